@@ -26,14 +26,20 @@ extern "C" {
 typedef struct {
     enum AUD_SAMPRATE_T fs;
     enum AUD_BITS_T bits;
-    float factor_up;
-    float factor_down;
+    uint8_t channels;
+    float lookahead_ms;
+    float release_s;
     float reduce_dB;
 } PEAK_DETECTOR_CFG_T;
 
 void peak_detector_init(void);
 void peak_detector_setup(PEAK_DETECTOR_CFG_T *cfg);
+// |buf| is delayed by the lookahead and limited to reduce_dB below full scale
+// after the codec volume |vol_multiple|.
 void peak_detector_run(uint8_t *buf, uint32_t len, float vol_multiple);
+// Gain reduction since the previous call; see peak_limiter_take_stats().
+void peak_detector_take_stats(uint32_t *gr_frames,
+                              uint32_t *max_reduction_q31);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,90 @@
+#ifndef __PEAK_LIMITER_H__
+#define __PEAK_LIMITER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fixed-point lookahead peak limiter.
+//
+// Input is delayed by |lookahead| sample frames. The detector takes the
+// largest magnitude over all channels of a frame, so every channel gets the
+// same gain and the stereo image does not move, and keeps the maximum of the
+// frames now in the delay line in a monotonic deque: O(1) per frame no matter
+// how long the lookahead is.
+//
+// When a peak above the threshold enters the delay line, the gain ramps down
+// linearly so that it reaches threshold/peak by the time that peak leaves,
+// and a peak can never get past the threshold. When the peak has gone, the
+// gain recovers towards the new target through a one-pole smoother. Gains
+// are Q31; the target is only recomputed when the window maximum changes, by
+// a reciprocal that is always rounded down, and there is no divide per
+// sample.
+
+#define PEAK_LIMITER_MAX_LOOKAHEAD 128
+#define PEAK_LIMITER_MAX_CHANNELS 2
+#define PEAK_LIMITER_UNITY_Q31 INT32_MAX
+// Power of two above PEAK_LIMITER_MAX_LOOKAHEAD, so indices wrap by masking.
+#define PEAK_LIMITER_DEQUE_SIZE 256
+
+typedef struct {
+  int32_t peak;
+  uint32_t frame;
+} PEAK_LIMITER_PEAK_T;
+
+typedef struct {
+  uint8_t channels;
+  uint32_t lookahead;
+  int32_t inv_lookahead_q31;
+  int32_t release_q31;
+  int32_t threshold;
+
+  int32_t delay[PEAK_LIMITER_MAX_LOOKAHEAD * PEAK_LIMITER_MAX_CHANNELS];
+  uint32_t delay_pos;
+  PEAK_LIMITER_PEAK_T deque[PEAK_LIMITER_DEQUE_SIZE];
+  // Free-running; masked on use.
+  uint32_t deque_head;
+  uint32_t deque_tail;
+  uint32_t frame;
+
+  int32_t window_peak;
+  int32_t target_q31;
+  int32_t gain_q31;
+  bool ramping;
+  int32_t ramp_to_q31;
+  int32_t ramp_step_q31;
+
+  uint32_t gr_frames;
+  int32_t min_gain_q31;
+} PEAK_LIMITER_T;
+
+// |lookahead| is in sample frames, 1 to PEAK_LIMITER_MAX_LOOKAHEAD;
+// |release_q31| is the share of the remaining distance to the target the
+// gain recovers per frame. The threshold starts out at full scale.
+void peak_limiter_init(PEAK_LIMITER_T *lim, uint8_t channels,
+                       uint32_t lookahead, int32_t release_q31);
+// Largest magnitude let through, in the units of the samples.
+void peak_limiter_set_threshold(PEAK_LIMITER_T *lim, int32_t threshold);
+
+// In place, interleaved. 24-bit samples are right-aligned in int32_t.
+void peak_limiter_process_16(PEAK_LIMITER_T *lim, int16_t *pcm,
+                             uint32_t frames);
+void peak_limiter_process_24(PEAK_LIMITER_T *lim, int32_t *pcm,
+                             uint32_t frames);
+
+// Frames that left with less than unity gain, and the deepest reduction,
+// UNITY - lowest gain in Q31, since the previous call.
+void peak_limiter_take_stats(PEAK_LIMITER_T *lim, uint32_t *gr_frames,
+                             uint32_t *max_reduction_q31);
+
+// floor(2^31 * num / den) or just below, for 0 <= num < den.
+int32_t peak_limiter_ratio_q31(int32_t num, int32_t den);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __PEAK_LIMITER_H__
@@ -0,0 +1,207 @@
+#include "peak_limiter.h"
+#include <string.h>
+
+// The release stops crawling and lands on the target when this close.
+#define LIM_SNAP_Q31 (1 << 15)
+
+// 48/17 - 32/17 * D, the minimax linear guess at 1/D on [0.5, 1), in Q30.
+#define LIM_RECIP_SEED_C1 3031741621LL
+#define LIM_RECIP_SEED_C2 2021161080LL
+
+int32_t peak_limiter_ratio_q31(int32_t num, int32_t den) {
+  uint32_t n;
+  int64_t d, r, e;
+
+  if (num <= 0 || den <= 0)
+    return 0;
+  if (num >= den)
+    return PEAK_LIMITER_UNITY_Q31;
+
+  // den = d / 2^n with d in [2^31, 2^32); r ~ 2^62 / d, that is 2^32 / d in
+  // Q30.
+  n = __builtin_clz((uint32_t)den);
+  d = (int64_t)((uint32_t)den << n);
+  r = LIM_RECIP_SEED_C1 - ((LIM_RECIP_SEED_C2 * d) >> 32);
+  // Newton: error 1/17 -> 2^-8 -> 2^-16 -> Q30. After the first step r is
+  // never above the true reciprocal, and truncation only takes it lower.
+  for (int i = 0; i < 3; i++) {
+    e = (1LL << 62) - d * r;
+    r += (r * (e >> 32)) >> 30;
+  }
+  return (int32_t)(((uint64_t)num * (uint64_t)r) >> (31 - n));
+}
+
+void peak_limiter_init(PEAK_LIMITER_T *lim, uint8_t channels,
+                       uint32_t lookahead, int32_t release_q31) {
+  memset(lim, 0, sizeof(*lim));
+  if (channels == 0)
+    channels = 1;
+  if (channels > PEAK_LIMITER_MAX_CHANNELS)
+    channels = PEAK_LIMITER_MAX_CHANNELS;
+  if (lookahead == 0)
+    lookahead = 1;
+  if (lookahead > PEAK_LIMITER_MAX_LOOKAHEAD)
+    lookahead = PEAK_LIMITER_MAX_LOOKAHEAD;
+
+  lim->channels = channels;
+  lim->lookahead = lookahead;
+  // Rounded up, so a ramp over |lookahead| frames is never short.
+  lim->inv_lookahead_q31 =
+      (int32_t)(((1LL << 31) + lookahead - 1) / lookahead - (lookahead == 1));
+  lim->release_q31 = release_q31 > 0 ? release_q31 : 1;
+  lim->threshold = INT32_MAX;
+  lim->target_q31 = PEAK_LIMITER_UNITY_Q31;
+  lim->gain_q31 = PEAK_LIMITER_UNITY_Q31;
+  lim->min_gain_q31 = PEAK_LIMITER_UNITY_Q31;
+}
+
+void peak_limiter_set_threshold(PEAK_LIMITER_T *lim, int32_t threshold) {
+  if (threshold < 1)
+    threshold = 1;
+  if (threshold == lim->threshold)
+    return;
+
+  lim->threshold = threshold;
+  if (lim->window_peak > threshold)
+    lim->target_q31 = peak_limiter_ratio_q31(threshold, lim->window_peak);
+  else
+    lim->target_q31 = PEAK_LIMITER_UNITY_Q31;
+  // Peaks already in the delay line get no time to ramp for; step down now.
+  if (lim->target_q31 < lim->gain_q31) {
+    lim->gain_q31 = lim->target_q31;
+    lim->ramping = false;
+  }
+}
+
+// Takes the peak of the frame entering the delay line and returns the gain
+// for the frame leaving it.
+static inline int32_t lim_next_gain(PEAK_LIMITER_T *lim, int32_t peak) {
+  PEAK_LIMITER_PEAK_T *dq = lim->deque;
+  const uint32_t mask = PEAK_LIMITER_DEQUE_SIZE - 1;
+  uint32_t head = lim->deque_head;
+  uint32_t tail = lim->deque_tail;
+  int32_t target, gain;
+
+  // Drop the peaks the new one hides, then the ones that have left.
+  while (tail != head && dq[(tail - 1) & mask].peak <= peak)
+    tail--;
+  dq[tail & mask].peak = peak;
+  dq[tail & mask].frame = lim->frame;
+  tail++;
+  while (lim->frame - dq[head & mask].frame > lim->lookahead)
+    head++;
+  lim->deque_head = head;
+  lim->deque_tail = tail;
+  lim->frame++;
+
+  if (dq[head & mask].peak != lim->window_peak) {
+    lim->window_peak = dq[head & mask].peak;
+    if (lim->window_peak > lim->threshold)
+      lim->target_q31 =
+          peak_limiter_ratio_q31(lim->threshold, lim->window_peak);
+    else
+      lim->target_q31 = PEAK_LIMITER_UNITY_Q31;
+  }
+
+  target = lim->target_q31;
+  gain = lim->gain_q31;
+  if (target < gain && (!lim->ramping || target < lim->ramp_to_q31)) {
+    // The new peak leaves the delay line |lookahead| frames from now; keep
+    // any steeper ramp already under way for an earlier one.
+    int32_t step = (int32_t)(((int64_t)(target - gain) *
+                              lim->inv_lookahead_q31) >> 31);
+    if (step == 0)
+      step = -1;
+    if (!lim->ramping || step < lim->ramp_step_q31)
+      lim->ramp_step_q31 = step;
+    lim->ramp_to_q31 = target;
+    lim->ramping = true;
+  }
+
+  if (lim->ramping) {
+    gain += lim->ramp_step_q31;
+    if (gain <= lim->ramp_to_q31) {
+      gain = lim->ramp_to_q31;
+      lim->ramping = false;
+    }
+  } else if (target > gain) {
+    int32_t diff = target - gain;
+    if (diff < LIM_SNAP_Q31)
+      gain = target;
+    else
+      gain += (int32_t)(((int64_t)diff * lim->release_q31 + INT32_MAX) >> 31);
+  }
+  lim->gain_q31 = gain;
+
+  if (gain != PEAK_LIMITER_UNITY_Q31) {
+    lim->gr_frames++;
+    if (gain < lim->min_gain_q31)
+      lim->min_gain_q31 = gain;
+  }
+  return gain;
+}
+
+void peak_limiter_process_16(PEAK_LIMITER_T *lim, int16_t *pcm,
+                             uint32_t frames) {
+  const uint8_t channels = lim->channels;
+
+  for (uint32_t n = 0; n < frames; n++, pcm += channels) {
+    int32_t *line = &lim->delay[lim->delay_pos * channels];
+    int32_t peak = 0;
+    int32_t gain;
+
+    for (uint8_t ch = 0; ch < channels; ch++) {
+      int32_t mag = pcm[ch] < 0 ? -pcm[ch] : pcm[ch];
+      if (mag > peak)
+        peak = mag;
+    }
+    gain = lim_next_gain(lim, peak);
+
+    for (uint8_t ch = 0; ch < channels; ch++) {
+      int32_t out = line[ch];
+      line[ch] = pcm[ch];
+      if (gain != PEAK_LIMITER_UNITY_Q31)
+        out = (int32_t)(((int64_t)out * gain) >> 31);
+      pcm[ch] = (int16_t)out;
+    }
+    if (++lim->delay_pos == lim->lookahead)
+      lim->delay_pos = 0;
+  }
+}
+
+void peak_limiter_process_24(PEAK_LIMITER_T *lim, int32_t *pcm,
+                             uint32_t frames) {
+  const uint8_t channels = lim->channels;
+
+  for (uint32_t n = 0; n < frames; n++, pcm += channels) {
+    int32_t *line = &lim->delay[lim->delay_pos * channels];
+    int32_t peak = 0;
+    int32_t gain;
+
+    for (uint8_t ch = 0; ch < channels; ch++) {
+      int32_t mag = pcm[ch] < 0 ? -pcm[ch] : pcm[ch];
+      if (mag > peak)
+        peak = mag;
+    }
+    gain = lim_next_gain(lim, peak);
+
+    for (uint8_t ch = 0; ch < channels; ch++) {
+      int32_t out = line[ch];
+      line[ch] = pcm[ch];
+      if (gain != PEAK_LIMITER_UNITY_Q31)
+        out = (int32_t)(((int64_t)out * gain) >> 31);
+      pcm[ch] = out;
+    }
+    if (++lim->delay_pos == lim->lookahead)
+      lim->delay_pos = 0;
+  }
+}
+
+void peak_limiter_take_stats(PEAK_LIMITER_T *lim, uint32_t *gr_frames,
+                             uint32_t *max_reduction_q31) {
+  *gr_frames = lim->gr_frames;
+  *max_reduction_q31 =
+      (uint32_t)(PEAK_LIMITER_UNITY_Q31 - lim->min_gain_q31);
+  lim->gr_frames = 0;
+  lim->min_gain_q31 = lim->gain_q31;
+}
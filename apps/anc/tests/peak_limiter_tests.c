@@ -0,0 +1,260 @@
+#include "peak_limiter.h"
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FS 48000
+#define FRAMES 4800
+// 50 ms release.
+#define RELEASE_Q31                                                            \
+  ((int32_t)(2147483648.0 * (1 - exp(-1.0 / (0.05 * FS)))))
+
+static uint32_t rng = 1;
+
+static int32_t rand_range(int32_t lo, int32_t hi) {
+  rng = rng * 1664525u + 1013904223u;
+  return lo + (int32_t)((rng >> 8) % (uint32_t)(hi - lo + 1));
+}
+
+// Quiet noise with full-scale clicks and short loud bursts.
+static void make_transients(int32_t *pcm, uint32_t frames, uint8_t channels,
+                            int32_t full_scale) {
+  for (uint32_t n = 0; n < frames; n++) {
+    int32_t level = full_scale / 64;
+
+    if (n % 997 == 500)
+      level = full_scale;
+    else if (n % 1500 < 40)
+      level = full_scale / 2;
+    for (uint8_t ch = 0; ch < channels; ch++)
+      pcm[n * channels + ch] =
+          n % 997 == 500 ? (ch ? -level : level) : rand_range(-level, level);
+  }
+  for (uint32_t i = 0; i < frames * channels; i++) {
+    if (pcm[i] >= full_scale)
+      pcm[i] = full_scale - 1;
+  }
+}
+
+static void test_ratio_is_never_high(void) {
+  for (int i = 0; i < 200000; i++) {
+    int32_t den = rand_range(2, INT32_MAX - 1);
+    int32_t num = rand_range(1, den - 1);
+    int64_t exact = (int64_t)(((__int128)num << 31) / den);
+    int32_t got = peak_limiter_ratio_q31(num, den);
+
+    assert(got <= exact);
+    assert(exact - got <= 4);
+  }
+  assert(peak_limiter_ratio_q31(1, 2) <= (1 << 30));
+  assert(peak_limiter_ratio_q31(1, 2) >= (1 << 30) - 4);
+  assert(peak_limiter_ratio_q31(5, 5) == PEAK_LIMITER_UNITY_Q31);
+  assert(peak_limiter_ratio_q31(0, 5) == 0);
+}
+
+static void test_quiet_input_is_only_delayed(void) {
+  static PEAK_LIMITER_T lim;
+  int16_t in[2 * 256], out[2 * 256];
+
+  peak_limiter_init(&lim, 2, 16, RELEASE_Q31);
+  peak_limiter_set_threshold(&lim, 20000);
+  for (int i = 0; i < 2 * 256; i++)
+    in[i] = (int16_t)rand_range(-20000, 20000);
+  memcpy(out, in, sizeof(in));
+  peak_limiter_process_16(&lim, out, 256);
+
+  for (int i = 0; i < 2 * 16; i++)
+    assert(out[i] == 0);
+  for (int i = 2 * 16; i < 2 * 256; i++)
+    assert(out[i] == in[i - 2 * 16]);
+  assert(lim.gr_frames == 0);
+}
+
+static void check_ceiling_16(uint8_t channels, uint32_t lookahead) {
+  static PEAK_LIMITER_T lim;
+  static int32_t src[2 * FRAMES];
+  static int16_t pcm[2 * FRAMES];
+  const int32_t threshold = 8000;
+  uint32_t gr_frames, max_gr;
+
+  make_transients(src, FRAMES, channels, 32768);
+  for (uint32_t i = 0; i < FRAMES * channels; i++)
+    pcm[i] = (int16_t)src[i];
+
+  peak_limiter_init(&lim, channels, lookahead, RELEASE_Q31);
+  peak_limiter_set_threshold(&lim, threshold);
+  // Uneven block sizes, as the stream delivers them.
+  for (uint32_t n = 0, len; n < FRAMES; n += len) {
+    len = (uint32_t)rand_range(1, 300);
+    if (len > FRAMES - n)
+      len = FRAMES - n;
+    peak_limiter_process_16(&lim, pcm + n * channels, len);
+  }
+  for (uint32_t i = 0; i < FRAMES * channels; i++)
+    assert(pcm[i] <= threshold && pcm[i] >= -threshold);
+
+  peak_limiter_take_stats(&lim, &gr_frames, &max_gr);
+  assert(gr_frames > 0);
+  // The clicks are at full scale: at least 32767 -> 8000.
+  assert(max_gr >= (uint32_t)(PEAK_LIMITER_UNITY_Q31 / 32768.0 * 24767));
+}
+
+static void test_ceiling_holds_on_transients(void) {
+  static const uint32_t lookaheads[] = {1, 2, 7, 48,
+                                        PEAK_LIMITER_MAX_LOOKAHEAD};
+
+  for (uint32_t i = 0; i < sizeof(lookaheads) / sizeof(lookaheads[0]); i++) {
+    check_ceiling_16(1, lookaheads[i]);
+    check_ceiling_16(2, lookaheads[i]);
+  }
+}
+
+static void test_ceiling_holds_24bit(void) {
+  static PEAK_LIMITER_T lim;
+  static int32_t pcm[2 * FRAMES];
+  const int32_t threshold = 0x7FFFFF / 10;
+
+  make_transients(pcm, FRAMES, 2, 0x800000);
+  peak_limiter_init(&lim, 2, 48, RELEASE_Q31);
+  peak_limiter_set_threshold(&lim, threshold);
+  peak_limiter_process_24(&lim, pcm, FRAMES);
+  for (uint32_t i = 0; i < 2 * FRAMES; i++)
+    assert(pcm[i] <= threshold && pcm[i] >= -threshold);
+}
+
+static void test_stereo_gain_is_linked(void) {
+  static PEAK_LIMITER_T lim;
+  int16_t pcm[2 * 64];
+
+  for (int n = 0; n < 64; n++) {
+    pcm[2 * n] = 16000;
+    pcm[2 * n + 1] = 1000;
+  }
+  peak_limiter_init(&lim, 2, 8, RELEASE_Q31);
+  peak_limiter_set_threshold(&lim, 4000);
+  peak_limiter_process_16(&lim, pcm, 64);
+
+  // Once the ramp is over both sides are down by the same 12 dB.
+  for (int n = 24; n < 64; n++) {
+    assert(pcm[2 * n] <= 4000 && pcm[2 * n] >= 3998);
+    assert(pcm[2 * n + 1] >= 249 && pcm[2 * n + 1] <= 250);
+  }
+}
+
+static void test_ramp_starts_ahead_and_releases(void) {
+  static PEAK_LIMITER_T lim;
+  static int16_t pcm[FS];
+  int first_reduced = -1, click_out = 300 + 32;
+  uint32_t gr_frames, max_gr;
+
+  memset(pcm, 0, sizeof(pcm));
+  for (int n = 0; n < FS; n++)
+    pcm[n] = 1000;
+  pcm[300] = 30000;
+  peak_limiter_init(&lim, 1, 32, RELEASE_Q31);
+  peak_limiter_set_threshold(&lim, 10000);
+  peak_limiter_process_16(&lim, pcm, FS);
+
+  for (int n = 0; n < FS; n++) {
+    if (first_reduced < 0 && n >= 32 && pcm[n] < 1000)
+      first_reduced = n;
+  }
+  // The gain starts falling as the click enters the delay line, not when
+  // it leaves it, and is at the target when it does.
+  assert(first_reduced >= 300 && first_reduced < click_out);
+  assert(pcm[click_out] <= 10000 && pcm[click_out] >= 9990);
+  // The smoother brings the gain all the way back to unity.
+  assert(pcm[FS - 1] == 1000);
+  assert(lim.gain_q31 == PEAK_LIMITER_UNITY_Q31);
+
+  peak_limiter_take_stats(&lim, &gr_frames, &max_gr);
+  assert(gr_frames > 32 && gr_frames < FS);
+  peak_limiter_take_stats(&lim, &gr_frames, &max_gr);
+  assert(gr_frames == 0 && max_gr == 0);
+}
+
+static void test_lower_threshold_applies_at_once(void) {
+  static PEAK_LIMITER_T lim;
+  int16_t pcm[2 * 256];
+
+  for (int i = 0; i < 2 * 256; i++)
+    pcm[i] = (int16_t)(i & 1 ? -12000 : 12000);
+  peak_limiter_init(&lim, 2, 32, RELEASE_Q31);
+  peak_limiter_set_threshold(&lim, 20000);
+  peak_limiter_process_16(&lim, pcm, 128);
+  peak_limiter_set_threshold(&lim, 3000);
+  peak_limiter_process_16(&lim, pcm + 2 * 128, 128);
+  for (int i = 2 * 128; i < 2 * 256; i++)
+    assert(pcm[i] <= 3000 && pcm[i] >= -3000);
+}
+
+// The float envelope follower this replaces, to show what it let through.
+static void ref_run(int16_t *buf, uint32_t len, float reduce_rate) {
+  const float alpha_r = expf(-1 / (2.0f * FS));
+  const float alpha_a = expf(-1 / (0.6f * FS));
+  float f1 = 0, f2 = 0;
+
+  for (uint32_t i = 0; i < len; i++) {
+    float tgt;
+
+    f1 = fmaxf(buf[i], alpha_r * f1);
+    f2 = alpha_a * f2 + (1 - alpha_a) * f1;
+    tgt = reduce_rate / (f2 / 32768);
+    if (tgt > 1.0f)
+      tgt = 1.0f;
+    buf[i] = (int16_t)(buf[i] * tgt);
+  }
+}
+
+static int32_t worst_overshoot(const int16_t *pcm, uint32_t len,
+                               int32_t ceiling) {
+  int32_t over = 0;
+
+  for (uint32_t i = 0; i < len; i++) {
+    if (abs(pcm[i]) - ceiling > over)
+      over = abs(pcm[i]) - ceiling;
+  }
+  return over;
+}
+
+static void report_against_float_follower(void) {
+  static PEAK_LIMITER_T lim;
+  static int32_t src[2 * FRAMES];
+  static int16_t pcm[2 * FRAMES];
+  int32_t ref_over, lim_over;
+
+  make_transients(src, FRAMES, 2, 32768);
+
+  for (uint32_t i = 0; i < 2 * FRAMES; i++)
+    pcm[i] = (int16_t)src[i];
+  ref_run(pcm, 2 * FRAMES, 0.25f);
+  ref_over = worst_overshoot(pcm, 2 * FRAMES, 8192);
+
+  for (uint32_t i = 0; i < 2 * FRAMES; i++)
+    pcm[i] = (int16_t)src[i];
+  peak_limiter_init(&lim, 2, 48, RELEASE_Q31);
+  peak_limiter_set_threshold(&lim, 8192);
+  peak_limiter_process_16(&lim, pcm, FRAMES);
+  lim_over = worst_overshoot(pcm, 2 * FRAMES, 8192);
+
+  assert(ref_over > 0);
+  assert(lim_over == 0);
+  printf("  worst overshoot of -12 dBFS: float follower %d, lookahead %d\n",
+         ref_over, lim_over);
+}
+
+int main(void) {
+  test_ratio_is_never_high();
+  test_quiet_input_is_only_delayed();
+  test_ceiling_holds_on_transients();
+  test_ceiling_holds_24bit();
+  test_stereo_gain_is_linked();
+  test_ramp_starts_ahead_and_releases();
+  test_lower_threshold_applies_at_once();
+  report_against_float_follower();
+  printf("peak_limiter_tests: all passed\n");
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include "a2dp_audio_drift.h"
+#include <math.h>
+#include <string.h>
+
+// Observations further than this many std devs from the prediction are gated.
+#define DRIFT_GATE_SIGMA 4.0f
+
+void a2dp_audio_drift_default_cfg(A2DP_AUDIO_DRIFT_CFG_T *cfg) {
+  cfg->meas_noise_us = 100.0f;
+  cfg->drift_walk_ppm = 0.05f;
+  cfg->init_drift_ppm = 100.0f;
+  cfg->phase_time_s = 4.0f;
+  cfg->min_ppm = -300.0f;
+  cfg->max_ppm = 300.0f;
+  cfg->max_slew_ppm_s = 20.0f;
+  cfg->reseed_s = 1.0f;
+  cfg->ratio_in_loop = true;
+}
+
+void a2dp_audio_drift_init(A2DP_AUDIO_DRIFT_T *drift,
+                           const A2DP_AUDIO_DRIFT_CFG_T *cfg) {
+  memset(drift, 0, sizeof(*drift));
+  drift->cfg = *cfg;
+  drift->p[1][1] = cfg->init_drift_ppm * cfg->init_drift_ppm;
+}
+
+void a2dp_audio_drift_reset(A2DP_AUDIO_DRIFT_T *drift) {
+  A2DP_AUDIO_DRIFT_CFG_T cfg = drift->cfg;
+
+  a2dp_audio_drift_init(drift, &cfg);
+}
+
+void a2dp_audio_drift_restart(A2DP_AUDIO_DRIFT_T *drift) {
+  drift->started = false;
+}
+
+static void drift_seed_offset(A2DP_AUDIO_DRIFT_T *drift, float z) {
+  drift->offset_us = z;
+  drift->p[0][0] = drift->cfg.meas_noise_us * drift->cfg.meas_noise_us;
+  drift->p[0][1] = 0;
+  drift->p[1][0] = 0;
+  drift->outlier_run_s = 0;
+}
+
+static void drift_predict(A2DP_AUDIO_DRIFT_T *drift, float dt,
+                          float applied_ppm) {
+  float(*p)[2] = drift->p;
+  float walk = drift->cfg.drift_walk_ppm;
+  // Let the offset wander a little too, so the gain never collapses to zero.
+  float q_offset = 0.01f * drift->cfg.meas_noise_us * drift->cfg.meas_noise_us;
+
+  drift->offset_us += (drift->drift_ppm + applied_ppm) * dt;
+  p[0][0] += dt * (p[0][1] + p[1][0]) + dt * dt * p[1][1] + q_offset * dt;
+  p[0][1] += dt * p[1][1];
+  p[1][0] = p[0][1];
+  p[1][1] += walk * walk * dt;
+}
+
+// Returns false if |z| was gated as an outlier.
+static bool drift_correct(A2DP_AUDIO_DRIFT_T *drift, float z, float dt) {
+  float(*p)[2] = drift->p;
+  float r = drift->cfg.meas_noise_us * drift->cfg.meas_noise_us;
+  float s = p[0][0] + r;
+  float innov = z - drift->offset_us;
+  float k0, k1;
+
+  if (innov * innov > DRIFT_GATE_SIGMA * DRIFT_GATE_SIGMA * s) {
+    drift->outliers++;
+    drift->outlier_run_s += dt;
+    if (drift->outlier_run_s >= drift->cfg.reseed_s)
+      drift_seed_offset(drift, z);
+    return false;
+  }
+  drift->outlier_run_s = 0;
+
+  k0 = p[0][0] / s;
+  k1 = p[1][0] / s;
+  drift->offset_us += k0 * innov;
+  drift->drift_ppm += k1 * innov;
+  p[1][1] -= k1 * p[0][1];
+  p[0][0] *= 1 - k0;
+  p[0][1] *= 1 - k0;
+  p[1][0] = p[0][1];
+  return true;
+}
+
+static float drift_control(A2DP_AUDIO_DRIFT_T *drift, float dt) {
+  const A2DP_AUDIO_DRIFT_CFG_T *cfg = &drift->cfg;
+  float target = -(drift->drift_ppm + drift->offset_us / cfg->phase_time_s);
+  float step = cfg->max_slew_ppm_s * dt;
+
+  if (target > cfg->max_ppm)
+    target = cfg->max_ppm;
+  else if (target < cfg->min_ppm)
+    target = cfg->min_ppm;
+  if (target > drift->ratio_ppm + step)
+    target = drift->ratio_ppm + step;
+  else if (target < drift->ratio_ppm - step)
+    target = drift->ratio_ppm - step;
+  return target;
+}
+
+float a2dp_audio_drift_update(A2DP_AUDIO_DRIFT_T *drift, uint32_t now_us,
+                              float offset_us, float applied_ppm) {
+  float dt;
+
+  if (!drift->started) {
+    drift->started = true;
+    drift->last_us = now_us;
+    drift->applied_us = 0;
+    drift_seed_offset(drift, offset_us);
+    // Carry on from the drift learnt before a restart, or else from whatever
+    // ratio is in effect.
+    drift->ratio_ppm = drift->updates ? -drift->drift_ppm : applied_ppm;
+    if (drift->ratio_ppm > drift->cfg.max_ppm)
+      drift->ratio_ppm = drift->cfg.max_ppm;
+    else if (drift->ratio_ppm < drift->cfg.min_ppm)
+      drift->ratio_ppm = drift->cfg.min_ppm;
+    return drift->ratio_ppm;
+  }
+
+  dt = (now_us - drift->last_us) * 1e-6f;
+  if (dt <= 0)
+    return drift->ratio_ppm;
+  drift->last_us = now_us;
+
+  // Out of loop the observations never see the correction, so add it back
+  // to get the offset the corrected clock would have had.
+  if (!drift->cfg.ratio_in_loop)
+    drift->applied_us += applied_ppm * dt;
+
+  drift_predict(drift, dt, applied_ppm);
+  drift_correct(drift, offset_us + drift->applied_us, dt);
+  drift->updates++;
+  drift->ratio_ppm = drift_control(drift, dt);
+  return drift->ratio_ppm;
+}
+
+void a2dp_audio_drift_shift(A2DP_AUDIO_DRIFT_T *drift, float delta_us) {
+  drift->offset_us += delta_us;
+}
+
+float a2dp_audio_drift_ratio_ppm(const A2DP_AUDIO_DRIFT_T *drift) {
+  return drift->ratio_ppm;
+}
+
+float a2dp_audio_drift_confidence(const A2DP_AUDIO_DRIFT_T *drift) {
+  if (!drift->started)
+    return 0;
+  return 1.0f / (1.0f + sqrtf(drift->p[1][1]));
+}
@@ -0,0 +1,80 @@
+#ifndef __A2DP_AUDIO_DRIFT_H__
+#define __A2DP_AUDIO_DRIFT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Clock drift estimator for A2DP playback sync.
+//
+// Fed with the offset of the local playback clock against a reference (the
+// BT clock, or the source as seen through the jitter buffer level), a two
+// state Kalman filter tracks that offset and the drift rate between the two
+// clocks. The output is the resample ratio, in ppm, that cancels the drift
+// and pulls the offset back to zero over |phase_time_s|. It is rate limited so
+// corrections never turn into audible pitch wobble.
+//
+// The filter gain starts high and falls as the drift estimate firms up, so it
+// locks within a few seconds of start yet rides out jitter and packet bursts
+// later on. Observations far outside the expected jitter are ignored, and a
+// run of them lasting |reseed_s| (a real step, e.g. after an underflow)
+// re-seeds the offset.
+
+typedef struct {
+  float meas_noise_us;   // std dev of one offset observation
+  float drift_walk_ppm;  // std dev of the drift change over one second
+  float init_drift_ppm;  // std dev of the drift before the first observation
+  float phase_time_s;    // time constant of the offset correction
+  float min_ppm;         // output clamp
+  float max_ppm;
+  float max_slew_ppm_s;  // fastest the output may move
+  float reseed_s;        // how long observations may be gated in a row
+  // Whether the ratio applied shows up in the observed offset: true when it
+  // retunes the codec clock, false when a software resampler absorbs it.
+  bool ratio_in_loop;
+} A2DP_AUDIO_DRIFT_CFG_T;
+
+typedef struct {
+  A2DP_AUDIO_DRIFT_CFG_T cfg;
+  bool started;
+  uint32_t last_us;
+  float offset_us;      // estimated offset of the corrected local clock
+  float drift_ppm;      // estimated drift of the local clock, uncorrected
+  float p[2][2];        // covariance of (offset_us, drift_ppm)
+  float applied_us;     // ratio applied so far, integrated, if out of loop
+  float ratio_ppm;      // current output
+  float outlier_run_s;
+  uint32_t updates;
+  uint32_t outliers;
+} A2DP_AUDIO_DRIFT_T;
+
+void a2dp_audio_drift_default_cfg(A2DP_AUDIO_DRIFT_CFG_T *cfg);
+void a2dp_audio_drift_init(A2DP_AUDIO_DRIFT_T *drift,
+                           const A2DP_AUDIO_DRIFT_CFG_T *cfg);
+void a2dp_audio_drift_reset(A2DP_AUDIO_DRIFT_T *drift);
+// Starts over from the next observation but keeps the drift learnt so far,
+// for when the stream restarts on the same pair of clocks.
+void a2dp_audio_drift_restart(A2DP_AUDIO_DRIFT_T *drift);
+
+// Takes one observation: at |now_us| the local clock is |offset_us| ahead of
+// the reference, with |applied_ppm| the ratio in effect since the previous
+// one. Returns the ratio to apply from now on.
+float a2dp_audio_drift_update(A2DP_AUDIO_DRIFT_T *drift, uint32_t now_us,
+                              float offset_us, float applied_ppm);
+
+// Moves the offset target by |delta_us|, e.g. to add deliberate latency,
+// without treating the step in the observations as an outlier.
+void a2dp_audio_drift_shift(A2DP_AUDIO_DRIFT_T *drift, float delta_us);
+
+float a2dp_audio_drift_ratio_ppm(const A2DP_AUDIO_DRIFT_T *drift);
+// 1 / (1 + std dev of the drift estimate in ppm): 0.5 at 1 ppm.
+float a2dp_audio_drift_confidence(const A2DP_AUDIO_DRIFT_T *drift);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __A2DP_AUDIO_DRIFT_H__
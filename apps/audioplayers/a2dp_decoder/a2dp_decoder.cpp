@@ -57,8 +57,6 @@
 
 #ifdef __A2DP_AUDIO_SYNC_FIX_DIFF_NOPID__
 #define A2DP_AUDIO_SYNC_INTERVAL (25)
-#else
-#define A2DP_AUDIO_SYNC_INTERVAL (1000)
 #endif
 
 #define A2DP_AUDIO_LATENCY_LOW_FACTOR (1.0f)
@@ -70,6 +68,12 @@
 #define A2DP_AUDIO_SYNC_FACTOR_SLOW_LIMIT (-0.00035f)
 #define A2DP_AUDIO_SYNC_FACTOR_NEED_FAST_CACHE (-0.001f)
 
+#define A2DP_AUDIO_SYNC_TUNE_INTERVAL (50)
+#define A2DP_AUDIO_SYNC_TUNE_STEP (0.000002f)
+#define A2DP_AUDIO_SYNC_DRIFT_NOISE_US (2000.0f)
+#define A2DP_AUDIO_SYNC_DRIFT_PHASE_S (120.0f)
+#define A2DP_AUDIO_SYNC_DRIFT_SLEW_PPM_S (5.0f)
+
 #define A2DP_AUDIO_UNDERFLOW_CAUSE_AUDIO_RETRIGGER (1)
 
 extern A2DP_AUDIO_DECODER_T a2dp_audio_sbc_decoder_config;
@@ -138,6 +142,9 @@ static uint32_t store_packet_history_loctime = 0;
 
 static uint32_t check_sum_seed = 0;
 
+static ilist_t a2dp_audio_input_raw_packets;
+static ilist_t a2dp_audio_output_pcm_packets;
+
 static int a2dp_audio_internal_lastframe_info_ptr_get(
     A2DP_AUDIO_LASTFRAME_INFO_T **lastframe_info);
 
@@ -186,6 +193,42 @@ void a2dp_audio_heap_info(size_t *total, size_t *used, size_t *max_used) {
     *max_used = info.total_bytes - info.minimum_free_bytes;
 }
 
+void a2dp_audio_slab_init(slab_t *slab, uint32_t obj_size, uint32_t count) {
+  uint32_t size = slab_buffer_size(obj_size, count);
+  slab_init(slab, a2dp_audio_heap_malloc(size), size, obj_size);
+}
+
+void a2dp_audio_slab_deinit(slab_t *slab) {
+  slab_info_t info;
+
+  if (slab->buf == NULL)
+    return;
+  slab_get_info(slab, &info);
+  TRACE_A2DP_DECODER_I("[SLAB] obj:%d total:%d used:%d peak:%d", info.obj_size,
+                       info.total, info.used, info.peak);
+  TRACE_A2DP_DECODER_I("[SLAB] alloc:%d free:%d fail:%d", info.alloc_cnt,
+                       info.free_cnt, info.fail_cnt);
+  a2dp_audio_heap_free(slab->buf);
+  slab_init(slab, NULL, 0, 0);
+}
+
+void *a2dp_audio_slab_malloc(slab_t *slab, uint32_t size) {
+  void *ptr = NULL;
+
+  if (size <= slab->info.obj_size)
+    ptr = slab_alloc(slab);
+  if (ptr == NULL)
+    ptr = a2dp_audio_heap_malloc(size);
+  return ptr;
+}
+
+void a2dp_audio_slab_free(slab_t *slab, void *rmem) {
+  if (slab_owns(slab, rmem))
+    slab_free(slab, rmem);
+  else
+    a2dp_audio_heap_free(rmem);
+}
+
 int inline a2dp_audio_semaphore_init(void) {
   if (a2dp_audio_context.audio_semaphore.semaphore == NULL) {
     a2dp_audio_context.audio_semaphore.semaphore =
@@ -265,73 +308,87 @@ int inline a2dp_audio_semaphore_release(void) {
   return 0;
 }
 
-list_node_t *a2dp_audio_list_begin(const list_t *list) {
+static void a2dp_audio_packet_free(void *packet) {
+  if (a2dp_audio_context.audio_decoder.audio_decoder_packet_free) {
+    a2dp_audio_context.audio_decoder.audio_decoder_packet_free(packet);
+  } else {
+    a2dp_audio_heap_free(packet);
+  }
+}
+
+ilist_node_t *a2dp_audio_list_begin(const ilist_t *list) {
   a2dp_audio_buffer_mutex_lock();
-  list_node_t *node = list_begin(list);
+  ilist_node_t *node = ilist_begin(list);
   a2dp_audio_buffer_mutex_unlock();
   return node;
 }
 
-list_node_t *a2dp_audio_list_end(const list_t *list) {
+ilist_node_t *a2dp_audio_list_end(const ilist_t *list) {
   a2dp_audio_buffer_mutex_lock();
-  list_node_t *node = list_end(list);
+  ilist_node_t *node = ilist_end(list);
   a2dp_audio_buffer_mutex_unlock();
   return node;
 }
 
-uint32_t a2dp_audio_list_length(const list_t *list) {
+uint32_t a2dp_audio_list_length(const ilist_t *list) {
   a2dp_audio_buffer_mutex_lock();
-  uint32_t length = list_length(list);
+  uint32_t length = ilist_length(list);
   a2dp_audio_buffer_mutex_unlock();
   return length;
 }
 
-void *a2dp_audio_list_node(const list_node_t *node) {
-  a2dp_audio_buffer_mutex_lock();
-  void *data = list_node(node);
-  a2dp_audio_buffer_mutex_unlock();
-  return data;
-}
+void *a2dp_audio_list_node(const ilist_node_t *node) { return (void *)node; }
 
-list_node_t *a2dp_audio_list_next(const list_node_t *node) {
+ilist_node_t *a2dp_audio_list_next(const ilist_node_t *node) {
   a2dp_audio_buffer_mutex_lock();
-  list_node_t *next = list_next(node);
+  ilist_node_t *next = ilist_next(node);
   a2dp_audio_buffer_mutex_unlock();
   return next;
 }
 
-bool a2dp_audio_list_remove(list_t *list, void *data) {
+bool a2dp_audio_list_remove(ilist_t *list, void *data) {
   a2dp_audio_buffer_mutex_lock();
-  bool nRet = list_remove(list, data);
+  ilist_remove(list, (ilist_node_t *)data);
   a2dp_audio_buffer_mutex_unlock();
-  return nRet;
+  a2dp_audio_packet_free(data);
+  return true;
 }
 
-bool a2dp_audio_list_append(list_t *list, void *data) {
+bool a2dp_audio_list_append(ilist_t *list, void *data) {
   a2dp_audio_buffer_mutex_lock();
-  bool nRet = list_append(list, data);
+  ilist_append(list, (ilist_node_t *)data);
   a2dp_audio_buffer_mutex_unlock();
-  return nRet;
+  return true;
 }
 
-void a2dp_audio_list_clear(list_t *list) {
+void a2dp_audio_list_splice(ilist_t *list, ilist_t *packets) {
   a2dp_audio_buffer_mutex_lock();
-  list_clear(list);
+  ilist_splice(list, packets);
   a2dp_audio_buffer_mutex_unlock();
 }
 
-void a2dp_audio_list_free(list_t *list) {
+uint32_t a2dp_audio_list_discard(ilist_t *list, uint32_t packets) {
+  ilist_t cut;
+  ilist_node_t *node;
+  uint32_t cnt;
+
+  ilist_init(&cut);
   a2dp_audio_buffer_mutex_lock();
-  list_free(list);
+  cnt = ilist_cut_front(&cut, list, packets);
   a2dp_audio_buffer_mutex_unlock();
+  while ((node = ilist_pop_front(&cut)) != NULL)
+    a2dp_audio_packet_free(node);
+  return cnt;
+}
+
+void a2dp_audio_list_clear(ilist_t *list) {
+  a2dp_audio_list_discard(list, UINT32_MAX);
 }
 
-list_t *a2dp_audio_list_new(list_free_cb callback, list_mempool_zmalloc zmalloc,
-                            list_mempool_free free) {
+void a2dp_audio_list_init(ilist_t *list) {
   a2dp_audio_buffer_mutex_lock();
-  list_t *list = list_new(callback, zmalloc, free);
+  ilist_init(list);
   a2dp_audio_buffer_mutex_unlock();
-  return list;
 }
 
 uint32_t a2dp_audio_get_passed(uint32_t curr_ticks, uint32_t prev_ticks,
@@ -412,15 +469,19 @@ static void a2dp_decoder_info_checker(void) {
   //    (uint32_t)bt_drv_reg_op_bt_info_checker);
 }
 
-int a2dp_audio_sync_pid_config(void) {
+static void a2dp_audio_sync_drift_init(void) {
   A2DP_AUDIO_SYNC_T *audio_sync = &a2dp_audio_context.audio_sync;
-  A2DP_AUDIO_SYNC_PID_T *pid = &audio_sync->pid;
-
-  pid->proportiongain = 0.4f;
-  pid->integralgain = 0.1f;
-  pid->derivativegain = 0.6f;
+  A2DP_AUDIO_DRIFT_CFG_T cfg;
 
-  return 0;
+  // The packet list level moves in whole packets, so trust each reading
+  // little and take minutes, not seconds, to work off an offset.
+  a2dp_audio_drift_default_cfg(&cfg);
+  cfg.meas_noise_us = A2DP_AUDIO_SYNC_DRIFT_NOISE_US;
+  cfg.phase_time_s = A2DP_AUDIO_SYNC_DRIFT_PHASE_S;
+  cfg.max_slew_ppm_s = A2DP_AUDIO_SYNC_DRIFT_SLEW_PPM_S;
+  cfg.min_ppm = A2DP_AUDIO_SYNC_FACTOR_SLOW_LIMIT * 1e6f;
+  cfg.max_ppm = A2DP_AUDIO_SYNC_FACTOR_FAST_LIMIT * 1e6f;
+  a2dp_audio_drift_init(&audio_sync->drift, &cfg);
 }
 
 int a2dp_audio_sync_reset_data(void) {
@@ -429,7 +490,8 @@ int a2dp_audio_sync_reset_data(void) {
   a2dp_audio_status_mutex_lock();
   audio_sync->tick = 0;
   audio_sync->cnt = 0;
-  a2dp_audio_sync_pid_config();
+  audio_sync->play_samples = 0;
+  a2dp_audio_drift_restart(&audio_sync->drift);
 #ifdef __A2DP_AUDIO_SYNC_FIX_DIFF_NOPID__
   a2dp_audio_sync_fix_diff_reset();
 #endif
@@ -443,6 +505,7 @@ int a2dp_audio_sync_init(double ratio) {
 #ifdef __A2DP_AUDIO_SYNC_FIX_DIFF_NOPID__
   a2dp_audio_sync_fix_diff_reset();
 #endif
+  a2dp_audio_sync_drift_init();
   a2dp_audio_sync_reset_data();
   a2dp_audio_sync_tune_sample_rate(ratio);
   sync_tune_dest_ratio = (float)ratio;
@@ -539,26 +602,6 @@ int a2dp_audio_sync_tune_cancel(void) {
   return 0;
 }
 
-float a2dp_audio_sync_pid_calc(A2DP_AUDIO_SYNC_PID_T *pid, float diff) {
-  float increment;
-  float pError, dError, iError;
-
-  pid->error[0] = diff;
-  pError = pid->error[0] - pid->error[1];
-  iError = pid->error[0];
-  dError = pid->error[0] - 2 * pid->error[1] + pid->error[2];
-
-  increment = pid->proportiongain * pError + pid->integralgain * iError +
-              pid->derivativegain * dError;
-
-  pid->error[2] = pid->error[1];
-  pid->error[1] = pid->error[0];
-
-  pid->result += increment;
-
-  return pid->result;
-}
-
 #ifdef __A2DP_AUDIO_SYNC_FIX_DIFF_NOPID__
 static int a2dp_audio_sync_fix_diff_proc(uint32_t tick) {
   if (a2dp_audio_sync_fix_diff.status ==
@@ -771,11 +814,12 @@ exit:
 int a2dp_audio_sync_handler(uint8_t *buffer, uint32_t buffer_bytes) {
   A2DP_AUDIO_LASTFRAME_INFO_T *lastframe_info = NULL;
   A2DP_AUDIO_SYNC_T *audio_sync = &a2dp_audio_context.audio_sync;
-  float dest_pid_result = .0f;
+  A2DP_AUDIO_OUTPUT_CONFIG_T *stream_info;
+  float dest_ratio = .0f;
   float diff_mtu = 0;
-  int32_t frame_mtu = 0;
-  int32_t total_mtu = 0;
-  float diff_factor = 0;
+  float packet_us;
+  float ratio_ppm;
+  bool need_tune = false;
 
 #if defined(IBRT)
   if (!app_tws_ibrt_mobile_link_connected()) {
@@ -785,121 +829,87 @@ int a2dp_audio_sync_handler(uint8_t *buffer, uint32_t buffer_bytes) {
   if (a2dp_audio_internal_lastframe_info_ptr_get(&lastframe_info) < 0) {
     return -1;
   }
-
-  if (audio_sync->tick++ % A2DP_AUDIO_SYNC_INTERVAL == 0) {
-    list_t *list = a2dp_audio_context.audio_datapath.input_raw_packet_list;
-    A2DP_AUDIO_SYNC_PID_T *pid = &audio_sync->pid;
-    // valid limter 0x80000
-    if (audio_sync->cnt < 0x80000) {
-      audio_sync->cnt += A2DP_AUDIO_SYNC_INTERVAL;
-    }
-    frame_mtu = lastframe_info->stream_info.frame_samples /
-                lastframe_info->frame_samples;
-    total_mtu = audio_sync->cnt * frame_mtu;
-    diff_mtu = a2dp_audio_context.average_packet_mut -
-               (float)a2dp_audio_context.dest_packet_mut;
-#if 1
-    TRACE_A2DP_DECODER_I(
-        "[SYNC] sample:%d/%d diff:%d/%d/%d/%d curr:%d",
-        lastframe_info->frame_samples,
-        lastframe_info->stream_info.frame_samples, (int32_t)(diff_mtu + 0.5f),
-        (int32_t)(a2dp_audio_context.average_packet_mut + 0.5f),
-        a2dp_audio_context.dest_packet_mut, total_mtu,
-        a2dp_audio_list_length(list) + get_in_cp_frame_cnt());
-#else
-    TRACE_A2DP_DECODER_I(
-        "[SYNC] diff:%10.9f/%10.9f frame_mut:%d dest:%d total:%d curr:%d",
-        (double)diff_mtu, (double)a2dp_audio_context.average_packet_mut,
-        frame_mtu, a2dp_audio_context.dest_packet_mut, total_mtu,
-        a2dp_audio_list_length(list));
-    TRACE_A2DP_DECODER_I("[SYNC] try tune:%d, %10.9f %10.9f",
-                         diff_mtu != 0.f && audio_sync->tick != 1
-                             ? ABS(diff_mtu) > ((float)frame_mtu * 0.2f)
-                             : 0,
-                         (double)ABS(diff_mtu),
-                         (double)((float)frame_mtu * 0.2f));
-#endif
-    // TRACE(2,"audio_sync tune %d/%d tick",
-    // app_tws_ibrt_audio_sync_tune_onprocess(),
-    // a2dp_audio_sync_tune_onprocess(), audio_sync->tick);
-
+  stream_info = &lastframe_info->stream_info;
+
+  // The packet list level against its target is how far playback runs
+  // ahead of the source; the drift estimator turns it into a ratio.
+  audio_sync->play_samples += stream_info->frame_samples;
+  packet_us = lastframe_info->frame_samples * 1000000.0f /
+              stream_info->sample_rate;
+  diff_mtu = a2dp_audio_context.average_packet_mut -
+             (float)a2dp_audio_context.dest_packet_mut;
+  ratio_ppm = a2dp_audio_drift_update(
+      &audio_sync->drift,
+      (uint32_t)((uint64_t)audio_sync->play_samples * 1000000 /
+                 stream_info->sample_rate),
+      -diff_mtu * packet_us,
+      (a2dp_audio_context.output_cfg.factor_reference -
+       a2dp_audio_context.init_factor_reference) *
+          1e6f);
+
+  if (lastframe_info->undecode_min_frames * 10 <=
+      a2dp_audio_context.dest_packet_mut * 10 / 3) {
+    dest_ratio = a2dp_audio_context.init_factor_reference +
+                 A2DP_AUDIO_SYNC_FACTOR_NEED_FAST_CACHE;
+    need_tune = true;
+  } else if (lastframe_info->undecode_min_frames * 10 <=
+             a2dp_audio_context.dest_packet_mut * 20 / 3) {
+    dest_ratio = a2dp_audio_context.init_factor_reference +
+                 A2DP_AUDIO_SYNC_FACTOR_SLOW_LIMIT;
+    need_tune = true;
+  }
+  if (need_tune) {
 #if defined(IBRT)
-    if ((!app_tws_ibrt_audio_sync_tune_onprocess() &&
-         !a2dp_audio_sync_tune_onprocess()) &&
+    if (!app_tws_ibrt_audio_sync_tune_onprocess() &&
+        !a2dp_audio_sync_tune_onprocess() &&
 #else
     if (!a2dp_audio_sync_tune_onprocess() &&
 #endif
-        diff_mtu != 0.f && audio_sync->tick != 1 &&
-        ((ABS(diff_mtu) > ((float)frame_mtu * 0.25f) && diff_mtu > 0) ||
-         (ABS(diff_mtu) > ((float)frame_mtu * 0.1f) && diff_mtu < 0))) {
-      diff_factor = diff_mtu / a2dp_audio_context.average_packet_mut;
-      if (a2dp_audio_sync_pid_calc(pid, diff_factor)) {
-        dest_pid_result =
-            a2dp_audio_context.output_cfg.factor_reference + pid->result;
-
-        if (dest_pid_result > (A2DP_AUDIO_SYNC_FACTOR_REFERENCE +
-                               A2DP_AUDIO_SYNC_FACTOR_FAST_LIMIT)) {
-          dest_pid_result = A2DP_AUDIO_SYNC_FACTOR_REFERENCE +
-                            A2DP_AUDIO_SYNC_FACTOR_FAST_LIMIT;
-        } else if (dest_pid_result < (A2DP_AUDIO_SYNC_FACTOR_REFERENCE +
-                                      A2DP_AUDIO_SYNC_FACTOR_SLOW_LIMIT)) {
-          dest_pid_result = A2DP_AUDIO_SYNC_FACTOR_REFERENCE +
-                            A2DP_AUDIO_SYNC_FACTOR_SLOW_LIMIT;
-        }
+        a2dp_audio_context.output_cfg.factor_reference != dest_ratio) {
+      a2dp_audio_sync_reset_data();
+      a2dp_audio_sync_tune(dest_ratio);
+      TRACE_A2DP_DECODER_I("[SYNC] tune ratio force slow %d/%d->%d",
+                           lastframe_info->undecode_min_frames,
+                           lastframe_info->undecode_max_frames,
+                           a2dp_audio_context.dest_packet_mut);
+    }
+    return 0;
+  }
 
-        if (a2dp_audio_context.output_cfg.factor_reference != dest_pid_result) {
-          if (!a2dp_audio_sync_tune(dest_pid_result)) {
-            audio_sync->cnt = 0;
-          }
-          TRACE_A2DP_DECODER_I(
-              "[SYNC] tune diff_factor:%10.9f pid:%10.9f tune:%10.9f",
-              (double)diff_factor, (double)pid->result,
-              (double)dest_pid_result);
-        } else {
-          TRACE_A2DP_DECODER_I("[SYNC] tune skip same");
-        }
-      }
-    } else {
-      /*
-                  TRACE_A2DP_DECODER_I("[SYNC] tune busy skip proc:%d/%d mtu:%d
-         tick:%d >0:%d <0:%d tick:%d", app_tws_ibrt_audio_sync_tune_onprocess(),
-                                                      a2dp_audio_sync_tune_onprocess(),
-                                                      diff_mtu != 0.f,
-                                                      audio_sync->tick != 1,
-                                                      (ABS(diff_mtu) >
-         ((float)frame_mtu * 0.25f) && diff_mtu > 0), (ABS(diff_mtu) >
-         ((float)frame_mtu * 0.1f) && diff_mtu < 0), audio_sync->tick);
-      */
+  if (audio_sync->tick++ % A2DP_AUDIO_SYNC_TUNE_INTERVAL == 0) {
+    // valid limter 0x80000
+    if (audio_sync->cnt < 0x80000) {
+      audio_sync->cnt += A2DP_AUDIO_SYNC_TUNE_INTERVAL;
     }
-  } else {
-    bool need_tune = false;
-    if (lastframe_info->undecode_min_frames * 10 <=
-        a2dp_audio_context.dest_packet_mut * 10 / 3) {
-      dest_pid_result = a2dp_audio_context.init_factor_reference +
-                        A2DP_AUDIO_SYNC_FACTOR_NEED_FAST_CACHE;
-      need_tune = true;
-    } else if (lastframe_info->undecode_min_frames * 10 <=
-               a2dp_audio_context.dest_packet_mut * 20 / 3) {
-      dest_pid_result = a2dp_audio_context.init_factor_reference +
-                        A2DP_AUDIO_SYNC_FACTOR_SLOW_LIMIT;
-      need_tune = true;
+    dest_ratio = a2dp_audio_context.init_factor_reference + ratio_ppm * 1e-6f;
+    if (dest_ratio > (A2DP_AUDIO_SYNC_FACTOR_REFERENCE +
+                      A2DP_AUDIO_SYNC_FACTOR_FAST_LIMIT)) {
+      dest_ratio =
+          A2DP_AUDIO_SYNC_FACTOR_REFERENCE + A2DP_AUDIO_SYNC_FACTOR_FAST_LIMIT;
+    } else if (dest_ratio < (A2DP_AUDIO_SYNC_FACTOR_REFERENCE +
+                             A2DP_AUDIO_SYNC_FACTOR_SLOW_LIMIT)) {
+      dest_ratio =
+          A2DP_AUDIO_SYNC_FACTOR_REFERENCE + A2DP_AUDIO_SYNC_FACTOR_SLOW_LIMIT;
     }
+
 #if defined(IBRT)
-    if (!app_tws_ibrt_audio_sync_tune_onprocess() &&
-        !a2dp_audio_sync_tune_onprocess() &&
+    if ((!app_tws_ibrt_audio_sync_tune_onprocess() &&
+         !a2dp_audio_sync_tune_onprocess()) &&
 #else
     if (!a2dp_audio_sync_tune_onprocess() &&
 #endif
-
-        need_tune) {
-      if (a2dp_audio_context.output_cfg.factor_reference != dest_pid_result) {
-        a2dp_audio_sync_reset_data();
-        a2dp_audio_sync_tune(dest_pid_result);
-        TRACE_A2DP_DECODER_I("[SYNC] tune ratio force slow %d/%d->%d",
-                             lastframe_info->undecode_min_frames,
-                             lastframe_info->undecode_max_frames,
-                             a2dp_audio_context.dest_packet_mut);
+        audio_sync->tick != 1 &&
+        ABS(a2dp_audio_context.output_cfg.factor_reference - dest_ratio) >=
+            A2DP_AUDIO_SYNC_TUNE_STEP) {
+      if (!a2dp_audio_sync_tune(dest_ratio)) {
+        audio_sync->cnt = 0;
       }
+      TRACE_A2DP_DECODER_I(
+          "[SYNC] tune diff:%d/%d drift:%d ppb conf:%d%% tune:%10.9f",
+          (int32_t)(diff_mtu + 0.5f), a2dp_audio_context.dest_packet_mut,
+          (int32_t)(audio_sync->drift.drift_ppm * 1000),
+          (int32_t)(a2dp_audio_drift_confidence(&audio_sync->drift) * 100),
+          (double)dest_ratio);
     }
   }
   return 0;
@@ -1149,48 +1159,36 @@ bool is_cp_need_reset(void) { return false; }
 #endif
 
 #define A2DP_AUDIO_SYSFREQ_BOOST_RESUME_CNT (20)
-uint32_t a2dp_audio_sysfreq_cnt = UINT32_MAX;
-uint32_t a2dp_audio_sysfreq_dest_boost_cnt = 0;
-APP_SYSFREQ_FREQ_T a2dp_audio_sysfreq_normalfreq = APP_SYSFREQ_52M;
-
-int a2dp_audio_sysfreq_boost_init(uint32_t normalfreq) {
-  a2dp_audio_sysfreq_cnt = UINT32_MAX;
-  a2dp_audio_sysfreq_dest_boost_cnt = 0;
-  a2dp_audio_sysfreq_normalfreq = (APP_SYSFREQ_FREQ_T)normalfreq;
-  TRACE_A2DP_DECODER_I("[BOOST] freq:%d", normalfreq);
-  return 0;
+static uint32_t a2dp_audio_sysfreq_period_us = 0;
+
+// The playback handler is a voter of the sysfreq governor: its period is the
+// length of the buffer it fills, its budget the cycles it took to fill it.
+static void a2dp_audio_sysfreq_register(uint32_t period_us) {
+  if (period_us && period_us != a2dp_audio_sysfreq_period_us) {
+    a2dp_audio_sysfreq_period_us = period_us;
+    app_sysfreq_gov_register(APP_SYSFREQ_USER_BT_A2DP, period_us, 0);
+  }
 }
 
-int a2dp_audio_sysfreq_boost_start(uint32_t boost_cnt) {
-  enum APP_SYSFREQ_FREQ_T sysfreq = APP_SYSFREQ_104M;
+static uint32_t a2dp_audio_playback_period_us(uint32_t buffer_bytes) {
+  A2DP_AUDIO_OUTPUT_CONFIG_T *cfg = &a2dp_audio_context.output_cfg;
+  uint32_t frame_bytes =
+      cfg->num_channels * (cfg->bits_depth <= 16 ? sizeof(int16_t)
+                                                 : sizeof(int32_t));
 
-  a2dp_audio_sysfreq_cnt = 0;
-  a2dp_audio_sysfreq_dest_boost_cnt = boost_cnt;
-  if (a2dp_audio_sysfreq_normalfreq >= APP_SYSFREQ_52M) {
-    sysfreq = APP_SYSFREQ_104M;
-  } else {
-    sysfreq = APP_SYSFREQ_52M;
-  }
-  TRACE_A2DP_DECODER_I("[BOOST] freq:%d cnt:%d", sysfreq, boost_cnt);
-  app_sysfreq_req(APP_SYSFREQ_USER_BT_A2DP, sysfreq);
-  return 0;
+  if (frame_bytes == 0 || cfg->sample_rate == 0)
+    return 0;
+  return (uint64_t)(buffer_bytes / frame_bytes) * 1000000 / cfg->sample_rate;
 }
 
-static int a2dp_audio_sysfreq_boost_porc(void) {
-  if (a2dp_audio_sysfreq_cnt == UINT32_MAX) {
-    // do nothing
-  } else if (a2dp_audio_sysfreq_cnt >= a2dp_audio_sysfreq_dest_boost_cnt) {
-    a2dp_audio_sysfreq_cnt = UINT32_MAX;
-    TRACE_A2DP_DECODER_I("[BOOST] freq:%d", a2dp_audio_sysfreq_normalfreq);
-    app_sysfreq_req(APP_SYSFREQ_USER_BT_A2DP, a2dp_audio_sysfreq_normalfreq);
-  } else {
-    a2dp_audio_sysfreq_cnt++;
-  }
+int a2dp_audio_sysfreq_boost_start(uint32_t boost_cnt) {
+  TRACE_A2DP_DECODER_I("[BOOST] cnt:%d", boost_cnt);
+  app_sysfreq_gov_miss(APP_SYSFREQ_USER_BT_A2DP, boost_cnt);
   return 0;
 }
 
 int a2dp_audio_sysfreq_boost_running(void) {
-  return a2dp_audio_sysfreq_cnt == UINT32_MAX ? 0 : 1;
+  return app_sysfreq_gov_boosting(APP_SYSFREQ_USER_BT_A2DP) ? 1 : 0;
 }
 
 int a2dp_audio_store_packet_checker_start(void) {
@@ -1331,7 +1329,8 @@ uint32_t a2dp_audio_playback_handler(uint8_t *buffer, uint32_t buffer_bytes) {
   uint32_t len = buffer_bytes;
   int nRet = A2DP_DECODER_NO_ERROR;
   A2DP_AUDIO_LASTFRAME_INFO_T *lastframe_info = NULL;
-  list_t *list = a2dp_audio_context.audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context.audio_datapath.input_raw_packet_list;
+  uint32_t start_ticks = hal_fast_sys_timer_get();
 
   a2dp_audio_set_playback_status(A2DP_AUDIO_DECODER_PLAYBACK_STATUS_BUSY);
   if (a2dp_audio_get_status() != A2DP_AUDIO_DECODER_STATUS_START) {
@@ -1340,7 +1339,7 @@ uint32_t a2dp_audio_playback_handler(uint8_t *buffer, uint32_t buffer_bytes) {
     goto exit;
   }
 
-  a2dp_audio_sysfreq_boost_porc();
+  a2dp_audio_sysfreq_register(a2dp_audio_playback_period_us(buffer_bytes));
   if (a2dp_audio_context.average_packet_mut == 0) {
     A2DP_AUDIO_HEADFRAME_INFO_T headframe_info;
     a2dp_audio_decoder_headframe_info_get(&headframe_info);
@@ -1473,6 +1472,9 @@ uint32_t a2dp_audio_playback_handler(uint8_t *buffer, uint32_t buffer_bytes) {
         (uint32_t)(a2dp_audio_context.average_packet_mut + 0.5f);
   }
 exit:
+  app_sysfreq_gov_report(
+      APP_SYSFREQ_USER_BT_A2DP,
+      app_sysfreq_fast_ticks_to_cycles(hal_fast_sys_timer_get() - start_ticks));
   a2dp_audio_set_playback_status(A2DP_AUDIO_DECODER_PLAYBACK_STATUS_IDLE);
 #if defined(IBRT)
   if (nRet == A2DP_DECODER_CACHE_UNDERFLOW_ERROR) {
@@ -1505,14 +1507,6 @@ exit:
   return len;
 }
 
-static void a2dp_audio_packet_free(void *packet) {
-  if (a2dp_audio_context.audio_decoder.audio_decoder_packet_free) {
-    a2dp_audio_context.audio_decoder.audio_decoder_packet_free(packet);
-  } else {
-    a2dp_audio_heap_free(packet);
-  }
-}
-
 void a2dp_audio_clear_input_raw_packet_list(void) {
   // just clean the packet list to start receive ai data again
   if (a2dp_audio_context.audio_datapath.input_raw_packet_list)
@@ -1535,7 +1529,11 @@ int a2dp_audio_init(uint32_t sysfreq, A2DP_AUDIO_CODEC_TYPE codec_type,
                        config->sample_rate, config->num_channels,
                        config->bits_depth, config->frame_samples,
                        dest_packet_mut);
-  a2dp_audio_sysfreq_boost_init(sysfreq);
+  a2dp_audio_sysfreq_period_us = 0;
+  if (config->sample_rate) {
+    a2dp_audio_sysfreq_register((uint64_t)config->frame_samples * 1000000 /
+                                config->sample_rate);
+  }
   a2dp_audio_sysfreq_boost_start(A2DP_AUDIO_SYSFREQ_BOOST_RESUME_CNT);
   a2dp_audio_semaphore_init();
   a2dp_audio_buffer_mutex_init();
@@ -1560,14 +1558,13 @@ int a2dp_audio_init(uint32_t sysfreq, A2DP_AUDIO_CODEC_TYPE codec_type,
 
   memset(&a2dp_audio_lastframe_info, 0, sizeof(A2DP_AUDIO_LASTFRAME_INFO_T));
 
-  a2dp_audio_context.audio_datapath.input_raw_packet_list = a2dp_audio_list_new(
-      a2dp_audio_packet_free, (list_mempool_zmalloc)a2dp_audio_heap_cmalloc,
-      (list_mempool_free)a2dp_audio_heap_free);
+  a2dp_audio_list_init(&a2dp_audio_input_raw_packets);
+  a2dp_audio_context.audio_datapath.input_raw_packet_list =
+      &a2dp_audio_input_raw_packets;
 
+  a2dp_audio_list_init(&a2dp_audio_output_pcm_packets);
   a2dp_audio_context.audio_datapath.output_pcm_packet_list =
-      a2dp_audio_list_new(a2dp_audio_packet_free,
-                          (list_mempool_zmalloc)a2dp_audio_heap_cmalloc,
-                          (list_mempool_free)a2dp_audio_heap_free);
+      &a2dp_audio_output_pcm_packets;
 
   memcpy(&(a2dp_audio_context.output_cfg), config,
          sizeof(A2DP_AUDIO_OUTPUT_CONFIG_T));
@@ -1666,24 +1663,26 @@ int a2dp_audio_init(uint32_t sysfreq, A2DP_AUDIO_CODEC_TYPE codec_type,
 int a2dp_audio_deinit(void) {
   TRACE_A2DP_DECODER_I("[DEINIT]");
 
+  app_sysfreq_gov_unregister(APP_SYSFREQ_USER_BT_A2DP);
+  a2dp_audio_sysfreq_period_us = 0;
+
   a2dp_audio_status_mutex_lock();
 
   a2dp_audio_detect_next_packet_callback_register(NULL);
   a2dp_audio_detect_store_packet_callback_register(NULL);
 
-  a2dp_audio_context.audio_decoder.audio_decoder_deinit();
-  memset(&(a2dp_audio_context.audio_decoder), 0, sizeof(A2DP_AUDIO_DECODER_T));
-  memset(&(a2dp_audio_context.output_cfg), 0,
-         sizeof(A2DP_AUDIO_OUTPUT_CONFIG_T));
+  // Packets go back through the decoder's own free callback while its packet
+  // slab still exists.
   a2dp_audio_list_clear(
       a2dp_audio_context.audio_datapath.input_raw_packet_list);
-  a2dp_audio_list_free(a2dp_audio_context.audio_datapath.input_raw_packet_list);
   a2dp_audio_context.audio_datapath.input_raw_packet_list = NULL;
   a2dp_audio_list_clear(
       a2dp_audio_context.audio_datapath.output_pcm_packet_list);
-  a2dp_audio_list_free(
-      a2dp_audio_context.audio_datapath.output_pcm_packet_list);
   a2dp_audio_context.audio_datapath.output_pcm_packet_list = NULL;
+  a2dp_audio_context.audio_decoder.audio_decoder_deinit();
+  memset(&(a2dp_audio_context.audio_decoder), 0, sizeof(A2DP_AUDIO_DECODER_T));
+  memset(&(a2dp_audio_context.output_cfg), 0,
+         sizeof(A2DP_AUDIO_OUTPUT_CONFIG_T));
 
   size_t total = 0, used = 0, max_used = 0;
   a2dp_audio_heap_info(&total, &used, &max_used);
@@ -89,14 +89,6 @@ typedef struct {
     uint16_t totalSubSequenceNumber;
 } A2DP_AUDIO_HEADFRAME_INFO_T;
 
-typedef struct{          
-    float proportiongain;     
-    float integralgain;       
-    float derivativegain;  
-    float error[3];
-    float result;
-}A2DP_AUDIO_SYNC_PID_T;
-
 typedef A2DP_AUDIO_LASTFRAME_INFO_T A2DP_AUDIO_SYNCFRAME_INFO_T;
 
 typedef int(*A2DP_AUDIO_DETECT_NEXT_PACKET_CALLBACK)(btif_media_header_t *, unsigned char *, unsigned int len);
@@ -106,7 +98,6 @@ extern "C" {
 #endif
 
 uint32_t a2dp_audio_playback_handler(uint8_t *buffer, uint32_t buffer_bytes);
-float a2dp_audio_sync_pid_calc(A2DP_AUDIO_SYNC_PID_T *pid, float diff);
 int a2dp_audio_sync_init(double ratio);
 int a2dp_audio_sync_reset_data(void);
 int a2dp_audio_sync_tune_sample_rate(double ratio);
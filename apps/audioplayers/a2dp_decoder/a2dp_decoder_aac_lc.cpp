@@ -41,14 +41,17 @@
 #define AAC_MEMPOOL_SIZE (40596)
 
 typedef struct {
+  ilist_node_t node;
   uint16_t sequenceNumber;
   uint32_t timestamp;
   uint8_t *aac_buffer;
   uint32_t aac_buffer_len;
+  uint32_t aac_buffer_size;
 } a2dp_audio_aac_decoder_frame_t;
 
 int a2dp_audio_aac_lc_reorder_init(void);
 int a2dp_audio_aac_lc_reorder_deinit(void);
+extern uint16_t bt_sbc_player_get_max_frame_bytes(void);
 
 static A2DP_AUDIO_CONTEXT_T *a2dp_audio_context_p = NULL;
 
@@ -66,24 +69,30 @@ static a2dp_audio_aac_decoder_frame_t aac_decoder_last_valid_frame = {
 };
 static bool aac_decoder_last_valid_frame_ready = false;
 
+// One slot holds a frame header immediately followed by its read buffer,
+// sized at init from the configured bitrate. The list stays below
+// aac_mtu_limiter packets, leaving one slot for the packet parked for
+// reorder. Packets larger than a slot come from the a2dp heap.
+static slab_t aac_frame_slab;
+static uint32_t aac_slab_frame_bytes = AAC_READBUF_SIZE;
+
 static void *a2dp_audio_aac_lc_frame_malloc(uint32_t packet_len) {
   a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
-  uint8_t *aac_buffer = NULL;
+  uint32_t size = aac_slab_frame_bytes;
 
-  aac_buffer = (uint8_t *)a2dp_audio_heap_malloc(AAC_READBUF_SIZE);
+  if (packet_len > size)
+    size = AAC_READBUF_SIZE;
   aac_decoder_frame_p =
-      (a2dp_audio_aac_decoder_frame_t *)a2dp_audio_heap_malloc(
-          sizeof(a2dp_audio_aac_decoder_frame_t));
-  aac_decoder_frame_p->aac_buffer = aac_buffer;
+      (a2dp_audio_aac_decoder_frame_t *)a2dp_audio_slab_malloc(
+          &aac_frame_slab, sizeof(a2dp_audio_aac_decoder_frame_t) + size);
+  aac_decoder_frame_p->aac_buffer = (uint8_t *)(aac_decoder_frame_p + 1);
   aac_decoder_frame_p->aac_buffer_len = packet_len;
+  aac_decoder_frame_p->aac_buffer_size = size;
   return (void *)aac_decoder_frame_p;
 }
 
 static void a2dp_audio_aac_lc_free(void *packet) {
-  a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p =
-      (a2dp_audio_aac_decoder_frame_t *)packet;
-  a2dp_audio_heap_free(aac_decoder_frame_p->aac_buffer);
-  a2dp_audio_heap_free(aac_decoder_frame_p);
+  a2dp_audio_slab_free(&aac_frame_slab, packet);
 }
 
 static void a2dp_audio_aac_lc_decoder_init(void) {
@@ -144,8 +153,8 @@ static int TEXT_AAC_LOC a2dp_cp_aac_lc_after_cache_underflow(void) {
 
 static int a2dp_cp_aac_lc_mcu_decode(uint8_t *buffer, uint32_t buffer_bytes) {
   a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
-  list_node_t *node = NULL;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int ret, dec_ret;
   struct A2DP_CP_AAC_LC_IN_FRM_INFO_T in_info;
   struct A2DP_CP_AAC_LC_OUT_FRM_INFO_T *p_out_info;
@@ -445,8 +454,8 @@ int a2dp_cp_aac_lc_cp_decode(void) {
 #endif
 
 static int a2dp_audio_aac_lc_list_checker(void) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
   int cnt = 0;
 
@@ -516,6 +525,14 @@ int a2dp_audio_aac_lc_init(A2DP_AUDIO_OUTPUT_CONFIG_T *config, void *context) {
   aac_mempoll = (uint8_t *)a2dp_audio_heap_malloc(AAC_MEMPOOL_SIZE);
   ASSERT_A2DP_DECODER(aac_mempoll, "aac_mempoll = NULL");
   aac_memhandle = heap_register(aac_mempoll, AAC_MEMPOOL_SIZE);
+  aac_slab_frame_bytes = bt_sbc_player_get_max_frame_bytes();
+  if (aac_slab_frame_bytes == 0 || aac_slab_frame_bytes > AAC_READBUF_SIZE)
+    aac_slab_frame_bytes = AAC_READBUF_SIZE;
+  TRACE_A2DP_DECODER_I("[AAC][INIT] slab frame:%d", aac_slab_frame_bytes);
+  a2dp_audio_slab_init(&aac_frame_slab,
+                       sizeof(a2dp_audio_aac_decoder_frame_t) +
+                           aac_slab_frame_bytes,
+                       aac_mtu_limiter);
 
 #ifdef A2DP_CP_ACCEL
   int ret;
@@ -544,6 +561,7 @@ int a2dp_audio_aac_lc_deinit(void) {
   size_t total = 0, used = 0, max_used = 0;
   heap_memory_info(aac_memhandle, &total, &used, &max_used);
   a2dp_audio_heap_free(aac_mempoll);
+  a2dp_audio_slab_deinit(&aac_frame_slab);
   TRACE_A2DP_DECODER_I(
       "[AAC] deinit MEM: total - %d, used - %d, max_used - %d.", total, used,
       max_used);
@@ -552,8 +570,8 @@ int a2dp_audio_aac_lc_deinit(void) {
 }
 
 int a2dp_audio_aac_lc_mcu_decode_frame(uint8_t *buffer, uint32_t buffer_bytes) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
 
   UINT bufferSize = 0, bytesValid = 0;
@@ -728,7 +746,8 @@ int a2dp_audio_aac_lc_reorder_proc(
     a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p,
     btif_media_header_t *header, uint8_t *buffer, uint32_t buffer_bytes) {
   uint8_t *dest_buf = NULL;
-  if ((aac_decoder_frame_p->aac_buffer_len + buffer_bytes) > AAC_READBUF_SIZE) {
+  if ((aac_decoder_frame_p->aac_buffer_len + buffer_bytes) >
+      aac_decoder_frame_p->aac_buffer_size) {
     return A2DP_DECODER_NO_ERROR;
   }
   TRACE_A2DP_DECODER_W("[AAC][INPUT][REORDER] proc enter seq:%d len:%d",
@@ -805,7 +824,7 @@ int a2dp_audio_aac_lc_packet_recover_find_missing(
 
 int a2dp_audio_aac_lc_packet_recover_proc(
     a2dp_audio_aac_decoder_frame_t *aac_decoder_frame) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int missing_pkt_cnt = 0;
   missing_pkt_cnt =
       a2dp_audio_aac_lc_packet_recover_find_missing(aac_decoder_frame);
@@ -829,7 +848,7 @@ int a2dp_audio_aac_lc_packet_recover_proc(
 
 int inline a2dp_audio_aac_lc_packet_append(
     a2dp_audio_aac_decoder_frame_t *aac_decoder_frame) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   a2dp_audio_aac_lc_packet_recover_proc(aac_decoder_frame);
   a2dp_audio_aac_lc_packet_recover_save_last(aac_decoder_frame);
   a2dp_audio_list_append(list, aac_decoder_frame);
@@ -839,7 +858,7 @@ int inline a2dp_audio_aac_lc_packet_append(
 #if 1
 int a2dp_audio_aac_lc_store_packet(btif_media_header_t *header, uint8_t *buffer,
                                    uint32_t buffer_bytes) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int nRet = A2DP_DECODER_NO_ERROR;
   a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
 
@@ -885,7 +904,7 @@ int a2dp_audio_aac_lc_store_packet(btif_media_header_t *header, uint8_t *buffer,
 #else
 int a2dp_audio_aac_lc_store_packet(btif_media_header_t *header, uint8_t *buffer,
                                    uint32_t buffer_bytes) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int nRet = A2DP_DECODER_NO_ERROR;
 
   if (!a2dp_audio_aac_lc_reorder_valid(header, buffer, buffer_bytes)) {
@@ -919,8 +938,8 @@ int a2dp_audio_aac_lc_store_packet(btif_media_header_t *header, uint8_t *buffer,
 
 int a2dp_audio_aac_lc_discards_packet(uint32_t packets) {
   int nRet = A2DP_DECODER_MEMORY_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
 
 #ifdef A2DP_CP_ACCEL
@@ -944,8 +963,8 @@ int a2dp_audio_aac_lc_discards_packet(uint32_t packets) {
 
 int a2dp_audio_aac_lc_headframe_info_get(
     A2DP_AUDIO_HEADFRAME_INFO_T *headframe_info) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_aac_decoder_frame_t *aac_decoder_frame = NULL;
 
   if (a2dp_audio_list_length(list) &&
@@ -968,8 +987,8 @@ int a2dp_audio_aac_lc_info_get(void *info) { return A2DP_DECODER_NO_ERROR; }
 int a2dp_audio_aac_lc_synchronize_packet(A2DP_AUDIO_SYNCFRAME_INFO_T *sync_info,
                                          uint32_t mask) {
   int nRet = A2DP_DECODER_SYNC_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   int list_len;
   a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
 
@@ -1016,9 +1035,9 @@ int a2dp_audio_aac_lc_synchronize_packet(A2DP_AUDIO_SYNCFRAME_INFO_T *sync_info,
 }
 
 int a2dp_audio_aac_lc_synchronize_dest_packet_mut(uint16_t packet_mut) {
-  list_node_t *node = NULL;
+  ilist_node_t *node = NULL;
   uint32_t list_len = 0;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
 
   list_len = a2dp_audio_list_length(list);
@@ -1047,7 +1066,7 @@ int a2dp_audio_aac_lc_synchronize_dest_packet_mut(uint16_t packet_mut) {
 
 int a2dp_audio_aac_lc_convert_list_to_samples(uint32_t *samples) {
   uint32_t list_len = 0;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
 
   list_len = a2dp_audio_list_length(list);
   *samples = AAC_OUTPUT_FRAME_SAMPLES * list_len;
@@ -1060,9 +1079,9 @@ int a2dp_audio_aac_lc_convert_list_to_samples(uint32_t *samples) {
 
 int a2dp_audio_aac_lc_discards_samples(uint32_t samples) {
   int nRet = A2DP_DECODER_SYNC_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
-  list_node_t *node = NULL;
+  ilist_node_t *node = NULL;
   int need_remove_list = 0;
   uint32_t list_samples = 0;
   ASSERT_A2DP_DECODER(!(samples % AAC_OUTPUT_FRAME_SAMPLES),
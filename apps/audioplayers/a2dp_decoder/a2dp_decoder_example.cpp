@@ -26,6 +26,7 @@ static A2DP_AUDIO_DECODER_LASTFRAME_INFO_T a2dp_audio_ldac_example_info;
 static A2DP_AUDIO_OUTPUT_CONFIG_T a2dp_audio_example_output_config;
 
 typedef struct {
+  ilist_node_t node;
   uint16_t sequenceNumber;
   uint32_t timestamp;
   uint8_t *buffer;
@@ -63,7 +64,7 @@ void a2dp_audio_example_free(void *packet) {
 
 int a2dp_audio_example_store_packet(btif_media_header_t *header,
                                     uint8_t *buffer, uint32_t buffer_bytes) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   a2dp_audio_example_decoder_frame_t *decoder_frame_p =
       (a2dp_audio_example_decoder_frame_t *)a2dp_audio_example_frame_malloc(
           buffer_bytes);
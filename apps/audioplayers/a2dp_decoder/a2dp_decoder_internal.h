@@ -16,8 +16,11 @@
 #ifndef __A2DP_DECODER_INTERNAL_H__
 #define __A2DP_DECODER_INTERNAL_H__
 
+#include "ilist.h"
 #include "list.h"
+#include "slab_api.h"
 #include "a2dp_decoder.h"
+#include "a2dp_audio_drift.h"
 #ifdef A2DP_CP_ACCEL
 #include "a2dp_decoder_cp.h"
 #include "hal_location.h"
@@ -87,9 +90,10 @@ typedef struct {
     AUDIO_DECODER_CHANNEL_SELECT audio_decoder_channel_select;
 } A2DP_AUDIO_DECODER_T;
 
+// Every packet queued on these lists starts with an ilist_node_t.
 typedef struct {    
-    list_t *input_raw_packet_list;
-    list_t *output_pcm_packet_list;
+    ilist_t *input_raw_packet_list;
+    ilist_t *output_pcm_packet_list;
 } A2DP_AUDIO_DATAPATH_T;
 
 typedef struct {    
@@ -128,7 +132,8 @@ typedef struct {
 } A2DP_AUDIO_DECODER_LASTFRAME_INFO_T;
 
 typedef struct {
-    A2DP_AUDIO_SYNC_PID_T pid;
+    A2DP_AUDIO_DRIFT_T drift;
+    uint32_t play_samples;
     uint32_t tick;
     uint32_t cnt;
 } A2DP_AUDIO_SYNC_T;
@@ -176,16 +181,27 @@ void *a2dp_audio_heap_cmalloc(uint32_t size);
 void *a2dp_audio_heap_realloc(void *rmem, uint32_t newsize);
 void a2dp_audio_heap_free(void *rmem);
 
-list_node_t *a2dp_audio_list_begin(const list_t *list);
-list_node_t *a2dp_audio_list_end(const list_t *list);
-uint32_t a2dp_audio_list_length(const list_t *list);
-void *a2dp_audio_list_node(const list_node_t *node);
-list_node_t *a2dp_audio_list_next(const list_node_t *node);
-bool a2dp_audio_list_remove(list_t *list, void *data);
-bool a2dp_audio_list_append(list_t *list, void *data);
-void a2dp_audio_list_clear(list_t *list);
-void a2dp_audio_list_free(list_t *list);
-list_t *a2dp_audio_list_new(list_free_cb callback, list_mempool_zmalloc zmalloc, list_mempool_free free);
+// Fixed-size packet slots carved from the a2dp heap. Requests larger than a
+// slot, or made while the slab is empty, fall back to a2dp_audio_heap_malloc().
+void a2dp_audio_slab_init(slab_t *slab, uint32_t obj_size, uint32_t count);
+void a2dp_audio_slab_deinit(slab_t *slab);
+void *a2dp_audio_slab_malloc(slab_t *slab, uint32_t size);
+void a2dp_audio_slab_free(slab_t *slab, void *rmem);
+
+ilist_node_t *a2dp_audio_list_begin(const ilist_t *list);
+ilist_node_t *a2dp_audio_list_end(const ilist_t *list);
+uint32_t a2dp_audio_list_length(const ilist_t *list);
+void *a2dp_audio_list_node(const ilist_node_t *node);
+ilist_node_t *a2dp_audio_list_next(const ilist_node_t *node);
+// Unlinks |data| in O(1) and releases it through the decoder's packet free.
+bool a2dp_audio_list_remove(ilist_t *list, void *data);
+bool a2dp_audio_list_append(ilist_t *list, void *data);
+// Appends all of |packets| under one lock, leaving it empty.
+void a2dp_audio_list_splice(ilist_t *list, ilist_t *packets);
+// Releases the first |packets| packets; returns how many were released.
+uint32_t a2dp_audio_list_discard(ilist_t *list, uint32_t packets);
+void a2dp_audio_list_clear(ilist_t *list);
+void a2dp_audio_list_init(ilist_t *list);
 
 int a2dp_audio_semaphore_wait(uint32_t timeout_ms);
 int a2dp_audio_semaphore_release(void);
@@ -24,6 +24,7 @@
 #include <string.h>
 
 typedef struct {
+  ilist_node_t node;
   uint16_t sequenceNumber;
   uint32_t timestamp;
   uint32_t frame_samples;
@@ -265,8 +266,8 @@ static int a2dp_cp_ldac_after_cache_underflow(void) {
 
 static int a2dp_cp_ldac_mcu_decode(uint8_t *buffer, uint32_t buffer_bytes) {
   a2dp_audio_ldac_decoder_frame_t *ldac_decoder_frame_p = NULL;
-  list_node_t *node = NULL;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int ret, dec_ret;
   struct A2DP_CP_LDAC_IN_FRM_INFO_T in_info;
   struct A2DP_CP_LDAC_OUT_FRM_INFO_T *p_out_info;
@@ -508,7 +509,7 @@ int a2dp_cp_ldac_cp_decode(void) {
 
 int a2dp_audio_ldac_mcu_decode_frame(uint8_t *buffer, uint32_t buffer_bytes) {
 
-  list_node_t *node = NULL;
+  ilist_node_t *node = NULL;
   uint8_t *temp_buf_ptr1 = NULL;
   uint8_t *temp_buf_ptr2 = NULL;
   uint16_t pcm_output_bytes;
@@ -534,7 +535,7 @@ int a2dp_audio_ldac_mcu_decode_frame(uint8_t *buffer, uint32_t buffer_bytes) {
     return A2DP_DECODER_NO_ERROR;
   }
 
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
 
   // TRACE("jtx~~");
 
@@ -691,7 +692,7 @@ int a2dp_audio_ldac_store_packet(btif_media_header_t *header, uint8_t *buffer,
 
   buffer++;
   buffer_bytes--;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
 
   // TRACE("buffer:%x %x %x %x %x %x
   // %x",buffer[0],buffer[1],buffer[2],buffer[3],buffer[4],buffer[5],buffer[6]);
@@ -776,8 +777,8 @@ int a2dp_audio_ldac_store_packet(btif_media_header_t *header, uint8_t *buffer,
 
 int a2dp_audio_ldac_discards_packet(uint32_t packets) {
   int nRet = A2DP_DECODER_MEMORY_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_ldac_decoder_frame_t *ldac_decoder_frame_p = NULL;
 #ifdef A2DP_CP_ACCEL
   a2dp_cp_reset_frame();
@@ -836,8 +837,8 @@ static void a2dp_audio_ldac_decoder_deinit(void) {
 static int a2dp_audio_ldac_list_checker(void) {
 
   // return 0;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_ldac_decoder_frame_t *ldac_decoder_frame_p = NULL;
   int cnt = 0;
 
@@ -906,8 +907,8 @@ int a2dp_audio_ldac_deinit(void) {
 int a2dp_audio_ldac_synchronize_packet(A2DP_AUDIO_SYNCFRAME_INFO_T *sync_info,
                                        uint32_t mask) {
   int nRet = A2DP_DECODER_SYNC_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   int list_len;
   a2dp_audio_ldac_decoder_frame_t *ldac_decoder_frame_p = NULL;
 
@@ -956,9 +957,9 @@ int a2dp_audio_ldac_synchronize_packet(A2DP_AUDIO_SYNCFRAME_INFO_T *sync_info,
 }
 
 int a2dp_audio_ldac_synchronize_dest_packet_mut(uint16_t packet_mut) {
-  list_node_t *node = NULL;
+  ilist_node_t *node = NULL;
   uint32_t list_len = 0;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   a2dp_audio_ldac_decoder_frame_t *ldac_decoder_frame_p = NULL;
 
   list_len = a2dp_audio_list_length(list);
@@ -977,8 +978,8 @@ int a2dp_audio_ldac_synchronize_dest_packet_mut(uint16_t packet_mut) {
 
 static int a2dp_audio_ldac_headframe_info_get(
     A2DP_AUDIO_HEADFRAME_INFO_T *headframe_info) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_ldac_decoder_frame_t *decoder_frame_p = NULL;
 
   if (a2dp_audio_list_length(list)) {
@@ -1000,7 +1001,7 @@ static int a2dp_audio_ldac_headframe_info_get(
 
 int a2dp_audio_ldac_convert_list_to_samples(uint32_t *samples) {
   uint32_t list_len = 0;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
 
   list_len = a2dp_audio_list_length(list);
   *samples = LDAC_LIST_SAMPLES * list_len;
@@ -1012,9 +1013,9 @@ int a2dp_audio_ldac_convert_list_to_samples(uint32_t *samples) {
 
 int a2dp_audio_ldac_discards_samples(uint32_t samples) {
   int nRet = A2DP_DECODER_SYNC_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   a2dp_audio_ldac_decoder_frame_t *ldac_decoder_frame = NULL;
-  list_node_t *node = NULL;
+  ilist_node_t *node = NULL;
   int need_remove_list = 0;
   uint32_t list_samples = 0;
   ASSERT(!(samples % LDAC_LIST_SAMPLES), "%s samples err:%d", __func__,
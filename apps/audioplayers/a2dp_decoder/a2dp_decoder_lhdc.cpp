@@ -23,6 +23,7 @@
 #include <string.h>
 
 typedef struct {
+  ilist_node_t node;
   uint16_t sequenceNumber;
   uint32_t timestamp;
   uint16_t curSubSequenceNumber;
@@ -412,8 +413,8 @@ static int a2dp_cp_lhdc_after_cache_underflow(void) {
 // uint32_t demoTimer = 0;
 static int a2dp_cp_lhdc_mcu_decode(uint8_t *buffer, uint32_t buffer_bytes) {
   a2dp_audio_lhdc_decoder_frame_t *lhdc_decoder_frame_p = NULL;
-  list_node_t *node = NULL;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int ret, dec_ret;
   struct A2DP_CP_LHDC_IN_FRM_INFO_T in_info;
   struct A2DP_CP_LHDC_OUT_FRM_INFO_T *p_out_info;
@@ -762,8 +763,8 @@ int a2dp_cp_lhdc_cp_decode(void) {
 
 #if 1
 static int a2dp_audio_lhdc_list_checker(void) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_lhdc_decoder_frame_t *lhdc_decoder_frame_p = NULL;
   int cnt = 0;
 
@@ -794,8 +795,8 @@ static int a2dp_audio_lhdc_list_checker(void) {
 #endif
 
 int a2dp_audio_lhdc_mcu_decode_frame(uint8_t *buffer, uint32_t buffer_bytes) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_lhdc_decoder_frame_t *lhdc_decoder_frame_p = NULL;
 
   bool cache_underflow = false;
@@ -916,7 +917,7 @@ void a2dp_audio_lhdc_free(void *packet) {
 
 int a2dp_audio_lhdc_store_packet(btif_media_header_t *header, uint8_t *buffer,
                                  uint32_t buffer_bytes) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int nRet = A2DP_DECODER_NO_ERROR;
   uint32_t frame_num = 0;
   uint32_t frame_cnt = 0;
@@ -1006,8 +1007,8 @@ int a2dp_audio_lhdc_discards_packet(uint32_t packets) {
 
 static int a2dp_audio_lhdc_headframe_info_get(
     A2DP_AUDIO_HEADFRAME_INFO_T *headframe_info) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_lhdc_decoder_frame_t *decoder_frame_p = NULL;
 
   if (a2dp_audio_list_length(list)) {
@@ -1090,8 +1091,8 @@ int a2dp_audio_lhdc_deinit(void) {
 int a2dp_audio_lhdc_synchronize_packet(A2DP_AUDIO_SYNCFRAME_INFO_T *sync_info,
                                        uint32_t mask) {
   int nRet = A2DP_DECODER_SYNC_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   int list_len;
   a2dp_audio_lhdc_decoder_frame_t *lhdc_decoder_frame;
 
@@ -1137,9 +1138,9 @@ int a2dp_audio_lhdc_synchronize_packet(A2DP_AUDIO_SYNCFRAME_INFO_T *sync_info,
 }
 
 int a2dp_audio_lhdc_synchronize_dest_packet_mut(uint16_t packet_mut) {
-  list_node_t *node = NULL;
+  ilist_node_t *node = NULL;
   uint32_t list_len = 0;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   a2dp_audio_lhdc_decoder_frame_t *lhdc_decoder_frame_p = NULL;
 
   list_len = a2dp_audio_list_length(list);
@@ -1158,7 +1159,7 @@ int a2dp_audio_lhdc_synchronize_dest_packet_mut(uint16_t packet_mut) {
 
 int a2dp_audio_lhdc_convert_list_to_samples(uint32_t *samples) {
   uint32_t list_len = 0;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
 
   list_len = a2dp_audio_list_length(list);
 
@@ -1171,9 +1172,9 @@ int a2dp_audio_lhdc_convert_list_to_samples(uint32_t *samples) {
 
 int a2dp_audio_lhdc_discards_samples(uint32_t samples) {
   int nRet = A2DP_DECODER_SYNC_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   a2dp_audio_lhdc_decoder_frame_t *lhdc_decoder_frame_p = NULL;
-  list_node_t *node = NULL;
+  ilist_node_t *node = NULL;
   int need_remove_list = 0;
   uint32_t list_samples = 0;
 
@@ -33,8 +33,24 @@
 
 #define SBC_LIST_SAMPLES (128)
 
+// Payload bytes of one packet slab slot when the stream's SBC configuration
+// is not known. 128 covers joint-stereo bitpool 53 (119 bytes), the highest
+// A2DP-recommended SBC setting; larger frames are still accepted but come
+// from the a2dp heap.
+#ifndef SBC_SLAB_FRAME_BYTES
+#define SBC_SLAB_FRAME_BYTES (128)
+#endif
+
+// Upper bound on the packet slab. Slots are sized from the configured
+// maximum bitpool, so a high-bitpool stream gets fewer of them rather than
+// a larger share of the a2dp heap than the default setting takes.
+#ifndef SBC_SLAB_BUDGET_BYTES
+#define SBC_SLAB_BUDGET_BYTES (32 * 1024)
+#endif
+
 static A2DP_AUDIO_CONTEXT_T *a2dp_audio_context_p = NULL;
 extern A2DP_AUDIO_DECODER_T a2dp_audio_sbc_decoder_config;
+extern uint16_t bt_sbc_player_get_max_frame_bytes(void);
 
 typedef struct {
   btif_sbc_decoder_t *sbc_decoder;
@@ -42,6 +58,7 @@ typedef struct {
 } a2dp_audio_sbc_decoder_t;
 
 typedef struct {
+  ilist_node_t node;
   uint16_t sequenceNumber;
   uint32_t timestamp;
   uint16_t curSubSequenceNumber;
@@ -57,6 +74,9 @@ static A2DP_AUDIO_DECODER_LASTFRAME_INFO_T a2dp_audio_sbc_lastframe_info;
 
 static uint16_t sbc_mtu_limiter = SBC_MTU_LIMITER;
 
+// One slot holds a frame header immediately followed by its SBC payload.
+static slab_t sbc_frame_slab;
+
 static btif_media_header_t sbc_decoder_last_valid_frame = {
     0,
 };
@@ -67,22 +87,17 @@ static int a2dp_audio_sbc_header_parser_init(void);
 
 static void *a2dp_audio_sbc_subframe_malloc(uint32_t sbc_len) {
   a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame_p = NULL;
-  uint8_t *sbc_buffer = NULL;
 
-  sbc_buffer = (uint8_t *)a2dp_audio_heap_malloc(sbc_len);
   sbc_decoder_frame_p =
-      (a2dp_audio_sbc_decoder_frame_t *)a2dp_audio_heap_malloc(
-          sizeof(a2dp_audio_sbc_decoder_frame_t));
-  sbc_decoder_frame_p->sbc_buffer = sbc_buffer;
+      (a2dp_audio_sbc_decoder_frame_t *)a2dp_audio_slab_malloc(
+          &sbc_frame_slab, sizeof(a2dp_audio_sbc_decoder_frame_t) + sbc_len);
+  sbc_decoder_frame_p->sbc_buffer = (uint8_t *)(sbc_decoder_frame_p + 1);
   sbc_decoder_frame_p->sbc_buffer_len = sbc_len;
   return (void *)sbc_decoder_frame_p;
 }
 
 static void a2dp_audio_sbc_subframe_free(void *packet) {
-  a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame_p =
-      (a2dp_audio_sbc_decoder_frame_t *)packet;
-  a2dp_audio_heap_free(sbc_decoder_frame_p->sbc_buffer);
-  a2dp_audio_heap_free(sbc_decoder_frame_p);
+  a2dp_audio_slab_free(&sbc_frame_slab, packet);
 }
 
 static void sbc_codec_init(void) {
@@ -125,8 +140,8 @@ static int TEXT_SBC_LOC a2dp_cp_sbc_after_cache_underflow(void) {
 
 static int a2dp_cp_sbc_mcu_decode(uint8_t *buffer, uint32_t buffer_bytes) {
   a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame = NULL;
-  list_node_t *node = NULL;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int ret, dec_ret;
   struct A2DP_CP_SBC_IN_FRM_INFO_T in_info;
   struct A2DP_CP_SBC_OUT_FRM_INFO_T *p_out_info = NULL;
@@ -373,8 +388,7 @@ int a2dp_cp_sbc_cp_decode(void) {
 #endif
 
 static int a2dp_audio_sbc_list_checker(void) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame = NULL;
   int cnt = 0;
 
@@ -388,14 +402,7 @@ static int a2dp_audio_sbc_list_checker(void) {
     cnt++;
   } while (sbc_decoder_frame && cnt < SBC_MTU_LIMITER);
 
-  do {
-    node = a2dp_audio_list_begin(list);
-    if (node) {
-      sbc_decoder_frame =
-          (a2dp_audio_sbc_decoder_frame_t *)a2dp_audio_list_node(node);
-      a2dp_audio_list_remove(list, sbc_decoder_frame);
-    }
-  } while (node);
+  a2dp_audio_list_clear(list);
 
   TRACE_A2DP_DECODER_I("[SBC][INIT] cnt:%d list:%d", cnt,
                        a2dp_audio_list_length(list));
@@ -404,6 +411,8 @@ static int a2dp_audio_sbc_list_checker(void) {
 }
 
 int a2dp_audio_sbc_init(A2DP_AUDIO_OUTPUT_CONFIG_T *config, void *context) {
+  uint32_t slab_frame_bytes, slab_obj_size, slab_count;
+
   TRACE_A2DP_DECODER_I("[SBC][INIT]");
 
   a2dp_audio_context_p = (A2DP_AUDIO_CONTEXT_T *)context;
@@ -428,6 +437,16 @@ int a2dp_audio_sbc_init(A2DP_AUDIO_OUTPUT_CONFIG_T *config, void *context) {
           sizeof(btif_sbc_pcm_data_t));
   a2dp_audio_sbc_decoder_preparse =
       (btif_sbc_decoder_t *)a2dp_audio_heap_malloc(sizeof(btif_sbc_decoder_t));
+  slab_frame_bytes = bt_sbc_player_get_max_frame_bytes();
+  if (slab_frame_bytes == 0)
+    slab_frame_bytes = SBC_SLAB_FRAME_BYTES;
+  slab_obj_size = sizeof(a2dp_audio_sbc_decoder_frame_t) + slab_frame_bytes;
+  slab_count = SBC_SLAB_BUDGET_BYTES / slab_obj_size;
+  if (slab_count > sbc_mtu_limiter)
+    slab_count = sbc_mtu_limiter;
+  TRACE_A2DP_DECODER_I("[SBC][INIT] slab frame:%d count:%d", slab_frame_bytes,
+                       slab_count);
+  a2dp_audio_slab_init(&sbc_frame_slab, slab_obj_size, slab_count);
 #ifdef A2DP_CP_ACCEL
   int ret;
   cp_codec_reset = true;
@@ -449,6 +468,7 @@ int a2dp_audio_sbc_deinit(void) {
   a2dp_audio_heap_free(a2dp_audio_sbc_decoder_preparse);
   a2dp_audio_heap_free(a2dp_audio_sbc_decoder.sbc_decoder);
   a2dp_audio_heap_free(a2dp_audio_sbc_decoder.pcm_data);
+  a2dp_audio_slab_deinit(&sbc_frame_slab);
 
   TRACE_A2DP_DECODER_I("[SBC][DEINIT]");
 
@@ -470,9 +490,9 @@ int a2dp_audio_sbc_mcu_decode_frame(uint8_t *buffer, uint32_t buffer_bytes) {
   frame_pcmbyte = sbc_decoder->maxPcmLen;
 
   a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame = NULL;
-  list_node_t *node = NULL;
+  ilist_node_t *node = NULL;
 
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
 
   pcm_data->data = buffer;
   pcm_data->dataLen = 0;
@@ -707,7 +727,7 @@ static int a2dp_audio_sbc_packet_recover_proc(
     btif_media_header_t *sbc_decoder_frame,
     a2dp_audio_sbc_decoder_frame_t *sbc_raw_frame, uint8_t frame_cnt) {
   int nRet = A2DP_DECODER_NO_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int missing_pkt_cnt = 0;
   missing_pkt_cnt =
       a2dp_audio_sbc_packet_recover_find_missing(sbc_decoder_frame, frame_cnt);
@@ -742,12 +762,13 @@ int a2dp_audio_sbc_store_packet(btif_media_header_t *header, uint8_t *buffer,
   uint32_t frame_num = 0;
   uint32_t frame_len = 0;
   uint8_t *parser_p = buffer;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   uint16_t bytes_parsed = 0;
   a2dp_audio_sbc_decoder_frame_t *frame_list[FRAME_LIST_MAX] = {
       0,
   };
   uint8_t frame_list_idx = 0;
+  ilist_t frames;
   bool find_err = false;
   uint32_t i = 0;
 
@@ -812,9 +833,11 @@ int a2dp_audio_sbc_store_packet(btif_media_header_t *header, uint8_t *buffer,
     } else {
       a2dp_audio_sbc_packet_recover_proc(header, frame_list[0], frame_num);
       a2dp_audio_sbc_packet_recover_save_last(header);
+      ilist_init(&frames);
       for (i = 0; i < frame_list_idx; i++) {
-        a2dp_audio_list_append(list, frame_list[i]);
+        ilist_append(&frames, &frame_list[i]->node);
       }
+      a2dp_audio_list_splice(list, &frames);
       nRet = A2DP_DECODER_NO_ERROR;
     }
   } else {
@@ -828,8 +851,8 @@ int a2dp_audio_sbc_store_packet(btif_media_header_t *header, uint8_t *buffer,
 
 int a2dp_audio_sbc_discards_packet(uint32_t packets) {
   int nRet = A2DP_DECODER_MEMORY_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame = NULL;
   uint16_t totalSubSequenceNumber;
   uint8_t j = 0;
@@ -872,17 +895,7 @@ int a2dp_audio_sbc_discards_packet(uint32_t packets) {
   totalSubSequenceNumber = sbc_decoder_frame->totalSubSequenceNumber;
 
   if (packets <= a2dp_audio_list_length(list) / totalSubSequenceNumber) {
-    for (uint8_t i = 0; i < packets; i++) {
-      for (j = 0; j < totalSubSequenceNumber; j++) {
-        node = a2dp_audio_list_begin(list);
-        if (!node) {
-          goto exit;
-        }
-        sbc_decoder_frame =
-            (a2dp_audio_sbc_decoder_frame_t *)a2dp_audio_list_node(node);
-        a2dp_audio_list_remove(list, sbc_decoder_frame);
-      }
-    }
+    a2dp_audio_list_discard(list, packets * totalSubSequenceNumber);
     nRet = A2DP_DECODER_NO_ERROR;
   }
 exit:
@@ -892,8 +905,8 @@ exit:
 
 int a2dp_audio_sbc_headframe_info_get(
     A2DP_AUDIO_HEADFRAME_INFO_T *headframe_info) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame = NULL;
 
   if (a2dp_audio_list_length(list) &&
@@ -918,8 +931,8 @@ int a2dp_audio_sbc_info_get(void *info) { return A2DP_DECODER_NO_ERROR; }
 int a2dp_audio_sbc_synchronize_packet(A2DP_AUDIO_SYNCFRAME_INFO_T *sync_info,
                                       uint32_t mask) {
   int nRet = A2DP_DECODER_SYNC_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   int list_len;
   a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame = NULL;
 
@@ -969,21 +982,12 @@ int a2dp_audio_sbc_synchronize_packet(A2DP_AUDIO_SYNCFRAME_INFO_T *sync_info,
 }
 
 int a2dp_audio_sbc_synchronize_dest_packet_mut(uint16_t packet_mut) {
-  list_node_t *node = NULL;
   uint32_t list_len = 0;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
 
   list_len = a2dp_audio_list_length(list);
   if (list_len > packet_mut) {
-    do {
-      node = a2dp_audio_list_begin(list);
-      if (node) {
-        sbc_decoder_frame =
-            (a2dp_audio_sbc_decoder_frame_t *)a2dp_audio_list_node(node);
-        a2dp_audio_list_remove(list, sbc_decoder_frame);
-      }
-    } while (a2dp_audio_list_length(list) > packet_mut);
+    a2dp_audio_list_discard(list, list_len - packet_mut);
   }
 
   TRACE_A2DP_DECODER_I("[MCU][SYNC][SBC] dest pkt list:%d",
@@ -994,7 +998,7 @@ int a2dp_audio_sbc_synchronize_dest_packet_mut(uint16_t packet_mut) {
 
 int a2dp_audio_sbc_convert_list_to_samples(uint32_t *samples) {
   uint32_t list_len = 0;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
 
   list_len = a2dp_audio_list_length(list);
   *samples = SBC_LIST_SAMPLES * list_len;
@@ -1006,9 +1010,7 @@ int a2dp_audio_sbc_convert_list_to_samples(uint32_t *samples) {
 
 int a2dp_audio_sbc_discards_samples(uint32_t samples) {
   int nRet = A2DP_DECODER_SYNC_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame = NULL;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int need_remove_list = 0;
   uint32_t list_samples = 0;
   ASSERT_A2DP_DECODER(!(samples % SBC_LIST_SAMPLES), "%s samples err:%d",
@@ -1017,14 +1019,7 @@ int a2dp_audio_sbc_discards_samples(uint32_t samples) {
   a2dp_audio_sbc_convert_list_to_samples(&list_samples);
   if (list_samples >= samples) {
     need_remove_list = samples / SBC_LIST_SAMPLES;
-    for (int i = 0; i < need_remove_list; i++) {
-      node = a2dp_audio_list_begin(list);
-      if (node) {
-        sbc_decoder_frame =
-            (a2dp_audio_sbc_decoder_frame_t *)a2dp_audio_list_node(node);
-        a2dp_audio_list_remove(list, sbc_decoder_frame);
-      }
-    }
+    a2dp_audio_list_discard(list, need_remove_list);
     nRet = A2DP_DECODER_NO_ERROR;
   }
 
@@ -44,6 +44,7 @@ static HANDLE_DECODER scalableDec_handle = NULL;
 static A2DP_AUDIO_DECODER_LASTFRAME_INFO_T lastframe_info;
 
 typedef struct {
+  ilist_node_t node;
   uint16_t sequenceNumber;
   uint32_t timestamp;
   uint8_t *buffer;
@@ -172,8 +173,8 @@ extern uint32_t app_bt_stream_get_dma_buffer_samples(void);
 TEXT_SSC_LOC static int a2dp_cp_scalable_mcu_decode(uint8_t *buffer,
                                                     uint32_t buffer_bytes) {
   a2dp_audio_scalable_decoder_frame_t *decoder_frame_p = NULL;
-  list_node_t *node = NULL;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int ret, dec_ret;
   struct A2DP_CP_scalable_IN_FRM_INFO_T in_info;
   struct A2DP_CP_scalable_OUT_FRM_INFO_T *p_out_info;
@@ -419,8 +420,8 @@ static int a2dp_audio_scalable_deinit(void) {
 
 int a2dp_audio_scalable_mcu_decode_frame(uint8_t *buffer,
                                          uint32_t buffer_bytes) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_scalable_decoder_frame_t *decoder_frame_p = NULL;
   int ret = A2DP_DECODER_NO_ERROR;
 
@@ -550,7 +551,7 @@ static void a2dp_audio_scalable_free(void *packet) {
 static int a2dp_audio_scalable_store_packet(btif_media_header_t *header,
                                             uint8_t *buffer,
                                             uint32_t buffer_bytes) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int nRet = A2DP_DECODER_NO_ERROR;
   if (a2dp_audio_list_length(list) < SCALABLE_MTU_LIMITER) {
     a2dp_audio_scalable_decoder_frame_t *decoder_frame_p =
@@ -575,8 +576,8 @@ static int a2dp_audio_scalable_store_packet(btif_media_header_t *header,
 
 static int a2dp_audio_scalable_discards_packet(uint32_t packets) {
   int nRet = A2DP_DECODER_MEMORY_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_scalable_decoder_frame_t *decoder_frame_p = NULL;
 
 #ifdef A2DP_CP_ACCEL
@@ -600,8 +601,8 @@ static int a2dp_audio_scalable_discards_packet(uint32_t packets) {
 
 static int a2dp_audio_scalable_headframe_info_get(
     A2DP_AUDIO_HEADFRAME_INFO_T *headframe_info) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   a2dp_audio_scalable_decoder_frame_t *decoder_frame_p = NULL;
 
   if (a2dp_audio_list_length(list)) {
@@ -628,8 +629,8 @@ static int
 a2dp_audio_scalable_synchronize_packet(A2DP_AUDIO_SYNCFRAME_INFO_T *sync_info,
                                        uint32_t mask) {
   int nRet = A2DP_DECODER_SYNC_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_node_t *node = NULL;
   int list_len;
   a2dp_audio_scalable_decoder_frame_t *decoder_frame_p = NULL;
 
@@ -671,9 +672,9 @@ a2dp_audio_scalable_synchronize_packet(A2DP_AUDIO_SYNCFRAME_INFO_T *sync_info,
 
 static int
 a2dp_audio_scalable_synchronize_dest_packet_mut(uint16_t packet_mut) {
-  list_node_t *node = NULL;
+  ilist_node_t *node = NULL;
   uint32_t list_len = 0;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   a2dp_audio_scalable_decoder_frame_t *decoder_frame_p = NULL;
 
   list_len = a2dp_audio_list_length(list);
@@ -695,7 +696,7 @@ a2dp_audio_scalable_synchronize_dest_packet_mut(uint16_t packet_mut) {
 
 int a2dp_audio_scalable_convert_list_to_samples(uint32_t *samples) {
   uint32_t list_len = 0;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
 
   list_len = a2dp_audio_list_length(list);
   *samples = SCALABLE_FRAME_SIZE * list_len;
@@ -707,9 +708,9 @@ int a2dp_audio_scalable_convert_list_to_samples(uint32_t *samples) {
 
 int a2dp_audio_scalable_discards_samples(uint32_t samples) {
   int nRet = A2DP_DECODER_SYNC_ERROR;
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  ilist_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   a2dp_audio_scalable_decoder_frame_t *scalable_decoder_frame = NULL;
-  list_node_t *node = NULL;
+  ilist_node_t *node = NULL;
   int need_remove_list = 0;
   uint32_t list_samples = 0;
   ASSERT(!(samples % SCALABLE_FRAME_SIZE), "%s samples err:%d", __func__,
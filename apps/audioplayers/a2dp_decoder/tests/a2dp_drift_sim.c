@@ -0,0 +1,545 @@
+#include "a2dp_audio_drift.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Plays the two A2DP playback sync loops against synthetic clocks and
+// compares the drift estimator with the controllers it replaced.
+//
+// "bt": app_bt_stream's MUSIC_DELAY_CONTROL loop. The local codec clock
+// drifts against the BT clock, observed every DMA callback with some timing
+// jitter and the odd slot slip. The ratio either retunes the codec (in loop)
+// or a software resampler (out of loop, so the content is what must track).
+//
+// "buf": a2dp_decoder's sync handler. Packets from a drifting source arrive
+// with jitter and in bursts after radio stalls; the sink measures how full its
+// packet list is and retunes its own clock against that.
+//
+// For each run it reports when the ratio first held within a few ppm of the
+// true drift for LOCK_S, its RMS error after SETTLE_S (the pitch wobble), and
+// the largest offset (buffer excursion) seen after SETTLE_S.
+
+#define FS 44100
+#define SETTLE_S 30.0
+#define LOCK_S 10.0
+
+// bt loop
+#define BT_CB_SAMPLES 256
+#define BT_DURATION_S 120.0
+#define BT_TUNE_STEP_PPM 1.0f
+#define BT_SLOT_US 625.0
+#define BT_SETTLED_PPM 5.0
+
+// buf loop, mirroring the decoder defaults
+#define BUF_PACKET_SAMPLES 512
+#define BUF_CB_SAMPLES 1024
+#define BUF_DEST_PACKETS 24
+#define BUF_DURATION_S 900.0
+#define BUF_SYNC_INTERVAL 1000
+#define BUF_TUNE_INTERVAL 50
+#define BUF_TUNE_STEP_PPM 2.0f
+#define BUF_FAST_LIMIT_PPM 150.0f
+#define BUF_SLOW_LIMIT_PPM -350.0f
+#define BUF_NEED_FAST_CACHE_PPM -1000.0f
+#define BUF_MAX_PACKETS 4096
+// Level changes by whole packets, so the drift shows only over minutes.
+#define BUF_SETTLED_PPM 20.0
+
+enum method { M_DRIFT, M_OLD };
+
+typedef struct {
+  const char *name;
+  double drift_ppm;   // local clock (bt) or sink against source (buf)
+  double walk_ppm;    // drift random walk per sqrt(s)
+  double jitter_us;   // observation jitter (bt) or packet delay jitter (buf)
+  bool bursts;        // slot slips (bt) or radio stalls (buf)
+  bool in_loop;       // bt only: codec retune instead of resampler
+  unsigned seed;
+} scenario_t;
+
+typedef struct {
+  double converge_s;
+  double rms_ppm;
+  double max_offset_us;
+  uint32_t tunes;
+  uint32_t underflows;
+  uint32_t forced;
+  float confidence;
+} result_t;
+
+static uint64_t rng;
+
+static double rand_uniform(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return (double)(rng >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rand_gauss(void) {
+  double u = rand_uniform() + 1e-12;
+  return sqrt(-2 * log(u)) * cos(2 * M_PI * rand_uniform());
+}
+
+static void seed(unsigned s) { rng = 0x9E3779B97F4A7C15ull ^ ((uint64_t)s << 1); }
+
+typedef struct {
+  double settled_ppm;
+  double good_since_s;
+  double locked_s;
+  double err_sq;
+  uint32_t err_n;
+} track_t;
+
+static void track(track_t *t, double now_s, double ratio_ppm,
+                  double want_ppm) {
+  double err = ratio_ppm - want_ppm;
+
+  if (fabs(err) > t->settled_ppm)
+    t->good_since_s = -1;
+  else if (t->good_since_s < 0)
+    t->good_since_s = now_s;
+  if (t->locked_s < 0 && t->good_since_s >= 0 &&
+      now_s - t->good_since_s >= LOCK_S)
+    t->locked_s = t->good_since_s;
+  if (now_s >= SETTLE_S) {
+    t->err_sq += err * err;
+    t->err_n++;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// bt loop
+
+typedef struct {
+  int flag;
+  float offset;
+} bang_bang_t;
+
+// app_bt_stream's former controller, on whole milliseconds.
+static float bang_bang(bang_bang_t *bb, double local_us, double bt_us,
+                       float applied_ppm) {
+  int64_t bt_ms = (int64_t)floor(bt_us / 1000);
+  int64_t local_ms = (int64_t)floor(local_us / 1000);
+
+  if (bt_ms > local_ms + 2) {
+    bb->flag = 1;
+    return 1000.0f;
+  } else if (bt_ms < local_ms - 2) {
+    bb->flag = -1;
+    return -1000.0f;
+  } else if (bb->flag && bt_ms == local_ms) {
+    if (bb->offset < 100.0f)
+      bb->offset += bb->flag * 0.5f;
+    bb->flag = 0;
+    return bb->offset;
+  }
+  return applied_ppm;
+}
+
+static FILE *trace_out;
+
+static void sim_bt(const scenario_t *sc, enum method m, result_t *res) {
+  A2DP_AUDIO_DRIFT_CFG_T cfg;
+  A2DP_AUDIO_DRIFT_T drift;
+  bang_bang_t bb = {0, 0};
+  track_t tr = {BT_SETTLED_PPM, -1, -1, 0, 0};
+  double d = sc->drift_ppm;
+  double real_us = 0, resampled_us = 0;
+  uint64_t samples = 0;
+  float applied = 0;
+
+  seed(sc->seed);
+  memset(res, 0, sizeof(*res));
+  a2dp_audio_drift_default_cfg(&cfg);
+  cfg.ratio_in_loop = sc->in_loop;
+  a2dp_audio_drift_init(&drift, &cfg);
+
+  while (real_us < BT_DURATION_S * 1e6) {
+    double local_dt_us = BT_CB_SAMPLES * 1e6 / FS;
+    double real_dt_us = local_dt_us / (1 + d * 1e-6);
+    double local_us, bt_us, err_us;
+    float want;
+
+    if (sc->in_loop)
+      real_dt_us /= 1 + applied * 1e-6;
+    real_us += real_dt_us;
+    samples += BT_CB_SAMPLES;
+    d += sc->walk_ppm * sqrt(real_dt_us * 1e-6) * rand_gauss();
+    if (!sc->in_loop)
+      resampled_us += applied * 1e-6 * local_dt_us;
+
+    local_us = samples * 1e6 / FS;
+    bt_us = real_us + sc->jitter_us * rand_gauss();
+    if (sc->bursts && rand_uniform() < 0.002)
+      bt_us += rand_uniform() < 0.5 ? BT_SLOT_US : -BT_SLOT_US;
+    if (trace_out)
+      fprintf(trace_out, "%.0f %.0f\n", bt_us, local_us);
+
+    if (m == M_DRIFT) {
+      want = a2dp_audio_drift_update(&drift, (uint32_t)(uint64_t)bt_us,
+                                     (float)(local_us - bt_us), applied);
+      if (fabsf(want - applied) >= BT_TUNE_STEP_PPM) {
+        applied = want;
+        res->tunes++;
+      }
+    } else {
+      want = bang_bang(&bb, local_us, bt_us, applied);
+      if (want != applied) {
+        applied = want;
+        res->tunes++;
+      }
+    }
+
+    err_us = local_us - real_us + resampled_us;
+    if (real_us >= SETTLE_S * 1e6 && fabs(err_us) > res->max_offset_us)
+      res->max_offset_us = fabs(err_us);
+    track(&tr, real_us * 1e-6, applied, -d);
+  }
+  res->converge_s = tr.locked_s;
+  res->rms_ppm = tr.err_n ? sqrt(tr.err_sq / tr.err_n) : 0;
+  res->confidence = a2dp_audio_drift_confidence(&drift);
+}
+
+// ---------------------------------------------------------------------------
+// buf loop
+
+typedef struct {
+  bool started;
+  uint32_t tick;
+  uint32_t play_samples;
+  float avg;
+  float pid_err[3];
+  float pid_result;
+  A2DP_AUDIO_DRIFT_T drift;
+} sink_t;
+
+static float buf_alpha(float y, float x) { return y ? (3 * y + x) / 4 : x; }
+
+static void sink_reset(sink_t *s) {
+  s->tick = 0;
+  s->play_samples = 0;
+  a2dp_audio_drift_restart(&s->drift);
+}
+
+// The low-cache fallback both versions keep. Returns true if it took over.
+static bool sink_force_slow(sink_t *s, uint32_t level, float *ratio,
+                            result_t *res) {
+  float want;
+
+  if (level * 10 <= BUF_DEST_PACKETS * 10 / 3)
+    want = BUF_NEED_FAST_CACHE_PPM;
+  else if (level * 10 <= BUF_DEST_PACKETS * 20 / 3)
+    want = BUF_SLOW_LIMIT_PPM;
+  else
+    return false;
+  if (*ratio != want) {
+    sink_reset(s);
+    res->forced++;
+    *ratio = want;
+    res->tunes++;
+  }
+  return true;
+}
+
+// a2dp_audio_sync_handler before the drift estimator: PID on the filtered
+// level every BUF_SYNC_INTERVAL callbacks.
+static void sink_old(sink_t *s, uint32_t level, float *ratio, result_t *res) {
+  float diff = s->avg - BUF_DEST_PACKETS;
+  float mtu = (float)BUF_CB_SAMPLES / BUF_PACKET_SAMPLES;
+
+  if (s->tick++ % BUF_SYNC_INTERVAL == 0) {
+    if (diff != 0.f && s->tick != 1 &&
+        ((fabsf(diff) > mtu * 0.25f && diff > 0) ||
+         (fabsf(diff) > mtu * 0.1f && diff < 0))) {
+      float *e = s->pid_err;
+      float want;
+
+      e[0] = diff / s->avg;
+      s->pid_result += 0.4f * (e[0] - e[1]) + 0.1f * e[0] +
+                       0.6f * (e[0] - 2 * e[1] + e[2]);
+      e[2] = e[1];
+      e[1] = e[0];
+      want = *ratio + s->pid_result * 1e6f;
+      if (want > BUF_FAST_LIMIT_PPM)
+        want = BUF_FAST_LIMIT_PPM;
+      else if (want < BUF_SLOW_LIMIT_PPM)
+        want = BUF_SLOW_LIMIT_PPM;
+      if (want != *ratio) {
+        *ratio = want;
+        res->tunes++;
+      }
+    }
+  } else {
+    sink_force_slow(s, level, ratio, res);
+  }
+}
+
+// a2dp_audio_sync_handler with the drift estimator.
+static void sink_drift(sink_t *s, uint32_t level, float *ratio,
+                       result_t *res) {
+  float packet_us = BUF_PACKET_SAMPLES * 1e6f / FS;
+  float want;
+
+  s->play_samples += BUF_CB_SAMPLES;
+  want = a2dp_audio_drift_update(
+      &s->drift, (uint32_t)((uint64_t)s->play_samples * 1000000 / FS),
+      (BUF_DEST_PACKETS - s->avg) * packet_us, *ratio);
+  if (sink_force_slow(s, level, ratio, res))
+    return;
+  if (s->tick++ % BUF_TUNE_INTERVAL == 0 && s->tick != 1 &&
+      fabsf(want - *ratio) >= BUF_TUNE_STEP_PPM) {
+    *ratio = want;
+    res->tunes++;
+  }
+}
+
+static void sink_drift_cfg(A2DP_AUDIO_DRIFT_CFG_T *cfg) {
+  a2dp_audio_drift_default_cfg(cfg);
+  cfg->meas_noise_us = 2000.0f;
+  cfg->phase_time_s = 120.0f;
+  cfg->max_slew_ppm_s = 5.0f;
+  cfg->min_ppm = BUF_SLOW_LIMIT_PPM;
+  cfg->max_ppm = BUF_FAST_LIMIT_PPM;
+}
+
+static void sim_buf(const scenario_t *sc, enum method m, result_t *res) {
+  A2DP_AUDIO_DRIFT_CFG_T cfg;
+  static double arrival[BUF_MAX_PACKETS];
+  sink_t sink;
+  track_t tr = {BUF_SETTLED_PPM, -1, -1, 0, 0};
+  double src_period_us = BUF_PACKET_SAMPLES * 1e6 / FS;
+  double d = sc->drift_ppm;
+  double now_us = 0, stall_end_us = 0, next_stall_us = 7e6;
+  double last_arrival = 0;
+  uint64_t sent = 0, received = 0, played = 0;
+  float ratio = 0;
+
+  seed(sc->seed);
+  memset(res, 0, sizeof(*res));
+  memset(&sink, 0, sizeof(sink));
+  sink_drift_cfg(&cfg);
+  a2dp_audio_drift_init(&sink.drift, &cfg);
+
+  while (now_us < BUF_DURATION_S * 1e6) {
+    double cb_us = BUF_CB_SAMPLES * 1e6 / FS / (1 + d * 1e-6) /
+                   (1 + ratio * 1e-6);
+    uint32_t level;
+
+    now_us += cb_us;
+    d += sc->walk_ppm * sqrt(cb_us * 1e-6) * rand_gauss();
+
+    // The source clock is the reference; it has sent everything due by now.
+    while ((sent + 1) * src_period_us <= now_us + 200000) {
+      double t = (sent + 1) * src_period_us + fabs(sc->jitter_us *
+                                                    rand_gauss());
+      if (sc->bursts && t >= next_stall_us) {
+        stall_end_us = next_stall_us + 40000 + 80000 * rand_uniform();
+        next_stall_us += 5e6 + 10e6 * rand_uniform();
+      }
+      if (t < stall_end_us)
+        t = stall_end_us;
+      if (t < last_arrival)
+        t = last_arrival;
+      last_arrival = t;
+      arrival[sent++ % BUF_MAX_PACKETS] = t;
+    }
+    while (received < sent && arrival[received % BUF_MAX_PACKETS] <= now_us)
+      received++;
+
+    level = (uint32_t)(received - played);
+    if (!sink.started) {
+      if (level < BUF_DEST_PACKETS)
+        continue;
+      sink.started = true;
+    }
+    if (level < BUF_CB_SAMPLES / BUF_PACKET_SAMPLES) {
+      res->underflows++;
+      sink.started = false;
+      sink.avg = 0;
+      sink_reset(&sink);
+      continue;
+    }
+    played += BUF_CB_SAMPLES / BUF_PACKET_SAMPLES;
+    level -= BUF_CB_SAMPLES / BUF_PACKET_SAMPLES;
+
+    sink.avg = buf_alpha(sink.avg, (float)level);
+    if (m == M_DRIFT)
+      sink_drift(&sink, level, &ratio, res);
+    else
+      sink_old(&sink, level, &ratio, res);
+
+    if (now_us >= SETTLE_S * 1e6) {
+      double excursion =
+          fabs((double)level - BUF_DEST_PACKETS) * src_period_us;
+      if (excursion > res->max_offset_us)
+        res->max_offset_us = excursion;
+    }
+    track(&tr, now_us * 1e-6, ratio, -d);
+  }
+  res->converge_s = tr.locked_s;
+  res->rms_ppm = tr.err_n ? sqrt(tr.err_sq / tr.err_n) : 0;
+  res->confidence = a2dp_audio_drift_confidence(&sink.drift);
+}
+
+// ---------------------------------------------------------------------------
+
+static const scenario_t bt_scenarios[] = {
+    {"bt codec +40ppm", 40, 0.05, 50, false, true, 1},
+    {"bt codec -25ppm", -25, 0.2, 100, true, true, 2},
+    {"bt resample +60ppm", 60, 0.05, 50, false, false, 3},
+    {"bt resample -90ppm", -90, 0.2, 150, true, false, 4},
+};
+
+static const scenario_t buf_scenarios[] = {
+    {"buf +40ppm", 40, 0.05, 3000, false, true, 5},
+    {"buf -60ppm", -60, 0.05, 5000, false, true, 6},
+    {"buf +80ppm bursts", 80, 0.1, 5000, true, true, 7},
+    {"buf -120ppm bursts", -120, 0.1, 8000, true, true, 8},
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static void print_result(const char *name, const char *method,
+                         const result_t *r) {
+  char conv[16];
+
+  if (r->converge_s < 0)
+    snprintf(conv, sizeof(conv), "never");
+  else
+    snprintf(conv, sizeof(conv), "%.1f", r->converge_s);
+  printf("%-22s %-6s %8s %9.1f %10.2f %6u %4u %4u %5.2f\n", name, method,
+         conv, r->rms_ppm, r->max_offset_us / 1000, r->tunes, r->forced,
+         r->underflows, r->confidence);
+}
+
+static int run_all(bool check) {
+  printf("%-22s %-6s %8s %9s %10s %6s %4s %4s %5s\n", "scenario", "method",
+         "lock_s", "rms_ppm", "excurs_ms", "tunes", "slow", "udf", "conf");
+  for (size_t i = 0; i < ARRAY_SIZE(bt_scenarios); ++i) {
+    result_t nd, od;
+
+    sim_bt(&bt_scenarios[i], M_DRIFT, &nd);
+    sim_bt(&bt_scenarios[i], M_OLD, &od);
+    print_result(bt_scenarios[i].name, "drift", &nd);
+    print_result(bt_scenarios[i].name, "old", &od);
+    if (check) {
+      assert(nd.converge_s >= 0 && nd.converge_s < 60);
+      assert(nd.rms_ppm < 3.0 && nd.rms_ppm * 10 < od.rms_ppm);
+      assert(nd.max_offset_us < 100);
+      assert(nd.max_offset_us < od.max_offset_us);
+      assert(nd.confidence > 0.4f);
+    }
+  }
+  for (size_t i = 0; i < ARRAY_SIZE(buf_scenarios); ++i) {
+    result_t nd, od;
+
+    sim_buf(&buf_scenarios[i], M_DRIFT, &nd);
+    sim_buf(&buf_scenarios[i], M_OLD, &od);
+    print_result(buf_scenarios[i].name, "drift", &nd);
+    print_result(buf_scenarios[i].name, "old", &od);
+    if (check) {
+      assert(nd.converge_s >= 0 && nd.converge_s < 300);
+      assert(nd.rms_ppm < od.rms_ppm);
+      assert(nd.underflows == 0);
+      // Stalls and the low cache fallback dominate when there are bursts.
+      if (!buf_scenarios[i].bursts) {
+        assert(nd.rms_ppm * 10 < od.rms_ppm);
+        assert(nd.max_offset_us <= od.max_offset_us);
+      }
+    }
+  }
+  return 0;
+}
+
+// Feeds a recorded "bt_us local_us" trace, one observation per line, to the
+// estimator out of loop and prints where it settled.
+static int replay(const char *path) {
+  A2DP_AUDIO_DRIFT_CFG_T cfg;
+  A2DP_AUDIO_DRIFT_T drift;
+  FILE *f = fopen(path, "r");
+  double bt_us, local_us, first_bt = -1, first_local = 0;
+  float applied = 0;
+  uint32_t n = 0, tunes = 0;
+
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+  a2dp_audio_drift_default_cfg(&cfg);
+  cfg.ratio_in_loop = false;
+  a2dp_audio_drift_init(&drift, &cfg);
+  while (fscanf(f, "%lf %lf", &bt_us, &local_us) == 2) {
+    float want;
+
+    if (first_bt < 0) {
+      first_bt = bt_us;
+      first_local = local_us;
+    }
+    want = a2dp_audio_drift_update(
+        &drift, (uint32_t)(uint64_t)(bt_us - first_bt),
+        (float)((local_us - first_local) - (bt_us - first_bt)), applied);
+    if (fabsf(want - applied) >= BT_TUNE_STEP_PPM) {
+      applied = want;
+      tunes++;
+    }
+    if (++n % 1000 == 0)
+      printf("%8.1fs drift:%8.2fppm ratio:%8.2fppm conf:%.2f\n",
+             (bt_us - first_bt) * 1e-6, drift.drift_ppm, applied,
+             a2dp_audio_drift_confidence(&drift));
+  }
+  fclose(f);
+  printf("%u observations, drift %.2f ppm, ratio %.2f ppm, %u tunes, "
+         "%u outliers\n",
+         n, drift.drift_ppm, applied, tunes, drift.outliers);
+  return 0;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-t] [-r trace] [-w trace]\n"
+          "  -t        check the results, for make test\n"
+          "  -r trace  replay a \"bt_us local_us\" trace\n"
+          "  -w trace  write the observations of an out of loop bt run\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  bool check = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "tr:w:")) != -1) {
+    switch (opt) {
+    case 't':
+      check = true;
+      break;
+    case 'r':
+      return replay(optarg);
+    case 'w': {
+      result_t r;
+
+      trace_out = fopen(optarg, "w");
+      if (!trace_out) {
+        perror(optarg);
+        return 1;
+      }
+      sim_bt(&bt_scenarios[2], M_DRIFT, &r);
+      fclose(trace_out);
+      trace_out = NULL;
+      return 0;
+    }
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  run_all(check);
+  if (check)
+    printf("All a2dp drift sim checks passed.\n");
+  return 0;
+}
@@ -155,7 +155,7 @@ enum APP_AUDIO_CACHE_T {
 
 #define app_audio_mempool_init  syspool_init
 
-#define app_audio_mempool_noclr_init syspool_init
+#define app_audio_mempool_noclr_init syspool_init_noclr
 
 #define app_audio_mempool_use_mempoolsection_init syspool_init
 
@@ -163,6 +163,10 @@ enum APP_AUDIO_CACHE_T {
 
 #define app_audio_mempool_get_buff syspool_get_buff
 
+#define app_audio_mempool_scope_begin syspool_scope_begin
+
+#define app_audio_mempool_scope_end syspool_scope_end
+
 #if defined(A2DP_LDAC_ON)
 #define  app_audio_mempool_total_buf              syspool_total_size
 #define  app_audio_mempool_force_set_buff_used    syspool_force_used_size
@@ -73,8 +73,10 @@ SPEAKER_WEIGHTING_FILTER_SUPPRESS | Default EQ                       | 0.5     \
 **/
 
 #include "bt_sco_chain.h"
+#include "audio_capture.h"
 #include "audio_dump.h"
 #include "bt_sco_chain_cfg.h"
+#include "bt_sco_chain_profile.h"
 #include "bt_sco_chain_tuning.h"
 #include "hal_timer.h"
 #include "hal_trace.h"
@@ -125,11 +127,137 @@ extern int sco_overlay_ram_buf_len;
 //#define BT_SCO_CHAIN_PROFILE
 //#define BT_SCO_CHAIN_AUDIO_DUMP
 
-#if defined(BT_SCO_CHAIN_PROFILE)
-static uint32_t tx_start_ticks = 0;
-static uint32_t tx_end_ticks = 0;
+#define SYSTEM_BASE_MIPS (18)
+
+// Every stage of the chain is timed on every frame; see bt_sco_chain_profile.h
+// for the statistics kept. Define BT_SCO_CHAIN_PROFILE to trace them.
+enum SPEECH_PROF_STAGE_T {
+  SPEECH_PROF_TX_FRAME,
+  SPEECH_PROF_RX_FRAME,
+#if defined(SPEECH_TX_DC_FILTER)
+  SPEECH_PROF_TX_DC_FILTER,
+#endif
+#if defined(SPEECH_TX_MIC_CALIBRATION)
+  SPEECH_PROF_TX_MIC_CALIB,
+#endif
+#if defined(SPEECH_TX_MIC_FIR_CALIBRATION)
+  SPEECH_PROF_TX_MIC_FIR_CALIB,
+#endif
+#if defined(SPEECH_TX_2MIC_NS)
+  SPEECH_PROF_TX_2MIC_NS,
+#endif
+#if defined(SPEECH_TX_2MIC_NS2)
+  SPEECH_PROF_TX_2MIC_NS2,
+#endif
+#if defined(SPEECH_TX_2MIC_NS4)
+  SPEECH_PROF_TX_2MIC_NS4,
+#endif
+#if defined(SPEECH_TX_2MIC_NS5)
+  SPEECH_PROF_TX_2MIC_NS5,
+#endif
+#if defined(SPEECH_TX_2MIC_NS6)
+  SPEECH_PROF_TX_2MIC_NS6,
+#endif
+#if defined(SPEECH_TX_3MIC_NS)
+  SPEECH_PROF_TX_3MIC_NS,
+#endif
+#if defined(SPEECH_TX_3MIC_NS3)
+  SPEECH_PROF_TX_3MIC_NS3,
+#endif
+#if defined(SPEECH_TX_AEC)
+  SPEECH_PROF_TX_AEC,
+#endif
+#if defined(SPEECH_TX_AEC2)
+  SPEECH_PROF_TX_AEC2,
+#endif
+#if defined(SPEECH_TX_AEC3)
+  SPEECH_PROF_TX_AEC3,
+#endif
+#if defined(SPEECH_TX_AEC2FLOAT) && !defined(SCO_CP_ACCEL)
+  SPEECH_PROF_TX_AEC2FLOAT,
+#endif
+#if defined(SPEECH_TX_NS)
+  SPEECH_PROF_TX_NS,
+#endif
+#if defined(SPEECH_TX_NS2)
+  SPEECH_PROF_TX_NS2,
+#endif
+#if defined(SPEECH_TX_NS2FLOAT)
+  SPEECH_PROF_TX_NS2FLOAT,
+#endif
+#if defined(SPEECH_TX_NS3)
+  SPEECH_PROF_TX_NS3,
+#endif
+#if defined(SPEECH_TX_WNR)
+  SPEECH_PROF_TX_WNR,
+#endif
+#if defined(SPEECH_TX_NOISE_GATE)
+  SPEECH_PROF_TX_NOISE_GATE,
+#endif
+#if defined(SPEECH_TX_COMPEXP)
+  SPEECH_PROF_TX_COMPEXP,
+#endif
+#if defined(SPEECH_TX_AGC)
+  SPEECH_PROF_TX_AGC,
+#endif
+#if defined(SPEECH_TX_EQ)
+  SPEECH_PROF_TX_EQ,
+#endif
+#if defined(SPEECH_TX_POST_GAIN)
+  SPEECH_PROF_TX_POST_GAIN,
+#endif
+#if defined(SPEECH_RX_NS)
+  SPEECH_PROF_RX_NS,
+#endif
+#if defined(SPEECH_RX_NS2)
+  SPEECH_PROF_RX_NS2,
+#endif
+#if defined(SPEECH_RX_NS2FLOAT)
+  SPEECH_PROF_RX_NS2FLOAT,
+#endif
+#if defined(SPEECH_RX_NS3)
+  SPEECH_PROF_RX_NS3,
+#endif
+#if defined(SPEECH_RX_AGC)
+  SPEECH_PROF_RX_AGC,
+#endif
+#if defined(SPEECH_RX_EQ)
+  SPEECH_PROF_RX_EQ,
+#endif
+#if defined(SPEECH_RX_POST_GAIN)
+  SPEECH_PROF_RX_POST_GAIN,
+#endif
+
+  SPEECH_PROF_STAGE_QTY
+};
+
+#define SPEECH_PROF_START(stage)                                               \
+  uint32_t stage##_start_ticks = hal_fast_sys_timer_get()
+#define SPEECH_PROF_STOP(stage)                                                \
+  speech_prof_stop(SPEECH_PROF_##stage, #stage, stage##_start_ticks)
+
+// Frames timed before the measured load replaces the static estimate, and
+// how often it is re-evaluated after that.
+#define SPEECH_PROF_WARMUP_FRAMES 64
+#define SPEECH_PROF_EVAL_FRAMES 64
+
+// The clock follows the measured load, except when the CP runs part of the
+// chain, or when the SCO stream holds 208M for ANC mixing that is not timed
+// here.
+#if !defined(SCO_CP_ACCEL) &&                                                  \
+    !(defined(AUDIO_ANC_FB_MC_SCO) && defined(ANC_APP) &&                      \
+      !defined(__AUDIO_RESAMPLE__))
+#define SPEECH_SYSFREQ_GOVERNOR
 #endif
 
+static SPEECH_PROF_STAT_T speech_prof_stats[SPEECH_PROF_STAGE_QTY];
+static SPEECH_PROF_GOV_T speech_prof_gov;
+static uint32_t speech_prof_frames = 0;
+static uint32_t speech_prof_cpu_mhz = 0;
+static uint32_t speech_prof_ticks_per_ms = 0;
+static uint32_t speech_tx_frame_us = 0;
+static uint32_t speech_rx_frame_us = 0;
+
 extern const SpeechConfig speech_cfg_default;
 static SpeechConfig *speech_cfg = NULL;
 
@@ -338,6 +466,113 @@ static int32_t _speech_tx_process_(void *pcm_buf, void *ref_buf,
 static int32_t _speech_rx_process_(void *pcm_buf, int32_t *pcm_len);
 enum APP_SYSFREQ_FREQ_T speech_get_proper_sysfreq(int *needed_mips);
 
+static const uint16_t speech_prof_freq_mhz[APP_SYSFREQ_FREQ_QTY] = {
+    [APP_SYSFREQ_26M] = 26,   [APP_SYSFREQ_52M] = 52,
+    [APP_SYSFREQ_78M] = 78,   [APP_SYSFREQ_104M] = 104,
+    [APP_SYSFREQ_208M] = 208,
+};
+
+static enum APP_SYSFREQ_FREQ_T speech_prof_mhz_to_freq(uint32_t mhz) {
+  enum APP_SYSFREQ_FREQ_T freq = APP_SYSFREQ_26M;
+
+  while (freq < APP_SYSFREQ_208M && speech_prof_freq_mhz[freq] < mhz)
+    freq++;
+
+  return freq;
+}
+
+static void speech_prof_init(void) {
+  for (int i = 0; i < SPEECH_PROF_STAGE_QTY; i++)
+    speech_prof_stat_init(&speech_prof_stats[i], NULL);
+
+  speech_prof_frames = 0;
+  speech_prof_ticks_per_ms = MS_TO_FAST_TICKS(1);
+  speech_tx_frame_us =
+      (uint64_t)speech_tx_frame_len * 1000000 / speech_tx_sample_rate;
+  speech_rx_frame_us =
+      (uint64_t)speech_rx_frame_len * 1000000 / speech_rx_sample_rate;
+}
+
+static void speech_prof_frame_start(void) {
+  speech_prof_cpu_mhz = speech_prof_freq_mhz[hal_sysfreq_get()];
+}
+
+static void speech_prof_stop(enum SPEECH_PROF_STAGE_T stage, const char *name,
+                             uint32_t start_ticks) {
+  uint32_t ticks = hal_fast_sys_timer_get() - start_ticks;
+  uint64_t cycles =
+      (uint64_t)ticks * speech_prof_cpu_mhz * 1000 / speech_prof_ticks_per_ms;
+
+  speech_prof_stats[stage].name = name;
+  speech_prof_stat_add(&speech_prof_stats[stage], (uint32_t)cycles);
+}
+
+// MIPS needed to run |tx_cycles| every TX frame and |rx_cycles| every RX
+// frame, plus the codec and the rest of the system.
+static uint32_t speech_prof_need_mips(uint32_t tx_cycles, uint32_t rx_cycles) {
+  return SYSTEM_BASE_MIPS +
+         (tx_cycles + speech_tx_frame_us - 1) / speech_tx_frame_us +
+         (rx_cycles + speech_rx_frame_us - 1) / speech_rx_frame_us;
+}
+
+static uint32_t speech_prof_measured_mips(void) {
+  return speech_prof_need_mips(
+      speech_prof_stat_percentile(&speech_prof_stats[SPEECH_PROF_TX_FRAME],
+                                  990),
+      speech_prof_stat_percentile(&speech_prof_stats[SPEECH_PROF_RX_FRAME],
+                                  990));
+}
+
+#if defined(BT_SCO_CHAIN_PROFILE)
+static void speech_prof_trace(void) {
+  for (int i = 0; i < SPEECH_PROF_STAGE_QTY; i++) {
+    const SPEECH_PROF_STAT_T *st = &speech_prof_stats[i];
+
+    if (st->name == NULL)
+      continue;
+    TRACE(5, "[%s] %s: p50 %d p99 %d max %d cycles", __func__, st->name,
+          speech_prof_stat_percentile(st, 500),
+          speech_prof_stat_percentile(st, 990), speech_prof_stat_max(st));
+  }
+}
+#endif
+
+static void speech_prof_frame_end(void) {
+  bool eval;
+
+  speech_prof_frames++;
+  eval = speech_prof_frames >= SPEECH_PROF_WARMUP_FRAMES &&
+         speech_prof_frames % SPEECH_PROF_EVAL_FRAMES == 0;
+
+#if defined(BT_SCO_CHAIN_PROFILE)
+  if (eval)
+    speech_prof_trace();
+#endif
+
+#if defined(SPEECH_SYSFREQ_GOVERNOR)
+  uint32_t cur_mhz = speech_prof_gov_mhz(&speech_prof_gov);
+  uint32_t need, mhz;
+
+  // A frame that did not fit the current clock with margin raises it right
+  // away, without waiting for the percentiles to catch up.
+  need = speech_prof_need_mips(speech_prof_stats[SPEECH_PROF_TX_FRAME].last,
+                               speech_prof_stats[SPEECH_PROF_RX_FRAME].last);
+  if (speech_prof_fit_mhz(need) <= cur_mhz) {
+    if (!eval)
+      return;
+    need = speech_prof_measured_mips();
+  }
+
+  mhz = speech_prof_gov_update(&speech_prof_gov, need);
+  if (mhz != cur_mhz) {
+    app_sysfreq_req(APP_SYSFREQ_USER_BT_SCO, speech_prof_mhz_to_freq(mhz));
+    TRACE(4, "[%s] need %d MIPS: %dM -> %dM", __func__, need, cur_mhz, mhz);
+  }
+#else
+  (void)eval;
+#endif
+}
+
 void *speech_get_ext_buff(int size) {
   void *pBuff = NULL;
   if (size % 4) {
@@ -653,6 +888,8 @@ int speech_init(int tx_sample_rate, int rx_sample_rate, int tx_frame_ms,
   speech_tx_init(speech_tx_sample_rate, speech_tx_frame_len);
   speech_rx_init(speech_rx_sample_rate, speech_rx_frame_len);
 
+  speech_prof_init();
+
 #if !defined(SCO_CP_ACCEL)
   int needed_freq = 0;
   enum APP_SYSFREQ_FREQ_T min_system_freq =
@@ -676,6 +913,11 @@ int speech_init(int tx_sample_rate, int rx_sample_rate, int tx_frame_ms,
   }
 #endif
 
+  // Start from the clock the call was set up with, and let the measured
+  // load bring it down from there.
+  speech_prof_gov_init(&speech_prof_gov,
+                       speech_prof_freq_mhz[hal_sysfreq_get()]);
+
   TRACE(1, "[%s] End", __func__);
 
   return 0;
@@ -1021,11 +1263,19 @@ float speech_get_required_mips(void) {
   return speech_tx_get_required_mips() + speech_rx_get_required_mips();
 }
 
-#define SYSTEM_BASE_MIPS (18)
-
+// Picks the clock from the measured load once enough frames have been timed,
+// and from the static estimates of the modules before that.
 enum APP_SYSFREQ_FREQ_T speech_get_proper_sysfreq(int *needed_mips) {
   enum APP_SYSFREQ_FREQ_T freq = APP_SYSFREQ_32K;
-  int required_mips = (int)ceilf(speech_get_required_mips() + SYSTEM_BASE_MIPS);
+  int required_mips;
+
+  if (speech_prof_frames >= SPEECH_PROF_WARMUP_FRAMES) {
+    required_mips = speech_prof_measured_mips();
+    *needed_mips = required_mips;
+    return speech_prof_mhz_to_freq(speech_prof_fit_mhz(required_mips));
+  }
+
+  required_mips = (int)ceilf(speech_get_required_mips() + SYSTEM_BASE_MIPS);
 
   if (required_mips >= 104)
     freq = APP_SYSFREQ_208M;
@@ -1138,10 +1388,6 @@ int speech_set_config(const SpeechConfig *cfg) {
 void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
   int pcm_len = *_pcm_len;
 
-#if defined(BT_SCO_CHAIN_PROFILE)
-  tx_start_ticks = hal_fast_sys_timer_get();
-#endif
-
   // TRACE(2,"[%s] pcm_len = %d", __func__, pcm_len);
 
 #ifdef AUDIO_DEBUG_V0_1_0
@@ -1172,6 +1418,17 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
   }
 #endif
 
+  AUDIO_CAPTURE_POINT(AUDIO_CAPTURE_TAP_SCO_TX_IN, pcm_buf,
+                      pcm_len / SPEECH_CODEC_CAPTURE_CHANNEL_NUM,
+                      SPEECH_CODEC_CAPTURE_CHANNEL_NUM, 16,
+                      speech_tx_sample_rate);
+#if defined(SPEECH_TX_AEC) || defined(SPEECH_TX_AEC2) ||                       \
+    defined(SPEECH_TX_AEC3) || defined(SPEECH_TX_AEC2FLOAT)
+  AUDIO_CAPTURE_POINT(AUDIO_CAPTURE_TAP_SCO_TX_REF, ref_buf,
+                      pcm_len / SPEECH_CODEC_CAPTURE_CHANNEL_NUM, 1, 16,
+                      speech_tx_sample_rate);
+#endif
+
 #if defined(BT_SCO_CHAIN_AUDIO_DUMP)
   audio_dump_clear_up();
 #endif
@@ -1189,7 +1446,9 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
 #endif
 
 #if defined(SPEECH_TX_DC_FILTER)
+  SPEECH_PROF_START(TX_DC_FILTER);
   speech_dc_filter_process(speech_tx_dc_filter_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_DC_FILTER);
 #endif
 
 #if (SPEECH_CODEC_CAPTURE_CHANNEL_NUM == 2) && defined(AUDIO_DUMP) &&          \
@@ -1201,11 +1460,15 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
 #endif
 
 #if defined(SPEECH_TX_MIC_CALIBRATION)
+  SPEECH_PROF_START(TX_MIC_CALIB);
   speech_iir_calib_process(speech_tx_mic_calib_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_MIC_CALIB);
 #endif
 
 #if defined(SPEECH_TX_MIC_FIR_CALIBRATION)
+  SPEECH_PROF_START(TX_MIC_FIR_CALIB);
   speech_fir_calib_process(speech_tx_mic_fir_calib_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_MIC_FIR_CALIB);
 #endif
 
 #if (SPEECH_CODEC_CAPTURE_CHANNEL_NUM == 2) && defined(AUDIO_DUMP) &&          \
@@ -1217,18 +1480,23 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
 #endif
 
 #if defined(SPEECH_TX_2MIC_NS)
+  SPEECH_PROF_START(TX_2MIC_NS);
   dual_mic_denoise_run(pcm_buf, pcm_len, pcm_buf);
+  SPEECH_PROF_STOP(TX_2MIC_NS);
   // Channel num: two-->one
   pcm_len >>= 1;
 #endif
 
 #if defined(SPEECH_TX_2MIC_NS2)
+  SPEECH_PROF_START(TX_2MIC_NS2);
   speech_2mic_ns2_process(speech_tx_2mic_ns2_st, pcm_buf, pcm_len, pcm_buf);
+  SPEECH_PROF_STOP(TX_2MIC_NS2);
   // Channel num: two-->one
   pcm_len >>= 1;
 #endif
 
 #if defined(SPEECH_TX_2MIC_NS4)
+  SPEECH_PROF_START(TX_2MIC_NS4);
   if (dualmic_enable == true) {
 #if defined(ANC_APP)
     sensormic_denoise_set_anc_status(speech_tx_2mic_ns4_st,
@@ -1240,31 +1508,40 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
     for (int i = 0, j = 0; i < pcm_len / 2; i++, j += 2)
       pcm16[i] = pcm16[j];
   }
+  SPEECH_PROF_STOP(TX_2MIC_NS4);
   // Channel num: two-->one
   pcm_len >>= 1;
 #endif
 
 #if defined(SPEECH_TX_2MIC_NS5)
+  SPEECH_PROF_START(TX_2MIC_NS5);
   leftright_denoise_process(speech_tx_2mic_ns5_st, pcm_buf, pcm_len, pcm_buf);
+  SPEECH_PROF_STOP(TX_2MIC_NS5);
   // Channel num: two-->one
   pcm_len >>= 1;
 #endif
 
 #if defined(SPEECH_TX_2MIC_NS6)
   // TRACE(0,"NS6");
+  SPEECH_PROF_START(TX_2MIC_NS6);
   speech_2mic_ns6_process(speech_tx_2mic_ns6_st, pcm_buf, pcm_len, pcm_buf);
+  SPEECH_PROF_STOP(TX_2MIC_NS6);
   // Channel num: two-->one
   pcm_len >>= 1;
 #endif
 
 #if defined(SPEECH_TX_3MIC_NS)
+  SPEECH_PROF_START(TX_3MIC_NS);
   speech_3mic_ns_process(speech_tx_3mic_ns_st, pcm_buf, pcm_len, pcm_buf);
+  SPEECH_PROF_STOP(TX_3MIC_NS);
   // Channel num: three-->one
   pcm_len = pcm_len / 3;
 #endif
 
 #if defined(SPEECH_TX_3MIC_NS3)
+  SPEECH_PROF_START(TX_3MIC_NS3);
   triple_mic_denoise3_process(speech_tx_3mic_ns3_st, pcm_buf, pcm_len, pcm_buf);
+  SPEECH_PROF_STOP(TX_3MIC_NS3);
   // Channel num: three-->one
   pcm_len = pcm_len / 3;
 #endif
@@ -1280,19 +1557,25 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
 #endif
 
 #if defined(SPEECH_TX_AEC)
+  SPEECH_PROF_START(TX_AEC);
   speech_aec_process(speech_tx_aec_st, pcm_buf, ref_buf, pcm_len, aec_out_buf);
   speech_copy_int16(pcm_buf, aec_out_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_AEC);
 #endif
 
 #if defined(SPEECH_TX_AEC2)
+  SPEECH_PROF_START(TX_AEC2);
   speech_aec2_process(speech_tx_aec2_st, pcm_buf, ref_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_AEC2);
 #endif
 
 #if defined(SPEECH_TX_AEC3)
+  SPEECH_PROF_START(TX_AEC3);
   CODEC_OpVecCpy(bufferstate + delay, ref_buf, pcm_len);
   CODEC_OpVecCpy(buf_out, bufferstate, pcm_len);
   CODEC_OpVecCpy(bufferstate, bufferstate + pcm_len, delay);
   SubBandAec_process(speech_tx_aec3_st, pcm_buf, buf_out, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_AEC3);
   // audio_dump_add_channel_data(1, pcm_buf, pcm_len);
 #endif
 
@@ -1305,10 +1588,16 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
           sensormic_denoise_get_vad(speech_tx_2mic_ns4_st));
   ec2float_set_external_vad(speech_tx_aec2float_st,
                             sensormic_denoise_get_vad(speech_tx_2mic_ns4_st));
+#endif
+#if !defined(SCO_CP_ACCEL)
+  SPEECH_PROF_START(TX_AEC2FLOAT);
 #endif
   ec2float_process(speech_tx_aec2float_st, pcm_buf, ref_buf, pcm_len,
                    aec_out_buf);
   speech_copy_int16(pcm_buf, aec_out_buf, pcm_len);
+#if !defined(SCO_CP_ACCEL)
+  SPEECH_PROF_STOP(TX_AEC2FLOAT);
+#endif
 #endif
 
   SCO_CP_ACCEL_ALGO_END();
@@ -1318,14 +1607,19 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
 #endif
 
 #if defined(SPEECH_TX_NS)
+  SPEECH_PROF_START(TX_NS);
   speech_ns_process(speech_tx_ns_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_NS);
 #endif
 
 #if defined(SPEECH_TX_NS2)
+  SPEECH_PROF_START(TX_NS2);
   speech_ns2_process(speech_tx_ns2_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_NS2);
 #endif
 
 #if defined(SPEECH_TX_NS2FLOAT)
+  SPEECH_PROF_START(TX_NS2FLOAT);
 #if defined(SPEECH_TX_2MIC_NS4)
   if (dualmic_enable == true)
     speech_ns2float_set_external_vad(
@@ -1333,14 +1627,19 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
         sensormic_denoise_get_vad(speech_tx_2mic_ns4_st));
 #endif
   speech_ns2float_process(speech_tx_ns2float_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_NS2FLOAT);
 #endif
 
 #if defined(SPEECH_TX_NS3)
+  SPEECH_PROF_START(TX_NS3);
   ns3_process(speech_tx_ns3_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_NS3);
 #endif
 
 #if defined(SPEECH_TX_WNR)
+  SPEECH_PROF_START(TX_WNR);
   wnr_process(speech_tx_wnr_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_WNR);
 #endif
 
 #if defined(BT_SCO_CHAIN_AUDIO_DUMP)
@@ -1348,7 +1647,9 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
 #endif
 
 #if defined(SPEECH_TX_NOISE_GATE)
+  SPEECH_PROF_START(TX_NOISE_GATE);
   speech_noise_gate_process(speech_tx_noise_gate_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_NOISE_GATE);
 #endif
 
 #if defined(BT_SCO_CHAIN_AUDIO_DUMP)
@@ -1356,15 +1657,21 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
 #endif
 
 #if defined(SPEECH_TX_COMPEXP)
+  SPEECH_PROF_START(TX_COMPEXP);
   compexp_process(speech_tx_compexp_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_COMPEXP);
 #endif
 
 #if defined(SPEECH_TX_AGC)
+  SPEECH_PROF_START(TX_AGC);
   agc_process(speech_tx_agc_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_AGC);
 #endif
 
 #if defined(SPEECH_TX_EQ)
+  SPEECH_PROF_START(TX_EQ);
   eq_process(speech_tx_eq_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_EQ);
 #endif
 
 #if defined(BT_SCO_CHAIN_AUDIO_DUMP)
@@ -1372,7 +1679,9 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
 #endif
 
 #if defined(SPEECH_TX_POST_GAIN)
+  SPEECH_PROF_START(TX_POST_GAIN);
   speech_gain_process(speech_tx_post_gain_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(TX_POST_GAIN);
 #endif
 
 #if defined(BT_SCO_CHAIN_AUDIO_DUMP)
@@ -1382,6 +1691,9 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
   audio_dump_run();
 #endif
 
+  AUDIO_CAPTURE_POINT(AUDIO_CAPTURE_TAP_SCO_TX_OUT, pcm_buf, pcm_len, 1, 16,
+                      speech_tx_sample_rate);
+
 #if defined(SPEECH_TX_24BIT)
   tx_pcmbuf16 = (int16_t *)pcm_buf;
   tx_pcmbuf32 = (int32_t *)pcm_buf;
@@ -1391,12 +1703,6 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
 #endif
 
   *_pcm_len = pcm_len;
-
-#if defined(BT_SCO_CHAIN_PROFILE)
-  tx_end_ticks = hal_fast_sys_timer_get();
-  TRACE(2, "[%s] takes %d us", __FUNCTION__,
-        FAST_TICKS_TO_US(tx_end_ticks - tx_start_ticks));
-#endif
 }
 
 #if defined(SCO_CP_ACCEL)
@@ -1413,21 +1719,26 @@ int sco_cp_algo(short *pcm_buf, short *ref_buf, int *_pcm_len) {
 #endif
 
 int32_t _speech_tx_process_(void *pcm_buf, void *ref_buf, int32_t *_pcm_len) {
+  speech_prof_frame_start();
+  SPEECH_PROF_START(TX_FRAME);
+
   _speech_tx_process_pre(pcm_buf, ref_buf, (int *)_pcm_len);
 #if defined(SCO_CP_ACCEL)
   sco_cp_process(pcm_buf, ref_buf, (int *)_pcm_len);
   _speech_tx_process_post(pcm_buf, ref_buf, (int *)_pcm_len);
 #endif
 
+  SPEECH_PROF_STOP(TX_FRAME);
+  speech_prof_frame_end();
+
   return 0;
 }
 
 int32_t _speech_rx_process_(void *pcm_buf, int32_t *_pcm_len) {
   int32_t pcm_len = *_pcm_len;
 
-#if defined(BT_SCO_CHAIN_PROFILE)
-  uint32_t start_ticks = hal_fast_sys_timer_get();
-#endif
+  speech_prof_frame_start();
+  SPEECH_PROF_START(RX_FRAME);
 
 #if defined(SPEECH_RX_24BIT)
   int32_t *buf32 = (int32_t *)pcm_buf;
@@ -1441,34 +1752,47 @@ int32_t _speech_rx_process_(void *pcm_buf, int32_t *_pcm_len) {
   // audio_dump_add_channel_data(0, pcm_buf, pcm_len);
 #endif
 
+  AUDIO_CAPTURE_POINT(AUDIO_CAPTURE_TAP_SCO_RX_IN, pcm_buf, pcm_len, 1, 16,
+                      speech_rx_sample_rate);
+
 #if defined(SPEECH_RX_NS)
+  SPEECH_PROF_START(RX_NS);
   speech_ns_process(speech_rx_ns_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(RX_NS);
 #endif
 
 #if defined(SPEECH_RX_NS2)
+  SPEECH_PROF_START(RX_NS2);
   // fix 0dB signal
   int16_t *pcm_buf16 = (int16_t *)pcm_buf;
   for (int i = 0; i < pcm_len; i++) {
     pcm_buf16[i] = (int16_t)(pcm_buf16[i] * 0.94);
   }
   speech_ns2_process(speech_rx_ns2_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(RX_NS2);
 #endif
 
 #if defined(SPEECH_RX_NS2FLOAT)
+  SPEECH_PROF_START(RX_NS2FLOAT);
   // FIXME
   int16_t *pcm_buf16 = (int16_t *)pcm_buf;
   for (int i = 0; i < pcm_len; i++) {
     pcm_buf16[i] = (int16_t)(pcm_buf16[i] * 0.94);
   }
   speech_ns2float_process(speech_rx_ns2float_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(RX_NS2FLOAT);
 #endif
 
 #ifdef SPEECH_RX_NS3
+  SPEECH_PROF_START(RX_NS3);
   ns3_process(speech_rx_ns3_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(RX_NS3);
 #endif
 
 #if defined(SPEECH_RX_AGC)
+  SPEECH_PROF_START(RX_AGC);
   agc_process(speech_rx_agc_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(RX_AGC);
 #endif
 
 #if defined(SPEECH_RX_24BIT)
@@ -1478,15 +1802,19 @@ int32_t _speech_rx_process_(void *pcm_buf, int32_t *_pcm_len) {
 #endif
 
 #if defined(SPEECH_RX_EQ)
+  SPEECH_PROF_START(RX_EQ);
 #if defined(SPEECH_RX_24BIT)
   eq_process_int24(speech_rx_eq_st, pcm_buf, pcm_len);
 #else
   eq_process(speech_rx_eq_st, pcm_buf, pcm_len);
 #endif
+  SPEECH_PROF_STOP(RX_EQ);
 #endif
 
 #if defined(SPEECH_RX_POST_GAIN)
+  SPEECH_PROF_START(RX_POST_GAIN);
   speech_gain_process(speech_rx_post_gain_st, pcm_buf, pcm_len);
+  SPEECH_PROF_STOP(RX_POST_GAIN);
 #endif
 
 #if defined(BT_SCO_CHAIN_AUDIO_DUMP)
@@ -1494,13 +1822,17 @@ int32_t _speech_rx_process_(void *pcm_buf, int32_t *_pcm_len) {
   // audio_dump_run();
 #endif
 
+#if defined(SPEECH_RX_24BIT)
+  AUDIO_CAPTURE_POINT(AUDIO_CAPTURE_TAP_SCO_RX_OUT, pcm_buf, pcm_len, 1, 24,
+                      speech_rx_sample_rate);
+#else
+  AUDIO_CAPTURE_POINT(AUDIO_CAPTURE_TAP_SCO_RX_OUT, pcm_buf, pcm_len, 1, 16,
+                      speech_rx_sample_rate);
+#endif
+
   *_pcm_len = pcm_len;
 
-#if defined(BT_SCO_CHAIN_PROFILE)
-  uint32_t end_ticks = hal_fast_sys_timer_get();
-  TRACE(2, "[%s] takes %d us", __FUNCTION__,
-        FAST_TICKS_TO_US(end_ticks - start_ticks));
-#endif
+  SPEECH_PROF_STOP(RX_FRAME);
 
   return 0;
 }
@@ -0,0 +1,118 @@
+#include "bt_sco_chain_profile.h"
+#include <string.h>
+
+#define PROF_MIN_SHIFT 10
+
+static const uint16_t speech_prof_levels_mhz[] = {26, 52, 78, 104, 208};
+
+#define PROF_LEVEL_NUM                                                         \
+  (sizeof(speech_prof_levels_mhz) / sizeof(speech_prof_levels_mhz[0]))
+
+static uint32_t prof_bin(uint32_t cycles) {
+  uint32_t msb, bin;
+
+  if (cycles < (1u << PROF_MIN_SHIFT))
+    return 0;
+  msb = 31 - __builtin_clz(cycles);
+  bin = (msb - PROF_MIN_SHIFT) * 4 + ((cycles >> (msb - 2)) & 3);
+  return bin < SPEECH_PROF_BINS ? bin : SPEECH_PROF_BINS - 1;
+}
+
+// Exclusive upper bound of the cycles counted in |bin|.
+static uint32_t prof_bin_limit(uint32_t bin) {
+  uint32_t msb = PROF_MIN_SHIFT + bin / 4;
+
+  return (4 + bin % 4 + 1) << (msb - 2);
+}
+
+void speech_prof_stat_init(SPEECH_PROF_STAT_T *st, const char *name) {
+  memset(st, 0, sizeof(*st));
+  st->name = name;
+}
+
+void speech_prof_stat_add(SPEECH_PROF_STAT_T *st, uint32_t cycles) {
+  st->bins[prof_bin(cycles)]++;
+  st->last = cycles;
+  if (cycles > st->max)
+    st->max = cycles;
+
+  if (++st->count >= SPEECH_PROF_WINDOW) {
+    st->count = 0;
+    for (int i = 0; i < SPEECH_PROF_BINS; i++) {
+      st->bins[i] >>= 1;
+      st->count += st->bins[i];
+    }
+    st->prev_max = st->max;
+    st->max = 0;
+  }
+}
+
+uint32_t speech_prof_stat_max(const SPEECH_PROF_STAT_T *st) {
+  return st->max > st->prev_max ? st->max : st->prev_max;
+}
+
+uint32_t speech_prof_stat_percentile(const SPEECH_PROF_STAT_T *st,
+                                     uint32_t permille) {
+  uint32_t target = (st->count * permille + 999) / 1000;
+  uint32_t seen = 0;
+  uint32_t max = speech_prof_stat_max(st);
+
+  if (st->count == 0)
+    return 0;
+  if (target == 0)
+    target = 1;
+
+  for (uint32_t i = 0; i < SPEECH_PROF_BINS; i++) {
+    seen += st->bins[i];
+    if (seen >= target) {
+      uint32_t limit = prof_bin_limit(i);
+      return (i == SPEECH_PROF_BINS - 1 || limit > max) ? max : limit;
+    }
+  }
+  return max;
+}
+
+static uint32_t prof_fit_level(uint32_t need_mips) {
+  for (uint32_t i = 0; i < PROF_LEVEL_NUM; i++) {
+    if (speech_prof_levels_mhz[i] * (100 - SPEECH_PROF_MARGIN_PCT) >=
+        need_mips * 100)
+      return i;
+  }
+  return PROF_LEVEL_NUM - 1;
+}
+
+uint32_t speech_prof_fit_mhz(uint32_t need_mips) {
+  return speech_prof_levels_mhz[prof_fit_level(need_mips)];
+}
+
+void speech_prof_gov_init(SPEECH_PROF_GOV_T *gov, uint32_t cur_mhz) {
+  gov->level = PROF_LEVEL_NUM - 1;
+  for (uint32_t i = 0; i < PROF_LEVEL_NUM; i++) {
+    if (speech_prof_levels_mhz[i] >= cur_mhz) {
+      gov->level = i;
+      break;
+    }
+  }
+  gov->down_votes = 0;
+}
+
+uint32_t speech_prof_gov_update(SPEECH_PROF_GOV_T *gov, uint32_t need_mips) {
+  uint32_t fit = prof_fit_level(need_mips);
+
+  if (fit > gov->level) {
+    gov->level = fit;
+    gov->down_votes = 0;
+  } else if (fit < gov->level) {
+    if (++gov->down_votes >= SPEECH_PROF_DOWN_VOTES) {
+      gov->level--;
+      gov->down_votes = 0;
+    }
+  } else {
+    gov->down_votes = 0;
+  }
+  return speech_prof_levels_mhz[gov->level];
+}
+
+uint32_t speech_prof_gov_mhz(const SPEECH_PROF_GOV_T *gov) {
+  return speech_prof_levels_mhz[gov->level];
+}
@@ -0,0 +1,62 @@
+#ifndef __BT_SCO_CHAIN_PROFILE_H__
+#define __BT_SCO_CHAIN_PROFILE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cycle statistics for the speech chain.
+//
+// Each stage of the chain keeps a histogram of the cycles it took per frame,
+// with four bins per octave from 1K to 4M cycles, so p50/p99 come out within
+// one bin (19%) and always on the high side. When a stage has seen
+// SPEECH_PROF_WINDOW frames all bins are halved, so the statistics follow
+// the last few seconds rather than the whole call. The maximum is exact and
+// covers the current and the previous window.
+//
+// The governor turns the measured load into a system clock: it steps up as
+// soon as the load no longer fits with SPEECH_PROF_MARGIN_PCT to spare, and
+// steps down one level at a time once the lower level has fitted for
+// SPEECH_PROF_DOWN_VOTES evaluations in a row.
+
+#define SPEECH_PROF_BINS 48
+#define SPEECH_PROF_WINDOW 256
+#define SPEECH_PROF_MARGIN_PCT 20
+#define SPEECH_PROF_DOWN_VOTES 4
+
+typedef struct {
+  const char *name;
+  uint16_t bins[SPEECH_PROF_BINS];
+  uint16_t count;
+  uint32_t last;
+  uint32_t max;
+  uint32_t prev_max;
+} SPEECH_PROF_STAT_T;
+
+typedef struct {
+  uint8_t level;
+  uint8_t down_votes;
+} SPEECH_PROF_GOV_T;
+
+void speech_prof_stat_init(SPEECH_PROF_STAT_T *st, const char *name);
+void speech_prof_stat_add(SPEECH_PROF_STAT_T *st, uint32_t cycles);
+// Cycles under which |permille| of the frames in the window fell; 0 if none.
+uint32_t speech_prof_stat_percentile(const SPEECH_PROF_STAT_T *st,
+                                     uint32_t permille);
+uint32_t speech_prof_stat_max(const SPEECH_PROF_STAT_T *st);
+
+// Lowest clock, in MHz, that runs |need_mips| with the margin to spare.
+uint32_t speech_prof_fit_mhz(uint32_t need_mips);
+
+void speech_prof_gov_init(SPEECH_PROF_GOV_T *gov, uint32_t cur_mhz);
+// Takes one load measurement and returns the clock to run at, in MHz.
+uint32_t speech_prof_gov_update(SPEECH_PROF_GOV_T *gov, uint32_t need_mips);
+uint32_t speech_prof_gov_mhz(const SPEECH_PROF_GOV_T *gov);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __BT_SCO_CHAIN_PROFILE_H__
@@ -35,7 +35,7 @@
 /* check msbc sequence number */
 #define ENABLE_SEQ_CHECK
 
-#ifdef ENABLE_CRC_CHECK
+// CRC-8 of SBC, x^8 + x^4 + x^3 + x^2 + 1, one byte per lookup.
 static const uint8_t sbc_crc_tbl[256] = {
     0x00, 0x1D, 0x3A, 0x27, 0x74, 0x69, 0x4E, 0x53, 0xE8, 0xF5, 0xD2, 0xCF,
     0x9C, 0x81, 0xA6, 0xBB, 0xCD, 0xD0, 0xF7, 0xEA, 0xB9, 0xA4, 0x83, 0x9E,
@@ -59,30 +59,53 @@ static const uint8_t sbc_crc_tbl[256] = {
     0xC6, 0xDB, 0xFC, 0xE1, 0x5A, 0x47, 0x60, 0x7D, 0x2E, 0x33, 0x14, 0x09,
     0x7F, 0x62, 0x45, 0x58, 0x0B, 0x16, 0x31, 0x2C, 0x97, 0x8A, 0xAD, 0xB0,
     0xE3, 0xFE, 0xD9, 0xC4};
+
+uint8_t sbc_crc8(const uint8_t *data, uint32_t bits) {
+  uint8_t fcs = SBC_CRC_INIT;
+  uint32_t i;
+
+  for (i = 0; i < bits / 8; i++)
+    fcs = sbc_crc_tbl[fcs ^ data[i]];
+  // A trailing part byte, most significant bit first.
+  for (uint32_t b = 0; b < bits % 8; b++) {
+    uint8_t bit = (uint8_t)(((data[i] >> (7 - b)) ^ (fcs >> 7)) & 0x01);
+    fcs = (uint8_t)(fcs << 1);
+    if (bit)
+      fcs ^= 0x1D;
+  }
+  return fcs;
+}
+
+// mSBC fixes the two header bytes after the syncword to zero, so the CRC
+// always has the same value by the time it reaches the scale factors.
+#define MSBC_CRC_AFTER_HEADER 0xA3
+
+static inline uint32_t msbc_load_le32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+// H2 header (0x01, sequence bits and 0x8) followed by the SBC syncword,
+// as a little-endian word over bytes 0-2.
+#if defined(MSBC_SYNC_HACKER)
+// Byte 0 may also read 0x00.
+#define MSBC_SYNC_MASK 0x00FF0FFEu
+#else
+#define MSBC_SYNC_MASK 0x00FF0FFFu
 #endif
+#define MSBC_SYNC_WORD 0x00AD0801u
 
-static int sco_parse_synchronization_header(uint8_t *buf, uint8_t *sn) {
+int msbc_check_frame(const uint8_t *buf, uint8_t *sn) {
+  uint32_t head = msbc_load_le32(buf);
   uint8_t sn1, sn2;
-#ifdef ENABLE_CRC_CHECK
-  uint8_t fcs = 0x0F;
-  uint8_t crc = 0;
-  uint8_t i, sb, bit, shift;
-  uint8_t ind = 6, bitOffset = 24;
-#endif
+
   *sn = 0xff;
-#if defined(MSBC_SYNC_HACKER)
-  if (((buf[0] != 0x01) && (buf[0] != 0x00)) || ((buf[1] & 0x0f) != 0x08) ||
-      (buf[2] != 0xad)) {
+  if ((head & MSBC_SYNC_MASK) != (MSBC_SYNC_WORD & MSBC_SYNC_MASK))
     return -1;
-  }
-#else
-  if ((buf[0] != 0x01) || ((buf[1] & 0x0f) != 0x08) || (buf[2] != 0xad)) {
-    return -1;
-  }
-#endif
 
-  sn1 = (buf[1] & 0x30) >> 4;
-  sn2 = (buf[1] & 0xc0) >> 6;
+  // Each sequence bit is sent twice.
+  sn1 = (buf[1] >> 4) & 0x03;
+  sn2 = buf[1] >> 6;
   if ((sn1 != 0) && (sn1 != 0x3)) {
     return -2;
   }
@@ -91,40 +114,20 @@ static int sco_parse_synchronization_header(uint8_t *buf, uint8_t *sn) {
   }
 
 #ifdef ENABLE_CRC_CHECK
-  fcs = sbc_crc_tbl[fcs ^ buf[3]];
-  if (buf[3] != 0x00)
-    return -4;
-  fcs = sbc_crc_tbl[fcs ^ buf[4]];
-  if (buf[4] != 0x00)
-    return -4;
-  crc = buf[5];
-  for (sb = 0; sb < 8; sb++) {
-    if (bitOffset % 8) {
-      /* Sum the whole byte */
-      fcs = sbc_crc_tbl[fcs ^ buf[ind]];
-      ind = ind + 1;
-    } else {
-      if (sb == 7) {
-        /* Sum the next 4 bits */
-
-        /* Just sum the most significant 4 bits */
-        shift = 7;
-        for (i = 0; i < 4; i++) {
-          bit = (uint8_t)((0x01 & (buf[ind] >> shift--)) ^ (fcs >> 7));
-          if (bit) {
-            fcs = (uint8_t)(((fcs << 1) | bit) ^ 0x1C);
-          } else {
-            fcs = (uint8_t)((fcs << 1));
-          }
-        }
-      }
-    }
-
-    bitOffset += 4;
+  {
+    uint32_t sf = msbc_load_le32(&buf[6]);
+    uint8_t fcs = MSBC_CRC_AFTER_HEADER;
+
+    if ((head >> 24) != 0x00 || buf[4] != 0x00)
+      return -4;
+    // One mono channel of 8 subbands: 4 bytes of scale factors.
+    fcs = sbc_crc_tbl[fcs ^ (uint8_t)sf];
+    fcs = sbc_crc_tbl[fcs ^ (uint8_t)(sf >> 8)];
+    fcs = sbc_crc_tbl[fcs ^ (uint8_t)(sf >> 16)];
+    fcs = sbc_crc_tbl[fcs ^ (uint8_t)(sf >> 24)];
+    if (buf[5] != fcs)
+      return -4;
   }
-  // TRACE(2,"msbc crc:%d fcs:%d", crc,fcs);
-  if (crc != fcs)
-    return -4;
 #endif
 
   *sn = (sn1 & 0x01) | (sn2 & 0x02);
@@ -139,26 +142,33 @@ static int sco_parse_synchronization_header(uint8_t *buf, uint8_t *sn) {
   return 0;
 }
 
-#ifdef ENABLE_BLE_CONFLICT_CHECK
-static bool memcmp_U8(uint8_t *x, uint8_t *y, uint16_t size) {
-  for (int i = 0; i < size; i++) {
-    if (x[i] != y[i])
-      return true;
-  }
+uint32_t msbc_check_frames(const uint8_t *buf, uint32_t stride,
+                           uint32_t count, int8_t *err, uint8_t *sn) {
+  uint32_t good = 0;
 
-  return false;
+  if (count > MSBC_CHECK_MAX_FRAMES)
+    count = MSBC_CHECK_MAX_FRAMES;
+  for (uint32_t i = 0; i < count; i++, buf += stride) {
+    err[i] = (int8_t)msbc_check_frame(buf, &sn[i]);
+    if (err[i] == 0)
+      good |= 1u << i;
+  }
+  return good;
 }
 
+#ifdef ENABLE_BLE_CONFLICT_CHECK
 // when signal is mute, msbc data remains the same except seq num. We should
 // check history flag, otherwise a single conflict may be detected twice
-static bool update_ble_sco_conflict(PacketLossState *st, uint8_t *last_pkt,
-                                    uint8_t *pkt) {
+static bool update_ble_sco_conflict(PacketLossState *st, uint8_t *pkt) {
+  // The two previous packets take turns in last_pkt; the older one is
+  // compared and then overwritten.
+  uint8_t *older = &st->last_pkt[st->last_pkt_idx * MSBC_PKTSIZE];
   // do not check padding byte as it maybe useless when msbc_offset is 1
   bool ret = (st->prev_ble_sco_conflict_flag[1] == false &&
-              memcmp_U8(last_pkt, pkt, MSBC_PKTSIZE - 1) == false);
+              memcmp(older, pkt, MSBC_PKTSIZE - 1) == 0);
 
-  memcpy(&last_pkt[0], &last_pkt[MSBC_PKTSIZE], MSBC_PKTSIZE);
-  memcpy(&last_pkt[MSBC_PKTSIZE], pkt, MSBC_PKTSIZE);
+  memcpy(older, pkt, MSBC_PKTSIZE);
+  st->last_pkt_idx ^= 1;
 
   return ret;
 }
@@ -203,20 +213,20 @@ void packet_loss_detection_init(PacketLossState *st) {
   st->last_seq_num = 0xff;
 
   memset(st->last_pkt, 0, sizeof(st->last_pkt));
+  st->last_pkt_idx = 0;
   memset(st->prev_ble_sco_conflict_flag, 0,
          sizeof(st->prev_ble_sco_conflict_flag));
   memset(st->hist, 0, sizeof(st->hist));
 }
 
-plc_type_t packet_loss_detection_process(PacketLossState *st,
-                                         uint8_t *sbc_buf) {
+static plc_type_t plc_detect(PacketLossState *st, uint8_t *sbc_buf,
+                             bool checked, int err, uint8_t seq_num) {
   plc_type_t plc_type = PLC_TYPE_PASS;
 
 #ifdef ENABLE_BLE_CONFLICT_CHECK
-  bool ble_sco_conflict = update_ble_sco_conflict(st, st->last_pkt, sbc_buf);
+  bool ble_sco_conflict = update_ble_sco_conflict(st, sbc_buf);
 #endif
 
-  uint8_t seq_num;
   if (msbc_check_controller_mute_pattern(sbc_buf, MSBC_MUTE_PATTERN) == true) {
     plc_type = PLC_TYPE_CONTROLLER_MUTE;
     st->last_seq_num = 0xff;
@@ -228,7 +238,8 @@ plc_type_t packet_loss_detection_process(PacketLossState *st,
   }
 #endif
   else {
-    int err = sco_parse_synchronization_header(sbc_buf, &seq_num);
+    if (!checked)
+      err = msbc_check_frame(sbc_buf, &seq_num);
     if (err < 0 && err >= -3) {
       plc_type = PLC_TYPE_HEADER_ERROR;
       st->last_seq_num = 0xff;
@@ -283,6 +294,17 @@ plc_type_t packet_loss_detection_process(PacketLossState *st,
   return plc_type;
 }
 
+plc_type_t packet_loss_detection_process(PacketLossState *st,
+                                         uint8_t *sbc_buf) {
+  return plc_detect(st, sbc_buf, false, 0, 0xff);
+}
+
+plc_type_t packet_loss_detection_process_checked(PacketLossState *st,
+                                                 uint8_t *sbc_buf, int err,
+                                                 uint8_t sn) {
+  return plc_detect(st, sbc_buf, true, err, sn);
+}
+
 void packet_loss_detection_update_histogram(PacketLossState *st,
                                             plc_type_t plc_type) {
   if (plc_type < 0 || plc_type >= PLC_TYPE_NUM) {
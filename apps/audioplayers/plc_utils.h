@@ -23,6 +23,7 @@ typedef struct
 {
     uint8_t last_seq_num;
     uint8_t last_pkt[60 * 2];
+    uint8_t last_pkt_idx;
 
     // for ble sco conflict
     bool prev_ble_sco_conflict_flag[2];
@@ -35,10 +36,44 @@ typedef struct
 extern "C" {
 #endif
 
+#define SBC_CRC_INIT 0x0F
+// Most frames msbc_check_frames() checks in one call.
+#define MSBC_CHECK_MAX_FRAMES 32
+
+/*
+ * SBC CRC-8 over the first |bits| bits of |data|, table driven a byte at a
+ * time. The CRC starts from SBC_CRC_INIT.
+ */
+uint8_t sbc_crc8(const uint8_t *data, uint32_t bits);
+
+/*
+ * Check the H2 synchronization header and the SBC header CRC of one 60-byte
+ * mSBC packet. Returns 0 if good, -1 to -3 for a bad synchronization header,
+ * -4 for a CRC error and -5 for a bad padding byte. |sn| gets the sequence
+ * number, or 0xff when the header is bad.
+ */
+int msbc_check_frame(const uint8_t *buf, uint8_t *sn);
+
+/*
+ * Check |count| packets placed |stride| bytes apart, such as a DMA snapshot,
+ * in one call. |err| and |sn| get what msbc_check_frame() returns for each.
+ * Returns a mask with bit i set when packet i is good.
+ */
+uint32_t msbc_check_frames(const uint8_t *buf, uint32_t stride,
+                           uint32_t count, int8_t *err, uint8_t *sn);
+
 void packet_loss_detection_init(PacketLossState *st);
 
 plc_type_t packet_loss_detection_process(PacketLossState *st, uint8_t *sbc_buf);
 
+/*
+ * As packet_loss_detection_process(), for a packet whose header has already
+ * been checked by msbc_check_frames().
+ */
+plc_type_t packet_loss_detection_process_checked(PacketLossState *st,
+                                                 uint8_t *sbc_buf, int err,
+                                                 uint8_t sn);
+
 /*
  * Update plc type histogram
  * Normally this function is called at the end of packet_loss_detection_process,
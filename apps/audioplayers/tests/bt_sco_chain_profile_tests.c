@@ -0,0 +1,138 @@
+#include "bt_sco_chain_profile.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng(void) {
+  rng_state = rng_state * 1103515245u + 12345u;
+  return rng_state >> 8;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+// The histogram answer must never be below the true percentile, and at most
+// one bin (a quarter octave) above it.
+static void check_percentile(const SPEECH_PROF_STAT_T *st, uint32_t *sorted,
+                             uint32_t n, uint32_t permille) {
+  uint32_t rank = (n * permille + 999) / 1000;
+  uint32_t exact = sorted[(rank ? rank : 1) - 1];
+  uint32_t got = speech_prof_stat_percentile(st, permille);
+
+  assert(got >= exact);
+  assert((uint64_t)got * 4 <= (uint64_t)exact * 5 + 4);
+}
+
+static void test_percentiles_bound_exact_values(void) {
+  SPEECH_PROF_STAT_T st;
+  uint32_t samples[SPEECH_PROF_WINDOW - 1];
+  uint32_t n = sizeof(samples) / sizeof(samples[0]);
+
+  speech_prof_stat_init(&st, "test");
+  assert(speech_prof_stat_percentile(&st, 500) == 0);
+  for (uint32_t i = 0; i < n; i++) {
+    // Mostly around 300K cycles, with a tail up to 2M.
+    samples[i] = 200000 + rng() % 200000;
+    if (rng() % 50 == 0)
+      samples[i] += rng() % 1800000;
+    speech_prof_stat_add(&st, samples[i]);
+  }
+  qsort(samples, n, sizeof(samples[0]), cmp_u32);
+
+  check_percentile(&st, samples, n, 500);
+  check_percentile(&st, samples, n, 990);
+  assert(speech_prof_stat_max(&st) == samples[n - 1]);
+  assert(speech_prof_stat_percentile(&st, 1000) == samples[n - 1]);
+  assert(st.last != 0);
+}
+
+static void test_small_and_huge_values(void) {
+  SPEECH_PROF_STAT_T st;
+
+  speech_prof_stat_init(&st, "test");
+  speech_prof_stat_add(&st, 10);
+  // Below the first bin the answer is capped by the exact maximum.
+  assert(speech_prof_stat_percentile(&st, 500) == 10);
+  speech_prof_stat_add(&st, 50000000);
+  assert(speech_prof_stat_percentile(&st, 990) == 50000000);
+  assert(speech_prof_stat_max(&st) == 50000000);
+}
+
+static void test_window_forgets_old_load(void) {
+  SPEECH_PROF_STAT_T st;
+
+  speech_prof_stat_init(&st, "test");
+  for (int i = 0; i < SPEECH_PROF_WINDOW; i++)
+    speech_prof_stat_add(&st, 1000000);
+  for (int i = 0; i < 4 * SPEECH_PROF_WINDOW; i++)
+    speech_prof_stat_add(&st, 100000);
+
+  assert(st.count < SPEECH_PROF_WINDOW);
+  assert(speech_prof_stat_percentile(&st, 990) < 125000);
+  // The maximum covers the last two windows only.
+  assert(speech_prof_stat_max(&st) == 100000);
+
+  // A fresh peak shows up at once.
+  speech_prof_stat_add(&st, 900000);
+  assert(speech_prof_stat_max(&st) == 900000);
+  assert(speech_prof_stat_percentile(&st, 990) < 125000);
+}
+
+static void test_fit_keeps_margin(void) {
+  assert(speech_prof_fit_mhz(0) == 26);
+  assert(speech_prof_fit_mhz(20) == 26);
+  assert(speech_prof_fit_mhz(21) == 52);
+  assert(speech_prof_fit_mhz(62) == 78);
+  assert(speech_prof_fit_mhz(83) == 104);
+  assert(speech_prof_fit_mhz(84) == 208);
+  assert(speech_prof_fit_mhz(1000) == 208);
+}
+
+static void test_governor_steps_down_slowly_and_up_at_once(void) {
+  SPEECH_PROF_GOV_T gov;
+  int i;
+
+  speech_prof_gov_init(&gov, 104);
+  assert(speech_prof_gov_mhz(&gov) == 104);
+
+  // A light load walks the clock down one level per SPEECH_PROF_DOWN_VOTES.
+  for (i = 0; i < SPEECH_PROF_DOWN_VOTES - 1; i++)
+    assert(speech_prof_gov_update(&gov, 30) == 104);
+  assert(speech_prof_gov_update(&gov, 30) == 78);
+  for (i = 0; i < SPEECH_PROF_DOWN_VOTES; i++)
+    speech_prof_gov_update(&gov, 30);
+  assert(speech_prof_gov_mhz(&gov) == 52);
+  for (i = 0; i < 4 * SPEECH_PROF_DOWN_VOTES; i++)
+    assert(speech_prof_gov_update(&gov, 30) == 52);
+
+  // A vote that fits the current level restarts the count.
+  speech_prof_gov_init(&gov, 78);
+  for (i = 0; i < SPEECH_PROF_DOWN_VOTES - 1; i++)
+    speech_prof_gov_update(&gov, 30);
+  assert(speech_prof_gov_update(&gov, 60) == 78);
+  for (i = 0; i < SPEECH_PROF_DOWN_VOTES - 1; i++)
+    assert(speech_prof_gov_update(&gov, 30) == 78);
+  assert(speech_prof_gov_update(&gov, 30) == 52);
+
+  // Overload jumps straight to the level that fits.
+  assert(speech_prof_gov_update(&gov, 90) == 208);
+  speech_prof_gov_init(&gov, 300);
+  assert(speech_prof_gov_mhz(&gov) == 208);
+  speech_prof_gov_init(&gov, 0);
+  assert(speech_prof_gov_mhz(&gov) == 26);
+}
+
+int main(void) {
+  test_percentiles_bound_exact_values();
+  test_small_and_huge_values();
+  test_window_forgets_old_load();
+  test_fit_keeps_margin();
+  test_governor_steps_down_slowly_and_up_at_once();
+  printf("bt_sco_chain_profile tests passed\n");
+  return 0;
+}
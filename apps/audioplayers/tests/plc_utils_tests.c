@@ -0,0 +1,271 @@
+#include "plc_utils.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PKT 60
+
+// mSBC encoding of 120 samples of silence, as sent by most phones.
+static const uint8_t msbc_silence[PKT] = {
+    0x01, 0x08, 0xAD, 0x00, 0x00, 0xC5, 0x00, 0x00, 0x00, 0x00, 0x77, 0x6D,
+    0xB6, 0xDD, 0xDB, 0x6D, 0xB7, 0x76, 0xDB, 0x6D, 0xDD, 0xB6, 0xDB, 0x77,
+    0x6D, 0xB6, 0xDD, 0xDB, 0x6D, 0xB7, 0x76, 0xDB, 0x6D, 0xDD, 0xB6, 0xDB,
+    0x77, 0x6D, 0xB6, 0xDD, 0xDB, 0x6D, 0xB7, 0x76, 0xDB, 0x6D, 0xDD, 0xB6,
+    0xDB, 0x77, 0x6D, 0xB6, 0xDD, 0xDB, 0x6D, 0xB7, 0x76, 0xDB, 0x6C, 0x00};
+
+// Second octet of the H2 header for sequence numbers 0-3.
+static const uint8_t h2_seq[4] = {0x08, 0x38, 0xC8, 0xF8};
+
+static uint32_t rng = 1;
+
+static uint8_t rand_byte(void) {
+  rng = rng * 1664525u + 1013904223u;
+  return (uint8_t)(rng >> 24);
+}
+
+// Bit-serial CRC straight from the SBC specification.
+static uint8_t ref_crc8(const uint8_t *data, uint32_t bits) {
+  uint8_t fcs = SBC_CRC_INIT;
+
+  for (uint32_t i = 0; i < bits; i++) {
+    uint8_t bit = (data[i / 8] >> (7 - i % 8)) & 1;
+    uint8_t top = fcs >> 7;
+
+    fcs = (uint8_t)(fcs << 1);
+    if (bit ^ top)
+      fcs ^= 0x1D;
+  }
+  return fcs;
+}
+
+// A well-formed packet with random scale factors and audio.
+static void make_packet(uint8_t *pkt, uint8_t seq) {
+  uint8_t crc_in[6];
+
+  for (int i = 0; i < PKT; i++)
+    pkt[i] = rand_byte();
+  pkt[0] = 0x01;
+  pkt[1] = h2_seq[seq & 3];
+  pkt[2] = 0xAD;
+  pkt[3] = 0x00;
+  pkt[4] = 0x00;
+  crc_in[0] = pkt[3];
+  crc_in[1] = pkt[4];
+  memcpy(&crc_in[2], &pkt[6], 4);
+  pkt[5] = ref_crc8(crc_in, 6 * 8);
+  pkt[PKT - 1] = 0x00;
+}
+
+static void test_crc8_matches_bitwise(void) {
+  uint8_t data[64];
+
+  for (int n = 0; n < 2000; n++) {
+    uint32_t bits = rand_byte() % (8 * sizeof(data) + 1);
+
+    for (uint32_t i = 0; i < sizeof(data); i++)
+      data[i] = rand_byte();
+    assert(sbc_crc8(data, bits) == ref_crc8(data, bits));
+  }
+}
+
+static void test_silence_frame_is_good(void) {
+  uint8_t sn;
+  uint8_t crc_in[6] = {0, 0, 0, 0, 0, 0};
+
+  assert(sbc_crc8(crc_in, 48) == 0xC5);
+  assert(msbc_check_frame(msbc_silence, &sn) == 0 && sn == 0);
+}
+
+static void test_good_packets_pass(void) {
+  uint8_t pkt[PKT], sn;
+
+  for (int n = 0; n < 4000; n++) {
+    make_packet(pkt, (uint8_t)n);
+    assert(msbc_check_frame(pkt, &sn) == 0);
+    assert(sn == (n & 3));
+  }
+}
+
+static void test_header_errors(void) {
+  uint8_t pkt[PKT], sn;
+
+  make_packet(pkt, 1);
+  pkt[0] = 0x02;
+  assert(msbc_check_frame(pkt, &sn) == -1 && sn == 0xff);
+  make_packet(pkt, 1);
+  pkt[1] = 0x09;
+  assert(msbc_check_frame(pkt, &sn) == -1);
+  make_packet(pkt, 1);
+  pkt[2] = 0x9C;
+  assert(msbc_check_frame(pkt, &sn) == -1);
+  // The two copies of a sequence bit disagree.
+  make_packet(pkt, 0);
+  pkt[1] = 0x18;
+  assert(msbc_check_frame(pkt, &sn) == -2 && sn == 0xff);
+  pkt[1] = 0x48;
+  assert(msbc_check_frame(pkt, &sn) == -3 && sn == 0xff);
+  // mSBC fixes the SBC header bytes after the syncword.
+  make_packet(pkt, 2);
+  pkt[3] = 0x10;
+  assert(msbc_check_frame(pkt, &sn) == -4);
+  make_packet(pkt, 2);
+  pkt[4] = 0x01;
+  assert(msbc_check_frame(pkt, &sn) == -4);
+}
+
+static void test_crc_catches_bit_errors(void) {
+  static const int covered[] = {5, 6, 7, 8, 9};
+  uint8_t pkt[PKT], bad[PKT], sn;
+
+  for (int n = 0; n < 200; n++) {
+    make_packet(pkt, (uint8_t)n);
+    // Every single and double bit error in the CRC byte and the scale
+    // factors.
+    for (int a = 0; a < 40; a++) {
+      memcpy(bad, pkt, PKT);
+      bad[covered[a / 8]] ^= (uint8_t)(1 << (a % 8));
+      assert(msbc_check_frame(bad, &sn) == -4);
+      for (int b = a + 1; b < 40; b++) {
+        uint8_t twice[PKT];
+
+        memcpy(twice, bad, PKT);
+        twice[covered[b / 8]] ^= (uint8_t)(1 << (b % 8));
+        assert(msbc_check_frame(twice, &sn) == -4);
+      }
+    }
+    // The subband samples are not covered.
+    memcpy(bad, pkt, PKT);
+    bad[30] ^= 0x40;
+    assert(msbc_check_frame(bad, &sn) == 0);
+  }
+}
+
+static void test_batch_matches_single(void) {
+  uint8_t snapshot[6 * PKT + 16];
+  int8_t err[6];
+  uint8_t sn[6];
+
+  for (int n = 0; n < 500; n++) {
+    // Odd offsets too: the DMA snapshot is not aligned to the packets.
+    uint32_t offset = rand_byte() % 16;
+    uint32_t expect = 0;
+
+    for (int i = 0; i < 6; i++) {
+      uint8_t *pkt = &snapshot[offset + i * PKT];
+
+      make_packet(pkt, (uint8_t)i);
+      if (rand_byte() & 1)
+        pkt[rand_byte() % 10] ^= (uint8_t)(1 << (rand_byte() % 8));
+    }
+    for (int i = 0; i < 6; i++) {
+      uint8_t one_sn;
+      int one = msbc_check_frame(&snapshot[offset + i * PKT], &one_sn);
+
+      if (one == 0)
+        expect |= 1u << i;
+      assert(one >= -4);
+      (void)one_sn;
+    }
+    assert(msbc_check_frames(&snapshot[offset], PKT, 6, err, sn) == expect);
+    for (int i = 0; i < 6; i++) {
+      uint8_t one_sn;
+
+      assert(err[i] == msbc_check_frame(&snapshot[offset + i * PKT], &one_sn));
+      assert(sn[i] == one_sn);
+    }
+  }
+}
+
+static void test_detection_types(void) {
+  PacketLossState st;
+  uint8_t pkt[PKT];
+
+  packet_loss_detection_init(&st);
+  for (int n = 0; n < 8; n++) {
+    make_packet(pkt, (uint8_t)n);
+    assert(packet_loss_detection_process(&st, pkt) == PLC_TYPE_PASS);
+  }
+  // Sequence 8 % 4 = 0 expected; 1 skips one.
+  make_packet(pkt, 1);
+  assert(packet_loss_detection_process(&st, pkt) ==
+         PLC_TYPE_SEQUENCE_DISCONTINUE);
+  make_packet(pkt, 2);
+  pkt[7] ^= 0x10;
+  assert(packet_loss_detection_process(&st, pkt) == PLC_TYPE_CRC_ERROR);
+  make_packet(pkt, 3);
+  pkt[2] = 0;
+  assert(packet_loss_detection_process(&st, pkt) == PLC_TYPE_HEADER_ERROR);
+
+  // The controller fills a lost packet with its mute pattern.
+  memset(pkt, 0x55, PKT);
+  assert(packet_loss_detection_process(&st, pkt) ==
+         PLC_TYPE_CONTROLLER_MUTE);
+
+  // A packet repeating the one two before means a BLE slot took the SCO one.
+  packet_loss_detection_init(&st);
+  uint8_t a[PKT], b[PKT];
+  make_packet(a, 0);
+  make_packet(b, 1);
+  assert(packet_loss_detection_process(&st, a) == PLC_TYPE_PASS);
+  assert(packet_loss_detection_process(&st, b) == PLC_TYPE_PASS);
+  assert(packet_loss_detection_process(&st, a) == PLC_TYPE_BLE_CONFLICT);
+  // and the sequence starts over after it.
+  make_packet(a, 3);
+  assert(packet_loss_detection_process(&st, a) == PLC_TYPE_PASS);
+  assert(st.hist[PLC_TYPE_PASS] == 3);
+  assert(st.hist[PLC_TYPE_BLE_CONFLICT] == 1);
+}
+
+static void test_checked_matches_unchecked(void) {
+  PacketLossState st1, st2;
+  uint8_t stream[6 * PKT];
+  int8_t err[6];
+  uint8_t sn[6];
+  uint32_t seq = 0;
+
+  packet_loss_detection_init(&st1);
+  packet_loss_detection_init(&st2);
+  for (int n = 0; n < 300; n++) {
+    for (int i = 0; i < 6; i++) {
+      uint8_t *pkt = &stream[i * PKT];
+      uint8_t r = rand_byte();
+
+      if (r < 16)
+        memset(pkt, 0x55, PKT);
+      else if (r < 24 && i >= 2)
+        memcpy(pkt, pkt - 2 * PKT, PKT);
+      else
+        make_packet(pkt, (uint8_t)(r < 40 ? seq + 2 : seq));
+      if (r >= 200)
+        pkt[rand_byte() % 10] ^= (uint8_t)(1 << (rand_byte() % 8));
+      seq++;
+    }
+    msbc_check_frames(stream, PKT, 6, err, sn);
+    for (int i = 0; i < 6; i++) {
+      plc_type_t t1 = packet_loss_detection_process(&st1, &stream[i * PKT]);
+      plc_type_t t2 = packet_loss_detection_process_checked(
+          &st2, &stream[i * PKT], err[i], sn[i]);
+      assert(t1 == t2);
+    }
+  }
+  assert(memcmp(st1.hist, st2.hist, sizeof(st1.hist)) == 0);
+  printf("  %u packets: %u pass, %u mute, %u ble, %u header, %u crc, %u seq\n",
+         300 * 6, st1.hist[PLC_TYPE_PASS], st1.hist[PLC_TYPE_CONTROLLER_MUTE],
+         st1.hist[PLC_TYPE_BLE_CONFLICT], st1.hist[PLC_TYPE_HEADER_ERROR],
+         st1.hist[PLC_TYPE_CRC_ERROR],
+         st1.hist[PLC_TYPE_SEQUENCE_DISCONTINUE]);
+}
+
+int main(void) {
+  test_crc8_matches_bitwise();
+  test_silence_frame_is_good();
+  test_good_packets_pass();
+  test_header_errors();
+  test_crc_catches_bit_errors();
+  test_batch_matches_single();
+  test_detection_types();
+  test_checked_matches_unchecked();
+  printf("plc_utils_tests: all passed\n");
+  return 0;
+}
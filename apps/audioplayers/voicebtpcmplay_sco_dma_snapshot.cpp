@@ -314,6 +314,9 @@ int process_downlink_msbc_frames(unsigned char *msbc_buf, unsigned int msbc_len,
   int msbc_offset_drift[6] = {
       0,
   };
+  int8_t msbc_err[6];
+  uint8_t msbc_sn[6];
+  bool msbc_checked = true;
 
   short *dec_pcm_buf = (short *)pcm_buf;
   unsigned char dec_msbc_buf[MSBC_LEN_PER_FRAME] = {
@@ -485,6 +488,18 @@ int process_downlink_msbc_frames(unsigned char *msbc_buf, unsigned int msbc_len,
       msbc_find_first_sync = 0;
   }
 
+  // Unless a packet has drifted, the packets sit MSBC_LEN_FORMBT_PER_FRAME
+  // bytes apart and their headers can all be checked in one go.
+  for (j = 0; j < msbc_len / MSBC_LEN_FORMBT_PER_FRAME; j++) {
+    if (msbc_offset_drift[j] != 0)
+      msbc_checked = false;
+  }
+  if (msbc_checked) {
+    msbc_check_frames(&msbc_buf_all[msbc_offset_lowdelay],
+                      MSBC_LEN_FORMBT_PER_FRAME,
+                      msbc_len / MSBC_LEN_FORMBT_PER_FRAME, msbc_err, msbc_sn);
+  }
+
   while ((frame_counter < msbc_len / MSBC_LEN_FORMBT_PER_FRAME) &&
          (frame_counter < pcm_len / BYTES_PER_PCM_FRAME)) {
     // TRACE(3,"[%s] decoding, offset %d, offset drift %d", __FUNCTION__,
@@ -509,7 +524,12 @@ int process_downlink_msbc_frames(unsigned char *msbc_buf, unsigned int msbc_len,
                                 MSBC_LEN_PER_FRAME / 2);
 #endif
 
-    plc_type_t plc_type = packet_loss_detection_process(&pld, dec_msbc_buf);
+    plc_type_t plc_type;
+    if (msbc_checked)
+      plc_type = packet_loss_detection_process_checked(
+          &pld, dec_msbc_buf, msbc_err[frame_counter], msbc_sn[frame_counter]);
+    else
+      plc_type = packet_loss_detection_process(&pld, dec_msbc_buf);
 
     if (plc_type != PLC_TYPE_PASS) {
       memset(dec_pcm_buf, 0, SAMPLES_LEN_PER_FRAME * sizeof(int16_t));
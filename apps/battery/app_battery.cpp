@@ -275,7 +275,12 @@ static void app_battery_event_process(enum APP_BATTERY_STATUS_T status,
   APP_BATTERY_SET_MESSAGE(app_battevt, status, volt);
   msg.msg_body.message_id = app_battevt;
   msg.msg_body.message_ptr = (uint32_t)NULL;
-  app_mailbox_put(&msg);
+  if (status == APP_BATTERY_STATUS_NORMAL) {
+    // Periodic voltage reading: only the latest one matters.
+    app_mailbox_put_coalesced(&msg, APP_MAILBOX_PRIO_LOW, 0xffff0000);
+  } else {
+    app_mailbox_put(&msg);
+  }
 }
 
 int app_battery_handle_process_normal(uint32_t status,
@@ -0,0 +1,162 @@
+#include "app_sysfreq_gov.h"
+#include <string.h>
+
+const uint16_t sysfreq_gov_level_mhz[SYSFREQ_GOV_LEVEL_QTY] = {26, 52, 78, 104,
+                                                               208};
+
+#define GOV_TOP_LEVEL (SYSFREQ_GOV_LEVEL_QTY - 1)
+// Reported peaks lose 1/SYSFREQ_GOV_DECAY of their height per period.
+#define SYSFREQ_GOV_DECAY 256
+
+void sysfreq_gov_init(SYSFREQ_GOV_T *gov, uint8_t headroom_pct,
+                      uint32_t down_hold_ms) {
+  memset(gov, 0, sizeof(*gov));
+  gov->headroom_pct = headroom_pct < 100 ? headroom_pct : 99;
+  gov->down_hold_ms = down_hold_ms;
+  gov->level = SYSFREQ_GOV_LEVEL_NONE;
+}
+
+static uint32_t gov_voter_mhz(const SYSFREQ_GOV_VOTER_T *v) {
+  if (!v->active || v->period_us == 0)
+    return 0;
+  return (v->budget_cycles + v->period_us - 1) / v->period_us;
+}
+
+uint32_t sysfreq_gov_load_mhz(const SYSFREQ_GOV_T *gov) {
+  uint32_t load = 0;
+
+  for (uint32_t i = 0; i < SYSFREQ_GOV_VOTER_QTY; i++)
+    load += gov_voter_mhz(&gov->voters[i]);
+  return load;
+}
+
+static int gov_fit_level(const SYSFREQ_GOV_T *gov, uint32_t load_mhz) {
+  for (int i = 0; i < SYSFREQ_GOV_LEVEL_QTY; i++) {
+    if ((uint32_t)sysfreq_gov_level_mhz[i] * (100 - gov->headroom_pct) >=
+        load_mhz * 100)
+      return i;
+  }
+  return GOV_TOP_LEVEL;
+}
+
+static void gov_set_level(SYSFREQ_GOV_T *gov, int level) {
+  if (gov->level != level) {
+    gov->level = level;
+    gov->switches++;
+  }
+}
+
+static int gov_eval(SYSFREQ_GOV_T *gov, uint32_t now_ms) {
+  bool any = false;
+  int need;
+
+  need = gov_fit_level(gov, sysfreq_gov_load_mhz(gov));
+  for (uint32_t i = 0; i < SYSFREQ_GOV_VOTER_QTY; i++) {
+    const SYSFREQ_GOV_VOTER_T *v = &gov->voters[i];
+
+    if (!v->active)
+      continue;
+    any = true;
+    if (v->boost_periods && v->boost_level > need)
+      need = v->boost_level;
+  }
+
+  if (!any) {
+    gov->lower_fits = false;
+    gov_set_level(gov, SYSFREQ_GOV_LEVEL_NONE);
+  } else if (gov->level == SYSFREQ_GOV_LEVEL_NONE || need > gov->level) {
+    gov->lower_fits = false;
+    gov_set_level(gov, need);
+  } else if (need < gov->level) {
+    if (!gov->lower_fits) {
+      gov->lower_fits = true;
+      gov->lower_since_ms = now_ms;
+    } else if (now_ms - gov->lower_since_ms >= gov->down_hold_ms) {
+      gov->lower_since_ms = now_ms;
+      gov_set_level(gov, gov->level - 1);
+    }
+  } else {
+    gov->lower_fits = false;
+  }
+  return gov->level;
+}
+
+int sysfreq_gov_register(SYSFREQ_GOV_T *gov, uint32_t id, uint32_t period_us,
+                         uint32_t budget_cycles, uint32_t now_ms) {
+  SYSFREQ_GOV_VOTER_T *v;
+
+  if (id >= SYSFREQ_GOV_VOTER_QTY)
+    return gov->level;
+
+  v = &gov->voters[id];
+  if (!v->active) {
+    memset(v, 0, sizeof(*v));
+    v->active = true;
+  }
+  v->period_us = period_us;
+  if (budget_cycles > v->budget_cycles)
+    v->budget_cycles = budget_cycles;
+  return gov_eval(gov, now_ms);
+}
+
+int sysfreq_gov_unregister(SYSFREQ_GOV_T *gov, uint32_t id, uint32_t now_ms) {
+  if (id < SYSFREQ_GOV_VOTER_QTY)
+    memset(&gov->voters[id], 0, sizeof(gov->voters[id]));
+  return gov_eval(gov, now_ms);
+}
+
+int sysfreq_gov_report(SYSFREQ_GOV_T *gov, uint32_t id, uint32_t cycles,
+                       uint32_t now_ms) {
+  SYSFREQ_GOV_VOTER_T *v;
+  uint32_t decayed;
+
+  if (id >= SYSFREQ_GOV_VOTER_QTY || !gov->voters[id].active)
+    return gov->level;
+
+  v = &gov->voters[id];
+  v->periods++;
+  if (v->boost_fresh) {
+    // The period the miss happened in does not count towards the boost, and
+    // its cycles are not to be trusted: the clock changed halfway through.
+    v->boost_fresh = false;
+  } else {
+    decayed = v->budget_cycles - v->budget_cycles / SYSFREQ_GOV_DECAY;
+    v->budget_cycles = cycles > decayed ? cycles : decayed;
+    if (v->boost_periods)
+      v->boost_periods--;
+  }
+  return gov_eval(gov, now_ms);
+}
+
+int sysfreq_gov_miss(SYSFREQ_GOV_T *gov, uint32_t id, uint32_t boost_periods,
+                     uint32_t now_ms) {
+  SYSFREQ_GOV_VOTER_T *v;
+  int level;
+
+  if (id >= SYSFREQ_GOV_VOTER_QTY || !gov->voters[id].active)
+    return gov->level;
+
+  v = &gov->voters[id];
+  v->misses++;
+  if (v->boost_periods == 0) {
+    // One step above what the voter itself needs, or above the current
+    // level if that is higher, but never past the cap.
+    level = gov_fit_level(gov, gov_voter_mhz(v));
+    if (gov->level > level)
+      level = gov->level;
+    level++;
+    if (level > SYSFREQ_GOV_BOOST_MAX_LEVEL)
+      level = SYSFREQ_GOV_BOOST_MAX_LEVEL;
+    v->boost_level = level;
+  }
+  if (boost_periods > v->boost_periods)
+    v->boost_periods = boost_periods;
+  v->boost_fresh = true;
+  return gov_eval(gov, now_ms);
+}
+
+int sysfreq_gov_level(const SYSFREQ_GOV_T *gov) { return gov->level; }
+
+bool sysfreq_gov_boosting(const SYSFREQ_GOV_T *gov, uint32_t id) {
+  return id < SYSFREQ_GOV_VOTER_QTY && gov->voters[id].boost_periods != 0;
+}
@@ -0,0 +1,92 @@
+#ifndef __APP_SYSFREQ_GOV_H__
+#define __APP_SYSFREQ_GOV_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Deadline-aware system clock governor.
+//
+// Instead of asking for a fixed frequency, a voter registers the period of
+// its work and the cycles that work takes per period, and reports the cycles
+// it actually used as each period completes. The reported figures are kept
+// as a peak that decays by 1/256 per period, so the budget follows the
+// heaviest recent periods rather than the average.
+//
+// The governor runs at the lowest level where the summed load of all voters,
+// cycles per microsecond, fits with |headroom_pct| to spare. It rises as soon
+// as the load does not fit, and falls one level at a time once a lower level
+// has fitted for |down_hold_ms|.
+//
+// A voter that misses a deadline is boosted for the given number of its own
+// periods: the clock stays at least one level above both what the voter's
+// own budget needs and the level the miss happened at, but no higher than
+// SYSFREQ_GOV_BOOST_MAX_LEVEL unless the load itself asks for more. What the
+// voter reports for the period of the miss is ignored, since the clock
+// changed in the middle of it.
+//
+// This is the pure part; app_utils.c applies the result through
+// APP_SYSFREQ_USER_GOVERNOR. It takes no locks and reads no clock.
+
+#define SYSFREQ_GOV_VOTER_QTY 16
+#define SYSFREQ_GOV_LEVEL_QTY 5
+// No voter is registered; the governor asks for nothing.
+#define SYSFREQ_GOV_LEVEL_NONE (-1)
+// 104M, the most a2dp_audio_sysfreq_boost_start() ever asked for.
+#define SYSFREQ_GOV_BOOST_MAX_LEVEL 3
+
+typedef struct {
+  bool active;
+  uint32_t period_us;
+  uint32_t budget_cycles;
+  uint32_t boost_periods;
+  bool boost_fresh;
+  int8_t boost_level;
+  uint32_t periods;
+  uint32_t misses;
+} SYSFREQ_GOV_VOTER_T;
+
+typedef struct {
+  SYSFREQ_GOV_VOTER_T voters[SYSFREQ_GOV_VOTER_QTY];
+  uint8_t headroom_pct;
+  uint32_t down_hold_ms;
+  int8_t level;
+  bool lower_fits;
+  uint32_t lower_since_ms;
+  uint32_t switches;
+} SYSFREQ_GOV_T;
+
+// MHz of each level, lowest first.
+extern const uint16_t sysfreq_gov_level_mhz[SYSFREQ_GOV_LEVEL_QTY];
+
+void sysfreq_gov_init(SYSFREQ_GOV_T *gov, uint8_t headroom_pct,
+                      uint32_t down_hold_ms);
+
+// All of these return the level to run at from now on.
+
+// Registering again updates the period and keeps the budget learnt so far,
+// unless |budget_cycles| is larger.
+int sysfreq_gov_register(SYSFREQ_GOV_T *gov, uint32_t id, uint32_t period_us,
+                         uint32_t budget_cycles, uint32_t now_ms);
+int sysfreq_gov_unregister(SYSFREQ_GOV_T *gov, uint32_t id, uint32_t now_ms);
+// One period of |id| completed in |cycles|.
+int sysfreq_gov_report(SYSFREQ_GOV_T *gov, uint32_t id, uint32_t cycles,
+                       uint32_t now_ms);
+// |id| missed a deadline; boost it for the rest of the current period and
+// |boost_periods| more.
+int sysfreq_gov_miss(SYSFREQ_GOV_T *gov, uint32_t id, uint32_t boost_periods,
+                     uint32_t now_ms);
+
+int sysfreq_gov_level(const SYSFREQ_GOV_T *gov);
+bool sysfreq_gov_boosting(const SYSFREQ_GOV_T *gov, uint32_t id);
+// Summed load of the voters, in MHz, boosts included.
+uint32_t sysfreq_gov_load_mhz(const SYSFREQ_GOV_T *gov);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __APP_SYSFREQ_GOV_H__
@@ -15,97 +15,226 @@
  ****************************************************************************/
 #include "app_thread.h"
 #include "app_utils.h"
+#include "cmsis.h"
 #include "cmsis_os.h"
 #include "hal_timer.h"
 #include "hal_trace.h"
+#include "ilist.h"
+#include <stddef.h>
 
 static APP_MOD_HANDLER_T mod_handler[APP_MODUAL_NUM];
+static uint8_t mod_prio[APP_MODUAL_NUM] = {
+    [0 ... APP_MODUAL_NUM - 1] = APP_MAILBOX_PRIO_NORMAL,
+    [APP_MODUAL_KEY] = APP_MAILBOX_PRIO_HIGH,
+};
 
 static void app_thread(void const *argument);
 osThreadDef(app_thread, osPriorityHigh, 1, 1024 * 3, "app_thread");
 
-osMailQDef(app_mailbox, APP_MAILBOX_MAX, APP_MESSAGE_BLOCK);
-static osMailQId app_mailbox = NULL;
+// Messages live in a fixed pool and move between the free list and the
+// lanes; the semaphore counts the queued ones.
+typedef struct {
+  ilist_node_t node;
+  APP_MESSAGE_BLOCK msg;
+} APP_MAILBOX_ENTRY_T;
+
+static APP_MAILBOX_ENTRY_T app_mailbox_pool[APP_MAILBOX_MAX];
+static ilist_t app_mailbox_free_list;
+static ilist_t app_mailbox_lane[APP_MAILBOX_PRIO_NUM];
+osSemaphoreDef(app_mailbox_sem);
+static osSemaphoreId app_mailbox_sem_id = NULL;
 static uint8_t app_mailbox_cnt = 0;
+static APP_MAILBOX_STATS_T app_mailbox_stats[APP_MODUAL_NUM];
 osThreadId app_thread_tid;
 
 static int app_mailbox_init(void) {
-  app_mailbox = osMailCreate(osMailQ(app_mailbox), NULL);
-  if (app_mailbox == NULL) {
+  app_mailbox_sem_id = osSemaphoreCreate(osSemaphore(app_mailbox_sem), 0);
+  if (app_mailbox_sem_id == NULL) {
     TRACE(0, "Failed to Create app_mailbox\n");
     return -1;
   }
+  ilist_init(&app_mailbox_free_list);
+  for (uint8_t i = 0; i < APP_MAILBOX_PRIO_NUM; i++) {
+    ilist_init(&app_mailbox_lane[i]);
+  }
+  for (uint8_t i = 0; i < APP_MAILBOX_MAX; i++) {
+    ilist_append(&app_mailbox_free_list, &app_mailbox_pool[i].node);
+  }
   app_mailbox_cnt = 0;
   return 0;
 }
 
-int app_mailbox_put(APP_MESSAGE_BLOCK *msg_src) {
-  osStatus status;
+static void app_mailbox_dump(void) {
+  ilist_node_t *node;
+  APP_MESSAGE_BLOCK *msg_p;
+
+  TRACE_IMM(0, "app_mailbox full dump");
+  for (uint8_t i = 0; i < APP_MAILBOX_PRIO_NUM; i++) {
+    for (node = ilist_begin(&app_mailbox_lane[i]);
+         node != ilist_end(&app_mailbox_lane[i]); node = ilist_next(node)) {
+      msg_p = &ilist_entry(node, APP_MAILBOX_ENTRY_T, node)->msg;
+      TRACE_IMM(
+          9,
+          "lane:%d mod:%d src:%08x tim:%d id:%x ptr:%08x para:%08x/%08x/%08x",
+          i, msg_p->mod_id, msg_p->src_thread, msg_p->system_time,
+          msg_p->msg_body.message_id, msg_p->msg_body.message_ptr,
+          msg_p->msg_body.message_Param0, msg_p->msg_body.message_Param1,
+          msg_p->msg_body.message_Param2);
+    }
+  }
+  TRACE_IMM(0, "app_mailbox full dump end");
+}
+
+static void app_mailbox_count_drop(uint32_t mod_id) {
+  if (mod_id < APP_MODUAL_NUM)
+    app_mailbox_stats[mod_id].dropped++;
+}
+
+// Returns the queued message of |mod_id| on |lane| matching |message_id|
+// under |id_mask|, or NULL.
+static APP_MESSAGE_BLOCK *app_mailbox_find(ilist_t *lane, uint32_t mod_id,
+                                           uint32_t message_id,
+                                           uint32_t id_mask) {
+  ilist_node_t *node;
+  APP_MESSAGE_BLOCK *msg_p;
+
+  for (node = ilist_begin(lane); node != ilist_end(lane);
+       node = ilist_next(node)) {
+    msg_p = &ilist_entry(node, APP_MAILBOX_ENTRY_T, node)->msg;
+    if (msg_p->mod_id == mod_id &&
+        !((msg_p->msg_body.message_id ^ message_id) & id_mask))
+      return msg_p;
+  }
+  return NULL;
+}
 
+static int app_mailbox_enqueue(APP_MESSAGE_BLOCK *msg_src,
+                               enum APP_MAILBOX_PRIO_T prio, bool coalesce,
+                               uint32_t id_mask) {
   APP_MESSAGE_BLOCK *msg_p = NULL;
+  ilist_node_t *node;
+  bool replaced = false;
+  uint32_t lock;
 
-  msg_p = (APP_MESSAGE_BLOCK *)osMailAlloc(app_mailbox, 0);
-
-  if (!msg_p) {
-    osEvent evt;
-    TRACE_IMM(0, "osMailAlloc error dump");
-    for (uint8_t i = 0; i < APP_MAILBOX_MAX; i++) {
-      evt = osMailGet(app_mailbox, 0);
-      if (evt.status == osEventMail) {
-        TRACE_IMM(
-            9,
-            "cnt:%d mod:%d src:%08x tim:%d id:%x ptr:%08x para:%08x/%08x/%08x",
-            i, ((APP_MESSAGE_BLOCK *)(evt.value.p))->mod_id,
-            ((APP_MESSAGE_BLOCK *)(evt.value.p))->src_thread,
-            ((APP_MESSAGE_BLOCK *)(evt.value.p))->system_time,
-            ((APP_MESSAGE_BLOCK *)(evt.value.p))->msg_body.message_id,
-            ((APP_MESSAGE_BLOCK *)(evt.value.p))->msg_body.message_ptr,
-            ((APP_MESSAGE_BLOCK *)(evt.value.p))->msg_body.message_Param0,
-            ((APP_MESSAGE_BLOCK *)(evt.value.p))->msg_body.message_Param1,
-            ((APP_MESSAGE_BLOCK *)(evt.value.p))->msg_body.message_Param2);
-      } else {
-        TRACE_IMM(2, "cnt:%d %d", i, evt.status);
-        break;
-      }
+  ASSERT(prio < APP_MAILBOX_PRIO_NUM, "%s: bad prio %d", __func__, prio);
+
+  lock = int_lock();
+  if (coalesce) {
+    msg_p = app_mailbox_find(&app_mailbox_lane[prio], msg_src->mod_id,
+                             msg_src->msg_body.message_id, id_mask);
+    if (msg_p) {
+      msg_p->msg_body = msg_src->msg_body;
+      if (msg_src->mod_id < APP_MODUAL_NUM)
+        app_mailbox_stats[msg_src->mod_id].coalesced++;
+      int_unlock(lock);
+      return osOK;
+    }
+  }
+
+  node = ilist_pop_front(&app_mailbox_free_list);
+  if (!node && prio != APP_MAILBOX_PRIO_LOW) {
+    // Make room by dropping the oldest periodic update.
+    node = ilist_pop_front(&app_mailbox_lane[APP_MAILBOX_PRIO_LOW]);
+    if (node) {
+      app_mailbox_count_drop(
+          ilist_entry(node, APP_MAILBOX_ENTRY_T, node)->msg.mod_id);
+      replaced = true;
+    }
+  }
+  if (!node) {
+    if (prio == APP_MAILBOX_PRIO_LOW) {
+      app_mailbox_count_drop(msg_src->mod_id);
+      int_unlock(lock);
+      return osErrorResource;
     }
-    TRACE_IMM(0, "osMailAlloc error dump end");
+    app_mailbox_dump();
+    ASSERT(0, "app_mailbox full");
   }
 
-  ASSERT(msg_p, "osMailAlloc error");
+  msg_p = &ilist_entry(node, APP_MAILBOX_ENTRY_T, node)->msg;
   msg_p->src_thread = (uint32_t)osThreadGetId();
   msg_p->dest_thread = (uint32_t)NULL;
   msg_p->system_time = hal_sys_timer_get();
   msg_p->mod_id = msg_src->mod_id;
-  msg_p->msg_body.message_id = msg_src->msg_body.message_id;
-  msg_p->msg_body.message_ptr = msg_src->msg_body.message_ptr;
-  msg_p->msg_body.message_Param0 = msg_src->msg_body.message_Param0;
-  msg_p->msg_body.message_Param1 = msg_src->msg_body.message_Param1;
-  msg_p->msg_body.message_Param2 = msg_src->msg_body.message_Param2;
-
-  status = osMailPut(app_mailbox, msg_p);
-  if (osOK == status)
+  msg_p->msg_body = msg_src->msg_body;
+  ilist_append(&app_mailbox_lane[prio], node);
+  if (!replaced)
     app_mailbox_cnt++;
-  return (int)status;
+  int_unlock(lock);
+
+  // A replaced message keeps the token it was queued with.
+  if (!replaced)
+    osSemaphoreRelease(app_mailbox_sem_id);
+  return osOK;
+}
+
+int app_mailbox_put(APP_MESSAGE_BLOCK *msg_src) {
+  enum APP_MAILBOX_PRIO_T prio = APP_MAILBOX_PRIO_NORMAL;
+
+  if (msg_src->mod_id < APP_MODUAL_NUM)
+    prio = (enum APP_MAILBOX_PRIO_T)mod_prio[msg_src->mod_id];
+  return app_mailbox_enqueue(msg_src, prio, false, 0);
+}
+
+int app_mailbox_put_prio(APP_MESSAGE_BLOCK *msg_src,
+                         enum APP_MAILBOX_PRIO_T prio) {
+  return app_mailbox_enqueue(msg_src, prio, false, 0);
+}
+
+int app_mailbox_put_coalesced(APP_MESSAGE_BLOCK *msg_src,
+                              enum APP_MAILBOX_PRIO_T prio, uint32_t id_mask) {
+  return app_mailbox_enqueue(msg_src, prio, true, id_mask);
 }
 
 int app_mailbox_free(APP_MESSAGE_BLOCK *msg_p) {
-  osStatus status;
+  APP_MAILBOX_ENTRY_T *entry =
+      (APP_MAILBOX_ENTRY_T *)((char *)msg_p -
+                              offsetof(APP_MAILBOX_ENTRY_T, msg));
+  uint32_t lock;
 
-  status = osMailFree(app_mailbox, msg_p);
-  if (osOK == status)
-    app_mailbox_cnt--;
+  lock = int_lock();
+  ilist_append(&app_mailbox_free_list, &entry->node);
+  app_mailbox_cnt--;
+  int_unlock(lock);
 
-  return (int)status;
+  return osOK;
 }
 
 int app_mailbox_get(APP_MESSAGE_BLOCK **msg_p) {
-  osEvent evt;
-  evt = osMailGet(app_mailbox, osWaitForever);
-  if (evt.status == osEventMail) {
-    *msg_p = (APP_MESSAGE_BLOCK *)evt.value.p;
-    return 0;
+  ilist_node_t *node = NULL;
+  uint32_t lock;
+
+  if (osSemaphoreWait(app_mailbox_sem_id, osWaitForever) <= 0)
+    return -1;
+
+  lock = int_lock();
+  for (uint8_t i = 0; i < APP_MAILBOX_PRIO_NUM && !node; i++) {
+    node = ilist_pop_front(&app_mailbox_lane[i]);
   }
-  return -1;
+  int_unlock(lock);
+
+  if (!node)
+    return -1;
+  *msg_p = &ilist_entry(node, APP_MAILBOX_ENTRY_T, node)->msg;
+  return 0;
+}
+
+static void app_mailbox_record_latency(const APP_MESSAGE_BLOCK *msg_p) {
+  APP_MAILBOX_STATS_T *stats;
+  uint32_t ms;
+  uint8_t bin = 0;
+
+  if (msg_p->mod_id >= APP_MODUAL_NUM)
+    return;
+  stats = &app_mailbox_stats[msg_p->mod_id];
+  ms = TICKS_TO_MS(hal_sys_timer_get() - msg_p->system_time);
+  while ((ms >> bin) && bin < APP_MAILBOX_LATENCY_BINS - 1)
+    bin++;
+  if (stats->latency_hist[bin] < UINT16_MAX)
+    stats->latency_hist[bin]++;
+  if (ms > stats->max_latency_ms)
+    stats->max_latency_ms = ms;
+  stats->dispatched++;
 }
 
 static void app_thread(void const *argument) {
@@ -113,6 +242,7 @@ static void app_thread(void const *argument) {
     APP_MESSAGE_BLOCK *msg_p = NULL;
 
     if (!app_mailbox_get(&msg_p)) {
+      app_mailbox_record_latency(msg_p);
       if (msg_p->mod_id < APP_MODUAL_NUM) {
         if (mod_handler[msg_p->mod_id]) {
           int ret = mod_handler[msg_p->mod_id](&(msg_p->msg_body));
@@ -146,6 +276,48 @@ int app_set_threadhandle(enum APP_MODUAL_ID_T mod_id,
   return 0;
 }
 
+int app_set_mailbox_prio(enum APP_MODUAL_ID_T mod_id,
+                         enum APP_MAILBOX_PRIO_T prio) {
+  if (mod_id >= APP_MODUAL_NUM || prio >= APP_MAILBOX_PRIO_NUM)
+    return -1;
+
+  mod_prio[mod_id] = prio;
+  return 0;
+}
+
+int app_mailbox_get_stats(enum APP_MODUAL_ID_T mod_id,
+                          APP_MAILBOX_STATS_T *stats) {
+  uint32_t lock;
+
+  if (mod_id >= APP_MODUAL_NUM)
+    return -1;
+
+  lock = int_lock();
+  *stats = app_mailbox_stats[mod_id];
+  int_unlock(lock);
+  return 0;
+}
+
+void app_mailbox_dump_stats(void) {
+  APP_MAILBOX_STATS_T stats;
+
+  for (uint8_t i = 0; i < APP_MODUAL_NUM; i++) {
+    app_mailbox_get_stats((enum APP_MODUAL_ID_T)i, &stats);
+    if (!stats.dispatched && !stats.dropped)
+      continue;
+    TRACE(5, "app_mailbox mod:%d n:%u coalesced:%u dropped:%u max:%ums", i,
+          stats.dispatched, stats.coalesced, stats.dropped,
+          stats.max_latency_ms);
+    TRACE(12, "app_mailbox mod:%d ms <1:%u <2:%u <4:%u <8:%u <16:%u <32:%u "
+              "<64:%u <128:%u <256:%u <512:%u more:%u",
+          i, stats.latency_hist[0], stats.latency_hist[1],
+          stats.latency_hist[2], stats.latency_hist[3], stats.latency_hist[4],
+          stats.latency_hist[5], stats.latency_hist[6], stats.latency_hist[7],
+          stats.latency_hist[8], stats.latency_hist[9],
+          stats.latency_hist[10]);
+  }
+}
+
 void *app_os_tid_get(void) { return (void *)app_thread_tid; }
 
 bool app_is_module_registered(enum APP_MODUAL_ID_T mod_id) {
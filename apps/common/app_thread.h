@@ -74,8 +74,40 @@ typedef struct {
 
 typedef int (*APP_MOD_HANDLER_T)(APP_MESSAGE_BODY *);
 
+// Mailbox lanes. app_thread always serves the highest non-empty lane first,
+// FIFO within a lane. When the mailbox is full, the oldest LOW message is
+// dropped to make room for a HIGH or NORMAL one, and a LOW message that finds
+// no room is dropped itself.
+enum APP_MAILBOX_PRIO_T {
+  APP_MAILBOX_PRIO_HIGH = 0, // user input
+  APP_MAILBOX_PRIO_NORMAL,   // state changes, the default
+  APP_MAILBOX_PRIO_LOW,      // periodic updates that a newer one supersedes
+  APP_MAILBOX_PRIO_NUM
+};
+
+// Dispatch latency bins: < 1 ms, then [2^(i-1), 2^i) ms, the last one open.
+#define APP_MAILBOX_LATENCY_BINS (11)
+
+typedef struct {
+  uint32_t dispatched;
+  uint32_t coalesced;
+  uint32_t dropped;
+  uint32_t max_latency_ms;
+  uint16_t latency_hist[APP_MAILBOX_LATENCY_BINS];
+} APP_MAILBOX_STATS_T;
+
+// Queues on the lane set for the module, NORMAL unless changed.
 int app_mailbox_put(APP_MESSAGE_BLOCK *msg_src);
 
+int app_mailbox_put_prio(APP_MESSAGE_BLOCK *msg_src,
+                         enum APP_MAILBOX_PRIO_T prio);
+
+// Overwrites a message still queued on |prio| for the same module whose
+// message_id equals msg_src's under |id_mask|, keeping its place in the lane;
+// queues a new one otherwise. For status polls where only the latest counts.
+int app_mailbox_put_coalesced(APP_MESSAGE_BLOCK *msg_src,
+                              enum APP_MAILBOX_PRIO_T prio, uint32_t id_mask);
+
 int app_mailbox_free(APP_MESSAGE_BLOCK *msg_p);
 
 int app_mailbox_get(APP_MESSAGE_BLOCK **msg_p);
@@ -85,6 +117,14 @@ int app_os_init(void);
 int app_set_threadhandle(enum APP_MODUAL_ID_T mod_id,
                          APP_MOD_HANDLER_T handler);
 
+int app_set_mailbox_prio(enum APP_MODUAL_ID_T mod_id,
+                         enum APP_MAILBOX_PRIO_T prio);
+
+int app_mailbox_get_stats(enum APP_MODUAL_ID_T mod_id,
+                          APP_MAILBOX_STATS_T *stats);
+
+void app_mailbox_dump_stats(void);
+
 void *app_os_tid_get(void);
 
 bool app_is_module_registered(enum APP_MODUAL_ID_T mod_id);
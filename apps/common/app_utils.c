@@ -15,6 +15,7 @@
  ****************************************************************************/
 #include "app_utils.h"
 #include "analog.h"
+#include "app_sysfreq_gov.h"
 #include "cmsis.h"
 #include "hal_timer.h"
 #include "hal_trace.h"
@@ -179,6 +180,99 @@ int app_sysfreq_req(enum APP_SYSFREQ_USER_T user,
   return ret;
 }
 
+#define SYSFREQ_GOV_HEADROOM_PCT 20
+#define SYSFREQ_GOV_DOWN_HOLD_MS 1000
+
+#define SYSFREQ_GOV_ID(user) ((uint32_t)(user) - (uint32_t)APP_SYSFREQ_USER_APP_0)
+
+static SYSFREQ_GOV_T sysfreq_gov;
+static bool sysfreq_gov_inited;
+static enum HAL_CMU_FREQ_T sysfreq_gov_freq = HAL_CMU_FREQ_32K;
+
+static void app_sysfreq_gov_init(void) {
+  if (!sysfreq_gov_inited) {
+    sysfreq_gov_init(&sysfreq_gov, SYSFREQ_GOV_HEADROOM_PCT,
+                     SYSFREQ_GOV_DOWN_HOLD_MS);
+    sysfreq_gov_inited = true;
+  }
+}
+
+// Called with interrupts locked.
+static int app_sysfreq_gov_apply(int level) {
+  enum HAL_CMU_FREQ_T freq = HAL_CMU_FREQ_32K;
+
+  if (level != SYSFREQ_GOV_LEVEL_NONE)
+    freq = (enum HAL_CMU_FREQ_T)(HAL_CMU_FREQ_26M + level);
+  if (freq == sysfreq_gov_freq)
+    return 0;
+
+  TRACE(2, "[GOV] sysfreq %d load %dM", freq,
+        sysfreq_gov_load_mhz(&sysfreq_gov));
+  sysfreq_gov_freq = freq;
+  return hal_sysfreq_req((enum HAL_SYSFREQ_USER_T)APP_SYSFREQ_USER_GOVERNOR,
+                         freq);
+}
+
+int app_sysfreq_gov_register(enum APP_SYSFREQ_USER_T user, uint32_t period_us,
+                             uint32_t budget_cycles) {
+  uint32_t lock;
+  int ret;
+
+  lock = int_lock();
+  app_sysfreq_gov_init();
+  ret = app_sysfreq_gov_apply(
+      sysfreq_gov_register(&sysfreq_gov, SYSFREQ_GOV_ID(user), period_us,
+                           budget_cycles, GET_CURRENT_MS()));
+  int_unlock(lock);
+  return ret;
+}
+
+int app_sysfreq_gov_unregister(enum APP_SYSFREQ_USER_T user) {
+  uint32_t lock;
+  int ret;
+
+  lock = int_lock();
+  app_sysfreq_gov_init();
+  ret = app_sysfreq_gov_apply(sysfreq_gov_unregister(
+      &sysfreq_gov, SYSFREQ_GOV_ID(user), GET_CURRENT_MS()));
+  int_unlock(lock);
+  return ret;
+}
+
+int app_sysfreq_gov_report(enum APP_SYSFREQ_USER_T user, uint32_t cycles) {
+  uint32_t lock;
+  int ret;
+
+  lock = int_lock();
+  app_sysfreq_gov_init();
+  ret = app_sysfreq_gov_apply(sysfreq_gov_report(
+      &sysfreq_gov, SYSFREQ_GOV_ID(user), cycles, GET_CURRENT_MS()));
+  int_unlock(lock);
+  return ret;
+}
+
+int app_sysfreq_gov_miss(enum APP_SYSFREQ_USER_T user, uint32_t boost_periods) {
+  uint32_t lock;
+  int ret;
+
+  lock = int_lock();
+  app_sysfreq_gov_init();
+  ret = app_sysfreq_gov_apply(
+      sysfreq_gov_miss(&sysfreq_gov, SYSFREQ_GOV_ID(user), boost_periods,
+                       GET_CURRENT_MS()));
+  int_unlock(lock);
+  return ret;
+}
+
+bool app_sysfreq_gov_boosting(enum APP_SYSFREQ_USER_T user) {
+  return sysfreq_gov_boosting(&sysfreq_gov, SYSFREQ_GOV_ID(user));
+}
+
+uint32_t app_sysfreq_fast_ticks_to_cycles(uint32_t ticks) {
+  return (uint32_t)((uint64_t)ticks * freq_map[hal_sysfreq_get()] * 1000 /
+                    MS_TO_FAST_TICKS(1));
+}
+
 #ifdef RTOS
 
 extern int rtx_task_idle_health_check(void);
@@ -26,7 +26,7 @@ extern "C" {
 #define APP_SYSFREQ_USER_BT_MAIN            APP_SYSFREQ_USER_APP_1
 #define APP_SYSFREQ_USER_HCI                APP_SYSFREQ_USER_APP_2
 #define APP_SYSFREQ_USER_BT_A2DP            APP_SYSFREQ_USER_APP_3
-#define APP_SYSFREQ_USER_UNUSED             APP_SYSFREQ_USER_APP_4
+#define APP_SYSFREQ_USER_GOVERNOR           APP_SYSFREQ_USER_APP_4
 #define APP_SYSFREQ_USER_AI_VOICE           APP_SYSFREQ_USER_APP_5
 #define APP_SYSFREQ_USER_BT_SCO             APP_SYSFREQ_USER_APP_6
 #define APP_SYSFREQ_USER_OTA                APP_SYSFREQ_USER_APP_7
@@ -95,6 +95,32 @@ enum APP_WDT_THREAD_CHECK_USER_T {
 
 int app_sysfreq_req(enum APP_SYSFREQ_USER_T user, enum APP_SYSFREQ_FREQ_T freq);
 
+/*
+ * Deadline-aware requests, see app_sysfreq_gov.h.
+ * A user registers the period of its work and the cycles it needs per period,
+ * then reports the cycles it used after every period. The governor requests,
+ * as APP_SYSFREQ_USER_GOVERNOR, the lowest frequency that meets the deadlines
+ * of all registered users, on top of what app_sysfreq_req() users ask for.
+ * app_sysfreq_gov_miss() raises the frequency a level, to at most 104M, for
+ * the next boost_periods periods of the user.
+ */
+int app_sysfreq_gov_register(enum APP_SYSFREQ_USER_T user, uint32_t period_us,
+                             uint32_t budget_cycles);
+
+int app_sysfreq_gov_unregister(enum APP_SYSFREQ_USER_T user);
+
+int app_sysfreq_gov_report(enum APP_SYSFREQ_USER_T user, uint32_t cycles);
+
+int app_sysfreq_gov_miss(enum APP_SYSFREQ_USER_T user, uint32_t boost_periods);
+
+bool app_sysfreq_gov_boosting(enum APP_SYSFREQ_USER_T user);
+
+/*
+ * CPU cycles in a span of hal_fast_sys_timer_get() ticks at the current
+ * system frequency
+ */
+uint32_t app_sysfreq_fast_ticks_to_cycles(uint32_t ticks);
+
 int app_wdt_open(int seconds);
 
 int app_wdt_reopen(int seconds);
@@ -0,0 +1,178 @@
+#include "app_thread.h"
+#include "cmsis_os.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// The app mailbox lanes, driven from the test instead of app_thread: the
+// stub semaphore never blocks, so app_mailbox_get() returns -1 once every
+// queued message is taken.
+
+uint32_t hal_sys_timer_get(void) { return 0; }
+
+static void reset(void) {
+  assert(app_os_init() == 0);
+  assert(app_set_mailbox_prio(APP_MODUAL_AUDIO, APP_MAILBOX_PRIO_NORMAL) ==
+         0);
+}
+
+static APP_MESSAGE_BLOCK make_msg(enum APP_MODUAL_ID_T mod, uint32_t id,
+                                  uint32_t param) {
+  APP_MESSAGE_BLOCK msg;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.mod_id = mod;
+  msg.msg_body.message_id = id;
+  msg.msg_body.message_Param0 = param;
+  return msg;
+}
+
+// Takes the next message and checks it, then gives it back to the pool.
+static void expect(enum APP_MODUAL_ID_T mod, uint32_t id, uint32_t param) {
+  APP_MESSAGE_BLOCK *msg_p = NULL;
+
+  assert(app_mailbox_get(&msg_p) == 0);
+  assert(msg_p->mod_id == mod);
+  assert(msg_p->msg_body.message_id == id);
+  assert(msg_p->msg_body.message_Param0 == param);
+  app_mailbox_free(msg_p);
+}
+
+static void expect_empty(void) {
+  APP_MESSAGE_BLOCK *msg_p = NULL;
+
+  assert(app_mailbox_get(&msg_p) == -1);
+}
+
+static APP_MAILBOX_STATS_T stats_of(enum APP_MODUAL_ID_T mod) {
+  APP_MAILBOX_STATS_T stats;
+
+  assert(app_mailbox_get_stats(mod, &stats) == 0);
+  return stats;
+}
+
+// The highest non-empty lane is served first, FIFO within a lane.
+static void test_lane_order(void) {
+  APP_MESSAGE_BLOCK msg;
+
+  reset();
+  msg = make_msg(APP_MODUAL_BT, 1, 0);
+  assert(app_mailbox_put(&msg) == osOK);
+  msg = make_msg(APP_MODUAL_BATTERY, 2, 0);
+  assert(app_mailbox_put_prio(&msg, APP_MAILBOX_PRIO_LOW) == osOK);
+  msg = make_msg(APP_MODUAL_BT, 3, 0);
+  assert(app_mailbox_put(&msg) == osOK);
+  msg = make_msg(APP_MODUAL_KEY, 4, 0);
+  assert(app_mailbox_put(&msg) == osOK);
+  msg = make_msg(APP_MODUAL_AUDIO, 5, 0);
+  assert(app_mailbox_put_prio(&msg, APP_MAILBOX_PRIO_HIGH) == osOK);
+
+  expect(APP_MODUAL_KEY, 4, 0);
+  expect(APP_MODUAL_AUDIO, 5, 0);
+  expect(APP_MODUAL_BT, 1, 0);
+  expect(APP_MODUAL_BT, 3, 0);
+  expect(APP_MODUAL_BATTERY, 2, 0);
+  expect_empty();
+
+  // A module moved to another lane is queued there by app_mailbox_put().
+  assert(app_set_mailbox_prio(APP_MODUAL_AUDIO, APP_MAILBOX_PRIO_LOW) == 0);
+  assert(app_set_mailbox_prio(APP_MODUAL_NUM, APP_MAILBOX_PRIO_LOW) == -1);
+  assert(app_set_mailbox_prio(APP_MODUAL_AUDIO, APP_MAILBOX_PRIO_NUM) == -1);
+  msg = make_msg(APP_MODUAL_AUDIO, 6, 0);
+  assert(app_mailbox_put(&msg) == osOK);
+  msg = make_msg(APP_MODUAL_BT, 7, 0);
+  assert(app_mailbox_put(&msg) == osOK);
+  expect(APP_MODUAL_BT, 7, 0);
+  expect(APP_MODUAL_AUDIO, 6, 0);
+  expect_empty();
+}
+
+// A queued message with the same module and masked id takes the newer body
+// and keeps its place; anything else is queued as usual.
+static void test_coalescing(void) {
+  const enum APP_MAILBOX_PRIO_T low = APP_MAILBOX_PRIO_LOW;
+  const uint32_t mask = 0xFF00;
+  APP_MAILBOX_STATS_T before = stats_of(APP_MODUAL_BATTERY);
+  APP_MESSAGE_BLOCK msg;
+
+  reset();
+  msg = make_msg(APP_MODUAL_BATTERY, 0x0100, 3700);
+  assert(app_mailbox_put_coalesced(&msg, low, mask) == osOK);
+  msg = make_msg(APP_MODUAL_WNR, 0x0100, 1);
+  assert(app_mailbox_put_coalesced(&msg, low, mask) == osOK);
+  msg = make_msg(APP_MODUAL_BATTERY, 0x0142, 3650);
+  assert(app_mailbox_put_coalesced(&msg, low, mask) == osOK);
+  msg = make_msg(APP_MODUAL_BATTERY, 0x0233, 3600);
+  assert(app_mailbox_put_coalesced(&msg, low, mask) == osOK);
+  // Only the same lane is searched.
+  msg = make_msg(APP_MODUAL_BATTERY, 0x0100, 3550);
+  assert(app_mailbox_put_coalesced(&msg, APP_MAILBOX_PRIO_NORMAL, mask) ==
+         osOK);
+  // A plain put never coalesces.
+  msg = make_msg(APP_MODUAL_BATTERY, 0x0233, 3500);
+  assert(app_mailbox_put_prio(&msg, APP_MAILBOX_PRIO_LOW) == osOK);
+
+  assert(stats_of(APP_MODUAL_BATTERY).coalesced == before.coalesced + 1);
+  expect(APP_MODUAL_BATTERY, 0x0100, 3550);
+  expect(APP_MODUAL_BATTERY, 0x0142, 3650);
+  expect(APP_MODUAL_WNR, 0x0100, 1);
+  expect(APP_MODUAL_BATTERY, 0x0233, 3600);
+  expect(APP_MODUAL_BATTERY, 0x0233, 3500);
+  expect_empty();
+}
+
+// With the pool full of LOW messages, another LOW one is dropped and a
+// NORMAL one takes the place of the oldest LOW one.
+static void test_drop_when_full(void) {
+  APP_MAILBOX_STATS_T battery = stats_of(APP_MODUAL_BATTERY);
+  APP_MAILBOX_STATS_T wnr = stats_of(APP_MODUAL_WNR);
+  APP_MESSAGE_BLOCK msg;
+  uint32_t i;
+
+  reset();
+  for (i = 0; i < APP_MAILBOX_MAX; i++) {
+    msg = make_msg(APP_MODUAL_BATTERY, i, 0);
+    assert(app_mailbox_put_prio(&msg, APP_MAILBOX_PRIO_LOW) == osOK);
+  }
+  msg = make_msg(APP_MODUAL_WNR, 100, 0);
+  assert(app_mailbox_put_prio(&msg, APP_MAILBOX_PRIO_LOW) ==
+         osErrorResource);
+  assert(stats_of(APP_MODUAL_WNR).dropped == wnr.dropped + 1);
+  assert(stats_of(APP_MODUAL_BATTERY).dropped == battery.dropped);
+
+  // A coalesced put still lands without room for a new message.
+  msg = make_msg(APP_MODUAL_BATTERY, 5, 55);
+  assert(app_mailbox_put_coalesced(&msg, APP_MAILBOX_PRIO_LOW, ~0u) ==
+         osOK);
+
+  msg = make_msg(APP_MODUAL_BT, 200, 0);
+  assert(app_mailbox_put(&msg) == osOK);
+  msg = make_msg(APP_MODUAL_KEY, 201, 0);
+  assert(app_mailbox_put(&msg) == osOK);
+  assert(stats_of(APP_MODUAL_BATTERY).dropped == battery.dropped + 2);
+
+  // The replacements keep the tokens of the messages they displaced, so
+  // exactly the pool size comes out.
+  expect(APP_MODUAL_KEY, 201, 0);
+  expect(APP_MODUAL_BT, 200, 0);
+  for (i = 2; i < APP_MAILBOX_MAX; i++)
+    expect(APP_MODUAL_BATTERY, i, i == 5 ? 55 : 0);
+  expect_empty();
+
+  // Taken messages go back to the pool.
+  for (i = 0; i < APP_MAILBOX_MAX; i++) {
+    msg = make_msg(APP_MODUAL_BT, i, 0);
+    assert(app_mailbox_put(&msg) == osOK);
+  }
+  for (i = 0; i < APP_MAILBOX_MAX; i++)
+    expect(APP_MODUAL_BT, i, 0);
+  expect_empty();
+}
+
+int main(void) {
+  test_lane_order();
+  test_coalescing();
+  test_drop_when_full();
+  printf("All app mailbox tests passed.\n");
+  return 0;
+}
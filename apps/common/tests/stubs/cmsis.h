@@ -0,0 +1,11 @@
+#ifndef __CMSIS_H__
+#define __CMSIS_H__
+
+// Host stand-in for platform/cmsis/inc/cmsis.h: interrupt locks are no-ops.
+
+#include <stdint.h>
+
+static inline uint32_t int_lock(void) { return 0; }
+static inline void int_unlock(uint32_t lock) { (void)lock; }
+
+#endif // __CMSIS_H__
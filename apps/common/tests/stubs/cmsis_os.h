@@ -0,0 +1,76 @@
+#ifndef __CMSIS_OS_H__
+#define __CMSIS_OS_H__
+
+// Host stand-in for the CMSIS-RTOS v1 calls app_thread.c makes. No thread is
+// started: the test drives the mailbox from its own thread, and a semaphore
+// wait that would block returns 0 at once.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  osOK = 0,
+  osErrorResource = 0x81,
+} osStatus;
+
+typedef enum {
+  osPriorityHigh = 2,
+} osPriority;
+
+#define osWaitForever 0xFFFFFFFFu
+
+typedef void (*os_pthread)(void const *argument);
+typedef void *osThreadId;
+
+typedef struct {
+  os_pthread pthread;
+} osThreadDef_t;
+
+#define osThreadDef(name, priority, instances, stacksz, task_name)            \
+  static const osThreadDef_t os_thread_def_##name = {(name)}
+#define osThread(name) (&os_thread_def_##name)
+
+static inline osThreadId osThreadCreate(const osThreadDef_t *thread_def,
+                                        void *argument) {
+  (void)thread_def;
+  (void)argument;
+  return NULL;
+}
+
+static inline osThreadId osThreadGetId(void) { return NULL; }
+
+typedef struct {
+  int32_t count;
+} osSemaphoreDef_t;
+typedef osSemaphoreDef_t *osSemaphoreId;
+
+#define osSemaphoreDef(name) static osSemaphoreDef_t os_semaphore_def_##name
+#define osSemaphore(name) (&os_semaphore_def_##name)
+
+static inline osSemaphoreId osSemaphoreCreate(osSemaphoreDef_t *def,
+                                              int32_t count) {
+  def->count = count;
+  return def;
+}
+
+static inline osStatus osSemaphoreRelease(osSemaphoreId id) {
+  id->count++;
+  return osOK;
+}
+
+static inline int32_t osSemaphoreWait(osSemaphoreId id, uint32_t millisec) {
+  (void)millisec;
+  if (id->count <= 0)
+    return 0;
+  return id->count--;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __CMSIS_OS_H__
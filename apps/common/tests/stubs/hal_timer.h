@@ -0,0 +1,21 @@
+#ifndef __HAL_TIMER_H__
+#define __HAL_TIMER_H__
+
+// Host stand-in for platform/hal/hal_timer.h. The test sets the clock; one
+// tick is one millisecond.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t hal_sys_timer_get(void);
+
+#define TICKS_TO_MS(tick) ((uint32_t)(tick))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HAL_TIMER_H__
@@ -0,0 +1,469 @@
+#include "app_sysfreq_gov.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Runs periodic voters on a simulated single core, scheduled earliest
+// deadline first, and compares the governor with the static requests the
+// same users make through app_sysfreq_req() today.
+//
+// Each voter releases a job every period with a cycle count drawn around its
+// mean, with jitter, occasional spikes and optionally a step change in load.
+// A job must finish by the next release or it counts as a missed deadline.
+// Like the firmware, a voter measures a job from when it starts running to
+// when it ends, at the clock in effect at the end, so preemption by other
+// voters shows up in its budget.
+//
+// For each scenario the sim reports the average clock (a stand-in for power)
+// and the deadlines missed with each method.
+
+#define DT_US 50
+#define MAX_VOTERS 4
+#define MAX_JOBS 8
+#define GOV_HEADROOM_PCT 20
+#define GOV_DOWN_HOLD_MS 1000
+// What a2dp_audio_init() asks for when playback starts.
+#define START_BOOST_PERIODS 20
+// What the decoders ask for on a cache underflow.
+#define MISS_BOOST_PERIODS 1
+#define MIN_MHZ 26
+
+// Ids are APP_SYSFREQ_USER_APP_n - APP_SYSFREQ_USER_APP_0.
+#define ID_BT_A2DP 3
+#define ID_AI_VOICE 5
+#define ID_BT_SCO 6
+
+typedef struct {
+  const char *name;
+  uint32_t id;
+  uint32_t period_us;
+  uint32_t cycles;       // mean per period
+  uint32_t jitter_pct;   // uniform, +-
+  uint32_t spike_every;  // periods between spikes, 0 for none
+  uint32_t spike_pct;    // spike size, percent of the mean
+  double start_s;
+  double stop_s;
+  double step_s;         // load changes to |step_pct| of the mean here
+  uint32_t step_pct;
+  uint32_t static_mhz;   // what it asks app_sysfreq_req() for today
+  bool qos;              // static requests of qos users add up
+} voter_cfg_t;
+
+typedef struct {
+  const char *name;
+  double duration_s;
+  bool static_enough;    // the static requests meet every deadline
+  int n;
+  voter_cfg_t v[MAX_VOTERS];
+} scenario_t;
+
+typedef struct {
+  uint64_t release_us;
+  uint64_t deadline_us;
+  uint64_t start_us;
+  uint32_t left;
+  bool started;
+  bool missed;
+} job_t;
+
+typedef struct {
+  const voter_cfg_t *cfg;
+  bool active;
+  uint64_t next_release_us;
+  uint32_t released;
+  job_t jobs[MAX_JOBS];
+  int head;
+  int count;
+} voter_t;
+
+typedef struct {
+  double avg_mhz;
+  uint32_t jobs;
+  uint32_t misses;
+  uint32_t switches;
+  uint32_t max_mhz;
+} result_t;
+
+enum method { M_GOV, M_STATIC };
+
+static const scenario_t scenarios[] = {
+    {"sbc music",
+     60.0,
+     true,
+     1,
+     {{"a2dp", ID_BT_A2DP, 5805, 70000, 15, 0, 0, 0, 1e9, 0, 0, 52, true}}},
+    {"aac music",
+     60.0,
+     true,
+     1,
+     {{"a2dp", ID_BT_A2DP, 23220, 650000, 25, 40, 180, 0, 1e9, 0, 0, 104,
+       true}}},
+    {"sco call",
+     60.0,
+     true,
+     1,
+     {{"sco", ID_BT_SCO, 15000, 600000, 10, 30, 150, 0, 1e9, 0, 0, 104,
+       false}}},
+    {"music + voice assistant",
+     60.0,
+     true,
+     2,
+     {{"a2dp", ID_BT_A2DP, 5805, 70000, 15, 0, 0, 0, 1e9, 0, 0, 52, true},
+      {"ai voice", ID_AI_VOICE, 16000, 320000, 20, 25, 160, 20.0, 40.0, 0, 0,
+       26, true}}},
+    {"aac load step",
+     60.0,
+     true,
+     1,
+     {{"a2dp", ID_BT_A2DP, 23220, 650000, 25, 0, 0, 0, 1e9, 20.0, 200, 104,
+       true}}},
+};
+
+#define NUM_SCENARIOS (int)(sizeof(scenarios) / sizeof(scenarios[0]))
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+  rng_state = rng_state * 1103515245u + 12345u;
+  return rng_state >> 8;
+}
+
+static uint32_t job_cycles(const voter_cfg_t *cfg, uint32_t n, double t_s) {
+  uint64_t c = cfg->cycles;
+  int32_t jitter;
+
+  if (cfg->step_pct && t_s >= cfg->step_s)
+    c = c * cfg->step_pct / 100;
+  if (cfg->spike_every && n % cfg->spike_every == cfg->spike_every - 1)
+    c = c * cfg->spike_pct / 100;
+  jitter = (int32_t)(rng() % (2 * cfg->jitter_pct + 1)) -
+           (int32_t)cfg->jitter_pct;
+  return (uint32_t)(c * (100 + jitter) / 100);
+}
+
+static uint32_t level_for_mhz(uint32_t mhz) {
+  for (int i = 0; i < SYSFREQ_GOV_LEVEL_QTY; i++) {
+    if (sysfreq_gov_level_mhz[i] >= mhz)
+      return sysfreq_gov_level_mhz[i];
+  }
+  return sysfreq_gov_level_mhz[SYSFREQ_GOV_LEVEL_QTY - 1];
+}
+
+// The clock app_sysfreq_req() settles on: the largest request, with the qos
+// users' requests summed first.
+static uint32_t static_mhz(const voter_t *voters, int n) {
+  uint32_t max = MIN_MHZ, qos = 0;
+
+  for (int i = 0; i < n; i++) {
+    if (!voters[i].active)
+      continue;
+    if (voters[i].cfg->qos)
+      qos += voters[i].cfg->static_mhz;
+    else if (voters[i].cfg->static_mhz > max)
+      max = voters[i].cfg->static_mhz;
+  }
+  qos = qos ? level_for_mhz(qos) : 0;
+  return qos > max ? qos : max;
+}
+
+static uint32_t gov_mhz(const SYSFREQ_GOV_T *gov) {
+  int level = sysfreq_gov_level(gov);
+
+  return level == SYSFREQ_GOV_LEVEL_NONE ? MIN_MHZ
+                                         : sysfreq_gov_level_mhz[level];
+}
+
+static job_t *pick_job(voter_t *voters, int n, voter_t **owner) {
+  job_t *best = NULL;
+
+  for (int i = 0; i < n; i++) {
+    voter_t *v = &voters[i];
+    job_t *j;
+
+    if (!v->active || v->count == 0)
+      continue;
+    j = &v->jobs[v->head];
+    if (!best || j->deadline_us < best->deadline_us) {
+      best = j;
+      *owner = v;
+    }
+  }
+  return best;
+}
+
+static void simulate(const scenario_t *sc, enum method m, result_t *r) {
+  voter_t voters[MAX_VOTERS];
+  SYSFREQ_GOV_T gov;
+  uint64_t end_us = (uint64_t)(sc->duration_s * 1e6);
+  uint64_t mhz_sum = 0;
+
+  memset(voters, 0, sizeof(voters));
+  memset(r, 0, sizeof(*r));
+  sysfreq_gov_init(&gov, GOV_HEADROOM_PCT, GOV_DOWN_HOLD_MS);
+  rng_state = 2024;
+  for (int i = 0; i < sc->n; i++)
+    voters[i].cfg = &sc->v[i];
+
+  for (uint64_t t = 0; t < end_us; t += DT_US) {
+    uint32_t now_ms = (uint32_t)(t / 1000);
+    uint32_t mhz;
+    uint64_t budget;
+    double step_used = 0;
+
+    for (int i = 0; i < sc->n; i++) {
+      voter_t *v = &voters[i];
+      const voter_cfg_t *cfg = v->cfg;
+      bool want = t >= cfg->start_s * 1e6 && t < cfg->stop_s * 1e6;
+
+      if (want && !v->active) {
+        v->active = true;
+        v->next_release_us = t;
+        v->count = 0;
+        if (m == M_GOV) {
+          sysfreq_gov_register(&gov, cfg->id, cfg->period_us, 0, now_ms);
+          sysfreq_gov_miss(&gov, cfg->id, START_BOOST_PERIODS, now_ms);
+        }
+      } else if (!want && v->active) {
+        v->active = false;
+        if (m == M_GOV)
+          sysfreq_gov_unregister(&gov, cfg->id, now_ms);
+      }
+      if (!v->active)
+        continue;
+
+      if (t >= v->next_release_us) {
+        job_t *j;
+
+        if (v->count == MAX_JOBS) {
+          v->head = (v->head + 1) % MAX_JOBS;
+          v->count--;
+        }
+        j = &v->jobs[(v->head + v->count) % MAX_JOBS];
+        memset(j, 0, sizeof(*j));
+        j->release_us = v->next_release_us;
+        j->deadline_us = v->next_release_us + cfg->period_us;
+        j->left = job_cycles(cfg, v->released++, t * 1e-6);
+        v->count++;
+        v->next_release_us += cfg->period_us;
+        r->jobs++;
+      }
+
+      for (int k = 0; k < v->count; k++) {
+        job_t *j = &v->jobs[(v->head + k) % MAX_JOBS];
+
+        if (!j->missed && t >= j->deadline_us) {
+          j->missed = true;
+          r->misses++;
+          if (m == M_GOV)
+            sysfreq_gov_miss(&gov, cfg->id, MISS_BOOST_PERIODS, now_ms);
+        }
+      }
+    }
+
+    mhz = m == M_GOV ? gov_mhz(&gov) : static_mhz(voters, sc->n);
+    mhz_sum += mhz;
+    if (mhz > r->max_mhz)
+      r->max_mhz = mhz;
+
+    budget = (uint64_t)mhz * DT_US;
+    while (budget) {
+      voter_t *owner = NULL;
+      job_t *j = pick_job(voters, sc->n, &owner);
+      uint32_t run;
+
+      if (!j)
+        break;
+      if (!j->started) {
+        j->started = true;
+        j->start_us = t + (uint64_t)step_used;
+      }
+      run = j->left < budget ? j->left : (uint32_t)budget;
+      j->left -= run;
+      budget -= run;
+      step_used += (double)run / mhz;
+      if (j->left == 0) {
+        uint64_t done_us = t + (uint64_t)step_used;
+        uint32_t measured = (uint32_t)((done_us - j->start_us + 1) * mhz);
+
+        if (m == M_GOV)
+          sysfreq_gov_report(&gov, owner->cfg->id, measured, now_ms);
+        owner->head = (owner->head + 1) % MAX_JOBS;
+        owner->count--;
+      }
+    }
+  }
+
+  r->avg_mhz = (double)mhz_sum / (end_us / DT_US);
+  r->switches = gov.switches;
+}
+
+static void test_governor_basics(void) {
+  SYSFREQ_GOV_T gov;
+
+  sysfreq_gov_init(&gov, 20, 1000);
+  assert(sysfreq_gov_level(&gov) == SYSFREQ_GOV_LEVEL_NONE);
+
+  // 10000 cycles per 1000 us is 10 MHz: 26M fits with 20% to spare.
+  assert(sysfreq_gov_register(&gov, 3, 1000, 10000, 0) == 0);
+  // 35 MHz more does not fit 52M * 0.8, so 78M right away.
+  assert(sysfreq_gov_register(&gov, 6, 1000, 35000, 0) == 2);
+  assert(sysfreq_gov_load_mhz(&gov) == 45);
+  // Registering again keeps the larger budget.
+  assert(sysfreq_gov_register(&gov, 6, 1000, 0, 0) == 2);
+
+  // Unregistering lets the clock fall, one level per hold time.
+  assert(sysfreq_gov_unregister(&gov, 6, 100) == 2);
+  assert(sysfreq_gov_report(&gov, 3, 10000, 600) == 2);
+  assert(sysfreq_gov_report(&gov, 3, 10000, 1100) == 1);
+  assert(sysfreq_gov_report(&gov, 3, 10000, 1500) == 1);
+  assert(sysfreq_gov_report(&gov, 3, 10000, 2100) == 0);
+
+  // Reported peaks decay by 1/256 per period.
+  assert(sysfreq_gov_report(&gov, 3, 40000, 2200) == 1);
+  assert(gov.voters[3].budget_cycles == 40000);
+  assert(sysfreq_gov_report(&gov, 3, 0, 2300) == 1);
+  assert(gov.voters[3].budget_cycles == 40000 - 40000 / 256);
+
+  // Out of range or unknown voters are ignored.
+  assert(sysfreq_gov_report(&gov, 9, 1000000, 2400) == 1);
+  assert(sysfreq_gov_register(&gov, SYSFREQ_GOV_VOTER_QTY, 1, 1000000,
+                              2400) == 1);
+
+  assert(sysfreq_gov_unregister(&gov, 3, 2500) == SYSFREQ_GOV_LEVEL_NONE);
+}
+
+static void test_boost(void) {
+  SYSFREQ_GOV_T gov;
+
+  sysfreq_gov_init(&gov, 20, 1000);
+  assert(sysfreq_gov_register(&gov, 3, 1000, 10000, 0) == 0);
+
+  // A miss raises the clock one level above what the voter needs.
+  assert(sysfreq_gov_miss(&gov, 3, 1, 10) == 1);
+  assert(sysfreq_gov_boosting(&gov, 3));
+  assert(sysfreq_gov_load_mhz(&gov) == 10);
+  // The period of the miss does not count, the next one does.
+  assert(sysfreq_gov_report(&gov, 3, 10000, 11) == 1);
+  assert(sysfreq_gov_boosting(&gov, 3));
+  sysfreq_gov_report(&gov, 3, 10000, 12);
+  assert(!sysfreq_gov_boosting(&gov, 3));
+  // Then the clock comes down as usual.
+  assert(sysfreq_gov_report(&gov, 3, 10000, 13) == 1);
+  assert(sysfreq_gov_report(&gov, 3, 10000, 1013) == 0);
+
+  // Another voter holds the clock at 78M: a miss goes one above that.
+  assert(sysfreq_gov_register(&gov, 6, 1000, 40000, 1100) == 2);
+  assert(sysfreq_gov_miss(&gov, 3, 1, 1100) == 3);
+  assert(sysfreq_gov_unregister(&gov, 6, 1100) == 3);
+  sysfreq_gov_report(&gov, 3, 10000, 1101);
+  sysfreq_gov_report(&gov, 3, 10000, 1102);
+  assert(!sysfreq_gov_boosting(&gov, 3));
+
+  // A miss from a voter that is not registered does nothing.
+  assert(sysfreq_gov_miss(&gov, 5, 2, 1200) == 3);
+  assert(!sysfreq_gov_boosting(&gov, 5));
+  assert(sysfreq_gov_unregister(&gov, 3, 1300) == SYSFREQ_GOV_LEVEL_NONE);
+}
+
+// However often it misses, a voter that fits 104M is not boosted past it;
+// only a load that needs 208M gets 208M.
+static void test_boost_cap(void) {
+  SYSFREQ_GOV_T gov;
+
+  sysfreq_gov_init(&gov, 20, 1000);
+  // 70 MHz: 104M with 20% to spare, like AAC or LDAC.
+  assert(sysfreq_gov_register(&gov, 3, 1000, 70000, 0) ==
+         SYSFREQ_GOV_BOOST_MAX_LEVEL);
+  assert(sysfreq_gov_miss(&gov, 3, 20, 0) == SYSFREQ_GOV_BOOST_MAX_LEVEL);
+  for (int i = 1; i <= 30; i++) {
+    assert(sysfreq_gov_miss(&gov, 3, 1, i) == SYSFREQ_GOV_BOOST_MAX_LEVEL);
+    assert(sysfreq_gov_report(&gov, 3, 70000, i) ==
+           SYSFREQ_GOV_BOOST_MAX_LEVEL);
+  }
+
+  // A voter just registered, with no budget yet, as at a2dp_audio_init().
+  sysfreq_gov_init(&gov, 20, 1000);
+  sysfreq_gov_register(&gov, 3, 23220, 0, 0);
+  assert(sysfreq_gov_miss(&gov, 3, 20, 0) == 1);
+
+  // The load itself needs 208M: the boost does not hold it down.
+  sysfreq_gov_init(&gov, 20, 1000);
+  assert(sysfreq_gov_register(&gov, 3, 1000, 100000, 0) == 4);
+  assert(sysfreq_gov_miss(&gov, 3, 2, 10) == 4);
+  assert(sysfreq_gov_miss(&gov, 3, 5, 10) == 4);
+  for (int i = 0; i < 5; i++)
+    sysfreq_gov_report(&gov, 3, 100000, 11 + i);
+  assert(sysfreq_gov_boosting(&gov, 3));
+  sysfreq_gov_report(&gov, 3, 100000, 16);
+  assert(!sysfreq_gov_boosting(&gov, 3));
+}
+
+static void run_all(bool check) {
+  double gov_total = 0, stat_total = 0;
+
+  printf("%-24s %-7s %8s %7s %6s %8s %7s\n", "scenario", "method", "avg MHz",
+         "max", "jobs", "misses", "switch");
+  for (int i = 0; i < NUM_SCENARIOS; i++) {
+    const scenario_t *sc = &scenarios[i];
+    result_t gov, stat;
+
+    simulate(sc, M_GOV, &gov);
+    simulate(sc, M_STATIC, &stat);
+    printf("%-24s %-7s %8.1f %7u %6u %8u %7u\n", sc->name, "static",
+           stat.avg_mhz, stat.max_mhz, stat.jobs, stat.misses, 0u);
+    printf("%-24s %-7s %8.1f %7u %6u %8u %7u\n", "", "gov", gov.avg_mhz,
+           gov.max_mhz, gov.jobs, gov.misses, gov.switches);
+    gov_total += gov.avg_mhz;
+    stat_total += stat.avg_mhz;
+
+    if (!check)
+      continue;
+    if (sc->static_enough)
+      assert(stat.misses == 0);
+    // Never above the static clock, deadlines kept but for a handful while
+    // the budget catches up, and no faster switching than the hold allows
+    // on average.
+    assert(gov.avg_mhz <= stat.avg_mhz);
+    // Boosts stay within what the static requests asked for.
+    assert(gov.max_mhz <= stat.max_mhz);
+    assert(gov.misses <= 5);
+    assert(gov.switches <= sc->duration_s * 1000 / GOV_DOWN_HOLD_MS);
+  }
+  printf("overall: gov %.1f%% of static\n", 100 * gov_total / stat_total);
+  if (check)
+    assert(gov_total < 0.85 * stat_total);
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-t]\n", prog);
+  fprintf(stderr, "  -t  check results and unit behaviour\n");
+}
+
+int main(int argc, char **argv) {
+  bool check = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "t")) != -1) {
+    switch (opt) {
+    case 't':
+      check = true;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (check) {
+    test_governor_basics();
+    test_boost();
+    test_boost_cap();
+  }
+  run_all(check);
+  if (check)
+    printf("All sysfreq governor sim checks passed.\n");
+  return 0;
+}
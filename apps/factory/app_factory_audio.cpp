@@ -98,6 +98,11 @@ int app_factorymode_audioloop(bool on, enum APP_SYSFREQ_FREQ_T freq) {
     stream_cfg.io_path = AUD_INPUT_PATH_MAINMIC;
     stream_cfg.handler = app_factorymode_data_come;
 
+    // Mic straight to speaker: quarter-buffer periods, and playback only one
+    // period ahead of the DMA, keep the loop latency down.
+    af_stream_set_periods(AUD_STREAM_ID_0, AUD_STREAM_CAPTURE, 4, 0);
+    af_stream_set_periods(AUD_STREAM_ID_0, AUD_STREAM_PLAYBACK, 4, 1);
+
     stream_cfg.data_ptr = BT_AUDIO_CACHE_2_UNCACHE(buff_capture);
     stream_cfg.data_size = BT_AUDIO_FACTORMODE_BUFF_SIZE;
     af_stream_open(AUD_STREAM_ID_0, AUD_STREAM_CAPTURE, &stream_cfg);
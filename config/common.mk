@@ -1023,6 +1023,9 @@ KBUILD_CPPFLAGS += -DROM_UTILS_ON
 core-y += utils/rom_utils/
 endif
 
+# heap_register() heaps use the TLSF allocator instead of the best-fit list
+export HEAP_TLSF ?= 0
+
 # -------------------------------------------
 # Features
 # -------------------------------------------
@@ -1763,6 +1766,11 @@ ifeq ($(AUDIO_LOOPBACK),1)
 KBUILD_CPPFLAGS += -DAUDIO_LOOPBACK
 endif
 
+export AUDIO_CAPTURE ?= 0
+ifeq ($(AUDIO_CAPTURE),1)
+KBUILD_CPPFLAGS += -DAUDIO_CAPTURE
+endif
+
 
 export INTERACTION_FASTPAIR ?= 0
 ifeq ($(INTERACTION_FASTPAIR),1)
@@ -0,0 +1,475 @@
+use std::collections::BTreeMap;
+use std::fs::File;
+use std::io::{Read, Write};
+use std::path::{Path, PathBuf};
+
+// Turns a trace log captured with AUDIO_CAPTURE=1 into one WAV per stream.
+// The frames are found by their magic among the text of the log, checked
+// against their CRC and put back in order by sample index; samples of frames
+// that never arrived are filled with silence and reported.
+//
+// Frame layout: services/audio_dump/include/audio_capture.h
+
+const MAGIC: [u8; 4] = *b"ACAP";
+const VERSION: u8 = 1;
+const HEADER_SIZE: usize = 24;
+const CRC_SIZE: usize = 4;
+const MAX_PAYLOAD: usize = 512;
+const MAX_CHANNELS: u8 = 8;
+
+const TAP_NAMES: [&str; 13] = [
+    "ap_in",
+    "ap_block_gain",
+    "ap_sw_iir",
+    "ap_hw_fir",
+    "ap_drc",
+    "ap_limiter",
+    "ap_hw_iir",
+    "ap_out",
+    "sco_tx_in",
+    "sco_tx_ref",
+    "sco_tx_out",
+    "sco_rx_in",
+    "sco_rx_out",
+];
+
+fn tap_name(tap: u8) -> String {
+    match TAP_NAMES.get(tap as usize) {
+        Some(name) => name.to_string(),
+        None => format!("tap{}", tap),
+    }
+}
+
+#[derive(Debug, Clone, PartialEq)]
+struct Frame {
+    tap: u8,
+    channels: u8,
+    sample_bytes: u8,
+    seq: u32,
+    sample_rate: u32,
+    frames: u16,
+    channel_mask: u16,
+    sample_index: u32,
+    payload: Vec<u8>,
+}
+
+fn le16(b: &[u8]) -> u16 {
+    u16::from_le_bytes([b[0], b[1]])
+}
+
+fn le32(b: &[u8]) -> u32 {
+    u32::from_le_bytes([b[0], b[1], b[2], b[3]])
+}
+
+// zlib CRC-32, as utils/crc32 computes it on the device.
+fn crc32(data: &[u8]) -> u32 {
+    let mut crc = 0xFFFF_FFFFu32;
+    for &byte in data {
+        crc ^= byte as u32;
+        for _ in 0..8 {
+            crc = if crc & 1 != 0 {
+                0xEDB8_8320 ^ (crc >> 1)
+            } else {
+                crc >> 1
+            };
+        }
+    }
+    !crc
+}
+
+#[derive(Debug, Default, PartialEq)]
+struct ScanStats {
+    frames: u32,
+    bad_frames: u32,
+    // Bytes that were not part of a good frame: log text, broken frames.
+    skipped: usize,
+}
+
+enum Parsed {
+    Good(Frame, usize),
+    Bad,
+    Short,
+}
+
+fn parse_at(buf: &[u8]) -> Parsed {
+    if buf.len() < HEADER_SIZE {
+        return Parsed::Short;
+    }
+    let h = &buf[..HEADER_SIZE];
+    let channels = h[6];
+    let sample_bytes = h[7];
+    let frames = le16(&h[16..]);
+    if h[4] != VERSION
+        || channels == 0
+        || channels > MAX_CHANNELS
+        || !(sample_bytes == 2 || sample_bytes == 3)
+    {
+        return Parsed::Bad;
+    }
+    let payload = frames as usize * channels as usize * sample_bytes as usize;
+    if payload == 0 || payload > MAX_PAYLOAD {
+        return Parsed::Bad;
+    }
+    let total = HEADER_SIZE + payload + CRC_SIZE;
+    if buf.len() < total {
+        return Parsed::Short;
+    }
+    if crc32(&buf[..HEADER_SIZE + payload]) != le32(&buf[HEADER_SIZE + payload..]) {
+        return Parsed::Bad;
+    }
+    Parsed::Good(
+        Frame {
+            tap: h[5],
+            channels,
+            sample_bytes,
+            seq: le32(&h[8..]),
+            sample_rate: le32(&h[12..]),
+            frames,
+            channel_mask: le16(&h[18..]),
+            sample_index: le32(&h[20..]),
+            payload: buf[HEADER_SIZE..HEADER_SIZE + payload].to_vec(),
+        },
+        total,
+    )
+}
+
+// Finds every good frame; after a bad one the search goes on from the next
+// byte, so a frame cut short by dropped trace output costs only itself.
+fn scan(buf: &[u8]) -> (Vec<Frame>, ScanStats) {
+    let mut frames = Vec::new();
+    let mut stats = ScanStats::default();
+    let mut pos = 0;
+
+    while pos < buf.len() {
+        let next = buf[pos..].windows(4).position(|w| w == MAGIC);
+        let Some(off) = next else {
+            stats.skipped += buf.len() - pos;
+            break;
+        };
+        stats.skipped += off;
+        pos += off;
+        match parse_at(&buf[pos..]) {
+            Parsed::Good(frame, len) => {
+                frames.push(frame);
+                stats.frames += 1;
+                pos += len;
+            }
+            Parsed::Bad => {
+                stats.bad_frames += 1;
+                stats.skipped += 1;
+                pos += 1;
+            }
+            Parsed::Short => {
+                stats.skipped += buf.len() - pos;
+                break;
+            }
+        }
+    }
+    (frames, stats)
+}
+
+// The format of one stream; a change of any of these starts a new WAV.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord)]
+struct StreamKey {
+    tap: u8,
+    channel_mask: u16,
+    channels: u8,
+    sample_bytes: u8,
+    sample_rate: u32,
+}
+
+#[derive(Debug, Default)]
+struct Segment {
+    first_index: u32,
+    next_index: u32,
+    data: Vec<u8>,
+    // Sample frames filled with silence, and the runs of them.
+    filled: u64,
+    gaps: u32,
+}
+
+#[derive(Debug, Default)]
+struct Assembled {
+    streams: BTreeMap<StreamKey, Vec<Segment>>,
+    // Frames missing from the sequence, over all streams.
+    lost_frames: u32,
+}
+
+fn assemble(frames: &[Frame]) -> Assembled {
+    let mut out = Assembled::default();
+    let mut last_seq: Option<u32> = None;
+
+    for f in frames {
+        if let Some(last) = last_seq {
+            let step = f.seq.wrapping_sub(last);
+            // Anything else is a restart of the device or an old frame.
+            if step > 1 && step < 0x8000_0000 {
+                out.lost_frames += step - 1;
+            }
+        }
+        last_seq = Some(f.seq);
+
+        let key = StreamKey {
+            tap: f.tap,
+            channel_mask: f.channel_mask,
+            channels: f.channels,
+            sample_bytes: f.sample_bytes,
+            sample_rate: f.sample_rate,
+        };
+        let frame_bytes = f.channels as usize * f.sample_bytes as usize;
+        let segments = out.streams.entry(key).or_default();
+        let restart = match segments.last() {
+            Some(seg) => f.sample_index < seg.next_index,
+            None => true,
+        };
+        if restart {
+            segments.push(Segment {
+                first_index: f.sample_index,
+                next_index: f.sample_index,
+                ..Default::default()
+            });
+        }
+        let seg = segments.last_mut().unwrap();
+        if f.sample_index > seg.next_index {
+            let missing = (f.sample_index - seg.next_index) as usize;
+            seg.data.resize(seg.data.len() + missing * frame_bytes, 0);
+            seg.filled += missing as u64;
+            seg.gaps += 1;
+        }
+        seg.data.extend_from_slice(&f.payload);
+        seg.next_index = f.sample_index + f.frames as u32;
+    }
+    out
+}
+
+fn wav_bytes(key: &StreamKey, data: &[u8]) -> Vec<u8> {
+    let block_align = key.channels as u32 * key.sample_bytes as u32;
+    let mut w = Vec::with_capacity(44 + data.len());
+
+    w.extend_from_slice(b"RIFF");
+    w.extend_from_slice(&(36 + data.len() as u32).to_le_bytes());
+    w.extend_from_slice(b"WAVEfmt ");
+    w.extend_from_slice(&16u32.to_le_bytes());
+    w.extend_from_slice(&1u16.to_le_bytes());
+    w.extend_from_slice(&(key.channels as u16).to_le_bytes());
+    w.extend_from_slice(&key.sample_rate.to_le_bytes());
+    w.extend_from_slice(&(key.sample_rate * block_align).to_le_bytes());
+    w.extend_from_slice(&(block_align as u16).to_le_bytes());
+    w.extend_from_slice(&(key.sample_bytes as u16 * 8).to_le_bytes());
+    w.extend_from_slice(b"data");
+    w.extend_from_slice(&(data.len() as u32).to_le_bytes());
+    w.extend_from_slice(data);
+    w
+}
+
+fn wav_name(key: &StreamKey, segment: usize) -> String {
+    format!(
+        "{}_m{:x}_{}hz_{}.wav",
+        tap_name(key.tap),
+        key.channel_mask,
+        key.sample_rate,
+        segment
+    )
+}
+
+fn write_wavs(out_dir: &Path, assembled: &Assembled) -> std::io::Result<Vec<PathBuf>> {
+    let mut written = Vec::new();
+
+    std::fs::create_dir_all(out_dir)?;
+    for (key, segments) in &assembled.streams {
+        for (i, seg) in segments.iter().enumerate() {
+            let path = out_dir.join(wav_name(key, i));
+            File::create(&path)?.write_all(&wav_bytes(key, &seg.data))?;
+            written.push(path);
+        }
+    }
+    Ok(written)
+}
+
+fn main() {
+    let args: Vec<String> = std::env::args().collect();
+    if args.len() < 2 {
+        eprintln!("usage: {} <trace capture> [output dir]", args[0]);
+        std::process::exit(2);
+    }
+    let out_dir = PathBuf::from(args.get(2).map(String::as_str).unwrap_or("."));
+
+    let mut buf = Vec::new();
+    File::open(&args[1])
+        .and_then(|mut f| f.read_to_end(&mut buf))
+        .expect("could not read capture");
+
+    let (frames, stats) = scan(&buf);
+    let assembled = assemble(&frames);
+    let written = write_wavs(&out_dir, &assembled).expect("could not write wav");
+
+    println!(
+        "{} frames, {} broken, {} bytes of other output",
+        stats.frames, stats.bad_frames, stats.skipped
+    );
+    println!(
+        "{} frames lost on the device or the link",
+        assembled.lost_frames
+    );
+    let mut paths = written.iter();
+    for (key, segments) in &assembled.streams {
+        let frame_bytes = key.channels as usize * key.sample_bytes as usize;
+        for seg in segments {
+            let samples = seg.data.len() / frame_bytes;
+            println!(
+                "{}: {} ch, {} Hz, {:.2} s from sample {}, {} samples of silence in {} gaps",
+                paths.next().unwrap().display(),
+                key.channels,
+                key.sample_rate,
+                samples as f64 / key.sample_rate.max(1) as f64,
+                seg.first_index,
+                seg.filled,
+                seg.gaps
+            );
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // Builds a frame the way audio_capture.c does.
+    fn encode(f: &Frame) -> Vec<u8> {
+        let mut b = Vec::new();
+        b.extend_from_slice(&MAGIC);
+        b.extend_from_slice(&[VERSION, f.tap, f.channels, f.sample_bytes]);
+        b.extend_from_slice(&f.seq.to_le_bytes());
+        b.extend_from_slice(&f.sample_rate.to_le_bytes());
+        b.extend_from_slice(&f.frames.to_le_bytes());
+        b.extend_from_slice(&f.channel_mask.to_le_bytes());
+        b.extend_from_slice(&f.sample_index.to_le_bytes());
+        b.extend_from_slice(&f.payload);
+        let crc = crc32(&b);
+        b.extend_from_slice(&crc.to_le_bytes());
+        b
+    }
+
+    fn mono16(seq: u32, sample_index: u32, frames: u16) -> Frame {
+        let payload = (0..frames)
+            .flat_map(|i| ((sample_index + i as u32) as i16).to_le_bytes())
+            .collect();
+        Frame {
+            tap: 7,
+            channels: 1,
+            sample_bytes: 2,
+            seq,
+            sample_rate: 16000,
+            frames,
+            channel_mask: 1,
+            sample_index,
+            payload,
+        }
+    }
+
+    #[test]
+    fn crc_matches_zlib() {
+        assert_eq!(crc32(b"123456789"), 0xCBF4_3926);
+        assert_eq!(crc32(&[]), 0);
+    }
+
+    #[test]
+    fn finds_frames_between_log_lines() {
+        let a = mono16(0, 0, 100);
+        let b = mono16(1, 100, 100);
+        let mut buf = b"boot ok\r\n[audio_capture_select] stream 0\r\n".to_vec();
+        buf.extend(encode(&a));
+        buf.extend_from_slice(b"ACAP but not a frame\r\n");
+        buf.extend(encode(&b));
+        buf.extend_from_slice(b"tail");
+
+        let (frames, stats) = scan(&buf);
+        assert_eq!(frames, vec![a, b]);
+        assert_eq!(stats.frames, 2);
+        assert!(stats.bad_frames >= 1);
+    }
+
+    #[test]
+    fn corrupt_and_cut_frames_are_skipped() {
+        let mut first = encode(&mono16(0, 0, 100));
+        first[HEADER_SIZE + 10] ^= 0x01;
+        let second = encode(&mono16(1, 100, 100));
+        let mut buf = first;
+        buf.extend(&second);
+        // A frame cut short by discarded trace output, then a good one.
+        buf.extend(&second[..50]);
+        buf.extend(encode(&mono16(2, 200, 100)));
+
+        let (frames, stats) = scan(&buf);
+        assert_eq!(frames.len(), 2);
+        assert_eq!(frames[0].seq, 1);
+        assert_eq!(frames[1].seq, 2);
+        assert_eq!(stats.bad_frames, 2);
+    }
+
+    #[test]
+    fn gaps_are_filled_and_counted() {
+        let frames = vec![mono16(0, 0, 100), mono16(3, 300, 100), mono16(4, 400, 50)];
+        let out = assemble(&frames);
+        assert_eq!(out.lost_frames, 2);
+
+        let segs = out.streams.values().next().unwrap();
+        assert_eq!(segs.len(), 1);
+        assert_eq!(segs[0].filled, 200);
+        assert_eq!(segs[0].gaps, 1);
+        assert_eq!(segs[0].data.len(), 450 * 2);
+        // Samples land at their own index.
+        assert_eq!(le16(&segs[0].data[2 * 300..]), 300);
+        assert_eq!(le16(&segs[0].data[2 * 150..]), 0);
+    }
+
+    #[test]
+    fn restart_and_format_change_split_files() {
+        let mut other = mono16(2, 0, 10);
+        other.sample_rate = 8000;
+        let frames = vec![
+            mono16(0, 0, 100),
+            mono16(1, 100, 100),
+            other,
+            mono16(3, 0, 10),
+        ];
+        let out = assemble(&frames);
+        assert_eq!(out.lost_frames, 0);
+        assert_eq!(out.streams.len(), 2);
+
+        let names: Vec<String> = out
+            .streams
+            .iter()
+            .flat_map(|(k, s)| (0..s.len()).map(move |i| wav_name(k, i)))
+            .collect();
+        assert_eq!(
+            names,
+            vec![
+                "ap_out_m1_8000hz_0.wav",
+                "ap_out_m1_16000hz_0.wav",
+                "ap_out_m1_16000hz_1.wav"
+            ]
+        );
+    }
+
+    #[test]
+    fn wav_header_describes_the_stream() {
+        let key = StreamKey {
+            tap: 8,
+            channel_mask: 5,
+            channels: 2,
+            sample_bytes: 3,
+            sample_rate: 16000,
+        };
+        let w = wav_bytes(&key, &[0u8; 60]);
+        assert_eq!(&w[0..4], b"RIFF");
+        assert_eq!(le32(&w[4..]), 36 + 60);
+        assert_eq!(le16(&w[22..]), 2);
+        assert_eq!(le32(&w[24..]), 16000);
+        assert_eq!(le32(&w[28..]), 16000 * 6);
+        assert_eq!(le16(&w[32..]), 6);
+        assert_eq!(le16(&w[34..]), 24);
+        assert_eq!(le32(&w[40..]), 60);
+        assert_eq!(w.len(), 44 + 60);
+    }
+}
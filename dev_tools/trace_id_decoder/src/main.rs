@@ -0,0 +1,623 @@
+use std::fs::File;
+use std::io::{BufWriter, Read, Write};
+
+// Turns the output of a USE_TRACE_ID build back into the text it would have
+// printed. Binary records are looked up in the .str file written beside the
+// image and formatted here; all other output is passed through unchanged.
+//
+// Record layout: platform/hal/hal_trace_id.h
+
+const SYNC: u8 = 0xBE;
+const HEADER_SIZE: usize = 12;
+const MAX_ARGS: usize = 10;
+const CTX_ISR: u16 = 1 << 14;
+const CTX_CP: u16 = 1 << 15;
+const MAX_OFFSET: u32 = 0x3F_FFFF;
+const NO_LF: u32 = 1 << 22;
+const NO_TS: u32 = 1 << 23;
+
+// Where the link puts the sections in the .str file (STR_BIN in Makefile).
+const STR_RODATA_OFFSET: usize = 0x10;
+const STR_TRC_OFFSET: usize = 0x8000;
+
+const LEVEL_CHARS: &[u8; 8] = b"CEWNIDV-";
+
+// _LOG_MODULE_LIST in platform/hal/hal_trace_mod.h.
+const MODULE_NAMES: [&str; 27] = [
+    "NONE",
+    "HAL",
+    "DRVANA",
+    "DRVCODEC",
+    "DRVBT",
+    "DRVFLS",
+    "DRVSEC",
+    "DRVUSB",
+    "AUDFLG",
+    "MAIN",
+    "RT_OS",
+    "BTPRF",
+    "BLEPRF",
+    "BTAPP",
+    "BLEAPP",
+    "TWSAPP",
+    "IBRTAPP",
+    "APPMAIN",
+    "APPTHREAD",
+    "PLAYER",
+    "TEST",
+    "AUD",
+    "OTA",
+    "NV_SEC",
+    "AI_GVA",
+    "AI_AMA",
+    "AI_GMA",
+];
+
+fn le16(b: &[u8]) -> u16 {
+    u16::from_le_bytes([b[0], b[1]])
+}
+
+fn le32(b: &[u8]) -> u32 {
+    u32::from_le_bytes([b[0], b[1], b[2], b[3]])
+}
+
+// hal_trace_id_crc8(): poly 0x07, initial value 0.
+fn crc8(data: &[u8]) -> u8 {
+    let mut crc = 0u8;
+    for &byte in data {
+        crc ^= byte;
+        for _ in 0..8 {
+            crc = if crc & 0x80 != 0 {
+                (crc << 1) ^ 0x07
+            } else {
+                crc << 1
+            };
+        }
+    }
+    crc
+}
+
+fn c_string(data: &[u8], start: usize) -> Option<&[u8]> {
+    let rest = data.get(start..)?;
+    let end = rest.iter().position(|&b| b == 0)?;
+    Some(&rest[..end])
+}
+
+struct StrTable {
+    data: Vec<u8>,
+    // Device address of .rodata_str, the first word of the file.
+    rodata_start: u32,
+}
+
+impl StrTable {
+    fn new(data: Vec<u8>) -> StrTable {
+        let rodata_start = if data.len() >= 4 { le32(&data) } else { 0 };
+        StrTable { data, rodata_start }
+    }
+
+    fn format(&self, offset: u32) -> Option<&[u8]> {
+        c_string(&self.data, STR_TRC_OFFSET + offset as usize)
+    }
+
+    // A %s argument, when it points into .rodata_str (__func__ and the like).
+    fn string_at(&self, addr: u32) -> Option<&[u8]> {
+        if self.rodata_start == 0 || addr < self.rodata_start {
+            return None;
+        }
+        let offset = STR_RODATA_OFFSET + (addr - self.rodata_start) as usize;
+        if offset >= STR_TRC_OFFSET {
+            return None;
+        }
+        c_string(&self.data, offset)
+    }
+}
+
+#[derive(Debug, PartialEq)]
+struct Record {
+    attr: u16,
+    ms: u32,
+    offset: u32,
+    // LOG_ATTR_NO_LF and LOG_ATTR_NO_TS: no newline, no time stamp prefix.
+    no_lf: bool,
+    no_ts: bool,
+    ctx: u8,
+    args: Vec<u32>,
+}
+
+impl Record {
+    fn level(&self) -> usize {
+        ((self.attr >> 4) & 0x7) as usize
+    }
+
+    fn module(&self) -> usize {
+        ((self.attr >> 7) & 0x7F) as usize
+    }
+}
+
+// A record at the start of |buf|, and its length.
+fn parse_record(buf: &[u8]) -> Option<(Record, usize)> {
+    if buf.len() < HEADER_SIZE || buf[0] != SYNC {
+        return None;
+    }
+    let attr = le16(&buf[2..]);
+    let num = (attr & 0xF) as usize;
+    let len = HEADER_SIZE + 4 * num;
+    if num > MAX_ARGS || buf.len() < len || crc8(&buf[2..len]) != buf[1] {
+        return None;
+    }
+    let word = le32(&buf[8..]);
+    let record = Record {
+        attr,
+        ms: le32(&buf[4..]),
+        offset: word & MAX_OFFSET,
+        no_lf: word & NO_LF != 0,
+        no_ts: word & NO_TS != 0,
+        ctx: (word >> 24) as u8,
+        args: buf[HEADER_SIZE..len].chunks(4).map(le32).collect(),
+    };
+    Some((record, len))
+}
+
+#[derive(Debug, Default, PartialEq)]
+struct Spec {
+    left: bool,
+    zero: bool,
+    plus: bool,
+    space: bool,
+    alt: bool,
+    width: usize,
+    precision: Option<usize>,
+}
+
+impl Spec {
+    fn pad(&self, body: String, prefix: &str) -> String {
+        let len = prefix.len() + body.len();
+        if len >= self.width {
+            return format!("{}{}", prefix, body);
+        }
+        let fill = self.width - len;
+        if self.left {
+            format!("{}{}{}", prefix, body, " ".repeat(fill))
+        } else if self.zero && self.precision.is_none() {
+            format!("{}{}{}", prefix, "0".repeat(fill), body)
+        } else {
+            format!("{}{}{}", " ".repeat(fill), prefix, body)
+        }
+    }
+
+    fn integer(&self, conv: u8, value: u32) -> String {
+        let (negative, magnitude) = match conv {
+            b'd' | b'i' => {
+                let v = value as i32;
+                (v < 0, v.unsigned_abs())
+            }
+            _ => (false, value),
+        };
+        let mut digits = match conv {
+            b'x' | b'p' => format!("{:x}", magnitude),
+            b'X' => format!("{:X}", magnitude),
+            b'o' => format!("{:o}", magnitude),
+            _ => magnitude.to_string(),
+        };
+        if let Some(p) = self.precision {
+            if p == 0 && magnitude == 0 {
+                digits.clear();
+            } else if digits.len() < p {
+                digits = format!("{}{}", "0".repeat(p - digits.len()), digits);
+            }
+        }
+        let prefix = match conv {
+            b'd' | b'i' if negative => "-",
+            b'd' | b'i' if self.plus => "+",
+            b'd' | b'i' if self.space => " ",
+            b'x' if self.alt && magnitude != 0 => "0x",
+            b'X' if self.alt && magnitude != 0 => "0X",
+            b'o' if self.alt && !digits.starts_with('0') => "0",
+            b'p' => "0x",
+            _ => "",
+        };
+        self.pad(digits, prefix)
+    }
+}
+
+// The printf() subset a record can carry: one word per argument, so 64-bit
+// and floating-point conversions are shown as unsupported.
+fn format_args(fmt: &[u8], args: &[u32], strings: &StrTable) -> String {
+    let mut out = String::new();
+    let mut args = args.iter().copied();
+    let mut i = 0;
+
+    while i < fmt.len() {
+        if fmt[i] != b'%' {
+            let next = fmt[i..]
+                .iter()
+                .position(|&b| b == b'%')
+                .map_or(fmt.len(), |n| i + n);
+            out.push_str(&String::from_utf8_lossy(&fmt[i..next]));
+            i = next;
+            continue;
+        }
+        let start = i;
+        i += 1;
+        let mut spec = Spec::default();
+        while i < fmt.len() {
+            match fmt[i] {
+                b'-' => spec.left = true,
+                b'0' => spec.zero = true,
+                b'+' => spec.plus = true,
+                b' ' => spec.space = true,
+                b'#' => spec.alt = true,
+                _ => break,
+            }
+            i += 1;
+        }
+        if fmt.get(i) == Some(&b'*') {
+            let w = args.next().unwrap_or(0) as i32;
+            spec.left |= w < 0;
+            spec.width = w.unsigned_abs() as usize;
+            i += 1;
+        }
+        while i < fmt.len() && fmt[i].is_ascii_digit() {
+            spec.width = spec.width * 10 + (fmt[i] - b'0') as usize;
+            i += 1;
+        }
+        if fmt.get(i) == Some(&b'.') {
+            i += 1;
+            let mut p = 0;
+            if fmt.get(i) == Some(&b'*') {
+                p = (args.next().unwrap_or(0) as i32).max(0) as usize;
+                i += 1;
+            }
+            while i < fmt.len() && fmt[i].is_ascii_digit() {
+                p = p * 10 + (fmt[i] - b'0') as usize;
+                i += 1;
+            }
+            spec.precision = Some(p);
+        }
+        let mut wide = false;
+        while i < fmt.len() {
+            match fmt[i] {
+                b'h' | b'z' | b't' | b'j' => {}
+                b'l' => wide |= fmt.get(i + 1) == Some(&b'l'),
+                b'L' | b'q' => wide = true,
+                _ => break,
+            }
+            i += 1;
+        }
+        let Some(&conv) = fmt.get(i) else {
+            out.push_str(&String::from_utf8_lossy(&fmt[start..]));
+            break;
+        };
+        i += 1;
+        let text = String::from_utf8_lossy(&fmt[start..i]);
+
+        if conv == b'%' {
+            out.push('%');
+            continue;
+        }
+        if !b"diuxXocspeEfFgGaA".contains(&conv) {
+            out.push_str(&text);
+            continue;
+        }
+        let Some(value) = args.next() else {
+            out.push_str(&format!("<{} missing>", text));
+            continue;
+        };
+        if wide || b"eEfFgGaA".contains(&conv) {
+            out.push_str(&format!("<{} unsupported>", text));
+            continue;
+        }
+        let field = match conv {
+            b'c' => spec.pad((value as u8 as char).to_string(), ""),
+            b's' => {
+                let s = match strings.string_at(value) {
+                    Some(s) => String::from_utf8_lossy(s).into_owned(),
+                    None if value == 0 => "(null)".to_string(),
+                    None => format!("<str@0x{:08x}>", value),
+                };
+                let s = match spec.precision {
+                    Some(p) => s.chars().take(p).collect(),
+                    None => s,
+                };
+                spec.pad(s, "")
+            }
+            _ => spec.integer(conv, value),
+        };
+        out.push_str(&field);
+    }
+    out
+}
+
+// The prefix hal_trace_print_time() puts on a text line.
+fn line_prefix(record: &Record) -> String {
+    let level = LEVEL_CHARS[record.level()] as char;
+    let module = MODULE_NAMES
+        .get(record.module())
+        .map_or(format!("M{}", record.module()), |m| m.to_string());
+    let module: String = module.chars().take(6).collect();
+    let ctx = if record.attr & CTX_CP != 0 {
+        " CP".to_string()
+    } else if record.attr & CTX_ISR != 0 {
+        format!("{:2}E", record.ctx as i8)
+    } else {
+        format!("{:3}", record.ctx)
+    };
+    format!("{:9}/{}/{:<6}/{} | ", record.ms, level, module, ctx)
+}
+
+#[derive(Debug, Default, PartialEq)]
+struct Stats {
+    records: usize,
+    unknown: usize,
+}
+
+fn decode(buf: &[u8], strings: &StrTable, out: &mut Vec<u8>) -> Stats {
+    let mut stats = Stats::default();
+    let mut pos = 0;
+
+    while pos < buf.len() {
+        let Some(next) = buf[pos..].iter().position(|&b| b == SYNC) else {
+            out.extend_from_slice(&buf[pos..]);
+            break;
+        };
+        out.extend_from_slice(&buf[pos..pos + next]);
+        pos += next;
+
+        match parse_record(&buf[pos..]) {
+            Some((record, len)) => {
+                let text = match strings.format(record.offset) {
+                    Some(fmt) => format_args(fmt, &record.args, strings),
+                    None => {
+                        stats.unknown += 1;
+                        format!("<unknown format 0x{:06x}>", record.offset)
+                    }
+                };
+                if !record.no_ts {
+                    out.extend_from_slice(line_prefix(&record).as_bytes());
+                }
+                out.extend_from_slice(text.as_bytes());
+                if !record.no_lf {
+                    out.push(b'\n');
+                }
+                stats.records += 1;
+                pos += len;
+            }
+            None => {
+                out.push(buf[pos]);
+                pos += 1;
+            }
+        }
+    }
+    stats
+}
+
+fn read_file(path: &str) -> Vec<u8> {
+    let mut buf = Vec::new();
+    File::open(path)
+        .and_then(|mut f| f.read_to_end(&mut buf))
+        .unwrap_or_else(|e| panic!("could not read {}: {}", path, e));
+    buf
+}
+
+fn main() {
+    let args: Vec<String> = std::env::args().collect();
+    if args.len() < 3 {
+        eprintln!("usage: {} <image .str file> <trace capture>", args[0]);
+        std::process::exit(2);
+    }
+
+    let strings = StrTable::new(read_file(&args[1]));
+    let capture = read_file(&args[2]);
+    let mut out = Vec::new();
+    let stats = decode(&capture, &strings, &mut out);
+
+    let stdout = std::io::stdout();
+    let mut w = BufWriter::new(stdout.lock());
+    w.write_all(&out).expect("could not write output");
+    w.flush().expect("could not write output");
+    eprintln!(
+        "{} records, {} with a format not in {}",
+        stats.records, stats.unknown, args[1]
+    );
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // Two records as hal_trace_id_encode() writes them:
+    //   3 args, INFO, AUD, thread 7, 123456 ms, format 0x40,
+    //   args -5, 0xBEEF, 0x10
+    //   1 arg, ERROR, HAL, IRQ -3, 9 ms, format 0, arg 42
+    const GOLDEN_A: [u8; 24] = [
+        0xBE, 0xB6, 0xC3, 0x0A, 0x40, 0xE2, 0x01, 0x00, 0x40, 0x00, 0x00, 0x07, 0xFB, 0xFF, 0xFF,
+        0xFF, 0xEF, 0xBE, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00,
+    ];
+    const GOLDEN_B: [u8; 16] = [
+        0xBE, 0xA9, 0x91, 0x40, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFD, 0x2A, 0x00, 0x00,
+        0x00,
+    ];
+
+    // A line built from two records, as a task dump writes one:
+    //   2 args, INFO, RT_OS, thread 5, 777 ms, format 0x80, NO_LF and NO_TS,
+    //   args 3, 0x1234
+    //   no args, INFO, RT_OS, thread 5, 778 ms, format 0xA0, NO_TS
+    const GOLDEN_C: [u8; 20] = [
+        0xBE, 0xB4, 0x42, 0x05, 0x09, 0x03, 0x00, 0x00, 0x80, 0x00, 0xC0, 0x05, 0x03, 0x00, 0x00,
+        0x00, 0x34, 0x12, 0x00, 0x00,
+    ];
+    const GOLDEN_D: [u8; 12] = [
+        0xBE, 0x56, 0x40, 0x05, 0x0A, 0x03, 0x00, 0x00, 0xA0, 0x00, 0x80, 0x05,
+    ];
+
+    const RODATA_START: u32 = 0x3C08_0000;
+
+    // A .str file with __func__ "app_main" in .rodata_str and the formats
+    // at the given .trc_str offsets.
+    fn str_file(formats: &[(usize, &str)]) -> StrTable {
+        let mut data = vec![0u8; STR_TRC_OFFSET + 0x100];
+        data[..4].copy_from_slice(&RODATA_START.to_le_bytes());
+        data[STR_RODATA_OFFSET..STR_RODATA_OFFSET + 8].copy_from_slice(b"app_main");
+        for &(offset, fmt) in formats {
+            let at = STR_TRC_OFFSET + offset;
+            data[at..at + fmt.len()].copy_from_slice(fmt.as_bytes());
+        }
+        StrTable::new(data)
+    }
+
+    fn fmt(f: &str, args: &[u32]) -> String {
+        format_args(f.as_bytes(), args, &str_file(&[]))
+    }
+
+    #[test]
+    fn crc_matches_the_device() {
+        assert_eq!(crc8(b"123456789"), 0xF4);
+        assert_eq!(crc8(&GOLDEN_A[2..]), GOLDEN_A[1]);
+    }
+
+    #[test]
+    fn parses_golden_records() {
+        let (a, len) = parse_record(&GOLDEN_A).unwrap();
+        assert_eq!(len, GOLDEN_A.len());
+        assert_eq!(
+            a,
+            Record {
+                attr: 3 | 4 << 4 | 21 << 7,
+                ms: 123456,
+                offset: 0x40,
+                no_lf: false,
+                no_ts: false,
+                ctx: 7,
+                args: vec![-5i32 as u32, 0xBEEF, 0x10],
+            }
+        );
+        assert_eq!(line_prefix(&a), "   123456/I/AUD   /  7 | ");
+
+        let (b, _) = parse_record(&GOLDEN_B).unwrap();
+        assert_eq!(line_prefix(&b), "        9/E/HAL   /-3E | ");
+    }
+
+    #[test]
+    fn damaged_records_are_not_parsed() {
+        let mut bad = GOLDEN_A;
+        bad[13] ^= 0x10;
+        assert!(parse_record(&bad).is_none());
+        assert!(parse_record(&GOLDEN_A[..20]).is_none());
+    }
+
+    #[test]
+    fn formats_integers_like_printf() {
+        assert_eq!(
+            fmt("%d %i %u", &[-5i32 as u32, 7, -1i32 as u32]),
+            "-5 7 4294967295"
+        );
+        assert_eq!(
+            fmt("[%5d|%-5d|%05d]", &[42, 42, -42i32 as u32]),
+            "[   42|42   |-0042]"
+        );
+        assert_eq!(
+            fmt("%x %X %#x %08x", &[0xbeef, 0xbeef, 0x1f, 0xab]),
+            "beef BEEF 0x1f 000000ab"
+        );
+        assert_eq!(
+            fmt("%.3d %+d % d %o %#o", &[7, 7, 7, 8, 8]),
+            "007 +7  7 10 010"
+        );
+        assert_eq!(fmt("%lu %ld %hd %zu", &[1, -2i32 as u32, 3, 4]), "1 -2 3 4");
+        assert_eq!(
+            fmt("%p %c%c 100%%", &[0x2000_0000, b'o' as u32, b'k' as u32]),
+            "0x20000000 ok 100%"
+        );
+        assert_eq!(fmt("%*d|%-*d|", &[4, 1, 3, 2]), "   1|2  |");
+    }
+
+    #[test]
+    fn unsupported_and_missing_arguments_are_marked() {
+        assert_eq!(fmt("%lld %d", &[1, 2]), "<%lld unsupported> 2");
+        assert_eq!(fmt("%f", &[0]), "<%f unsupported>");
+        assert_eq!(fmt("%d %d", &[1]), "1 <%d missing>");
+        assert_eq!(fmt("50%", &[]), "50%");
+    }
+
+    #[test]
+    fn strings_resolve_from_rodata_str() {
+        let strings = str_file(&[]);
+        let f = |f: &str, a: &[u32]| format_args(f.as_bytes(), a, &strings);
+        assert_eq!(f("[%s]", &[RODATA_START]), "[app_main]");
+        assert_eq!(f("[%s]", &[RODATA_START + 4]), "[main]");
+        assert_eq!(
+            f("[%.3s|%6s]", &[RODATA_START, RODATA_START + 4]),
+            "[app|  main]"
+        );
+        assert_eq!(f("%s", &[0]), "(null)");
+        assert_eq!(f("%s", &[0x2000_1234]), "<str@0x20001234>");
+    }
+
+    #[test]
+    fn decodes_records_between_text() {
+        let strings = str_file(&[(0, "irq %d"), (0x40, "[%s] v=%d 0x%04x")]);
+        let mut buf = b"      1/I/HAL   /  0 | text line\n".to_vec();
+        let mut a = GOLDEN_A.to_vec();
+        a[12..16].copy_from_slice(&RODATA_START.to_le_bytes());
+        a[1] = crc8(&a[2..]);
+        buf.extend(&a);
+        buf.extend_from_slice(b"\xBE stray sync\n");
+        buf.extend(&GOLDEN_B);
+        // An id the .str file does not have: built from another image.
+        let mut c = GOLDEN_B.to_vec();
+        c[9] = 0x02;
+        c[1] = crc8(&c[2..]);
+        buf.extend(&c);
+
+        let mut out = Vec::new();
+        let stats = decode(&buf, &strings, &mut out);
+        assert_eq!(
+            stats,
+            Stats {
+                records: 3,
+                unknown: 1
+            }
+        );
+        assert_eq!(
+            String::from_utf8_lossy(&out),
+            "      1/I/HAL   /  0 | text line\n\
+             \x20  123456/I/AUD   /  7 | [app_main] v=48879 0x0010\n\
+             \u{FFFD} stray sync\n\
+             \x20       9/E/HAL   /-3E | irq 42\n\
+             \x20       9/E/HAL   /-3E | <unknown format 0x000200>\n"
+        );
+    }
+
+    #[test]
+    fn no_lf_and_no_ts_records_continue_the_line() {
+        let (c, len) = parse_record(&GOLDEN_C).unwrap();
+        assert_eq!(len, GOLDEN_C.len());
+        assert_eq!(
+            c,
+            Record {
+                attr: 2 | 4 << 4 | 10 << 7,
+                ms: 777,
+                offset: 0x80,
+                no_lf: true,
+                no_ts: true,
+                ctx: 5,
+                args: vec![3, 0x1234],
+            }
+        );
+        let (d, _) = parse_record(&GOLDEN_D).unwrap();
+        assert!(!d.no_lf && d.no_ts && d.offset == 0xA0);
+
+        let strings = str_file(&[(0, "irq %d"), (0x80, "%d:0x%04x "), (0xA0, "done")]);
+        let mut buf = GOLDEN_C.to_vec();
+        buf.extend(&GOLDEN_D);
+        buf.extend(&GOLDEN_B);
+        let mut out = Vec::new();
+        let stats = decode(&buf, &strings, &mut out);
+        assert_eq!(stats.records, 3);
+        assert_eq!(
+            String::from_utf8_lossy(&out),
+            "3:0x1234 done\n\
+             \x20       9/E/HAL   /-3E | irq 42\n"
+        );
+    }
+}
@@ -33,6 +33,7 @@
 #include "hal_memsc.h"
 #include "hal_sysfreq.h"
 #include "hal_timer.h"
+#include "hal_trace_id.h"
 #include "hal_uart.h"
 #include "stdarg.h"
 #include "stdio.h"
@@ -926,104 +927,58 @@ int hal_trace_output(const unsigned char *buf, unsigned int buf_len) {
   return ret ? 0 : buf_len;
 }
 #ifdef USE_TRACE_ID
-// define USE_CRC_CHECK
-//#define LITE_VERSION
-
-typedef struct {
-  uint32_t crc : 6;
-  uint32_t count : 4;
-  uint32_t tskid : 5;
-  uint32_t addr : 17; // 127 KB trace space support
-} trace_info_t;
-
-typedef struct {
-  uint32_t crc : 8;
-  uint32_t timestamp : 24; // 4 hours support
-} trace_head_t;
-
-typedef struct {
-#ifndef LITE_VERSION
-  trace_head_t trace_head;
-#endif
-  trace_info_t trace_info;
-} __attribute__((packed)) LOG_DATA_T;
-
-extern const char *unkonw_str;
-
-extern uint32_t __trc_str_start__[];
-extern uint32_t __trc_str_end__[];
-uint8_t crc8(uint8_t *data, uint32_t length) {
-  uint8_t i;
-  uint8_t crc = 0; // Initial value
-  while (length--) {
-    crc ^= *data++; // crc ^= *data; data++;
-    for (i = 0; i < 8; i++) {
-      if (crc & 0x80)
-        crc = (crc << 1) ^ 0x07;
-      else
-        crc <<= 1;
-    }
-  }
-  return crc;
-}
-
-uint8_t crc6(uint8_t *data, uint32_t length) {
-  uint8_t i;
-  uint8_t crc = 0; // Initial value
-  while (length--) {
-    crc ^= *data++; // crc ^= *data; data++;
-    for (i = 0; i < 8; ++i) {
-      if (crc & 1)
-        crc = (crc >> 1) ^ 0x30; // 0x30 = (reverse 0x03)>>(8-6)
-      else
-        crc = (crc >> 1);
-    }
-  }
-  return crc;
-}
-
-static int hal_trace_format_id(uint32_t attr, char *buf, uint32_t size,
-                               const char *fmt, va_list ap) {
+extern const char __trc_str_start__[];
+extern const char __trc_str_end__[];
+
+// Writes a record to |buf|, which holds one with TRACE_ID_MAX_ARGS. Returns
+// -1 for a log that has to go out as text: its format is not in .trc_str.
+// A format in .trc_str is never printed, as the image does not have the
+// section.
+static int hal_trace_format_id(uint32_t attr, char *buf, const char *fmt,
+                               va_list ap) {
   uint8_t num;
-  unsigned int value[10];
-  LOG_DATA_T trace;
+  uint8_t ctx;
+  uint32_t offset;
+  uint32_t value[TRACE_ID_MAX_ARGS];
 
-  if (size < sizeof(trace) + sizeof(value)) {
+  if (fmt < __trc_str_start__ || fmt >= __trc_str_end__) {
     return -1;
   }
+  offset = fmt - __trc_str_start__;
+  if (attr & LOG_ATTR_NO_LF) {
+    offset |= TRACE_ID_NO_LF;
+  }
+  if (attr & LOG_ATTR_NO_TS) {
+    offset |= TRACE_ID_NO_TS;
+  }
 
   num = GET_BITFIELD(attr, LOG_ATTR_ARG_NUM);
-  if (num > 10) {
-    num = 10;
+  if (num > TRACE_ID_MAX_ARGS) {
+    num = TRACE_ID_MAX_ARGS;
   }
   for (int i = 0; i < num; i++) {
     value[i] = va_arg(ap, unsigned long);
   }
 
-  // memset(buf, 0, size);
-
-  trace.trace_info.count = num;
-  trace.trace_info.addr =
-      (uint32_t)fmt -
-      (uint32_t)0xFFFC0000; //(uint32_t)fmt-(uint32_t)__trc_str_start__;
-  trace.trace_info.tskid = osGetThreadIntId();
-  trace.trace_info.crc = 0x2A;
-#ifndef LITE_VERSION
-  trace.trace_head.timestamp = TICKS_TO_MS(hal_sys_timer_get());
-#ifdef USE_CRC_CHECK
-  trace.trace_head.crc = crc8(((uint8_t *)&trace) + 1, 7);
-#else
-  trace.trace_head.crc = 0xBE;
+  attr = SET_BITFIELD(attr, LOG_ATTR_ARG_NUM, num) & TRACE_ID_ATTR_MASK;
+  ctx = 0;
+  if (0) {
+#ifdef CP_TRACE_ENABLE
+  } else if (get_cpu_id()) {
+    attr |= TRACE_ID_CTX_CP;
 #endif
-#else
-  trace.trace_info.crc = crc6(((uint8_t *)&trace) + 1, 3);
+  } else if (in_isr()) {
+    attr |= TRACE_ID_CTX_ISR;
+    ctx = (uint8_t)NVIC_GetCurrentActiveIRQ();
+  } else {
+#if defined(RTOS) && !defined(KERNEL_RTX5)
+    ctx = (uint8_t)osGetThreadIntId();
 #endif
-  memcpy(buf, &trace, sizeof(trace));
-  if (num != 0) {
-    memcpy(buf + sizeof(trace), value, 4 * num);
   }
 
-  return sizeof(trace) + 4 * num;
+  return hal_trace_id_encode((uint8_t *)buf, attr,
+                             TICKS_TO_MS(hal_sys_timer_get()), offset, ctx,
+                             value, num);
 }
 #endif
 
@@ -1135,6 +1090,8 @@ static int hal_trace_printf_internal(uint32_t attr, const char *fmt,
                                      va_list ap) {
 #ifdef USE_TRACE_ID
   char buf[60];
+  STATIC_ASSERT(sizeof(buf) >= TRACE_ID_HEADER_SIZE + 4 * TRACE_ID_MAX_ARGS,
+                "Trace buffer too small for a record");
 #else
   char buf[120];
 #endif
@@ -1159,8 +1116,7 @@ static int hal_trace_printf_internal(uint32_t attr, const char *fmt,
   }
 
 #ifdef USE_TRACE_ID
-  if ((attr & LOG_ATTR_NO_ID) ||
-      (len = hal_trace_format_id(attr, buf, sizeof(buf), fmt, ap)) < 0)
+  if ((len = hal_trace_format_id(attr, buf, fmt, ap)) < 0)
 #endif
   {
     len = 0;
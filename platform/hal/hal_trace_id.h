@@ -0,0 +1,92 @@
+#ifndef __HAL_TRACE_ID_H__
+#define __HAL_TRACE_ID_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Binary trace records, USE_TRACE_ID builds.
+//
+// TRC_STR() links the TRACE() format strings into .trc_str, which
+// TRACE_STR_SECTION leaves out of the image and writes to the .str file
+// beside it. Instead of formatting, a record carries the offset of the
+// string in that section and the arguments as raw words, so the device does
+// no vsnprintf() and the link carries a fraction of the bytes.
+// dev_tools/trace_id_decoder turns the records back into the usual lines;
+// anything else in the stream is passed through as text.
+//
+//   u8  TRACE_ID_SYNC                     (all fields little endian)
+//   u8  CRC-8 (poly 0x07) of the rest of the record
+//   u16 argument count, level and module as in LOG_ATTR_*, and the
+//       TRACE_ID_CTX_* flags
+//   u32 time in ms
+//   u32 format offset, bits 0-21; TRACE_ID_NO_LF and TRACE_ID_NO_TS,
+//       bits 22-23; context, bits 24-31: the thread id, or the IRQ number
+//       with TRACE_ID_CTX_ISR
+//   u32 arguments[count]
+//
+// .trc_str sits at 0xFFFC0000, so its offsets fit in 18 bits. A log with
+// LOG_ATTR_NO_LF or LOG_ATTR_NO_TS sets the matching flag and the decoder
+// leaves out the newline or the time stamp prefix.
+//
+// Every argument is one word, so 64-bit and floating-point arguments do not
+// survive, and a %s only decodes when it points at a string the host has in
+// the .str file, such as __func__. Logs that need them have to pass a format
+// from outside .trc_str, such as a buffer built at run time, which goes out
+// as text.
+
+#define TRACE_ID_SYNC 0xBE
+#define TRACE_ID_HEADER_SIZE 12
+#define TRACE_ID_MAX_ARGS 10
+#define TRACE_ID_MAX_OFFSET 0x3FFFFF
+#define TRACE_ID_NO_LF (1 << 22)
+#define TRACE_ID_NO_TS (1 << 23)
+#define TRACE_ID_ATTR_MASK 0x3FFF
+#define TRACE_ID_CTX_ISR (1 << 14)
+#define TRACE_ID_CTX_CP (1 << 15)
+
+static inline uint8_t hal_trace_id_crc8(const uint8_t *data, uint32_t len) {
+  static const uint8_t nibble[16] = {
+      0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+      0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+  };
+  uint8_t crc = 0;
+
+  while (len--) {
+    crc ^= *data++;
+    crc = (uint8_t)(crc << 4) ^ nibble[crc >> 4];
+    crc = (uint8_t)(crc << 4) ^ nibble[crc >> 4];
+  }
+  return crc;
+}
+
+// Writes one record to |buf|, which must hold TRACE_ID_HEADER_SIZE + 4 *
+// |num| bytes, and returns its length. |offset| may carry TRACE_ID_NO_LF
+// and TRACE_ID_NO_TS.
+static inline int hal_trace_id_encode(uint8_t *buf, uint16_t attr,
+                                      uint32_t ms, uint32_t offset,
+                                      uint8_t ctx, const uint32_t *args,
+                                      uint8_t num) {
+  uint32_t word;
+  int len = TRACE_ID_HEADER_SIZE + 4 * num;
+
+  buf[0] = TRACE_ID_SYNC;
+  buf[2] = (uint8_t)attr;
+  buf[3] = (uint8_t)(attr >> 8);
+  memcpy(&buf[4], &ms, 4);
+  word = (offset & (TRACE_ID_MAX_OFFSET | TRACE_ID_NO_LF | TRACE_ID_NO_TS)) |
+         ((uint32_t)ctx << 24);
+  memcpy(&buf[8], &word, 4);
+  memcpy(&buf[TRACE_ID_HEADER_SIZE], args, 4 * num);
+  buf[1] = hal_trace_id_crc8(&buf[2], len - 2);
+  return len;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HAL_TRACE_ID_H__
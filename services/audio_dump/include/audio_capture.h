@@ -0,0 +1,167 @@
+#ifndef __AUDIO_CAPTURE_H__
+#define __AUDIO_CAPTURE_H__
+
+#include "spsc_cqueue.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Framed binary capture of PCM at tap points in the audio chains.
+//
+// Up to AUDIO_CAPTURE_MAX_STREAMS streams each follow one tap, keep the
+// channels in their mask and one sample frame out of every |decimation|.
+// Decimation picks samples without filtering, so a decimated capture aliases;
+// it is for seeing levels and dropouts, not for listening.
+//
+// The audio thread only copies the picked samples into a per-stream staging
+// buffer and, once that is full, moves it into a ring as one frame. When the
+// ring has no room the frame is dropped, but it still takes its sequence
+// number, so the host sees exactly where data is missing. The CRC is added
+// by the drain on the consumer side, which sends whole frames and leaves a
+// frame in the ring when the transport refuses it.
+//
+// Wire format, little endian:
+//   u32 magic 'ACAP'   u8 version   u8 tap   u8 channels   u8 sample_bytes
+//   u32 seq            u32 sample_rate (after decimation)
+//   u16 frames         u16 channel_mask      u32 sample_index
+//   payload: frames * channels * sample_bytes, interleaved
+//   u32 CRC-32 (zlib) of header and payload
+// |seq| counts frames over all streams; |sample_index| counts the sample
+// frames of the stream up to the first one in the payload. 24-bit samples
+// are sent as 3 bytes.
+//
+// All taps must come from one thread and the drain from one other context.
+// audio_capture_configure() may be called from a third; the change is
+// picked up by the next tap call.
+
+#define AUDIO_CAPTURE_MAGIC 0x50414341
+#define AUDIO_CAPTURE_VERSION 1
+#define AUDIO_CAPTURE_HEADER_SIZE 24
+#define AUDIO_CAPTURE_CRC_SIZE 4
+#define AUDIO_CAPTURE_MAX_PAYLOAD 512
+#define AUDIO_CAPTURE_MAX_FRAME                                                \
+  (AUDIO_CAPTURE_HEADER_SIZE + AUDIO_CAPTURE_MAX_PAYLOAD +                     \
+   AUDIO_CAPTURE_CRC_SIZE)
+#define AUDIO_CAPTURE_MAX_STREAMS 4
+#define AUDIO_CAPTURE_MAX_CHANNELS 8
+
+enum AUDIO_CAPTURE_TAP_T {
+  // audio_process_run(): the input, and the output of each stage.
+  AUDIO_CAPTURE_TAP_AP_IN = 0,
+  AUDIO_CAPTURE_TAP_AP_BLOCK_GAIN,
+  AUDIO_CAPTURE_TAP_AP_SW_IIR,
+  AUDIO_CAPTURE_TAP_AP_HW_FIR,
+  AUDIO_CAPTURE_TAP_AP_DRC,
+  AUDIO_CAPTURE_TAP_AP_LIMITER,
+  AUDIO_CAPTURE_TAP_AP_HW_IIR,
+  AUDIO_CAPTURE_TAP_AP_OUT,
+  // SCO chain: microphones, echo reference and uplink; downlink in and out.
+  AUDIO_CAPTURE_TAP_SCO_TX_IN,
+  AUDIO_CAPTURE_TAP_SCO_TX_REF,
+  AUDIO_CAPTURE_TAP_SCO_TX_OUT,
+  AUDIO_CAPTURE_TAP_SCO_RX_IN,
+  AUDIO_CAPTURE_TAP_SCO_RX_OUT,
+
+  AUDIO_CAPTURE_TAP_QTY,
+  AUDIO_CAPTURE_TAP_NONE = 0xFF,
+};
+
+typedef struct {
+  uint8_t tap;
+  uint8_t decimation;
+  uint16_t channel_mask;
+} AUDIO_CAPTURE_CFG_T;
+
+typedef struct {
+  AUDIO_CAPTURE_CFG_T cfg;
+  // Format latched from the tap; a change starts a new frame.
+  uint8_t in_channels;
+  uint8_t sample_bytes;
+  uint8_t channels;
+  uint16_t channel_mask;
+  uint32_t sample_rate;
+  // Input frames to skip before the next one is kept.
+  uint32_t skip;
+  uint32_t sample_index;
+  uint16_t staged_frames;
+  uint16_t frame_bytes;
+  uint8_t frame[AUDIO_CAPTURE_HEADER_SIZE + AUDIO_CAPTURE_MAX_PAYLOAD];
+} AUDIO_CAPTURE_STREAM_T;
+
+typedef struct {
+  AUDIO_CAPTURE_STREAM_T streams[AUDIO_CAPTURE_MAX_STREAMS];
+  // Written by the configuring side; |cfg_gen| is bumped last.
+  AUDIO_CAPTURE_CFG_T cfg_req[AUDIO_CAPTURE_MAX_STREAMS];
+  uint32_t cfg_gen;
+  uint32_t cfg_applied;
+  // Which taps some stream follows, so a tap nobody wants costs one test.
+  uint32_t tap_mask;
+
+  SpscCQueue ring;
+  uint32_t seq;
+  uint32_t frames_queued;
+  uint32_t frames_dropped;
+
+  // Consumer side: the frame being sent, CRC appended.
+  uint8_t tx[AUDIO_CAPTURE_MAX_FRAME];
+  uint32_t tx_len;
+  uint32_t frames_sent;
+  uint32_t send_retries;
+} AUDIO_CAPTURE_T;
+
+// Returns |len| when it took the whole buffer and anything else when it took
+// none of it, like hal_trace_output().
+typedef int (*AUDIO_CAPTURE_SEND_T)(const unsigned char *buf,
+                                    unsigned int len);
+
+// |ring| must hold at least one AUDIO_CAPTURE_MAX_FRAME. All streams start
+// out off.
+int audio_capture_init(AUDIO_CAPTURE_T *cap, uint8_t *ring, uint32_t size);
+
+// |tap| AUDIO_CAPTURE_TAP_NONE turns the stream off. A |decimation| of 0 is
+// taken as 1. Returns -1 for a bad stream or tap.
+int audio_capture_configure(AUDIO_CAPTURE_T *cap, uint8_t stream, uint8_t tap,
+                            uint16_t channel_mask, uint8_t decimation);
+
+// Producer. |pcm| is interleaved, int16_t for 16 bits, right-aligned
+// int32_t for 24.
+void audio_capture_tap(AUDIO_CAPTURE_T *cap, uint8_t tap, const void *pcm,
+                       uint32_t frames, uint8_t channels, uint8_t bits,
+                       uint32_t sample_rate);
+// Queues what is staged now instead of waiting for a full frame.
+void audio_capture_flush(AUDIO_CAPTURE_T *cap);
+
+// Consumer. Sends whole frames until |budget| bytes have gone, the ring is
+// empty or |send| refuses one, and returns the bytes sent.
+uint32_t audio_capture_drain(AUDIO_CAPTURE_T *cap, AUDIO_CAPTURE_SEND_T send,
+                             uint32_t budget);
+
+// Wire bytes per second the stream will produce at the given input format.
+uint32_t audio_capture_byte_rate(const AUDIO_CAPTURE_CFG_T *cfg,
+                                 uint8_t channels, uint8_t bits,
+                                 uint32_t sample_rate);
+
+// Device side, AUDIO_CAPTURE=1 builds: one instance, drained over the trace
+// by a low-priority thread at no more than AUDIO_CAPTURE_BYTES_PER_SEC.
+#ifdef AUDIO_CAPTURE
+void audio_capture_open(void);
+int audio_capture_select(uint8_t stream, uint8_t tap, uint16_t channel_mask,
+                         uint8_t decimation);
+void audio_capture_point(uint8_t tap, const void *pcm, uint32_t frames,
+                         uint8_t channels, uint8_t bits, uint32_t sample_rate);
+void audio_capture_report(void);
+int audio_capture_cmd_callback(uint8_t *buf, uint32_t len);
+#define AUDIO_CAPTURE_POINT(tap, pcm, frames, channels, bits, rate)            \
+  audio_capture_point(tap, pcm, frames, channels, bits, rate)
+#else
+#define AUDIO_CAPTURE_POINT(tap, pcm, frames, channels, bits, rate)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUDIO_CAPTURE_H__
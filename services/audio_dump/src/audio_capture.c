@@ -0,0 +1,261 @@
+#include "audio_capture.h"
+#include "crc32.h"
+#include <string.h>
+
+#define CAP_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define CAP_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static inline void put_le16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t get_le16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+int audio_capture_init(AUDIO_CAPTURE_T *cap, uint8_t *ring, uint32_t size) {
+  memset(cap, 0, sizeof(*cap));
+  if (size < AUDIO_CAPTURE_MAX_FRAME)
+    return -1;
+  if (InitSpscCQueue(&cap->ring, size, ring) != CQ_OK)
+    return -1;
+  for (int i = 0; i < AUDIO_CAPTURE_MAX_STREAMS; i++) {
+    cap->streams[i].cfg.tap = AUDIO_CAPTURE_TAP_NONE;
+    cap->cfg_req[i].tap = AUDIO_CAPTURE_TAP_NONE;
+  }
+  return 0;
+}
+
+int audio_capture_configure(AUDIO_CAPTURE_T *cap, uint8_t stream, uint8_t tap,
+                            uint16_t channel_mask, uint8_t decimation) {
+  AUDIO_CAPTURE_CFG_T *req;
+
+  if (stream >= AUDIO_CAPTURE_MAX_STREAMS)
+    return -1;
+  if (tap >= AUDIO_CAPTURE_TAP_QTY && tap != AUDIO_CAPTURE_TAP_NONE)
+    return -1;
+
+  req = &cap->cfg_req[stream];
+  req->tap = tap;
+  req->channel_mask = channel_mask;
+  req->decimation = decimation ? decimation : 1;
+  CAP_STORE_RELEASE(&cap->cfg_gen, cap->cfg_gen + 1);
+  return 0;
+}
+
+static void capture_flush_stream(AUDIO_CAPTURE_T *cap,
+                                 AUDIO_CAPTURE_STREAM_T *s) {
+  uint8_t *h = s->frame;
+  uint32_t total;
+
+  if (s->staged_frames == 0)
+    return;
+
+  put_le32(&h[0], AUDIO_CAPTURE_MAGIC);
+  h[4] = AUDIO_CAPTURE_VERSION;
+  h[5] = s->cfg.tap;
+  h[6] = s->channels;
+  h[7] = s->sample_bytes;
+  put_le32(&h[8], cap->seq);
+  put_le32(&h[12], s->sample_rate);
+  put_le16(&h[16], s->staged_frames);
+  put_le16(&h[18], s->channel_mask);
+  put_le32(&h[20], s->sample_index);
+  total = AUDIO_CAPTURE_HEADER_SIZE + s->staged_frames * s->frame_bytes;
+
+  cap->seq++;
+  if (AvailableOfSpscCQueue(&cap->ring) >= total &&
+      EnSpscCQueue(&cap->ring, h, total) == CQ_OK)
+    cap->frames_queued++;
+  else
+    cap->frames_dropped++;
+
+  s->sample_index += s->staged_frames;
+  s->staged_frames = 0;
+}
+
+static void capture_apply_cfg(AUDIO_CAPTURE_T *cap, uint32_t gen) {
+  uint32_t tap_mask = 0;
+
+  for (int i = 0; i < AUDIO_CAPTURE_MAX_STREAMS; i++) {
+    AUDIO_CAPTURE_STREAM_T *s = &cap->streams[i];
+    AUDIO_CAPTURE_CFG_T req = cap->cfg_req[i];
+
+    if (memcmp(&req, &s->cfg, sizeof(req)) != 0) {
+      capture_flush_stream(cap, s);
+      s->cfg = req;
+      // Latch the format again at the next tap.
+      s->in_channels = 0;
+      s->sample_index = 0;
+      s->skip = 0;
+    }
+    if (s->cfg.tap != AUDIO_CAPTURE_TAP_NONE)
+      tap_mask |= 1u << s->cfg.tap;
+  }
+  cap->tap_mask = tap_mask;
+  cap->cfg_applied = gen;
+}
+
+static void capture_latch_format(AUDIO_CAPTURE_T *cap,
+                                 AUDIO_CAPTURE_STREAM_T *s, uint8_t channels,
+                                 uint8_t sample_bytes, uint32_t sample_rate) {
+  uint16_t present;
+
+  capture_flush_stream(cap, s);
+  present = (uint16_t)((1u << (channels < AUDIO_CAPTURE_MAX_CHANNELS
+                                   ? channels
+                                   : AUDIO_CAPTURE_MAX_CHANNELS)) -
+                       1);
+  s->in_channels = channels;
+  s->sample_bytes = sample_bytes;
+  s->channel_mask = s->cfg.channel_mask & present;
+  s->channels = (uint8_t)__builtin_popcount(s->channel_mask);
+  s->frame_bytes = (uint16_t)(s->channels * sample_bytes);
+  s->sample_rate = sample_rate / s->cfg.decimation;
+  s->sample_index = 0;
+  s->skip = 0;
+}
+
+static void capture_stream_run(AUDIO_CAPTURE_T *cap, AUDIO_CAPTURE_STREAM_T *s,
+                               const void *pcm, uint32_t frames,
+                               uint8_t channels, uint8_t bits,
+                               uint32_t sample_rate) {
+  const uint8_t sample_bytes = bits > 16 ? 3 : 2;
+  const uint32_t step = s->cfg.decimation;
+  uint32_t n;
+
+  if (s->in_channels != channels || s->sample_bytes != sample_bytes ||
+      s->sample_rate != sample_rate / step)
+    capture_latch_format(cap, s, channels, sample_bytes, sample_rate);
+  if (s->channels == 0)
+    return;
+
+  for (n = s->skip; n < frames; n += step) {
+    uint8_t *out = &s->frame[AUDIO_CAPTURE_HEADER_SIZE +
+                             s->staged_frames * s->frame_bytes];
+    uint32_t mask = s->channel_mask;
+
+    if (sample_bytes == 2) {
+      const int16_t *in = (const int16_t *)pcm + n * channels;
+      for (uint8_t ch = 0; mask; ch++, mask >>= 1) {
+        if (mask & 1) {
+          put_le16(out, (uint16_t)in[ch]);
+          out += 2;
+        }
+      }
+    } else {
+      const int32_t *in = (const int32_t *)pcm + n * channels;
+      for (uint8_t ch = 0; mask; ch++, mask >>= 1) {
+        if (mask & 1) {
+          out[0] = (uint8_t)in[ch];
+          out[1] = (uint8_t)(in[ch] >> 8);
+          out[2] = (uint8_t)(in[ch] >> 16);
+          out += 3;
+        }
+      }
+    }
+    s->staged_frames++;
+    if ((s->staged_frames + 1) * s->frame_bytes > AUDIO_CAPTURE_MAX_PAYLOAD)
+      capture_flush_stream(cap, s);
+  }
+  s->skip = n - frames;
+}
+
+void audio_capture_tap(AUDIO_CAPTURE_T *cap, uint8_t tap, const void *pcm,
+                       uint32_t frames, uint8_t channels, uint8_t bits,
+                       uint32_t sample_rate) {
+  uint32_t gen = CAP_LOAD_ACQUIRE(&cap->cfg_gen);
+
+  if (gen != cap->cfg_applied)
+    capture_apply_cfg(cap, gen);
+  if (tap >= AUDIO_CAPTURE_TAP_QTY || !(cap->tap_mask & (1u << tap)))
+    return;
+  if (channels == 0 || frames == 0)
+    return;
+
+  for (int i = 0; i < AUDIO_CAPTURE_MAX_STREAMS; i++) {
+    AUDIO_CAPTURE_STREAM_T *s = &cap->streams[i];
+
+    if (s->cfg.tap == tap)
+      capture_stream_run(cap, s, pcm, frames, channels, bits, sample_rate);
+  }
+}
+
+void audio_capture_flush(AUDIO_CAPTURE_T *cap) {
+  for (int i = 0; i < AUDIO_CAPTURE_MAX_STREAMS; i++)
+    capture_flush_stream(cap, &cap->streams[i]);
+}
+
+// Moves the next frame out of the ring into |tx| and appends its CRC.
+static bool capture_take_frame(AUDIO_CAPTURE_T *cap) {
+  uint8_t h[AUDIO_CAPTURE_HEADER_SIZE];
+  CQItemType *e1, *e2;
+  unsigned int len1, len2;
+  uint32_t total, crc;
+
+  if (PeekSpscCQueue(&cap->ring, sizeof(h), &e1, &len1, &e2, &len2) != CQ_OK)
+    return false;
+  memcpy(h, e1, len1);
+  if (len2)
+    memcpy(&h[len1], e2, len2);
+
+  total = AUDIO_CAPTURE_HEADER_SIZE +
+          (uint32_t)get_le16(&h[16]) * h[6] * h[7];
+  if (DeSpscCQueue(&cap->ring, cap->tx, total) != CQ_OK)
+    return false;
+  crc = (uint32_t)crc32(0, cap->tx, total);
+  put_le32(&cap->tx[total], crc);
+  cap->tx_len = total + AUDIO_CAPTURE_CRC_SIZE;
+  return true;
+}
+
+uint32_t audio_capture_drain(AUDIO_CAPTURE_T *cap, AUDIO_CAPTURE_SEND_T send,
+                             uint32_t budget) {
+  uint32_t sent = 0;
+
+  while (sent < budget) {
+    if (cap->tx_len == 0 && !capture_take_frame(cap))
+      break;
+    if (sent && sent + cap->tx_len > budget)
+      break;
+    if (send(cap->tx, cap->tx_len) != (int)cap->tx_len) {
+      cap->send_retries++;
+      break;
+    }
+    sent += cap->tx_len;
+    cap->tx_len = 0;
+    cap->frames_sent++;
+  }
+  return sent;
+}
+
+uint32_t audio_capture_byte_rate(const AUDIO_CAPTURE_CFG_T *cfg,
+                                 uint8_t channels, uint8_t bits,
+                                 uint32_t sample_rate) {
+  uint16_t present = (uint16_t)((1u << (channels < AUDIO_CAPTURE_MAX_CHANNELS
+                                            ? channels
+                                            : AUDIO_CAPTURE_MAX_CHANNELS)) -
+                                1);
+  uint32_t frame_bytes = (uint32_t)__builtin_popcount(cfg->channel_mask &
+                                                      present) *
+                         (bits > 16 ? 3 : 2);
+  uint32_t per_frame, rate;
+
+  if (cfg->tap == AUDIO_CAPTURE_TAP_NONE || frame_bytes == 0)
+    return 0;
+  per_frame = AUDIO_CAPTURE_MAX_PAYLOAD / frame_bytes;
+  rate = sample_rate / (cfg->decimation ? cfg->decimation : 1);
+  return rate * frame_bytes +
+         (uint32_t)(((uint64_t)rate *
+                         (AUDIO_CAPTURE_HEADER_SIZE + AUDIO_CAPTURE_CRC_SIZE) +
+                     per_frame - 1) /
+                    per_frame);
+}
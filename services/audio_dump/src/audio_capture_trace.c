@@ -0,0 +1,105 @@
+#ifdef AUDIO_CAPTURE
+
+#include "audio_capture.h"
+#include "cmsis_os.h"
+#include "hal_trace.h"
+
+#ifndef AUDIO_CAPTURE_RING_SIZE
+#define AUDIO_CAPTURE_RING_SIZE (8 * 1024)
+#endif
+
+// Stream 0 can be set up at build time; otherwise nothing is captured until
+// audio_capture_select() or the "audio_capture" PC command asks for it.
+#ifdef AUDIO_CAPTURE_DEFAULT_TAP
+#ifndef AUDIO_CAPTURE_DEFAULT_MASK
+#define AUDIO_CAPTURE_DEFAULT_MASK 0xFFFF
+#endif
+#ifndef AUDIO_CAPTURE_DEFAULT_DECIMATION
+#define AUDIO_CAPTURE_DEFAULT_DECIMATION 1
+#endif
+#endif
+
+// Half of a 921600 baud trace UART; the rest is left to the logs.
+#ifndef AUDIO_CAPTURE_BYTES_PER_SEC
+#define AUDIO_CAPTURE_BYTES_PER_SEC (921600 / 10 / 2)
+#endif
+
+#define AUDIO_CAPTURE_DRAIN_MS 10
+#define AUDIO_CAPTURE_DRAIN_BUDGET                                             \
+  (AUDIO_CAPTURE_BYTES_PER_SEC * AUDIO_CAPTURE_DRAIN_MS / 1000)
+
+static AUDIO_CAPTURE_T capture;
+static uint8_t capture_ring[AUDIO_CAPTURE_RING_SIZE];
+static osThreadId capture_tid;
+
+// Polled rather than woken by the taps: the audio thread makes no RTOS call,
+// and a fixed budget per tick holds the byte rate.
+static void audio_capture_thread(void const *argument) {
+  uint32_t ticks = 0, dropped = 0;
+
+  while (1) {
+    osDelay(AUDIO_CAPTURE_DRAIN_MS);
+    audio_capture_drain(&capture, hal_trace_output,
+                        AUDIO_CAPTURE_DRAIN_BUDGET);
+    // Once a second, say so if the streams ask for more than the budget.
+    if (++ticks * AUDIO_CAPTURE_DRAIN_MS >= 1000) {
+      ticks = 0;
+      if (capture.frames_dropped != dropped) {
+        dropped = capture.frames_dropped;
+        audio_capture_report();
+      }
+    }
+  }
+}
+
+osThreadDef(audio_capture_thread, osPriorityLow, 1, 1024, "audio_capture");
+
+void audio_capture_open(void) {
+  if (capture_tid)
+    return;
+
+  audio_capture_init(&capture, capture_ring, sizeof(capture_ring));
+  capture_tid = osThreadCreate(osThread(audio_capture_thread), NULL);
+  ASSERT(capture_tid, "[%s] failed to create thread", __func__);
+#ifdef AUDIO_CAPTURE_DEFAULT_TAP
+  audio_capture_configure(&capture, 0, AUDIO_CAPTURE_DEFAULT_TAP,
+                          AUDIO_CAPTURE_DEFAULT_MASK,
+                          AUDIO_CAPTURE_DEFAULT_DECIMATION);
+#endif
+}
+
+int audio_capture_select(uint8_t stream, uint8_t tap, uint16_t channel_mask,
+                         uint8_t decimation) {
+  if (!capture_tid)
+    audio_capture_open();
+  TRACE(5, "[%s] stream %d: tap %d mask 0x%x 1/%d", __func__, stream, tap,
+        channel_mask, decimation);
+  return audio_capture_configure(&capture, stream, tap, channel_mask,
+                                 decimation);
+}
+
+// PC command payload: stream, tap, channel mask (LE16), decimation.
+int audio_capture_cmd_callback(uint8_t *buf, uint32_t len) {
+  if (len != 5)
+    return 1;
+  return audio_capture_select(buf[0], buf[1], (uint16_t)(buf[2] | buf[3] << 8),
+                              buf[4])
+             ? 1
+             : 0;
+}
+
+void audio_capture_point(uint8_t tap, const void *pcm, uint32_t frames,
+                         uint8_t channels, uint8_t bits, uint32_t sample_rate) {
+  if (!capture_tid)
+    return;
+
+  audio_capture_tap(&capture, tap, pcm, frames, channels, bits, sample_rate);
+}
+
+void audio_capture_report(void) {
+  TRACE(5, "[%s] seq %u queued %u dropped %u sent %u retries %u", __func__,
+        capture.seq, capture.frames_queued, capture.frames_dropped,
+        capture.frames_sent, capture.send_retries);
+}
+
+#endif
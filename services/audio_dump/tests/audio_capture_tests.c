@@ -0,0 +1,351 @@
+#include "audio_capture.h"
+#include "crc32.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint8_t wire[1 << 20];
+static uint32_t wire_len;
+// Refuse every n-th call to send, like a full trace buffer.
+static uint32_t refuse_every;
+static uint32_t send_calls;
+// Room left in the trace buffer; the UART empties it between drains.
+static uint32_t trace_room = UINT32_MAX;
+
+// Keeps to hal_trace_output(): takes the whole buffer and returns its length,
+// or takes none of it and returns 0.
+static int wire_send(const unsigned char *buf, unsigned int len) {
+  send_calls++;
+  if (refuse_every && send_calls % refuse_every == 0)
+    return 0;
+  if (len > trace_room)
+    return 0;
+  trace_room -= len;
+  assert(wire_len + len <= sizeof(wire));
+  memcpy(&wire[wire_len], buf, len);
+  wire_len += len;
+  return (int)len;
+}
+
+static void wire_reset(void) {
+  wire_len = 0;
+  refuse_every = 0;
+  send_calls = 0;
+  trace_room = UINT32_MAX;
+}
+
+static uint32_t rd16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+static uint32_t rd32(const uint8_t *p) {
+  return (uint32_t)p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+typedef struct {
+  uint8_t tap, channels, sample_bytes;
+  uint32_t seq, sample_rate, sample_index;
+  uint16_t frames, channel_mask;
+  const uint8_t *payload;
+} FRAME_T;
+
+// Parses the frame at |*pos| and checks its magic and CRC.
+static int next_frame(uint32_t *pos, FRAME_T *f) {
+  const uint8_t *p = &wire[*pos];
+  uint32_t payload;
+
+  if (*pos == wire_len)
+    return 0;
+  assert(wire_len - *pos >= AUDIO_CAPTURE_HEADER_SIZE);
+  assert(rd32(p) == AUDIO_CAPTURE_MAGIC);
+  assert(p[4] == AUDIO_CAPTURE_VERSION);
+  f->tap = p[5];
+  f->channels = p[6];
+  f->sample_bytes = p[7];
+  f->seq = rd32(&p[8]);
+  f->sample_rate = rd32(&p[12]);
+  f->frames = (uint16_t)rd16(&p[16]);
+  f->channel_mask = (uint16_t)rd16(&p[18]);
+  f->sample_index = rd32(&p[20]);
+  f->payload = &p[AUDIO_CAPTURE_HEADER_SIZE];
+  payload = (uint32_t)f->frames * f->channels * f->sample_bytes;
+  assert(payload <= AUDIO_CAPTURE_MAX_PAYLOAD);
+  assert(rd32(&p[AUDIO_CAPTURE_HEADER_SIZE + payload]) ==
+         (uint32_t)crc32(0, p, AUDIO_CAPTURE_HEADER_SIZE + payload));
+  *pos += AUDIO_CAPTURE_HEADER_SIZE + payload + AUDIO_CAPTURE_CRC_SIZE;
+  return 1;
+}
+
+static void drain_all(AUDIO_CAPTURE_T *cap) {
+  while (audio_capture_drain(cap, wire_send, 4096))
+    ;
+}
+
+// Left and right ramps that never repeat within a test.
+static void make_stereo(int16_t *pcm, uint32_t first, uint32_t frames) {
+  for (uint32_t n = 0; n < frames; n++) {
+    pcm[2 * n] = (int16_t)(first + n);
+    pcm[2 * n + 1] = (int16_t)(-(int32_t)(first + n) * 3);
+  }
+}
+
+static void test_decimated_channel_round_trip(void) {
+  static AUDIO_CAPTURE_T cap;
+  static uint8_t ring[16 * 1024];
+  int16_t pcm[2 * 512];
+  uint32_t fed = 0, pos = 0, expect_index = 0, expect_seq = 0;
+  FRAME_T f;
+
+  assert(audio_capture_init(&cap, ring, sizeof(ring)) == 0);
+  assert(audio_capture_configure(&cap, 0, AUDIO_CAPTURE_TAP_AP_OUT, 0x2, 3) ==
+         0);
+  wire_reset();
+  srand(1);
+  while (fed < 30000) {
+    uint32_t len = 1 + rand() % 512;
+
+    make_stereo(pcm, fed, len);
+    // Other taps are ignored.
+    audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_AP_IN, pcm, len, 2, 16, 48000);
+    audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_AP_OUT, pcm, len, 2, 16, 48000);
+    fed += len;
+    drain_all(&cap);
+  }
+  audio_capture_flush(&cap);
+  drain_all(&cap);
+
+  while (next_frame(&pos, &f)) {
+    assert(f.tap == AUDIO_CAPTURE_TAP_AP_OUT);
+    assert(f.channels == 1 && f.channel_mask == 0x2 && f.sample_bytes == 2);
+    assert(f.sample_rate == 16000);
+    assert(f.seq == expect_seq++);
+    assert(f.sample_index == expect_index);
+    for (uint32_t i = 0; i < f.frames; i++) {
+      uint32_t src = 3 * (expect_index + i);
+      assert((int16_t)rd16(&f.payload[2 * i]) ==
+             (int16_t)(-(int32_t)src * 3));
+    }
+    expect_index += f.frames;
+  }
+  assert(expect_index == (fed + 2) / 3);
+  assert(cap.frames_dropped == 0 && cap.frames_sent == expect_seq);
+}
+
+static void test_24bit_and_several_streams(void) {
+  static AUDIO_CAPTURE_T cap;
+  static uint8_t ring[64 * 1024];
+  int32_t pcm[4 * 200];
+  uint32_t pos = 0, got[3] = {0, 0, 0};
+  FRAME_T f;
+
+  audio_capture_init(&cap, ring, sizeof(ring));
+  // Two streams on one tap with different channels, one on another tap.
+  audio_capture_configure(&cap, 0, AUDIO_CAPTURE_TAP_SCO_TX_IN, 0x5, 1);
+  audio_capture_configure(&cap, 1, AUDIO_CAPTURE_TAP_SCO_TX_IN, 0x8, 2);
+  // Channels beyond what the tap has are left out.
+  audio_capture_configure(&cap, 3, AUDIO_CAPTURE_TAP_SCO_RX_OUT, 0xFF, 1);
+  wire_reset();
+  for (uint32_t blk = 0; blk < 20; blk++) {
+    for (uint32_t n = 0; n < 200; n++) {
+      for (uint32_t ch = 0; ch < 4; ch++)
+        pcm[4 * n + ch] = (int32_t)((blk * 200 + n) * 16 + ch) - 0x400000;
+    }
+    audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_SCO_TX_IN, pcm, 200, 4, 24,
+                      16000);
+    audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_SCO_RX_OUT, pcm, 400, 2, 24,
+                      16000);
+    drain_all(&cap);
+  }
+  audio_capture_flush(&cap);
+  drain_all(&cap);
+
+  while (next_frame(&pos, &f)) {
+    assert(f.sample_bytes == 3);
+    for (uint32_t i = 0; i < f.frames; i++) {
+      for (uint32_t c = 0; c < f.channels; c++) {
+        const uint8_t *s = &f.payload[3 * (i * f.channels + c)];
+        int32_t v = (int32_t)((uint32_t)(s[0] | s[1] << 8 | s[2] << 16) << 8);
+        uint32_t idx = f.sample_index + i;
+        uint32_t k = 2 * (idx % 400) + c;
+
+        v >>= 8;
+        if (f.tap == AUDIO_CAPTURE_TAP_SCO_RX_OUT) {
+          assert(f.channels == 2 && f.channel_mask == 0x3);
+          assert(v == (int32_t)((idx / 400 * 200 + k / 4) * 16 + k % 4) -
+                          0x400000);
+        } else if (f.channel_mask == 0x5) {
+          assert(v == (int32_t)(idx * 16 + 2 * c) - 0x400000);
+        } else {
+          assert(f.channel_mask == 0x8 && f.sample_rate == 8000);
+          assert(v == (int32_t)(2 * idx * 16 + 3) - 0x400000);
+        }
+      }
+    }
+    if (f.tap == AUDIO_CAPTURE_TAP_SCO_RX_OUT)
+      got[2] += f.frames;
+    else
+      got[f.channel_mask == 0x5 ? 0 : 1] += f.frames;
+  }
+  assert(got[0] == 4000 && got[1] == 2000 && got[2] == 8000);
+}
+
+static void test_full_ring_drops_but_counts(void) {
+  static AUDIO_CAPTURE_T cap;
+  static uint8_t ring[3 * AUDIO_CAPTURE_MAX_FRAME];
+  int16_t pcm[2 * 4096];
+  uint32_t pos = 0, frames = 0, last_seq = 0, gaps = 0, last_index = 0;
+  FRAME_T f;
+
+  audio_capture_init(&cap, ring, sizeof(ring));
+  audio_capture_configure(&cap, 0, AUDIO_CAPTURE_TAP_AP_IN, 0x3, 1);
+  wire_reset();
+  make_stereo(pcm, 0, 4096);
+  // 16 frames' worth with room for 3: the rest go, but keep their numbers.
+  audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_AP_IN, pcm, 2048, 2, 16, 48000);
+  assert(cap.frames_queued == 3 && cap.frames_dropped == 13);
+  drain_all(&cap);
+  audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_AP_IN, pcm + 2 * 2048, 2048, 2, 16,
+                    48000);
+  drain_all(&cap);
+
+  while (next_frame(&pos, &f)) {
+    if (frames && f.seq != last_seq + 1) {
+      gaps += f.seq - last_seq - 1;
+      // The samples of the lost frames are accounted for.
+      assert(f.sample_index - last_index == (f.seq - last_seq) * 128);
+    }
+    last_seq = f.seq;
+    last_index = f.sample_index;
+    frames++;
+    assert(memcmp(f.payload, &pcm[2 * f.sample_index], 4u * f.frames) == 0);
+  }
+  assert(frames == cap.frames_queued);
+  // Lost at the end, so only the next frame would show them.
+  assert(gaps + (cap.seq - 1 - last_seq) == cap.frames_dropped);
+  assert(cap.seq == 32);
+}
+
+static void test_refused_send_loses_nothing(void) {
+  static AUDIO_CAPTURE_T cap;
+  static uint8_t ring[128 * 1024];
+  int16_t pcm[2 * 1000];
+  uint32_t pos = 0, seq = 0, sent;
+  FRAME_T f;
+
+  audio_capture_init(&cap, ring, sizeof(ring));
+  audio_capture_configure(&cap, 2, AUDIO_CAPTURE_TAP_AP_LIMITER, 0x3, 1);
+  wire_reset();
+  refuse_every = 3;
+  for (int i = 0; i < 20; i++) {
+    make_stereo(pcm, i * 1000, 1000);
+    audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_AP_LIMITER, pcm, 1000, 2, 16,
+                      44100);
+    // Whole frames only, never more than the budget but at least one.
+    sent = audio_capture_drain(&cap, wire_send, 1200);
+    assert(sent <= 1200);
+  }
+  audio_capture_flush(&cap);
+  drain_all(&cap);
+  assert(cap.send_retries > 0);
+
+  while (next_frame(&pos, &f))
+    assert(f.seq == seq++);
+  assert(seq == cap.frames_queued && cap.frames_dropped == 0);
+  assert(cap.frames_sent == seq);
+}
+
+// A frame the trace takes goes out once; one it has no room for waits for
+// the UART and goes out whole, once.
+static void test_trace_output_contract(void) {
+  static AUDIO_CAPTURE_T cap;
+  static uint8_t ring[128 * 1024];
+  int16_t pcm[2 * 1000];
+  uint32_t pos = 0, seq = 0, drains = 0;
+  FRAME_T f;
+
+  audio_capture_init(&cap, ring, sizeof(ring));
+  audio_capture_configure(&cap, 0, AUDIO_CAPTURE_TAP_AP_IN, 0x3, 1);
+  wire_reset();
+  for (int i = 0; i < 8; i++) {
+    make_stereo(pcm, i * 1000, 1000);
+    audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_AP_IN, pcm, 1000, 2, 16,
+                      48000);
+  }
+  audio_capture_flush(&cap);
+  assert(cap.frames_queued > 4);
+
+  // Room for about one and a half frames per tick.
+  while (cap.frames_sent < cap.frames_queued) {
+    trace_room = AUDIO_CAPTURE_MAX_FRAME * 3 / 2;
+    audio_capture_drain(&cap, wire_send, 1 << 16);
+    assert(++drains <= 2 * cap.frames_queued);
+  }
+  assert(cap.send_retries > 0 && cap.send_retries <= drains);
+  assert(send_calls == cap.frames_sent + cap.send_retries);
+  while (next_frame(&pos, &f))
+    assert(f.seq == seq++);
+  assert(seq == cap.frames_queued && pos == wire_len);
+}
+
+static void test_reconfigure_flushes(void) {
+  static AUDIO_CAPTURE_T cap;
+  static uint8_t ring[16 * 1024];
+  int16_t pcm[2 * 100];
+  uint32_t pos = 0;
+  FRAME_T f;
+
+  audio_capture_init(&cap, ring, sizeof(ring));
+  wire_reset();
+  make_stereo(pcm, 0, 100);
+  // Nothing is captured until a stream asks for it.
+  audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_AP_IN, pcm, 100, 2, 16, 48000);
+  assert(cap.seq == 0);
+
+  audio_capture_configure(&cap, 0, AUDIO_CAPTURE_TAP_AP_IN, 0x1, 1);
+  audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_AP_IN, pcm, 100, 2, 16, 48000);
+  // A new rate starts a new frame.
+  audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_AP_IN, pcm, 100, 2, 16, 44100);
+  assert(cap.seq == 1);
+  // Turning the stream off sends what is staged.
+  audio_capture_configure(&cap, 0, AUDIO_CAPTURE_TAP_NONE, 0, 0);
+  audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_SCO_RX_IN, pcm, 100, 1, 16, 16000);
+  assert(cap.seq == 2);
+  drain_all(&cap);
+
+  assert(next_frame(&pos, &f) && f.sample_rate == 48000 && f.frames == 100);
+  assert(next_frame(&pos, &f) && f.sample_rate == 44100 && f.frames == 100);
+  assert(f.sample_index == 0);
+  assert(!next_frame(&pos, &f));
+
+  assert(audio_capture_configure(&cap, AUDIO_CAPTURE_MAX_STREAMS, 0, 1, 1) ==
+         -1);
+  assert(audio_capture_configure(&cap, 0, AUDIO_CAPTURE_TAP_QTY, 1, 1) == -1);
+}
+
+static void test_byte_rate_matches_wire(void) {
+  static AUDIO_CAPTURE_T cap;
+  static uint8_t ring[256 * 1024];
+  static int16_t pcm[2 * 48000];
+  AUDIO_CAPTURE_CFG_T cfg = {AUDIO_CAPTURE_TAP_AP_OUT, 2, 0x3};
+  uint32_t rate = audio_capture_byte_rate(&cfg, 2, 16, 48000);
+
+  audio_capture_init(&cap, ring, sizeof(ring));
+  audio_capture_configure(&cap, 0, cfg.tap, cfg.channel_mask, cfg.decimation);
+  wire_reset();
+  audio_capture_tap(&cap, AUDIO_CAPTURE_TAP_AP_OUT, pcm, 48000, 2, 16, 48000);
+  drain_all(&cap);
+  assert(wire_len <= rate && wire_len + AUDIO_CAPTURE_MAX_FRAME > rate);
+  printf("  48 kHz stereo 16-bit at 1/2: %u bytes/s on the wire\n", rate);
+}
+
+int main(void) {
+  test_decimated_channel_round_trip();
+  test_24bit_and_several_streams();
+  test_full_ring_drops_but_counts();
+  test_refused_send_loses_nothing();
+  test_trace_output_contract();
+  test_reconfigure_flushes();
+  test_byte_rate_matches_wire();
+  printf("audio_capture_tests: all passed\n");
+  return 0;
+}
@@ -52,6 +52,7 @@ Audio Flow:
 #include "audio_process.h"
 #include "audio_cfg.h"
 #include "audiogram.h"
+#include "biquad_cascade.h"
 #include "drc.h"
 #include "dsp_chain.h"
 #include "hal_cmu.h"
@@ -307,47 +308,114 @@ static const char *DSP_CHAIN_ORDER[] = {"calibration_eq", "audiogram_eq",
                                         "limiter"};
 static DspChainState g_dsp_chain;
 
-static void audio_process_apply_block_gain(uint8_t *buf, uint32_t samples,
-                                           enum AUD_BITS_T bits,
-                                           float linear_gain) {
-  if (!buf || samples == 0)
-    return;
+#ifdef AUDIO_PROCESS_STAGE_PROFILE
+#define AUDIO_PROCESS_STAGE_START() dsp_chain_stage_start(&g_dsp_chain)
+#define AUDIO_PROCESS_STAGE_MARK(stage, samples)                               \
+  dsp_chain_stage_mark(&g_dsp_chain, stage, samples)
+#else
+#define AUDIO_PROCESS_STAGE_START()
+#define AUDIO_PROCESS_STAGE_MARK(stage, samples)
+#endif
 
-  if (fabsf(linear_gain - 1.0f) < 0.0001f)
-    return;
+#ifdef AUDIO_CAPTURE
+#include "audio_capture.h"
+#define AUDIO_PROCESS_TAP(tap, ch_num, samples)                                \
+  audio_capture_point(AUDIO_CAPTURE_TAP_##tap, buf, (samples) / (ch_num),      \
+                      (uint8_t)(ch_num),                                       \
+                      audio_process.sample_bits == AUD_BITS_16 ? 16 : 24,      \
+                      audio_process.sample_rate)
+#else
+#define AUDIO_PROCESS_TAP(tap, ch_num, samples)
+#endif
 
-  uint32_t clipped = 0;
-
-  if (bits == AUD_BITS_16) {
-    int16_t *pcm = (int16_t *)buf;
-    for (uint32_t i = 0; i < samples; ++i) {
-      int32_t v = (int32_t)((float)pcm[i] * linear_gain);
-      if (v > INT16_MAX) {
-        v = INT16_MAX;
-        clipped++;
-      } else if (v < INT16_MIN) {
-        v = INT16_MIN;
-        clipped++;
-      }
-      pcm[i] = (int16_t)v;
-    }
-  } else if (bits == AUD_BITS_24) {
-    int32_t *pcm = (int32_t *)buf;
-    const int32_t max24 = 0x7FFFFF;
-    const int32_t min24 = -0x800000;
-    for (uint32_t i = 0; i < samples; ++i) {
-      int64_t v = (int64_t)((float)pcm[i] * linear_gain);
-      if (v > max24) {
-        v = max24;
-        clipped++;
-      } else if (v < min24) {
-        v = min24;
-        clipped++;
-      }
-      pcm[i] = (int32_t)v;
-    }
+#if defined(__SW_IIR_EQ_PROCESS__)
+#ifdef AUDIO_SW_IIR_IN_TREE
+#ifndef AUDIO_SW_IIR_FORM
+#define AUDIO_SW_IIR_FORM BIQUAD_FORM_DF1_Q31
+#endif
+
+#ifndef AUDIO_SW_IIR_XFADE_FRAMES
+#define AUDIO_SW_IIR_XFADE_FRAMES 0
+#endif
+
+// In-tree replacement for the prebuilt iir_open/iir_set_cfg/iir_run library.
+// Configuration calls build into the bank from the control thread; sw_iir_run()
+// picks up the newest set at the next frame boundary, so the EQ never has to
+// be disabled while its coefficients change.
+static BiquadCascade audio_sw_iir;
+static BiquadCoefBank audio_sw_iir_bank;
+static uint32_t audio_sw_iir_fade_frames = AUDIO_SW_IIR_XFADE_FRAMES;
+
+static int sw_iir_open(enum AUD_SAMPRATE_T sample_rate,
+                       enum AUD_BITS_T sample_bits,
+                       enum AUD_CHANNEL_NUM_T ch_num) {
+  biquad_bank_init(&audio_sw_iir_bank, AUDIO_SW_IIR_FORM);
+  return biquad_cascade_open(&audio_sw_iir, AUDIO_SW_IIR_FORM, sample_rate,
+                             sample_bits, ch_num);
+}
+
+static int sw_iir_build(const IIR_CFG_T *cfg, uint8_t ch) {
+  int ret = biquad_cascade_build(biquad_bank_edit(&audio_sw_iir_bank),
+                                 AUDIO_SW_IIR_FORM, audio_sw_iir.sample_rate,
+                                 cfg, ch);
+  if (ret)
+    biquad_bank_discard(&audio_sw_iir_bank);
+  return ret;
+}
+
+static int sw_iir_set_cfg_pair(const IIR_CFG_T *left, const IIR_CFG_T *right) {
+  int ret = sw_iir_build(left, 0);
+  if (ret == 0)
+    ret = sw_iir_build(right, 1);
+  if (ret == 0)
+    biquad_bank_publish(&audio_sw_iir_bank);
+  return ret;
+}
+
+static int sw_iir_set_cfg(const IIR_CFG_T *cfg) {
+  return sw_iir_set_cfg_pair(cfg, cfg);
+}
+
+static int sw_iir_run(uint8_t *buf, uint32_t len) {
+  // A crossfade in progress finishes before the next set is taken.
+  if (!biquad_cascade_fading(&audio_sw_iir)) {
+    const BiquadCascadeCoefs *coefs;
+
+    biquad_cascade_detach(&audio_sw_iir);
+    coefs = biquad_bank_acquire(&audio_sw_iir_bank);
+    if (coefs)
+      biquad_cascade_swap(&audio_sw_iir, coefs, audio_sw_iir_fade_frames);
   }
+  biquad_cascade_run(&audio_sw_iir, buf, len);
+  return 0;
+}
 
+static int sw_iir_close(void) {
+  biquad_cascade_reset(&audio_sw_iir);
+  return 0;
+}
+#else
+#define sw_iir_open iir_open
+#define sw_iir_set_cfg iir_set_cfg
+#define sw_iir_run iir_run
+#define sw_iir_close iir_close
+
+static int sw_iir_set_cfg_pair(const IIR_CFG_T *left, const IIR_CFG_T *right) {
+  iir_set_cfg_ch(left, AUD_CHANNEL_NUM_1);
+  return iir_set_cfg_ch(right, AUD_CHANNEL_NUM_2);
+}
+#endif
+#endif
+
+static void audio_process_apply_block_gain(uint8_t *buf, uint32_t samples,
+                                           enum AUD_BITS_T bits,
+                                           uint8_t channels,
+                                           const DspChainGainBlock *gain) {
+  if (!buf || samples == 0 || channels == 0 || gain->unity)
+    return;
+
+  uint32_t clipped = dsp_chain_apply_gain_fixed(gain, buf, samples / channels,
+                                                channels, (uint8_t)bits);
   if (clipped > 0) {
     dsp_chain_mark_clipping(&g_dsp_chain, clipped);
   }
@@ -361,14 +429,17 @@ int audio_eq_set_cfg(const FIR_CFG_T *fir_cfg, const IIR_CFG_T *iir_cfg,
 #if defined(__SW_IIR_EQ_PROCESS__)
   case AUDIO_EQ_TYPE_SW_IIR: {
     if (iir_cfg) {
+#ifndef AUDIO_SW_IIR_IN_TREE
+      // The prebuilt library is not safe against a concurrent iir_run().
       audio_process.sw_iir_enable = false;
+#endif
 #ifdef USB_EQ_TUNING
       if (audio_process.eq_updated_cfg) {
-        iir_set_cfg(&audio_process.sw_iir_cfg);
+        sw_iir_set_cfg(&audio_process.sw_iir_cfg);
       } else
 #endif
       {
-        iir_set_cfg(iir_cfg);
+        sw_iir_set_cfg(iir_cfg);
       }
       audio_process.sw_iir_enable = true;
     } else {
@@ -467,18 +538,21 @@ int SRAM_TEXT_LOC audio_process_run(uint8_t *buf, uint32_t len) {
     ASSERT(0, "[%s] bits(%d) is invalid", __func__, audio_process.sample_bits);
   }
 
+  AUDIO_PROCESS_STAGE_START();
+  AUDIO_PROCESS_TAP(AP_IN, audio_process.hw_ch_num, pcm_len);
+
   if (audio_process.sw_ch_num == audio_process.hw_ch_num) {
     // do nothing
   } else if (audio_process.sw_ch_num == AUD_CHANNEL_NUM_1 &&
              audio_process.hw_ch_num == AUD_CHANNEL_NUM_2) {
     if (audio_process.sample_bits == AUD_BITS_16) {
       int16_t *pcm_buf = (int16_t *)buf;
-      for (uint32_t i = 0, j = 0; i < pcm_len; i += 2, j++) {
+      for (int32_t i = 0, j = 0; i < pcm_len; i += 2, j++) {
         pcm_buf[j] = pcm_buf[i];
       }
     } else {
       int32_t *pcm_buf = (int32_t *)buf;
-      for (uint32_t i = 0, j = 0; i < pcm_len; i += 2, j++) {
+      for (int32_t i = 0, j = 0; i < pcm_len; i += 2, j++) {
         pcm_buf[j] = pcm_buf[i];
       }
     }
@@ -488,10 +562,17 @@ int SRAM_TEXT_LOC audio_process_run(uint8_t *buf, uint32_t len) {
     ASSERT(0, "[%s] sw_ch_num(%d) or hw_ch_num(%d) is invalid", __FUNCTION__,
            audio_process.sw_ch_num, audio_process.hw_ch_num);
   }
+  AUDIO_PROCESS_STAGE_MARK(DSP_CHAIN_STAGE_REMIX_IN, pcm_len);
 
-  float block_gain = dsp_chain_begin_frame(&g_dsp_chain, pcm_len);
+  DspChainGainBlock block_gain;
+  dsp_chain_begin_frame_fixed(&g_dsp_chain,
+                              pcm_len / (uint8_t)audio_process.sw_ch_num,
+                              &block_gain);
   audio_process_apply_block_gain(buf, pcm_len, audio_process.sample_bits,
-                                 block_gain);
+                                 (uint8_t)audio_process.sw_ch_num,
+                                 &block_gain);
+  AUDIO_PROCESS_STAGE_MARK(DSP_CHAIN_STAGE_BLOCK_GAIN, pcm_len);
+  AUDIO_PROCESS_TAP(AP_BLOCK_GAIN, audio_process.sw_ch_num, pcm_len);
 
 #ifdef AUDIO_PROCESS_DUMP
   int *buf32 = (int *)buf;
@@ -507,13 +588,17 @@ int SRAM_TEXT_LOC audio_process_run(uint8_t *buf, uint32_t len) {
 
 #ifdef __SW_IIR_EQ_PROCESS__
   if (audio_process.sw_iir_enable) {
-    iir_run(buf, pcm_len);
+    sw_iir_run(buf, pcm_len);
+    AUDIO_PROCESS_STAGE_MARK(DSP_CHAIN_STAGE_SW_IIR, pcm_len);
+    AUDIO_PROCESS_TAP(AP_SW_IIR, audio_process.sw_ch_num, pcm_len);
   }
 #endif
 
 #ifdef __HW_FIR_EQ_PROCESS__
   if (audio_process.hw_fir_enable) {
     fir_run(buf, pcm_len);
+    AUDIO_PROCESS_STAGE_MARK(DSP_CHAIN_STAGE_HW_FIR, pcm_len);
+    AUDIO_PROCESS_TAP(AP_HW_FIR, audio_process.sw_ch_num, pcm_len);
   }
 #endif
 
@@ -526,6 +611,8 @@ int SRAM_TEXT_LOC audio_process_run(uint8_t *buf, uint32_t len) {
 #endif
 
   drc_process(audio_process.drc_st, buf, pcm_len);
+  AUDIO_PROCESS_STAGE_MARK(DSP_CHAIN_STAGE_DRC, pcm_len);
+  AUDIO_PROCESS_TAP(AP_DRC, audio_process.sw_ch_num, pcm_len);
 #endif
 
   // int32_t m_time = hal_fast_sys_timer_get();
@@ -540,11 +627,15 @@ int SRAM_TEXT_LOC audio_process_run(uint8_t *buf, uint32_t len) {
 
   limiter_process(audio_process.drc2_st, buf, pcm_len);
   dsp_chain_mark_limiter(&g_dsp_chain);
+  AUDIO_PROCESS_STAGE_MARK(DSP_CHAIN_STAGE_LIMITER, pcm_len);
+  AUDIO_PROCESS_TAP(AP_LIMITER, audio_process.sw_ch_num, pcm_len);
 #endif
 
 #ifdef __HW_IIR_EQ_PROCESS__
   if (audio_process.hw_iir_enable) {
     hw_iir_run(buf, pcm_len);
+    AUDIO_PROCESS_STAGE_MARK(DSP_CHAIN_STAGE_HW_IIR, pcm_len);
+    AUDIO_PROCESS_TAP(AP_HW_IIR, audio_process.sw_ch_num, pcm_len);
   }
 #endif
 
@@ -571,6 +662,8 @@ int SRAM_TEXT_LOC audio_process_run(uint8_t *buf, uint32_t len) {
     ASSERT(0, "[%s] sw_ch_num(%d) or hw_ch_num(%d) is invalid", __FUNCTION__,
            audio_process.sw_ch_num, audio_process.hw_ch_num);
   }
+  AUDIO_PROCESS_STAGE_MARK(DSP_CHAIN_STAGE_REMIX_OUT, pcm_len);
+  AUDIO_PROCESS_TAP(AP_OUT, audio_process.hw_ch_num, pcm_len);
 
 #ifdef AUDIO_PROCESS_DUMP
   // for(int i=0;i<1024;i++)
@@ -622,7 +715,7 @@ int audio_process_open(enum AUD_SAMPRATE_T sample_rate,
 #endif
 
 #ifdef __SW_IIR_EQ_PROCESS__
-  iir_open(sample_rate, sample_bits, sw_ch_num);
+  sw_iir_open(sample_rate, sample_bits, sw_ch_num);
 #ifdef AUDIO_EQ_SW_IIR_UPDATE_CFG
   audio_eq_set_cfg(NULL, &audio_process.sw_iir_cfg, AUDIO_EQ_TYPE_SW_IIR);
 #endif
@@ -713,7 +806,7 @@ int audio_process_open(enum AUD_SAMPRATE_T sample_rate,
 int audio_process_close(void) {
 #ifdef __SW_IIR_EQ_PROCESS__
   audio_process.sw_iir_enable = false;
-  iir_close();
+  sw_iir_close();
 #endif
 
 #ifdef __HW_DAC_IIR_EQ_PROCESS__
@@ -796,7 +889,7 @@ int audio_eq_sw_iir_callback(uint8_t *buf, uint32_t len) {
 
 #ifdef __SW_IIR_EQ_PROCESS__
   {
-    iir_set_cfg(&audio_process.sw_iir_cfg);
+    sw_iir_set_cfg(&audio_process.sw_iir_cfg);
     audio_process.sw_iir_enable = true;
   }
 #endif
@@ -1136,7 +1229,7 @@ void audio_eq_usb_eq_update(void) {
 #endif
 
 #if defined(AUDIO_EQ_SW_IIR_UPDATE_CFG)
-    iir_set_cfg(&audio_process.sw_iir_cfg);
+    sw_iir_set_cfg(&audio_process.sw_iir_cfg);
     audio_process.sw_iir_enable = true;
 #endif
 
@@ -1166,6 +1259,7 @@ extern int getSampleArray(uint8_t *buf, uint16_t *num);
 extern void hal_cmd_set_res_playload(uint8_t *data, int len);
 #define CMD_TYPE_QUERY_DUT_EQ_INFO 0x00
 int audio_cmd_callback(uint8_t *buf, uint32_t len) {
+  (void)len;
   uint8_t type;
   // uint32_t* sample_rate;
   // uint8_t* p;
@@ -1219,9 +1313,16 @@ int audio_process_init(void) {
       sizeof(DSP_CHAIN_ORDER) / sizeof(DSP_CHAIN_ORDER[0]), 3.0f);
   ASSERT(limiter_last, "[%s] limiter must be final stage", __func__);
   config_protocol_init();
+#ifdef AUDIO_CAPTURE
+  audio_capture_open();
+#endif
 #ifdef __PC_CMD_UART__
   hal_cmd_init();
 
+#ifdef AUDIO_CAPTURE
+  hal_cmd_register("audio_capture", audio_capture_cmd_callback);
+#endif
+
 #ifdef AUDIO_EQ_SW_IIR_UPDATE_CFG
   hal_cmd_register("iir_eq", audio_eq_sw_iir_callback); // Will be removed
   hal_cmd_register("sw_iir_eq", audio_eq_sw_iir_callback);
@@ -1308,6 +1409,12 @@ int audio_process_init(void) {
   return 0;
 }
 
+#if defined(__SW_IIR_EQ_PROCESS__)
+// Per-ear fits, so single-point edits during a fitting session only redo the
+// bins they touch.
+static AudiogramFitCache audio_audiogram_fit[2];
+#endif
+
 int audio_process_apply_audiogram(const AudiogramProfile *profile) {
 #if !defined(__SW_IIR_EQ_PROCESS__)
   (void)profile;
@@ -1316,16 +1423,17 @@ int audio_process_apply_audiogram(const AudiogramProfile *profile) {
   IIR_CFG_T left_cfg = {0};
   IIR_CFG_T right_cfg = {0};
 
-  int ret = audiogram_build_iir_cfg(profile, true, &left_cfg);
+  int ret = audiogram_build_iir_cfg_cached(&audio_audiogram_fit[0], profile,
+                                           true, &left_cfg);
   if (ret)
     return ret;
-  ret = audiogram_build_iir_cfg(profile, false, &right_cfg);
+  ret = audiogram_build_iir_cfg_cached(&audio_audiogram_fit[1], profile, false,
+                                       &right_cfg);
   if (ret)
     return ret;
 
 #ifdef AUDIO_EQ_SW_IIR_UPDATE_CFG
   memcpy(&audio_process.sw_iir_cfg, &left_cfg, sizeof(IIR_CFG_T));
-  audio_process.sw_iir_enable = true;
 #ifdef AUDIO_UPDATE_CFG
   audio_process.update_cfg = true;
 #endif
@@ -1333,16 +1441,24 @@ int audio_process_apply_audiogram(const AudiogramProfile *profile) {
 
   // Apply per-ear curves; fall back to mono if stereo channels are not active.
   if (audio_process.sw_ch_num >= AUD_CHANNEL_NUM_2) {
-    iir_set_cfg_ch(&left_cfg, AUD_CHANNEL_NUM_1);
-    iir_set_cfg_ch(&right_cfg, AUD_CHANNEL_NUM_2);
+    sw_iir_set_cfg_pair(&left_cfg, &right_cfg);
   } else {
-    iir_set_cfg(&left_cfg);
+    sw_iir_set_cfg(&left_cfg);
   }
+  audio_process.sw_iir_enable = true;
 
   return 0;
 #endif
 }
 
+void audio_process_set_eq_crossfade(uint32_t frames) {
+#if defined(__SW_IIR_EQ_PROCESS__) && defined(AUDIO_SW_IIR_IN_TREE)
+  audio_sw_iir_fade_frames = frames;
+#else
+  (void)frames;
+#endif
+}
+
 void audio_process_request_ramp(float target_gain_db, uint32_t frame_count) {
   dsp_chain_request_ramp(&g_dsp_chain, target_gain_db, frame_count);
 }
@@ -1354,3 +1470,17 @@ void audio_process_force_panic_off(void) {
 void audio_process_get_telemetry(DspChainCounters *out) {
   dsp_chain_get_counters(&g_dsp_chain, out);
 }
+
+void audio_process_mark_gain_reduction(uint32_t gr_frames,
+                                       uint32_t max_gr_q31) {
+  dsp_chain_mark_gain_reduction(&g_dsp_chain, gr_frames, max_gr_q31);
+}
+
+void audio_process_get_stage_stats(DspChainStageId stage,
+                                   DspChainStageStats *out) {
+  dsp_chain_get_stage_stats(&g_dsp_chain, stage, out);
+}
+
+void audio_process_reset_stage_stats(void) {
+  dsp_chain_reset_stage_stats(&g_dsp_chain);
+}
@@ -45,10 +45,24 @@ int audio_eq_set_cfg(const FIR_CFG_T *fir_cfg,const IIR_CFG_T *iir_cfg,AUDIO_EQ_
 // interpolation and smoothing. Returns 0 on success.
 int audio_process_apply_audiogram(const AudiogramProfile *profile);
 
+// Crossfade length, in frames, between the old and new software EQ outputs
+// when a new configuration is picked up. 0 switches at the frame boundary.
+// Only used by the in-tree EQ (SW_IIR_EQ_IN_TREE).
+void audio_process_set_eq_crossfade(uint32_t frames);
+
 // Ramping + telemetry helpers for the DSP chain.
 void audio_process_request_ramp(float target_gain_db, uint32_t frame_count);
 void audio_process_force_panic_off(void);
 void audio_process_get_telemetry(DspChainCounters *out);
+// Gain reduction applied by a peak limiter run outside audio_process_run().
+void audio_process_mark_gain_reduction(uint32_t gr_frames,
+                                       uint32_t max_gr_q31);
+
+// Per-stage timing of audio_process_run(). Only populated when built with
+// AUDIO_PROCESS_STAGE_PROFILE.
+void audio_process_get_stage_stats(DspChainStageId stage,
+                                   DspChainStageStats *out);
+void audio_process_reset_stage_stats(void);
 
 #ifdef USB_EQ_TUNING
 void audio_eq_usb_eq_update (void);
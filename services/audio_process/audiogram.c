@@ -1,12 +1,8 @@
 #include "audiogram.h"
-#include <math.h>
+#include "crc32.h"
 #include <stdio.h>
 #include <string.h>
 
-#ifndef M_LN10
-#define M_LN10 2.302585092994046
-#endif
-
 #define MIN_POINTS_PER_EAR 2
 #define AUDIOGRAM_MAX_DB_HL 120
 #define AUDIOGRAM_MIN_DB_HL -20
@@ -15,6 +11,49 @@
 #define AUDIOGRAM_HALF_GAIN 0.5f
 #define SMOOTHING_WINDOW 3
 #define SMOOTHING_PASSES 2
+#define FIT_Q 1.2f
+
+// log2(1 + k / 128), k = 0..128: mantissa table for log2_lookup().
+#define LOG2_TABLE_BITS 7
+static const float log2_mantissa[(1 << LOG2_TABLE_BITS) + 1] = {
+    0.00000000f, 0.01122726f, 0.02236781f, 0.03342300f, 0.04439412f,
+    0.05528244f, 0.06608919f, 0.07681560f, 0.08746284f, 0.09803208f,
+    0.10852446f, 0.11894107f, 0.12928302f, 0.13955135f, 0.14974712f,
+    0.15987134f, 0.16992500f, 0.17990909f, 0.18982456f, 0.19967234f,
+    0.20945337f, 0.21916852f, 0.22881869f, 0.23840474f, 0.24792751f,
+    0.25738784f, 0.26678654f, 0.27612441f, 0.28540222f, 0.29462075f,
+    0.30378075f, 0.31288296f, 0.32192809f, 0.33091688f, 0.33985000f,
+    0.34872815f, 0.35755200f, 0.36632221f, 0.37503943f, 0.38370429f,
+    0.39231742f, 0.40087944f, 0.40939094f, 0.41785251f, 0.42626475f,
+    0.43462823f, 0.44294350f, 0.45121111f, 0.45943162f, 0.46760555f,
+    0.47573343f, 0.48381578f, 0.49185310f, 0.49984589f, 0.50779464f,
+    0.51569984f, 0.52356196f, 0.53138146f, 0.53915881f, 0.54689446f,
+    0.55458885f, 0.56224242f, 0.56985561f, 0.57742883f, 0.58496250f,
+    0.59245704f, 0.59991284f, 0.60733031f, 0.61470984f, 0.62205182f,
+    0.62935662f, 0.63662462f, 0.64385619f, 0.65105169f, 0.65821148f,
+    0.66533592f, 0.67242534f, 0.67948010f, 0.68650053f, 0.69348696f,
+    0.70043972f, 0.70735913f, 0.71424552f, 0.72109919f, 0.72792045f,
+    0.73470962f, 0.74146699f, 0.74819285f, 0.75488750f, 0.76155123f,
+    0.76818432f, 0.77478706f, 0.78135971f, 0.78790256f, 0.79441587f,
+    0.80089990f, 0.80735492f, 0.81378119f, 0.82017896f, 0.82654849f,
+    0.83289001f, 0.83920379f, 0.84549005f, 0.85174904f, 0.85798100f,
+    0.86418614f, 0.87036472f, 0.87651695f, 0.88264305f, 0.88874325f,
+    0.89481776f, 0.90086681f, 0.90689060f, 0.91288934f, 0.91886324f,
+    0.92481250f, 0.93073734f, 0.93663794f, 0.94251451f, 0.94836723f,
+    0.95419631f, 0.96000193f, 0.96578428f, 0.97154355f, 0.97727992f,
+    0.98299357f, 0.98868469f, 0.99435344f, 1.00000000f,
+};
+
+// Peak filter centres used by audiogram_build_iir_cfg() and their log2.
+#define FIT_GRID_BINS 12
+static const AudiogramGrid fit_grid = {
+    .count = FIT_GRID_BINS,
+    .freqs = {125.f, 250.f, 500.f, 750.f, 1000.f, 1500.f, 2000.f, 3000.f,
+              4000.f, 6000.f, 8000.f, 10000.f},
+    .log2_hz = {6.96578428f, 7.96578428f, 8.96578428f, 9.55074679f,
+                9.96578428f, 10.55074679f, 10.96578428f, 11.55074679f,
+                11.96578428f, 12.55074679f, 12.96578428f, 13.28771238f},
+};
 
 static float clampf(float v, float lo, float hi) {
   if (v < lo)
@@ -24,13 +63,23 @@ static float clampf(float v, float lo, float hi) {
   return v;
 }
 
-static float log10f_safe(float v) {
-  if (v <= 0.0f) {
-    return 0.0f;
-  }
-  return logf(v) / (float)M_LN10;
+// log2 of a positive frequency from the exponent bits and a linearly
+// interpolated mantissa table; no branches and no libm. Absolute error is
+// below 1.2e-5 (0.0001 octave).
+static float log2_lookup(float hz) {
+  uint32_t bits;
+  memcpy(&bits, &hz, sizeof(bits));
+  const int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127;
+  const uint32_t frac = bits & 0x7FFFFF;
+  const uint32_t idx = frac >> (23 - LOG2_TABLE_BITS);
+  const float t = (float)(frac & ((1u << (23 - LOG2_TABLE_BITS)) - 1)) *
+                  (1.0f / (float)(1u << (23 - LOG2_TABLE_BITS)));
+  const float m0 = log2_mantissa[idx];
+  return (float)exponent + m0 + (log2_mantissa[idx + 1] - m0) * t;
 }
 
+float audiogram_log2_hz(float hz) { return hz > 0.0f ? log2_lookup(hz) : 0.0f; }
+
 bool audiogram_validate_ear(const AudiogramEarProfile *ear, char *reason,
                             size_t reason_size) {
   uint8_t freq_count = 0;
@@ -91,6 +140,11 @@ bool audiogram_validate_ear(const AudiogramEarProfile *ear, char *reason,
   return true;
 }
 
+static bool schema_supported(uint8_t version) {
+  return version == 0 || (version >= AUDIOGRAM_MIN_SCHEMA_VERSION &&
+                          version <= AUDIOGRAM_SCHEMA_VERSION);
+}
+
 bool audiogram_validate_profile(const AudiogramProfile *profile, char *reason,
                                 size_t reason_size) {
   if (!profile) {
@@ -98,9 +152,7 @@ bool audiogram_validate_profile(const AudiogramProfile *profile, char *reason,
       snprintf(reason, reason_size, "%s", "profile is NULL");
     return false;
   }
-  if (profile->schema_version != 0 &&
-      (profile->schema_version < AUDIOGRAM_MIN_SCHEMA_VERSION ||
-       profile->schema_version > AUDIOGRAM_SCHEMA_VERSION)) {
+  if (!schema_supported(profile->schema_version)) {
     if (reason && reason_size)
       snprintf(reason, reason_size, "%s", "unsupported schema version");
     return false;
@@ -156,58 +208,108 @@ static void smooth_gain(float *gains, size_t count) {
   memcpy(gains, stage, count * sizeof(float));
 }
 
-int audiogram_interpolate_gain(const AudiogramEarProfile *ear,
-                               const float *target_freqs, size_t target_count,
-                               float *out_gain_db) {
-  uint8_t point_count = 0;
+static uint8_t ear_point_count(const AudiogramEarProfile *ear) {
+  return ear->threshold_count ? ear->threshold_count : ear->point_count;
+}
+
+// Gain at one target bin from the per-point log2 frequencies and gains. The
+// segment is found with a branch-free binary search; clamping the ratio to
+// [0, 1] holds the edge gains outside the measured range.
+static float interpolate_bin(const float *ear_log, const float *ear_gain,
+                             uint8_t point_count, float tlog) {
+  uint32_t base = 0;
+  uint32_t n = point_count - 1u;
+
+  while (n > 1) {
+    const uint32_t half = n / 2;
+    base = ear_log[base + half] <= tlog ? base + half : base;
+    n -= half;
+  }
+  const float log0 = ear_log[base];
+  const float span = ear_log[base + 1] - log0;
+  const float ratio =
+      clampf((tlog - log0) / (span > 0.0f ? span : 1.0f), 0.0f, 1.0f);
+  return ear_gain[base] + (ear_gain[base + 1] - ear_gain[base]) * ratio;
+}
+
+static void prepare_points(const AudiogramEarProfile *ear, uint8_t count,
+                           float *ear_log, float *ear_gain) {
+  for (uint8_t i = 0; i < count; ++i) {
+    ear_log[i] = log2_lookup((float)ear->frequencies_hz[i]);
+    ear_gain[i] = map_threshold_to_gain(ear->thresholds_db_hl[i]);
+  }
+}
+
+int audiogram_grid_register(AudiogramGrid *grid, const float *freqs,
+                            size_t count) {
+  if (!grid || !freqs || count == 0)
+    return -1;
+  if (count > AUDIOGRAM_MAX_TARGET_BINS)
+    return -3;
+  for (size_t i = 0; i < count; ++i) {
+    if (!(freqs[i] > 0.0f))
+      return -2;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    grid->freqs[i] = freqs[i];
+    grid->log2_hz[i] = log2_lookup(freqs[i]);
+  }
+  grid->count = (uint8_t)count;
+  return 0;
+}
+
+const AudiogramGrid *audiogram_fit_grid(void) { return &fit_grid; }
+
+int audiogram_interpolate_grid(const AudiogramEarProfile *ear,
+                               const AudiogramGrid *grid, float *out_gain_db) {
   float ear_log[AUDIOGRAM_MAX_POINTS_PER_EAR];
   float ear_gain[AUDIOGRAM_MAX_POINTS_PER_EAR];
 
-  if (!ear || !target_freqs || !out_gain_db || target_count == 0)
+  if (!ear || !grid || !out_gain_db || grid->count == 0)
     return -1;
-  if (target_count > AUDIOGRAM_MAX_TARGET_BINS)
+  if (grid->count > AUDIOGRAM_MAX_TARGET_BINS)
     return -3;
   if (!audiogram_validate_ear(ear, NULL, 0))
     return -2;
 
-  point_count = ear->threshold_count ? ear->threshold_count : ear->point_count;
+  const uint8_t point_count = ear_point_count(ear);
+  prepare_points(ear, point_count, ear_log, ear_gain);
+  for (size_t i = 0; i < grid->count; ++i)
+    out_gain_db[i] =
+        interpolate_bin(ear_log, ear_gain, point_count, grid->log2_hz[i]);
 
-  for (uint8_t i = 0; i < point_count; ++i) {
-    ear_log[i] = log10f_safe((float)ear->frequencies_hz[i]);
-    ear_gain[i] = map_threshold_to_gain(ear->thresholds_db_hl[i]);
-  }
+  smooth_gain(out_gain_db, grid->count);
+  return (int)grid->count;
+}
 
-  for (size_t i = 0; i < target_count; ++i) {
-    float tfreq = target_freqs[i];
-    float tlog = log10f_safe(tfreq);
-    float lower_gain = ear_gain[0];
-    float upper_gain = ear_gain[point_count - 1];
+int audiogram_interpolate_gain(const AudiogramEarProfile *ear,
+                               const float *target_freqs, size_t target_count,
+                               float *out_gain_db) {
+  AudiogramGrid grid;
 
-    if (tfreq <= ear->frequencies_hz[0]) {
-      out_gain_db[i] = lower_gain;
-      continue;
-    }
-    if (tfreq >= ear->frequencies_hz[point_count - 1]) {
-      out_gain_db[i] = upper_gain;
-      continue;
-    }
+  if (!ear || !target_freqs || !out_gain_db || target_count == 0)
+    return -1;
+  if (target_count > AUDIOGRAM_MAX_TARGET_BINS)
+    return -3;
+  if (audiogram_grid_register(&grid, target_freqs, target_count))
+    return -1;
+  return audiogram_interpolate_grid(ear, &grid, out_gain_db);
+}
 
-    for (uint8_t j = 1; j < point_count; ++j) {
-      float log0 = ear_log[j - 1];
-      float log1 = ear_log[j];
-      if (tlog >= log0 && tlog <= log1) {
-        float g0 = ear_gain[j - 1];
-        float g1 = ear_gain[j];
-        float denom = (log1 - log0) > 0.0f ? (log1 - log0) : 1.0f;
-        float ratio = (tlog - log0) / denom;
-        out_gain_db[i] = g0 + (g1 - g0) * ratio;
-        break;
-      }
-    }
-  }
+static void fill_fit_cfg(const float *gains, IIR_CFG_T *out_cfg) {
+  memset(out_cfg, 0, sizeof(*out_cfg));
+  out_cfg->gain0 = 0.0f;
+  out_cfg->gain1 = 0.0f;
+  out_cfg->num = (int)FIT_GRID_BINS;
+  if (out_cfg->num > IIR_PARAM_NUM)
+    out_cfg->num = IIR_PARAM_NUM;
 
-  smooth_gain(out_gain_db, target_count);
-  return (int)target_count;
+  for (int i = 0; i < out_cfg->num; ++i) {
+    out_cfg->param[i].type = IIR_TYPE_PEAK;
+    out_cfg->param[i].gain = gains[i];
+    out_cfg->param[i].fc = fit_grid.freqs[i];
+    out_cfg->param[i].Q = FIT_Q;
+  }
 }
 
 int audiogram_build_iir_cfg(const AudiogramProfile *profile, bool left_ear,
@@ -217,32 +319,110 @@ int audiogram_build_iir_cfg(const AudiogramProfile *profile, bool left_ear,
   if (!audiogram_validate_profile(profile, NULL, 0))
     return -2;
 
-  static const float target_grid[] = {125.f,  250.f,  500.f,  750.f,  1000.f,
-                                      1500.f, 2000.f, 3000.f, 4000.f, 6000.f,
-                                      8000.f, 10000.f};
-  const size_t target_count = sizeof(target_grid) / sizeof(target_grid[0]);
-  float gains[target_count];
+  float gains[FIT_GRID_BINS];
 
-  if (target_count > AUDIOGRAM_MAX_TARGET_BINS)
-    return -3;
   const AudiogramEarProfile *ear = left_ear ? &profile->left : &profile->right;
-  int written =
-      audiogram_interpolate_gain(ear, target_grid, target_count, gains);
+  int written = audiogram_interpolate_grid(ear, &fit_grid, gains);
   if (written < 0)
     return written;
 
-  memset(out_cfg, 0, sizeof(*out_cfg));
-  out_cfg->gain0 = 0.0f;
-  out_cfg->gain1 = 0.0f;
-  out_cfg->num = (int)target_count;
-  if (out_cfg->num > IIR_PARAM_NUM)
-    out_cfg->num = IIR_PARAM_NUM;
+  fill_fit_cfg(gains, out_cfg);
+  return 0;
+}
 
-  for (int i = 0; i < out_cfg->num; ++i) {
-    out_cfg->param[i].type = IIR_TYPE_PEAK;
-    out_cfg->param[i].gain = gains[i];
-    out_cfg->param[i].fc = target_grid[i];
-    out_cfg->param[i].Q = 1.2f;
+// CRC over the meaningful part of an ear profile; unused trailing points do
+// not change the key.
+static uint32_t ear_crc(const AudiogramEarProfile *ear, uint8_t count) {
+  uint32_t crc = crc32(0, &count, 1);
+  crc = crc32(crc, (const unsigned char *)ear->frequencies_hz,
+              count * sizeof(ear->frequencies_hz[0]));
+  return crc32(crc, (const unsigned char *)ear->thresholds_db_hl,
+               count * sizeof(ear->thresholds_db_hl[0]));
+}
+
+static bool same_frequencies(const AudiogramEarProfile *a,
+                             const AudiogramEarProfile *b, uint8_t count) {
+  return ear_point_count(a) == count &&
+         memcmp(a->frequencies_hz, b->frequencies_hz,
+                count * sizeof(a->frequencies_hz[0])) == 0;
+}
+
+static void cache_full_fit(AudiogramFitCache *cache,
+                           const AudiogramEarProfile *ear, uint8_t count) {
+  prepare_points(ear, count, cache->point_log, cache->point_gain);
+  for (size_t i = 0; i < FIT_GRID_BINS; ++i) {
+    cache->raw_db[i] = interpolate_bin(cache->point_log, cache->point_gain,
+                                       count, fit_grid.log2_hz[i]);
+  }
+  cache->full_fits++;
+}
+
+// Only thresholds changed: a point feeds the bins between its neighbours, so
+// re-interpolate just those.
+static void cache_partial_fit(AudiogramFitCache *cache,
+                              const AudiogramEarProfile *ear, uint8_t count) {
+  for (uint8_t j = 0; j < count; ++j) {
+    if (ear->thresholds_db_hl[j] == cache->ear.thresholds_db_hl[j])
+      continue;
+    cache->point_gain[j] = map_threshold_to_gain(ear->thresholds_db_hl[j]);
+
+    const float lo = j > 0 ? (float)ear->frequencies_hz[j - 1] : 0.0f;
+    const float hi = j + 1 < count ? (float)ear->frequencies_hz[j + 1]
+                                   : (float)AUDIOGRAM_MAX_FREQ_HZ * 2.0f;
+    for (size_t i = 0; i < FIT_GRID_BINS; ++i) {
+      if (fit_grid.freqs[i] < lo || fit_grid.freqs[i] > hi)
+        continue;
+      cache->raw_db[i] = interpolate_bin(cache->point_log, cache->point_gain,
+                                         count, fit_grid.log2_hz[i]);
+    }
+  }
+  cache->partial_fits++;
+}
+
+int audiogram_build_iir_cfg_cached(AudiogramFitCache *cache,
+                                   const AudiogramProfile *profile,
+                                   bool left_ear, IIR_CFG_T *out_cfg) {
+  if (!cache || !profile || !out_cfg)
+    return -1;
+
+  const AudiogramEarProfile *ear = left_ear ? &profile->left : &profile->right;
+  const uint8_t count = ear_point_count(ear);
+  if (count > AUDIOGRAM_MAX_POINTS_PER_EAR)
+    return -2;
+  const uint32_t crc = ear_crc(ear, count);
+
+  if (cache->valid && crc == cache->crc &&
+      same_frequencies(&cache->ear, ear, count) &&
+      memcmp(cache->ear.thresholds_db_hl, ear->thresholds_db_hl,
+             count * sizeof(ear->thresholds_db_hl[0])) == 0 &&
+      schema_supported(profile->schema_version)) {
+    cache->hits++;
+    memcpy(out_cfg, &cache->cfg, sizeof(*out_cfg));
+    return 0;
+  }
+
+  if (!schema_supported(profile->schema_version) ||
+      !audiogram_validate_ear(ear, NULL, 0))
+    return -2;
+
+  if (cache->valid && same_frequencies(&cache->ear, ear, count)) {
+    cache_partial_fit(cache, ear, count);
+  } else {
+    cache_full_fit(cache, ear, count);
   }
+
+  memcpy(cache->gain_db, cache->raw_db, FIT_GRID_BINS * sizeof(float));
+  smooth_gain(cache->gain_db, FIT_GRID_BINS);
+  fill_fit_cfg(cache->gain_db, &cache->cfg);
+
+  memcpy(&cache->ear, ear, sizeof(cache->ear));
+  cache->crc = crc;
+  cache->valid = true;
+  memcpy(out_cfg, &cache->cfg, sizeof(*out_cfg));
   return 0;
 }
+
+void audiogram_fit_cache_reset(AudiogramFitCache *cache) {
+  if (cache)
+    memset(cache, 0, sizeof(*cache));
+}
@@ -36,6 +36,32 @@ typedef struct {
   AudiogramEarProfile right;
 } AudiogramProfile;
 
+// Target frequencies with their log2 values computed once, so per-call
+// interpolation only does table lookups and multiply-adds.
+typedef struct {
+  uint8_t count;
+  float freqs[AUDIOGRAM_MAX_TARGET_BINS];
+  float log2_hz[AUDIOGRAM_MAX_TARGET_BINS];
+} AudiogramGrid;
+
+// Fitting state for one ear, reused across audiogram_build_iir_cfg_cached()
+// calls. Keyed on a CRC of the ear's points; when only thresholds change,
+// just the target bins next to the edited points are re-interpolated.
+typedef struct {
+  bool valid;
+  uint32_t crc;
+  AudiogramEarProfile ear;
+  float point_log[AUDIOGRAM_MAX_POINTS_PER_EAR];
+  float point_gain[AUDIOGRAM_MAX_POINTS_PER_EAR];
+  // Interpolated grid before and after smoothing.
+  float raw_db[AUDIOGRAM_MAX_TARGET_BINS];
+  float gain_db[AUDIOGRAM_MAX_TARGET_BINS];
+  IIR_CFG_T cfg;
+  uint32_t hits;
+  uint32_t partial_fits;
+  uint32_t full_fits;
+} AudiogramFitCache;
+
 // Validation helpers
 bool audiogram_validate_ear(const AudiogramEarProfile *ear, char *reason,
                             size_t reason_size);
@@ -50,12 +76,34 @@ int audiogram_interpolate_gain(const AudiogramEarProfile *ear,
                                const float *target_freqs, size_t target_count,
                                float *out_gain_db);
 
+// Register `count` target frequencies (Hz, > 0) into `grid`. Returns 0 on
+// success.
+int audiogram_grid_register(AudiogramGrid *grid, const float *freqs,
+                            size_t count);
+// The peak filter grid used by audiogram_build_iir_cfg(); built at compile
+// time.
+const AudiogramGrid *audiogram_fit_grid(void);
+// audiogram_interpolate_gain() onto a registered grid. Writes grid->count
+// bins; returns that count or negative on error.
+int audiogram_interpolate_grid(const AudiogramEarProfile *ear,
+                               const AudiogramGrid *grid, float *out_gain_db);
+// Table-based log2 used for the grid and audiogram points (|error| < 1.2e-5).
+float audiogram_log2_hz(float hz);
+
 // Fit a validated audiogram profile into an EQ configuration for one ear. The
 // returned configuration uses peak filters centered on an internal target grid
 // with smoothed gains capped for safety.
 int audiogram_build_iir_cfg(const AudiogramProfile *profile, bool left_ear,
                             IIR_CFG_T *out_cfg);
 
+// Same result as audiogram_build_iir_cfg() for the selected ear, served from
+// or updated in `cache`. Returns 0 on success; the cache is left untouched on
+// error.
+int audiogram_build_iir_cfg_cached(AudiogramFitCache *cache,
+                                   const AudiogramProfile *profile,
+                                   bool left_ear, IIR_CFG_T *out_cfg);
+void audiogram_fit_cache_reset(AudiogramFitCache *cache);
+
 #ifdef __cplusplus
 }
 #endif
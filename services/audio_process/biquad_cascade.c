@@ -0,0 +1,473 @@
+#include "biquad_cascade.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Samples are de-interleaved into a scratch block and every section runs over
+// the whole block with its state held in locals.
+#define BIQUAD_CASCADE_BLOCK 64
+
+int biquad_cascade_design(const IIR_PARAM_T *param, float gain_db,
+                          uint32_t sample_rate, BiquadCoefs *out) {
+  if (!param || !out || sample_rate == 0)
+    return -1;
+  if (param->fc <= 0.0f || param->fc >= 0.5f * (float)sample_rate)
+    return -2;
+
+  const double A = pow(10.0, (double)param->gain / 40.0);
+  const double w0 = 2.0 * M_PI * (double)param->fc / (double)sample_rate;
+  const double cw = cos(w0);
+  const double Q = param->Q > 0.0f ? (double)param->Q : 0.707106781186548;
+  const double alpha = sin(w0) / (2.0 * Q);
+  const double sqA2alpha = 2.0 * sqrt(A) * alpha;
+  double b0, b1, b2, a0, a1, a2;
+
+  switch (param->type) {
+  case IIR_TYPE_LOW_SHELF:
+    b0 = A * ((A + 1) - (A - 1) * cw + sqA2alpha);
+    b1 = 2 * A * ((A - 1) - (A + 1) * cw);
+    b2 = A * ((A + 1) - (A - 1) * cw - sqA2alpha);
+    a0 = (A + 1) + (A - 1) * cw + sqA2alpha;
+    a1 = -2 * ((A - 1) + (A + 1) * cw);
+    a2 = (A + 1) + (A - 1) * cw - sqA2alpha;
+    break;
+  case IIR_TYPE_PEAK:
+    b0 = 1 + alpha * A;
+    b1 = -2 * cw;
+    b2 = 1 - alpha * A;
+    a0 = 1 + alpha / A;
+    a1 = -2 * cw;
+    a2 = 1 - alpha / A;
+    break;
+  case IIR_TYPE_HIGH_SHELF:
+    b0 = A * ((A + 1) + (A - 1) * cw + sqA2alpha);
+    b1 = -2 * A * ((A - 1) + (A + 1) * cw);
+    b2 = A * ((A + 1) + (A - 1) * cw - sqA2alpha);
+    a0 = (A + 1) - (A - 1) * cw + sqA2alpha;
+    a1 = 2 * ((A - 1) - (A + 1) * cw);
+    a2 = (A + 1) - (A - 1) * cw - sqA2alpha;
+    break;
+  case IIR_TYPE_LOW_PASS:
+    b0 = (1 - cw) / 2;
+    b1 = 1 - cw;
+    b2 = (1 - cw) / 2;
+    a0 = 1 + alpha;
+    a1 = -2 * cw;
+    a2 = 1 - alpha;
+    break;
+  case IIR_TYPE_HIGH_PASS:
+    b0 = (1 + cw) / 2;
+    b1 = -(1 + cw);
+    b2 = (1 + cw) / 2;
+    a0 = 1 + alpha;
+    a1 = -2 * cw;
+    a2 = 1 - alpha;
+    break;
+  default:
+    return -3;
+  }
+
+  const double g = pow(10.0, (double)gain_db / 20.0);
+  out->b0 = g * b0 / a0;
+  out->b1 = g * b1 / a0;
+  out->b2 = g * b2 / a0;
+  out->a1 = a1 / a0;
+  out->a2 = a2 / a0;
+  return 0;
+}
+
+static int32_t quantize_q31(double v, uint8_t post_shift) {
+  double scaled = v * (2147483648.0 / (double)(1u << post_shift));
+  scaled += scaled >= 0.0 ? 0.5 : -0.5;
+  if (scaled >= 2147483647.0)
+    return INT32_MAX;
+  if (scaled <= -2147483648.0)
+    return INT32_MIN;
+  return (int32_t)scaled;
+}
+
+int biquad_cascade_build(BiquadCascadeCoefs *out, BiquadForm form,
+                         uint32_t sample_rate, const IIR_CFG_T *cfg,
+                         uint8_t ch) {
+  BiquadCoefs sec[BIQUAD_CASCADE_MAX_SECTIONS];
+  int num;
+
+  if (!out || !cfg || ch >= BIQUAD_CASCADE_MAX_CH)
+    return -1;
+  if (cfg->num < 0 || cfg->num > BIQUAD_CASCADE_MAX_SECTIONS)
+    return -3;
+
+  const float gain_db = ch == 0 ? cfg->gain0 : cfg->gain1;
+  num = cfg->num;
+  for (int i = 0; i < num; ++i) {
+    int ret = biquad_cascade_design(&cfg->param[i], i == 0 ? gain_db : 0.0f,
+                                    sample_rate, &sec[i]);
+    if (ret)
+      return ret;
+  }
+  if (num == 0 && gain_db != 0.0f) {
+    // Gain-only configuration: a single pass-through section carries it.
+    memset(&sec[0], 0, sizeof(sec[0]));
+    sec[0].b0 = pow(10.0, (double)gain_db / 20.0);
+    num = 1;
+  }
+
+  out->form = form;
+  out->num[ch] = (uint8_t)num;
+  out->post_shift[ch] = 0;
+
+  if (form == BIQUAD_FORM_TDF2_F32) {
+    for (int i = 0; i < num; ++i) {
+      float *c = out->c.f32[ch][i];
+      c[0] = (float)sec[i].b0;
+      c[1] = (float)sec[i].b1;
+      c[2] = (float)sec[i].b2;
+      c[3] = (float)-sec[i].a1;
+      c[4] = (float)-sec[i].a2;
+    }
+    return 0;
+  }
+
+  double peak = 0.0;
+  for (int i = 0; i < num; ++i) {
+    const double v[5] = {sec[i].b0, sec[i].b1, sec[i].b2, sec[i].a1,
+                         sec[i].a2};
+    for (int k = 0; k < 5; ++k)
+      peak = fabs(v[k]) > peak ? fabs(v[k]) : peak;
+  }
+  uint8_t post_shift = 0;
+  while (post_shift < BIQUAD_CASCADE_MAX_POST_SHIFT &&
+         peak >= (double)(1u << post_shift))
+    post_shift++;
+  if (peak >= (double)(1u << post_shift))
+    return -4;
+
+  out->post_shift[ch] = post_shift;
+  for (int i = 0; i < num; ++i) {
+    int32_t *c = out->c.q31[ch][i];
+    c[0] = quantize_q31(sec[i].b0, post_shift);
+    c[1] = quantize_q31(sec[i].b1, post_shift);
+    c[2] = quantize_q31(sec[i].b2, post_shift);
+    c[3] = quantize_q31(-sec[i].a1, post_shift);
+    c[4] = quantize_q31(-sec[i].a2, post_shift);
+  }
+  return 0;
+}
+
+int biquad_cascade_open(BiquadCascade *bq, BiquadForm form,
+                        uint32_t sample_rate, uint8_t bits, uint8_t channels) {
+  if (!bq || sample_rate == 0 || channels == 0 ||
+      channels > BIQUAD_CASCADE_MAX_CH || (bits != 16 && bits != 24))
+    return -1;
+
+  memset(bq, 0, sizeof(*bq));
+  bq->sample_rate = sample_rate;
+  bq->bits = bits;
+  bq->channels = channels;
+  bq->form = form;
+  bq->coefs.form = form;
+  bq->active = &bq->coefs;
+  return 0;
+}
+
+// Zero the state of sections `from` and up.
+static void reset_sections(BiquadForm form, BiquadCascadeState *z, int ch,
+                           int from) {
+  if (from >= BIQUAD_CASCADE_MAX_SECTIONS)
+    return;
+  if (form == BIQUAD_FORM_TDF2_F32)
+    memset(z->f32[ch][from], 0,
+           (BIQUAD_CASCADE_MAX_SECTIONS - from) * sizeof(z->f32[ch][0]));
+  else
+    memset(z->q31[ch][from], 0,
+           (BIQUAD_CASCADE_MAX_SECTIONS - from) * sizeof(z->q31[ch][0]));
+}
+
+int biquad_cascade_set_cfg(BiquadCascade *bq, const IIR_CFG_T *cfg, int ch) {
+  if (!bq || !cfg || ch >= BIQUAD_CASCADE_MAX_CH)
+    return -1;
+
+  if (bq->active != &bq->coefs) {
+    memcpy(&bq->coefs, bq->active, sizeof(bq->coefs));
+    bq->active = &bq->coefs;
+  }
+  bq->fade_len = 0;
+  for (int c = ch < 0 ? 0 : ch; c < (ch < 0 ? BIQUAD_CASCADE_MAX_CH : ch + 1);
+       ++c) {
+    int ret = biquad_cascade_build(&bq->coefs, bq->form, bq->sample_rate, cfg,
+                                   (uint8_t)c);
+    if (ret)
+      return ret;
+    reset_sections(bq->form, &bq->z, c, 0);
+  }
+  return 0;
+}
+
+void biquad_cascade_reset(BiquadCascade *bq) {
+  if (!bq)
+    return;
+  memset(&bq->z, 0, sizeof(bq->z));
+  bq->fade_len = 0;
+}
+
+int biquad_cascade_swap(BiquadCascade *bq, const BiquadCascadeCoefs *coefs,
+                        uint32_t fade_frames) {
+  if (!bq || !coefs || coefs->form != bq->form)
+    return -1;
+
+  if (fade_frames > 0) {
+    // The outgoing set keeps running on a copy of the current state.
+    if (bq->active != &bq->fade_coefs)
+      memcpy(&bq->fade_coefs, bq->active, sizeof(bq->fade_coefs));
+    memcpy(&bq->fade_z, &bq->z, sizeof(bq->fade_z));
+    bq->fade_len = fade_frames;
+    bq->fade_pos = 0;
+  } else {
+    bq->fade_len = 0;
+  }
+  // DF1 history stays valid across a coefficient change; only sections that
+  // were not running before start from silence.
+  for (int ch = 0; ch < BIQUAD_CASCADE_MAX_CH; ++ch) {
+    if (coefs->num[ch] > bq->active->num[ch])
+      reset_sections(bq->form, &bq->z, ch, bq->active->num[ch]);
+  }
+  bq->active = coefs;
+  return 0;
+}
+
+void biquad_cascade_detach(BiquadCascade *bq) {
+  if (!bq || bq->fade_len > 0 || bq->active == &bq->fade_coefs)
+    return;
+  memcpy(&bq->fade_coefs, bq->active, sizeof(bq->fade_coefs));
+  bq->active = &bq->fade_coefs;
+}
+
+bool biquad_cascade_fading(const BiquadCascade *bq) {
+  return bq && bq->fade_len > 0;
+}
+
+static inline int32_t sat_s32(int64_t v) {
+  if (v > INT32_MAX)
+    return INT32_MAX;
+  if (v < INT32_MIN)
+    return INT32_MIN;
+  return (int32_t)v;
+}
+
+static void df1_q31_block(const int32_t (*coef)[5], uint8_t num,
+                          uint8_t post_shift, int32_t (*z)[4], int32_t *buf,
+                          uint32_t n) {
+  const uint32_t shift = 31u - post_shift;
+  const int64_t round = (int64_t)1 << (shift - 1);
+
+  for (uint8_t s = 0; s < num; ++s) {
+    const int32_t b0 = coef[s][0], b1 = coef[s][1], b2 = coef[s][2];
+    const int32_t a1 = coef[s][3], a2 = coef[s][4];
+    int32_t x1 = z[s][0], x2 = z[s][1], y1 = z[s][2], y2 = z[s][3];
+
+    for (uint32_t i = 0; i < n; ++i) {
+      const int32_t x0 = buf[i];
+      int64_t acc = round;
+      acc += (int64_t)b0 * x0;
+      acc += (int64_t)b1 * x1;
+      acc += (int64_t)b2 * x2;
+      acc += (int64_t)a1 * y1;
+      acc += (int64_t)a2 * y2;
+      const int32_t y0 = sat_s32(acc >> shift);
+      x2 = x1;
+      x1 = x0;
+      y2 = y1;
+      y1 = y0;
+      buf[i] = y0;
+    }
+    z[s][0] = x1;
+    z[s][1] = x2;
+    z[s][2] = y1;
+    z[s][3] = y2;
+  }
+}
+
+static void tdf2_f32_block(const float (*coef)[5], uint8_t num,
+                           float (*z)[2], float *buf, uint32_t n) {
+  for (uint8_t s = 0; s < num; ++s) {
+    const float b0 = coef[s][0], b1 = coef[s][1], b2 = coef[s][2];
+    const float a1 = coef[s][3], a2 = coef[s][4];
+    float s1 = z[s][0], s2 = z[s][1];
+
+    for (uint32_t i = 0; i < n; ++i) {
+      const float x0 = buf[i];
+      const float y0 = b0 * x0 + s1;
+      s1 = b1 * x0 + a1 * y0 + s2;
+      s2 = b2 * x0 + a2 * y0;
+      buf[i] = y0;
+    }
+    z[s][0] = s1;
+    z[s][1] = s2;
+  }
+}
+
+static int32_t round_f32(float v) {
+  return (int32_t)(v >= 0.0f ? v + 0.5f : v - 0.5f);
+}
+
+// Linear crossfade from `old` to `cur` in place; `pos` is the frame index of
+// cur[0] within a fade of `len` frames.
+static void fade_q31_block(int32_t *cur, const int32_t *old, uint32_t pos,
+                           uint32_t len, uint32_t n) {
+  // Q30 weight keeps the product of a full-range difference inside int64.
+  const uint64_t step = ((uint64_t)1 << 30) / len;
+  uint64_t w = (uint64_t)pos * step;
+
+  for (uint32_t i = 0; i < n; ++i, w += step) {
+    if (pos + i >= len)
+      break;
+    const int64_t d = (int64_t)cur[i] - old[i];
+    cur[i] = old[i] + (int32_t)((d * (int64_t)w) >> 30);
+  }
+}
+
+static void fade_f32_block(float *cur, const float *old, uint32_t pos,
+                           uint32_t len, uint32_t n) {
+  const float step = 1.0f / (float)len;
+
+  for (uint32_t i = 0; i < n && pos + i < len; ++i)
+    cur[i] = old[i] + (cur[i] - old[i]) * ((float)(pos + i) * step);
+}
+
+void biquad_cascade_run(BiquadCascade *bq, void *pcm, uint32_t samples) {
+  if (!bq || !pcm || samples == 0)
+    return;
+
+  const BiquadCascadeCoefs *coefs = bq->active;
+  const BiquadCascadeCoefs *old = &bq->fade_coefs;
+  const bool fading = bq->fade_len > 0;
+  const uint8_t channels = bq->channels;
+  const uint32_t frames = samples / channels;
+  const int32_t out_max = bq->bits == 16 ? INT16_MAX : 0x7FFFFF;
+  const int32_t out_min = bq->bits == 16 ? INT16_MIN : -0x800000;
+  const uint32_t qshift = BIQUAD_CASCADE_SAMPLE_Q - (bq->bits - 1);
+  int16_t *pcm16 = (int16_t *)pcm;
+  int32_t *pcm32 = (int32_t *)pcm;
+
+  for (uint8_t ch = 0; ch < channels; ++ch) {
+    const uint8_t num = coefs->num[ch];
+    if (num == 0 && !fading)
+      continue;
+
+    for (uint32_t base = 0; base < frames; base += BIQUAD_CASCADE_BLOCK) {
+      const uint32_t n = frames - base < BIQUAD_CASCADE_BLOCK
+                             ? frames - base
+                             : BIQUAD_CASCADE_BLOCK;
+      const uint32_t first = base * channels + ch;
+
+      if (bq->form == BIQUAD_FORM_TDF2_F32) {
+        float blk[BIQUAD_CASCADE_BLOCK];
+        float prev[BIQUAD_CASCADE_BLOCK];
+        for (uint32_t i = 0; i < n; ++i)
+          blk[i] = bq->bits == 16 ? (float)pcm16[first + i * channels]
+                                  : (float)pcm32[first + i * channels];
+        if (fading) {
+          memcpy(prev, blk, n * sizeof(blk[0]));
+          tdf2_f32_block((const float(*)[5])old->c.f32[ch], old->num[ch],
+                         bq->fade_z.f32[ch], prev, n);
+        }
+        tdf2_f32_block((const float(*)[5])coefs->c.f32[ch], num,
+                       bq->z.f32[ch], blk, n);
+        if (fading)
+          fade_f32_block(blk, prev, bq->fade_pos + base, bq->fade_len, n);
+        for (uint32_t i = 0; i < n; ++i) {
+          float y = blk[i];
+          int32_t v = y >= (float)out_max   ? out_max
+                      : y <= (float)out_min ? out_min
+                                            : round_f32(y);
+          if (bq->bits == 16)
+            pcm16[first + i * channels] = (int16_t)v;
+          else
+            pcm32[first + i * channels] = v;
+        }
+        continue;
+      }
+
+      int32_t blk[BIQUAD_CASCADE_BLOCK];
+      int32_t prev[BIQUAD_CASCADE_BLOCK];
+      for (uint32_t i = 0; i < n; ++i)
+        blk[i] = (bq->bits == 16 ? (int32_t)pcm16[first + i * channels]
+                                 : pcm32[first + i * channels]) *
+                 (1 << qshift);
+      if (fading) {
+        memcpy(prev, blk, n * sizeof(blk[0]));
+        df1_q31_block((const int32_t(*)[5])old->c.q31[ch], old->num[ch],
+                      old->post_shift[ch], bq->fade_z.q31[ch], prev, n);
+      }
+      df1_q31_block((const int32_t(*)[5])coefs->c.q31[ch], num,
+                    coefs->post_shift[ch], bq->z.q31[ch], blk, n);
+      if (fading)
+        fade_q31_block(blk, prev, bq->fade_pos + base, bq->fade_len, n);
+      const int32_t round = 1 << (qshift - 1);
+      for (uint32_t i = 0; i < n; ++i) {
+        int32_t v = (int32_t)(((int64_t)blk[i] + round) >> qshift);
+        v = v > out_max ? out_max : v;
+        v = v < out_min ? out_min : v;
+        if (bq->bits == 16)
+          pcm16[first + i * channels] = (int16_t)v;
+        else
+          pcm32[first + i * channels] = v;
+      }
+    }
+  }
+
+  if (fading) {
+    bq->fade_pos += frames;
+    if (bq->fade_pos >= bq->fade_len)
+      bq->fade_len = 0;
+  }
+}
+
+void biquad_bank_init(BiquadCoefBank *bank, BiquadForm form) {
+  if (!bank)
+    return;
+  memset(bank, 0, sizeof(*bank));
+  for (int i = 0; i < BIQUAD_BANK_SLOTS; ++i)
+    bank->slot[i].form = form;
+  bank->front = 0;
+  bank->ready = 1;
+  bank->back = 2;
+  bank->latest = 1;
+}
+
+BiquadCascadeCoefs *biquad_bank_edit(BiquadCoefBank *bank) {
+  return bank ? &bank->slot[bank->back] : NULL;
+}
+
+void biquad_bank_publish(BiquadCoefBank *bank) {
+  if (!bank)
+    return;
+  const uint8_t pub = bank->back;
+  bank->back = __atomic_exchange_n(&bank->ready, pub | BIQUAD_BANK_FRESH,
+                                   __ATOMIC_ACQ_REL) &
+               ~BIQUAD_BANK_FRESH;
+  bank->latest = pub;
+  // The audio thread only ever reads slot[pub], so seeding the next edit from
+  // it is safe even if it is acquired meanwhile.
+  memcpy(&bank->slot[bank->back], &bank->slot[pub], sizeof(bank->slot[0]));
+}
+
+void biquad_bank_discard(BiquadCoefBank *bank) {
+  if (!bank)
+    return;
+  memcpy(&bank->slot[bank->back], &bank->slot[bank->latest],
+         sizeof(bank->slot[0]));
+}
+
+const BiquadCascadeCoefs *biquad_bank_acquire(BiquadCoefBank *bank) {
+  if (!bank ||
+      !(__atomic_load_n(&bank->ready, __ATOMIC_ACQUIRE) & BIQUAD_BANK_FRESH))
+    return NULL;
+  bank->front =
+      __atomic_exchange_n(&bank->ready, bank->front, __ATOMIC_ACQ_REL) &
+      ~BIQUAD_BANK_FRESH;
+  return &bank->slot[bank->front];
+}
@@ -0,0 +1,135 @@
+#ifndef __BIQUAD_CASCADE_H__
+#define __BIQUAD_CASCADE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "iir_process.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// In-tree software biquad cascade. Accepts the same IIR_CFG_T as iir_set_cfg()
+// and runs on interleaved 16-bit or 24-bit (right-aligned in int32_t) PCM.
+
+#define BIQUAD_CASCADE_MAX_CH 2
+#define BIQUAD_CASCADE_MAX_SECTIONS IIR_PARAM_NUM
+
+// Internal Q format of the fixed-point path: full scale is 2^27, leaving four
+// guard bits (+24 dB) for boosting sections before the output saturates.
+#define BIQUAD_CASCADE_SAMPLE_Q 27
+#define BIQUAD_CASCADE_MAX_POST_SHIFT 5
+
+typedef enum {
+  // Direct form I, Q31 coefficients (scaled by 2^-post_shift), 32x32->64
+  // multiply-accumulate, like arm_biquad_cas_df1_32x64_q31().
+  BIQUAD_FORM_DF1_Q31 = 0,
+  // Transposed direct form II in single precision float.
+  BIQUAD_FORM_TDF2_F32,
+} BiquadForm;
+
+// Normalised section coefficients: y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2.
+typedef struct {
+  double b0, b1, b2, a1, a2;
+} BiquadCoefs;
+
+// Runtime coefficients for every channel, quantised for one form. Per section
+// the order is b0, b1, b2, -a1, -a2.
+typedef struct {
+  BiquadForm form;
+  uint8_t num[BIQUAD_CASCADE_MAX_CH];
+  uint8_t post_shift[BIQUAD_CASCADE_MAX_CH];
+  union {
+    int32_t q31[BIQUAD_CASCADE_MAX_CH][BIQUAD_CASCADE_MAX_SECTIONS][5];
+    float f32[BIQUAD_CASCADE_MAX_CH][BIQUAD_CASCADE_MAX_SECTIONS][5];
+  } c;
+} BiquadCascadeCoefs;
+
+typedef union {
+  // x1, x2, y1, y2 per section.
+  int32_t q31[BIQUAD_CASCADE_MAX_CH][BIQUAD_CASCADE_MAX_SECTIONS][4];
+  // s1, s2 per section.
+  float f32[BIQUAD_CASCADE_MAX_CH][BIQUAD_CASCADE_MAX_SECTIONS][2];
+} BiquadCascadeState;
+
+typedef struct {
+  uint32_t sample_rate;
+  uint8_t bits;
+  uint8_t channels;
+  BiquadForm form;
+  // Coefficients used by biquad_cascade_run(): `coefs` after
+  // biquad_cascade_set_cfg(), a bank slot after biquad_cascade_swap(), or
+  // `fade_coefs` after biquad_cascade_detach().
+  const BiquadCascadeCoefs *active;
+  BiquadCascadeCoefs coefs;
+  BiquadCascadeState z;
+  // Outgoing coefficients and state while crossfading after a swap.
+  // Otherwise `fade_coefs` may hold the detached active set.
+  uint32_t fade_len;
+  uint32_t fade_pos;
+  BiquadCascadeCoefs fade_coefs;
+  BiquadCascadeState fade_z;
+} BiquadCascade;
+
+// Triple-buffered coefficient sets shared between a control thread (writer)
+// and the audio thread (reader) without locks. The writer edits the back slot
+// and publishes it; the reader takes the newest published slot at a frame
+// boundary and owns it until its next acquire.
+#define BIQUAD_BANK_SLOTS 3
+#define BIQUAD_BANK_FRESH 0x80
+
+typedef struct {
+  BiquadCascadeCoefs slot[BIQUAD_BANK_SLOTS];
+  uint8_t front;  // audio thread
+  uint8_t back;   // control thread
+  uint8_t latest; // control thread: last published slot
+  uint8_t ready;  // shared: slot index | BIQUAD_BANK_FRESH
+} BiquadCoefBank;
+
+// RBJ cookbook design of one section in double precision. `gain_db` is an
+// extra broadband gain folded into the numerator. Returns 0 on success.
+int biquad_cascade_design(const IIR_PARAM_T *param, float gain_db,
+                          uint32_t sample_rate, BiquadCoefs *out);
+
+// Design and quantise `cfg` for channel `ch` (0 = left/gain0, 1 =
+// right/gain1) into `out`. The channel gain is folded into the first section.
+int biquad_cascade_build(BiquadCascadeCoefs *out, BiquadForm form,
+                         uint32_t sample_rate, const IIR_CFG_T *cfg,
+                         uint8_t ch);
+
+int biquad_cascade_open(BiquadCascade *bq, BiquadForm form,
+                        uint32_t sample_rate, uint8_t bits, uint8_t channels);
+// Apply `cfg` to one channel, or to all channels when `ch` is negative.
+int biquad_cascade_set_cfg(BiquadCascade *bq, const IIR_CFG_T *cfg, int ch);
+void biquad_cascade_reset(BiquadCascade *bq);
+
+// Switch to `coefs` at the next sample. With `fade_frames` > 0 the outputs of
+// the previous and new coefficients are crossfaded linearly over that many
+// frames. `coefs` must stay valid until the next swap or set_cfg.
+int biquad_cascade_swap(BiquadCascade *bq, const BiquadCascadeCoefs *coefs,
+                        uint32_t fade_frames);
+// Run from a private copy of the active coefficients, so the bank slot they
+// came from can go back to the writer. Call before biquad_bank_acquire(),
+// which releases that slot. Does nothing while fading.
+void biquad_cascade_detach(BiquadCascade *bq);
+bool biquad_cascade_fading(const BiquadCascade *bq);
+
+// Filter `samples` interleaved samples in place.
+void biquad_cascade_run(BiquadCascade *bq, void *pcm, uint32_t samples);
+
+void biquad_bank_init(BiquadCoefBank *bank, BiquadForm form);
+// Control thread: the slot to edit, holding the last published coefficients.
+BiquadCascadeCoefs *biquad_bank_edit(BiquadCoefBank *bank);
+void biquad_bank_publish(BiquadCoefBank *bank);
+// Control thread: drop edits made since the last publish.
+void biquad_bank_discard(BiquadCoefBank *bank);
+// Audio thread: the newest published coefficients, or NULL if nothing was
+// published since the previous call. The slot returned by the previous call
+// goes back to the writer, so stop using it first (biquad_cascade_detach()).
+const BiquadCascadeCoefs *biquad_bank_acquire(BiquadCoefBank *bank);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __BIQUAD_CASCADE_H__
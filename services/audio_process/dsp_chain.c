@@ -20,6 +20,7 @@ static void reset_ramp(DspChainRamp *ramp, float headroom_db) {
   ramp->remaining_frames = 0;
   ramp->headroom_db = headroom_db;
   ramp->applied_gain_db = -headroom_db;
+  ramp->last_linear_gain = db_to_linear(-headroom_db);
 }
 
 bool dsp_chain_init(DspChainState *state, const char **stage_order,
@@ -40,10 +41,7 @@ bool dsp_chain_init(DspChainState *state, const char **stage_order,
   return state->limiter_last;
 }
 
-float dsp_chain_begin_frame(DspChainState *state, uint32_t frame_samples) {
-  if (!state)
-    return 1.0f;
-
+static void advance_frame(DspChainState *state, uint32_t frame_samples) {
   state->frame_samples = frame_samples;
   state->frame_start_fast_ticks = hal_fast_sys_timer_get();
   state->counters.frames_processed++;
@@ -54,8 +52,97 @@ float dsp_chain_begin_frame(DspChainState *state, uint32_t frame_samples) {
     state->ramp.current_gain_db += state->ramp.step_db;
     state->ramp.remaining_frames--;
   }
+}
+
+float dsp_chain_begin_frame(DspChainState *state, uint32_t frame_samples) {
+  if (!state)
+    return 1.0f;
+
+  advance_frame(state, frame_samples);
+  state->ramp.last_linear_gain = db_to_linear(state->ramp.applied_gain_db);
+  return state->ramp.last_linear_gain;
+}
+
+static int32_t gain_to_q31(float gain, uint8_t shift) {
+  float scaled = gain * (2147483648.0f / (float)(1u << shift));
+  if (scaled >= 2147483647.0f)
+    return INT32_MAX;
+  if (scaled <= 0.0f)
+    return 0;
+  return (int32_t)scaled;
+}
+
+void dsp_chain_begin_frame_fixed(DspChainState *state, uint32_t frame_samples,
+                                 DspChainGainBlock *out) {
+  if (!out)
+    return;
+  if (!state) {
+    out->start_q31 = INT32_MAX;
+    out->step_q31 = 0;
+    out->shift = 0;
+    out->unity = true;
+    return;
+  }
+
+  advance_frame(state, frame_samples);
 
-  return db_to_linear(state->ramp.applied_gain_db);
+  float start = state->ramp.last_linear_gain;
+  float end = db_to_linear(state->ramp.applied_gain_db);
+  float peak = start > end ? start : end;
+  uint8_t shift = 0;
+  while (shift < DSP_CHAIN_GAIN_MAX_SHIFT && peak >= (float)(1u << shift))
+    shift++;
+
+  int32_t start_q31 = gain_to_q31(start, shift);
+  int32_t end_q31 = gain_to_q31(end, shift);
+
+  out->shift = shift;
+  out->start_q31 = start_q31;
+  out->step_q31 = frame_samples
+                      ? (int32_t)(((int64_t)end_q31 - start_q31) /
+                                  (int64_t)frame_samples)
+                      : 0;
+  out->unity = out->step_q31 == 0 && fabsf(end - 1.0f) < 0.0001f;
+  state->ramp.last_linear_gain = end;
+}
+
+static inline int32_t sat_count(int32_t v, int32_t lo, int32_t hi,
+                                uint32_t *clipped) {
+  int32_t s = v > hi ? hi : v;
+  s = s < lo ? lo : s;
+  *clipped += s != v;
+  return s;
+}
+
+uint32_t dsp_chain_apply_gain_fixed(const DspChainGainBlock *gain, void *pcm,
+                                    uint32_t frame_samples, uint8_t channels,
+                                    uint8_t bits) {
+  if (!gain || !pcm || frame_samples == 0 || channels == 0 || gain->unity)
+    return 0;
+
+  const uint32_t rshift = 31u - gain->shift;
+  const int32_t step = gain->step_q31;
+  int32_t g = gain->start_q31;
+  uint32_t clipped = 0;
+
+  if (bits == 16) {
+    int16_t *p = (int16_t *)pcm;
+    for (uint32_t n = 0; n < frame_samples; ++n, g += step) {
+      for (uint8_t ch = 0; ch < channels; ++ch, ++p) {
+        int32_t v = (int32_t)(((int64_t)*p * g) >> rshift);
+        *p = (int16_t)sat_count(v, INT16_MIN, INT16_MAX, &clipped);
+      }
+    }
+  } else if (bits == 24) {
+    int32_t *p = (int32_t *)pcm;
+    for (uint32_t n = 0; n < frame_samples; ++n, g += step) {
+      for (uint8_t ch = 0; ch < channels; ++ch, ++p) {
+        int32_t v = (int32_t)(((int64_t)*p * g) >> rshift);
+        *p = sat_count(v, -0x800000, 0x7FFFFF, &clipped);
+      }
+    }
+  }
+  return clipped;
 }
 
 void dsp_chain_finish_frame(DspChainState *state) {
@@ -92,6 +179,8 @@ void dsp_chain_force_mute(DspChainState *state) {
   state->ramp.target_gain_db = -80.0f;
   state->ramp.remaining_frames = 0;
   state->ramp.step_db = 0.0f;
+  state->ramp.last_linear_gain =
+      db_to_linear(state->ramp.current_gain_db - state->ramp.headroom_db);
 }
 
 void dsp_chain_mark_limiter(DspChainState *state) {
@@ -100,6 +189,15 @@ void dsp_chain_mark_limiter(DspChainState *state) {
   state->counters.limiter_engaged++;
 }
 
+void dsp_chain_mark_gain_reduction(DspChainState *state, uint32_t gr_frames,
+                                   uint32_t max_gr_q31) {
+  if (!state)
+    return;
+  state->counters.limiter_gr_frames += gr_frames;
+  if (max_gr_q31 > state->counters.limiter_max_gr_q31)
+    state->counters.limiter_max_gr_q31 = max_gr_q31;
+}
+
 void dsp_chain_mark_clipping(DspChainState *state, uint32_t clipped) {
   if (!state)
     return;
@@ -124,3 +222,40 @@ void dsp_chain_get_counters(const DspChainState *state, DspChainCounters *out) {
   memcpy(out, &state->counters, sizeof(*out));
 }
 
+
+void dsp_chain_stage_start(DspChainState *state) {
+  if (!state)
+    return;
+  state->stage_mark_fast_ticks = hal_fast_sys_timer_get();
+}
+
+void dsp_chain_stage_mark(DspChainState *state, DspChainStageId stage,
+                          uint32_t samples) {
+  if (!state || stage >= DSP_CHAIN_STAGE_NUM)
+    return;
+
+  uint32_t now = hal_fast_sys_timer_get();
+  uint32_t elapsed = now - state->stage_mark_fast_ticks;
+  DspChainStageStats *stats = &state->stage_stats[stage];
+
+  stats->calls++;
+  stats->last_ticks = elapsed;
+  if (elapsed > stats->max_ticks)
+    stats->max_ticks = elapsed;
+  stats->total_ticks += elapsed;
+  stats->total_samples += samples;
+  state->stage_mark_fast_ticks = now;
+}
+
+void dsp_chain_get_stage_stats(const DspChainState *state,
+                               DspChainStageId stage, DspChainStageStats *out) {
+  if (!state || !out || stage >= DSP_CHAIN_STAGE_NUM)
+    return;
+  memcpy(out, &state->stage_stats[stage], sizeof(*out));
+}
+
+void dsp_chain_reset_stage_stats(DspChainState *state) {
+  if (!state)
+    return;
+  memset(state->stage_stats, 0, sizeof(state->stage_stats));
+}
@@ -15,8 +15,35 @@ typedef struct {
   uint32_t overflow_events;
   uint64_t total_cpu_cycles;
   uint32_t last_frame_us;
+  // Sample frames the peak limiter let out below unity gain, and the deepest
+  // reduction it applied, unity minus the lowest gain in Q31.
+  uint32_t limiter_gr_frames;
+  uint32_t limiter_max_gr_q31;
 } DspChainCounters;
 
+// Stages of audio_process_run() that can be timed individually when
+// AUDIO_PROCESS_STAGE_PROFILE is enabled.
+typedef enum {
+  DSP_CHAIN_STAGE_REMIX_IN = 0,
+  DSP_CHAIN_STAGE_BLOCK_GAIN,
+  DSP_CHAIN_STAGE_SW_IIR,
+  DSP_CHAIN_STAGE_HW_FIR,
+  DSP_CHAIN_STAGE_DRC,
+  DSP_CHAIN_STAGE_LIMITER,
+  DSP_CHAIN_STAGE_HW_IIR,
+  DSP_CHAIN_STAGE_REMIX_OUT,
+  DSP_CHAIN_STAGE_NUM,
+} DspChainStageId;
+
+// Per-stage cost accumulated in fast timer ticks.
+typedef struct {
+  uint32_t calls;
+  uint32_t last_ticks;
+  uint32_t max_ticks;
+  uint64_t total_ticks;
+  uint64_t total_samples;
+} DspChainStageStats;
+
 // Block-level ramping and headroom state. Gains are stored in dB to make it
 // clear how much headroom is being reserved when stacking EQ and mode overlays.
 typedef struct {
@@ -26,8 +53,23 @@ typedef struct {
   uint32_t remaining_frames;
   float headroom_db;
   float applied_gain_db;
+  // Linear gain reached at the end of the previous block; the fixed-point path
+  // interpolates from here to the current block gain.
+  float last_linear_gain;
 } DspChainRamp;
 
+// Largest block exponent used by the fixed-point gain path (gains < 8.0).
+#define DSP_CHAIN_GAIN_MAX_SHIFT 3
+
+// Per-sample gain trajectory for one block. The gain applied to sample frame
+// n is (start_q31 + n * step_q31) * 2^shift, with the mantissa in Q31.
+typedef struct {
+  int32_t start_q31;
+  int32_t step_q31;
+  uint8_t shift;
+  bool unity;
+} DspChainGainBlock;
+
 typedef struct {
   const char *stages[DSP_CHAIN_MAX_STAGES];
   uint8_t stage_count;
@@ -36,6 +78,8 @@ typedef struct {
   DspChainCounters counters;
   uint32_t frame_samples;
   uint32_t frame_start_fast_ticks;
+  uint32_t stage_mark_fast_ticks;
+  DspChainStageStats stage_stats[DSP_CHAIN_STAGE_NUM];
 } DspChainState;
 
 // Initialize the chain with an explicit stage order (limiter must be last).
@@ -46,6 +90,19 @@ bool dsp_chain_init(DspChainState *state, const char **stage_order,
 // should be applied for ramping + headroom management.
 float dsp_chain_begin_frame(DspChainState *state, uint32_t frame_samples);
 
+// Fixed-point variant of dsp_chain_begin_frame(). Fills `out` with a linear
+// ramp from the previous block's gain to this block's gain over
+// `frame_samples` sample frames, so ramps are sample accurate.
+void dsp_chain_begin_frame_fixed(DspChainState *state, uint32_t frame_samples,
+                                 DspChainGainBlock *out);
+
+// Apply a block gain to interleaved PCM in place with saturation. `bits` is
+// 16 (int16_t samples) or 24 (right-aligned in int32_t). Every channel of a
+// sample frame gets the same gain. Returns the number of clipped samples.
+uint32_t dsp_chain_apply_gain_fixed(const DspChainGainBlock *gain, void *pcm,
+                                    uint32_t frame_samples, uint8_t channels,
+                                    uint8_t bits);
+
 // Complete telemetry for the current frame using the fast timer.
 void dsp_chain_finish_frame(DspChainState *state);
 
@@ -56,8 +113,19 @@ void dsp_chain_force_mute(DspChainState *state);
 
 // Telemetry helpers.
 void dsp_chain_mark_limiter(DspChainState *state);
+void dsp_chain_mark_gain_reduction(DspChainState *state, uint32_t gr_frames,
+                                   uint32_t max_gr_q31);
 void dsp_chain_mark_clipping(DspChainState *state, uint32_t clipped);
 void dsp_chain_mark_underflow(DspChainState *state);
 void dsp_chain_mark_overflow(DspChainState *state);
 void dsp_chain_get_counters(const DspChainState *state, DspChainCounters *out);
 
+// Stage profiling. `dsp_chain_stage_start` arms the stage timer; each
+// `dsp_chain_stage_mark` charges the time since the previous mark to `stage`.
+void dsp_chain_stage_start(DspChainState *state);
+void dsp_chain_stage_mark(DspChainState *state, DspChainStageId stage,
+                          uint32_t samples);
+void dsp_chain_get_stage_stats(const DspChainState *state,
+                               DspChainStageId stage, DspChainStageStats *out);
+void dsp_chain_reset_stage_stats(DspChainState *state);
+
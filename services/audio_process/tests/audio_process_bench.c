@@ -0,0 +1,210 @@
+// Host benchmark for audio_process_run(). Drives the full chain with 16- and
+// 24-bit stereo/mono frames at 44.1/48/96 kHz and prints per-stage cost from
+// the AUDIO_PROCESS_STAGE_PROFILE counters. ns/sample is normalised to
+// output (stereo, hardware layout) samples so the stage rows add up.
+//
+// usage: audio_process_bench [-f frames] [-n samples_per_frame] [-m cpu_mhz]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "audio_process.h"
+#include "fir_process.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define BENCH_MAX_FRAME_SAMPLES 1024
+#define BENCH_FIR_TAPS 64
+
+typedef struct {
+  enum AUD_SAMPRATE_T rate;
+  enum AUD_BITS_T bits;
+  enum AUD_CHANNEL_NUM_T sw_ch;
+} BenchCase;
+
+static const BenchCase BENCH_CASES[] = {
+    {AUD_SAMPRATE_44100, AUD_BITS_16, AUD_CHANNEL_NUM_2},
+    {AUD_SAMPRATE_48000, AUD_BITS_16, AUD_CHANNEL_NUM_2},
+    {AUD_SAMPRATE_96000, AUD_BITS_16, AUD_CHANNEL_NUM_2},
+    {AUD_SAMPRATE_44100, AUD_BITS_24, AUD_CHANNEL_NUM_2},
+    {AUD_SAMPRATE_48000, AUD_BITS_24, AUD_CHANNEL_NUM_2},
+    {AUD_SAMPRATE_96000, AUD_BITS_24, AUD_CHANNEL_NUM_2},
+    {AUD_SAMPRATE_44100, AUD_BITS_16, AUD_CHANNEL_NUM_1},
+    {AUD_SAMPRATE_48000, AUD_BITS_16, AUD_CHANNEL_NUM_1},
+    {AUD_SAMPRATE_96000, AUD_BITS_16, AUD_CHANNEL_NUM_1},
+    {AUD_SAMPRATE_44100, AUD_BITS_24, AUD_CHANNEL_NUM_1},
+    {AUD_SAMPRATE_48000, AUD_BITS_24, AUD_CHANNEL_NUM_1},
+    {AUD_SAMPRATE_96000, AUD_BITS_24, AUD_CHANNEL_NUM_1},
+};
+
+static const char *const STAGE_NAMES[DSP_CHAIN_STAGE_NUM] = {
+    "remix_in", "block_gain", "sw_iir",  "hw_fir",
+    "drc",      "limiter",    "hw_iir",  "remix_out",
+};
+
+static int32_t src_pcm[BENCH_MAX_FRAME_SAMPLES * 2];
+static int32_t work_pcm[BENCH_MAX_FRAME_SAMPLES * 2];
+static uint8_t eq_buf[4096];
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Host cycles per ns, measured against the TSC when one is available.
+static double calibrate_cycles_per_ns(void) {
+#ifdef BENCH_HAVE_TSC
+  double t0 = now_ns();
+  uint64_t c0 = __rdtsc();
+  while (now_ns() - t0 < 50e6) {
+  }
+  uint64_t c1 = __rdtsc();
+  double t1 = now_ns();
+  return (double)(c1 - c0) / (t1 - t0);
+#else
+  return 1.0;
+#endif
+}
+
+static AudiogramProfile make_bench_profile(void) {
+  AudiogramProfile p;
+  static const uint16_t freqs[] = {250, 500, 1000, 2000, 4000, 8000};
+  static const int16_t left[] = {10, 15, 25, 35, 45, 50};
+  static const int16_t right[] = {5, 10, 20, 30, 40, 55};
+
+  memset(&p, 0, sizeof(p));
+  p.schema_version = AUDIOGRAM_SCHEMA_VERSION;
+  for (size_t i = 0; i < sizeof(freqs) / sizeof(freqs[0]); ++i) {
+    p.left.frequencies_hz[i] = freqs[i];
+    p.right.frequencies_hz[i] = freqs[i];
+    p.left.thresholds_db_hl[i] = left[i];
+    p.right.thresholds_db_hl[i] = right[i];
+  }
+  p.left.point_count = sizeof(freqs) / sizeof(freqs[0]);
+  p.right.point_count = p.left.point_count;
+  return p;
+}
+
+static void make_fir_cfg(FIR_CFG_T *cfg) {
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->len = BENCH_FIR_TAPS;
+  for (int i = 0; i < BENCH_FIR_TAPS; ++i) {
+    // Hann-windowed low-pass, Q23 coefficients.
+    double n = i - (BENCH_FIR_TAPS - 1) / 2.0;
+    double sinc = n == 0.0 ? 0.5 : sin(0.5 * M_PI * n) / (M_PI * n);
+    double win = 0.5 - 0.5 * cos(2.0 * M_PI * i / (BENCH_FIR_TAPS - 1));
+    cfg->coef[i] = (int32_t)(sinc * win * (1 << 23));
+  }
+}
+
+// Two-tone test signal at -6 dBFS on the hardware channel layout.
+static void fill_source(const BenchCase *bc, uint32_t frame_samples) {
+  const double full_scale = bc->bits == AUD_BITS_16 ? 32767.0 : 8388607.0;
+  int16_t *pcm16 = (int16_t *)src_pcm;
+
+  for (uint32_t i = 0; i < frame_samples; ++i) {
+    double t = (double)i / (double)bc->rate;
+    double v = 0.25 * sin(2.0 * M_PI * 1000.0 * t) +
+               0.25 * sin(2.0 * M_PI * 6300.0 * t);
+    int32_t s = (int32_t)(v * full_scale);
+    for (uint32_t ch = 0; ch < 2; ++ch) {
+      if (bc->bits == AUD_BITS_16)
+        pcm16[2 * i + ch] = (int16_t)s;
+      else
+        src_pcm[2 * i + ch] = s;
+    }
+  }
+}
+
+static void run_case(const BenchCase *bc, uint32_t frames,
+                     uint32_t frame_samples, double cycles_per_ns) {
+  const uint32_t sample_size = bc->bits == AUD_BITS_16 ? 2 : 4;
+  const uint32_t frame_bytes = frame_samples * 2 * sample_size;
+  AudiogramProfile profile = make_bench_profile();
+  FIR_CFG_T fir_cfg;
+  DspChainStageStats stats;
+  double total_ns = 0.0;
+
+  fill_source(bc, frame_samples);
+  make_fir_cfg(&fir_cfg);
+
+  audio_process_open(bc->rate, bc->bits, bc->sw_ch, AUD_CHANNEL_NUM_2,
+                     (int32_t)frame_samples, eq_buf, sizeof(eq_buf));
+  audio_process_apply_audiogram(&profile);
+  audio_eq_set_cfg(&fir_cfg, NULL, AUDIO_EQ_TYPE_HW_FIR);
+  audio_process_reset_stage_stats();
+
+  double wall_start = now_ns();
+  for (uint32_t f = 0; f < frames; ++f) {
+    memcpy(work_pcm, src_pcm, frame_bytes);
+    audio_process_run((uint8_t *)work_pcm, frame_bytes);
+  }
+  double wall_ns = now_ns() - wall_start;
+
+  printf("\n%2u-bit %-6s %5u Hz, %u samples/ch/frame, %u frames\n", bc->bits,
+         bc->sw_ch == AUD_CHANNEL_NUM_1 ? "mono" : "stereo", bc->rate,
+         frame_samples, frames);
+  printf("  %-10s %10s %14s %12s\n", "stage", "ns/sample", "cycles/frame",
+         "max us");
+  for (int s = 0; s < DSP_CHAIN_STAGE_NUM; ++s) {
+    audio_process_get_stage_stats((DspChainStageId)s, &stats);
+    if (stats.calls == 0)
+      continue;
+    double ns = (double)stats.total_ticks;
+    total_ns += ns;
+    printf("  %-10s %10.2f %14.0f %12.2f\n", STAGE_NAMES[s],
+           ns / ((double)stats.calls * frame_samples * 2),
+           ns / (double)stats.calls * cycles_per_ns,
+           (double)stats.max_ticks / 1000.0);
+  }
+  printf("  %-10s %10.2f %14.0f %12s  (real-time load %.2f%%)\n", "total",
+         total_ns / ((double)frames * frame_samples * 2),
+         total_ns / (double)frames * cycles_per_ns, "",
+         100.0 * wall_ns / (1e9 * frames * frame_samples / (double)bc->rate));
+
+  audio_process_close();
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = 2000;
+  uint32_t frame_samples = 256;
+  double cpu_mhz = 0.0;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-f") == 0)
+      frames = (uint32_t)strtoul(argv[i + 1], NULL, 0);
+    else if (strcmp(argv[i], "-n") == 0)
+      frame_samples = (uint32_t)strtoul(argv[i + 1], NULL, 0);
+    else if (strcmp(argv[i], "-m") == 0)
+      cpu_mhz = strtod(argv[i + 1], NULL);
+  }
+  if (frames == 0 || frame_samples == 0 ||
+      frame_samples > BENCH_MAX_FRAME_SAMPLES) {
+    fprintf(stderr, "usage: %s [-f frames] [-n samples<=%d] [-m cpu_mhz]\n",
+            argv[0], BENCH_MAX_FRAME_SAMPLES);
+    return 1;
+  }
+
+  double cycles_per_ns =
+      cpu_mhz > 0.0 ? cpu_mhz / 1000.0 : calibrate_cycles_per_ns();
+  printf("audio_process_run host benchmark (%.0f MHz cycle clock)\n",
+         cycles_per_ns * 1000.0);
+
+  audio_process_init();
+  for (size_t i = 0; i < sizeof(BENCH_CASES) / sizeof(BENCH_CASES[0]); ++i) {
+    run_case(&BENCH_CASES[i], frames, frame_samples, cycles_per_ns);
+  }
+  return 0;
+}
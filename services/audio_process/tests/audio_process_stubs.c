@@ -0,0 +1,297 @@
+// Host stand-ins for the HAL services and prebuilt DSP libraries that
+// audio_process.c links against on the device. The FIR/DRC/limiter stages
+// are plain-C reference kernels with the same data layout and per-sample work
+// shape as the device libraries, so the harness timings track real changes to
+// the chain (remix, block gain, stage ordering) rather than library internals.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "audio_memory.h"
+#include "drc.h"
+#include "fir_process.h"
+#include "heap_api.h"
+#include "iir_process.h"
+#include "limiter.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STUB_MAX_CH 2
+#define STUB_POOL_SIZE (64 * 1024)
+
+// ---------------------------------------------------------------------------
+// HAL
+// ---------------------------------------------------------------------------
+
+// 4 GHz crystal -> CONFIG_FAST_SYSTICK_HZ of 1 GHz, i.e. one tick per ns.
+uint32_t hal_cmu_get_crystal_freq(void) { return 4000000000U; }
+
+uint32_t hal_fast_sys_timer_get(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+void config_protocol_init(void) {}
+
+int getMaxEqBand(void) { return IIR_PARAM_NUM; }
+
+int getSampleArray(uint8_t *buf, uint16_t *num) {
+  (void)buf;
+  *num = 0;
+  return 0;
+}
+
+void hal_cmd_set_res_playload(uint8_t *data, int len) {
+  (void)data;
+  (void)len;
+}
+
+static uint8_t syspool[STUB_POOL_SIZE];
+static uint32_t syspool_used;
+
+int syspool_get_buff(uint8_t **buff, uint32_t size) {
+  if (syspool_used + size > sizeof(syspool)) {
+    *buff = NULL;
+    return -1;
+  }
+  *buff = &syspool[syspool_used];
+  syspool_used += size;
+  return (int)size;
+}
+
+void audio_heap_init(void *begin_addr, size_t size) {
+  (void)begin_addr;
+  (void)size;
+  syspool_used = 0;
+}
+
+void audio_memory_info(size_t *total, size_t *used, size_t *max_used) {
+  *total = sizeof(syspool);
+  *used = 0;
+  *max_used = syspool_used;
+}
+
+// ---------------------------------------------------------------------------
+// Shared sample access
+// ---------------------------------------------------------------------------
+
+static float load_sample(const uint8_t *buf, enum AUD_BITS_T bits,
+                         uint32_t idx) {
+  if (bits == AUD_BITS_16)
+    return (float)((const int16_t *)buf)[idx];
+  return (float)((const int32_t *)buf)[idx];
+}
+
+static void store_sample(uint8_t *buf, enum AUD_BITS_T bits, uint32_t idx,
+                         float v) {
+  if (bits == AUD_BITS_16) {
+    if (v > 32767.0f)
+      v = 32767.0f;
+    else if (v < -32768.0f)
+      v = -32768.0f;
+    ((int16_t *)buf)[idx] = (int16_t)v;
+  } else {
+    if (v > 8388607.0f)
+      v = 8388607.0f;
+    else if (v < -8388608.0f)
+      v = -8388608.0f;
+    ((int32_t *)buf)[idx] = (int32_t)v;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// HW FIR: direct convolution with a per-channel history line.
+// ---------------------------------------------------------------------------
+
+static struct {
+  enum AUD_BITS_T bits;
+  uint32_t ch_num;
+  int32_t len;
+  float coef[FIR_COEF_NUM];
+  float hist[STUB_MAX_CH][FIR_COEF_NUM];
+  uint32_t pos[STUB_MAX_CH];
+} stub_fir;
+
+int fir_open(enum AUD_SAMPRATE_T sample_rate, enum AUD_BITS_T sample_bits,
+             enum AUD_CHANNEL_NUM_T ch_num, void *eq_buf, uint32_t len) {
+  (void)sample_rate;
+  (void)eq_buf;
+  (void)len;
+  memset(&stub_fir, 0, sizeof(stub_fir));
+  stub_fir.bits = sample_bits;
+  stub_fir.ch_num = ch_num > STUB_MAX_CH ? STUB_MAX_CH : ch_num;
+  return 0;
+}
+
+int fir_set_cfg(const FIR_CFG_T *cfg) {
+  stub_fir.len = cfg->len > FIR_COEF_NUM ? FIR_COEF_NUM : cfg->len;
+  for (int32_t i = 0; i < stub_fir.len; ++i)
+    stub_fir.coef[i] = (float)cfg->coef[i] / (float)(1 << 23);
+  return 0;
+}
+
+int fir_run(uint8_t *buf, uint32_t len) {
+  const uint32_t ch_num = stub_fir.ch_num ? stub_fir.ch_num : 1;
+  const int32_t taps = stub_fir.len;
+
+  if (taps <= 0)
+    return 0;
+  for (uint32_t i = 0; i < len; ++i) {
+    uint32_t ch = i % ch_num;
+    float *hist = stub_fir.hist[ch];
+    uint32_t pos = stub_fir.pos[ch];
+    float acc = 0.0f;
+
+    hist[pos] = load_sample(buf, stub_fir.bits, i);
+    for (int32_t t = 0; t < taps; ++t) {
+      acc += stub_fir.coef[t] * hist[pos];
+      pos = pos ? pos - 1 : (uint32_t)taps - 1;
+    }
+    stub_fir.pos[ch] = stub_fir.pos[ch] + 1 == (uint32_t)taps
+                           ? 0
+                           : stub_fir.pos[ch] + 1;
+    store_sample(buf, stub_fir.bits, i, acc);
+  }
+  return 0;
+}
+
+int fir_close(void) { return 0; }
+
+// ---------------------------------------------------------------------------
+// DRC / limiter: peak envelope follower with attack/release smoothing and a
+// static gain curve, one gain per channel.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+  enum AUD_BITS_T bits;
+  uint32_t ch_num;
+  float threshold;
+  float ratio;
+  float attack;
+  float release;
+  float env[STUB_MAX_CH];
+} StubDynamics;
+
+struct DrcState_ {
+  StubDynamics dyn;
+};
+
+struct LimiterState_ {
+  StubDynamics dyn;
+};
+
+const DrcConfig audio_drc_cfg = {
+    .knee = 3,
+    .filter_type = {-1, -1},
+    .band_num = 1,
+    .look_ahead_time = 10,
+    .band_settings = {{-20, 0, 2, 3, 3000, 1}, {-20, 0, 2, 3, 3000, 1}},
+};
+
+const LimiterConfig audio_drc2_cfg = {
+    .knee = 2,
+    .look_ahead_time = 10,
+    .threshold = -3,
+    .makeup_gain = 0,
+    .ratio = 1000,
+    .attack_time = 1,
+    .release_time = 3000,
+};
+
+static float time_coef(int ms, int sample_rate) {
+  if (ms <= 0)
+    return 0.0f;
+  return expf(-1000.0f / ((float)ms * (float)sample_rate));
+}
+
+static void dynamics_init(StubDynamics *dyn, int sample_rate, int sample_bit,
+                          int ch_num, int threshold_db, int ratio,
+                          int attack_ms, int release_ms) {
+  float full_scale = sample_bit == AUD_BITS_16 ? 32768.0f : 8388608.0f;
+
+  memset(dyn, 0, sizeof(*dyn));
+  dyn->bits = (enum AUD_BITS_T)sample_bit;
+  dyn->ch_num = ch_num > STUB_MAX_CH ? STUB_MAX_CH : (uint32_t)ch_num;
+  dyn->threshold = full_scale * powf(10.0f, (float)threshold_db / 20.0f);
+  dyn->ratio = ratio > 1 ? (float)ratio : 1.0f;
+  dyn->attack = time_coef(attack_ms, sample_rate);
+  dyn->release = time_coef(release_ms, sample_rate);
+}
+
+static void dynamics_run(StubDynamics *dyn, uint8_t *buf, uint32_t len) {
+  const uint32_t ch_num = dyn->ch_num ? dyn->ch_num : 1;
+
+  for (uint32_t i = 0; i < len; ++i) {
+    uint32_t ch = i % ch_num;
+    float x = load_sample(buf, dyn->bits, i);
+    float level = fabsf(x);
+    float coef = level > dyn->env[ch] ? dyn->attack : dyn->release;
+    float gain = 1.0f;
+
+    dyn->env[ch] = level + coef * (dyn->env[ch] - level);
+    if (dyn->env[ch] > dyn->threshold) {
+      float over = dyn->env[ch] / dyn->threshold;
+      gain = powf(over, 1.0f / dyn->ratio - 1.0f);
+    }
+    store_sample(buf, dyn->bits, i, x * gain);
+  }
+}
+
+DrcState *drc_create(int sample_rate, int frame_size, int sample_bit,
+                     int ch_num, const DrcConfig *config) {
+  (void)frame_size;
+  DrcState *st = calloc(1, sizeof(*st));
+  if (!st)
+    return NULL;
+  const struct DrcBandConfig *band = &config->band_settings[0];
+  dynamics_init(&st->dyn, sample_rate, sample_bit, ch_num, band->threshold,
+                band->ratio, band->attack_time, band->release_time);
+  return st;
+}
+
+int32_t drc_destroy(DrcState *st) {
+  free(st);
+  return 0;
+}
+
+int32_t drc_set_config(DrcState *st, const DrcConfig *config) {
+  (void)st;
+  (void)config;
+  return 0;
+}
+
+int32_t drc_process(DrcState *st, uint8_t *buf, uint32_t len) {
+  dynamics_run(&st->dyn, buf, len);
+  return 0;
+}
+
+LimiterState *limiter_create(int32_t sample_rate, int32_t frame_size,
+                             int32_t sample_bit, int32_t channel_number,
+                             const LimiterConfig *config) {
+  (void)frame_size;
+  LimiterState *st = calloc(1, sizeof(*st));
+  if (!st)
+    return NULL;
+  dynamics_init(&st->dyn, sample_rate, sample_bit, channel_number,
+                config->threshold, config->ratio, config->attack_time,
+                config->release_time);
+  return st;
+}
+
+int32_t limiter_destroy(LimiterState *st) {
+  free(st);
+  return 0;
+}
+
+int32_t limiter_set_config(LimiterState *st, const LimiterConfig *config) {
+  (void)st;
+  (void)config;
+  return 0;
+}
+
+int32_t limiter_process(LimiterState *st, uint8_t *buf, int32_t len) {
+  dynamics_run(&st->dyn, buf, (uint32_t)len);
+  return 0;
+}
@@ -130,6 +130,102 @@ static void test_limiter_remains_last(void) {
   assert(state.counters.limiter_engaged == 1);
 }
 
+// Frames add up across calls; the deepest reduction is kept.
+static void test_gain_reduction_counters(void) {
+  const char *order[] = {"audiogram_eq", "limiter"};
+  DspChainState state;
+
+  assert(dsp_chain_init(&state, order, 2, 0.0f));
+  assert(state.counters.limiter_gr_frames == 0);
+  dsp_chain_mark_gain_reduction(&state, 10, 1000);
+  dsp_chain_mark_gain_reduction(&state, 5, 400);
+  assert(state.counters.limiter_gr_frames == 15);
+  assert(state.counters.limiter_max_gr_q31 == 1000);
+}
+
+static void test_fixed_gain_ramp_is_sample_accurate(void) {
+  const char *order[] = {"audiogram_eq", "limiter"};
+  DspChainState state;
+  DspChainGainBlock gain;
+  int16_t pcm[2 * 64];
+
+  assert(dsp_chain_init(&state, order, 2, 0.0f));
+  dsp_chain_begin_frame_fixed(&state, 64, &gain);
+  assert(gain.unity);
+
+  dsp_chain_request_ramp(&state, -6.0f, 1);
+  dsp_chain_begin_frame_fixed(&state, 64, &gain);
+  assert(gain.unity);
+  dsp_chain_begin_frame_fixed(&state, 64, &gain);
+  assert(!gain.unity);
+
+  for (size_t i = 0; i < sizeof(pcm) / sizeof(pcm[0]); ++i)
+    pcm[i] = 16384;
+  assert(dsp_chain_apply_gain_fixed(&gain, pcm, 64, 2, 16) == 0);
+  assert(pcm[0] == 16383 || pcm[0] == 16384);
+  for (size_t n = 1; n < 64; ++n) {
+    assert(pcm[2 * n] <= pcm[2 * (n - 1)]);
+    assert(pcm[2 * n] == pcm[2 * n + 1]);
+  }
+  assert(fabsf((float)pcm[2 * 63] - 16384.0f * 0.5012f) < 150.0f);
+
+  // Next block holds the target gain with no further ramp.
+  dsp_chain_begin_frame_fixed(&state, 64, &gain);
+  assert(gain.step_q31 == 0);
+}
+
+static void test_fixed_gain_saturates_24bit(void) {
+  const char *order[] = {"limiter"};
+  DspChainState state;
+  DspChainGainBlock gain;
+  int32_t pcm[4] = {0x7FFFFF, -0x800000, 0x100000, -0x100000};
+
+  assert(dsp_chain_init(&state, order, 1, 0.0f));
+  dsp_chain_request_ramp(&state, 12.0f, 0);
+  dsp_chain_begin_frame_fixed(&state, 2, &gain);
+  dsp_chain_begin_frame_fixed(&state, 2, &gain);
+  assert(gain.shift == 2 && gain.step_q31 == 0);
+  assert(dsp_chain_apply_gain_fixed(&gain, pcm, 2, 2, 24) == 2);
+  assert(pcm[0] == 0x7FFFFF && pcm[1] == -0x800000);
+  assert(pcm[2] > 0x3F0000 && pcm[2] < 0x410000);
+  assert(pcm[3] < -0x3F0000 && pcm[3] > -0x410000);
+}
+
+static void test_log2_table_and_grid_handle(void) {
+  AudiogramProfile profile = make_mixed_point_profile();
+  const size_t bins = sizeof(TARGET_GRID) / sizeof(TARGET_GRID[0]);
+  AudiogramGrid grid;
+  float via_grid[AUDIOGRAM_MAX_TARGET_BINS];
+  float via_freqs[AUDIOGRAM_MAX_TARGET_BINS];
+  double max_err = 0.0;
+
+  for (uint32_t hz = AUDIOGRAM_MIN_FREQ_HZ; hz <= AUDIOGRAM_MAX_FREQ_HZ; ++hz) {
+    double err = fabs((double)audiogram_log2_hz((float)hz) - log2((double)hz));
+    max_err = err > max_err ? err : max_err;
+  }
+  assert(max_err < 1.2e-5);
+
+  assert(audiogram_grid_register(&grid, TARGET_GRID, bins) == 0);
+  assert(audiogram_interpolate_grid(&profile.left, &grid, via_grid) ==
+         (int)bins);
+  assert(audiogram_interpolate_gain(&profile.left, TARGET_GRID, bins,
+                                    via_freqs) == (int)bins);
+  assert(memcmp(via_grid, via_freqs, bins * sizeof(float)) == 0);
+
+  // The compile-time fit grid matches a registered copy of itself.
+  const AudiogramGrid *fit = audiogram_fit_grid();
+  assert(fit->count == bins);
+  assert(audiogram_interpolate_grid(&profile.left, fit, via_grid) ==
+         (int)bins);
+  for (size_t i = 0; i < bins; ++i) {
+    assert(fit->freqs[i] == TARGET_GRID[i]);
+    assert(fabsf(via_grid[i] - via_freqs[i]) < 1e-3f);
+  }
+
+  const float bad[] = {1000.0f, 0.0f};
+  assert(audiogram_grid_register(&grid, bad, 2) == -2);
+}
+
 static void profile_interpolation_speed(void) {
   AudiogramProfile profile = make_mixed_point_profile();
   float gains[sizeof(TARGET_GRID) / sizeof(TARGET_GRID[0])];
@@ -148,6 +244,63 @@ static void profile_interpolation_speed(void) {
   printf("Interpolated %zu iterations in %.3f ms (%.3f us/iter)\n",
          iterations, elapsed_ms, (elapsed_ms * 1000.0) / (double)iterations);
   assert(elapsed_ms < 50.0);
+
+  // Mode switch: both ears onto the pre-registered fit grid.
+  start = clock();
+  for (size_t i = 0; i < iterations; ++i) {
+    assert(audiogram_interpolate_grid(&profile.left, audiogram_fit_grid(),
+                                      gains) > 0);
+    assert(audiogram_interpolate_grid(&profile.right, audiogram_fit_grid(),
+                                      gains) > 0);
+  }
+  end = clock();
+  elapsed_ms = (double)(end - start) * 1000.0 / (double)CLOCKS_PER_SEC;
+  printf("Grid interpolation, both ears: %.3f us/iter\n",
+         (elapsed_ms * 1000.0) / (double)iterations);
+  assert(elapsed_ms < 50.0);
+}
+
+static void test_fit_cache_tracks_single_point_edits(void) {
+  AudiogramProfile profile = make_mixed_point_profile();
+  AudiogramFitCache cache[2];
+  IIR_CFG_T cached, fresh;
+  uint32_t lcg = 7;
+
+  audiogram_fit_cache_reset(&cache[0]);
+  audiogram_fit_cache_reset(&cache[1]);
+  for (int iter = 0; iter < 300; ++iter) {
+    lcg = lcg * 1664525u + 1013904223u;
+    const bool left = (lcg >> 4) & 1;
+    AudiogramEarProfile *ear = left ? &profile.left : &profile.right;
+    const uint8_t idx = (uint8_t)((lcg >> 8) % ear->point_count);
+    if (iter % 5 != 4) // every fifth call resends the same profile
+      ear->thresholds_db_hl[idx] = (int16_t)((lcg >> 16) % 100) - 10;
+
+    assert(audiogram_build_iir_cfg_cached(&cache[left ? 0 : 1], &profile, left,
+                                          &cached) == 0);
+    assert(audiogram_build_iir_cfg(&profile, left, &fresh) == 0);
+    assert(memcmp(&cached, &fresh, sizeof(cached)) == 0);
+  }
+  assert(cache[0].full_fits == 1 && cache[1].full_fits == 1);
+  assert(cache[0].hits + cache[1].hits >= 60);
+  assert(cache[0].partial_fits + cache[1].partial_fits > 200);
+
+  // A frequency change refits the ear; a rejected profile leaves the cache
+  // serving the last good fit.
+  profile.left.frequencies_hz[3] = 800;
+  assert(audiogram_build_iir_cfg_cached(&cache[0], &profile, true, &cached) ==
+         0);
+  assert(audiogram_build_iir_cfg(&profile, true, &fresh) == 0);
+  assert(memcmp(&cached, &fresh, sizeof(cached)) == 0);
+  assert(cache[0].full_fits == 2);
+
+  profile.left.thresholds_db_hl[2] = 500;
+  assert(audiogram_build_iir_cfg_cached(&cache[0], &profile, true, &cached) <
+         0);
+  profile.left.thresholds_db_hl[2] = cache[0].ear.thresholds_db_hl[2];
+  assert(audiogram_build_iir_cfg_cached(&cache[0], &profile, true, &cached) ==
+         0);
+  assert(memcmp(&cached, &fresh, sizeof(cached)) == 0);
 }
 
 int main(void) {
@@ -156,6 +309,11 @@ int main(void) {
   test_excessive_point_budget_rejected();
   test_target_bin_cap();
   test_limiter_remains_last();
+  test_gain_reduction_counters();
+  test_fixed_gain_ramp_is_sample_accurate();
+  test_fixed_gain_saturates_24bit();
+  test_fit_cache_tracks_single_point_edits();
+  test_log2_table_and_grid_handle();
   profile_interpolation_speed();
 
   printf("All audiogram and limiter tests passed.\n");
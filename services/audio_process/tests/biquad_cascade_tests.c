@@ -0,0 +1,383 @@
+#include "audiogram.h"
+#include "biquad_cascade.h"
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_RATE 48000
+#define TEST_FRAMES 4096
+
+// Double-precision DF1 reference for one channel of an IIR_CFG_T.
+typedef struct {
+  BiquadCoefs sec[BIQUAD_CASCADE_MAX_SECTIONS];
+  double z[BIQUAD_CASCADE_MAX_SECTIONS][4];
+  int num;
+} RefCascade;
+
+static void ref_init(RefCascade *ref, const IIR_CFG_T *cfg, int ch) {
+  const float gain_db = ch == 0 ? cfg->gain0 : cfg->gain1;
+  memset(ref, 0, sizeof(*ref));
+  ref->num = cfg->num;
+  for (int i = 0; i < cfg->num; ++i) {
+    assert(biquad_cascade_design(&cfg->param[i], i == 0 ? gain_db : 0.0f,
+                                 TEST_RATE, &ref->sec[i]) == 0);
+  }
+}
+
+static double ref_step(RefCascade *ref, double x) {
+  for (int s = 0; s < ref->num; ++s) {
+    const BiquadCoefs *c = &ref->sec[s];
+    double *z = ref->z[s];
+    double y = c->b0 * x + c->b1 * z[0] + c->b2 * z[1] - c->a1 * z[2] -
+               c->a2 * z[3];
+    z[1] = z[0];
+    z[0] = x;
+    z[3] = z[2];
+    z[2] = y;
+    x = y;
+  }
+  return x;
+}
+
+static int32_t ref_quantize(double v, int bits) {
+  const double hi = bits == 16 ? 32767.0 : 8388607.0;
+  const double lo = bits == 16 ? -32768.0 : -8388608.0;
+  v = floor(v + 0.5);
+  return (int32_t)(v > hi ? hi : v < lo ? lo : v);
+}
+
+// Mild slope: the overlapping peak sections of the fitted cascade stay below
+// +18 dB so a -24 dBFS signal never clips in the reference either.
+static AudiogramProfile make_sloping_profile(void) {
+  AudiogramProfile p = {0};
+  static const uint16_t freqs[] = {250, 500, 1000, 2000, 3000, 4000, 6000,
+                                   8000};
+  p.schema_version = AUDIOGRAM_SCHEMA_VERSION;
+  for (size_t i = 0; i < sizeof(freqs) / sizeof(freqs[0]); ++i) {
+    p.left.frequencies_hz[i] = freqs[i];
+    p.right.frequencies_hz[i] = freqs[i];
+    p.left.thresholds_db_hl[i] = (int16_t)(2 * i);
+    p.right.thresholds_db_hl[i] = (int16_t)(-10 + 3 * i);
+  }
+  p.left.point_count = sizeof(freqs) / sizeof(freqs[0]);
+  p.right.point_count = p.left.point_count;
+  return p;
+}
+
+// Stereo test signal: log sweep on the left, pseudo-random noise on the
+// right, both at -24 dBFS.
+static void make_signal(double *left, double *right, int bits) {
+  const double fs = bits == 16 ? 32767.0 : 8388607.0;
+  const double amp = fs * pow(10.0, -24.0 / 20.0);
+  uint32_t lcg = 12345;
+  double phase = 0.0;
+
+  for (int i = 0; i < TEST_FRAMES; ++i) {
+    double f = 50.0 * pow(12000.0 / 50.0, (double)i / TEST_FRAMES);
+    phase += 2.0 * M_PI * f / TEST_RATE;
+    left[i] = floor(amp * sin(phase) + 0.5);
+    lcg = lcg * 1664525u + 1013904223u;
+    right[i] = floor(amp * ((double)(lcg >> 8) / (double)(1u << 23) - 1.0));
+  }
+}
+
+static int32_t compare_against_reference(const IIR_CFG_T *left_cfg,
+                                         const IIR_CFG_T *right_cfg,
+                                         BiquadForm form, int bits) {
+  static double in[2][TEST_FRAMES];
+  static int32_t pcm32[2 * TEST_FRAMES];
+  static int16_t pcm16[2 * TEST_FRAMES];
+  RefCascade ref[2];
+  BiquadCascade bq;
+  int32_t max_err = 0;
+
+  make_signal(in[0], in[1], bits);
+  for (int i = 0; i < TEST_FRAMES; ++i) {
+    for (int ch = 0; ch < 2; ++ch) {
+      if (bits == 16)
+        pcm16[2 * i + ch] = (int16_t)in[ch][i];
+      else
+        pcm32[2 * i + ch] = (int32_t)in[ch][i];
+    }
+  }
+
+  assert(biquad_cascade_open(&bq, form, TEST_RATE, (uint8_t)bits, 2) == 0);
+  assert(biquad_cascade_set_cfg(&bq, left_cfg, 0) == 0);
+  assert(biquad_cascade_set_cfg(&bq, right_cfg, 1) == 0);
+  ref_init(&ref[0], left_cfg, 0);
+  ref_init(&ref[1], right_cfg, 1);
+
+  // Odd chunk sizes exercise state carry-over across calls and blocks.
+  void *pcm = bits == 16 ? (void *)pcm16 : (void *)pcm32;
+  const uint32_t sample_size = bits == 16 ? 2 : 4;
+  uint32_t done = 0;
+  while (done < TEST_FRAMES) {
+    uint32_t chunk = TEST_FRAMES - done < 173 ? TEST_FRAMES - done : 173;
+    biquad_cascade_run(&bq, (uint8_t *)pcm + 2 * done * sample_size,
+                       2 * chunk);
+    done += chunk;
+  }
+
+  for (int i = 0; i < TEST_FRAMES; ++i) {
+    for (int ch = 0; ch < 2; ++ch) {
+      int32_t want = ref_quantize(ref_step(&ref[ch], in[ch][i]), bits);
+      int32_t got = bits == 16 ? pcm16[2 * i + ch] : pcm32[2 * i + ch];
+      int32_t err = abs(got - want);
+      max_err = err > max_err ? err : max_err;
+    }
+  }
+  return max_err;
+}
+
+static void test_design_identity_and_shelves(void) {
+  IIR_PARAM_T p = {IIR_TYPE_PEAK, 0.0f, 1000.0f, 1.0f};
+  BiquadCoefs c;
+
+  assert(biquad_cascade_design(&p, 0.0f, TEST_RATE, &c) == 0);
+  assert(fabs(c.b0 - 1.0) < 1e-12);
+  assert(fabs(c.b1 - c.a1) < 1e-12 && fabs(c.b2 - c.a2) < 1e-12);
+
+  // Low shelf: DC gain equals the shelf gain.
+  p.type = IIR_TYPE_LOW_SHELF;
+  p.gain = 6.0f;
+  assert(biquad_cascade_design(&p, 0.0f, TEST_RATE, &c) == 0);
+  double dc = (c.b0 + c.b1 + c.b2) / (1.0 + c.a1 + c.a2);
+  assert(fabs(20.0 * log10(dc) - 6.0) < 1e-6);
+
+  p.fc = TEST_RATE;
+  assert(biquad_cascade_design(&p, 0.0f, TEST_RATE, &c) < 0);
+}
+
+static void test_audiogram_cfg_matches_double_model(void) {
+  AudiogramProfile profile = make_sloping_profile();
+  IIR_CFG_T left = {0}, right = {0};
+
+  assert(audiogram_build_iir_cfg(&profile, true, &left) == 0);
+  assert(audiogram_build_iir_cfg(&profile, false, &right) == 0);
+  right.gain1 = -3.0f;
+
+  int32_t q16 = compare_against_reference(&left, &right, BIQUAD_FORM_DF1_Q31,
+                                          16);
+  int32_t q24 = compare_against_reference(&left, &right, BIQUAD_FORM_DF1_Q31,
+                                          24);
+  int32_t f16 = compare_against_reference(&left, &right, BIQUAD_FORM_TDF2_F32,
+                                          16);
+  int32_t f24 = compare_against_reference(&left, &right, BIQUAD_FORM_TDF2_F32,
+                                          24);
+  printf("Max LSB error vs double model: df1_q31 16b=%d 24b=%d, "
+         "tdf2_f32 16b=%d 24b=%d\n",
+         q16, q24, f16, f24);
+  // 16-bit output only differs by output rounding; at 24 bits the residual is
+  // coefficient quantisation, still more than 100 dB below full scale.
+  assert(q16 <= 1);
+  assert(q24 <= 32);
+  assert(f16 <= 1);
+  assert(f24 <= 64);
+}
+
+static void test_gain_only_and_bypass(void) {
+  IIR_CFG_T cfg = {0};
+  BiquadCascade bq;
+  int16_t pcm[4] = {1000, 1000, -2000, -2000};
+
+  cfg.gain0 = -6.0206f;
+  assert(biquad_cascade_open(&bq, BIQUAD_FORM_DF1_Q31, TEST_RATE, 16, 2) == 0);
+  assert(biquad_cascade_set_cfg(&bq, &cfg, -1) == 0);
+  assert(bq.coefs.num[0] == 1 && bq.coefs.num[1] == 0);
+  biquad_cascade_run(&bq, pcm, 4);
+  assert(pcm[0] == 500 && pcm[2] == -1000);
+  assert(pcm[1] == 1000 && pcm[3] == -2000);
+}
+
+static void test_bank_hands_over_newest_set(void) {
+  BiquadCoefBank bank;
+  IIR_CFG_T cfg = {0};
+  const BiquadCascadeCoefs *got;
+
+  biquad_bank_init(&bank, BIQUAD_FORM_DF1_Q31);
+  assert(biquad_bank_acquire(&bank) == NULL);
+
+  cfg.num = 1;
+  cfg.param[0] = (IIR_PARAM_T){IIR_TYPE_PEAK, 3.0f, 1000.0f, 1.0f};
+  assert(biquad_cascade_build(biquad_bank_edit(&bank), BIQUAD_FORM_DF1_Q31,
+                              TEST_RATE, &cfg, 0) == 0);
+  biquad_bank_publish(&bank);
+  got = biquad_bank_acquire(&bank);
+  assert(got && got->num[0] == 1 && got->num[1] == 0);
+  assert(biquad_bank_acquire(&bank) == NULL);
+
+  // The edit slot starts from the last published set; only the newest of
+  // several publishes is handed over.
+  assert(biquad_bank_edit(&bank)->num[0] == 1);
+  cfg.num = 2;
+  cfg.param[1] = (IIR_PARAM_T){IIR_TYPE_PEAK, -3.0f, 4000.0f, 1.0f};
+  assert(biquad_cascade_build(biquad_bank_edit(&bank), BIQUAD_FORM_DF1_Q31,
+                              TEST_RATE, &cfg, 1) == 0);
+  biquad_bank_publish(&bank);
+  cfg.num = 3;
+  cfg.param[2] = (IIR_PARAM_T){IIR_TYPE_HIGH_SHELF, 2.0f, 8000.0f, 0.7f};
+  assert(biquad_cascade_build(biquad_bank_edit(&bank), BIQUAD_FORM_DF1_Q31,
+                              TEST_RATE, &cfg, 1) == 0);
+  biquad_bank_publish(&bank);
+  got = biquad_bank_acquire(&bank);
+  assert(got && got->num[0] == 1 && got->num[1] == 3);
+
+  // A failed build is rolled back before the next publish.
+  cfg.param[0].fc = TEST_RATE;
+  assert(biquad_cascade_build(biquad_bank_edit(&bank), BIQUAD_FORM_DF1_Q31,
+                              TEST_RATE, &cfg, 0) < 0);
+  biquad_bank_discard(&bank);
+  biquad_bank_publish(&bank);
+  got = biquad_bank_acquire(&bank);
+  assert(got && got->num[0] == 1 && got->num[1] == 3);
+}
+
+static void build_peaks(BiquadCoefBank *bank, int num, float gain_db) {
+  IIR_CFG_T cfg = {0};
+
+  cfg.num = num;
+  for (int i = 0; i < num; ++i)
+    cfg.param[i] =
+        (IIR_PARAM_T){IIR_TYPE_PEAK, gain_db, 500.0f * (i + 1), 1.0f};
+  assert(biquad_cascade_build(biquad_bank_edit(bank), BIQUAD_FORM_DF1_Q31,
+                              TEST_RATE, &cfg, 0) == 0);
+  biquad_bank_publish(bank);
+}
+
+// acquire hands the slot the cascade is running from back to the writer.
+// Two publishes before the swap land in that slot; the outgoing set must
+// not change under the crossfade.
+static void test_bank_publish_between_acquire_and_swap(void) {
+  static BiquadCoefBank bank, quiet_bank;
+  static BiquadCascade bq, quiet;
+  static int16_t pcm[1024], ref[1024];
+  BiquadCascadeCoefs outgoing;
+  const BiquadCascadeCoefs *coefs;
+
+  for (int k = 0; k < 2; ++k) {
+    BiquadCoefBank *b = k ? &quiet_bank : &bank;
+    BiquadCascade *c = k ? &quiet : &bq;
+
+    biquad_bank_init(b, BIQUAD_FORM_DF1_Q31);
+    assert(biquad_cascade_open(c, BIQUAD_FORM_DF1_Q31, TEST_RATE, 16, 1) ==
+           0);
+    build_peaks(b, 1, 6.0f);
+    biquad_cascade_detach(c);
+    assert(biquad_cascade_swap(c, biquad_bank_acquire(b), 0) == 0);
+    build_peaks(b, 2, -6.0f);
+  }
+  memcpy(&outgoing, bq.active, sizeof(outgoing));
+  for (int i = 0; i < 1024; ++i)
+    pcm[i] = ref[i] = (int16_t)(4000.0 * sin(2.0 * M_PI * 700.0 * i /
+                                             TEST_RATE));
+
+  biquad_cascade_detach(&bq);
+  coefs = biquad_bank_acquire(&bank);
+  assert(coefs && coefs->num[0] == 2);
+  build_peaks(&bank, 4, 9.0f);
+  build_peaks(&bank, 3, -9.0f);
+  assert(biquad_cascade_swap(&bq, coefs, 480) == 0);
+  assert(memcmp(&bq.fade_coefs, &outgoing, sizeof(outgoing)) == 0);
+
+  biquad_cascade_detach(&quiet);
+  assert(biquad_cascade_swap(&quiet, biquad_bank_acquire(&quiet_bank), 480) ==
+         0);
+  biquad_cascade_run(&bq, pcm, 1024);
+  biquad_cascade_run(&quiet, ref, 1024);
+  assert(memcmp(pcm, ref, sizeof(pcm)) == 0);
+
+  // The newer of the two publishes is handed over next.
+  biquad_cascade_detach(&bq);
+  coefs = biquad_bank_acquire(&bank);
+  assert(coefs && coefs->num[0] == 3);
+}
+
+// Largest second difference (curvature) of a 1 kHz tone across a live switch
+// from a flat EQ to +12 dB of channel gain. A clean tone of amplitude A has
+// at most A * (2 pi 1000 / 48000)^2, so clicks stand out.
+static int32_t run_live_switch(BiquadForm form, uint32_t fade, int16_t *out) {
+  const uint32_t frames = 2048, frame = 256, switch_at = 1024;
+  BiquadCoefBank bank;
+  BiquadCascade bq;
+  IIR_CFG_T flat = {0}, boost = {0};
+  int32_t max_curv = 0;
+
+  flat.num = 1;
+  flat.param[0] = (IIR_PARAM_T){IIR_TYPE_PEAK, 0.0f, 1000.0f, 1.0f};
+  boost = flat;
+  boost.gain0 = 12.0f;
+
+  biquad_bank_init(&bank, form);
+  assert(biquad_cascade_open(&bq, form, TEST_RATE, 16, 1) == 0);
+  assert(biquad_cascade_build(biquad_bank_edit(&bank), form, TEST_RATE, &flat,
+                              0) == 0);
+  biquad_bank_publish(&bank);
+
+  for (uint32_t i = 0; i < frames; ++i)
+    out[i] = (int16_t)(4000.0 * sin(2.0 * M_PI * 1000.0 * i / TEST_RATE));
+  for (uint32_t f = 0; f < frames; f += frame) {
+    if (f == switch_at) {
+      assert(biquad_cascade_build(biquad_bank_edit(&bank), form, TEST_RATE,
+                                  &boost, 0) == 0);
+      biquad_bank_publish(&bank);
+    }
+    // Frame boundary, as in audio_process_run().
+    if (!biquad_cascade_fading(&bq)) {
+      const BiquadCascadeCoefs *coefs;
+
+      biquad_cascade_detach(&bq);
+      coefs = biquad_bank_acquire(&bank);
+      if (coefs)
+        assert(biquad_cascade_swap(&bq, coefs, f ? fade : 0) == 0);
+    }
+    biquad_cascade_run(&bq, out + f, frame);
+  }
+  for (uint32_t i = switch_at - frame; i < frames; ++i) {
+    int32_t curv = abs(out[i] - 2 * out[i - 1] + out[i - 2]);
+    max_curv = curv > max_curv ? curv : max_curv;
+  }
+  return max_curv;
+}
+
+static void test_live_switch_crossfade(void) {
+  static int16_t hard[2048], soft[2048];
+  static const BiquadForm forms[] = {BIQUAD_FORM_DF1_Q31,
+                                     BIQUAD_FORM_TDF2_F32};
+
+  for (size_t k = 0; k < sizeof(forms) / sizeof(forms[0]); ++k) {
+    int32_t hard_curv = run_live_switch(forms[k], 0, hard);
+    int32_t soft_curv = run_live_switch(forms[k], 480, soft);
+    printf("Live EQ switch (%s): max curvature %d hard, %d with 480-frame "
+           "fade\n",
+           forms[k] == BIQUAD_FORM_DF1_Q31 ? "df1_q31" : "tdf2_f32",
+           hard_curv, soft_curv);
+    // 4 x 4000 x (2 pi / 48)^2 = 274 for the boosted tone itself.
+    assert(soft_curv <= 300);
+    // TDF2 state is coefficient dependent, so a hard swap clicks; DF1 only
+    // holds past inputs/outputs and rings in without the fade too.
+    if (forms[k] == BIQUAD_FORM_TDF2_F32)
+      assert(hard_curv > 4 * soft_curv);
+    // Once the fade is over, both runs are on the same new-filter trajectory.
+    for (uint32_t i = 1024 + 512; i < 2048; ++i)
+      assert(hard[i] == soft[i]);
+  }
+}
+
+int main(void) {
+  test_design_identity_and_shelves();
+  test_audiogram_cfg_matches_double_model();
+  test_gain_only_and_bypass();
+  test_bank_hands_over_newest_set();
+  test_bank_publish_between_acquire_and_swap();
+  test_live_switch_crossfade();
+
+  printf("All biquad cascade tests passed.\n");
+  return 0;
+}
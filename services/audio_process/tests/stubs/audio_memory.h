@@ -0,0 +1,22 @@
+#ifndef AUDIO_MEMORY_H
+#define AUDIO_MEMORY_H
+
+// Host stand-in for audio/process/common/include/audio_memory.h. The device
+// header defines the audio heap inline on top of multi_heap; the host build
+// only needs the declarations, implemented in audio_process_stubs.c.
+
+#include "heap_api.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void audio_heap_init(void *begin_addr, size_t size);
+void audio_memory_info(size_t *total, size_t *used, size_t *max_used);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
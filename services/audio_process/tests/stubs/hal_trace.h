@@ -0,0 +1,36 @@
+#ifndef __HAL_TRACE_H__
+#define __HAL_TRACE_H__
+
+// Host stand-in for platform/hal/hal_trace.h. Traces compile to nothing but
+// still consume their arguments; ASSERT prints the message and aborts.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline void hal_trace_dummy(const char *fmt, ...) { (void)fmt; }
+
+#define TRACE(attr, str, ...) hal_trace_dummy(str, ##__VA_ARGS__)
+#define TRACE_IMM(attr, str, ...) hal_trace_dummy(str, ##__VA_ARGS__)
+#define TRACE_NOCRLF(attr, str, ...) hal_trace_dummy(str, ##__VA_ARGS__)
+#define TRACE_DUMMY(attr, str, ...) hal_trace_dummy(str, ##__VA_ARGS__)
+#define FUNC_ENTRY_TRACE() hal_trace_dummy(__func__)
+#define TRACE_FLUSH() hal_trace_dummy(NULL)
+
+#define ASSERT(cond, str, ...)                                                 \
+  {                                                                            \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "ASSERT %s:%d: " str "\n", __FILE__, __LINE__,          \
+              ##__VA_ARGS__);                                                  \
+      abort();                                                                 \
+    }                                                                          \
+  }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HAL_TRACE_H__
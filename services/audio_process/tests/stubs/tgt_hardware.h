@@ -0,0 +1,16 @@
+#ifndef __TGT_HARDWARE__
+#define __TGT_HARDWARE__
+
+// Host stand-in for config/<target>/tgt_hardware.h.
+
+#include "hal_aud.h"
+
+#define EQ_HW_DAC_IIR_LIST_NUM 1
+#define EQ_HW_IIR_LIST_NUM 1
+#define EQ_SW_IIR_LIST_NUM 1
+#define EQ_HW_FIR_LIST_NUM 3
+
+#define CFG_HW_AUD_OUTPUT_PATH_SPEAKER_DEV                                     \
+  (AUD_CHANNEL_MAP_CH0 | AUD_CHANNEL_MAP_CH1)
+
+#endif // __TGT_HARDWARE__
@@ -104,8 +104,6 @@ extern void tws_playback_ticks_check_for_mix_prompt(void);
 #endif
 #define AF_CODEC_FADE_MIN_SAMPLE_CNT 200
 
-#define PP_PINGPANG(v) (v == PP_PING ? PP_PANG : PP_PING)
-
 #ifdef AUDIO_ANC_FB_ADJ_MC
 #define AF_STACK_SIZE (1024 * 10)
 #else
@@ -118,16 +116,18 @@ extern void tws_playback_ticks_check_for_mix_prompt(void);
 #define DYNAMIC_AUDIO_BUFFER_COUNT
 #endif
 
+// The DMA buffer is a ring of periods, each made of one or more
+// descriptors, with an interrupt at the end of every period.
 #ifdef DYNAMIC_AUDIO_BUFFER_COUNT
 #define MAX_AUDIO_BUFFER_COUNT 16
 #define MIN_AUDIO_BUFFER_COUNT 2
-#define AUDIO_BUFFER_COUNT (role->dma_desc_cnt)
 #else
-#define MAX_AUDIO_BUFFER_COUNT 4
-#define AUDIO_BUFFER_COUNT MAX_AUDIO_BUFFER_COUNT
-#if (AUDIO_BUFFER_COUNT & 0x1)
-#error "AUDIO_BUFFER_COUNT must be an even number"
+#define MAX_AUDIO_BUFFER_COUNT AF_STREAM_MAX_PERIODS
+#define MIN_AUDIO_BUFFER_COUNT 4
 #endif
+#define AUDIO_BUFFER_COUNT (role->dma_desc_cnt)
+#if (MAX_AUDIO_BUFFER_COUNT < AF_STREAM_MAX_PERIODS)
+#error "MAX_AUDIO_BUFFER_COUNT must hold AF_STREAM_MAX_PERIODS descriptors"
 #endif
 
 /* internal use */
@@ -156,8 +156,9 @@ enum AF_STATUS_T {
 };
 
 struct af_stream_ctl_t {
-  enum AF_PP_T pp_index; // pingpong operate
-  uint8_t pp_cnt;        // use to count the lost signals
+  uint8_t pp_index; // period the DMA is in
+  uint8_t pp_cnt;   // use to count the lost signals
+  uint8_t wr_index; // next period for the handler
   uint8_t status;        // status machine
   enum AUD_STREAM_USE_DEVICE_T use_device;
 };
@@ -174,9 +175,10 @@ struct af_stream_cfg_t {
   struct AF_STREAM_CONFIG_T cfg;
 
   // dma cfg parameters
-#ifdef DYNAMIC_AUDIO_BUFFER_COUNT
   uint8_t dma_desc_cnt;
-#endif
+  uint8_t periods;
+  // Periods playback keeps filled ahead of the one being played
+  uint8_t write_ahead;
   struct HAL_DMA_DESC_T dma_desc[MAX_AUDIO_BUFFER_COUNT];
   struct HAL_DMA_CH_CFG_T dma_cfg;
 
@@ -194,20 +196,22 @@ volatile static float saved_output_coef;
 #ifdef AUDIO_OUTPUT_SW_LIMITER
 static FloatLimiterPtr FloatLimiterP;
 #else
-typedef struct {
-  float coefs_b[3];
-  float coefs_a[3];
-  float history_x[2];
-  float history_y[2];
-} SW_GAIN_IIR_T;
-SW_GAIN_IIR_T sw_gain_iir = {
-    .coefs_b = {0.00000042780818597736f, 0.00000085561637195472f,
-                0.00000042780818597736f},
-    .coefs_a = {1.00000000000000000000f, -1.99738371810092970000f,
-                0.99738542933367369000f},
-    .history_x = {0, 0},
-    .history_y = {0, 0},
-};
+// The volume is smoothed by a critically damped pair of poles at
+// AF_SW_GAIN_POLE per sample, so the gain |n| samples on is known in closed
+// form and only needs working out once per block of AF_SW_GAIN_BLOCK frames.
+#define AF_SW_GAIN_BLOCK 32
+#define AF_SW_GAIN_POLE 0.9986918591f
+// AF_SW_GAIN_POLE to the power AF_SW_GAIN_BLOCK and AF_SW_GAIN_BLOCK - 1
+#define AF_SW_GAIN_POLE_BLOCK 0.9589772625f
+#define AF_SW_GAIN_POLE_BLOCK_1 0.9602333831f
+// Closer than this to the volume, the gain is taken as settled
+#define AF_SW_GAIN_SETTLED 0.00001f
+
+// The volume being smoothed towards, and the distance of the gain from it at
+// the last sample and the one before. Kept as distances so that the gain
+// still converges once they are far below the resolution of the volume.
+static float sw_gain_target;
+static float sw_gain_dist[2];
 #endif
 #endif
 
@@ -499,73 +503,124 @@ static void af_codec_output_gain_changed(float coef) {
   saved_output_coef = coef;
 }
 #ifndef AUDIO_OUTPUT_SW_LIMITER
-static float af_codec_sw_gain_filter(float gain_in) {
-  float gain_out = saved_output_coef * sw_gain_iir.coefs_b[0] +
-                   sw_gain_iir.history_x[0] * sw_gain_iir.coefs_b[1] +
-                   sw_gain_iir.history_x[1] * sw_gain_iir.coefs_b[2] -
-                   sw_gain_iir.history_y[0] * sw_gain_iir.coefs_a[1] -
-                   sw_gain_iir.history_y[1] * sw_gain_iir.coefs_a[2];
+// Moves the smoothed gain |frames| samples on, |frames| <= AF_SW_GAIN_BLOCK.
+// With d the distance and e = d[n] - pole * d[n-1],
+// d[n+k] = pole^k * (d[n] + k * e).
+static void af_codec_sw_gain_step(uint32_t frames) {
+  float d, e;
+  float pole_n, pole_n1;
+  uint32_t i;
 
-  sw_gain_iir.history_y[1] = sw_gain_iir.history_y[0];
-  sw_gain_iir.history_y[0] = gain_out;
-  sw_gain_iir.history_x[1] = sw_gain_iir.history_x[0];
-  sw_gain_iir.history_x[0] = saved_output_coef;
+  if (frames == AF_SW_GAIN_BLOCK) {
+    pole_n = AF_SW_GAIN_POLE_BLOCK;
+    pole_n1 = AF_SW_GAIN_POLE_BLOCK_1;
+  } else {
+    pole_n1 = 1.0f;
+    for (i = 1; i < frames; i++) {
+      pole_n1 *= AF_SW_GAIN_POLE;
+    }
+    pole_n = pole_n1 * AF_SW_GAIN_POLE;
+  }
 
-  return gain_out;
+  d = sw_gain_dist[0];
+  e = d - AF_SW_GAIN_POLE * sw_gain_dist[1];
+  sw_gain_dist[1] = pole_n1 * (d + (frames - 1) * e);
+  sw_gain_dist[0] = pole_n * (d + frames * e);
 }
-static void af_codec_sw_gain_process(uint8_t *buf, uint32_t size,
-                                     enum AUD_BITS_T bits,
-                                     enum AUD_CHANNEL_NUM_T chans) {
-  uint32_t i, pcm_len;
-  int32_t pcm_out;
-  float output_gain = 1.0f;
 
-  // TRACE(1,"af_codec_sw_gain_process:%d",(int32_t)(saved_output_coef*1000));
+static void af_codec_sw_gain_apply(uint8_t *buf, uint32_t samples,
+                                   enum AUD_BITS_T bits, float gain) {
+  uint32_t i;
+  int32_t pcm_out;
 
-  if (chans == AUD_CHANNEL_NUM_1) {
-    if (bits <= AUD_BITS_16) {
-      pcm_len = size / sizeof(int16_t);
-      int16_t *pcm_buf = (int16_t *)buf;
-      for (i = 0; i < pcm_len; i++) {
-        output_gain = af_codec_sw_gain_filter(saved_output_coef);
+  if (bits <= AUD_BITS_16) {
+    int16_t *pcm_buf = (int16_t *)buf;
+    for (i = 0; i < samples; i++) {
+      pcm_out = (int32_t)(pcm_buf[i] * gain);
+      pcm_buf[i] = __SSAT(pcm_out, 16);
+    }
+  } else {
+    int32_t *pcm_buf = (int32_t *)buf;
+    for (i = 0; i < samples; i++) {
+      pcm_out = (int32_t)(pcm_buf[i] * gain);
+      pcm_buf[i] = __SSAT(pcm_out, 24);
+    }
+  }
+}
 
-        pcm_out = (int32_t)(pcm_buf[i] * output_gain);
-        pcm_buf[i] = __SSAT(pcm_out, 16);
-      }
-    } else {
-      pcm_len = size / sizeof(int32_t);
-      int32_t *pcm_buf = (int32_t *)buf;
-      for (i = 0; i < pcm_len; i++) {
-        output_gain = af_codec_sw_gain_filter(saved_output_coef);
+// |gain| + |step| on the first frame, rising by |step| every frame
+static void af_codec_sw_gain_ramp(uint8_t *buf, uint32_t frames,
+                                  enum AUD_BITS_T bits,
+                                  enum AUD_CHANNEL_NUM_T chans, float gain,
+                                  float step) {
+  uint32_t i, ch;
+  int32_t pcm_out;
 
-        pcm_out = (int32_t)(pcm_buf[i] * output_gain);
-        pcm_buf[i] = __SSAT(pcm_out, 24);
+  if (bits <= AUD_BITS_16) {
+    int16_t *pcm_buf = (int16_t *)buf;
+    for (i = 0; i < frames; i++) {
+      gain += step;
+      for (ch = 0; ch < chans; ch++) {
+        pcm_out = (int32_t)(pcm_buf[ch] * gain);
+        pcm_buf[ch] = __SSAT(pcm_out, 16);
       }
+      pcm_buf += chans;
     }
-  } else if (chans == AUD_CHANNEL_NUM_2) {
-    if (bits <= AUD_BITS_16) {
-      pcm_len = size / sizeof(int16_t);
-      int16_t *pcm_buf = (int16_t *)buf;
-      for (i = 0; i < pcm_len; i = i + 2) {
-        output_gain = af_codec_sw_gain_filter(saved_output_coef);
-
-        pcm_out = (int32_t)(pcm_buf[i] * output_gain);
-        pcm_buf[i] = __SSAT(pcm_out, 16);
-        pcm_out = (int32_t)(pcm_buf[i + 1] * output_gain);
-        pcm_buf[i + 1] = __SSAT(pcm_out, 16);
+  } else {
+    int32_t *pcm_buf = (int32_t *)buf;
+    for (i = 0; i < frames; i++) {
+      gain += step;
+      for (ch = 0; ch < chans; ch++) {
+        pcm_out = (int32_t)(pcm_buf[ch] * gain);
+        pcm_buf[ch] = __SSAT(pcm_out, 24);
       }
-    } else {
-      pcm_len = size / sizeof(int32_t);
-      int32_t *pcm_buf = (int32_t *)buf;
-      for (i = 0; i < pcm_len; i = i + 2) {
-        output_gain = af_codec_sw_gain_filter(saved_output_coef);
-
-        pcm_out = (int32_t)(pcm_buf[i] * output_gain);
-        pcm_buf[i] = __SSAT(pcm_out, 24);
-        pcm_out = (int32_t)(pcm_buf[i + 1] * output_gain);
-        pcm_buf[i + 1] = __SSAT(pcm_out, 24);
+      pcm_buf += chans;
+    }
+  }
+}
+
+static void af_codec_sw_gain_process(uint8_t *buf, uint32_t size,
+                                     enum AUD_BITS_T bits,
+                                     enum AUD_CHANNEL_NUM_T chans) {
+  uint32_t frames, n;
+  uint32_t samp_size;
+  float target;
+  float gain;
+
+  if (chans != AUD_CHANNEL_NUM_1 && chans != AUD_CHANNEL_NUM_2) {
+    return;
+  }
+
+  samp_size = (bits <= AUD_BITS_16) ? sizeof(int16_t) : sizeof(int32_t);
+  frames = size / samp_size / chans;
+  target = saved_output_coef;
+  if (target != sw_gain_target) {
+    sw_gain_dist[0] += sw_gain_target - target;
+    sw_gain_dist[1] += sw_gain_target - target;
+    sw_gain_target = target;
+  }
+
+  while (frames) {
+    if (ABS(sw_gain_dist[0]) < AF_SW_GAIN_SETTLED &&
+        ABS(sw_gain_dist[1]) < AF_SW_GAIN_SETTLED) {
+      // Settled: a plain multiply, or nothing at all at unity
+      sw_gain_dist[0] = 0.0f;
+      sw_gain_dist[1] = 0.0f;
+      if (target != 1.0f) {
+        af_codec_sw_gain_apply(buf, frames * chans, bits, target);
       }
+      return;
     }
+
+    // Still moving: step the gain once per block and interpolate inside it
+    n = MIN(frames, AF_SW_GAIN_BLOCK);
+    gain = sw_gain_dist[0];
+    af_codec_sw_gain_step(n);
+    af_codec_sw_gain_ramp(buf, n, bits, chans, target + gain,
+                          (sw_gain_dist[0] - gain) / n);
+
+    buf += n * chans * samp_size;
+    frames -= n;
   }
 }
 #endif
@@ -816,6 +871,19 @@ static void af_codec_playback_post_handler(uint8_t *buf, uint32_t len,
 #endif
 }
 
+// Starts the handler on the period after the first one the DMA plays or
+// fills; playback leaves write_ahead periods of the initial buffer to play.
+static void af_stream_reset_ring(struct af_stream_cfg_t *role,
+                                 enum AUD_STREAM_T stream) {
+  role->ctl.pp_index = 0;
+  role->ctl.pp_cnt = 0;
+  if (stream == AUD_STREAM_PLAYBACK) {
+    role->ctl.wr_index = (1 + role->write_ahead) % role->periods;
+  } else {
+    role->ctl.wr_index = 0;
+  }
+}
+
 static inline void af_thread_stream_handler(enum AUD_STREAM_ID_T id,
                                             enum AUD_STREAM_T stream) {
   uint32_t lock;
@@ -826,7 +894,11 @@ static inline void af_thread_stream_handler(enum AUD_STREAM_ID_T id,
   uint32_t pp_cnt;
   bool codec_playback;
   bool skip_handler;
-  enum AF_PP_T pp_index;
+  uint32_t periods;
+  uint32_t period;
+  uint32_t period_step;
+  uint32_t dist;
+  uint32_t cnt;
 
   role = af_get_stream_role(id, stream);
 
@@ -838,15 +910,10 @@ static inline void af_thread_stream_handler(enum AUD_STREAM_ID_T id,
     role->ctl.pp_cnt = 0;
     int_unlock(lock);
 
-    af_sig_lost_cnt[id][stream] = pp_cnt - 1;
-    if (af_sig_lost_cnt[id][stream]) {
-      TRACE(3, "af_thread:WARNING: id=%d stream=%d lost %u signals", id, stream,
-            af_sig_lost_cnt[id][stream]);
-    }
+    periods = role->periods;
+    period = role->ctl.pp_index;
 
-    pp_index = PP_PINGPANG(role->ctl.pp_index);
-
-    // Get PP index from accurate DMA pos
+    // Get the period from accurate DMA pos
     dma_addr = af_stream_get_cur_dma_addr(id, stream);
     hw_pos = dma_addr - (uint32_t)role->dma_buf_ptr;
     if (hw_pos > role->dma_buf_size) {
@@ -860,34 +927,48 @@ static inline void af_thread_stream_handler(enum AUD_STREAM_ID_T id,
       uint32_t chan_size;
 
       chan_size = role->dma_buf_size / role->cfg.channel_num;
+      period_step = chan_size / periods;
 
       if (hw_pos <= role->dma_buf_size) {
-        hw_pos = hw_pos % chan_size;
-        if (hw_pos < chan_size / 2) {
-          pp_index = PP_PANG;
-        } else if (hw_pos < chan_size) {
-          pp_index = PP_PING;
-        }
-      }
-      if (pp_index == PP_PING) {
-        buf = role->dma_buf_ptr;
-      } else {
-        buf = role->dma_buf_ptr + chan_size / 2;
+        period = (hw_pos % chan_size) / period_step;
       }
     } else
 #endif
     {
-      if (hw_pos < role->dma_buf_size / 2) {
-        pp_index = PP_PANG;
-      } else if (hw_pos < role->dma_buf_size) {
-        pp_index = PP_PING;
+      period_step = role->dma_buf_size / periods;
+
+      if (hw_pos < role->dma_buf_size) {
+        period = hw_pos / period_step;
       }
-      if (pp_index == PP_PING) {
-        buf = role->dma_buf_ptr;
+    }
+
+    if (stream == AUD_STREAM_PLAYBACK) {
+      // Fill the periods up to write_ahead past the one being played
+      dist = (role->ctl.wr_index + periods - period) % periods;
+      if (dist >= 1 && dist <= role->write_ahead) {
+        cnt = role->write_ahead + 1 - dist;
+      } else {
+        role->ctl.wr_index = (period + 1) % periods;
+        cnt = role->write_ahead;
+      }
+    } else {
+      // Hand over the periods the DMA has filled, the oldest first
+      if (pp_cnt < periods) {
+        cnt = (period + periods - role->ctl.wr_index) % periods;
       } else {
-        buf = role->dma_buf_ptr + role->dma_buf_size / 2;
+        role->ctl.wr_index = (period + 1) % periods;
+        cnt = periods - 1;
       }
     }
+    if (pp_cnt == 0) {
+      cnt = 0;
+    }
+
+    af_sig_lost_cnt[id][stream] = (pp_cnt > cnt) ? (pp_cnt - cnt) : 0;
+    if (af_sig_lost_cnt[id][stream]) {
+      TRACE(3, "af_thread:WARNING: id=%d stream=%d lost %u signals", id, stream,
+            af_sig_lost_cnt[id][stream]);
+    }
 
     if (stream == AUD_STREAM_PLAYBACK &&
         role->ctl.use_device == AUD_STREAM_USE_INT_CODEC) {
@@ -896,31 +977,38 @@ static inline void af_thread_stream_handler(enum AUD_STREAM_ID_T id,
       codec_playback = false;
     }
 
-    skip_handler = false;
-    len = role->dma_buf_size / 2;
+    len = role->dma_buf_size / periods;
 
-    if (codec_playback) {
-      skip_handler = af_codec_playback_pre_handler(buf, len, role);
-    }
+    for (; cnt > 0; cnt--) {
+      buf = role->dma_buf_ptr + period_step * role->ctl.wr_index;
+      if (++role->ctl.wr_index >= periods) {
+        role->ctl.wr_index = 0;
+      }
 
-    if (!skip_handler) {
-#ifdef __RAND_FROM_MIC__
-      if ((AUD_STREAM_CAPTURE == stream) &&
-          (AUD_STREAM_USE_INT_CODEC == role->cfg.device)) {
-        random_data_process(buf, role->dma_buf_size / 2, role->cfg.bits,
-                            role->cfg.channel_num);
+      skip_handler = false;
+
+      if (codec_playback) {
+        skip_handler = af_codec_playback_pre_handler(buf, len, role);
       }
+
+      if (!skip_handler) {
+#ifdef __RAND_FROM_MIC__
+        if ((AUD_STREAM_CAPTURE == stream) &&
+            (AUD_STREAM_USE_INT_CODEC == role->cfg.device)) {
+          random_data_process(buf, len, role->cfg.bits, role->cfg.channel_num);
+        }
 #endif
-      role->handler(buf, len);
-    }
+        role->handler(buf, len);
+      }
 
-    if (codec_playback) {
-      af_codec_playback_post_handler(buf, len, role);
-    }
+      if (codec_playback) {
+        af_codec_playback_post_handler(buf, len, role);
+      }
 
 #if defined(RTOS) && defined(AF_STREAM_ID_0_PLAYBACK_FADEOUT)
-    af_stream_stop_process(role, buf, len);
+      af_stream_stop_process(role, buf, len);
 #endif
+    }
 
     if (role->ctl.pp_cnt) {
       TRACE(3,
@@ -1031,7 +1119,9 @@ static void af_dma_irq_handler(uint8_t ch, uint32_t remain_dst_tsize,
                                 (enum AUD_STREAM_T)stream);
 
       if (role->dma_cfg.ch == ch) {
-        role->ctl.pp_index = PP_PINGPANG(role->ctl.pp_index);
+        if (++role->ctl.pp_index >= role->periods) {
+          role->ctl.pp_index = 0;
+        }
         role->ctl.pp_cnt++;
         // TRACE(4,"[%s] id = %d, stream = %d, ch = %d", __func__, id, stream,
         // ch); TRACE(2,"[%s] PLAYBACK pp_cnt = %d", __func__,
@@ -1143,7 +1233,9 @@ uint32_t af_open(void) {
       if (role->ctl.status == AF_STATUS_NULL) {
         role->dma_buf_ptr = NULL;
         role->dma_buf_size = 0;
-        role->ctl.pp_index = PP_PING;
+        role->ctl.pp_index = 0;
+        role->periods = AF_STREAM_MIN_PERIODS;
+        role->write_ahead = AF_STREAM_MIN_PERIODS - 1;
         role->ctl.status = AF_STATUS_OPEN_CLOSE;
         role->ctl.use_device = AUD_STREAM_USE_DEVICE_NULL;
         role->dma_cfg.ch = HAL_DMA_CHAN_NONE;
@@ -1166,6 +1258,88 @@ uint32_t af_open(void) {
   return AF_RES_SUCCESS;
 }
 
+static uint8_t af_stream_samp_size(const struct AF_STREAM_CONFIG_T *cfg) {
+  if (cfg->bits == AUD_BITS_24 || cfg->bits == AUD_BITS_32) {
+    return 4;
+  } else if (cfg->bits == AUD_BITS_16) {
+    return 2;
+  }
+  return 1;
+}
+
+// Every period takes the same number of descriptors
+static uint32_t af_stream_dma_desc_cnt(const struct af_stream_cfg_t *role,
+                                       const struct AF_STREAM_CONFIG_T *cfg) {
+  uint32_t desc_cnt;
+
+#ifdef DYNAMIC_AUDIO_BUFFER_COUNT
+  desc_cnt = (cfg->data_size / af_stream_samp_size(cfg) +
+              HAL_DMA_MAX_DESC_XFER_SIZE - 1) /
+             HAL_DMA_MAX_DESC_XFER_SIZE;
+  if (desc_cnt < MIN_AUDIO_BUFFER_COUNT) {
+    desc_cnt = MIN_AUDIO_BUFFER_COUNT;
+  } else if (desc_cnt & (desc_cnt - 1)) {
+    desc_cnt = 1 << (31 - __CLZ(desc_cnt) + 1);
+  }
+#else
+  desc_cnt = MIN_AUDIO_BUFFER_COUNT;
+#endif
+  return (desc_cnt + role->periods - 1) / role->periods * role->periods;
+}
+
+// Bytes each descriptor's transfer must be a multiple of
+static uint32_t af_stream_dma_align(enum AUD_STREAM_T stream,
+                                    const struct af_stream_cfg_t *role,
+                                    const struct AF_STREAM_CONFIG_T *cfg) {
+  uint32_t align = 4;
+
+#ifndef CHIP_BEST1000
+  if (cfg->chan_sep_buf && cfg->channel_num > AUD_CHANNEL_NUM_1) {
+    enum HAL_DMA_BSIZE_T bsize;
+    uint8_t burst_size;
+
+    if (stream == AUD_STREAM_PLAYBACK) {
+      bsize = role->dma_cfg.src_bsize;
+    } else {
+      bsize = role->dma_cfg.dst_bsize;
+    }
+    if (bsize == HAL_DMA_BSIZE_1) {
+      burst_size = 1;
+    } else if (bsize == HAL_DMA_BSIZE_4) {
+      burst_size = 4;
+    } else {
+      burst_size = 8;
+    }
+    align = burst_size * af_stream_samp_size(cfg) * cfg->channel_num;
+    // Ensure word-aligned too
+    if (align & 0x1) {
+      align *= 4;
+    } else if (align & 0x2) {
+      align *= 2;
+    }
+  }
+#endif
+  return align;
+}
+
+// The buffer must split into whole, aligned descriptors, which the period
+// count makes stricter: see af_stream_set_periods().
+static bool af_stream_dma_size_valid(enum AUD_STREAM_T stream,
+                                     const struct af_stream_cfg_t *role,
+                                     const struct AF_STREAM_CONFIG_T *cfg) {
+  uint32_t desc_cnt = af_stream_dma_desc_cnt(role, cfg);
+  uint32_t align = af_stream_dma_align(stream, role, cfg);
+
+  if (desc_cnt > MAX_AUDIO_BUFFER_COUNT ||
+      cfg->data_size % (desc_cnt * align)) {
+    TRACE(5, "af_stream_dma_size_valid: Bad data_size=%u desc_cnt=%u "
+             "align=%u periods=%u",
+          cfg->data_size, desc_cnt, align, role->periods);
+    return false;
+  }
+  return true;
+}
+
 static void af_stream_update_dma_buffer(enum AUD_STREAM_T stream,
                                         struct af_stream_cfg_t *role,
                                         const struct AF_STREAM_CONFIG_T *cfg) {
@@ -1218,23 +1392,16 @@ static void af_stream_update_dma_buffer(enum AUD_STREAM_T stream,
     samp_size = 1;
   }
 
-#ifdef DYNAMIC_AUDIO_BUFFER_COUNT
   uint32_t desc_cnt;
-
-  desc_cnt = (cfg->data_size / samp_size + HAL_DMA_MAX_DESC_XFER_SIZE - 1) /
-             HAL_DMA_MAX_DESC_XFER_SIZE;
-  if (desc_cnt < 2) {
-    desc_cnt = 2;
-  } else if (desc_cnt & (desc_cnt - 1)) {
-    desc_cnt = 1 << (31 - __CLZ(desc_cnt) + 1);
-  }
-  TRACE(4, "%s: desc_cnt=%u data_size=%u samp_size=%u", __func__, desc_cnt,
-        cfg->data_size, samp_size);
-  ASSERT(MIN_AUDIO_BUFFER_COUNT <= desc_cnt &&
-             desc_cnt <= MAX_AUDIO_BUFFER_COUNT,
-         "%s: Bad desc_cnt=%u", __func__, desc_cnt);
+  uint32_t periods;
+
+  periods = role->periods;
+  desc_cnt = af_stream_dma_desc_cnt(role, cfg);
+  TRACE(5, "%s: desc_cnt=%u periods=%u data_size=%u samp_size=%u", __func__,
+        desc_cnt, periods, cfg->data_size, samp_size);
+  ASSERT(desc_cnt <= MAX_AUDIO_BUFFER_COUNT, "%s: Bad desc_cnt=%u", __func__,
+         desc_cnt);
   role->dma_desc_cnt = desc_cnt;
-#endif
 
   desc_xfer_size = cfg->data_size / AUDIO_BUFFER_COUNT;
 
@@ -1246,35 +1413,10 @@ static void af_stream_update_dma_buffer(enum AUD_STREAM_T stream,
   }
 
   if (dma_2d_en) {
-    enum HAL_DMA_BSIZE_T bsize;
-    uint8_t burst_size;
-
     chan_desc_xfer_size = desc_xfer_size / cfg->channel_num;
-
-    if (stream == AUD_STREAM_PLAYBACK) {
-      bsize = dma_cfg->src_bsize;
-    } else {
-      bsize = dma_cfg->dst_bsize;
-    }
-    if (bsize == HAL_DMA_BSIZE_1) {
-      burst_size = 1;
-    } else if (bsize == HAL_DMA_BSIZE_4) {
-      burst_size = 4;
-    } else {
-      burst_size = 8;
-    }
-    align = burst_size * samp_size * cfg->channel_num;
-    // Ensure word-aligned too
-    if (align & 0x1) {
-      align *= 4;
-    } else if (align & 0x2) {
-      align *= 2;
-    }
-  } else
-#endif
-  {
-    align = 4;
   }
+#endif
+  align = af_stream_dma_align(stream, role, cfg);
   ASSERT(desc_xfer_size * AUDIO_BUFFER_COUNT == cfg->data_size &&
              (desc_xfer_size % align) == 0,
          "%s: Dma data size is not aligned: data_size=%u AUDIO_BUFFER_COUNT=%u "
@@ -1288,15 +1430,10 @@ static void af_stream_update_dma_buffer(enum AUD_STREAM_T stream,
   for (i = 0; i < AUDIO_BUFFER_COUNT; i++) {
     if (i == AUDIO_BUFFER_COUNT - 1) {
       next_desc = &dma_desc[0];
-      irq = 1;
     } else {
       next_desc = &dma_desc[i + 1];
-      if (i == AUDIO_BUFFER_COUNT / 2 - 1) {
-        irq = 1;
-      } else {
-        irq = 0;
-      }
     }
+    irq = ((i + 1) % (AUDIO_BUFFER_COUNT / periods) == 0);
 
     if (stream == AUD_STREAM_PLAYBACK) {
 #ifndef CHIP_BEST1000
@@ -1406,6 +1543,11 @@ uint32_t af_stream_open(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream,
 
   dma_cfg->handler = af_dma_irq_handler;
 
+  if (!af_stream_dma_size_valid(stream, role, cfg)) {
+    TRACE(1, "[%s] ERROR: data_size does not fit the periods", __func__);
+    goto _exit;
+  }
+
   if (stream == AUD_STREAM_PLAYBACK) {
     AF_TRACE_DEBUG();
     dma_cfg->src_periph = (enum HAL_DMA_PERIPH_T)0;
@@ -1497,10 +1639,10 @@ uint32_t af_stream_open(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream,
         goto _exit;
       }
 #else
-      sw_gain_iir.history_x[0] = 0.0f;
-      sw_gain_iir.history_x[1] = 0.0f;
-      sw_gain_iir.history_y[0] = 0.0f;
-      sw_gain_iir.history_y[1] = 0.0f;
+      // Fade in from silence
+      sw_gain_target = 0.0f;
+      sw_gain_dist[0] = 0.0f;
+      sw_gain_dist[1] = 0.0f;
 #endif
 #endif
 
@@ -1659,6 +1801,43 @@ _exit:
   return ret;
 }
 
+uint32_t af_stream_set_periods(enum AUD_STREAM_ID_T id,
+                               enum AUD_STREAM_T stream, uint8_t periods,
+                               uint8_t write_ahead) {
+  struct af_stream_cfg_t *role;
+  enum AF_RESULT_T ret;
+
+  role = af_get_stream_role(id, stream);
+  TRACE(5, "[%s] id = %d, stream = %d, periods = %d, write_ahead = %d",
+        __func__, id, stream, periods, write_ahead);
+
+  if (periods < AF_STREAM_MIN_PERIODS || periods > AF_STREAM_MAX_PERIODS ||
+      (periods & (periods - 1)) || write_ahead >= periods) {
+    return AF_RES_FAILD;
+  }
+  if (write_ahead == 0) {
+    write_ahead = periods - 1;
+  }
+
+  af_lock_thread();
+
+  // check stream is not open
+  if (role->ctl.status != AF_STATUS_OPEN_CLOSE) {
+    TRACE(2, "[%s] ERROR: status = %d", __func__, role->ctl.status);
+    ret = AF_RES_FAILD;
+    goto _exit;
+  }
+
+  role->periods = periods;
+  role->write_ahead = write_ahead;
+  ret = AF_RES_SUCCESS;
+
+_exit:
+  af_unlock_thread();
+
+  return ret;
+}
+
 // volume, path, sample rate, channel num ...
 uint32_t af_stream_setup(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream,
                          const struct AF_STREAM_CONFIG_T *cfg) {
@@ -1708,6 +1887,10 @@ uint32_t af_stream_setup(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream,
              "[%s] ERROR: Update dma while stream %d started", __func__,
              stream);
 
+      if (!af_stream_dma_size_valid(stream, role, cfg)) {
+        TRACE(1, "[%s] ERROR: data_size does not fit the periods", __func__);
+        goto _exit;
+      }
       af_stream_update_dma_buffer(stream, role, cfg);
     }
 
@@ -2071,8 +2254,7 @@ uint32_t af_stream_start(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream) {
 
   device = role->ctl.use_device;
 
-  role->ctl.pp_index = PP_PING;
-  role->ctl.pp_cnt = 0;
+  af_stream_reset_ring(role, stream);
 
 #ifndef RTOS
   af_clear_flag(&af_flag_signal, 1 << (id * 2 + stream));
@@ -2455,8 +2637,7 @@ uint32_t af_stream_restart(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream) {
     goto _exit;
   }
 
-  role->ctl.pp_index = PP_PING;
-  role->ctl.pp_cnt = 0;
+  af_stream_reset_ring(role, stream);
 
 #ifdef AUDIO_OUTPUT_PA_ON_FADE_IN
   if (AUD_STREAM_PLAYBACK == stream) {
@@ -2513,7 +2694,9 @@ uint32_t af_stream_close(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream) {
   //  TODO: more parameter should be set!!!
   //    memset(role, 0xff, sizeof(struct af_stream_cfg_t));
   role->handler = NULL;
-  role->ctl.pp_index = PP_PING;
+  role->ctl.pp_index = 0;
+  role->periods = AF_STREAM_MIN_PERIODS;
+  role->write_ahead = AF_STREAM_MIN_PERIODS - 1;
   role->ctl.use_device = AUD_STREAM_USE_DEVICE_NULL;
   role->dma_buf_ptr = NULL;
   role->dma_buf_size = 0;
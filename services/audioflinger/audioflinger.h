@@ -64,11 +64,31 @@ struct AF_STREAM_CONFIG_T {
     uint8_t vol;
 };
 
+// A stream's DMA buffer is split into periods, 2 (ping-pong) by default, and
+// the handler is called once for each period, with data_size / periods
+// bytes. Playback fills the period write_ahead periods ahead of the one being
+// played, so the latency is write_ahead periods while a callback may be
+// write_ahead - 1 periods late without an underrun. Capture hands over each
+// period as soon as the DMA has filled it.
+#define AF_STREAM_MIN_PERIODS 2
+#define AF_STREAM_MAX_PERIODS 8
+
 //Should define return status
 uint32_t af_open(void);
 void *af_thread_tid_get(void);
 uint32_t af_stream_open(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream, const struct AF_STREAM_CONFIG_T *cfg);
 uint32_t af_stream_setup(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream, const struct AF_STREAM_CONFIG_T *cfg);
+// Call before af_stream_open(); the setting holds until af_stream_close().
+// periods must be a power of two from AF_STREAM_MIN_PERIODS to
+// AF_STREAM_MAX_PERIODS. A write_ahead of 0 is taken as periods - 1, the
+// most slack.
+// data_size must split into whole, word-aligned descriptors, and each
+// period takes the same number of them: usually max(periods, 4)
+// descriptors, so a multiple of 4 * max(periods, 4) bytes. chan_sep_buf
+// aligns each descriptor to burst * sample size * channels instead. A
+// data_size that does not split makes af_stream_open() and
+// af_stream_setup() return AF_RES_FAILD.
+uint32_t af_stream_set_periods(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream, uint8_t periods, uint8_t write_ahead);
 uint32_t af_stream_mute(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream, bool mute);
 uint32_t af_stream_set_chan_vol(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream, enum AUD_CHANNEL_MAP_T ch_map, uint8_t vol);
 uint32_t af_stream_restore_chan_vol(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream);
@@ -635,6 +635,69 @@ FRAM_TEXT_LOC uint8_t bt_sbc_player_get_sample_bit(void) {
   return app_bt_device.sample_bit[st_id];
 }
 
+// Largest frame the source may send on each stream, from the codec
+// configuration it set; 0 when not known.
+static uint16_t a2dp_max_frame_bytes[BT_DEVICE_NUM];
+
+// SBC frame length (A2DP spec 12.9) at the configured maximum bitpool.
+static uint16_t a2dp_sbc_max_frame_bytes(const uint8_t *elements) {
+  uint8_t mode = elements[0] & A2D_SBC_IE_CH_MD_MSK;
+  uint8_t bitpool = elements[3];
+  uint32_t subbands, blocks, channels, bits;
+
+  subbands = (elements[1] & A2D_SBC_IE_SUBBAND_4) ? 4 : 8;
+  switch (elements[1] & A2D_SBC_IE_BLOCKS_MSK) {
+  case A2D_SBC_IE_BLOCKS_4:
+    blocks = 4;
+    break;
+  case A2D_SBC_IE_BLOCKS_8:
+    blocks = 8;
+    break;
+  case A2D_SBC_IE_BLOCKS_12:
+    blocks = 12;
+    break;
+  default:
+    blocks = 16;
+    break;
+  }
+  channels = (mode == A2D_SBC_IE_CH_MD_MONO) ? 1 : 2;
+
+  if (mode == A2D_SBC_IE_CH_MD_MONO || mode == A2D_SBC_IE_CH_MD_DUAL)
+    bits = blocks * channels * bitpool;
+  else if (mode == A2D_SBC_IE_CH_MD_JOINT)
+    bits = subbands + blocks * bitpool;
+  else
+    bits = blocks * bitpool;
+  return 4 + (4 * subbands * channels) / 8 + (bits + 7) / 8;
+}
+
+#if defined(A2DP_AAC_ON)
+// A CBR AAC frame carries 1024 samples at the configured bitrate. Frames
+// may borrow from the bit reservoir, so allow half as much again plus the
+// LATM header. VBR has no bound short of the read buffer.
+static uint16_t a2dp_aac_max_frame_bytes(const uint8_t *elements) {
+  uint32_t rate, bit_rate, bytes;
+
+  if (elements[3] & A2DP_AAC_OCTET3_VBR_SUPPORTED)
+    return 0;
+  bit_rate = ((elements[3] & 0x7f) << 16) | (elements[4] << 8) | elements[5];
+  if (bit_rate == 0)
+    return 0;
+  if (elements[1] & A2DP_AAC_OCTET1_SAMPLING_FREQUENCY_44100)
+    rate = 44100;
+  else
+    rate = 48000;
+  bytes = (uint32_t)(((uint64_t)bit_rate * 1024 + rate * 8 - 1) / (rate * 8));
+  return bytes + bytes / 2 + 16;
+}
+#endif
+
+uint16_t bt_sbc_player_get_max_frame_bytes(void) {
+  enum BT_DEVICE_ID_T st_id = app_bt_device.curr_a2dp_stream_id;
+
+  return a2dp_max_frame_bytes[st_id];
+}
+
 #ifdef __BT_ONE_BRING_TWO__
 
 uint8_t avrcp_playback_status[BT_DEVICE_NUM] = {0};
@@ -3100,6 +3163,8 @@ extern "C" void a2dp_callback(a2dp_stream_t *Stream,
       app_bt_device.codec_type[stream_id_flag.id] =
           BTIF_AVDTP_CODEC_TYPE_MPEG2_4_AAC;
       app_bt_device.sample_bit[stream_id_flag.id] = 16;
+      a2dp_max_frame_bytes[stream_id_flag.id] =
+          a2dp_aac_max_frame_bytes(Info->p.configReq->codec.elements);
       // convert aac sample_rate to sbc sample_rate format
       if (Info->p.configReq->codec.elements[1] &
           A2DP_AAC_OCTET1_SAMPLING_FREQUENCY_44100) {
@@ -3200,6 +3265,8 @@ extern "C" void a2dp_callback(a2dp_stream_t *Stream,
 
       app_bt_device.codec_type[stream_id_flag.id] = BTIF_AVDTP_CODEC_TYPE_SBC;
       app_bt_device.sample_bit[stream_id_flag.id] = 16;
+      a2dp_max_frame_bytes[stream_id_flag.id] =
+          a2dp_sbc_max_frame_bytes(Info->p.configReq->codec.elements);
       app_bt_device.sample_rate[stream_id_flag.id] =
           (Info->p.configReq->codec.elements[0] & A2D_SBC_IE_SAMP_FREQ_MSK);
 
@@ -4077,6 +4144,8 @@ extern "C" void a2dp_callback(a2dp_stream_t *Stream,
       app_bt_device.codec_type[stream_id_flag.id] =
           BTIF_AVDTP_CODEC_TYPE_MPEG2_4_AAC;
       app_bt_device.sample_bit[stream_id_flag.id] = 16;
+      a2dp_max_frame_bytes[stream_id_flag.id] =
+          a2dp_aac_max_frame_bytes(Info->p.configReq->codec.elements);
       // convert aac sample_rate to sbc sample_rate format
       if (Info->p.configReq->codec.elements[1] &
           A2DP_AAC_OCTET1_SAMPLING_FREQUENCY_44100) {
@@ -4168,6 +4237,8 @@ extern "C" void a2dp_callback(a2dp_stream_t *Stream,
 
       app_bt_device.codec_type[stream_id_flag.id] = BTIF_AVDTP_CODEC_TYPE_SBC;
       app_bt_device.sample_bit[stream_id_flag.id] = 16;
+      a2dp_max_frame_bytes[stream_id_flag.id] =
+          a2dp_sbc_max_frame_bytes(Info->p.configReq->codec.elements);
       app_bt_device.sample_rate[stream_id_flag.id] =
           (Info->p.configReq->codec.elements[0] & A2D_SBC_IE_SAMP_FREQ_MSK);
 
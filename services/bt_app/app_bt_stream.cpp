@@ -917,14 +917,14 @@ int app_playback_resample_run(struct APP_RESAMPLE_T *resamp, uint8_t *buf,
      defined(CHIP_BEST2300A) || defined(CHIP_BEST1400) ||                      \
      defined(CHIP_BEST1402))
 
+#include "a2dp_audio_drift.h"
+
 #define BT_USPERCLK (625)
 #define BT_MUTIUSPERSECOND (1000000 / BT_USPERCLK)
 
 #define CALIB_DEVIATION_MS (2)
-#define CALIB_FACTOR_MAX_THRESHOLD (0.0001f)
-#define CALIB_BT_CLOCK_FACTOR_STEP (0.0000005f)
-
-#define CALIB_FACTOR_DELAY (0.001f)
+// Smallest ratio change worth a retune of the codec or resampler.
+#define CALIB_TUNE_STEP_PPM (1.0f)
 
 // bt time
 static int32_t bt_old_clock_us = 0;
@@ -935,25 +935,20 @@ static int32_t bt_clock_us = 0;
 static uint32_t bt_clock_total_mutius = 0;
 static int32_t bt_total_offset_us = 0;
 
-static int32_t bt_clock_ms = 0;
-
 // local time
 static uint32_t local_total_samples = 0;
-static uint32_t local_total_frames = 0;
-
-// static uint32_t local_clock_us=0;
-static int32_t local_clock_ms = 0;
 
 // bt and local time
 static uint32_t bt_local_clock_s = 0;
 
 // calib time
 static int32_t calib_total_delay = 0;
+static int32_t calib_applied_delay = 0;
 static int32_t calib_flag = 0;
 
 // calib factor
-static float calib_factor_offset = 0.0f;
-static int32_t calib_factor_flag = 0;
+static A2DP_AUDIO_DRIFT_T calib_drift;
+static float calib_ratio_ppm = 0.0f;
 static volatile int calib_reset = 1;
 #endif
 
@@ -983,6 +978,15 @@ bool process_delay(int32_t delay_ms) {
     (defined(CHIP_BEST2300) || defined(CHIP_BEST2300P) ||                      \
      defined(CHIP_BEST2300A) || defined(CHIP_BEST1400) ||                      \
      defined(CHIP_BEST1402))
+static void a2dp_clock_calib_tune(float ratio_ppm) {
+#if defined(__AUDIO_RESAMPLE__) && defined(SW_PLAYBACK_RESAMPLE)
+  app_resample_tune(a2dp_resample, ratio_ppm * 1e-6f);
+#else
+  af_codec_tune(AUD_STREAM_PLAYBACK, ratio_ppm * 1e-6f);
+#endif
+  calib_ratio_ppm = ratio_ppm;
+}
+
 void a2dp_clock_calib_process(uint32_t len) {
   //    btif_remote_device_t   * p_a2dp_remDev=NULL;
   uint32_t smplcnt = 0;
@@ -1004,6 +1008,8 @@ void a2dp_clock_calib_process(uint32_t len) {
     btofs = btdrv_rf_bitoffset_get(a2dp_Get_curr_a2dp_conhdl() - 0x80);
 
     if (calib_reset == 1) {
+      A2DP_AUDIO_DRIFT_CFG_T cfg;
+
       calib_reset = 0;
 
       bt_clock_total_mutius = 0;
@@ -1014,20 +1020,30 @@ void a2dp_clock_calib_process(uint32_t len) {
       bt_total_offset_us = 0;
 
       local_total_samples = 0;
-      local_total_frames = 0;
-      local_clock_ms = 0;
 
       bt_local_clock_s = 0;
       bt_clock_us = 0;
-      bt_clock_ms = 0;
 
       bt_old_offset_us = btofs;
 
-      calib_factor_offset = 0.0f;
-      calib_factor_flag = 0;
       calib_total_delay = 0;
+      calib_applied_delay = 0;
       calib_flag = 0;
+
+      a2dp_audio_drift_default_cfg(&cfg);
+#if defined(__AUDIO_RESAMPLE__) && defined(SW_PLAYBACK_RESAMPLE)
+      // The resampler changes what is played, not the codec clock we measure.
+      cfg.ratio_in_loop = false;
+#endif
+      a2dp_audio_drift_init(&calib_drift, &cfg);
+      if (calib_ratio_ppm != 0.0f) {
+        a2dp_clock_calib_tune(0.0f);
+      }
     } else {
+      int64_t bt_us;
+      int64_t local_us;
+      float ratio_ppm;
+
       btoffset = btofs - bt_old_offset_us;
 
       if (btoffset < -BT_USPERCLK / 3) {
@@ -1039,7 +1055,6 @@ void a2dp_clock_calib_process(uint32_t len) {
       bt_total_offset_us = bt_total_offset_us + btoffset;
       bt_old_offset_us = btofs;
 
-      local_total_frames++;
       if (lowdelay_sample_size_play_bt == AUD_BITS_16) {
         smplcnt = len / (2 * lowdelay_playback_ch_num_bt);
       } else {
@@ -1067,57 +1082,38 @@ void a2dp_clock_calib_process(uint32_t len) {
             local_total_samples - lowdelay_sample_rate_play_bt;
       }
 
-      bt_clock_ms =
-          (bt_clock_total_mutius * BT_USPERCLK / 1000) + bt_clock_us / 625;
-      local_clock_ms =
-          (local_total_samples * 1000) / lowdelay_sample_rate_play_bt;
+      bt_us = (int64_t)bt_clock_total_mutius * BT_USPERCLK + bt_clock_us;
+      local_us = (int64_t)local_total_samples * 1000000 /
+                     lowdelay_sample_rate_play_bt +
+                 (int64_t)calib_total_delay * 1000;
+
+      // A new delay steps the offset on purpose; let the loop work it off
+      // instead of gating it as an outlier.
+      if (calib_total_delay != calib_applied_delay) {
+        a2dp_audio_drift_shift(&calib_drift, (calib_total_delay -
+                                              calib_applied_delay) * 1000.0f);
+        calib_applied_delay = calib_total_delay;
+      }
 
-      local_clock_ms = local_clock_ms + calib_total_delay;
+      ratio_ppm = a2dp_audio_drift_update(
+          &calib_drift,
+          (uint32_t)((int64_t)bt_local_clock_s * 1000000 + bt_us),
+          (float)(local_us - bt_us), calib_ratio_ppm);
 
       // TRACE_AUD_STREAM_I("A2DP
-      // bt_clock_ms:%8d,local_clock_ms:%8d,bt_total_offset_us:%8d\n",bt_clock_ms,
-      // local_clock_ms,bt_total_offset_us);
+      // bt_us:%8d,local_us:%8d,ratio_ppm:%d\n",(int32_t)bt_us,
+      // (int32_t)local_us,(int32_t)ratio_ppm);
 
-      if (bt_clock_ms > (local_clock_ms + CALIB_DEVIATION_MS)) {
-#if defined(__AUDIO_RESAMPLE__) && defined(SW_PLAYBACK_RESAMPLE)
-        app_resample_tune(a2dp_resample, CALIB_FACTOR_DELAY);
-#else
-        af_codec_tune(AUD_STREAM_PLAYBACK, CALIB_FACTOR_DELAY);
-#endif
-        calib_factor_flag = 1;
-        // TRACE_AUD_STREAM_I("*************1***************");
-      } else if (bt_clock_ms < (local_clock_ms - CALIB_DEVIATION_MS)) {
-#if defined(__AUDIO_RESAMPLE__) && defined(SW_PLAYBACK_RESAMPLE)
-        app_resample_tune(a2dp_resample, -CALIB_FACTOR_DELAY);
-#else
-        af_codec_tune(AUD_STREAM_PLAYBACK, -CALIB_FACTOR_DELAY);
-#endif
-        calib_factor_flag = -1;
-        // TRACE_AUD_STREAM_I("*************-1***************");
-      } else {
-        if ((calib_factor_flag == 1 || calib_factor_flag == -1) &&
-            (bt_clock_ms == local_clock_ms)) {
-          if (calib_factor_offset < CALIB_FACTOR_MAX_THRESHOLD &&
-              calib_flag == 0) {
-            if (calib_factor_flag == 1) {
-              calib_factor_offset =
-                  calib_factor_offset + CALIB_BT_CLOCK_FACTOR_STEP;
-            } else {
-              calib_factor_offset =
-                  calib_factor_offset - CALIB_BT_CLOCK_FACTOR_STEP;
-            }
-          }
-#if defined(__AUDIO_RESAMPLE__) && defined(SW_PLAYBACK_RESAMPLE)
-          app_resample_tune(a2dp_resample, calib_factor_offset);
-#else
-          af_codec_tune(AUD_STREAM_PLAYBACK, calib_factor_offset);
-#endif
-          calib_factor_flag = 0;
-          calib_flag = 0;
-          // TRACE_AUD_STREAM_I("*************0***************");
-        }
+      if (ratio_ppm - calib_ratio_ppm >= CALIB_TUNE_STEP_PPM ||
+          calib_ratio_ppm - ratio_ppm >= CALIB_TUNE_STEP_PPM) {
+        a2dp_clock_calib_tune(ratio_ppm);
+      }
+
+      // Accept the next delay request once this one has been played out.
+      if (calib_flag && calib_drift.offset_us < CALIB_DEVIATION_MS * 1000 &&
+          calib_drift.offset_us > -CALIB_DEVIATION_MS * 1000) {
+        calib_flag = 0;
       }
-      //  TRACE_AUD_STREAM_I("factoroffset:%d\n",(int32_t)((factoroffset)*(float)10000000.0f));
     }
   }
 
@@ -1268,23 +1264,28 @@ FRAM_TEXT_LOC uint32_t bt_sbc_player_more_data(uint8_t *buf, uint32_t len) {
 #endif
 #endif
 
+#ifdef ANC_APP
+  bt_audio_updata_eq_for_anc(app_anc_work_status());
+#endif
+
+  audio_process_run(buf, len);
+
 #ifdef __HEAR_THRU_PEAK_DET__
+  // The limiter runs last so the EQ and DRC gains cannot push the output
+  // past its ceiling again.
 #ifdef ANC_APP
   if (app_anc_work_status())
 #endif
   {
     int vol_level = 0;
+    uint32_t gr_frames, max_gr_q31;
     vol_level = app_bt_stream_local_volume_get();
     peak_detector_run(buf, len, pkd_vol_multiple[vol_level]);
+    peak_detector_take_stats(&gr_frames, &max_gr_q31);
+    audio_process_mark_gain_reduction(gr_frames, max_gr_q31);
   }
 #endif
 
-#ifdef ANC_APP
-  bt_audio_updata_eq_for_anc(app_anc_work_status());
-#endif
-
-  audio_process_run(buf, len);
-
 #if defined(IBRT)
   app_tws_ibrt_audio_analysis_audiohandler_tick();
 #endif
@@ -3573,6 +3574,32 @@ void app_audio_buffer_check(void) {
 }
 
 static bool isRun = false;
+static int a2dp_mempool_scope = -1;
+
+// Names the mempool scope of a stream so each codec gets its own peak.
+static const char *bt_sbc_player_mempool_scope_name(uint8_t codec_type) {
+  if (codec_type == BTIF_AVDTP_CODEC_TYPE_MPEG2_4_AAC) {
+    return "a2dp.aac";
+  } else if (codec_type == BTIF_AVDTP_CODEC_TYPE_NON_A2DP) {
+#if defined(A2DP_LHDC_ON)
+    if (current_a2dp_non_type == A2DP_NON_CODEC_TYPE_LHDC) {
+      return "a2dp.lhdc";
+    }
+#endif
+#if defined(A2DP_LDAC_ON)
+    if (current_a2dp_non_type == A2DP_NON_CODEC_TYPE_LDAC) {
+      return "a2dp.ldac";
+    }
+#endif
+#if defined(A2DP_SCALABLE_ON)
+    if (current_a2dp_non_type == A2DP_NON_CODEC_TYPE_SCALABLE) {
+      return "a2dp.scalable";
+    }
+#endif
+    return "a2dp.vendor";
+  }
+  return "a2dp.sbc";
+}
 
 int bt_sbc_player(enum PLAYER_OPER_T on, enum APP_SYSFREQ_FREQ_T freq) {
   struct AF_STREAM_CONFIG_T stream_cfg;
@@ -3706,6 +3733,8 @@ int bt_sbc_player(enum PLAYER_OPER_T on, enum APP_SYSFREQ_FREQ_T freq) {
 #endif
 #endif
       a2dp_audio_deinit();
+      app_audio_mempool_scope_end(a2dp_mempool_scope);
+      a2dp_mempool_scope = -1;
 #if defined(AUDIO_ANC_FB_MC) && defined(ANC_APP) &&                            \
     !defined(__AUDIO_RESAMPLE__) && defined(AUDIO_ANC_FB_ADJ_MC)
       adj_mc_deinit();
@@ -3759,6 +3788,8 @@ int bt_sbc_player(enum PLAYER_OPER_T on, enum APP_SYSFREQ_FREQ_T freq) {
     bt_media_volume_ptr_update_by_mediatype(BT_STREAM_SBC);
     stream_local_volume = btdevice_volume_p->a2dp_vol;
     app_audio_mempool_init_with_specific_size(APP_AUDIO_BUFFER_SIZE);
+    a2dp_mempool_scope = app_audio_mempool_scope_begin(
+        bt_sbc_player_mempool_scope_name(codec_type));
 
 #ifdef __BT_ONE_BRING_TWO__
     if (btif_me_get_activeCons() > 1) {
@@ -4158,8 +4189,9 @@ int bt_sbc_player(enum PLAYER_OPER_T on, enum APP_SYSFREQ_FREQ_T freq) {
     PEAK_DETECTOR_CFG_T peak_detector_cfg;
     peak_detector_cfg.fs = stream_cfg.sample_rate;
     peak_detector_cfg.bits = stream_cfg.bits;
-    peak_detector_cfg.factor_up = 0.6;
-    peak_detector_cfg.factor_down = 2.0;
+    peak_detector_cfg.channels = stream_cfg.channel_num;
+    peak_detector_cfg.lookahead_ms = 1.0;
+    peak_detector_cfg.release_s = 2.0;
     peak_detector_cfg.reduce_dB = -30;
     peak_detector_init();
     peak_detector_setup(&peak_detector_cfg);
@@ -6112,6 +6144,7 @@ extern uint8_t bt_drv_reg_op_pcm_get();
 int bt_sco_player(bool on, enum APP_SYSFREQ_FREQ_T freq) {
   struct AF_STREAM_CONFIG_T stream_cfg;
   static bool isRun = false;
+  static int sco_mempool_scope = -1;
   uint8_t *bt_audio_buff = NULL;
   enum AUD_SAMPRATE_T sample_rate;
 
@@ -6216,6 +6249,7 @@ int bt_sco_player(bool on, enum APP_SYSFREQ_FREQ_T freq) {
     bt_sco_mode = 1;
 
     app_audio_mempool_init();
+    sco_mempool_scope = app_audio_mempool_scope_begin("sco");
 
 #ifndef _SCO_BTPCM_CHANNEL_
     memset(&hf_sendbuff_ctrl, 0, sizeof(hf_sendbuff_ctrl));
@@ -6791,6 +6825,8 @@ defined(ANC_APP) && !defined(__AUDIO_RESAMPLE__)
     // app_cap_thread_stop();
 #endif
     voicebtpcm_pcm_audio_deinit();
+    app_audio_mempool_scope_end(sco_mempool_scope);
+    sco_mempool_scope = -1;
 
 #if defined(BONE_SENSOR_TDM)
     lis25ba_deinit();
@@ -398,6 +398,9 @@ void bt_key_handle_func_longpress();
 void bt_sbc_player_set_codec_type(uint8_t type);
 uint8_t bt_sbc_player_get_codec_type(void);
 uint8_t bt_sbc_player_get_sample_bit(void);
+// Largest SBC or AAC frame the current stream's configuration allows, 0 if
+// unknown.
+uint16_t bt_sbc_player_get_max_frame_bytes(void);
 #if defined(A2DP_LDAC_ON)
 int bt_ldac_player_get_channelmode(void);
 int bt_get_ladc_sample_rate(void);
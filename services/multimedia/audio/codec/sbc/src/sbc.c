@@ -0,0 +1,685 @@
+#include "sbc_local.h"
+#include <string.h>
+
+// SBC and mSBC, A2DP spec section 12 and HFP appendix A, behind the
+// btif_sbc_* interface the archives used to provide. Of the fields the
+// interface defines, the decoder keeps its V ring position in
+// parser.rxState and a partial frame in parser.stageBuff.
+
+static const int8_t sbc_offset4[4][4] = {
+    {-1, 0, 0, 0},
+    {-2, 0, 0, 1},
+    {-2, 0, 0, 1},
+    {-2, 0, 0, 1},
+};
+
+static const int8_t sbc_offset8[4][8] = {
+    {-2, 0, 0, 0, 0, 0, 0, 1},
+    {-3, 0, 0, 0, 0, 0, 1, 2},
+    {-4, 0, 0, 0, 0, 0, 1, 2},
+    {-4, 0, 0, 0, 0, 0, 1, 2},
+};
+
+// CRC-8, x^8 + x^4 + x^3 + x^2 + 1, one byte per lookup.
+static const uint8_t sbc_crc_tbl[256] = {
+    0x00, 0x1D, 0x3A, 0x27, 0x74, 0x69, 0x4E, 0x53, 0xE8, 0xF5, 0xD2, 0xCF,
+    0x9C, 0x81, 0xA6, 0xBB, 0xCD, 0xD0, 0xF7, 0xEA, 0xB9, 0xA4, 0x83, 0x9E,
+    0x25, 0x38, 0x1F, 0x02, 0x51, 0x4C, 0x6B, 0x76, 0x87, 0x9A, 0xBD, 0xA0,
+    0xF3, 0xEE, 0xC9, 0xD4, 0x6F, 0x72, 0x55, 0x48, 0x1B, 0x06, 0x21, 0x3C,
+    0x4A, 0x57, 0x70, 0x6D, 0x3E, 0x23, 0x04, 0x19, 0xA2, 0xBF, 0x98, 0x85,
+    0xD6, 0xCB, 0xEC, 0xF1, 0x13, 0x0E, 0x29, 0x34, 0x67, 0x7A, 0x5D, 0x40,
+    0xFB, 0xE6, 0xC1, 0xDC, 0x8F, 0x92, 0xB5, 0xA8, 0xDE, 0xC3, 0xE4, 0xF9,
+    0xAA, 0xB7, 0x90, 0x8D, 0x36, 0x2B, 0x0C, 0x11, 0x42, 0x5F, 0x78, 0x65,
+    0x94, 0x89, 0xAE, 0xB3, 0xE0, 0xFD, 0xDA, 0xC7, 0x7C, 0x61, 0x46, 0x5B,
+    0x08, 0x15, 0x32, 0x2F, 0x59, 0x44, 0x63, 0x7E, 0x2D, 0x30, 0x17, 0x0A,
+    0xB1, 0xAC, 0x8B, 0x96, 0xC5, 0xD8, 0xFF, 0xE2, 0x26, 0x3B, 0x1C, 0x01,
+    0x52, 0x4F, 0x68, 0x75, 0xCE, 0xD3, 0xF4, 0xE9, 0xBA, 0xA7, 0x80, 0x9D,
+    0xEB, 0xF6, 0xD1, 0xCC, 0x9F, 0x82, 0xA5, 0xB8, 0x03, 0x1E, 0x39, 0x24,
+    0x77, 0x6A, 0x4D, 0x50, 0xA1, 0xBC, 0x9B, 0x86, 0xD5, 0xC8, 0xEF, 0xF2,
+    0x49, 0x54, 0x73, 0x6E, 0x3D, 0x20, 0x07, 0x1A, 0x6C, 0x71, 0x56, 0x4B,
+    0x18, 0x05, 0x22, 0x3F, 0x84, 0x99, 0xBE, 0xA3, 0xF0, 0xED, 0xCA, 0xD7,
+    0x35, 0x28, 0x0F, 0x12, 0x41, 0x5C, 0x7B, 0x66, 0xDD, 0xC0, 0xE7, 0xFA,
+    0xA9, 0xB4, 0x93, 0x8E, 0xF8, 0xE5, 0xC2, 0xDF, 0x8C, 0x91, 0xB6, 0xAB,
+    0x10, 0x0D, 0x2A, 0x37, 0x64, 0x79, 0x5E, 0x43, 0xB2, 0xAF, 0x88, 0x95,
+    0xC6, 0xDB, 0xFC, 0xE1, 0x5A, 0x47, 0x60, 0x7D, 0x2E, 0x33, 0x14, 0x09,
+    0x7F, 0x62, 0x45, 0x58, 0x0B, 0x16, 0x31, 0x2C, 0x97, 0x8A, 0xAD, 0xB0,
+    0xE3, 0xFE, 0xD9, 0xC4,
+};
+
+static uint8_t sbc_crc8(const uint8_t *data, uint32_t bits) {
+  uint8_t crc = 0x0F;
+  uint32_t i;
+
+  for (i = 0; i < bits / 8; i++)
+    crc = sbc_crc_tbl[crc ^ data[i]];
+  for (i = 0; i < bits % 8; i++) {
+    uint8_t bit = ((crc ^ (data[bits / 8] << i)) & 0x80) != 0;
+
+    crc = (uint8_t)(crc << 1) ^ (bit ? 0x1D : 0);
+  }
+  return crc;
+}
+
+static uint32_t sbc_get_bits(const uint8_t *data, uint32_t *pos, int n) {
+  uint32_t p = *pos, v = 0;
+
+  *pos += n;
+  while (n > 0) {
+    int avail = 8 - (p & 7);
+    int take = n < avail ? n : avail;
+
+    v = (v << take) | ((data[p >> 3] >> (avail - take)) & ((1 << take) - 1));
+    p += take;
+    n -= take;
+  }
+  return v;
+}
+
+// |data| must start zeroed.
+static void sbc_put_bits(uint8_t *data, uint32_t *pos, uint32_t v, int n) {
+  uint32_t p = *pos;
+
+  *pos += n;
+  while (n > 0) {
+    int avail = 8 - (p & 7);
+    int take = n < avail ? n : avail;
+
+    n -= take;
+    data[p >> 3] |= ((v >> n) & ((1 << take) - 1)) << (avail - take);
+    p += take;
+  }
+}
+
+static void sbc_set_msbc(btif_sbc_stream_info_t *si) {
+  si->sampleFreq = BTIF_SBC_CHNL_SAMPLE_FREQ_16;
+  si->numBlocks = BTIF_MSBC_BLOCKS;
+  si->channelMode = BTIF_SBC_CHNL_MODE_MONO;
+  si->allocMethod = BTIF_SBC_ALLOC_METHOD_LOUDNESS;
+  si->numSubBands = 8;
+  si->numChannels = 1;
+  si->bitPool = MSBC_BITPOOL;
+}
+
+static int sbc_check_config(const btif_sbc_stream_info_t *si) {
+  int max_bitpool = 16 * si->numSubBands;
+
+  if (si->numSubBands != 4 && si->numSubBands != 8)
+    return 0;
+  if (si->sampleFreq > BTIF_SBC_CHNL_SAMPLE_FREQ_48 ||
+      si->channelMode > BTIF_SBC_CHNL_MODE_JOINT_STEREO)
+    return 0;
+  if (!si->mSbcFlag && (si->numBlocks & 3 || si->numBlocks < 4 ||
+                        si->numBlocks > BTIF_SBC_MAX_NUM_BLK))
+    return 0;
+  if (si->channelMode >= BTIF_SBC_CHNL_MODE_STEREO)
+    max_bitpool *= 2;
+  return si->bitPool >= 2 && si->bitPool <= max_bitpool;
+}
+
+uint16_t btif_sbc_frame_len(btif_sbc_stream_info_t *StreamInfo) {
+  const btif_sbc_stream_info_t *si = StreamInfo;
+  uint32_t bits, nch;
+
+  if (si->mSbcFlag)
+    return MSBC_FRAME_LEN;
+
+  nch = si->channelMode == BTIF_SBC_CHNL_MODE_MONO ? 1 : 2;
+  if (si->channelMode == BTIF_SBC_CHNL_MODE_MONO ||
+      si->channelMode == BTIF_SBC_CHNL_MODE_DUAL_CHNL)
+    bits = si->numBlocks * nch * si->bitPool;
+  else
+    bits = si->numBlocks * si->bitPool;
+  if (si->channelMode == BTIF_SBC_CHNL_MODE_JOINT_STEREO)
+    bits += si->numSubBands;
+  return (uint16_t)(4 + 4 * si->numSubBands * nch / 8 + (bits + 7) / 8);
+}
+
+// Reads the header at |data|, which holds at least 3 bytes, into |si| and
+// returns the length of the frame, or 0 when it is not a frame header.
+static uint16_t sbc_parse_header(const uint8_t *data,
+                                 btif_sbc_stream_info_t *si) {
+  if (data[0] == MSBC_SYNCWORD) {
+    si->mSbcFlag = 1;
+    sbc_set_msbc(si);
+  } else if (data[0] == SBC_SYNCWORD) {
+    si->mSbcFlag = 0;
+    si->sampleFreq = data[1] >> 6;
+    si->numBlocks = (((data[1] >> 4) & 3) + 1) * 4;
+    si->channelMode = (data[1] >> 2) & 3;
+    si->allocMethod = (data[1] >> 1) & 1;
+    si->numSubBands = data[1] & 1 ? 8 : 4;
+    si->numChannels = si->channelMode == BTIF_SBC_CHNL_MODE_MONO ? 1 : 2;
+    si->bitPool = data[2];
+    if (!sbc_check_config(si))
+      return 0;
+  } else {
+    return 0;
+  }
+  return btif_sbc_frame_len(si);
+}
+
+// The spec's bit allocation over the |nch| channels from |ch0|: one for
+// mono and dual channel, both for stereo and joint stereo.
+static void sbc_alloc_bits(btif_sbc_stream_info_t *si, int ch0, int nch) {
+  const int m = si->numSubBands;
+  const int8_t *offset =
+      m == 4 ? sbc_offset4[si->sampleFreq] : sbc_offset8[si->sampleFreq];
+  // S8 is a plain char, which is unsigned on ARM; read it back as int8_t.
+  S8 *need[2] = {si->bitNeed0, si->bitNeed1};
+  int max_need = 0, bitcount = 0, slicecount = 0, bitslice;
+  int ch, sb;
+
+  for (ch = ch0; ch < ch0 + nch; ch++) {
+    for (sb = 0; sb < m; sb++) {
+      int sf = si->scale_factors[ch][sb], n;
+
+      if (si->allocMethod == BTIF_SBC_ALLOC_METHOD_SNR) {
+        n = sf;
+      } else if (sf == 0) {
+        n = -5;
+      } else {
+        n = sf - offset[sb];
+        if (n > 0)
+          n /= 2;
+      }
+      need[ch][sb] = (S8)n;
+      if (n > max_need)
+        max_need = n;
+    }
+  }
+
+  bitslice = max_need + 1;
+  do {
+    bitslice--;
+    bitcount += slicecount;
+    slicecount = 0;
+    for (ch = ch0; ch < ch0 + nch; ch++) {
+      for (sb = 0; sb < m; sb++) {
+        int n = (int8_t)need[ch][sb];
+
+        if (n > bitslice + 1 && n < bitslice + 16)
+          slicecount++;
+        else if (n == bitslice + 1)
+          slicecount += 2;
+      }
+    }
+  } while (bitcount + slicecount < si->bitPool);
+  if (bitcount + slicecount == si->bitPool) {
+    bitcount += slicecount;
+    bitslice--;
+  }
+
+  for (ch = ch0; ch < ch0 + nch; ch++) {
+    for (sb = 0; sb < m; sb++) {
+      int n = (int8_t)need[ch][sb];
+
+      if (n < bitslice + 2)
+        si->bits[ch][sb] = 0;
+      else
+        si->bits[ch][sb] = (uint8_t)(n - bitslice < 16 ? n - bitslice : 16);
+    }
+  }
+
+  // The leftovers go one subband at a time, alternating channels.
+  for (sb = 0; bitcount < si->bitPool && sb < m; sb++) {
+    for (ch = ch0; bitcount < si->bitPool && ch < ch0 + nch; ch++) {
+      uint8_t *bits = &si->bits[ch][sb];
+
+      if (*bits >= 2 && *bits < 16) {
+        (*bits)++;
+        bitcount++;
+      } else if ((int8_t)need[ch][sb] == bitslice + 1 &&
+                 si->bitPool > bitcount + 1) {
+        *bits = 2;
+        bitcount += 2;
+      }
+    }
+  }
+  for (sb = 0; bitcount < si->bitPool && sb < m; sb++) {
+    for (ch = ch0; bitcount < si->bitPool && ch < ch0 + nch; ch++) {
+      if (si->bits[ch][sb] < 16) {
+        si->bits[ch][sb]++;
+        bitcount++;
+      }
+    }
+  }
+}
+
+static void sbc_calc_bits(btif_sbc_stream_info_t *si) {
+  if (si->channelMode == BTIF_SBC_CHNL_MODE_STEREO ||
+      si->channelMode == BTIF_SBC_CHNL_MODE_JOINT_STEREO) {
+    sbc_alloc_bits(si, 0, 2);
+  } else {
+    sbc_alloc_bits(si, 0, 1);
+    if (si->channelMode == BTIF_SBC_CHNL_MODE_DUAL_CHNL)
+      sbc_alloc_bits(si, 1, 1);
+  }
+}
+
+// 2^(30 + bits) / (2^bits - 1), rounded: (2q + 1) / levels without a
+// divide in sbc_unpack_frame().
+static const uint32_t sbc_level_recip[17] = {
+    0,          0x80000000, 0x55555555, 0x49249249, 0x44444444,
+    0x42108421, 0x41041041, 0x40810204, 0x40404040, 0x40201008,
+    0x40100401, 0x40080100, 0x40040040, 0x40020010, 0x40010004,
+    0x40008001, 0x40004000,
+};
+
+// Unpacks the |len| byte frame at |data| into |si|, including the subband
+// samples. Returns the frame length, or 0 on a bad header, short frame or
+// CRC mismatch.
+static uint16_t sbc_unpack_frame(const uint8_t *data, uint16_t len,
+                                 btif_sbc_stream_info_t *si) {
+  uint8_t crc_data[11];
+  uint32_t pos = 32, crc_bits;
+  uint16_t flen;
+  int nch, m, blk, ch, sb;
+
+  if (len < 4)
+    return 0;
+  flen = sbc_parse_header(data, si);
+  if (!flen || len < flen)
+    return 0;
+  nch = si->numChannels;
+  m = si->numSubBands;
+
+  memset(si->join, 0, sizeof(si->join));
+  if (si->channelMode == BTIF_SBC_CHNL_MODE_JOINT_STEREO) {
+    for (sb = 0; sb < m; sb++)
+      si->join[sb] = (uint8_t)sbc_get_bits(data, &pos, 1);
+    si->join[m - 1] = 0;
+  }
+  for (ch = 0; ch < nch; ch++)
+    for (sb = 0; sb < m; sb++)
+      si->scale_factors[ch][sb] = (uint8_t)sbc_get_bits(data, &pos, 4);
+
+  // The CRC covers bytes 1 and 2 and the bits read so far.
+  crc_bits = pos - 32;
+  crc_data[0] = data[1];
+  crc_data[1] = data[2];
+  memcpy(&crc_data[2], &data[4], (crc_bits + 7) / 8);
+  si->crc = data[3];
+  si->fcs = sbc_crc8(crc_data, 16 + crc_bits);
+  if (si->fcs != si->crc)
+    return 0;
+
+  sbc_calc_bits(si);
+
+  for (blk = 0; blk < si->numBlocks; blk++) {
+    for (ch = 0; ch < nch; ch++) {
+      for (sb = 0; sb < m; sb++) {
+        int bits = si->bits[ch][sb];
+        int sf = si->scale_factors[ch][sb];
+        int64_t v;
+        uint32_t q;
+
+        if (!bits) {
+          si->sbSample[blk][ch][sb] = 0;
+          continue;
+        }
+        q = sbc_get_bits(data, &pos, bits);
+        // ((2q + 1) / levels - 1) * 2^(sf + 1), in Q15.
+        v = (int64_t)(((uint64_t)(2 * q + 1) * sbc_level_recip[bits]) >>
+                      (14 + bits - sf)) -
+            ((int64_t)1 << (sf + 16));
+        if (v > INT32_MAX)
+          v = INT32_MAX;
+        si->sbSample[blk][ch][sb] = (REAL)v;
+      }
+    }
+    if (si->channelMode == BTIF_SBC_CHNL_MODE_JOINT_STEREO) {
+      REAL *l = si->sbSample[blk][0], *r = si->sbSample[blk][1];
+
+      for (sb = 0; sb < m - 1; sb++) {
+        if (si->join[sb]) {
+          REAL mid = l[sb], side = r[sb];
+
+          l[sb] = (REAL)((uint32_t)mid + (uint32_t)side);
+          r[sb] = (REAL)((uint32_t)mid - (uint32_t)side);
+        }
+      }
+    }
+  }
+  return flen;
+}
+
+// The smallest scale factor that bounds the |n| samples |stride| apart:
+// |sample| < 2^(sf + 1) in PCM units.
+static uint8_t sbc_scale_factor(const REAL *s, int n, int stride) {
+  uint32_t max = 0;
+  int sf;
+
+  for (; n > 0; n--, s += stride) {
+    uint32_t a = *s < 0 ? 0 - (uint32_t)*s : (uint32_t)*s;
+
+    if (a > max)
+      max = a;
+  }
+  sf = max ? 32 - __builtin_clz(max) - 16 : 0;
+  return (uint8_t)(sf < 0 ? 0 : sf > 15 ? 15 : sf);
+}
+
+// Scale factors and, for joint stereo, the mid/side choice for each
+// subband but the last: mid/side when it needs smaller scale factors.
+static void sbc_calc_scale_factors(btif_sbc_encoder_t *enc) {
+  btif_sbc_stream_info_t *si = &enc->streamInfo;
+  const int stride = BTIF_SBC_MAX_NUM_CHNL * BTIF_SBC_MAX_NUM_SB;
+  int blocks = si->numBlocks, m = si->numSubBands;
+  int blk, ch, sb;
+
+  for (ch = 0; ch < si->numChannels; ch++)
+    for (sb = 0; sb < m; sb++)
+      si->scale_factors[ch][sb] =
+          sbc_scale_factor(&si->sbSample[0][ch][sb], blocks, stride);
+
+  memset(si->join, 0, sizeof(si->join));
+  if (si->channelMode != BTIF_SBC_CHNL_MODE_JOINT_STEREO)
+    return;
+
+  for (sb = 0; sb < m - 1; sb++) {
+    for (blk = 0; blk < blocks; blk++) {
+      int64_t l = si->sbSample[blk][0][sb], r = si->sbSample[blk][1][sb];
+
+      enc->sbJoint[blk][0] = (REAL)((l + r) >> 1);
+      enc->sbJoint[blk][1] = (REAL)((l - r) >> 1);
+    }
+    for (ch = 0; ch < 2; ch++)
+      enc->sFactorsJoint[ch][sb] =
+          sbc_scale_factor(&enc->sbJoint[0][ch], blocks, 2);
+    if (enc->sFactorsJoint[0][sb] + enc->sFactorsJoint[1][sb] >=
+        si->scale_factors[0][sb] + si->scale_factors[1][sb])
+      continue;
+
+    si->join[sb] = 1;
+    for (ch = 0; ch < 2; ch++)
+      si->scale_factors[ch][sb] = enc->sFactorsJoint[ch][sb];
+    for (blk = 0; blk < blocks; blk++) {
+      si->sbSample[blk][0][sb] = enc->sbJoint[blk][0];
+      si->sbSample[blk][1][sb] = enc->sbJoint[blk][1];
+    }
+  }
+}
+
+// Packs the subband samples in the encoder's stream info into a frame at
+// |out| and returns its length.
+static uint16_t sbc_pack_frame(btif_sbc_encoder_t *enc, uint8_t *out) {
+  btif_sbc_stream_info_t *si = &enc->streamInfo;
+  uint16_t flen = btif_sbc_frame_len(si);
+  int nch = si->numChannels, m = si->numSubBands;
+  uint8_t crc_data[11];
+  uint32_t pos = 32, crc_bits;
+  int blk, ch, sb;
+
+  sbc_calc_scale_factors(enc);
+  sbc_calc_bits(si);
+
+  memset(out, 0, flen);
+  if (si->mSbcFlag) {
+    out[0] = MSBC_SYNCWORD;
+  } else {
+    out[0] = SBC_SYNCWORD;
+    out[1] = (uint8_t)(si->sampleFreq << 6 | (si->numBlocks / 4 - 1) << 4 |
+                       si->channelMode << 2 | si->allocMethod << 1 |
+                       (m == 8));
+    out[2] = si->bitPool;
+  }
+  if (si->channelMode == BTIF_SBC_CHNL_MODE_JOINT_STEREO)
+    for (sb = 0; sb < m; sb++)
+      sbc_put_bits(out, &pos, si->join[sb], 1);
+  for (ch = 0; ch < nch; ch++)
+    for (sb = 0; sb < m; sb++)
+      sbc_put_bits(out, &pos, si->scale_factors[ch][sb], 4);
+
+  crc_bits = pos - 32;
+  crc_data[0] = out[1];
+  crc_data[1] = out[2];
+  memcpy(&crc_data[2], &out[4], (crc_bits + 7) / 8);
+  si->crc = out[3] = sbc_crc8(crc_data, 16 + crc_bits);
+
+  for (blk = 0; blk < si->numBlocks; blk++) {
+    for (ch = 0; ch < nch; ch++) {
+      for (sb = 0; sb < m; sb++) {
+        int bits = si->bits[ch][sb];
+        int sf = si->scale_factors[ch][sb];
+        uint32_t levels = (1u << bits) - 1;
+        uint64_t v;
+
+        if (!bits)
+          continue;
+        // (sample / 2^(sf + 1) + 1) * levels / 2, rounded down.
+        v = (uint64_t)((int64_t)si->sbSample[blk][ch][sb] +
+                       ((int64_t)1 << (sf + 16)));
+        sbc_put_bits(out, &pos, (uint32_t)((v * levels) >> (sf + 17)), bits);
+      }
+    }
+  }
+  return flen;
+}
+
+void btif_sbc_init_decoder(btif_sbc_decoder_t *Decoder) {
+  memset(Decoder, 0, sizeof(*Decoder));
+}
+
+static void sbc_decode_pcm(btif_sbc_decoder_t *dec, const int32_t *gain,
+                           int16_t *pcm) {
+  btif_sbc_stream_info_t *si = &dec->streamInfo;
+  int nch = si->numChannels, m = si->numSubBands;
+  int32_t *v[2] = {dec->V0, dec->V1};
+  int blk, ch, sb;
+
+  for (blk = 0; blk < si->numBlocks; blk++, pcm += m * nch) {
+    dec->parser.rxState = (dec->parser.rxState + 9) % 10;
+    for (ch = 0; ch < nch; ch++) {
+      REAL *s = si->sbSample[blk][ch];
+
+      if (gain) {
+        for (sb = 0; sb < m; sb++) {
+          int64_t g = ((int64_t)s[sb] * gain[sb]) >> 14;
+
+          s[sb] = (REAL)(g > INT32_MAX ? INT32_MAX
+                                       : g < INT32_MIN ? INT32_MIN : g);
+        }
+      }
+      sbc_synthesize(v[ch], dec->parser.rxState, s, m, pcm + ch, nch);
+    }
+  }
+}
+
+// The per-subband gains in Q14, or NULL when they are all 1.
+static const int32_t *sbc_gain_q14(const float *gains, int32_t *q14) {
+  int sb, unity = 1;
+
+  if (!gains)
+    return NULL;
+  for (sb = 0; sb < BTIF_SBC_MAX_NUM_SB; sb++) {
+    q14[sb] = (int32_t)(gains[sb] * 16384.0f + 0.5f);
+    if (q14[sb] != 16384)
+      unity = 0;
+  }
+  return unity ? NULL : q14;
+}
+
+bt_status_t btif_sbc_decode_frames(btif_sbc_decoder_t *Decoder, uint8_t *Buff,
+                                   uint16_t Len, uint16_t *BytesParsed,
+                                   btif_sbc_pcm_data_t *PcmData,
+                                   uint16_t MaxPcmData, float *gains) {
+  btif_sbc_stream_info_t *si = &Decoder->streamInfo;
+  U8 *stage = Decoder->parser.stageBuff;
+  U16 *staged = &Decoder->parser.stageLen;
+  int32_t gain_q14[BTIF_SBC_MAX_NUM_SB];
+  const int32_t *gain = sbc_gain_q14(gains, gain_q14);
+  uint16_t used = 0;
+
+  *BytesParsed = 0;
+  while (PcmData->dataLen < MaxPcmData) {
+    const uint8_t *frame;
+    uint16_t flen, avail = Len - used;
+    uint16_t pcm_len;
+
+    if (!*staged && !avail)
+      return BT_STS_CONTINUE;
+
+    if (*staged || avail < 3) {
+      // A frame split across calls is gathered in the stage buffer.
+      uint16_t take;
+
+      if (*staged < 3) {
+        take = avail < 3 - *staged ? avail : 3 - *staged;
+        memcpy(stage + *staged, Buff + used, take);
+        *staged += take;
+        used += take;
+        avail -= take;
+        *BytesParsed = used;
+        if (*staged < 3)
+          return BT_STS_CONTINUE;
+      }
+      flen = sbc_parse_header(stage, si);
+      if (!flen || flen > sizeof(Decoder->parser.stageBuff)) {
+        *staged = 0;
+        return BT_STS_FAILED;
+      }
+      if (*staged < flen) {
+        take = avail < flen - *staged ? avail : flen - *staged;
+        memcpy(stage + *staged, Buff + used, take);
+        *staged += take;
+        used += take;
+        *BytesParsed = used;
+        if (*staged < flen)
+          return BT_STS_CONTINUE;
+      }
+      frame = stage;
+    } else {
+      flen = sbc_parse_header(Buff + used, si);
+      if (!flen) {
+        *BytesParsed = used + 1;
+        return BT_STS_FAILED;
+      }
+      if (avail < flen) {
+        if (flen > sizeof(Decoder->parser.stageBuff)) {
+          *BytesParsed = Len;
+          return BT_STS_FAILED;
+        }
+        memcpy(stage, Buff + used, avail);
+        *staged = avail;
+        *BytesParsed = Len;
+        return BT_STS_CONTINUE;
+      }
+      frame = Buff + used;
+    }
+
+    pcm_len = si->numBlocks * si->numSubBands * si->numChannels * 2;
+    Decoder->maxPcmLen = pcm_len;
+    if (MaxPcmData - PcmData->dataLen < pcm_len)
+      return BT_STS_NO_RESOURCES;
+
+    if (frame == stage) {
+      *staged = 0;
+    } else {
+      used += flen;
+      *BytesParsed = used;
+    }
+    if (!sbc_unpack_frame(frame, flen, si))
+      return BT_STS_FAILED;
+
+    sbc_decode_pcm(Decoder, gain,
+                   (int16_t *)(PcmData->data + PcmData->dataLen));
+    PcmData->dataLen += pcm_len;
+    PcmData->sampleFreq = si->sampleFreq;
+    PcmData->numChannels = si->numChannels;
+  }
+  return BT_STS_SUCCESS;
+}
+
+bt_status_t btif_sbc_decode_frames_parser(btif_sbc_decoder_t *Decoder,
+                                          uint8_t *Buff, uint16_t Len,
+                                          uint16_t *BytesParsed) {
+  btif_sbc_stream_info_t *si = &Decoder->streamInfo;
+  uint16_t flen;
+
+  *BytesParsed = 0;
+  if (Len < 3)
+    return BT_STS_FAILED;
+  flen = sbc_parse_header(Buff, si);
+  if (!flen)
+    return BT_STS_FAILED;
+  Decoder->maxPcmLen = si->numBlocks * si->numSubBands * si->numChannels * 2;
+  *BytesParsed = flen;
+  return BT_STS_SUCCESS;
+}
+
+void btif_sbc_init_encoder(btif_sbc_encoder_t *Encoder) {
+  memset(Encoder, 0, sizeof(*Encoder));
+  Encoder->X0pos = SBC_X_LEN;
+  Encoder->X1pos = SBC_X_LEN;
+}
+
+static void sbc_analyze_frame(btif_sbc_encoder_t *enc, const int16_t *pcm) {
+  btif_sbc_stream_info_t *si = &enc->streamInfo;
+  int nch = si->numChannels, m = si->numSubBands;
+  int blk;
+
+  for (blk = 0; blk < si->numBlocks; blk++, pcm += m * nch) {
+    sbc_analyze(enc->X0, &enc->X0pos, pcm, nch, m, si->sbSample[blk][0]);
+    if (nch == 2)
+      sbc_analyze(enc->X1, &enc->X1pos, pcm + 1, nch, m,
+                  si->sbSample[blk][1]);
+  }
+}
+
+static int sbc_encoder_config(btif_sbc_stream_info_t *si) {
+  if (si->mSbcFlag)
+    sbc_set_msbc(si);
+  si->numChannels = si->channelMode == BTIF_SBC_CHNL_MODE_MONO ? 1 : 2;
+  return sbc_check_config(si);
+}
+
+bt_status_t btif_sbc_encode_frames(btif_sbc_encoder_t *Encoder,
+                                   btif_sbc_pcm_data_t *PcmData,
+                                   uint16_t *BytesEncoded, uint8_t *Buff,
+                                   uint16_t *Len, uint16_t MaxSbcData) {
+  btif_sbc_stream_info_t *si = &Encoder->streamInfo;
+  uint16_t flen, pcm_len;
+
+  *BytesEncoded = 0;
+  *Len = 0;
+  if (!sbc_encoder_config(si))
+    return BT_STS_FAILED;
+
+  flen = btif_sbc_frame_len(si);
+  pcm_len = si->numBlocks * si->numSubBands * si->numChannels * 2;
+  while (PcmData->dataLen - *BytesEncoded >= pcm_len &&
+         MaxSbcData - *Len >= flen) {
+    sbc_analyze_frame(Encoder,
+                      (const int16_t *)(PcmData->data + *BytesEncoded));
+    *Len += sbc_pack_frame(Encoder, Buff + *Len);
+    *BytesEncoded += pcm_len;
+  }
+  return BT_STS_SUCCESS;
+}
+
+// After a frame is concealed, runs its PCM through the analysis and the
+// decoder's synthesis, so the frames after it decode from the state a
+// received frame would have left.
+void btif_plc_update_sbc_decoder_state(btif_sbc_encoder_t *Encoder,
+                                       btif_sbc_pcm_data_t *PcmData,
+                                       btif_sbc_decoder_t *Decoder,
+                                       float *gain) {
+  btif_sbc_stream_info_t *si = &Encoder->streamInfo;
+  int32_t gain_q14[BTIF_SBC_MAX_NUM_SB];
+  int16_t pcm[BTIF_MSBC_BLOCKS * BTIF_SBC_MAX_NUM_SB];
+  uint16_t pcm_len;
+
+  if (!sbc_encoder_config(si) || si->numChannels != 1)
+    return;
+  pcm_len = si->numBlocks * si->numSubBands * 2;
+  if (PcmData->dataLen < pcm_len || pcm_len > sizeof(pcm))
+    return;
+
+  sbc_analyze_frame(Encoder, (const int16_t *)PcmData->data);
+  Decoder->streamInfo.numBlocks = si->numBlocks;
+  Decoder->streamInfo.numSubBands = si->numSubBands;
+  Decoder->streamInfo.numChannels = 1;
+  memcpy(Decoder->streamInfo.sbSample, si->sbSample,
+         si->numBlocks * sizeof(si->sbSample[0]));
+  sbc_decode_pcm(Decoder, sbc_gain_q14(gain, gain_q14), pcm);
+}
@@ -0,0 +1,206 @@
+#include "sbc_local.h"
+#include <string.h>
+
+// The multiplies go through these four operations. With the DSP extension
+// they are single instructions; otherwise the C forms below give the same
+// results bit for bit, wrapping where the instructions wrap.
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "cmsis.h"
+
+// acc + lo(x) * lo(y) + hi(x) * hi(y)
+#define sbc_smlad(x, y, acc) ((int32_t)__SMLAD((x), (y), (uint32_t)(acc)))
+
+// acc + ((a * lo(b)) >> 16)
+static inline int32_t sbc_smlawb(int32_t a, uint32_t b, int32_t acc) {
+  int32_t r;
+
+  __ASM("smlawb %0, %1, %2, %3" : "=r"(r) : "r"(a), "r"(b), "r"(acc));
+  return r;
+}
+
+// acc + ((a * hi(b)) >> 16)
+static inline int32_t sbc_smlawt(int32_t a, uint32_t b, int32_t acc) {
+  int32_t r;
+
+  __ASM("smlawt %0, %1, %2, %3" : "=r"(r) : "r"(a), "r"(b), "r"(acc));
+  return r;
+}
+#else
+static inline int32_t sbc_smlad(uint32_t x, uint32_t y, int32_t acc) {
+  return (int32_t)((uint32_t)acc +
+                   (uint32_t)((int16_t)x * (int16_t)y) +
+                   (uint32_t)((int16_t)(x >> 16) * (int16_t)(y >> 16)));
+}
+
+static inline int32_t sbc_smlawb(int32_t a, uint32_t b, int32_t acc) {
+  return (int32_t)((uint32_t)acc +
+                   (uint32_t)(int32_t)(((int64_t)a * (int16_t)b) >> 16));
+}
+
+static inline int32_t sbc_smlawt(int32_t a, uint32_t b, int32_t acc) {
+  return (int32_t)((uint32_t)acc + (uint32_t)(int32_t)(((int64_t)a *
+                                                        (int16_t)(b >> 16)) >>
+                                                       16));
+}
+#endif
+
+static inline uint32_t sbc_load_pair(const int16_t *p) {
+  uint32_t w;
+
+  memcpy(&w, p, sizeof(w));
+  return w;
+}
+
+static inline int16_t sbc_sat16(int32_t v) {
+  if (v > 32767)
+    return 32767;
+  if (v < -32768)
+    return -32768;
+  return (int16_t)v;
+}
+
+// The spec's analysis, with X[0] the newest sample:
+//
+//   Y[k] = sum(j = 0 .. 4) C[k + 2Mj] * X[k + 2Mj],   k = 0 .. 2M - 1
+//   S[i] = sum(k) cos((i + 0.5) * (k - M/2) * pi / M) * Y[k]
+//
+// The cosine repeats for k and M - k and changes sign between M + k and
+// 2M - k, and is 1 at M/2 and 0 at 3M/2, so S only needs the M folded sums
+// Y[r] + Y[M - r], Y[M + r] - Y[2M - r] and Y[M/2]. The history keeps each
+// block as X[1], X[M - 1], X[2], X[M - 2], ..., X[0], X[M/2], which puts
+// the two samples of a fold in one word: the window is one SMLAD per fold
+// and segment, plus three multiplies for X[0] and X[M/2]. The folds stay at
+// 32 bits, so the matrix is one SMLAWB/SMLAWT per fold.
+static inline void sbc_analyze_m(int16_t *x, uint16_t *pos, const int16_t *pcm,
+                                 int stride, const int m, int32_t *sb) {
+  const int half = m / 2;
+  const int fshift = m == 8 ? 1 : 0;
+  const uint32_t *win = m == 8 ? sbc_enc_win8 : sbc_enc_win4;
+  const uint32_t *mat = m == 8 ? sbc_enc_mat8 : sbc_enc_mat4;
+  int32_t fsum[3] = {0}, fdiff[3] = {0}, f0 = 0, fmid = 0;
+  int32_t fold[8];
+  int16_t *blk;
+  int i, j, r;
+
+  // The 9 newest blocks move back to the end once the window reaches the
+  // start; the first block after init starts on the zeroed tail.
+  if (*pos > SBC_X_LEN - 9 * m) {
+    *pos = SBC_X_LEN - 9 * m;
+  } else if (*pos < m) {
+    memmove(x + SBC_X_LEN - 9 * m, x + *pos, 9 * m * sizeof(*x));
+    *pos = SBC_X_LEN - 9 * m;
+  }
+  *pos -= m;
+  blk = x + *pos;
+
+  // X[r] is pcm[M - 1 - r].
+  for (r = 1; r < half; r++) {
+    blk[2 * r - 2] = pcm[(m - 1 - r) * stride];
+    blk[2 * r - 1] = pcm[(r - 1) * stride];
+  }
+  blk[m - 2] = pcm[(m - 1) * stride];
+  blk[m - 1] = pcm[(half - 1) * stride];
+
+  for (j = 0; j < 5; j++, win += m) {
+    const int16_t *a = blk + 2 * j * m;
+    const int16_t *b = a + m;
+
+    for (r = 0; r < half - 1; r++) {
+      fsum[r] = sbc_smlad(sbc_load_pair(a + 2 * r), win[r], fsum[r]);
+      fdiff[r] =
+          sbc_smlad(sbc_load_pair(b + 2 * r), win[half - 1 + r], fdiff[r]);
+    }
+    f0 += a[m - 2] * (int16_t)win[m - 2] +
+          b[m - 2] * (int16_t)(win[m - 2] >> 16);
+    fmid += a[m - 1] * (int16_t)win[m - 1];
+  }
+
+  // Q16 PCM units for the matrix. Rounding them to 16 bits here would cost
+  // the 8-subband analysis about 14 dB against the double model.
+#define SBC_FOLD(v) (((v) + ((1 << fshift) >> 1)) >> fshift)
+  fold[0] = SBC_FOLD(f0);
+  for (r = 0; r < half - 1; r++) {
+    fold[1 + r] = SBC_FOLD(fsum[r]);
+    fold[half + r] = SBC_FOLD(fdiff[r]);
+  }
+  fold[m - 1] = SBC_FOLD(fmid);
+#undef SBC_FOLD
+
+  for (i = 0; i < m; i++, mat += half) {
+    int32_t acc = (fold[m - 1] + 1) >> 1;
+
+    for (r = 0; r < half; r++) {
+      acc = sbc_smlawb(fold[2 * r], mat[r], acc);
+      acc = sbc_smlawt(fold[2 * r + 1], mat[r], acc);
+    }
+    sb[i] = acc;
+  }
+}
+
+void sbc_analyze(int16_t *x, uint16_t *pos, const int16_t *pcm, int stride,
+                 int subbands, int32_t *sb) {
+  if (subbands == 8)
+    sbc_analyze_m(x, pos, pcm, stride, 8, sb);
+  else
+    sbc_analyze_m(x, pos, pcm, stride, 4, sb);
+}
+
+// The spec's synthesis, with V shifted by 2M for each block:
+//
+//   V[k] = sum(i) cos((i + 0.5) * (k + M/2) * pi / M) * S[i],  k < 2M
+//   x[j] = sum(a = 0 .. 9) D[Ma + j] * V[2Ma + (a odd ? M : 0) + j]
+//
+// V[M - k] = -V[k], V[M/2] = 0 and V[3M - k] = V[k] leave M rows to
+// compute. V is a ring of 10 blocks of 2M rather than a shifting buffer,
+// and each SMLAWB/SMLAWT takes one of the two coefficients of a word.
+static inline void sbc_synthesize_m(int32_t *v, int vpos, const int32_t *sb,
+                                    const int m, int16_t *pcm, int stride) {
+  const int half = m / 2;
+  const uint32_t *mat = m == 8 ? sbc_dec_mat8 : sbc_dec_mat4;
+  const uint32_t *win = m == 8 ? sbc_dec_win8 : sbc_dec_win4;
+  int32_t *blk = v + vpos * 2 * m;
+  int32_t t[8], acc[8];
+  int a, j, k;
+
+  for (k = 0; k < m; k++, mat += half) {
+    int32_t s = 0;
+
+    for (j = 0; j < half; j++) {
+      s = sbc_smlawb(sb[2 * j], mat[j], s);
+      s = sbc_smlawt(sb[2 * j + 1], mat[j], s);
+    }
+    t[k] = s;
+  }
+  for (k = 0; k < half; k++) {
+    blk[k] = t[k];
+    blk[m + 1 + k] = t[half + k];
+  }
+  blk[half] = 0;
+  for (k = 1; k < half; k++) {
+    blk[m - k] = -t[k];
+    blk[2 * m - k] = t[half + k - 1];
+  }
+  blk[m] = -t[0];
+
+  // V is Q13 and D Q14, so the sums are Q11.
+  for (j = 0; j < m; j++)
+    acc[j] = 1 << 10;
+  for (a = 0; a < 10; a++, win += half) {
+    const int32_t *va = v + ((vpos + a) % 10) * 2 * m + (a & 1) * m;
+
+    for (j = 0; j < half; j++) {
+      acc[2 * j] = sbc_smlawb(va[2 * j], win[j], acc[2 * j]);
+      acc[2 * j + 1] = sbc_smlawt(va[2 * j + 1], win[j], acc[2 * j + 1]);
+    }
+  }
+  for (j = 0; j < m; j++)
+    pcm[j * stride] = sbc_sat16(acc[j] >> 11);
+}
+
+void sbc_synthesize(int32_t *v, int vpos, const int32_t *sb, int subbands,
+                    int16_t *pcm, int stride) {
+  if (subbands == 8)
+    sbc_synthesize_m(v, vpos, sb, 8, pcm, stride);
+  else
+    sbc_synthesize_m(v, vpos, sb, 4, pcm, stride);
+}
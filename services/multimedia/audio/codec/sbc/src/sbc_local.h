@@ -0,0 +1,54 @@
+#ifndef __SBC_LOCAL_H__
+#define __SBC_LOCAL_H__
+
+#include "codec_sbc.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_SYNCWORD 0x9C
+#define MSBC_SYNCWORD 0xAD
+#define MSBC_BITPOOL 26
+#define MSBC_FRAME_LEN 57
+
+// Length of the X0/X1 and V0/V1 histories in the encoder and decoder.
+#define SBC_X_LEN 160
+#define SBC_V_LEN 160
+
+// Two 16-bit values in one word, |lo| in the bottom half: the operand
+// layout of SMLAD and of SMLAWB/SMLAWT.
+#define SBC_PAIR(lo, hi)                                                       \
+  ((uint32_t)(uint16_t)(lo) | (uint32_t)(uint16_t)(hi) << 16)
+
+// Filterbank tables (sbc_tables.c); the suffix is the number of subbands.
+extern const uint32_t sbc_enc_win4[5 * 4];
+extern const uint32_t sbc_enc_win8[5 * 8];
+extern const uint32_t sbc_enc_mat4[4 * 2];
+extern const uint32_t sbc_enc_mat8[8 * 4];
+extern const uint32_t sbc_dec_mat4[4 * 2];
+extern const uint32_t sbc_dec_mat8[8 * 4];
+extern const uint32_t sbc_dec_win4[10 * 2];
+extern const uint32_t sbc_dec_win8[10 * 4];
+
+// Subband samples are Q15 in units of 16-bit PCM, so a scale factor sf
+// bounds them by 1 << (sf + 16).
+
+// Analysis of one block of |subbands| samples of one channel, read
+// |stride| samples apart, oldest first. |x| and |pos| are the channel's X
+// history and its position, SBC_X_LEN after btif_sbc_init_encoder().
+void sbc_analyze(int16_t *x, uint16_t *pos, const int16_t *pcm, int stride,
+                 int subbands, int32_t *sb);
+
+// Synthesis of one block of one channel. |vpos| is the V block the new
+// values go to, one lower (mod 10) for each block and shared by the
+// channels of a stream; |pcm| gets |subbands| samples |stride| apart.
+void sbc_synthesize(int32_t *v, int vpos, const int32_t *sb, int subbands,
+                    int16_t *pcm, int stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,110 @@
+#include "sbc_local.h"
+
+// Fixed-point forms of the SBC filterbank, from the prototype filters of
+// A2DP spec tables 12.23 (4 subbands) and 12.24 (8 subbands) and the cosine
+// modulation matrices, laid out in the order the loops in sbc_filter.c read
+// them.
+
+// Analysis window C[] in Q16 (Q17 for 8 subbands, to keep the same
+// precision). For each 2M-sample segment j of the window: the pairs
+// (C[r], C[M - r]) and (C[M + r], -C[2M - r]) for r = 1 .. M/2 - 1, then
+// (C[0], C[M]) and (C[M/2], 0), all offset by 2M * j.
+const uint32_t sbc_enc_win4[20] = {
+    SBC_PAIR(35, 179), SBC_PAIR(255, 201), SBC_PAIR(0, 251), SBC_PAIR(98, 0),
+    SBC_PAIR(1339, 2110), SBC_PAIR(402, 5089), SBC_PAIR(715, 1696),
+    SBC_PAIR(1892, 0), SBC_PAIR(12779, 18470), SBC_PAIR(18470, -12779),
+    SBC_PAIR(8886, 19288), SBC_PAIR(16164, 0), SBC_PAIR(-5089, 402),
+    SBC_PAIR(2110, -1339), SBC_PAIR(-8886, 1696), SBC_PAIR(-1889, 0),
+    SBC_PAIR(-201, 255), SBC_PAIR(179, -35), SBC_PAIR(-715, 251),
+    SBC_PAIR(122, 0),
+};
+
+// Analysis matrix cos((i + 0.5) * (k - M/2) * pi / M) in Q15, one row per
+// subband i over the folded window outputs: k = 0 .. M/2 - 1, k = M + 1 ..
+// 3M/2 - 1, and a zero for k = M/2, whose cosine is 1 for every row.
+const uint32_t sbc_enc_mat4[8] = {
+    SBC_PAIR(23170, 30274), SBC_PAIR(12540, 0), SBC_PAIR(-23170, 12540),
+    SBC_PAIR(-30274, 0), SBC_PAIR(-23170, -12540), SBC_PAIR(30274, 0),
+    SBC_PAIR(23170, -30274), SBC_PAIR(-12540, 0),
+};
+
+// Synthesis matrix cos((i + 0.5) * (k + M/2) * pi / M) in Q14 for the
+// rows of V that are not mirrors of others: k = 0 .. M/2 - 1 and k = M + 1
+// .. 3M/2.
+const uint32_t sbc_dec_mat4[8] = {
+    SBC_PAIR(11585, -11585), SBC_PAIR(-11585, 11585), SBC_PAIR(6270, -15137),
+    SBC_PAIR(15137, -6270), SBC_PAIR(-15137, -6270), SBC_PAIR(6270, 15137),
+    SBC_PAIR(-16384, -16384), SBC_PAIR(-16384, -16384),
+};
+
+// Synthesis window D[] = -M * C[] in Q14, in natural order.
+const uint32_t sbc_dec_win4[20] = {
+    SBC_PAIR(0, -35), SBC_PAIR(-98, -179), SBC_PAIR(-251, -255),
+    SBC_PAIR(-122, 201), SBC_PAIR(-715, -1339), SBC_PAIR(-1892, -2110),
+    SBC_PAIR(-1696, -402), SBC_PAIR(1889, 5089), SBC_PAIR(-8886, -12779),
+    SBC_PAIR(-16164, -18470), SBC_PAIR(-19288, -18470),
+    SBC_PAIR(-16164, -12779), SBC_PAIR(8886, 5089), SBC_PAIR(1889, -402),
+    SBC_PAIR(-1696, -2110), SBC_PAIR(-1892, -1339), SBC_PAIR(715, 201),
+    SBC_PAIR(-122, -255), SBC_PAIR(-251, -179), SBC_PAIR(-98, -35),
+};
+
+const uint32_t sbc_enc_win8[40] = {
+    SBC_PAIR(21, 234), SBC_PAIR(45, 194), SBC_PAIR(73, 149), SBC_PAIR(276, 458),
+    SBC_PAIR(261, 216), SBC_PAIR(212, 23), SBC_PAIR(0, 264), SBC_PAIR(108, 0),
+    SBC_PAIR(1052, 2008), SBC_PAIR(1371, 2126), SBC_PAIR(1671, 2085),
+    SBC_PAIR(1161, 6971), SBC_PAIR(382, 5122), SBC_PAIR(-644, 3422),
+    SBC_PAIR(742, 1696), SBC_PAIR(1921, 0), SBC_PAIR(10877, 19057),
+    SBC_PAIR(12789, 18449), SBC_PAIR(14575, 17467), SBC_PAIR(19057, -10877),
+    SBC_PAIR(18449, -12789), SBC_PAIR(17467, -14575), SBC_PAIR(8913, 19262),
+    SBC_PAIR(16157, 0), SBC_PAIR(-6971, 1161), SBC_PAIR(-5122, 382),
+    SBC_PAIR(-3422, -644), SBC_PAIR(2008, -1052), SBC_PAIR(2126, -1371),
+    SBC_PAIR(2085, -1671), SBC_PAIR(-8913, 1696), SBC_PAIR(-1919, 0),
+    SBC_PAIR(-458, 276), SBC_PAIR(-216, 261), SBC_PAIR(-23, 212),
+    SBC_PAIR(234, -21), SBC_PAIR(194, -45), SBC_PAIR(149, -73),
+    SBC_PAIR(-742, 264), SBC_PAIR(118, 0),
+};
+
+const uint32_t sbc_enc_mat8[32] = {
+    SBC_PAIR(23170, 27246), SBC_PAIR(30274, 32138), SBC_PAIR(18205, 12540),
+    SBC_PAIR(6393, 0), SBC_PAIR(-23170, -6393), SBC_PAIR(12540, 27246),
+    SBC_PAIR(-32138, -30274), SBC_PAIR(-18205, 0), SBC_PAIR(-23170, -32138),
+    SBC_PAIR(-12540, 18205), SBC_PAIR(6393, 30274), SBC_PAIR(27246, 0),
+    SBC_PAIR(23170, -18205), SBC_PAIR(-30274, 6393), SBC_PAIR(27246, -12540),
+    SBC_PAIR(-32138, 0), SBC_PAIR(23170, 18205), SBC_PAIR(-30274, -6393),
+    SBC_PAIR(-27246, -12540), SBC_PAIR(32138, 0), SBC_PAIR(-23170, 32138),
+    SBC_PAIR(-12540, -18205), SBC_PAIR(-6393, 30274), SBC_PAIR(-27246, 0),
+    SBC_PAIR(-23170, 6393), SBC_PAIR(12540, -27246), SBC_PAIR(32138, -30274),
+    SBC_PAIR(18205, 0), SBC_PAIR(23170, -27246), SBC_PAIR(30274, -32138),
+    SBC_PAIR(-18205, 12540), SBC_PAIR(-6393, 0),
+};
+
+const uint32_t sbc_dec_mat8[32] = {
+    SBC_PAIR(11585, -11585), SBC_PAIR(-11585, 11585), SBC_PAIR(11585, -11585),
+    SBC_PAIR(-11585, 11585), SBC_PAIR(9102, -16069), SBC_PAIR(3196, 13623),
+    SBC_PAIR(-13623, -3196), SBC_PAIR(16069, -9102), SBC_PAIR(6270, -15137),
+    SBC_PAIR(15137, -6270), SBC_PAIR(-6270, 15137), SBC_PAIR(-15137, 6270),
+    SBC_PAIR(3196, -9102), SBC_PAIR(13623, -16069), SBC_PAIR(16069, -13623),
+    SBC_PAIR(9102, -3196), SBC_PAIR(-13623, 3196), SBC_PAIR(16069, 9102),
+    SBC_PAIR(-9102, -16069), SBC_PAIR(-3196, 13623), SBC_PAIR(-15137, -6270),
+    SBC_PAIR(6270, 15137), SBC_PAIR(15137, 6270), SBC_PAIR(-6270, -15137),
+    SBC_PAIR(-16069, -13623), SBC_PAIR(-9102, -3196), SBC_PAIR(3196, 9102),
+    SBC_PAIR(13623, 16069), SBC_PAIR(-16384, -16384), SBC_PAIR(-16384, -16384),
+    SBC_PAIR(-16384, -16384), SBC_PAIR(-16384, -16384),
+};
+
+const uint32_t sbc_dec_win8[40] = {
+    SBC_PAIR(0, -21), SBC_PAIR(-45, -73), SBC_PAIR(-108, -149),
+    SBC_PAIR(-194, -234), SBC_PAIR(-264, -276), SBC_PAIR(-261, -212),
+    SBC_PAIR(-118, 23), SBC_PAIR(216, 458), SBC_PAIR(-742, -1052),
+    SBC_PAIR(-1371, -1671), SBC_PAIR(-1921, -2085), SBC_PAIR(-2126, -2008),
+    SBC_PAIR(-1696, -1161), SBC_PAIR(-382, 644), SBC_PAIR(1919, 3422),
+    SBC_PAIR(5122, 6971), SBC_PAIR(-8913, -10877), SBC_PAIR(-12789, -14575),
+    SBC_PAIR(-16157, -17467), SBC_PAIR(-18449, -19057),
+    SBC_PAIR(-19262, -19057), SBC_PAIR(-18449, -17467),
+    SBC_PAIR(-16157, -14575), SBC_PAIR(-12789, -10877), SBC_PAIR(8913, 6971),
+    SBC_PAIR(5122, 3422), SBC_PAIR(1919, 644), SBC_PAIR(-382, -1161),
+    SBC_PAIR(-1696, -2008), SBC_PAIR(-2126, -2085), SBC_PAIR(-1921, -1671),
+    SBC_PAIR(-1371, -1052), SBC_PAIR(742, 458), SBC_PAIR(216, 23),
+    SBC_PAIR(-118, -212), SBC_PAIR(-261, -276), SBC_PAIR(-264, -234),
+    SBC_PAIR(-194, -149), SBC_PAIR(-108, -73), SBC_PAIR(-45, -21),
+};
@@ -0,0 +1,794 @@
+#include "sbc_local.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// First halves of the prototype filters of A2DP spec tables 12.23 and
+// 12.24, in the spec's decimal form; the rest is the mirror image.
+static const double proto4[21] = {
+    0.00000000E+00,  5.36548976E-04,  1.49188357E-03,  2.73370904E-03,
+    3.83720193E-03,  3.89205149E-03,  1.86581691E-03,  -3.06012286E-03,
+    -1.09137620E-02, -2.04385087E-02, -2.88757392E-02, -3.21939290E-02,
+    -2.58767811E-02, -6.13245186E-03, 2.88217274E-02,  7.76463494E-02,
+    1.35593274E-01,  1.94987841E-01,  2.46636662E-01,  2.81828203E-01,
+    2.94315332E-01,
+};
+
+static const double proto8[41] = {
+    0.00000000E+00,  1.56575398E-04,  3.43256425E-04,  5.54620202E-04,
+    8.23919506E-04,  1.13992507E-03,  1.47640169E-03,  1.78371725E-03,
+    2.01182542E-03,  2.10371989E-03,  1.99454554E-03,  1.61656283E-03,
+    9.02154502E-04,  -1.78805361E-04, -1.64973098E-03, -3.49717454E-03,
+    -5.65949473E-03, -8.02941163E-03, -1.04584443E-02, -1.27472335E-02,
+    -1.46525263E-02, -1.59045603E-02, -1.62208471E-02, -1.53184106E-02,
+    -1.29371806E-02, -8.85757540E-03, -2.91746183E-03, 4.91578024E-03,
+    1.46404076E-02,  2.61098752E-02,  3.90751381E-02,  5.31873032E-02,
+    6.79989431E-02,  8.29847578E-02,  9.75753918E-02,  1.11196689E-01,
+    1.23264548E-01,  1.33264415E-01,  1.40753505E-01,  1.45389847E-01,
+    1.46955068E-01,
+};
+
+// The spec's window C[], with the sign of every other 2M segment flipped.
+static double window_coef(int m, int n) {
+  const double *p = m == 8 ? proto8 : proto4;
+  double c = n <= 5 * m ? p[n] : p[10 * m - n];
+
+  return (n / (2 * m)) & 1 ? -c : c;
+}
+
+// Double precision analysis and synthesis, straight from the spec.
+struct model {
+  int m;
+  double x[80];
+  double v[160];
+};
+
+static void model_analyze(struct model *md, const int16_t *pcm, int stride,
+                          double *s) {
+  int m = md->m, i, j, k;
+  double y[16];
+
+  memmove(md->x + m, md->x, (9 * m) * sizeof(double));
+  for (i = 0; i < m; i++)
+    md->x[m - 1 - i] = pcm[i * stride];
+  for (k = 0; k < 2 * m; k++) {
+    y[k] = 0;
+    for (j = 0; j < 5; j++)
+      y[k] += window_coef(m, k + 2 * m * j) * md->x[k + 2 * m * j];
+  }
+  for (i = 0; i < m; i++) {
+    s[i] = 0;
+    for (k = 0; k < 2 * m; k++)
+      s[i] += cos((i + 0.5) * (k - m / 2.0) * M_PI / m) * y[k];
+  }
+}
+
+static void model_synthesize(struct model *md, const double *s, double *out) {
+  int m = md->m, i, j, k;
+
+  memmove(md->v + 2 * m, md->v, (18 * m) * sizeof(double));
+  for (k = 0; k < 2 * m; k++) {
+    md->v[k] = 0;
+    for (i = 0; i < m; i++)
+      md->v[k] += cos((i + 0.5) * (k + m / 2.0) * M_PI / m) * s[i];
+  }
+  for (j = 0; j < m; j++) {
+    out[j] = 0;
+    for (i = 0; i < 5; i++) {
+      out[j] += -m * window_coef(m, 2 * m * i + j) * md->v[4 * m * i + j];
+      out[j] += -m * window_coef(m, 2 * m * i + m + j) *
+                md->v[4 * m * i + 3 * m + j];
+    }
+  }
+}
+
+static uint32_t lcg_next(uint32_t *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+// Music-like test signal: a few tones and some noise, near full scale.
+static void make_signal(int16_t *pcm, int frames, int channels,
+                        double sample_rate, uint32_t seed) {
+  int n, ch;
+
+  for (n = 0; n < frames; n++) {
+    for (ch = 0; ch < channels; ch++) {
+      double t = n / sample_rate;
+      double v = 9000 * sin(2 * M_PI * (220 + 110 * ch) * t) +
+                 6000 * sin(2 * M_PI * 1375 * t + ch) +
+                 3000 * sin(2 * M_PI * 5200 * t) +
+                 ((int)(lcg_next(&seed) & 0x3FF) - 512);
+
+      pcm[n * channels + ch] = (int16_t)v;
+    }
+  }
+}
+
+static double snr_db(const double *ref, const double *out, int n) {
+  double sig = 0, err = 0;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    sig += ref[i] * ref[i];
+    err += (out[i] - ref[i]) * (out[i] - ref[i]);
+  }
+  return 10 * log10(sig / (err > 0 ? err : 1e-30));
+}
+
+// The fixed-point filterbank against the double model, each half on its
+// own.
+static void test_filterbank_vs_model(void) {
+  static int16_t pcm[4096];
+  int m;
+
+  make_signal(pcm, 4096, 1, 44100, 1);
+  for (m = 4; m <= 8; m += 4) {
+    static double ref_s[4096], got_s[4096], ref_x[4096], got_x[4096];
+    struct model ma = {m, {0}, {0}}, ms = {m, {0}, {0}};
+    int16_t x[SBC_X_LEN] = {0};
+    int32_t v[SBC_V_LEN] = {0};
+    uint16_t pos = SBC_X_LEN;
+    int vpos = 0, blk, i;
+
+    for (blk = 0; blk < 4096 / m; blk++) {
+      int32_t sb[8];
+      int16_t out[8];
+      double s[8];
+
+      model_analyze(&ma, pcm + blk * m, 1, ref_s + blk * m);
+      sbc_analyze(x, &pos, pcm + blk * m, 1, m, sb);
+      for (i = 0; i < m; i++)
+        got_s[blk * m + i] = sb[i] / 32768.0;
+
+      // Synthesis of the model's subband samples both ways.
+      for (i = 0; i < m; i++) {
+        sb[i] = (int32_t)lrint(ref_s[blk * m + i] * 32768);
+        s[i] = sb[i] / 32768.0;
+      }
+      model_synthesize(&ms, s, ref_x + blk * m);
+      vpos = (vpos + 9) % 10;
+      sbc_synthesize(v, vpos, sb, m, out, 1);
+      for (i = 0; i < m; i++)
+        got_x[blk * m + i] = out[i];
+    }
+    printf("%d subbands: analysis %.1f dB, synthesis %.1f dB\n", m,
+           snr_db(ref_s, got_s, 4096), snr_db(ref_x, got_x, 4096));
+    assert(snr_db(ref_s, got_s, 4096) > 85);
+    assert(snr_db(ref_x, got_x, 4096) > 80);
+  }
+}
+
+static void encoder_setup(btif_sbc_encoder_t *enc, int freq, int blocks,
+                          int mode, int alloc, int subbands, int bitpool) {
+  btif_sbc_init_encoder(enc);
+  enc->streamInfo.sampleFreq = (uint8_t)freq;
+  enc->streamInfo.numBlocks = (uint8_t)blocks;
+  enc->streamInfo.channelMode = (uint8_t)mode;
+  enc->streamInfo.allocMethod = (uint8_t)alloc;
+  enc->streamInfo.numSubBands = (uint8_t)subbands;
+  enc->streamInfo.numChannels = mode == BTIF_SBC_CHNL_MODE_MONO ? 1 : 2;
+  enc->streamInfo.bitPool = (uint8_t)bitpool;
+}
+
+static void encoder_setup_msbc(btif_sbc_encoder_t *enc) {
+  btif_sbc_init_encoder(enc);
+  enc->streamInfo.mSbcFlag = 1;
+}
+
+// The mSBC frame for silence, as carried on every HFP wideband link.
+static const uint8_t msbc_silence[MSBC_FRAME_LEN] = {
+    0xad, 0x00, 0x00, 0xc5, 0x00, 0x00, 0x00, 0x00, 0x77, 0x6d, 0xb6, 0xdd,
+    0xdb, 0x6d, 0xb7, 0x76, 0xdb, 0x6d, 0xdd, 0xb6, 0xdb, 0x77, 0x6d, 0xb6,
+    0xdd, 0xdb, 0x6d, 0xb7, 0x76, 0xdb, 0x6d, 0xdd, 0xb6, 0xdb, 0x77, 0x6d,
+    0xb6, 0xdd, 0xdb, 0x6d, 0xb7, 0x76, 0xdb, 0x6d, 0xdd, 0xb6, 0xdb, 0x77,
+    0x6d, 0xb6, 0xdd, 0xdb, 0x6d, 0xb7, 0x76, 0xdb, 0x6c,
+};
+
+static void test_msbc_silence_frame(void) {
+  static btif_sbc_encoder_t enc;
+  static btif_sbc_decoder_t dec;
+  int16_t pcm[120] = {0}, out[120];
+  uint8_t frame[64];
+  btif_sbc_pcm_data_t in = {BTIF_SBC_CHNL_SAMPLE_FREQ_16, 1, sizeof(pcm),
+                            (uint8_t *)pcm};
+  btif_sbc_pcm_data_t dec_pcm = {0, 0, 0, (uint8_t *)out};
+  uint16_t consumed, len;
+  int i;
+
+  encoder_setup_msbc(&enc);
+  assert(btif_sbc_frame_len(&enc.streamInfo) == MSBC_FRAME_LEN);
+  assert(btif_sbc_encode_frames(&enc, &in, &consumed, frame, &len, 0xFFFF) ==
+         BT_STS_SUCCESS);
+  assert(consumed == sizeof(pcm) && len == MSBC_FRAME_LEN);
+  assert(memcmp(frame, msbc_silence, MSBC_FRAME_LEN) == 0);
+
+  btif_sbc_init_decoder(&dec);
+  assert(btif_sbc_decode_frames(&dec, (uint8_t *)msbc_silence, MSBC_FRAME_LEN,
+                                &consumed, &dec_pcm, sizeof(out),
+                                NULL) == BT_STS_SUCCESS);
+  assert(consumed == MSBC_FRAME_LEN && dec_pcm.dataLen == sizeof(out));
+  assert(dec_pcm.numChannels == 1 &&
+         dec_pcm.sampleFreq == BTIF_SBC_CHNL_SAMPLE_FREQ_16);
+  for (i = 0; i < 120; i++)
+    assert(out[i] == 0);
+}
+
+static void test_frame_len(void) {
+  static btif_sbc_encoder_t enc;
+
+  // The A2DP high quality settings: 44.1 kHz joint stereo, bitpool 53.
+  encoder_setup(&enc, BTIF_SBC_CHNL_SAMPLE_FREQ_44_1, 16,
+                BTIF_SBC_CHNL_MODE_JOINT_STEREO, BTIF_SBC_ALLOC_METHOD_LOUDNESS,
+                8, 53);
+  assert(btif_sbc_frame_len(&enc.streamInfo) == 119);
+  enc.streamInfo.bitPool = 35;
+  assert(btif_sbc_frame_len(&enc.streamInfo) == 83);
+  encoder_setup(&enc, BTIF_SBC_CHNL_SAMPLE_FREQ_16, 16,
+                BTIF_SBC_CHNL_MODE_MONO, BTIF_SBC_ALLOC_METHOD_LOUDNESS, 8, 31);
+  assert(btif_sbc_frame_len(&enc.streamInfo) == 70);
+  encoder_setup(&enc, BTIF_SBC_CHNL_SAMPLE_FREQ_48, 4,
+                BTIF_SBC_CHNL_MODE_DUAL_CHNL, BTIF_SBC_ALLOC_METHOD_SNR, 4, 15);
+  assert(btif_sbc_frame_len(&enc.streamInfo) == 4 + 4 + 15);
+}
+
+struct codec_case {
+  const char *name;
+  int freq, blocks, mode, alloc, subbands, bitpool;
+  double rate;
+  double min_snr;
+  uint32_t golden_sbc, golden_pcm;
+};
+
+// Golden CRC-32s of the bitstream and the decoded PCM lock the fixed-point
+// arithmetic: any change to rounding, tables or allocation shows up here.
+// Whether the output is right is up to the reference decoder below.
+static const struct codec_case cases[] = {
+    {"44.1k joint 8sb bp53", BTIF_SBC_CHNL_SAMPLE_FREQ_44_1, 16,
+     BTIF_SBC_CHNL_MODE_JOINT_STEREO, BTIF_SBC_ALLOC_METHOD_LOUDNESS, 8, 53,
+     44100, 30, 0x216f3af9, 0xa7a073f1},
+    {"48k stereo 8sb bp51 snr", BTIF_SBC_CHNL_SAMPLE_FREQ_48, 16,
+     BTIF_SBC_CHNL_MODE_STEREO, BTIF_SBC_ALLOC_METHOD_SNR, 8, 51, 48000, 30,
+     0x7464e996, 0x727ff03a},
+    {"32k dual 4sb bp20", BTIF_SBC_CHNL_SAMPLE_FREQ_32, 8,
+     BTIF_SBC_CHNL_MODE_DUAL_CHNL, BTIF_SBC_ALLOC_METHOD_LOUDNESS, 4, 20,
+     32000, 36, 0x19423fe4, 0xcb0417a1},
+    {"16k mono 8sb bp31", BTIF_SBC_CHNL_SAMPLE_FREQ_16, 16,
+     BTIF_SBC_CHNL_MODE_MONO, BTIF_SBC_ALLOC_METHOD_LOUDNESS, 8, 31, 16000, 27,
+     0x19dc1750, 0x784e86ef},
+    {"44.1k joint 4sb bp28", BTIF_SBC_CHNL_SAMPLE_FREQ_44_1, 12,
+     BTIF_SBC_CHNL_MODE_JOINT_STEREO, BTIF_SBC_ALLOC_METHOD_SNR, 4, 28, 44100,
+     30, 0x44a45e55, 0x809d0754},
+};
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *p, uint32_t len) {
+  int k;
+
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (k = 0; k < 8; k++)
+      crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+  }
+  return ~crc;
+}
+
+// Reference decoder: the spec's frame syntax, CRC, bit allocation and
+// reconstruction in double precision, sharing nothing with the codec but
+// the prototype filters above. The encoder's frames must pass it, and the
+// codec's decoder must agree with it.
+struct ref_decoder {
+  struct model ms[2];
+};
+
+struct ref_reader {
+  const uint8_t *p;
+  uint32_t pos;
+  uint8_t crc;
+};
+
+// CRC-8 x^8 + x^4 + x^3 + x^2 + 1 over |n| bits of |v|, MSB first.
+static uint8_t ref_crc(uint8_t crc, uint32_t v, int n) {
+  while (n--) {
+    int top = ((crc >> 7) ^ (v >> n)) & 1;
+
+    crc = (uint8_t)(crc << 1);
+    if (top)
+      crc ^= 0x1D;
+  }
+  return crc;
+}
+
+static uint32_t ref_get(struct ref_reader *r, int n, int crc) {
+  uint32_t v = 0;
+  int k;
+
+  for (k = 0; k < n; k++, r->pos++)
+    v = v << 1 | ((r->p[r->pos / 8] >> (7 - r->pos % 8)) & 1);
+  if (crc)
+    r->crc = ref_crc(r->crc, v, n);
+  return v;
+}
+
+static const int ref_offset4[4][4] = {
+    {-1, 0, 0, 0}, {-2, 0, 0, 1}, {-2, 0, 0, 1}, {-2, 0, 0, 1}};
+static const int ref_offset8[4][8] = {{-2, 0, 0, 0, 0, 0, 0, 1},
+                                      {-3, 0, 0, 0, 0, 0, 1, 2},
+                                      {-4, 0, 0, 0, 0, 0, 1, 2},
+                                      {-4, 0, 0, 0, 0, 0, 1, 2}};
+
+// Bit allocation over |nch| channels sharing one bitpool, as in the spec's
+// pseudo code; the leftover bits go round the channels of each subband.
+static void ref_allocate(int sf[][8], int nch, int m, int fs, int snr,
+                         int bitpool, int bits[][8]) {
+  int need[2][8], max = 0, slice, count = 0, scount = 0, ch, sb;
+
+  for (ch = 0; ch < nch; ch++) {
+    for (sb = 0; sb < m; sb++) {
+      int off = m == 4 ? ref_offset4[fs][sb] : ref_offset8[fs][sb];
+      int loud = sf[ch][sb] - off;
+
+      if (snr)
+        need[ch][sb] = sf[ch][sb];
+      else if (sf[ch][sb] == 0)
+        need[ch][sb] = -5;
+      else
+        need[ch][sb] = loud > 0 ? loud / 2 : loud;
+      if (need[ch][sb] > max)
+        max = need[ch][sb];
+    }
+  }
+  slice = max + 1;
+  do {
+    slice--;
+    count += scount;
+    scount = 0;
+    for (ch = 0; ch < nch; ch++) {
+      for (sb = 0; sb < m; sb++) {
+        if (need[ch][sb] > slice + 1 && need[ch][sb] < slice + 16)
+          scount++;
+        else if (need[ch][sb] == slice + 1)
+          scount += 2;
+      }
+    }
+  } while (count + scount < bitpool);
+  if (count + scount == bitpool) {
+    count += scount;
+    slice--;
+  }
+  for (ch = 0; ch < nch; ch++) {
+    for (sb = 0; sb < m; sb++) {
+      int b = need[ch][sb] - slice;
+
+      bits[ch][sb] = need[ch][sb] < slice + 2 ? 0 : b < 16 ? b : 16;
+    }
+  }
+  for (ch = 0, sb = 0; count < bitpool && sb < m;) {
+    if (bits[ch][sb] >= 2 && bits[ch][sb] < 16) {
+      bits[ch][sb]++;
+      count++;
+    } else if (need[ch][sb] == slice + 1 && bitpool > count + 1) {
+      bits[ch][sb] = 2;
+      count += 2;
+    }
+    if (++ch == nch) {
+      ch = 0;
+      sb++;
+    }
+  }
+  for (ch = 0, sb = 0; count < bitpool && sb < m;) {
+    if (bits[ch][sb] < 16) {
+      bits[ch][sb]++;
+      count++;
+    }
+    if (++ch == nch) {
+      ch = 0;
+      sb++;
+    }
+  }
+}
+
+// Decodes one frame into interleaved PCM. Returns the frame length, or -1
+// if the frame is short, has no sync word or fails the CRC.
+static int ref_decode(struct ref_decoder *rd, const uint8_t *frame, int len,
+                      int16_t *out) {
+  struct ref_reader r = {frame, 32, 0x0F};
+  int fs, blocks, mode, snr, m, bitpool, nch, flen, bits_len;
+  int join[8] = {0}, sf[2][8], bits[2][8];
+  double s[16][2][8];
+  int blk, ch, sb, i;
+
+  if (len < 4 || frame[0] != SBC_SYNCWORD)
+    return -1;
+  fs = frame[1] >> 6;
+  blocks = 4 * (((frame[1] >> 4) & 3) + 1);
+  mode = (frame[1] >> 2) & 3;
+  snr = (frame[1] >> 1) & 1;
+  m = frame[1] & 1 ? 8 : 4;
+  bitpool = frame[2];
+  nch = mode == BTIF_SBC_CHNL_MODE_MONO ? 1 : 2;
+  if (mode == BTIF_SBC_CHNL_MODE_MONO || mode == BTIF_SBC_CHNL_MODE_DUAL_CHNL)
+    bits_len = blocks * nch * bitpool;
+  else
+    bits_len = (mode == BTIF_SBC_CHNL_MODE_JOINT_STEREO ? m : 0) +
+               blocks * bitpool;
+  flen = 4 + 4 * m * nch / 8 + (bits_len + 7) / 8;
+  if (len < flen)
+    return -1;
+
+  r.crc = ref_crc(ref_crc(r.crc, frame[1], 8), frame[2], 8);
+  if (mode == BTIF_SBC_CHNL_MODE_JOINT_STEREO) {
+    for (sb = 0; sb < m; sb++)
+      join[sb] = (int)ref_get(&r, 1, 1);
+    join[m - 1] = 0;
+  }
+  for (ch = 0; ch < nch; ch++)
+    for (sb = 0; sb < m; sb++)
+      sf[ch][sb] = (int)ref_get(&r, 4, 1);
+  if (r.crc != frame[3])
+    return -1;
+
+  if (nch == 2 && (mode == BTIF_SBC_CHNL_MODE_STEREO ||
+                   mode == BTIF_SBC_CHNL_MODE_JOINT_STEREO)) {
+    ref_allocate(sf, 2, m, fs, snr, bitpool, bits);
+  } else {
+    for (ch = 0; ch < nch; ch++)
+      ref_allocate(&sf[ch], 1, m, fs, snr, bitpool, &bits[ch]);
+  }
+
+  for (blk = 0; blk < blocks; blk++) {
+    for (ch = 0; ch < nch; ch++) {
+      for (sb = 0; sb < m; sb++) {
+        double levels = (1 << bits[ch][sb]) - 1;
+        double q;
+
+        s[blk][ch][sb] = 0;
+        if (bits[ch][sb] == 0)
+          continue;
+        q = ref_get(&r, bits[ch][sb], 0);
+        s[blk][ch][sb] =
+            ldexp(1, sf[ch][sb] + 1) * ((2 * q + 1) / levels - 1);
+      }
+    }
+    for (sb = 0; sb < m; sb++) {
+      if (join[sb]) {
+        double mid = s[blk][0][sb], side = s[blk][1][sb];
+
+        s[blk][0][sb] = mid + side;
+        s[blk][1][sb] = mid - side;
+      }
+    }
+    for (ch = 0; ch < nch; ch++) {
+      double x[8];
+
+      rd->ms[ch].m = m;
+      model_synthesize(&rd->ms[ch], s[blk][ch], x);
+      for (i = 0; i < m; i++) {
+        double v = floor(x[i] + 0.5);
+
+        out[(blk * m + i) * nch + ch] =
+            (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+      }
+    }
+  }
+  return flen;
+}
+
+#define CODEC_FRAMES 200
+
+static void run_case(const struct codec_case *c) {
+  static btif_sbc_encoder_t enc;
+  static btif_sbc_decoder_t dec;
+  static struct ref_decoder rd;
+  static int16_t pcm[CODEC_FRAMES * 256], out[CODEC_FRAMES * 256],
+      ref_out[CODEC_FRAMES * 256];
+  static uint8_t sbc[CODEC_FRAMES * 520];
+  static double ref[CODEC_FRAMES * 256], got[CODEC_FRAMES * 256];
+  int nch = c->mode == BTIF_SBC_CHNL_MODE_MONO ? 1 : 2;
+  int frame_samples = c->blocks * c->subbands;
+  int samples = CODEC_FRAMES * frame_samples;
+  int delay = 10 * c->subbands - c->subbands + 1;
+  btif_sbc_pcm_data_t in = {(uint8_t)c->freq, (uint8_t)nch, 0,
+                            (uint8_t *)pcm};
+  btif_sbc_pcm_data_t dec_pcm = {0, 0, 0, (uint8_t *)out};
+  uint16_t consumed, len, flen;
+  uint32_t sbc_len = 0, crc_pcm;
+  int f, i, n, max_diff = 0;
+  double snr;
+
+  encoder_setup(&enc, c->freq, c->blocks, c->mode, c->alloc, c->subbands,
+                c->bitpool);
+  flen = btif_sbc_frame_len(&enc.streamInfo);
+  make_signal(pcm, samples, nch, c->rate, 7);
+
+  // One frame per call, as the A2DP source does with its packets.
+  for (f = 0; f < CODEC_FRAMES; f++) {
+    in.data = (uint8_t *)(pcm + f * frame_samples * nch);
+    in.dataLen = (uint16_t)(frame_samples * nch * 2);
+    assert(btif_sbc_encode_frames(&enc, &in, &consumed, sbc + sbc_len, &len,
+                                  flen) == BT_STS_SUCCESS);
+    assert(consumed == in.dataLen && len == flen);
+    sbc_len += len;
+  }
+
+  btif_sbc_init_decoder(&dec);
+  for (f = 0; f < CODEC_FRAMES; f++) {
+    dec_pcm.data = (uint8_t *)(out + f * frame_samples * nch);
+    dec_pcm.dataLen = 0;
+    assert(btif_sbc_decode_frames(&dec, sbc + f * flen, flen, &consumed,
+                                  &dec_pcm, (uint16_t)(frame_samples * nch * 2),
+                                  NULL) == BT_STS_SUCCESS);
+    assert(consumed == flen);
+    assert(dec.maxPcmLen == frame_samples * nch * 2);
+  }
+
+  // The reference decoder takes every frame and agrees with the codec's.
+  memset(&rd, 0, sizeof(rd));
+  for (f = 0; f < CODEC_FRAMES; f++) {
+    assert(ref_decode(&rd, sbc + f * flen, flen,
+                      ref_out + f * frame_samples * nch) == flen);
+  }
+  for (i = 0; i < samples * nch; i++) {
+    int d = abs(out[i] - ref_out[i]);
+
+    max_diff = d > max_diff ? d : max_diff;
+  }
+
+  for (n = 0, i = 0; i + delay < samples; i++) {
+    int ch;
+
+    if (i < 2 * frame_samples)
+      continue;
+    for (ch = 0; ch < nch; ch++, n++) {
+      ref[n] = pcm[i * nch + ch];
+      got[n] = out[(i + delay) * nch + ch];
+    }
+  }
+  snr = snr_db(ref, got, n);
+  crc_pcm = crc32_update(0, (const uint8_t *)out, samples * nch * 2);
+  printf("%s: %u bytes/frame, SNR %.1f dB, vs reference %d LSB, sbc %08x, "
+         "pcm %08x\n",
+         c->name, flen, snr, max_diff, crc32_update(0, sbc, sbc_len), crc_pcm);
+  assert(snr > c->min_snr);
+  assert(max_diff <= 2);
+  assert(crc32_update(0, sbc, sbc_len) == c->golden_sbc);
+  assert(crc_pcm == c->golden_pcm);
+}
+
+static void test_codec_cases(void) {
+  unsigned int i;
+
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    run_case(&cases[i]);
+}
+
+#define STREAM_FRAMES 20
+
+// Frames of the A2DP high quality stream for the decoder API tests.
+static uint16_t make_stream(uint8_t *sbc, int16_t *pcm) {
+  static btif_sbc_encoder_t enc;
+  btif_sbc_pcm_data_t in = {BTIF_SBC_CHNL_SAMPLE_FREQ_44_1, 2,
+                            STREAM_FRAMES * 128 * 2 * 2, (uint8_t *)pcm};
+  uint16_t consumed, len;
+
+  encoder_setup(&enc, BTIF_SBC_CHNL_SAMPLE_FREQ_44_1, 16,
+                BTIF_SBC_CHNL_MODE_JOINT_STEREO, BTIF_SBC_ALLOC_METHOD_LOUDNESS,
+                8, 53);
+  make_signal(pcm, STREAM_FRAMES * 128, 2, 44100, 3);
+  // Room for all but the last frame: the encoder stops at MaxSbcData.
+  assert(btif_sbc_encode_frames(&enc, &in, &consumed, sbc, &len,
+                                (STREAM_FRAMES - 1) * 119 + 118) ==
+         BT_STS_SUCCESS);
+  assert(consumed == (STREAM_FRAMES - 1) * 512 &&
+         len == (STREAM_FRAMES - 1) * 119);
+  in.data += consumed;
+  in.dataLen -= consumed;
+  assert(btif_sbc_encode_frames(&enc, &in, &consumed, sbc + len, &len,
+                                0xFFFF) == BT_STS_SUCCESS);
+  assert(consumed == 512 && len == 119);
+  return STREAM_FRAMES * 119;
+}
+
+// Input cut anywhere, including inside headers, decodes to the same PCM as
+// whole frames, and each call stops when the PCM buffer is full.
+static void test_decode_split_input(void) {
+  static btif_sbc_decoder_t dec;
+  static uint8_t sbc[STREAM_FRAMES * 119];
+  static int16_t pcm[STREAM_FRAMES * 256], ref[STREAM_FRAMES * 256],
+      out[STREAM_FRAMES * 256];
+  btif_sbc_pcm_data_t dec_pcm = {0, 0, 0, (uint8_t *)ref};
+  uint16_t total = make_stream(sbc, pcm), consumed, pos = 0;
+  uint32_t seed = 11, out_len = 0;
+  bt_status_t ret;
+
+  btif_sbc_init_decoder(&dec);
+  assert(btif_sbc_decode_frames(&dec, sbc, total, &consumed, &dec_pcm,
+                                sizeof(ref), NULL) == BT_STS_SUCCESS);
+  assert(consumed == total && dec_pcm.dataLen == sizeof(ref));
+  assert(dec_pcm.numChannels == 2 &&
+         dec_pcm.sampleFreq == BTIF_SBC_CHNL_SAMPLE_FREQ_44_1);
+
+  // Chunks of 1 to 160 bytes into a buffer of two frames at a time.
+  btif_sbc_init_decoder(&dec);
+  while (pos < total) {
+    uint16_t chunk = (uint16_t)(1 + lcg_next(&seed) % 160);
+
+    if (chunk > total - pos)
+      chunk = total - pos;
+    dec_pcm.data = (uint8_t *)out + out_len;
+    dec_pcm.dataLen = 0;
+    do {
+      ret = btif_sbc_decode_frames(&dec, sbc + pos, chunk, &consumed,
+                                   &dec_pcm, 2 * 512, NULL);
+      assert(ret == BT_STS_SUCCESS || ret == BT_STS_CONTINUE);
+      assert(consumed <= chunk);
+      pos += consumed;
+      chunk -= consumed;
+      if (ret == BT_STS_SUCCESS) {
+        assert(dec_pcm.dataLen == 2 * 512);
+        out_len += dec_pcm.dataLen;
+        dec_pcm.data = (uint8_t *)out + out_len;
+        dec_pcm.dataLen = 0;
+      }
+    } while (ret == BT_STS_SUCCESS && chunk);
+    assert(ret == BT_STS_SUCCESS || chunk == 0);
+    out_len += dec_pcm.dataLen;
+  }
+  assert(out_len == sizeof(out));
+  assert(memcmp(out, ref, sizeof(out)) == 0);
+}
+
+static void test_decode_errors(void) {
+  static btif_sbc_decoder_t dec;
+  static uint8_t sbc[STREAM_FRAMES * 119];
+  static int16_t pcm[STREAM_FRAMES * 256], out[256];
+  btif_sbc_pcm_data_t dec_pcm = {0, 0, 0, (uint8_t *)out};
+  uint16_t consumed;
+
+  make_stream(sbc, pcm);
+
+  btif_sbc_init_decoder(&dec);
+  assert(btif_sbc_decode_frames_parser(&dec, sbc, 119, &consumed) ==
+         BT_STS_SUCCESS);
+  assert(consumed == 119 && dec.maxPcmLen == 512);
+  assert(dec.streamInfo.bitPool == 53 && dec.streamInfo.numBlocks == 16 &&
+         dec.streamInfo.channelMode == BTIF_SBC_CHNL_MODE_JOINT_STEREO);
+
+  // No room for a frame: nothing is consumed.
+  assert(btif_sbc_decode_frames(&dec, sbc, 119, &consumed, &dec_pcm, 511,
+                                NULL) == BT_STS_NO_RESOURCES);
+  assert(consumed == 0 && dec_pcm.dataLen == 0);
+
+  // A scale factor bit flipped fails the CRC; the frame is dropped.
+  sbc[6] ^= 0x10;
+  assert(btif_sbc_decode_frames(&dec, sbc, 2 * 119, &consumed, &dec_pcm, 512,
+                                NULL) == BT_STS_FAILED);
+  assert(consumed == 119);
+  sbc[6] ^= 0x10;
+
+  // Not a sync word: one byte is skipped.
+  assert(btif_sbc_decode_frames(&dec, sbc + 1, 119, &consumed, &dec_pcm, 512,
+                                NULL) == BT_STS_FAILED);
+  assert(consumed == 1);
+  assert(btif_sbc_decode_frames_parser(&dec, sbc + 1, 119, &consumed) ==
+         BT_STS_FAILED);
+
+  // A bitpool below 2 is not a valid header.
+  sbc[2] = 1;
+  assert(btif_sbc_decode_frames_parser(&dec, sbc, 119, &consumed) ==
+         BT_STS_FAILED);
+}
+
+// Unity gains take the same path as none; other gains scale the subbands.
+static void test_decode_gains(void) {
+  static btif_sbc_decoder_t dec;
+  static uint8_t sbc[STREAM_FRAMES * 119];
+  static int16_t pcm[STREAM_FRAMES * 256], ref[STREAM_FRAMES * 256],
+      out[STREAM_FRAMES * 256];
+  float unity[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+  float half[8] = {0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f};
+  btif_sbc_pcm_data_t dec_pcm = {0, 0, 0, (uint8_t *)ref};
+  uint16_t total = make_stream(sbc, pcm), consumed;
+  double sum_ref = 0, sum_out = 0;
+  int i;
+
+  btif_sbc_init_decoder(&dec);
+  btif_sbc_decode_frames(&dec, sbc, total, &consumed, &dec_pcm, sizeof(ref),
+                         NULL);
+  btif_sbc_init_decoder(&dec);
+  dec_pcm.data = (uint8_t *)out;
+  dec_pcm.dataLen = 0;
+  btif_sbc_decode_frames(&dec, sbc, total, &consumed, &dec_pcm, sizeof(out),
+                         unity);
+  assert(memcmp(out, ref, sizeof(out)) == 0);
+
+  btif_sbc_init_decoder(&dec);
+  dec_pcm.dataLen = 0;
+  btif_sbc_decode_frames(&dec, sbc, total, &consumed, &dec_pcm, sizeof(out),
+                         half);
+  for (i = 0; i < STREAM_FRAMES * 256; i++) {
+    sum_ref += fabs((double)ref[i]);
+    sum_out += fabs(out[i] - 0.5 * ref[i]);
+  }
+  assert(sum_out < sum_ref * 0.001);
+}
+
+// After a lost mSBC frame, updating the decoder from the concealed PCM
+// brings the next frames back to what the decoder would have produced;
+// without it they carry the stale filterbank state.
+static void test_plc_update(void) {
+  static btif_sbc_encoder_t enc, plc_enc;
+  static btif_sbc_decoder_t ref_dec, plc_dec, skip_dec, spare_dec;
+  static int16_t pcm[10 * 120];
+  static uint8_t frames[10][MSBC_FRAME_LEN];
+  double ref[120], with_plc[120], without[120];
+  int16_t out[3][120];
+  uint16_t consumed, len;
+  int f, i;
+
+  encoder_setup_msbc(&enc);
+  encoder_setup_msbc(&plc_enc);
+  make_signal(pcm, 10 * 120, 1, 16000, 5);
+  for (f = 0; f < 10; f++) {
+    btif_sbc_pcm_data_t in = {BTIF_SBC_CHNL_SAMPLE_FREQ_16, 1, 240,
+                              (uint8_t *)(pcm + f * 120)};
+
+    assert(btif_sbc_encode_frames(&enc, &in, &consumed, frames[f], &len,
+                                  0xFFFF) == BT_STS_SUCCESS);
+  }
+
+  btif_sbc_init_decoder(&ref_dec);
+  btif_sbc_init_decoder(&plc_dec);
+  btif_sbc_init_decoder(&skip_dec);
+  btif_sbc_init_decoder(&spare_dec);
+  for (f = 0; f < 10; f++) {
+    btif_sbc_decoder_t *decs[3] = {&ref_dec, &plc_dec, &skip_dec};
+    btif_sbc_pcm_data_t in = {BTIF_SBC_CHNL_SAMPLE_FREQ_16, 1, 240,
+                              (uint8_t *)(pcm + f * 120)};
+    int d;
+
+    for (d = 0; d < 3; d++) {
+      btif_sbc_pcm_data_t dec_pcm = {0, 0, 0, (uint8_t *)out[d]};
+
+      if (f == 6 && d > 0)
+        continue;
+      assert(btif_sbc_decode_frames(decs[d], frames[f], MSBC_FRAME_LEN,
+                                    &consumed, &dec_pcm, 240,
+                                    NULL) == BT_STS_SUCCESS);
+    }
+    // The concealment encoder follows the signal; frame 6 is "lost" and
+    // its PCM stands in for the concealed frame.
+    btif_plc_update_sbc_decoder_state(&plc_enc, &in,
+                                      f == 6 ? &plc_dec : &spare_dec, NULL);
+    if (f == 7) {
+      for (i = 0; i < 120; i++) {
+        ref[i] = out[0][i];
+        with_plc[i] = out[1][i];
+        without[i] = out[2][i];
+      }
+    }
+  }
+  printf("plc update: %.1f dB, without %.1f dB\n", snr_db(ref, with_plc, 120),
+         snr_db(ref, without, 120));
+  assert(snr_db(ref, with_plc, 120) > 25);
+  assert(snr_db(ref, with_plc, 120) > snr_db(ref, without, 120) + 10);
+}
+
+int main(void) {
+  test_filterbank_vs_model();
+  test_msbc_silence_frame();
+  test_frame_len();
+  test_codec_cases();
+  test_decode_split_input();
+  test_decode_errors();
+  test_decode_gains();
+  test_plc_update();
+  printf("sbc_tests: all passed\n");
+  return 0;
+}
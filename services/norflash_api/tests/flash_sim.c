@@ -0,0 +1,346 @@
+#include "flash_sim.h"
+#include "cmsis.h"
+#include "hal_norflash.h"
+#include "hal_sleep.h"
+#include "hal_timer.h"
+#include "hal_trace.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef struct {
+  bool active;
+  bool is_erase;
+  uint32_t offs;
+  uint32_t len;
+  const uint8_t *buf;
+  uint64_t total_us;
+  uint64_t done_us;
+} sim_op_t;
+
+static flash_sim_cfg_t cfg;
+static uint8_t *mem;
+static uint64_t now_us;
+static uint64_t cut_at_us;
+static sim_op_t op;
+static flash_sim_stats_t stats;
+static uint32_t lock_depth;
+static uint64_t lock_start_us;
+static uint32_t rand_state = 1;
+static HAL_SLEEP_HOOK_HANDLER sleep_hooks[HAL_SLEEP_HOOK_USER_QTY];
+static HAL_DEEP_SLEEP_HOOK_HANDLER deep_sleep_hooks[HAL_DEEP_SLEEP_HOOK_USER_QTY];
+
+void flash_sim_default_cfg(flash_sim_cfg_t *c) {
+  c->size = 0x80000;
+  c->page_size = 256;
+  c->sector_size = 4096;
+  c->block_size = 0x10000;
+  c->page_program_us = 700;
+  c->sector_erase_us = 45000;
+  c->block_erase_us = 150000;
+  c->suspend_slice_us = 500;
+}
+
+void flash_sim_init(const flash_sim_cfg_t *c) {
+  if (!mem) {
+    void *p = mmap((void *)(uintptr_t)FLASH_SIM_BASE, c->size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    ASSERT(p == (void *)(uintptr_t)FLASH_SIM_BASE, "%s: mmap failed",
+           __func__);
+    mem = (uint8_t *)p;
+    memset(mem, 0xFF, c->size);
+  }
+  ASSERT(c->size <= cfg.size || cfg.size == 0, "%s: device cannot grow",
+         __func__);
+  cfg = *c;
+  now_us = 0;
+  cut_at_us = 0;
+  lock_depth = 0;
+  memset(&op, 0, sizeof(op));
+  memset(sleep_hooks, 0, sizeof(sleep_hooks));
+  memset(deep_sleep_hooks, 0, sizeof(deep_sleep_hooks));
+  flash_sim_reset_stats();
+}
+
+void flash_sim_erase_all(void) { memset(mem, 0xFF, cfg.size); }
+
+uint8_t *flash_sim_mem(void) { return mem; }
+
+uint64_t flash_sim_now_us(void) { return now_us; }
+
+void flash_sim_set_power_cut_us(uint64_t at_us) { cut_at_us = at_us; }
+
+void flash_sim_get_stats(flash_sim_stats_t *s) { *s = stats; }
+
+void flash_sim_reset_stats(void) { memset(&stats, 0, sizeof(stats)); }
+
+// Advances the clock by up to |us| and returns how much actually passed,
+// which is less if the power is cut on the way. |*cut| tells the caller to
+// leave its work half done and call sim_power_off().
+static uint64_t sim_pass_time(uint64_t us, bool *cut) {
+  *cut = false;
+  if (cut_at_us && now_us + us >= cut_at_us) {
+    us = cut_at_us > now_us ? cut_at_us - now_us : 0;
+    *cut = true;
+  }
+  now_us += us;
+  return us;
+}
+
+static void sim_power_off(void) { _exit(FLASH_SIM_POWER_CUT_EXIT); }
+
+static uint32_t sim_rand(void) {
+  rand_state = rand_state * 1103515245u + 12345u;
+  return rand_state >> 16;
+}
+
+static void sim_program(uint32_t from, uint32_t to) {
+  for (uint32_t i = from; i < to; ++i)
+    mem[op.offs + i] &= op.buf[i];
+  stats.programmed_bytes += to - from;
+}
+
+// Runs the current operation for at most |budget_us|. Returns true once it is
+// complete.
+static bool sim_run(uint64_t budget_us) {
+  uint64_t before = op.done_us;
+  uint64_t run = op.total_us - op.done_us;
+  bool cut;
+
+  if (run > budget_us)
+    run = budget_us;
+  run = sim_pass_time(run, &cut);
+  op.done_us += run;
+  stats.busy_us += run;
+  if (run > stats.max_busy_us)
+    stats.max_busy_us = (uint32_t)run;
+
+  if (!op.is_erase) {
+    sim_program((uint32_t)(op.len * before / op.total_us),
+                (uint32_t)(op.len * op.done_us / op.total_us));
+  } else if (op.done_us == op.total_us) {
+    memset(mem + op.offs, 0xFF, op.len);
+    stats.erases++;
+  } else if (cut) {
+    // An interrupted erase leaves a random subset of the bits set.
+    for (uint32_t i = 0; i < op.len; ++i)
+      mem[op.offs + i] |= (uint8_t)sim_rand();
+  }
+  if (cut)
+    sim_power_off();
+  if (op.done_us == op.total_us) {
+    op.active = false;
+    return true;
+  }
+  return false;
+}
+
+static enum HAL_NORFLASH_RET_T sim_start(bool is_erase, uint32_t addr,
+                                         const uint8_t *buf, uint32_t len,
+                                         int suspend) {
+  uint32_t offs = addr - FLASH_SIM_BASE;
+
+  ASSERT(!op.active, "%s: operation already in progress", __func__);
+  if (addr < FLASH_SIM_BASE || offs + len > cfg.size || offs + len < offs)
+    return HAL_NORFLASH_BAD_ADDR;
+  if (is_erase && (offs % cfg.sector_size || len % cfg.sector_size))
+    return HAL_NORFLASH_BAD_LEN;
+  if (len == 0)
+    return HAL_NORFLASH_OK;
+
+  op.active = true;
+  op.is_erase = is_erase;
+  op.offs = offs;
+  op.len = len;
+  op.buf = buf;
+  op.done_us = 0;
+  if (is_erase) {
+    op.total_us = len == cfg.block_size
+                      ? cfg.block_erase_us
+                      : (uint64_t)cfg.sector_erase_us * (len / cfg.sector_size);
+  } else {
+    uint32_t pages = (offs + len - 1) / cfg.page_size - offs / cfg.page_size + 1;
+    op.total_us = (uint64_t)pages * cfg.page_program_us;
+  }
+
+  if (!suspend) {
+    sim_run(op.total_us);
+    return HAL_NORFLASH_OK;
+  }
+  if (sim_run(cfg.suspend_slice_us))
+    return HAL_NORFLASH_OK;
+  stats.suspends++;
+  return HAL_NORFLASH_SUSPENDED;
+}
+
+static enum HAL_NORFLASH_RET_T sim_resume(int suspend) {
+  ASSERT(op.active, "%s: nothing to resume", __func__);
+  if (sim_run(suspend ? cfg.suspend_slice_us : op.total_us))
+    return HAL_NORFLASH_OK;
+  stats.suspends++;
+  return HAL_NORFLASH_SUSPENDED;
+}
+
+enum HAL_NORFLASH_RET_T hal_norflash_get_size(enum HAL_NORFLASH_ID_T id,
+                                              uint32_t *total_size,
+                                              uint32_t *block_size,
+                                              uint32_t *sector_size,
+                                              uint32_t *page_size) {
+  (void)id;
+  if (total_size)
+    *total_size = cfg.size;
+  if (block_size)
+    *block_size = cfg.block_size;
+  if (sector_size)
+    *sector_size = cfg.sector_size;
+  if (page_size)
+    *page_size = cfg.page_size;
+  return HAL_NORFLASH_OK;
+}
+
+enum HAL_NORFLASH_RET_T hal_norflash_erase_suspend(enum HAL_NORFLASH_ID_T id,
+                                                   uint32_t start_address,
+                                                   uint32_t len, int suspend) {
+  (void)id;
+  return sim_start(true, start_address, NULL, len, suspend);
+}
+
+enum HAL_NORFLASH_RET_T hal_norflash_erase(enum HAL_NORFLASH_ID_T id,
+                                           uint32_t start_address,
+                                           uint32_t len) {
+  (void)id;
+  return sim_start(true, start_address, NULL, len, 0);
+}
+
+enum HAL_NORFLASH_RET_T hal_norflash_erase_resume(enum HAL_NORFLASH_ID_T id,
+                                                  int suspend) {
+  (void)id;
+  return sim_resume(suspend);
+}
+
+enum HAL_NORFLASH_RET_T hal_norflash_write_suspend(enum HAL_NORFLASH_ID_T id,
+                                                   uint32_t start_address,
+                                                   const uint8_t *buffer,
+                                                   uint32_t len, int suspend) {
+  (void)id;
+  return sim_start(false, start_address, buffer, len, suspend);
+}
+
+enum HAL_NORFLASH_RET_T hal_norflash_write(enum HAL_NORFLASH_ID_T id,
+                                           uint32_t start_address,
+                                           const uint8_t *buffer,
+                                           uint32_t len) {
+  (void)id;
+  return sim_start(false, start_address, buffer, len, 0);
+}
+
+enum HAL_NORFLASH_RET_T hal_norflash_write_resume(enum HAL_NORFLASH_ID_T id,
+                                                  int suspend) {
+  (void)id;
+  return sim_resume(suspend);
+}
+
+enum HAL_NORFLASH_RET_T hal_norflash_read(enum HAL_NORFLASH_ID_T id,
+                                          uint32_t start_address,
+                                          uint8_t *buffer, uint32_t len) {
+  uint32_t offs = start_address - FLASH_SIM_BASE;
+
+  (void)id;
+  if (start_address < FLASH_SIM_BASE || offs + len > cfg.size)
+    return HAL_NORFLASH_BAD_ADDR;
+  memcpy(buffer, mem + offs, len);
+  return HAL_NORFLASH_OK;
+}
+
+enum HAL_NORFLASH_RET_T hal_norflash_enable_remap(enum HAL_NORFLASH_ID_T id,
+                                                  uint32_t addr, uint32_t len,
+                                                  uint32_t offset) {
+  (void)id;
+  (void)addr;
+  (void)len;
+  (void)offset;
+  return HAL_NORFLASH_OK;
+}
+
+enum HAL_NORFLASH_RET_T hal_norflash_disable_remap(enum HAL_NORFLASH_ID_T id) {
+  (void)id;
+  return HAL_NORFLASH_OK;
+}
+
+int hal_norflash_get_remap_status(enum HAL_NORFLASH_ID_T id) {
+  (void)id;
+  return 0;
+}
+
+uint32_t int_lock_global(void) {
+  if (lock_depth++ == 0)
+    lock_start_us = now_us;
+  return 0;
+}
+
+void int_unlock_global(uint32_t pri) {
+  uint64_t held;
+
+  (void)pri;
+  ASSERT(lock_depth, "%s: not locked", __func__);
+  if (--lock_depth)
+    return;
+  held = now_us - lock_start_us;
+  stats.locked_us += held;
+  if (held > stats.max_lock_us)
+    stats.max_lock_us = (uint32_t)held;
+}
+
+uint32_t int_lock(void) { return int_lock_global(); }
+
+void int_unlock(uint32_t pri) { int_unlock_global(pri); }
+
+int hal_sleep_set_sleep_hook(enum HAL_SLEEP_HOOK_USER_T user,
+                             HAL_SLEEP_HOOK_HANDLER handler) {
+  sleep_hooks[user] = handler;
+  return 0;
+}
+
+int hal_sleep_set_deep_sleep_hook(enum HAL_DEEP_SLEEP_HOOK_USER_T user,
+                                  HAL_DEEP_SLEEP_HOOK_HANDLER handler) {
+  deep_sleep_hooks[user] = handler;
+  return 0;
+}
+
+int flash_sim_run_sleep_hooks(void) {
+  int busy = 0;
+
+  for (int i = 0; i < HAL_SLEEP_HOOK_USER_QTY; ++i) {
+    if (sleep_hooks[i] && sleep_hooks[i]())
+      busy = 1;
+  }
+  for (int i = 0; i < HAL_DEEP_SLEEP_HOOK_USER_QTY; ++i) {
+    if (deep_sleep_hooks[i] && deep_sleep_hooks[i]())
+      busy = 1;
+  }
+  return busy;
+}
+
+void flash_sim_idle_us(uint64_t us) {
+  uint64_t end = now_us + us;
+  bool cut = false;
+
+  while (now_us < end && !cut) {
+    uint64_t before = now_us;
+    if (!flash_sim_run_sleep_hooks()) {
+      sim_pass_time(end - now_us, &cut);
+      break;
+    }
+    // A hook that found work but took no flash time still costs a little.
+    if (now_us == before)
+      sim_pass_time(10, &cut);
+  }
+  if (cut)
+    sim_power_off();
+}
+
+int osDelay(uint32_t ms) {
+  flash_sim_idle_us((uint64_t)ms * 1000);
+  return 0;
+}
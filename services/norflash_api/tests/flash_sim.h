@@ -0,0 +1,76 @@
+#ifndef __FLASH_SIM_H__
+#define __FLASH_SIM_H__
+
+// Simulated NOR flash behind the hal_norflash stubs.
+//
+// The device is mapped at FLASH_SIM_BASE so norflash_api can read it through
+// plain pointers, and shared across fork() so a "rebooted" child sees what
+// the previous one left on flash. Time is virtual: page programs and sector
+// erases advance the clock by their configured cost, and so do idle periods.
+// Erase sets bytes to 0xFF, program can only clear bits.
+//
+// With suspend enabled, an operation runs for at most |suspend_slice_us| per
+// call and returns HAL_NORFLASH_SUSPENDED, like a device servicing an
+// interrupt between slices.
+//
+// A power cut can be scheduled at a virtual time. The operation in flight at
+// that moment is left half done (a partial program, or a sector with random
+// bits erased) and the process exits with FLASH_SIM_POWER_CUT_EXIT, so run
+// the code under test in a forked child.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FLASH_SIM_BASE 0x3C000000u
+#define FLASH_SIM_POWER_CUT_EXIT 75
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  uint32_t size;
+  uint32_t page_size;
+  uint32_t sector_size;
+  uint32_t block_size;
+  uint32_t page_program_us;
+  uint32_t sector_erase_us;
+  uint32_t block_erase_us;
+  uint32_t suspend_slice_us;
+} flash_sim_cfg_t;
+
+typedef struct {
+  uint64_t programmed_bytes;
+  uint32_t erases;
+  uint64_t busy_us;         // time the device spent programming or erasing
+  uint32_t max_busy_us;     // longest stretch one driver call kept it busy
+  uint32_t max_lock_us;     // longest int_lock_global() hold
+  uint64_t locked_us;       // total time under int_lock_global()
+  uint32_t suspends;
+} flash_sim_stats_t;
+
+// Datasheet-typical timings of the 4 KB sector parts on these boards.
+void flash_sim_default_cfg(flash_sim_cfg_t *cfg);
+// Maps the device, erased, on first use. Later calls keep the contents.
+void flash_sim_init(const flash_sim_cfg_t *cfg);
+void flash_sim_erase_all(void);
+uint8_t *flash_sim_mem(void);
+
+uint64_t flash_sim_now_us(void);
+// Lets |us| of idle time pass, running the registered sleep hooks in between
+// as the idle thread does.
+void flash_sim_idle_us(uint64_t us);
+// Runs the sleep hooks once. Returns non-zero if any of them had work.
+int flash_sim_run_sleep_hooks(void);
+
+// 0 disables the cut.
+void flash_sim_set_power_cut_us(uint64_t at_us);
+
+void flash_sim_get_stats(flash_sim_stats_t *stats);
+void flash_sim_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FLASH_SIM_H__
@@ -0,0 +1,647 @@
+#include "cmsis.h"
+#include "flash_sim.h"
+#include "hal_trace.h"
+#include "norflash_api.h"
+#include "nvrecord_kvlog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Replays the flash traffic of nvrecord, OTA and coredump through norflash_api
+// on the simulated device and reports throughput, how long callers and the
+// interrupt lock were held up, and how long queued data took to reach flash.
+//
+// Every run happens in a forked child that plays the device, so norflash_api
+// starts from reset RAM. A power-cut trial lets a child die at a random
+// moment, then boots a second child on the same flash to check that whatever
+// the first one had been told was written is still there. What a child learns
+// while running goes to a journal in shared memory.
+
+#define NV_OFFS 0x00000
+#define OTA_OFFS 0x10000
+#define OTA_LEN 0x20000
+#define CD_OFFS 0x40000
+#define CD_LEN 0x10000
+
+// nvrecord: a 1 KB record split into 64-byte chunks, a couple of which
+// change every so often.
+#define NV_KEYS 17
+#define NV_CHUNK 64
+#define NV_BATCHES 150
+#define NV_GAP_MIN_US 20000
+#define NV_GAP_MAX_US 200000
+
+// OTA: 512-byte packets arriving over BT, burnt a sector at a time.
+#define OTA_IMAGE_LEN 0x18000
+#define OTA_PACKET 512
+#define OTA_PACKET_GAP_US 8000
+#define OTA_BURN_LEN 4096
+#define OTA_PACKETS (OTA_IMAGE_LEN / OTA_PACKET)
+
+// coredump: erase the section, then write it a sector at a time, with an OTA
+// burn interrupted half way.
+#define CD_DUMP_LEN 0x8000
+
+#define MAX_UNITS 256
+#define STALL_US 1000
+
+typedef struct {
+  uint64_t payload;       // bytes the pattern asked to store
+  uint64_t elapsed_us;
+  uint32_t calls;         // calls into the flash layer
+  uint32_t stalls;        // calls that kept the caller over STALL_US
+  uint32_t max_stall_us;
+  uint32_t max_queue;     // most operations pending in the module
+  uint32_t durable_cnt;   // units acknowledged as written
+  uint64_t durable_sum_us;
+  uint32_t durable_max_us;
+  flash_sim_stats_t flash;
+} bench_result_t;
+
+// Units are nvrecord batches, OTA packets or coredump sectors.
+typedef struct {
+  uint32_t issued;          // units handed to the flash layer
+  uint32_t durable;         // leading units acknowledged as written
+  uint8_t done[MAX_UNITS];  // units acknowledged as written
+  bench_result_t res;
+} bench_journal_t;
+
+typedef struct {
+  const char *name;
+  void (*run)(void);
+  int (*verify)(void);
+  uint32_t units;
+} bench_pattern_t;
+
+static flash_sim_cfg_t cfg;
+static bench_journal_t *jnl;
+static uint32_t seed = 1;
+static uint64_t issue_us[MAX_UNITS];
+static uint64_t call_start_us;
+
+static uint32_t bench_rand(uint32_t *state) {
+  *state = *state * 1103515245u + 12345u;
+  return *state >> 16;
+}
+
+static void fill(uint8_t *buf, uint32_t len, uint32_t state) {
+  for (uint32_t i = 0; i < len; ++i)
+    buf[i] = (uint8_t)bench_rand(&state);
+}
+
+static void call_begin(void) { call_start_us = flash_sim_now_us(); }
+
+static void call_end(void) {
+  uint64_t took = flash_sim_now_us() - call_start_us;
+
+  jnl->res.calls++;
+  if (took > STALL_US)
+    jnl->res.stalls++;
+  if (took > jnl->res.max_stall_us)
+    jnl->res.max_stall_us = (uint32_t)took;
+}
+
+static void note_queue(enum NORFLASH_API_MODULE_ID_T mod) {
+  uint32_t n = norflash_api_get_used_buffer_count(mod, NORFLASH_API_ALL);
+
+  if (n > jnl->res.max_queue)
+    jnl->res.max_queue = n;
+}
+
+static void mark_durable(uint32_t unit) {
+  uint64_t took;
+
+  if (jnl->done[unit])
+    return;
+  jnl->done[unit] = 1;
+  while (jnl->durable < jnl->issued && jnl->done[jnl->durable])
+    jnl->durable++;
+  took = flash_sim_now_us() - issue_us[unit];
+  jnl->res.durable_cnt++;
+  jnl->res.durable_sum_us += took;
+  if (took > jnl->res.durable_max_us)
+    jnl->res.durable_max_us = (uint32_t)took;
+}
+
+static void mod_register(enum NORFLASH_API_MODULE_ID_T mod, uint32_t offs,
+                         uint32_t len, NORFLASH_API_OPERA_CB cb) {
+  enum NORFLASH_API_RET_T ret;
+
+  ret = norflash_api_register(mod, HAL_NORFLASH_ID_0, FLASH_SIM_BASE + offs,
+                              len, cfg.block_size, cfg.sector_size,
+                              cfg.page_size, cfg.sector_size, cb);
+  ASSERT(ret == NORFLASH_API_OK, "%s: register %d failed, ret = %d", __func__,
+         mod, ret);
+}
+
+static void mod_drain(enum NORFLASH_API_MODULE_ID_T mod) {
+  while (!norflash_api_buffer_is_free(mod))
+    flash_sim_idle_us(1000);
+}
+
+//-------------------------------------------------------------------
+// nvrecord
+//-------------------------------------------------------------------
+
+typedef struct {
+  uint8_t val[NV_KEYS][NV_CHUNK];
+} nv_state_t;
+
+// The same access functions as nvrecord_extension.c.
+static int nv_read(uint32_t addr, void *buf, uint32_t len) {
+  enum NORFLASH_API_RET_T ret;
+
+  ret = norflash_api_read(NORFLASH_API_MODULE_ID_USERDATA_EXT, addr,
+                          (uint8_t *)buf, len);
+  return (ret == NORFLASH_API_OK) ? 0 : -1;
+}
+
+static int nv_write(uint32_t addr, const void *buf, uint32_t len) {
+  enum NORFLASH_API_RET_T ret;
+
+  do {
+    ret = norflash_api_write(NORFLASH_API_MODULE_ID_USERDATA_EXT, addr,
+                             (const uint8_t *)buf, len, true);
+    if (ret == NORFLASH_API_BUFFER_FULL) {
+      do {
+        norflash_api_flush();
+      } while (norflash_api_get_free_buffer_count(NORFLASH_API_WRITTING) == 0);
+    }
+  } while (ret == NORFLASH_API_BUFFER_FULL);
+  note_queue(NORFLASH_API_MODULE_ID_USERDATA_EXT);
+  return (ret == NORFLASH_API_OK) ? 0 : -1;
+}
+
+static int nv_erase(uint32_t addr, uint32_t len) {
+  enum NORFLASH_API_RET_T ret;
+
+  do {
+    ret = norflash_api_erase(NORFLASH_API_MODULE_ID_USERDATA_EXT, addr, len,
+                             true);
+    if (ret == NORFLASH_API_BUFFER_FULL) {
+      do {
+        norflash_api_flush();
+      } while (norflash_api_get_free_buffer_count(NORFLASH_API_ERASING) == 0);
+    }
+  } while (ret == NORFLASH_API_BUFFER_FULL);
+  note_queue(NORFLASH_API_MODULE_ID_USERDATA_EXT);
+  return (ret == NORFLASH_API_OK) ? 0 : -1;
+}
+
+static const nv_kvlog_flash_t nv_flash = {nv_read, nv_write, nv_erase};
+
+// Everything queued so far, so every batch issued so far, is on flash once
+// the module has nothing left to do.
+static void nv_opera_cb(void *param) {
+  NORFLASH_API_OPERA_RESULT *result = (NORFLASH_API_OPERA_RESULT *)param;
+
+  if (result->remain_num == 0) {
+    for (uint32_t b = jnl->durable; b < jnl->issued; ++b)
+      mark_durable(b);
+  }
+}
+
+// Applies batch |b| to |st|. Returns the number of keys it touches, listed in
+// |keys|, and the idle time that follows it in |gap_us|.
+static uint32_t nv_batch(uint32_t b, nv_state_t *st, uint8_t *keys,
+                         uint32_t *gap_us) {
+  uint32_t state = seed * 2654435761u + b;
+  uint32_t n = 0;
+
+  if (b == 0) {
+    for (uint8_t k = 0; k < NV_KEYS; ++k)
+      keys[n++] = k;
+  } else {
+    // The header chunk carries the record crc, so it changes every time.
+    keys[n++] = 0;
+    for (uint32_t i = 1 + bench_rand(&state) % 2; i > 0; --i)
+      keys[n++] = (uint8_t)(1 + bench_rand(&state) % (NV_KEYS - 1));
+  }
+  for (uint32_t i = 0; i < n; ++i)
+    fill(st->val[keys[i]], NV_CHUNK, state ^ (b << 8) ^ keys[i]);
+  *gap_us = NV_GAP_MIN_US + bench_rand(&state) % (NV_GAP_MAX_US - NV_GAP_MIN_US);
+  return n;
+}
+
+static void nv_run(void) {
+  nv_kvlog_t log;
+  nv_state_t st;
+  uint8_t keys[NV_KEYS];
+  uint32_t gap_us;
+
+  mod_register(NORFLASH_API_MODULE_ID_USERDATA_EXT, NV_OFFS,
+               2 * cfg.sector_size, nv_opera_cb);
+  memset(&st, 0, sizeof(st));
+  nv_kvlog_mount(&log, &nv_flash, FLASH_SIM_BASE + NV_OFFS, cfg.sector_size);
+  call_begin();
+  nv_kvlog_format(&log, 0);
+  call_end();
+
+  for (uint32_t b = 0; b < NV_BATCHES; ++b) {
+    uint32_t n = nv_batch(b, &st, keys, &gap_us);
+    uint32_t need = nv_kvlog_commit_size();
+
+    for (uint32_t i = 0; i < n; ++i)
+      need += nv_kvlog_record_size(NV_CHUNK);
+    issue_us[b] = flash_sim_now_us();
+    call_begin();
+    ASSERT(nv_kvlog_begin(&log, need) == 0, "%s: begin failed", __func__);
+    for (uint32_t i = 0; i < n; ++i)
+      nv_kvlog_put(&log, keys[i], st.val[keys[i]], NV_CHUNK);
+    ASSERT(nv_kvlog_commit(&log) == 0, "%s: commit failed", __func__);
+    call_end();
+    jnl->issued = b + 1;
+    jnl->res.payload += n * NV_CHUNK;
+    flash_sim_idle_us(gap_us);
+  }
+  mod_drain(NORFLASH_API_MODULE_ID_USERDATA_EXT);
+}
+
+static bool nv_matches(const nv_kvlog_t *log, const nv_state_t *st,
+                       uint32_t batches) {
+  uint8_t buf[NV_CHUNK];
+
+  for (uint8_t k = 0; k < NV_KEYS; ++k) {
+    int len = nv_kvlog_get(log, k, buf, sizeof(buf));
+    if (batches == 0) {
+      if (len != -1)
+        return false;
+    } else if (len != NV_CHUNK || memcmp(buf, st->val[k], NV_CHUNK)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The log must hold the values after some batch between the last one known to
+// be durable and the last one issued, and still take updates.
+static int nv_verify(void) {
+  nv_kvlog_t log;
+  nv_state_t st;
+  uint8_t keys[NV_KEYS];
+  uint8_t buf[NV_CHUNK];
+  uint32_t gap_us;
+  uint32_t found = UINT32_MAX;
+
+  mod_register(NORFLASH_API_MODULE_ID_USERDATA_EXT, NV_OFFS,
+               2 * cfg.sector_size, NULL);
+  memset(&st, 0, sizeof(st));
+  if (nv_kvlog_mount(&log, &nv_flash, FLASH_SIM_BASE + NV_OFFS,
+                     cfg.sector_size)) {
+    if (jnl->durable) {
+      printf("nvrecord: log lost after %u durable batches\n", jnl->durable);
+      return -1;
+    }
+    nv_kvlog_format(&log, 0);
+  } else {
+    for (uint32_t b = 0; b <= jnl->issued && found == UINT32_MAX; ++b) {
+      if (b)
+        nv_batch(b - 1, &st, keys, &gap_us);
+      if (b >= jnl->durable && nv_matches(&log, &st, b))
+        found = b;
+    }
+    if (found == UINT32_MAX) {
+      printf("nvrecord: no batch in [%u, %u] matches\n", jnl->durable,
+             jnl->issued);
+      return -1;
+    }
+  }
+
+  fill(buf, sizeof(buf), seed);
+  if (nv_kvlog_begin(&log, nv_kvlog_commit_size() +
+                               nv_kvlog_record_size(NV_CHUNK)) ||
+      nv_kvlog_put(&log, 1, buf, NV_CHUNK) || nv_kvlog_commit(&log)) {
+    printf("nvrecord: log refuses updates after reboot\n");
+    return -1;
+  }
+  mod_drain(NORFLASH_API_MODULE_ID_USERDATA_EXT);
+  if (nv_kvlog_mount(&log, &nv_flash, FLASH_SIM_BASE + NV_OFFS,
+                     cfg.sector_size) ||
+      nv_kvlog_get(&log, 1, st.val[1], NV_CHUNK) != NV_CHUNK ||
+      memcmp(st.val[1], buf, NV_CHUNK)) {
+    printf("nvrecord: update after reboot lost\n");
+    return -1;
+  }
+  return 0;
+}
+
+//-------------------------------------------------------------------
+// OTA
+//-------------------------------------------------------------------
+
+static void ota_image(uint8_t *image) {
+  fill(image, OTA_IMAGE_LEN, seed ^ 0x07A07A);
+}
+
+static void ota_opera_cb(void *param) {
+  NORFLASH_API_OPERA_RESULT *result = (NORFLASH_API_OPERA_RESULT *)param;
+  uint32_t start;
+  uint32_t end;
+
+  if (result->type != NORFLASH_API_WRITTING)
+    return;
+  start = result->addr - (FLASH_SIM_BASE + OTA_OFFS);
+  end = start + result->len;
+  for (uint32_t p = (start + OTA_PACKET - 1) / OTA_PACKET;
+       (p + 1) * OTA_PACKET <= end && p < OTA_PACKETS; ++p)
+    mark_durable(p);
+}
+
+// What ota_flush_data_to_flash() does with a sector aligned buffer.
+static void ota_burn(uint32_t offs, uint8_t *buf, uint32_t len) {
+  enum NORFLASH_API_MODULE_ID_T mod = NORFLASH_API_MODULE_ID_OTA;
+
+  app_flash_page_erase(mod, offs);
+  app_flash_page_program(mod, offs, buf, len, false);
+  note_queue(mod);
+  app_flush_pending_flash_op(mod, NORFLASH_API_ALL);
+}
+
+static void ota_run(void) {
+  static uint8_t image[OTA_IMAGE_LEN];
+  uint8_t burn[OTA_BURN_LEN];
+  uint32_t burn_offs = 0;
+  uint32_t burn_len = 0;
+
+  // The previous image is still in the slot.
+  fill(flash_sim_mem() + OTA_OFFS, OTA_LEN, seed);
+  ota_image(image);
+  mod_register(NORFLASH_API_MODULE_ID_OTA, OTA_OFFS, OTA_LEN, ota_opera_cb);
+
+  for (uint32_t p = 0; p < OTA_PACKETS; ++p) {
+    flash_sim_idle_us(OTA_PACKET_GAP_US);
+    memcpy(burn + burn_len, image + p * OTA_PACKET, OTA_PACKET);
+    burn_len += OTA_PACKET;
+    issue_us[p] = flash_sim_now_us();
+    jnl->issued = p + 1;
+    jnl->res.payload += OTA_PACKET;
+    if (burn_len == OTA_BURN_LEN || p + 1 == OTA_PACKETS) {
+      call_begin();
+      ota_burn(OTA_OFFS + burn_offs, burn, burn_len);
+      call_end();
+      burn_offs += burn_len;
+      burn_len = 0;
+    }
+  }
+}
+
+static int ota_verify(void) {
+  static uint8_t image[OTA_IMAGE_LEN];
+  const uint8_t *flash = flash_sim_mem() + OTA_OFFS;
+
+  ota_image(image);
+  for (uint32_t p = 0; p < OTA_PACKETS; ++p) {
+    if (jnl->done[p] && memcmp(flash + p * OTA_PACKET, image + p * OTA_PACKET,
+                               OTA_PACKET)) {
+      printf("ota: acknowledged packet %u is corrupt\n", p);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+//-------------------------------------------------------------------
+// coredump
+//-------------------------------------------------------------------
+
+static void cd_dump(uint8_t *dump) { fill(dump, CD_DUMP_LEN, seed ^ 0xC0DE); }
+
+// The loops of core_dump_erase_section() and core_dump_write_large().
+static void cd_run(void) {
+  static uint8_t dump[CD_DUMP_LEN];
+  static uint8_t ota[OTA_BURN_LEN];
+  enum NORFLASH_API_MODULE_ID_T mod = NORFLASH_API_MODULE_ID_COREDUMP;
+  uint32_t base = FLASH_SIM_BASE + CD_OFFS;
+  uint32_t sectors = CD_DUMP_LEN / cfg.sector_size;
+  enum NORFLASH_API_RET_T ret;
+  uint32_t lock;
+
+  fill(flash_sim_mem() + CD_OFFS, CD_LEN, seed);
+  fill(flash_sim_mem() + OTA_OFFS, OTA_LEN, seed);
+  cd_dump(dump);
+  fill(ota, sizeof(ota), seed ^ 0x07A07A);
+  mod_register(NORFLASH_API_MODULE_ID_OTA, OTA_OFFS, OTA_LEN, NULL);
+  mod_register(mod, CD_OFFS, CD_LEN, NULL);
+
+  // The crash hits while an OTA sector is being erased.
+  app_flash_page_erase(NORFLASH_API_MODULE_ID_OTA, OTA_OFFS);
+  app_flash_page_program(NORFLASH_API_MODULE_ID_OTA, OTA_OFFS, ota,
+                         sizeof(ota), false);
+  norflash_api_flush();
+
+  for (uint32_t s = 0; s < CD_LEN / cfg.sector_size; ++s) {
+    call_begin();
+    lock = int_lock_global();
+    ret = norflash_api_erase(mod, base + s * cfg.sector_size, cfg.sector_size,
+                             false);
+    int_unlock_global(lock);
+    call_end();
+    ASSERT(ret == NORFLASH_API_OK, "%s: erase failed, ret = %d", __func__,
+           ret);
+  }
+  for (uint32_t s = 0; s < sectors; ++s) {
+    issue_us[s] = flash_sim_now_us();
+    jnl->issued = s + 1;
+    call_begin();
+    lock = int_lock_global();
+    ret = norflash_api_write(mod, base + s * cfg.sector_size,
+                             dump + s * cfg.sector_size, cfg.sector_size,
+                             false);
+    int_unlock_global(lock);
+    call_end();
+    ASSERT(ret == NORFLASH_API_OK, "%s: write failed, ret = %d", __func__,
+           ret);
+    jnl->res.payload += cfg.sector_size;
+    mark_durable(s);
+  }
+}
+
+static int cd_verify(void) {
+  static uint8_t dump[CD_DUMP_LEN];
+  const uint8_t *flash = flash_sim_mem() + CD_OFFS;
+
+  cd_dump(dump);
+  for (uint32_t s = 0; s < CD_DUMP_LEN / cfg.sector_size; ++s) {
+    if (jnl->done[s] && memcmp(flash + s * cfg.sector_size,
+                               dump + s * cfg.sector_size, cfg.sector_size)) {
+      printf("coredump: written sector %u is corrupt\n", s);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+//-------------------------------------------------------------------
+// Driver
+//-------------------------------------------------------------------
+
+static const bench_pattern_t patterns[] = {
+    {"nvrecord", nv_run, nv_verify, NV_BATCHES},
+    {"ota", ota_run, ota_verify, OTA_PACKETS},
+    {"coredump", cd_run, cd_verify, CD_DUMP_LEN / 4096},
+};
+
+// Boots a device child running |run|, or |verify| if given. Returns the
+// child's exit status, FLASH_SIM_POWER_CUT_EXIT if the power went first, or
+// -1 if it crashed.
+static int bench_boot(const bench_pattern_t *pat, bool verify,
+                      uint64_t cut_us) {
+  pid_t pid;
+  int status;
+
+  fflush(stdout);
+  pid = fork();
+  ASSERT(pid >= 0, "%s: fork failed", __func__);
+  if (pid == 0) {
+    flash_sim_init(&cfg);
+    norflash_api_init();
+    if (verify)
+      _exit(pat->verify() ? 1 : 0);
+    flash_sim_set_power_cut_us(cut_us);
+    pat->run();
+    jnl->res.elapsed_us = flash_sim_now_us();
+    flash_sim_get_stats(&jnl->res.flash);
+    _exit(0);
+  }
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status))
+    return -1;
+  return WEXITSTATUS(status);
+}
+
+static void bench_reset(void) {
+  memset(jnl, 0, sizeof(*jnl));
+  flash_sim_erase_all();
+}
+
+// A full run without power cuts. It must complete, get every unit
+// acknowledged and verify.
+static int bench_measure(const bench_pattern_t *pat, bench_result_t *res) {
+  bench_reset();
+  if (bench_boot(pat, false, 0) != 0) {
+    printf("%s: run failed\n", pat->name);
+    return -1;
+  }
+  *res = jnl->res;
+  if (jnl->durable != pat->units || res->durable_cnt != pat->units) {
+    printf("%s: only %u of %u units acknowledged\n", pat->name, jnl->durable,
+           pat->units);
+    return -1;
+  }
+  if (bench_boot(pat, true, 0) != 0) {
+    printf("%s: verify failed\n", pat->name);
+    return -1;
+  }
+  return 0;
+}
+
+// Returns the number of trials whose reboot found everything acknowledged.
+static uint32_t bench_power_cuts(const bench_pattern_t *pat, uint64_t span_us,
+                                 uint32_t trials) {
+  uint32_t state = seed;
+  uint32_t passed = 0;
+
+  for (uint32_t t = 0; t < trials; ++t) {
+    uint64_t cut_us = 1 + ((uint64_t)bench_rand(&state) << 16 |
+                           bench_rand(&state)) % span_us;
+    int status;
+
+    bench_reset();
+    status = bench_boot(pat, false, cut_us);
+    if (status != 0 && status != FLASH_SIM_POWER_CUT_EXIT) {
+      printf("%s: run crashed, cut at %llu us\n", pat->name,
+             (unsigned long long)cut_us);
+      continue;
+    }
+    if (bench_boot(pat, true, 0) != 0) {
+      printf("%s: recovery failed, cut at %llu us\n", pat->name,
+             (unsigned long long)cut_us);
+      continue;
+    }
+    passed++;
+  }
+  return passed;
+}
+
+static double ms(uint64_t us) { return us / 1000.0; }
+
+static void usage(const char *prog) {
+  printf("usage: %s [-t trials] [-s seed] [-p page_us] [-e erase_us] "
+         "[-l slice_us]\n",
+         prog);
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t trials = 50;
+  int failed = 0;
+  int opt;
+
+  flash_sim_default_cfg(&cfg);
+  while ((opt = getopt(argc, argv, "t:s:p:e:l:h")) != -1) {
+    switch (opt) {
+    case 't':
+      trials = strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      seed = strtoul(optarg, NULL, 0);
+      break;
+    case 'p':
+      cfg.page_program_us = strtoul(optarg, NULL, 0);
+      break;
+    case 'e':
+      cfg.sector_erase_us = strtoul(optarg, NULL, 0);
+      break;
+    case 'l':
+      cfg.suspend_slice_us = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 2;
+    }
+  }
+
+  jnl = (bench_journal_t *)mmap(NULL, sizeof(*jnl), PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  ASSERT(jnl != MAP_FAILED, "%s: mmap failed", __func__);
+  flash_sim_init(&cfg);
+
+  printf("norflash_api bench: write buffers %d, %s, page %u us, "
+         "sector erase %u us, suspend slice %u us, seed %u\n",
+         NORFLASH_API_WRITE_BUFF_LEN,
+#if defined(FLASH_SUSPEND)
+         "suspend",
+#else
+         "no suspend",
+#endif
+         cfg.page_program_us, cfg.sector_erase_us, cfg.suspend_slice_us, seed);
+  printf("%-9s %8s %9s %7s %6s %9s %5s %17s %9s %9s %6s %8s %9s\n", "pattern",
+         "bytes", "time ms", "KB/s", "stalls", "stall ms", "queue",
+         "durable avg/max", "lock ms", "busy ms", "erases", "suspends",
+         "power cut");
+
+  for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); ++i) {
+    const bench_pattern_t *pat = &patterns[i];
+    bench_result_t res;
+    uint32_t passed;
+
+    if (bench_measure(pat, &res)) {
+      failed = 1;
+      continue;
+    }
+    passed = bench_power_cuts(pat, res.elapsed_us, trials);
+    if (passed != trials)
+      failed = 1;
+    printf("%-9s %8llu %9.1f %7.1f %6u %9.1f %5u %8.1f/%8.1f %9.1f %9.1f "
+           "%6u %8u %4u/%-4u\n",
+           pat->name, (unsigned long long)res.payload, ms(res.elapsed_us),
+           res.payload / 1024.0 / (res.elapsed_us / 1e6), res.stalls,
+           ms(res.max_stall_us), res.max_queue,
+           ms(res.durable_sum_us / res.durable_cnt), ms(res.durable_max_us),
+           ms(res.flash.max_lock_us), ms(res.flash.max_busy_us),
+           res.flash.erases, res.flash.suspends, passed, trials);
+  }
+  return failed;
+}
@@ -0,0 +1,26 @@
+#ifndef __CMSIS_H__
+#define __CMSIS_H__
+
+// Host stand-in for platform/cmsis/inc/cmsis.h. The interrupt locks are
+// counted by the flash simulator so the bench can report how long they are
+// held; the simulated flash is mapped at FLASH_NC_BASE.
+
+#include "flash_sim.h"
+#include <stdint.h>
+
+#define FLASH_NC_BASE FLASH_SIM_BASE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t int_lock_global(void);
+void int_unlock_global(uint32_t pri);
+uint32_t int_lock(void);
+void int_unlock(uint32_t pri);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __CMSIS_H__
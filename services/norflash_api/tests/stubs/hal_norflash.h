@@ -0,0 +1,69 @@
+#ifndef __HAL_NORFLASH_H__
+#define __HAL_NORFLASH_H__
+
+// Host stand-in for platform/hal/hal_norflash.h, served by flash_sim.c.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum HAL_NORFLASH_ID_T {
+  HAL_NORFLASH_ID_0 = 0,
+  HAL_NORFLASH_ID_NUM,
+};
+
+enum HAL_NORFLASH_RET_T {
+  HAL_NORFLASH_OK,
+  HAL_NORFLASH_SUSPENDED,
+  HAL_NORFLASH_ERR,
+  HAL_NORFLASH_BAD_ID,
+  HAL_NORFLASH_BAD_DIV,
+  HAL_NORFLASH_BAD_CALIB_ID,
+  HAL_NORFLASH_BAD_CFG,
+  HAL_NORFLASH_BAD_OP,
+  HAL_NORFLASH_BAD_CALIB_MAGIC,
+  HAL_NORFLASH_BAD_ADDR,
+  HAL_NORFLASH_BAD_LEN,
+  HAL_NORFLASH_NOT_OPENED,
+  HAL_NORFLASH_CFG_NULL,
+};
+
+enum HAL_NORFLASH_RET_T hal_norflash_get_size(enum HAL_NORFLASH_ID_T id,
+                                              uint32_t *total_size,
+                                              uint32_t *block_size,
+                                              uint32_t *sector_size,
+                                              uint32_t *page_size);
+enum HAL_NORFLASH_RET_T hal_norflash_erase_suspend(enum HAL_NORFLASH_ID_T id,
+                                                   uint32_t start_address,
+                                                   uint32_t len, int suspend);
+enum HAL_NORFLASH_RET_T hal_norflash_erase(enum HAL_NORFLASH_ID_T id,
+                                           uint32_t start_address,
+                                           uint32_t len);
+enum HAL_NORFLASH_RET_T hal_norflash_erase_resume(enum HAL_NORFLASH_ID_T id,
+                                                  int suspend);
+enum HAL_NORFLASH_RET_T hal_norflash_write_suspend(enum HAL_NORFLASH_ID_T id,
+                                                   uint32_t start_address,
+                                                   const uint8_t *buffer,
+                                                   uint32_t len, int suspend);
+enum HAL_NORFLASH_RET_T hal_norflash_write(enum HAL_NORFLASH_ID_T id,
+                                           uint32_t start_address,
+                                           const uint8_t *buffer,
+                                           uint32_t len);
+enum HAL_NORFLASH_RET_T hal_norflash_write_resume(enum HAL_NORFLASH_ID_T id,
+                                                  int suspend);
+enum HAL_NORFLASH_RET_T hal_norflash_read(enum HAL_NORFLASH_ID_T id,
+                                          uint32_t start_address,
+                                          uint8_t *buffer, uint32_t len);
+enum HAL_NORFLASH_RET_T hal_norflash_enable_remap(enum HAL_NORFLASH_ID_T id,
+                                                  uint32_t addr, uint32_t len,
+                                                  uint32_t offset);
+enum HAL_NORFLASH_RET_T hal_norflash_disable_remap(enum HAL_NORFLASH_ID_T id);
+int hal_norflash_get_remap_status(enum HAL_NORFLASH_ID_T id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HAL_NORFLASH_H__
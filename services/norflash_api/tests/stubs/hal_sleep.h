@@ -0,0 +1,40 @@
+#ifndef __HAL_SLEEP_H__
+#define __HAL_SLEEP_H__
+
+// Host stand-in for platform/hal/hal_sleep.h. The simulator keeps the hooks
+// and runs them when the bench idles.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum HAL_SLEEP_HOOK_USER_T {
+  HAL_SLEEP_HOOK_USER_NVRECORD = 0,
+  HAL_SLEEP_HOOK_USER_OTA,
+  HAL_SLEEP_HOOK_NORFLASH_API,
+  HAL_SLEEP_HOOK_DUMP_LOG,
+  HAL_SLEEP_HOOK_USER_QTY
+};
+
+enum HAL_DEEP_SLEEP_HOOK_USER_T {
+  HAL_DEEP_SLEEP_HOOK_USER_WDT = 0,
+  HAL_DEEP_SLEEP_HOOK_USER_NVRECORD,
+  HAL_DEEP_SLEEP_HOOK_USER_OTA,
+  HAL_DEEP_SLEEP_HOOK_NORFLASH_API,
+  HAL_DEEP_SLEEP_HOOK_DUMP_LOG,
+  HAL_DEEP_SLEEP_HOOK_USER_QTY
+};
+
+typedef int (*HAL_SLEEP_HOOK_HANDLER)(void);
+typedef int (*HAL_DEEP_SLEEP_HOOK_HANDLER)(void);
+
+int hal_sleep_set_sleep_hook(enum HAL_SLEEP_HOOK_USER_T user,
+                             HAL_SLEEP_HOOK_HANDLER handler);
+int hal_sleep_set_deep_sleep_hook(enum HAL_DEEP_SLEEP_HOOK_USER_T user,
+                                  HAL_DEEP_SLEEP_HOOK_HANDLER handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HAL_SLEEP_H__
@@ -0,0 +1,19 @@
+#ifndef __HAL_TIMER_H__
+#define __HAL_TIMER_H__
+
+// Host stand-in for platform/hal/hal_timer.h: delays advance the simulated
+// clock.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int osDelay(uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HAL_TIMER_H__
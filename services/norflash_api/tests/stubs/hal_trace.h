@@ -0,0 +1,26 @@
+#ifndef __HAL_TRACE_H__
+#define __HAL_TRACE_H__
+
+// Host stand-in for platform/hal/hal_trace.h: ASSERT prints and aborts,
+// TRACE is dropped.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TRACE(num, str, ...)                                                   \
+  do {                                                                         \
+  } while (0)
+
+#define ASSERT(cond, str, ...)                                                 \
+  {                                                                            \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "ASSERT %s:%d: " str "\n", __FILE__, __LINE__,          \
+              ##__VA_ARGS__);                                                  \
+      abort();                                                                 \
+    }                                                                          \
+  }
+
+static inline int hal_trace_pause(void) { return 0; }
+static inline int hal_trace_continue(void) { return 0; }
+
+#endif // __HAL_TRACE_H__
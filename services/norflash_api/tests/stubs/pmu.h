@@ -0,0 +1,9 @@
+#ifndef __PMU_H__
+#define __PMU_H__
+
+// Host stand-in for platform/drivers/ana/pmu.h.
+
+static inline void pmu_flash_write_config(void) {}
+static inline void pmu_flash_read_config(void) {}
+
+#endif // __PMU_H__
@@ -31,8 +31,10 @@
 #include "nvrecord_dma_config.h"
 #include "nvrecord_env.h"
 #include "nvrecord_fp_account_key.h"
+#include "nvrecord_kvlog.h"
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 
 extern uint32_t __userdata_start[];
@@ -51,29 +53,44 @@ nvrecord_rebuild_dma_configuration(NV_DMA_CONFIGURATION_T *pDmaConfig);
 
 typedef enum {
   NV_STATE_IDLE,
-  NV_STATE_MAIN_ERASING,
-  NV_STATE_MAIN_ERASED,
-  NV_STATE_MAIN_WRITTING,
-  NV_STATE_MAIN_WRITTEN,
-  NV_STATE_MAIN_DONE,
-  NV_STATE_BAK_ERASING,
-  NV_STATE_BAK_ERASED,
-  NV_STATE_BAK_WRITTING,
-  NV_STATE_BAK_WRITTEN,
-  NV_STATE_BAK_DONE,
+  NV_STATE_APPENDED, // records queued, norflash_api still programming them
 } NV_STATE;
 
 typedef struct {
   bool is_update;
   NV_STATE state;
-  uint32_t written_size;
 } NV_FLUSH_STATE;
 
+/*
+ * The two userdata sectors hold an append-only key/value log (see
+ * nvrecord_kvlog.h). Key 0 is the record header, then the record body is
+ * split into NV_EXTENSION_CHUNK_SIZE byte chunks, one key each, so a flush
+ * only appends the chunks that changed. A full snapshot must fit in one
+ * sector.
+ */
+#define NV_EXTENSION_CHUNK_SIZE 64
+#define NV_EXTENSION_CHUNK_NUM                                                 \
+  ((NV_EXTENSION_VALID_LEN + NV_EXTENSION_CHUNK_SIZE - 1) /                    \
+   NV_EXTENSION_CHUNK_SIZE)
+#define NV_EXTENSION_LOG_KEY_HEADER 0
+#define NV_EXTENSION_LOG_KEY_CHUNK(i) ((i) + 1)
+#define NV_EXTENSION_LOG_HEADER_LEN offsetof(NVRECORD_HEADER_T, crc32)
+
+STATIC_ASSERT(NV_EXTENSION_CHUNK_NUM + 1 <= NV_KVLOG_MAX_KEYS,
+              "NV extension has too many chunks for the log");
+
 static NV_FLUSH_STATE nv_flsh_state;
 static bool nvrec_init = false;
 static uint32_t _user_data_main_start;
 static uint32_t _user_data_bak_start;
-static uint8_t _nv_burn_buf[NV_EXTENSION_PAGE_SIZE];
+
+static nv_kvlog_t nv_kvlog;
+// crc32 of each chunk as last appended to the log
+static uint32_t nv_chunk_crc[NV_EXTENSION_CHUNK_NUM];
+// write the header and every chunk on the next flush
+static bool nv_log_full_sync;
+// sector to start a fresh log in before the next flush, -1 for none
+static int8_t nv_log_format_sector = -1;
 
 NV_EXTENSION_RECORD_T *nvrecord_extension_p = NULL;
 
@@ -313,6 +330,176 @@ static void _nv_record_extension_init(void) {
          result);
 }
 
+static int nv_kvlog_flash_read(uint32_t addr, void *buf, uint32_t len) {
+  enum NORFLASH_API_RET_T ret;
+
+  ret = norflash_api_read(NORFLASH_API_MODULE_ID_USERDATA_EXT, addr,
+                          (uint8_t *)buf, len);
+  return (ret == NORFLASH_API_OK) ? 0 : -1;
+}
+
+static int nv_kvlog_flash_write(uint32_t addr, const void *buf, uint32_t len) {
+  enum NORFLASH_API_RET_T ret;
+
+  do {
+    ret = norflash_api_write(NORFLASH_API_MODULE_ID_USERDATA_EXT, addr,
+                             (const uint8_t *)buf, len, true);
+    if (ret == NORFLASH_API_BUFFER_FULL) {
+      do {
+        norflash_api_flush();
+      } while (norflash_api_get_free_buffer_count(NORFLASH_API_WRITTING) == 0);
+    }
+  } while (ret == NORFLASH_API_BUFFER_FULL);
+  if (ret != NORFLASH_API_OK) {
+    TRACE(3, "%s: err,ret = %d,addr = 0x%x.", __func__, ret, addr);
+  }
+  return (ret == NORFLASH_API_OK) ? 0 : -1;
+}
+
+static int nv_kvlog_flash_erase(uint32_t addr, uint32_t len) {
+  enum NORFLASH_API_RET_T ret;
+
+  do {
+    ret = norflash_api_erase(NORFLASH_API_MODULE_ID_USERDATA_EXT, addr, len,
+                             true);
+    if (ret == NORFLASH_API_BUFFER_FULL) {
+      do {
+        norflash_api_flush();
+      } while (norflash_api_get_free_buffer_count(NORFLASH_API_ERASING) == 0);
+    }
+  } while (ret == NORFLASH_API_BUFFER_FULL);
+  if (ret != NORFLASH_API_OK) {
+    TRACE(3, "%s: err,ret = %d,addr = 0x%x.", __func__, ret, addr);
+  }
+  return (ret == NORFLASH_API_OK) ? 0 : -1;
+}
+
+static const nv_kvlog_flash_t nv_kvlog_flash = {
+    nv_kvlog_flash_read,
+    nv_kvlog_flash_write,
+    nv_kvlog_flash_erase,
+};
+
+static uint32_t nv_record_chunk_len(uint32_t valid_len, uint32_t i) {
+  uint32_t offs = i * NV_EXTENSION_CHUNK_SIZE;
+  uint32_t len = valid_len - offs;
+
+  return len < NV_EXTENSION_CHUNK_SIZE ? len : NV_EXTENSION_CHUNK_SIZE;
+}
+
+static void nv_record_update_chunk_crc(void) {
+  uint8_t *body = (uint8_t *)nvrecord_extension_p + NV_EXTENSION_HEADER_SIZE;
+
+  for (uint32_t i = 0; i < NV_EXTENSION_CHUNK_NUM; i++) {
+    nv_chunk_crc[i] = crc32(0, body + i * NV_EXTENSION_CHUNK_SIZE,
+                            nv_record_chunk_len(NV_EXTENSION_VALID_LEN, i));
+  }
+}
+
+// Fills the mirror from the mounted log. Returns false if the log holds no
+// record of this major version, leaving the mirror to be rebuilt.
+static bool nv_record_load_from_log(void) {
+  NVRECORD_HEADER_T header;
+  uint8_t *body = (uint8_t *)nvrecord_extension_p + NV_EXTENSION_HEADER_SIZE;
+  uint32_t chunk_num;
+  int len;
+
+  len = nv_kvlog_get(&nv_kvlog, NV_EXTENSION_LOG_KEY_HEADER, &header,
+                     sizeof(header));
+  if (len != (int)NV_EXTENSION_LOG_HEADER_LEN) {
+    TRACE(1, "%s: no header in log.", __func__);
+    return false;
+  }
+  TRACE(4, "%s: magic 0x%x version %d valid len %d", __func__,
+        header.magicNumber, header.majorVersion, header.validLen);
+  if (header.magicNumber != NV_EXTENSION_MAGIC_NUMBER ||
+      header.majorVersion != NV_EXTENSION_MAJOR_VERSION) {
+    return false;
+  }
+  if (header.validLen > NV_EXTENSION_VALID_LEN) {
+    TRACE(0, "Valid length of extension must be increased,"
+             "use the default value.");
+    return false;
+  }
+
+  chunk_num = (header.validLen + NV_EXTENSION_CHUNK_SIZE - 1) /
+              NV_EXTENSION_CHUNK_SIZE;
+  for (uint32_t i = 0; i < chunk_num; i++) {
+    uint32_t chunk_len = nv_record_chunk_len(header.validLen, i);
+    len = nv_kvlog_get(&nv_kvlog, NV_EXTENSION_LOG_KEY_CHUNK(i),
+                       body + i * NV_EXTENSION_CHUNK_SIZE, chunk_len);
+    if (len != (int)chunk_len) {
+      TRACE(2, "%s: chunk %d missing.", __func__, i);
+      return false;
+    }
+  }
+
+  nv_record_update_chunk_crc();
+  if (NV_EXTENSION_VALID_LEN > header.validLen) {
+    TRACE(2, "NV extension is extended! (0x%x) -> (0x%x)", header.validLen,
+          NV_EXTENSION_VALID_LEN);
+    nv_log_full_sync = true;
+    nv_flsh_state.is_update = true;
+  }
+  return true;
+}
+
+// Queues one batch holding every chunk that changed since the last one.
+// Runs with the global interrupt lock held.
+static void nv_record_append_to_log(void) {
+  uint8_t *body = (uint8_t *)nvrecord_extension_p + NV_EXTENSION_HEADER_SIZE;
+  uint32_t crc[NV_EXTENSION_CHUNK_NUM];
+  uint32_t need = nv_kvlog_commit_size();
+  uint32_t dirty = 0;
+  int ret;
+
+  if (nv_log_format_sector >= 0) {
+    ret = nv_kvlog_format(&nv_kvlog, nv_log_format_sector);
+    ASSERT(ret == 0, "%s: nv_kvlog_format(%d) failed!", __func__,
+           nv_log_format_sector);
+    nv_log_format_sector = -1;
+    nv_log_full_sync = true;
+  }
+
+  if (nv_log_full_sync) {
+    need += nv_kvlog_record_size(NV_EXTENSION_LOG_HEADER_LEN);
+  }
+  for (uint32_t i = 0; i < NV_EXTENSION_CHUNK_NUM; i++) {
+    uint32_t len = nv_record_chunk_len(NV_EXTENSION_VALID_LEN, i);
+    crc[i] = crc32(0, body + i * NV_EXTENSION_CHUNK_SIZE, len);
+    if (nv_log_full_sync || crc[i] != nv_chunk_crc[i]) {
+      need += nv_kvlog_record_size(len);
+      dirty++;
+    }
+  }
+  if (dirty == 0 && !nv_log_full_sync) {
+    return;
+  }
+
+  ret = nv_kvlog_begin(&nv_kvlog, need);
+  ASSERT(ret == 0, "%s: no room for %d bytes!", __func__, need);
+  if (nv_log_full_sync) {
+    ret = nv_kvlog_put(&nv_kvlog, NV_EXTENSION_LOG_KEY_HEADER,
+                       &nvrecord_extension_p->header,
+                       NV_EXTENSION_LOG_HEADER_LEN);
+    ASSERT(ret == 0, "%s: header put failed!", __func__);
+  }
+  for (uint32_t i = 0; i < NV_EXTENSION_CHUNK_NUM; i++) {
+    if (nv_log_full_sync || crc[i] != nv_chunk_crc[i]) {
+      ret = nv_kvlog_put(&nv_kvlog, NV_EXTENSION_LOG_KEY_CHUNK(i),
+                         body + i * NV_EXTENSION_CHUNK_SIZE,
+                         nv_record_chunk_len(NV_EXTENSION_VALID_LEN, i));
+      ASSERT(ret == 0, "%s: chunk %d put failed!", __func__, i);
+      nv_chunk_crc[i] = crc[i];
+    }
+  }
+  ret = nv_kvlog_commit(&nv_kvlog);
+  ASSERT(ret == 0, "%s: commit failed!", __func__);
+  nv_log_full_sync = false;
+  TRACE(4, "%s: %d chunks appended, sector %d free 0x%x", __func__, dirty,
+        nv_kvlog.active, nv_kvlog_free_space(&nv_kvlog));
+}
+
 uint32_t nv_record_pre_write_operation(void) {
   uint32_t lock = int_lock_global();
   mpu_clear(MPU_ID_USER_DATA_SECTION);
@@ -331,8 +518,6 @@ void nv_record_post_write_operation(uint32_t lock) {
 
 static void nv_record_extension_init(void) {
   uint32_t lock;
-  bool main_is_valid = false;
-  bool bak_is_valid = false;
   bool data_is_valid = false;
 
   if (nvrec_init) {
@@ -345,8 +530,9 @@ static void nv_record_extension_init(void) {
   _nv_record_extension_init();
 
   nv_flsh_state.is_update = false;
-  nv_flsh_state.written_size = 0;
   nv_flsh_state.state = NV_STATE_IDLE;
+  nv_log_full_sync = false;
+  nv_log_format_sector = -1;
 
   nvrecord_extension_p = &local_extension_data.nv_record;
 
@@ -362,55 +548,48 @@ static void nv_record_extension_init(void) {
            nvrecord_extension_p->header.validLen);
   }
 
-  // Check main sector.
-  if (nv_record_data_is_valid((NV_EXTENSION_RECORD_T *)_user_data_main_start) &&
-      nv_record_items_is_valid(
-          (NV_EXTENSION_RECORD_T *)_user_data_main_start)) {
-    TRACE(2, "%s,main sector is valid.", __func__);
-    main_is_valid = true;
-  } else {
-    TRACE(1, "%s,main sector is invalid!", __func__);
-    main_is_valid = false;
-  }
-
-  // Check bak secotr.
-  if (nv_record_data_is_valid((NV_EXTENSION_RECORD_T *)_user_data_bak_start) &&
-      nv_record_items_is_valid(
-          (NV_EXTENSION_RECORD_T *)_user_data_main_start)) {
-    TRACE(2, "%s,bak sector is valid.", __func__);
-    bak_is_valid = true;
-  } else {
-    TRACE(1, "%s,bak sector is invalid!", __func__);
-    bak_is_valid = false;
-  }
-
-  if (main_is_valid) {
-    data_is_valid = true;
-    if (!bak_is_valid) {
-      nv_flsh_state.is_update = true;
-      nv_flsh_state.state = NV_STATE_MAIN_DONE;
-    }
-  } else {
-    if (bak_is_valid) {
+  if (nv_kvlog_mount(&nv_kvlog, &nv_kvlog_flash, _user_data_main_start,
+                     NV_EXTENSION_SIZE) == 0) {
+    if (nv_record_load_from_log()) {
+      TRACE(2, "%s,log in sector %d is valid.", __func__, nv_kvlog.active);
       data_is_valid = true;
-      nv_flsh_state.is_update = true;
-      nv_flsh_state.state = NV_STATE_IDLE;
     } else {
-      data_is_valid = false;
+      nv_log_format_sector = nv_kvlog.active ^ 1;
     }
-  }
-
-  if (data_is_valid) {
-    TRACE(2, "%s,data is valid.", __func__);
-    if (main_is_valid) {
+  } else {
+    // No log yet: take over a record written by the former main/bak layout.
+    // The log starts in the sector the data is not read from, so a power cut
+    // before its first commit leaves the old copy in place.
+    if (nv_record_data_is_valid(
+            (NV_EXTENSION_RECORD_T *)_user_data_main_start) &&
+        nv_record_items_is_valid(
+            (NV_EXTENSION_RECORD_T *)_user_data_main_start)) {
+      TRACE(2, "%s,migrate main sector.", __func__);
       memcpy((uint8_t *)nvrecord_extension_p + NV_EXTENSION_HEADER_SIZE,
              (uint8_t *)_user_data_main_start + NV_EXTENSION_HEADER_SIZE,
              NV_EXTENSION_VALID_LEN);
-    } else {
+      nv_log_format_sector = 1;
+      data_is_valid = true;
+    } else if (nv_record_data_is_valid(
+                   (NV_EXTENSION_RECORD_T *)_user_data_bak_start) &&
+               nv_record_items_is_valid(
+                   (NV_EXTENSION_RECORD_T *)_user_data_bak_start)) {
+      TRACE(2, "%s,migrate bak sector.", __func__);
       memcpy((uint8_t *)nvrecord_extension_p + NV_EXTENSION_HEADER_SIZE,
              (uint8_t *)_user_data_bak_start + NV_EXTENSION_HEADER_SIZE,
              NV_EXTENSION_VALID_LEN);
+      nv_log_format_sector = 0;
+      data_is_valid = true;
+    } else {
+      nv_log_format_sector = 0;
+    }
+    if (data_is_valid) {
+      nv_record_extension_update();
     }
+  }
+
+  if (data_is_valid) {
+    TRACE(2, "%s,data is valid.", __func__);
     nvrecord_extension_p->header.crc32 =
         crc32(0, ((uint8_t *)nvrecord_extension_p + NV_EXTENSION_HEADER_SIZE),
               nvrecord_extension_p->header.validLen);
@@ -439,359 +618,55 @@ NV_EXTENSION_RECORD_T *nv_record_get_extension_entry_ptr(void) {
 
 void nv_record_extension_update(void) { nv_flsh_state.is_update = true; }
 
-static int nv_record_extension_flush_main(bool is_async) {
-  uint32_t crc;
+static int nv_record_extension_flush(bool is_async) {
   uint32_t lock;
-  enum NORFLASH_API_RET_T ret = NORFLASH_API_OK;
 
   if (NULL == nvrecord_extension_p) {
     TRACE(1, "%s,nvrecord_extension_p is null.", __func__);
-    goto _func_end;
+    return 0;
   }
 
-  // TRACE(3, "%s is_async %d state %d", __func__, is_async,
-  // nv_flsh_state.state);
-
-  if (is_async) {
-    if (nv_flsh_state.state == NV_STATE_IDLE &&
-        nv_flsh_state.is_update == true) {
-      TRACE(3, "%s: async flush begin!", __func__);
-    }
-
-    hal_trace_pause();
-    lock = int_lock_global();
-
-    if (nv_flsh_state.state == NV_STATE_IDLE ||
-        nv_flsh_state.state == NV_STATE_MAIN_ERASING) {
-      if (nv_flsh_state.state == NV_STATE_IDLE) {
-        nv_flsh_state.state = NV_STATE_MAIN_ERASING;
-        TRACE(4, "%s: NV_STATE_MAIN_ERASING", __func__);
-      }
-
-      ret = norflash_api_erase(NORFLASH_API_MODULE_ID_USERDATA_EXT,
-                               (uint32_t)(__userdata_start), NV_EXTENSION_SIZE,
-                               true);
-      if (ret == NORFLASH_API_OK) {
-        nv_flsh_state.state = NV_STATE_MAIN_ERASED;
-        TRACE(4, "%s: NV_STATE_MAIN_ERASED", __func__);
-        TRACE(4, "%s: norflash_api_erase ok,addr = 0x%x.", __func__,
-              _user_data_main_start);
-      } else if (ret == NORFLASH_API_BUFFER_FULL) {
-        norflash_api_flush();
-      } else {
-        ASSERT(0, "%s: norflash_api_erase err,ret = %d,addr = 0x%x.", __func__,
-               ret, _user_data_main_start);
-      }
-    } else if (nv_flsh_state.state == NV_STATE_MAIN_ERASED ||
-               nv_flsh_state.state == NV_STATE_MAIN_WRITTING) {
-      if (nv_flsh_state.state == NV_STATE_MAIN_ERASED) {
-        nv_flsh_state.state = NV_STATE_MAIN_WRITTING;
-        TRACE(4, "%s: NV_STATE_MAIN_WRITTING", __func__);
-      }
-      uint32_t tmpLock = nv_record_pre_write_operation();
-      crc = crc32(0, (uint8_t *)nvrecord_extension_p + NV_EXTENSION_HEADER_SIZE,
-                  NV_EXTENSION_VALID_LEN);
-      nvrecord_extension_p->header.crc32 = crc;
-      ASSERT(nv_record_data_is_valid(nvrecord_extension_p) &&
-                 nv_record_items_is_valid(nvrecord_extension_p),
-             "%s nv_record is invalid!", __func__);
-      ret = norflash_api_write(
-          NORFLASH_API_MODULE_ID_USERDATA_EXT, (uint32_t)(__userdata_start),
-          (uint8_t *)nvrecord_extension_p, NV_EXTENSION_SIZE, true);
-      nv_record_post_write_operation(tmpLock);
-      if (ret == NORFLASH_API_OK) {
-        nv_flsh_state.is_update = false;
-        nv_flsh_state.state = NV_STATE_MAIN_WRITTEN;
-        TRACE(4, "%s: NV_STATE_MAIN_WRITTEN", __func__);
-        TRACE(4, "%s: norflash_api_write ok,addr = 0x%x.", __func__,
-              _user_data_main_start);
-      } else if (ret == NORFLASH_API_BUFFER_FULL) {
-        norflash_api_flush();
-      } else {
-        ASSERT(0, "%s: norflash_api_write err,ret = %d,addr = 0x%x.", __func__,
-               ret, _user_data_main_start);
+  // TRACE(3, "%s state %d is_update %d", __func__, nv_flsh_state.state,
+  // nv_flsh_state.is_update);
+  do {
+    if (nv_flsh_state.state == NV_STATE_IDLE) {
+      if (nv_flsh_state.is_update == FALSE) {
+        break;
       }
-    } else {
-      if (norflash_api_get_used_buffer_count(
-              NORFLASH_API_MODULE_ID_USERDATA_EXT, NORFLASH_API_ALL) == 0) {
-        nv_flsh_state.state = NV_STATE_MAIN_DONE;
-        // TRACE(1,"%s: NV_STATE_MAIN_DONE", __func__);
-        TRACE(1, "%s: async flush done.", __func__);
-      } else {
-        norflash_api_flush();
+      TRACE(2, "%s: %s flush begin!", __func__, is_async ? "async" : "sync");
+      hal_trace_pause();
+      lock = int_lock_global();
+      nv_flsh_state.is_update = false;
+      nv_record_append_to_log();
+      nv_flsh_state.state = NV_STATE_APPENDED;
+      int_unlock_global(lock);
+      hal_trace_continue();
+      if (is_async) {
+        break;
       }
     }
-    int_unlock_global(lock);
-    hal_trace_continue();
-  } else {
-    TRACE(4, "%s: sync flush begin!", __func__);
-    if (nv_flsh_state.state == NV_STATE_IDLE ||
-        nv_flsh_state.state == NV_STATE_MAIN_ERASING) {
-      do {
-        hal_trace_pause();
-        lock = int_lock_global();
-        ret = norflash_api_erase(NORFLASH_API_MODULE_ID_USERDATA_EXT,
-                                 (uint32_t)(__userdata_start),
-                                 NV_EXTENSION_SIZE, true);
-        int_unlock_global(lock);
-        hal_trace_continue();
-        if (ret == NORFLASH_API_OK) {
-          nv_flsh_state.state = NV_STATE_MAIN_ERASED;
-          TRACE(4, "%s: norflash_api_erase ok,addr = 0x%x.", __func__,
-                _user_data_main_start);
-        } else if (ret == NORFLASH_API_BUFFER_FULL) {
-          do {
-            norflash_api_flush();
-          } while (norflash_api_get_free_buffer_count(NORFLASH_API_ERASING) ==
-                   0);
-        } else {
-          ASSERT(0, "%s: norflash_api_erase err,ret = %d,addr = 0x%x.",
-                 __func__, ret, _user_data_main_start);
-        }
-
-      } while (ret == NORFLASH_API_BUFFER_FULL);
-    }
-
-    if (nv_flsh_state.state == NV_STATE_MAIN_ERASED ||
-        nv_flsh_state.state == NV_STATE_MAIN_WRITTING) {
-      do {
-        hal_trace_pause();
-        uint32_t tmpLock = nv_record_pre_write_operation();
-        crc =
-            crc32(0, (uint8_t *)nvrecord_extension_p + NV_EXTENSION_HEADER_SIZE,
-                  NV_EXTENSION_VALID_LEN);
-        nvrecord_extension_p->header.crc32 = crc;
-        ASSERT(nv_record_data_is_valid(nvrecord_extension_p) &&
-                   nv_record_items_is_valid(nvrecord_extension_p),
-               "%s nv_record is invalid!", __func__);
-        ret = norflash_api_write(
-            NORFLASH_API_MODULE_ID_USERDATA_EXT, (uint32_t)(__userdata_start),
-            (uint8_t *)nvrecord_extension_p, NV_EXTENSION_SIZE, true);
-        nv_record_post_write_operation(tmpLock);
-        hal_trace_continue();
-        if (ret == NORFLASH_API_OK) {
-          nv_flsh_state.is_update = false;
-          nv_flsh_state.state = NV_STATE_MAIN_WRITTEN;
-          TRACE(4, "%s: norflash_api_write ok,addr = 0x%x.", __func__,
-                _user_data_main_start);
-        } else if (ret == NORFLASH_API_BUFFER_FULL) {
-          do {
-            norflash_api_flush();
-          } while (norflash_api_get_free_buffer_count(NORFLASH_API_WRITTING) ==
-                   0);
-        } else {
-          ASSERT(0, "%s: norflash_api_write err,ret = %d,addr = 0x%x.",
-                 __func__, ret, _user_data_main_start);
-        }
-      } while (ret == NORFLASH_API_BUFFER_FULL);
-    }
-
-    do {
-      norflash_api_flush();
-    } while (norflash_api_get_used_buffer_count(
-                 NORFLASH_API_MODULE_ID_USERDATA_EXT, NORFLASH_API_ALL) > 0);
-
-    nv_flsh_state.state = NV_STATE_MAIN_DONE;
-    TRACE(1, "%s: sync flush done.", __func__);
-  }
-_func_end:
-  return (ret == NORFLASH_API_OK) ? 0 : 1;
-}
 
-static int nv_record_extension_flush_bak(bool is_async) {
-  uint32_t lock;
-  enum NORFLASH_API_RET_T ret = NORFLASH_API_OK;
-  uint8_t *burn_buf = (uint8_t *)_nv_burn_buf;
-
-  if (is_async) {
-    hal_trace_pause();
-    lock = int_lock_global();
-    if (nv_flsh_state.state == NV_STATE_MAIN_DONE ||
-        nv_flsh_state.state == NV_STATE_BAK_ERASING) {
-      if (nv_flsh_state.state == NV_STATE_MAIN_DONE) {
-        nv_flsh_state.state = NV_STATE_BAK_ERASING;
-        TRACE(3, "%s: async flush begin", __func__);
-      }
-      ret = norflash_api_erase(NORFLASH_API_MODULE_ID_USERDATA_EXT,
-                               _user_data_bak_start, NV_EXTENSION_SIZE, true);
-      if (ret == NORFLASH_API_OK) {
-        nv_flsh_state.state = NV_STATE_BAK_ERASED;
-        TRACE(4, "%s: norflash_api_erase ok,addr = 0x%x.", __func__,
-              _user_data_bak_start);
-        // TRACE(4,"%s: NV_STATE_BAK_ERASED", __func__);
-      } else if (ret == NORFLASH_API_BUFFER_FULL) {
-        norflash_api_flush();
-      } else {
-        ASSERT(0, "%s: norflash_api_erase err,ret = %d,addr = 0x%x.", __func__,
-               ret, _user_data_bak_start);
-      }
-    } else if (nv_flsh_state.state == NV_STATE_BAK_ERASED ||
-               nv_flsh_state.state == NV_STATE_BAK_WRITTING) {
-      if (nv_flsh_state.state == NV_STATE_BAK_ERASED) {
-        nv_flsh_state.state = NV_STATE_BAK_WRITTING;
-        nv_flsh_state.written_size = 0;
-        // TRACE(4,"%s: NV_STATE_BAK_WRITTING", __func__);
-      }
-      do {
-        ret = norflash_api_read(NORFLASH_API_MODULE_ID_USERDATA_EXT,
-                                _user_data_main_start +
-                                    nv_flsh_state.written_size,
-                                burn_buf, NV_EXTENSION_PAGE_SIZE);
-        ASSERT(ret == NORFLASH_API_OK,
-               "norflash_api_read failed! ret = %d, addr = 0x%x.", (int32_t)ret,
-               _user_data_main_start + nv_flsh_state.written_size);
-
-        ret = norflash_api_write(NORFLASH_API_MODULE_ID_USERDATA_EXT,
-                                 _user_data_bak_start +
-                                     nv_flsh_state.written_size,
-                                 burn_buf, NV_EXTENSION_PAGE_SIZE, true);
-        if (ret == NORFLASH_API_OK) {
-          nv_flsh_state.written_size += NV_EXTENSION_PAGE_SIZE;
-
-          if (nv_flsh_state.written_size == NV_EXTENSION_SIZE) {
-            nv_flsh_state.state = NV_STATE_BAK_WRITTEN;
-            // TRACE(4,"%s: NV_STATE_BAK_WRITTEN", __func__);
-            break;
-          }
-        } else if (ret == NORFLASH_API_BUFFER_FULL) {
-          norflash_api_flush();
-          break;
-        } else {
-          ASSERT(0, "%s: norflash_api_write err,ret = %d,addr = 0x%x.",
-                 __func__, ret,
-                 _user_data_bak_start + nv_flsh_state.written_size);
-        }
-      } while (1);
-    } else {
+    if (is_async) {
       if (norflash_api_get_used_buffer_count(
               NORFLASH_API_MODULE_ID_USERDATA_EXT, NORFLASH_API_ALL) == 0) {
-        nv_flsh_state.state = NV_STATE_BAK_DONE;
-        TRACE(3, "%s: async flush done.", __func__);
+        nv_flsh_state.state = NV_STATE_IDLE;
+        TRACE(1, "%s: async flush done.", __func__);
       } else {
-        norflash_api_flush();
-      }
-    }
-    int_unlock_global(lock);
-    hal_trace_continue();
-  } else {
-    TRACE(4, "%s: sync flush begin.", __func__);
-    if (nv_flsh_state.state == NV_STATE_MAIN_DONE ||
-        nv_flsh_state.state == NV_STATE_BAK_ERASING) {
-      do {
         hal_trace_pause();
-        lock = int_lock_global();
-        ret = norflash_api_erase(NORFLASH_API_MODULE_ID_USERDATA_EXT,
-                                 _user_data_bak_start, NV_EXTENSION_SIZE, true);
-        int_unlock_global(lock);
+        norflash_api_flush();
         hal_trace_continue();
-        if (ret == NORFLASH_API_OK) {
-          nv_flsh_state.state = NV_STATE_BAK_ERASED;
-          TRACE(4, "%s: norflash_api_erase ok,addr = 0x%x.", __func__,
-                _user_data_bak_start);
-        } else if (ret == NORFLASH_API_BUFFER_FULL) {
-          do {
-            norflash_api_flush();
-          } while (norflash_api_get_free_buffer_count(NORFLASH_API_ERASING) ==
-                   0);
-        } else {
-          ASSERT(0, "%s: norflash_api_erase err,ret = %d,addr = 0x%x.",
-                 __func__, ret, _user_data_bak_start);
-        }
-      } while (ret == NORFLASH_API_BUFFER_FULL);
-    }
-
-    if (nv_flsh_state.state == NV_STATE_BAK_ERASED ||
-        nv_flsh_state.state == NV_STATE_BAK_WRITTING) {
-      nv_flsh_state.state = NV_STATE_BAK_WRITTING;
-      nv_flsh_state.written_size = 0;
-
-      hal_trace_pause();
-      do {
-        lock = int_lock_global();
-        ret = norflash_api_read(NORFLASH_API_MODULE_ID_USERDATA_EXT,
-                                _user_data_main_start +
-                                    nv_flsh_state.written_size,
-                                burn_buf, NV_EXTENSION_PAGE_SIZE);
-        ASSERT(ret == NORFLASH_API_OK,
-               "norflash_api_read failed! ret = %d, addr = 0x%x.", (int32_t)ret,
-               _user_data_main_start + nv_flsh_state.written_size);
-
-        ret = norflash_api_write(NORFLASH_API_MODULE_ID_USERDATA_EXT,
-                                 _user_data_bak_start +
-                                     nv_flsh_state.written_size,
-                                 burn_buf, NV_EXTENSION_PAGE_SIZE, true);
-        int_unlock_global(lock);
-        if (ret == NORFLASH_API_OK) {
-          nv_flsh_state.written_size += NV_EXTENSION_PAGE_SIZE;
-          if (nv_flsh_state.written_size == NV_EXTENSION_SIZE) {
-            nv_flsh_state.state = NV_STATE_BAK_WRITTEN;
-            TRACE(3, "%s: NV_STATE_BAK_WRITTEN", __func__);
-            break;
-          }
-        } else if (ret == NORFLASH_API_BUFFER_FULL) {
-          do {
-            norflash_api_flush();
-          } while (norflash_api_get_free_buffer_count(NORFLASH_API_WRITTING) ==
-                   0);
-        } else {
-          ASSERT(0, "%s: norflash_api_write err,ret = %d,addr = 0x%x.",
-                 __func__, ret,
-                 _user_data_bak_start + nv_flsh_state.written_size);
-        }
-      } while (1);
+      }
+      break;
     }
-    hal_trace_continue();
 
-    // nv_flsh_state.state == NV_STATE_BAK_WRITTEN;
     do {
       norflash_api_flush();
     } while (norflash_api_get_used_buffer_count(
                  NORFLASH_API_MODULE_ID_USERDATA_EXT, NORFLASH_API_ALL) > 0);
-
-    nv_flsh_state.state = NV_STATE_BAK_DONE;
-    TRACE(1, "%s: sync flush done.", __func__);
-  }
-
-  if (nv_flsh_state.state == NV_STATE_BAK_DONE) {
     nv_flsh_state.state = NV_STATE_IDLE;
-    TRACE(1, "%s: NV_STATE_IDLE", __func__);
-  }
-
-  return (ret == NORFLASH_API_OK) ? 0 : 1;
-}
-
-static int nv_record_extension_flush(bool is_async) {
-  int ret = 0;
-  // TRACE(3, "%s state %d is_update %d", __func__, nv_flsh_state.state,
-  // nv_flsh_state.is_update);
-  do {
-    if (nv_flsh_state.state == NV_STATE_IDLE &&
-        nv_flsh_state.is_update == FALSE) {
-      break;
-    }
-
-    if ((nv_flsh_state.state == NV_STATE_IDLE &&
-         nv_flsh_state.is_update == TRUE) ||
-        nv_flsh_state.state == NV_STATE_MAIN_ERASING ||
-        nv_flsh_state.state == NV_STATE_MAIN_ERASED ||
-        nv_flsh_state.state == NV_STATE_MAIN_WRITTING ||
-        nv_flsh_state.state == NV_STATE_MAIN_WRITTEN) {
-      ret = nv_record_extension_flush_main(is_async);
-      if (is_async) {
-        break;
-      }
-    }
-
-    if (nv_flsh_state.state == NV_STATE_MAIN_DONE ||
-        nv_flsh_state.state == NV_STATE_BAK_ERASING ||
-        nv_flsh_state.state == NV_STATE_BAK_ERASED ||
-        nv_flsh_state.state == NV_STATE_BAK_WRITTING ||
-        nv_flsh_state.state == NV_STATE_BAK_WRITTEN ||
-        nv_flsh_state.state == NV_STATE_BAK_DONE) {
-      ret = nv_record_extension_flush_bak(is_async);
-    }
-  } while (!is_async);
-  return ret;
+    TRACE(1, "%s: sync flush done.", __func__);
+  } while (1);
+  return 0;
 }
 
 void nv_extension_callback(void *param) {
@@ -846,6 +721,8 @@ void nv_record_sector_clear(void) {
   ASSERT(ret == NORFLASH_API_OK,
          "%s: norflash_api_erase(0x%x) failed! ret = %d.", __func__,
          (uint32_t)__userdata_start + NV_EXTENSION_SIZE, (int32_t)ret);
+  // the log is gone with the sectors, start a new one on the next flush
+  nv_log_format_sector = 0;
   // pmu_reboot();
   int_unlock_global(lock);
 }
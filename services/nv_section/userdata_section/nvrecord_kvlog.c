@@ -0,0 +1,368 @@
+#include "nvrecord_kvlog.h"
+#include "crc32.h"
+#include "hal_trace.h"
+#include <stddef.h>
+#include <string.h>
+
+#define NV_KVLOG_MAGIC 0x4B564C47 // "KVLG"
+#define NV_KVLOG_REC_DATA 0xD5
+#define NV_KVLOG_REC_COMMIT 0xC3
+#define NV_KVLOG_ALIGN(x) (((x) + 3) & ~3)
+#define NV_KVLOG_COPY_CHUNK 64
+
+typedef struct {
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t crc; // crc32 of magic and seq
+} nv_kvlog_sector_hdr_t;
+
+typedef struct {
+  uint8_t key;
+  uint8_t type;
+  uint16_t len;
+  uint32_t crc; // crc32 of key, type, len and the payload
+} nv_kvlog_rec_hdr_t;
+
+#define NV_KVLOG_SECTOR_HDR_SIZE sizeof(nv_kvlog_sector_hdr_t)
+#define NV_KVLOG_REC_HDR_SIZE sizeof(nv_kvlog_rec_hdr_t)
+
+uint32_t nv_kvlog_record_size(uint32_t len) {
+  return NV_KVLOG_REC_HDR_SIZE + NV_KVLOG_ALIGN(len);
+}
+
+uint32_t nv_kvlog_commit_size(void) {
+  return nv_kvlog_record_size(sizeof(uint32_t));
+}
+
+static uint32_t nv_kvlog_sector_addr(const nv_kvlog_t *log, uint8_t sector) {
+  return log->base + sector * log->sector_size;
+}
+
+static uint32_t nv_kvlog_sector_crc(const nv_kvlog_sector_hdr_t *hdr) {
+  return crc32(0, (const unsigned char *)hdr,
+               offsetof(nv_kvlog_sector_hdr_t, crc));
+}
+
+static uint32_t nv_kvlog_rec_crc(const nv_kvlog_rec_hdr_t *hdr,
+                                 const void *val) {
+  uint32_t crc = crc32(0, (const unsigned char *)hdr,
+                       offsetof(nv_kvlog_rec_hdr_t, crc));
+  return crc32(crc, (const unsigned char *)val, hdr->len);
+}
+
+static bool nv_kvlog_is_erased(const void *buf, uint32_t len) {
+  const uint8_t *p = (const uint8_t *)buf;
+  while (len--) {
+    if (*p++ != 0xFF)
+      return false;
+  }
+  return true;
+}
+
+static int nv_kvlog_append(nv_kvlog_t *log, uint8_t key, uint8_t type,
+                           const void *val, uint16_t len) {
+  nv_kvlog_rec_hdr_t hdr;
+  uint32_t addr = nv_kvlog_sector_addr(log, log->active) + log->write_offs;
+
+  hdr.key = key;
+  hdr.type = type;
+  hdr.len = len;
+  hdr.crc = nv_kvlog_rec_crc(&hdr, val);
+  // The header goes first: flash programs in address order, so a record cut
+  // short by a power loss always fails its crc.
+  if (log->flash->write(addr, &hdr, sizeof(hdr)))
+    return -1;
+  if (len && log->flash->write(addr + sizeof(hdr), val, len))
+    return -1;
+  log->write_offs += nv_kvlog_record_size(len);
+  return 0;
+}
+
+static int nv_kvlog_append_commit(nv_kvlog_t *log, uint32_t batch_start) {
+  return nv_kvlog_append(log, 0, NV_KVLOG_REC_COMMIT, &batch_start,
+                         sizeof(batch_start));
+}
+
+static bool nv_kvlog_read_sector_hdr(const nv_kvlog_t *log, uint8_t sector,
+                                     uint32_t *seq) {
+  nv_kvlog_sector_hdr_t hdr;
+
+  if (log->flash->read(nv_kvlog_sector_addr(log, sector), &hdr, sizeof(hdr)))
+    return false;
+  if (hdr.magic != NV_KVLOG_MAGIC || hdr.crc != nv_kvlog_sector_crc(&hdr))
+    return false;
+  *seq = hdr.seq;
+  return true;
+}
+
+// Checks the record at |addr| and returns its header through |hdr|. Returns
+// 1 for a valid record, 0 for erased flash and -1 for a torn or corrupt one.
+static int nv_kvlog_read_rec(const nv_kvlog_t *log, uint32_t addr,
+                             uint32_t room, nv_kvlog_rec_hdr_t *hdr) {
+  uint8_t buf[NV_KVLOG_COPY_CHUNK];
+  uint32_t crc, done, n;
+
+  // Too little room left for even a header: the sector is simply full.
+  if (room < sizeof(*hdr))
+    return 0;
+  if (log->flash->read(addr, hdr, sizeof(*hdr)))
+    return -1;
+  if (nv_kvlog_is_erased(hdr, sizeof(*hdr)))
+    return 0;
+  if (nv_kvlog_record_size(hdr->len) > room)
+    return -1;
+  if (hdr->type == NV_KVLOG_REC_DATA) {
+    if (hdr->key >= NV_KVLOG_MAX_KEYS || hdr->len > NV_KVLOG_MAX_VALUE_LEN)
+      return -1;
+  } else if (hdr->type == NV_KVLOG_REC_COMMIT) {
+    if (hdr->len != sizeof(uint32_t))
+      return -1;
+  } else {
+    return -1;
+  }
+
+  crc = crc32(0, (const unsigned char *)hdr,
+              offsetof(nv_kvlog_rec_hdr_t, crc));
+  for (done = 0; done < hdr->len; done += n) {
+    n = hdr->len - done;
+    if (n > sizeof(buf))
+      n = sizeof(buf);
+    if (log->flash->read(addr + sizeof(*hdr) + done, buf, n))
+      return -1;
+    crc = crc32(crc, buf, n);
+  }
+  return crc == hdr->crc ? 1 : -1;
+}
+
+// Replays |sector| into |index|. Records only count once a later commit
+// record covers them; a batch cut short by a power loss is dropped. Returns
+// true if at least one batch was committed. |end| receives the first free
+// offset, or the sector size if the tail is torn and must not be appended to.
+static bool nv_kvlog_scan(nv_kvlog_t *log, uint8_t sector, uint16_t *index,
+                          uint32_t *end) {
+  uint16_t pending[NV_KVLOG_MAX_KEYS];
+  uint32_t addr = nv_kvlog_sector_addr(log, sector);
+  uint32_t offs = NV_KVLOG_SECTOR_HDR_SIZE;
+  uint32_t batch_start;
+  nv_kvlog_rec_hdr_t hdr;
+  bool committed = false;
+  int ret;
+
+  memset(index, 0, sizeof(pending));
+  memset(pending, 0, sizeof(pending));
+  while (offs < log->sector_size) {
+    ret = nv_kvlog_read_rec(log, addr + offs, log->sector_size - offs, &hdr);
+    if (ret == 0)
+      break;
+    if (ret < 0) {
+      TRACE(3, "%s: torn record in sector %d at 0x%x", __func__, sector, offs);
+      log->stats.torn_cnt++;
+      offs = log->sector_size;
+      break;
+    }
+    if (hdr.type == NV_KVLOG_REC_DATA) {
+      pending[hdr.key] = offs;
+    } else {
+      log->flash->read(addr + offs + sizeof(hdr), &batch_start,
+                       sizeof(batch_start));
+      // Records older than |batch_start| belong to a batch that never
+      // committed and must not be resurrected by this one.
+      for (uint32_t k = 0; k < NV_KVLOG_MAX_KEYS; ++k) {
+        if (pending[k] && pending[k] >= batch_start)
+          index[k] = pending[k];
+        pending[k] = 0;
+      }
+      committed = true;
+    }
+    offs += nv_kvlog_record_size(hdr.len);
+  }
+  *end = offs;
+  return committed;
+}
+
+int nv_kvlog_mount(nv_kvlog_t *log, const nv_kvlog_flash_t *flash,
+                   uint32_t base, uint32_t sector_size) {
+  uint32_t seq[2];
+  bool has_hdr[2];
+  uint8_t order[2] = {0, 1};
+  uint32_t end;
+
+  ASSERT(log && flash, "%s", __func__);
+  ASSERT(sector_size > NV_KVLOG_SECTOR_HDR_SIZE && sector_size <= 0x10000,
+         "%s: bad sector size %d", __func__, sector_size);
+  memset(log, 0, sizeof(*log));
+  log->flash = flash;
+  log->base = base;
+  log->sector_size = sector_size;
+
+  has_hdr[0] = nv_kvlog_read_sector_hdr(log, 0, &seq[0]);
+  has_hdr[1] = nv_kvlog_read_sector_hdr(log, 1, &seq[1]);
+  if (has_hdr[0] && has_hdr[1] && (int32_t)(seq[1] - seq[0]) > 0) {
+    order[0] = 1;
+    order[1] = 0;
+  }
+
+  for (uint32_t i = 0; i < 2; ++i) {
+    uint8_t s = order[i];
+    if (!has_hdr[s])
+      continue;
+    if (nv_kvlog_scan(log, s, log->index, &end)) {
+      log->active = s;
+      log->seq = seq[s];
+      log->write_offs = end;
+      log->mounted = true;
+      TRACE(4, "%s: sector %d seq %d used 0x%x", __func__, s, seq[s], end);
+      return 0;
+    }
+    // No commit: the sector was cut short while being formatted or rotated
+    // into, and the other one still holds the data.
+  }
+  memset(log->index, 0, sizeof(log->index));
+  return -1;
+}
+
+int nv_kvlog_format(nv_kvlog_t *log, uint8_t sector) {
+  nv_kvlog_sector_hdr_t hdr;
+  uint32_t addr;
+
+  ASSERT(log && log->flash && sector < 2, "%s", __func__);
+  ASSERT(!log->in_batch, "%s: batch open", __func__);
+  addr = nv_kvlog_sector_addr(log, sector);
+  if (log->flash->erase(addr, log->sector_size))
+    return -1;
+  log->stats.erase_cnt++;
+
+  hdr.magic = NV_KVLOG_MAGIC;
+  hdr.seq = log->seq + 1;
+  hdr.crc = nv_kvlog_sector_crc(&hdr);
+  if (log->flash->write(addr, &hdr, sizeof(hdr)))
+    return -1;
+
+  log->active = sector;
+  log->seq = hdr.seq;
+  log->write_offs = NV_KVLOG_SECTOR_HDR_SIZE;
+  log->mounted = true;
+  memset(log->index, 0, sizeof(log->index));
+  return 0;
+}
+
+static int nv_kvlog_copy(nv_kvlog_t *log, uint32_t dst, uint32_t src,
+                         uint32_t len) {
+  uint8_t buf[NV_KVLOG_COPY_CHUNK];
+  uint32_t n;
+
+  for (; len; len -= n, src += n, dst += n) {
+    n = len < sizeof(buf) ? len : sizeof(buf);
+    if (log->flash->read(src, buf, n) || log->flash->write(dst, buf, n))
+      return -1;
+  }
+  return 0;
+}
+
+// Copies the live records into the other sector and moves the log there. The
+// old sector stays valid until the copy is committed, and is only erased by
+// the next rotation.
+static int nv_kvlog_rotate(nv_kvlog_t *log) {
+  uint16_t index[NV_KVLOG_MAX_KEYS];
+  uint32_t src = nv_kvlog_sector_addr(log, log->active);
+  uint32_t dst;
+  nv_kvlog_rec_hdr_t hdr;
+
+  memcpy(index, log->index, sizeof(index));
+  if (nv_kvlog_format(log, log->active ^ 1))
+    return -1;
+  dst = nv_kvlog_sector_addr(log, log->active);
+  for (uint32_t k = 0; k < NV_KVLOG_MAX_KEYS; ++k) {
+    uint32_t size;
+    if (!index[k])
+      continue;
+    if (log->flash->read(src + index[k], &hdr, sizeof(hdr)))
+      return -1;
+    size = nv_kvlog_record_size(hdr.len);
+    ASSERT(log->write_offs + size + nv_kvlog_commit_size() <= log->sector_size,
+           "%s: live set overflows the sector", __func__);
+    if (nv_kvlog_copy(log, dst + log->write_offs, src + index[k], size))
+      return -1;
+    log->index[k] = log->write_offs;
+    log->write_offs += size;
+  }
+  if (nv_kvlog_append_commit(log, NV_KVLOG_SECTOR_HDR_SIZE))
+    return -1;
+  log->stats.gc_cnt++;
+  TRACE(4, "%s: now sector %d seq %d live 0x%x", __func__, log->active,
+        log->seq, log->write_offs);
+  return 0;
+}
+
+int nv_kvlog_begin(nv_kvlog_t *log, uint32_t need) {
+  ASSERT(log && log->mounted, "%s: not mounted", __func__);
+  ASSERT(!log->in_batch, "%s: batch already open", __func__);
+
+  if (need < nv_kvlog_commit_size())
+    need = nv_kvlog_commit_size();
+  if (log->write_offs + need > log->sector_size) {
+    if (nv_kvlog_rotate(log))
+      return -1;
+    if (log->write_offs + need > log->sector_size) {
+      TRACE(3, "%s: batch of %d bytes does not fit, 0x%x used", __func__,
+            need, log->write_offs);
+      return -1;
+    }
+  }
+  log->in_batch = true;
+  log->batch_start = log->write_offs;
+  log->batch_need = need;
+  return 0;
+}
+
+int nv_kvlog_put(nv_kvlog_t *log, uint8_t key, const void *val, uint16_t len) {
+  uint32_t offs;
+
+  ASSERT(log && log->in_batch, "%s: no batch open", __func__);
+  ASSERT(key < NV_KVLOG_MAX_KEYS && len <= NV_KVLOG_MAX_VALUE_LEN,
+         "%s: bad key %d len %d", __func__, key, len);
+  offs = log->write_offs;
+  if (offs + nv_kvlog_record_size(len) + nv_kvlog_commit_size() >
+      log->batch_start + log->batch_need) {
+    TRACE(2, "%s: key %d overruns the batch reservation", __func__, key);
+    return -1;
+  }
+  if (nv_kvlog_append(log, key, NV_KVLOG_REC_DATA, val, len))
+    return -1;
+  log->index[key] = offs;
+  log->stats.append_cnt++;
+  return 0;
+}
+
+int nv_kvlog_commit(nv_kvlog_t *log) {
+  ASSERT(log && log->in_batch, "%s: no batch open", __func__);
+  log->in_batch = false;
+  if (nv_kvlog_append_commit(log, log->batch_start))
+    return -1;
+  log->stats.commit_cnt++;
+  return 0;
+}
+
+int nv_kvlog_get(const nv_kvlog_t *log, uint8_t key, void *buf, uint16_t size) {
+  nv_kvlog_rec_hdr_t hdr;
+  uint32_t addr;
+
+  ASSERT(log && key < NV_KVLOG_MAX_KEYS, "%s", __func__);
+  if (!log->mounted || !log->index[key])
+    return -1;
+  addr = nv_kvlog_sector_addr(log, log->active) + log->index[key];
+  if (log->flash->read(addr, &hdr, sizeof(hdr)) || hdr.len > size)
+    return -1;
+  if (hdr.len && log->flash->read(addr + sizeof(hdr), buf, hdr.len))
+    return -1;
+  return hdr.len;
+}
+
+bool nv_kvlog_contains(const nv_kvlog_t *log, uint8_t key) {
+  ASSERT(log && key < NV_KVLOG_MAX_KEYS, "%s", __func__);
+  return log->mounted && log->index[key] != 0;
+}
+
+uint32_t nv_kvlog_free_space(const nv_kvlog_t *log) {
+  return log->sector_size - log->write_offs;
+}
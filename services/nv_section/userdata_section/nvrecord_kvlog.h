@@ -0,0 +1,90 @@
+#ifndef __NVRECORD_KVLOG_H__
+#define __NVRECORD_KVLOG_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Append-only key/value log over two rotating flash sectors.
+//
+// Every update is a small CRC'd record appended to the active sector, so a
+// change costs a few bytes of page program instead of a sector erase. Records
+// are grouped into batches; a batch only takes effect once its commit record
+// has reached flash, so a power cut leaves either the old or the new values.
+// When the active sector fills up, the live records are copied to the other
+// sector (erased first) under a higher sequence number and the log continues
+// there. The in-RAM index holds the offset of the latest committed record of
+// each key and is rebuilt by scanning the sectors at mount time.
+//
+// Sector layout: a 12-byte header (magic, sequence, crc) followed by records,
+// each an 8-byte header (key, type, len, crc) and a payload padded to 4 bytes.
+
+#define NV_KVLOG_MAX_KEYS 64
+#define NV_KVLOG_MAX_VALUE_LEN 1024
+
+// Flash access. Each returns 0 on success. |read| must see data that has been
+// queued by |write| even if it has not reached the flash yet.
+typedef struct {
+  int (*read)(uint32_t addr, void *buf, uint32_t len);
+  int (*write)(uint32_t addr, const void *buf, uint32_t len);
+  int (*erase)(uint32_t addr, uint32_t len);
+} nv_kvlog_flash_t;
+
+typedef struct {
+  uint32_t append_cnt; // records appended, GC copies excluded
+  uint32_t commit_cnt; // batches committed
+  uint32_t gc_cnt;     // sector rotations
+  uint32_t erase_cnt;  // sector erases
+  uint32_t torn_cnt;   // torn or corrupt records found at mount
+} nv_kvlog_stats_t;
+
+typedef struct {
+  const nv_kvlog_flash_t *flash;
+  uint32_t base;        // sector 0; sector 1 follows it
+  uint32_t sector_size;
+  uint32_t seq;         // sequence number of the active sector
+  uint32_t write_offs;  // next free byte in the active sector
+  uint32_t batch_start; // offset of the first record of the open batch
+  uint32_t batch_need;  // bytes reserved by nv_kvlog_begin()
+  uint8_t active;       // active sector, 0 or 1
+  bool mounted;
+  bool in_batch;
+  uint16_t index[NV_KVLOG_MAX_KEYS]; // record offset, 0 when absent
+  nv_kvlog_stats_t stats;
+} nv_kvlog_t;
+
+// Bytes of log taken by one record carrying |len| bytes of value.
+uint32_t nv_kvlog_record_size(uint32_t len);
+// Bytes needed by nv_kvlog_begin() for a batch of no records.
+uint32_t nv_kvlog_commit_size(void);
+
+// Scans both sectors and rebuilds the index from the newest sector holding a
+// committed batch. Returns 0 on success, -1 if neither sector holds a log.
+int nv_kvlog_mount(nv_kvlog_t *log, const nv_kvlog_flash_t *flash,
+                   uint32_t base, uint32_t sector_size);
+// Erases |sector| and starts an empty log there. The sector only becomes valid
+// once the first batch is committed, so the other sector is left untouched
+// until then.
+int nv_kvlog_format(nv_kvlog_t *log, uint8_t sector);
+
+// Opens a batch that will append at most |need| bytes, including the commit
+// record. Rotates to the other sector first if the active one lacks room.
+int nv_kvlog_begin(nv_kvlog_t *log, uint32_t need);
+int nv_kvlog_put(nv_kvlog_t *log, uint8_t key, const void *val, uint16_t len);
+int nv_kvlog_commit(nv_kvlog_t *log);
+
+// Copies the latest committed value of |key| into |buf| and returns its
+// length, or -1 if the key has never been written or |size| is too small.
+int nv_kvlog_get(const nv_kvlog_t *log, uint8_t key, void *buf, uint16_t size);
+bool nv_kvlog_contains(const nv_kvlog_t *log, uint8_t key);
+// Bytes still free in the active sector.
+uint32_t nv_kvlog_free_space(const nv_kvlog_t *log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __NVRECORD_KVLOG_H__
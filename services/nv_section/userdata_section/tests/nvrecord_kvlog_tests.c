@@ -0,0 +1,251 @@
+#include "nvrecord_kvlog.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// NOR flash simulator: erase sets bytes to 0xFF, program can only clear bits.
+// |budget| counts programmed bytes plus one per erase; when it runs out the
+// power is cut and every later operation is silently dropped. An erase hit
+// by the cut only gets halfway.
+
+#define MAX_SECTOR 4096
+#define NUM_KEYS 8
+#define MAX_LEN 200
+
+static uint8_t flash[2 * MAX_SECTOR];
+static uint16_t max_len = MAX_LEN;
+static long budget = -1;
+static long consumed;
+static int dead;
+
+static int sim_read(uint32_t addr, void *buf, uint32_t len) {
+  assert(addr + len <= sizeof(flash));
+  memcpy(buf, flash + addr, len);
+  return 0;
+}
+
+static int sim_write(uint32_t addr, const void *buf, uint32_t len) {
+  const uint8_t *p = (const uint8_t *)buf;
+  assert(addr + len <= sizeof(flash));
+  for (uint32_t i = 0; i < len; ++i) {
+    if (budget == 0)
+      dead = 1;
+    if (dead)
+      return 0;
+    if (budget > 0)
+      budget--;
+    consumed++;
+    flash[addr + i] &= p[i];
+  }
+  return 0;
+}
+
+static int sim_erase(uint32_t addr, uint32_t len) {
+  assert(addr + len <= sizeof(flash));
+  if (budget == 0 && !dead) {
+    dead = 1;
+    memset(flash + addr, 0xFF, len / 2);
+  }
+  if (dead)
+    return 0;
+  if (budget > 0)
+    budget--;
+  consumed++;
+  memset(flash + addr, 0xFF, len);
+  return 0;
+}
+
+static const nv_kvlog_flash_t sim_flash = {sim_read, sim_write, sim_erase};
+
+static void sim_reset(void) {
+  memset(flash, 0xFF, sizeof(flash));
+  budget = -1;
+  consumed = 0;
+  dead = 0;
+}
+
+typedef struct {
+  uint16_t len[NUM_KEYS]; // 0 when absent
+  uint8_t val[NUM_KEYS][MAX_LEN];
+} model_t;
+
+static void fill_value(uint8_t *buf, uint16_t len, uint32_t seed) {
+  for (uint16_t i = 0; i < len; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    buf[i] = (uint8_t)(seed >> 16);
+  }
+}
+
+static void check_model(const nv_kvlog_t *log, const model_t *m) {
+  uint8_t buf[MAX_LEN];
+  for (uint8_t k = 0; k < NUM_KEYS; ++k) {
+    if (!m->len[k]) {
+      assert(!nv_kvlog_contains(log, k));
+      assert(nv_kvlog_get(log, k, buf, sizeof(buf)) == -1);
+      continue;
+    }
+    assert(nv_kvlog_get(log, k, buf, sizeof(buf)) == m->len[k]);
+    assert(memcmp(buf, m->val[k], m->len[k]) == 0);
+  }
+}
+
+static int models_equal(const nv_kvlog_t *log, const model_t *m) {
+  uint8_t buf[MAX_LEN];
+  for (uint8_t k = 0; k < NUM_KEYS; ++k) {
+    int len = nv_kvlog_get(log, k, buf, sizeof(buf));
+    if (!m->len[k]) {
+      if (len != -1)
+        return 0;
+    } else if (len != m->len[k] || memcmp(buf, m->val[k], len)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Writes |count| keys starting at |first| as one batch and mirrors it in |m|.
+static int write_batch(nv_kvlog_t *log, model_t *m, uint32_t batch,
+                       uint8_t first, uint8_t count) {
+  uint32_t need = nv_kvlog_commit_size();
+  uint16_t lens[NUM_KEYS];
+
+  for (uint8_t i = 0; i < count; ++i) {
+    lens[i] = 1 + (batch * 37 + i * 11) % max_len;
+    need += nv_kvlog_record_size(lens[i]);
+  }
+  if (nv_kvlog_begin(log, need))
+    return -1;
+  for (uint8_t i = 0; i < count; ++i) {
+    uint8_t k = (first + i) % NUM_KEYS;
+    m->len[k] = lens[i];
+    fill_value(m->val[k], lens[i], batch * 131 + k);
+    assert(nv_kvlog_put(log, k, m->val[k], lens[i]) == 0);
+  }
+  return nv_kvlog_commit(log);
+}
+
+static void test_put_get_and_remount(void) {
+  nv_kvlog_t log, log2;
+  model_t m;
+  uint8_t small[4];
+
+  sim_reset();
+  memset(&m, 0, sizeof(m));
+  assert(nv_kvlog_mount(&log, &sim_flash, 0, MAX_SECTOR) == -1);
+  assert(nv_kvlog_format(&log, 1) == 0);
+  assert(write_batch(&log, &m, 0, 0, 3) == 0);
+  check_model(&log, &m);
+  assert(m.len[1] > sizeof(small));
+  assert(nv_kvlog_get(&log, 1, small, sizeof(small)) == -1);
+
+  assert(nv_kvlog_mount(&log2, &sim_flash, 0, MAX_SECTOR) == 0);
+  assert(log2.active == 1 && log2.write_offs == log.write_offs);
+  check_model(&log2, &m);
+
+  // An update only costs its own records.
+  uint32_t used = log2.write_offs;
+  assert(write_batch(&log2, &m, 1, 1, 1) == 0);
+  assert(log2.write_offs - used ==
+         nv_kvlog_record_size(m.len[1]) + nv_kvlog_commit_size());
+  assert(nv_kvlog_mount(&log, &sim_flash, 0, MAX_SECTOR) == 0);
+  check_model(&log, &m);
+  assert(log.stats.torn_cnt == 0);
+}
+
+// Many small updates rotate between the sectors without losing a value, and
+// erase far less often than once per update.
+static void test_rotation_keeps_live_values(void) {
+  nv_kvlog_t log;
+  model_t m;
+  uint32_t batches = 2000;
+
+  sim_reset();
+  memset(&m, 0, sizeof(m));
+  nv_kvlog_mount(&log, &sim_flash, 0, MAX_SECTOR);
+  assert(nv_kvlog_format(&log, 0) == 0);
+  assert(write_batch(&log, &m, 0, 0, NUM_KEYS) == 0);
+  for (uint32_t b = 1; b < batches; ++b) {
+    assert(write_batch(&log, &m, b, b % NUM_KEYS, 1 + b % 2) == 0);
+    check_model(&log, &m);
+    if (b % 97 == 0) {
+      uint32_t seq = log.seq;
+      assert(nv_kvlog_mount(&log, &sim_flash, 0, MAX_SECTOR) == 0);
+      assert(log.seq == seq);
+      check_model(&log, &m);
+    }
+  }
+  // Every rotation erases one sector and bumps the sequence number.
+  assert(log.seq > 10);
+  assert(log.seq * 10 < batches);
+  assert(nv_kvlog_free_space(&log) < MAX_SECTOR);
+
+  // A batch larger than a sector is refused rather than torn.
+  assert(nv_kvlog_begin(&log, MAX_SECTOR) == -1);
+  assert(!log.in_batch);
+}
+
+// Cuts the power at every programmed byte and erase of a run of batches that
+// rotates several times. After remount the store must hold exactly the values
+// of the last batch whose commit made it to flash, and stay writable.
+static void test_power_cut_anywhere(void) {
+  enum { SECTOR = 1024, BATCHES = 40 };
+  static model_t states[BATCHES + 1];
+  static uint8_t base_image[sizeof(flash)];
+  nv_kvlog_t log;
+  model_t m;
+  long total;
+
+  sim_reset();
+  max_len = 40;
+  memset(&m, 0, sizeof(m));
+  nv_kvlog_mount(&log, &sim_flash, 0, SECTOR);
+  assert(nv_kvlog_format(&log, 0) == 0);
+  assert(write_batch(&log, &m, 0, 0, 2) == 0);
+  memcpy(base_image, flash, sizeof(flash));
+  states[0] = m;
+
+  // Dry run to learn the states and how many operations the run takes.
+  consumed = 0;
+  for (uint32_t b = 1; b <= BATCHES; ++b) {
+    assert(write_batch(&log, &m, b, b % NUM_KEYS, 1 + b % 3) == 0);
+    states[b] = m;
+  }
+  total = consumed;
+  assert(log.stats.gc_cnt >= 3);
+
+  for (long cut = 0; cut <= total; ++cut) {
+    uint32_t done = 0;
+
+    memcpy(flash, base_image, sizeof(flash));
+    budget = -1;
+    dead = 0;
+    m = states[0];
+    assert(nv_kvlog_mount(&log, &sim_flash, 0, SECTOR) == 0);
+    budget = cut;
+    for (uint32_t b = 1; b <= BATCHES && !dead; ++b) {
+      assert(write_batch(&log, &m, b, b % NUM_KEYS, 1 + b % 3) == 0);
+      if (!dead)
+        done = b;
+    }
+
+    budget = -1;
+    dead = 0;
+    assert(nv_kvlog_mount(&log, &sim_flash, 0, SECTOR) == 0);
+    assert(models_equal(&log, &states[done]));
+
+    m = states[done];
+    assert(write_batch(&log, &m, 1000 + cut, 3, 2) == 0);
+    assert(nv_kvlog_mount(&log, &sim_flash, 0, SECTOR) == 0);
+    check_model(&log, &m);
+  }
+  max_len = MAX_LEN;
+}
+
+int main(void) {
+  test_put_get_and_remount();
+  test_rotation_keeps_live_values();
+  test_power_cut_anywhere();
+  printf("All nvrecord kvlog tests passed.\n");
+  return 0;
+}
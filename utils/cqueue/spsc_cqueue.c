@@ -0,0 +1,141 @@
+/***
+ * spsc_cqueue.c - lock-free single-producer/single-consumer circle queue
+ */
+
+#include "spsc_cqueue.h"
+#include <string.h>
+
+#define SPSC_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SPSC_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static inline uint32_t spsc_used(const SpscCQueue *Q, uint32_t write,
+                                 uint32_t read) {
+  return write >= read ? write - read : write + 2 * Q->size - read;
+}
+
+static inline uint32_t spsc_offset(const SpscCQueue *Q, uint32_t pos) {
+  return pos >= Q->size ? pos - Q->size : pos;
+}
+
+static inline uint32_t spsc_advance(const SpscCQueue *Q, uint32_t pos,
+                                    uint32_t len) {
+  pos += len;
+  return pos >= 2 * Q->size ? pos - 2 * Q->size : pos;
+}
+
+static void spsc_map(SpscCQueue *Q, uint32_t pos, unsigned int len,
+                     CQItemType **e1, unsigned int *len1, CQItemType **e2,
+                     unsigned int *len2) {
+  uint32_t offset = spsc_offset(Q, pos);
+  uint32_t bytesToTheEnd = Q->size - offset;
+
+  *e1 = &Q->base[offset];
+  if (bytesToTheEnd >= len) {
+    *len1 = len;
+    *e2 = NULL;
+    *len2 = 0;
+  } else {
+    *len1 = bytesToTheEnd;
+    *e2 = &Q->base[0];
+    *len2 = len - bytesToTheEnd;
+  }
+}
+
+int InitSpscCQueue(SpscCQueue *Q, unsigned int size, CQItemType *buf) {
+  if (!Q || !buf || size == 0 || size >= 0x80000000U)
+    return CQ_ERR;
+
+  Q->size = size;
+  Q->base = buf;
+  Q->read = Q->write = 0;
+  return CQ_OK;
+}
+
+void ResetSpscCQueue(SpscCQueue *Q) {
+  SPSC_STORE_RELEASE(&Q->read, 0);
+  SPSC_STORE_RELEASE(&Q->write, 0);
+}
+
+unsigned int LengthOfSpscCQueue(SpscCQueue *Q) {
+  uint32_t read = SPSC_LOAD_ACQUIRE(&Q->read);
+  return spsc_used(Q, SPSC_LOAD_ACQUIRE(&Q->write), read);
+}
+
+unsigned int AvailableOfSpscCQueue(SpscCQueue *Q) {
+  return Q->size - LengthOfSpscCQueue(Q);
+}
+
+int ReserveSpscCQueue(SpscCQueue *Q, unsigned int len, CQItemType **e1,
+                      unsigned int *len1, CQItemType **e2,
+                      unsigned int *len2) {
+  uint32_t write = Q->write;
+  uint32_t read = SPSC_LOAD_ACQUIRE(&Q->read);
+
+  if (Q->size - spsc_used(Q, write, read) < len)
+    return CQ_ERR;
+
+  spsc_map(Q, write, len, e1, len1, e2, len2);
+  return CQ_OK;
+}
+
+int CommitSpscCQueue(SpscCQueue *Q, unsigned int len) {
+  uint32_t write = Q->write;
+  uint32_t read = SPSC_LOAD_ACQUIRE(&Q->read);
+
+  if (Q->size - spsc_used(Q, write, read) < len)
+    return CQ_ERR;
+
+  SPSC_STORE_RELEASE(&Q->write, spsc_advance(Q, write, len));
+  return CQ_OK;
+}
+
+int EnSpscCQueue(SpscCQueue *Q, const CQItemType *e, unsigned int len) {
+  CQItemType *e1, *e2;
+  unsigned int len1, len2;
+
+  if (ReserveSpscCQueue(Q, len, &e1, &len1, &e2, &len2) != CQ_OK)
+    return CQ_ERR;
+
+  memcpy(e1, e, len1);
+  if (len2)
+    memcpy(e2, e + len1, len2);
+  return CommitSpscCQueue(Q, len);
+}
+
+int PeekSpscCQueue(SpscCQueue *Q, unsigned int len, CQItemType **e1,
+                   unsigned int *len1, CQItemType **e2, unsigned int *len2) {
+  uint32_t read = Q->read;
+  uint32_t write = SPSC_LOAD_ACQUIRE(&Q->write);
+
+  if (spsc_used(Q, write, read) < len)
+    return CQ_ERR;
+
+  spsc_map(Q, read, len, e1, len1, e2, len2);
+  return CQ_OK;
+}
+
+int ReleaseSpscCQueue(SpscCQueue *Q, unsigned int len) {
+  uint32_t read = Q->read;
+  uint32_t write = SPSC_LOAD_ACQUIRE(&Q->write);
+
+  if (spsc_used(Q, write, read) < len)
+    return CQ_ERR;
+
+  SPSC_STORE_RELEASE(&Q->read, spsc_advance(Q, read, len));
+  return CQ_OK;
+}
+
+int DeSpscCQueue(SpscCQueue *Q, CQItemType *e, unsigned int len) {
+  CQItemType *e1, *e2;
+  unsigned int len1, len2;
+
+  if (PeekSpscCQueue(Q, len, &e1, &len1, &e2, &len2) != CQ_OK)
+    return CQ_ERR;
+
+  if (e != NULL) {
+    memcpy(e, e1, len1);
+    if (len2)
+      memcpy(e + len1, e2, len2);
+  }
+  return ReleaseSpscCQueue(Q, len);
+}
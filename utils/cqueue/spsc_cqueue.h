@@ -0,0 +1,62 @@
+/***
+ * spsc_cqueue.h - lock-free single-producer/single-consumer circle queue
+ *
+ * One thread (or ISR) produces and one consumes; no lock is needed around
+ * any call. Each side publishes its index with release ordering after
+ * touching the data and loads the other side's index with acquire ordering.
+ *
+ * Producers can write in place: ReserveSpscCQueue() returns the free space as
+ * up to two spans (the second one after the wrap), and CommitSpscCQueue()
+ * publishes what was written. Consumers mirror this with PeekSpscCQueue() and
+ * ReleaseSpscCQueue().
+ */
+
+#ifndef SPSC_CQUEUE_H
+#define SPSC_CQUEUE_H 1
+
+#include "cqueue.h"
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct __SpscCQueue {
+  /* Positions run over [0, 2 * size) so a full queue differs from an empty
+   * one without a separate length field. */
+  uint32_t read;  /* written by the consumer only */
+  uint32_t write; /* written by the producer only */
+  uint32_t size;
+  CQItemType *base;
+} SpscCQueue;
+
+/* Init Queue; any size below 2^31 bytes */
+int InitSpscCQueue(SpscCQueue *Q, unsigned int size, CQItemType *buf);
+/* Drop all data; only while neither side is running */
+void ResetSpscCQueue(SpscCQueue *Q);
+/* Filled Length Of Queue */
+unsigned int LengthOfSpscCQueue(SpscCQueue *Q);
+/* Empty Length Of Queue */
+unsigned int AvailableOfSpscCQueue(SpscCQueue *Q);
+
+/* Producer: map len free bytes as e1[len1] followed by e2[len2] */
+int ReserveSpscCQueue(SpscCQueue *Q, unsigned int len, CQItemType **e1,
+                      unsigned int *len1, CQItemType **e2, unsigned int *len2);
+/* Producer: publish len bytes written into the reserved spans */
+int CommitSpscCQueue(SpscCQueue *Q, unsigned int len);
+/* Producer: copy len bytes in (Tail) */
+int EnSpscCQueue(SpscCQueue *Q, const CQItemType *e, unsigned int len);
+
+/* Consumer: map len queued bytes as e1[len1] followed by e2[len2] */
+int PeekSpscCQueue(SpscCQueue *Q, unsigned int len, CQItemType **e1,
+                   unsigned int *len1, CQItemType **e2, unsigned int *len2);
+/* Consumer: drop len bytes from the Front after peeking them */
+int ReleaseSpscCQueue(SpscCQueue *Q, unsigned int len);
+/* Consumer: copy len bytes out (Front); e may be NULL to discard */
+int DeSpscCQueue(SpscCQueue *Q, CQItemType *e, unsigned int len);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* SPSC_CQUEUE_H */
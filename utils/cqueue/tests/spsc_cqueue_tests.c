@@ -0,0 +1,170 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "spsc_cqueue.h"
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Odd size so wrap points move around relative to the chunk sizes.
+#define STRESS_QUEUE_SIZE 1021
+#define STRESS_BYTES (16u * 1024u * 1024u)
+
+static uint8_t stream_byte(uint32_t pos) {
+  return (uint8_t)(pos * 2654435761u >> 24);
+}
+
+static uint32_t lcg_next(uint32_t *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+static void test_spans_and_wrap(void) {
+  uint8_t buf[8];
+  uint8_t out[8];
+  SpscCQueue q;
+  CQItemType *e1, *e2;
+  unsigned int len1, len2;
+
+  assert(InitSpscCQueue(&q, sizeof(buf), buf) == CQ_OK);
+  assert(LengthOfSpscCQueue(&q) == 0 && AvailableOfSpscCQueue(&q) == 8);
+  assert(PeekSpscCQueue(&q, 1, &e1, &len1, &e2, &len2) == CQ_ERR);
+
+  assert(EnSpscCQueue(&q, (const CQItemType *)"abcdef", 6) == CQ_OK);
+  assert(DeSpscCQueue(&q, out, 5) == CQ_OK && memcmp(out, "abcde", 5) == 0);
+
+  // 7 free bytes starting at offset 6: two spans.
+  assert(ReserveSpscCQueue(&q, 8, &e1, &len1, &e2, &len2) == CQ_ERR);
+  assert(ReserveSpscCQueue(&q, 7, &e1, &len1, &e2, &len2) == CQ_OK);
+  assert(e1 == &buf[6] && len1 == 2 && e2 == &buf[0] && len2 == 5);
+  memcpy(e1, "gh", 2);
+  memcpy(e2, "ijklm", 5);
+  assert(CommitSpscCQueue(&q, 7) == CQ_OK);
+  assert(LengthOfSpscCQueue(&q) == 8 && AvailableOfSpscCQueue(&q) == 0);
+  assert(CommitSpscCQueue(&q, 1) == CQ_ERR);
+
+  assert(PeekSpscCQueue(&q, 8, &e1, &len1, &e2, &len2) == CQ_OK);
+  assert(e1 == &buf[5] && len1 == 3 && e2 == &buf[0] && len2 == 5);
+  assert(memcmp(e1, "fgh", 3) == 0 && memcmp(e2, "ijklm", 5) == 0);
+  assert(ReleaseSpscCQueue(&q, 8) == CQ_OK);
+  assert(LengthOfSpscCQueue(&q) == 0);
+  assert(ReleaseSpscCQueue(&q, 1) == CQ_ERR);
+}
+
+typedef struct {
+  SpscCQueue *q;
+  uint32_t seed;
+  uint32_t spins;
+} StressSide;
+
+// Yield so the test also makes progress on a single-core host.
+static void wait_for_peer(StressSide *side) {
+  side->spins++;
+  sched_yield();
+}
+
+// Producer alternates between writing in place through reserved spans and
+// copying in with EnSpscCQueue().
+static void *producer(void *arg) {
+  StressSide *side = arg;
+  uint32_t pos = 0;
+
+  while (pos < STRESS_BYTES) {
+    uint32_t want = 1 + lcg_next(&side->seed) % 300;
+    if (want > STRESS_BYTES - pos)
+      want = STRESS_BYTES - pos;
+
+    if (want & 1) {
+      CQItemType *e1, *e2;
+      unsigned int len1, len2;
+      if (ReserveSpscCQueue(side->q, want, &e1, &len1, &e2, &len2) != CQ_OK) {
+        wait_for_peer(side);
+        continue;
+      }
+      for (unsigned int i = 0; i < len1; ++i)
+        e1[i] = stream_byte(pos + i);
+      for (unsigned int i = 0; i < len2; ++i)
+        e2[i] = stream_byte(pos + len1 + i);
+      assert(CommitSpscCQueue(side->q, want) == CQ_OK);
+    } else {
+      uint8_t chunk[300];
+      for (uint32_t i = 0; i < want; ++i)
+        chunk[i] = stream_byte(pos + i);
+      if (EnSpscCQueue(side->q, chunk, want) != CQ_OK) {
+        wait_for_peer(side);
+        continue;
+      }
+    }
+    pos += want;
+  }
+  return NULL;
+}
+
+static void *consumer(void *arg) {
+  StressSide *side = arg;
+  uint32_t pos = 0;
+
+  while (pos < STRESS_BYTES) {
+    uint32_t want = 1 + lcg_next(&side->seed) % 400;
+    if (want > STRESS_BYTES - pos)
+      want = STRESS_BYTES - pos;
+
+    if (want & 1) {
+      CQItemType *e1, *e2;
+      unsigned int len1, len2;
+      if (PeekSpscCQueue(side->q, want, &e1, &len1, &e2, &len2) != CQ_OK) {
+        wait_for_peer(side);
+        continue;
+      }
+      for (unsigned int i = 0; i < len1; ++i)
+        assert(e1[i] == stream_byte(pos + i));
+      for (unsigned int i = 0; i < len2; ++i)
+        assert(e2[i] == stream_byte(pos + len1 + i));
+      assert(ReleaseSpscCQueue(side->q, want) == CQ_OK);
+    } else {
+      uint8_t chunk[400];
+      if (DeSpscCQueue(side->q, chunk, want) != CQ_OK) {
+        wait_for_peer(side);
+        continue;
+      }
+      for (uint32_t i = 0; i < want; ++i)
+        assert(chunk[i] == stream_byte(pos + i));
+    }
+    pos += want;
+  }
+  return NULL;
+}
+
+static void test_two_thread_stress(void) {
+  static uint8_t buf[STRESS_QUEUE_SIZE];
+  SpscCQueue q;
+  StressSide prod = {&q, 1, 0};
+  StressSide cons = {&q, 2, 0};
+  pthread_t tp, tc;
+  struct timespec t0, t1;
+
+  assert(InitSpscCQueue(&q, sizeof(buf), buf) == CQ_OK);
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  assert(pthread_create(&tc, NULL, consumer, &cons) == 0);
+  assert(pthread_create(&tp, NULL, producer, &prod) == 0);
+  pthread_join(tp, NULL);
+  pthread_join(tc, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  double s = (double)(t1.tv_sec - t0.tv_sec) +
+             (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+  printf("Streamed %u MiB through a %u byte queue in %.3f s "
+         "(producer waits %u, consumer waits %u)\n",
+         STRESS_BYTES >> 20, STRESS_QUEUE_SIZE, s, prod.spins, cons.spins);
+  assert(LengthOfSpscCQueue(&q) == 0);
+}
+
+int main(void) {
+  test_spans_and_wrap();
+  test_two_thread_stress();
+
+  printf("All spsc cqueue tests passed.\n");
+  return 0;
+}
@@ -24,6 +24,38 @@ uint32_t syspool_original_size(void) SYSPOOL_PURE;
 int syspool_force_used_size(uint32_t size);
 #endif
 
+// The pool is a bump allocator reset by syspool_init(). Buffers are zeroed
+// as they are handed out rather than the whole pool at init;
+// syspool_init_noclr() skips the zeroing until the next syspool_init().
+void syspool_init_noclr(void);
+
+// Named scopes nest inside a pool run. Ending a scope gives back everything
+// taken since it began, along with any scope still open inside it, and
+// records its peak usage under its name. syspool_init() ends all open
+// scopes. syspool_scope_begin() returns -1 when SYSPOOL_SCOPE_DEPTH scopes
+// are already open; syspool_scope_end() ignores a scope already ended.
+#define SYSPOOL_SCOPE_DEPTH 4
+#define SYSPOOL_SCOPE_STAT_NUM 16
+#define SYSPOOL_ALLOC_LOG_NUM 32
+
+typedef struct {
+  const char *name;
+  uint32_t runs;      // times the scope has ended
+  uint32_t peak;      // most bytes held inside the scope in any run
+  uint32_t last_peak; // most bytes held inside it in the last run
+  uint32_t allocs;    // buffers taken directly in the last run
+} syspool_scope_stat_t;
+
+int syspool_scope_begin(const char *name);
+void syspool_scope_end(int scope);
+uint32_t syspool_mark(void);
+void syspool_rollback(uint32_t mark);
+// Copies up to |num| records, one per scope name, and returns how many.
+int syspool_get_scope_stats(syspool_scope_stat_t *stats, int num);
+// Traces the scope records and the last SYSPOOL_ALLOC_LOG_NUM buffers with
+// the code that took them.
+void syspool_dump(void);
+
 #define heap_malloc multi_heap_malloc
 
 #define heap_free multi_heap_free
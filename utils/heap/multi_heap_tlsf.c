@@ -0,0 +1,762 @@
+#include "hal_trace.h"
+#include "multi_heap_internal.h"
+#include <assert.h>
+#include <multi_heap.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Note: Keep platform-specific parts in this header, this source
+   file should depend on libc only */
+#include "multi_heap_platform.h"
+
+/* Two-level segregated fit (TLSF) implementation of the multi_heap API, built
+   instead of multi_heap.c when HEAP_TLSF=1.
+
+   Free blocks are kept in one list per size class. The first level splits
+   sizes by power of two, the second splits each power of two into
+   TLSF_SL_COUNT equal ranges, and two bitmaps record which lists are
+   non-empty. malloc rounds the request up to the next class so that the
+   head of any non-empty list at or above it fits, and finds that list with
+   two find-first-set operations; free merges with the physical neighbours
+   through the boundary tags. Neither walks a list, so both take the same
+   time however many blocks the heap holds; the one exception is a request
+   that would otherwise fail (see locate_free_block()).
+*/
+
+#ifndef MULTI_HEAP_POISONING
+/* if no heap poisoning, public API aliases directly to these implementations */
+void *multi_heap_malloc(multi_heap_handle_t heap, size_t size)
+    __attribute__((alias("multi_heap_malloc_impl")));
+
+void multi_heap_free(multi_heap_handle_t heap, void *p)
+    __attribute__((alias("multi_heap_free_impl")));
+
+void *multi_heap_realloc(multi_heap_handle_t heap, void *p, size_t size)
+    __attribute__((alias("multi_heap_realloc_impl")));
+
+size_t multi_heap_get_allocated_size(multi_heap_handle_t heap, void *p)
+    __attribute__((alias("multi_heap_get_allocated_size_impl")));
+
+multi_heap_handle_t multi_heap_register(void *start, size_t size)
+    __attribute__((alias("multi_heap_register_impl")));
+
+void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info)
+    __attribute__((alias("multi_heap_get_info_impl")));
+
+size_t multi_heap_free_size(multi_heap_handle_t heap)
+    __attribute__((alias("multi_heap_free_size_impl")));
+
+size_t multi_heap_minimum_free_size(multi_heap_handle_t heap)
+    __attribute__((alias("multi_heap_minimum_free_size_impl")));
+
+void *multi_heap_get_block_address(multi_heap_block_handle_t block)
+    __attribute__((alias("multi_heap_get_block_address_impl")));
+
+void *multi_heap_get_block_owner(multi_heap_block_handle_t block) {
+  (void)block;
+  return NULL;
+}
+
+#endif
+
+#define HEAP_ALIGN(X) ((X) & ~(sizeof(void *) - 1))
+#define HEAP_ALIGN_UP(X) HEAP_ALIGN((X) + sizeof(void *) - 1)
+
+/* Size classes. Sizes below TLSF_SMALL_SIZE all share first level 0 and
+   are split into TLSF_SL_COUNT lists one alignment unit apart; above it,
+   first level i covers [2^(i + TLSF_FL_SHIFT - 1), 2^(i + TLSF_FL_SHIFT)).
+   The number of first levels follows the size of each heap. */
+#define TLSF_SL_LOG2 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_ALIGN_LOG2 (sizeof(void *) == 8 ? 3 : 2)
+#define TLSF_FL_SHIFT (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_SMALL_SIZE ((size_t)1 << TLSF_FL_SHIFT)
+
+struct heap_block;
+
+/* Block in the heap
+
+   'header' holds the data size of the block ORed with two flags: whether
+   this block is free and whether the block physically before it is free.
+
+   'prev_phys' is only valid if the previous block is free. It lives in the
+   last word of that block's data, so a used block costs one word of
+   header.
+
+   'next_free' and 'prev_free' link the free list of the block's size class
+   and overlay the data, so they are only valid while the block is free.
+*/
+typedef struct heap_block {
+  struct heap_block *prev_phys;
+  size_t header;
+  union {
+    uint8_t data[1]; /* First byte of data, valid if block is used */
+    struct heap_block *next_free;
+  };
+  struct heap_block *prev_free;
+} heap_block_t;
+
+/* These masks apply to the 'header' field of heap_block_t */
+#define BLOCK_FREE_FLAG 0x1
+#define BLOCK_PREV_FREE_FLAG 0x2
+#define BLOCK_SIZE_MASK (~(size_t)3)
+
+/* Bytes a block adds in front of its data */
+#define BLOCK_OVERHEAD sizeof(size_t)
+/* Smallest data size: a free block must hold its list links and the next
+   block's prev_phys */
+#define BLOCK_SIZE_MIN (sizeof(heap_block_t) - sizeof(heap_block_t *))
+
+/* Metadata header for the heap, stored at the beginning of heap space,
+   followed by 'sl_bitmap' and the 'free_lists' heads, fl_count and
+   fl_count * TLSF_SL_COUNT entries.
+
+   'first_block' is the first allocatable block. The heap ends with a used
+   block of size 0 which is never allocated or merged.
+ */
+typedef struct multi_heap_info {
+  void *lock;
+  size_t total_bytes;
+  size_t free_bytes;
+  size_t minimum_free_bytes;
+  heap_block_t *first_block;
+  uint32_t fl_count;
+  uint32_t fl_bitmap;
+  uint32_t *sl_bitmap;
+  heap_block_t **free_lists;
+#if defined(MULTI_HEAP_DEFAULT_INT_LOCK)
+  size_t int_lock;
+#endif
+} heap_t;
+
+/* Index of the highest set bit; x is non-zero. The heap sizes fit in 32
+   bits. */
+static inline int tlsf_fls(size_t x) {
+  return 31 - __builtin_clz((uint32_t)x);
+}
+
+/* Index of the lowest set bit; x is non-zero. */
+static inline int tlsf_ffs(uint32_t x) { return __builtin_ctz(x); }
+
+static inline size_t block_size(const heap_block_t *block) {
+  return block->header & BLOCK_SIZE_MASK;
+}
+
+static inline void block_set_size(heap_block_t *block, size_t size) {
+  block->header = size | (block->header & ~BLOCK_SIZE_MASK);
+}
+
+static inline bool is_free(const heap_block_t *block) {
+  return block->header & BLOCK_FREE_FLAG;
+}
+
+static inline bool is_prev_free(const heap_block_t *block) {
+  return block->header & BLOCK_PREV_FREE_FLAG;
+}
+
+/* Return true if this block is the size 0 block at the end of the heap */
+static inline bool is_last_block(const heap_block_t *block) {
+  return block_size(block) == 0;
+}
+
+/* Given a pointer to the 'data' field of a block (ie the previous
+   malloc/realloc result), return a pointer to the containing block.
+*/
+static inline heap_block_t *get_block(const void *data_ptr) {
+  return (heap_block_t *)((char *)data_ptr - offsetof(heap_block_t, data));
+}
+
+/* Return the next sequential block in the heap. */
+static inline heap_block_t *get_next_block(const heap_block_t *block) {
+  return (heap_block_t *)((char *)block->data + block_size(block) -
+                          BLOCK_OVERHEAD);
+}
+
+/* Point the next block back at 'block' and return it */
+static inline heap_block_t *link_next(heap_block_t *block) {
+  heap_block_t *next = get_next_block(block);
+
+  next->prev_phys = block;
+  return next;
+}
+
+static inline void mark_free(heap_block_t *block) {
+  heap_block_t *next = link_next(block);
+
+  next->header |= BLOCK_PREV_FREE_FLAG;
+  block->header |= BLOCK_FREE_FLAG;
+}
+
+static inline void mark_used(heap_block_t *block) {
+  heap_block_t *next = get_next_block(block);
+
+  next->header &= ~BLOCK_PREV_FREE_FLAG;
+  block->header &= ~BLOCK_FREE_FLAG;
+}
+
+/* Size class holding blocks of exactly 'size' bytes */
+static inline void mapping_insert(size_t size, int *fl, int *sl) {
+  if (size < TLSF_SMALL_SIZE) {
+    *fl = 0;
+    *sl = (int)(size / (TLSF_SMALL_SIZE / TLSF_SL_COUNT));
+  } else {
+    int bit = tlsf_fls(size);
+
+    *sl = (int)(size >> (bit - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+    *fl = bit - (TLSF_FL_SHIFT - 1);
+  }
+}
+
+/* Lowest size class whose every block holds 'size' bytes */
+static inline void mapping_search(size_t size, int *fl, int *sl) {
+  if (size >= TLSF_SMALL_SIZE)
+    size += ((size_t)1 << (tlsf_fls(size) - TLSF_SL_LOG2)) - 1;
+  mapping_insert(size, fl, sl);
+}
+
+static inline heap_block_t **free_list(heap_t *heap, int fl, int sl) {
+  return &heap->free_lists[fl * TLSF_SL_COUNT + sl];
+}
+
+/* The head of each list is the block malloc takes. Keeping the lower of
+   the new block and the old head there packs allocations towards the start
+   of the heap, which leaves larger holes than plain LIFO order. */
+static void insert_free_block(heap_t *heap, heap_block_t *block) {
+  heap_block_t **head;
+  int fl, sl;
+
+  mapping_insert(block_size(block), &fl, &sl);
+  head = free_list(heap, fl, sl);
+  if (*head != NULL && *head < block) {
+    heap_block_t *first = *head;
+
+    block->next_free = first->next_free;
+    block->prev_free = first;
+    if (first->next_free != NULL)
+      first->next_free->prev_free = block;
+    first->next_free = block;
+  } else {
+    block->next_free = *head;
+    block->prev_free = NULL;
+    if (*head != NULL)
+      (*head)->prev_free = block;
+    *head = block;
+  }
+  heap->fl_bitmap |= 1U << fl;
+  heap->sl_bitmap[fl] |= 1U << sl;
+}
+
+static void remove_free_block(heap_t *heap, heap_block_t *block) {
+  int fl, sl;
+
+  MULTI_HEAP_ASSERT(is_free(block), block); // block should be free
+  mapping_insert(block_size(block), &fl, &sl);
+  if (block->next_free != NULL)
+    block->next_free->prev_free = block->prev_free;
+  if (block->prev_free != NULL) {
+    block->prev_free->next_free = block->next_free;
+  } else {
+    heap_block_t **head = free_list(heap, fl, sl);
+
+    MULTI_HEAP_ASSERT(*head == block, head); // block should head its list
+    *head = block->next_free;
+    if (*head == NULL) {
+      heap->sl_bitmap[fl] &= ~(1U << sl);
+      if (heap->sl_bitmap[fl] == 0)
+        heap->fl_bitmap &= ~(1U << fl);
+    }
+  }
+}
+
+/* Find a free block of at least 'size' bytes, or NULL. */
+static heap_block_t *locate_free_block(heap_t *heap, size_t size) {
+  heap_block_t *block;
+  uint32_t map;
+  int fl, sl;
+
+  mapping_search(size, &fl, &sl);
+  if (fl < (int)heap->fl_count) {
+    map = heap->sl_bitmap[fl] & (~0U << sl);
+    if (map == 0) {
+      map = heap->fl_bitmap & (~0U << (fl + 1));
+      if (map != 0) {
+        fl = tlsf_ffs(map);
+        map = heap->sl_bitmap[fl];
+      }
+    }
+    if (map != 0)
+      return *free_list(heap, fl, tlsf_ffs(map));
+  }
+
+  /* Rounding up skips the class 'size' itself falls in, which may still
+     hold a block big enough. Only a nearly full heap gets here, and walking
+     that one list beats failing the request. */
+  mapping_insert(size, &fl, &sl);
+  if (fl >= (int)heap->fl_count)
+    return NULL;
+  for (block = *free_list(heap, fl, sl); block != NULL;
+       block = block->next_free) {
+    if (block_size(block) >= size)
+      break;
+  }
+  return block;
+}
+
+/* Merge 'next', which physically follows 'block', into 'block'. */
+static inline void absorb_next(heap_block_t *block, heap_block_t *next) {
+  block_set_size(block, block_size(block) + block_size(next) + BLOCK_OVERHEAD);
+  link_next(block);
+}
+
+/* Release the data beyond 'size' bytes of a used block as a free block, if
+   there is room for one. */
+static void trim_used(heap_t *heap, heap_block_t *block, size_t size) {
+  heap_block_t *rest, *next;
+
+  if (block_size(block) < size + sizeof(heap_block_t))
+    return;
+
+  rest = (heap_block_t *)((char *)block->data + size - BLOCK_OVERHEAD);
+  rest->header = block_size(block) - size - BLOCK_OVERHEAD;
+  block_set_size(block, size);
+  rest->prev_phys = block;
+  mark_free(rest);
+  heap->free_bytes += block_size(rest);
+
+  next = get_next_block(rest);
+  if (is_free(next)) {
+    remove_free_block(heap, next);
+    absorb_next(rest, next);
+    heap->free_bytes += BLOCK_OVERHEAD;
+  }
+  insert_free_block(heap, rest);
+}
+
+/* Check a block is a used block of this heap. Used to verify parameters. */
+static void assert_valid_used_block(const heap_t *heap,
+                                    const heap_block_t *block) {
+  MULTI_HEAP_ASSERT((const char *)block >= (const char *)heap->first_block &&
+                        (const char *)block <
+                            (const char *)heap + heap->total_bytes,
+                    block); // block not in heap
+  MULTI_HEAP_ASSERT(!is_free(block), block); // block shouldn't be free
+  MULTI_HEAP_ASSERT(!is_last_block(block), block); // not the end block
+}
+
+void *multi_heap_get_block_address_impl(multi_heap_block_handle_t block) {
+  return ((char *)block + offsetof(heap_block_t, data));
+}
+
+size_t multi_heap_get_allocated_size_impl(multi_heap_handle_t heap, void *p) {
+  heap_block_t *pb = get_block(p);
+
+  assert_valid_used_block(heap, pb);
+  return block_size(pb);
+}
+
+multi_heap_handle_t multi_heap_register_impl(void *start, size_t size) {
+  TRACE(2, "multi_heap_register_impl start=%p,size=%d", start, (int)size);
+  heap_t *heap = (heap_t *)HEAP_ALIGN_UP((intptr_t)start);
+  uintptr_t end = HEAP_ALIGN((uintptr_t)start + size);
+  uintptr_t tables, first;
+  heap_block_t *last;
+  int fl, sl;
+
+  if (end < (uintptr_t)heap + sizeof(heap_t) + 2 * sizeof(heap_block_t)) {
+    return NULL; /* 'size' is too small to fit a heap here */
+  }
+
+  /* One first level per power of two up to the whole region */
+  mapping_insert(end - (uintptr_t)heap, &fl, &sl);
+  heap->fl_count = fl + 1;
+  heap->fl_bitmap = 0;
+  heap->sl_bitmap = (uint32_t *)(heap + 1);
+  tables = HEAP_ALIGN_UP((uintptr_t)(heap->sl_bitmap + heap->fl_count));
+  heap->free_lists = (heap_block_t **)tables;
+  tables += heap->fl_count * TLSF_SL_COUNT * sizeof(heap_block_t *);
+  if (end < tables + sizeof(heap_block_t) + BLOCK_OVERHEAD) {
+    return NULL;
+  }
+  memset(heap->sl_bitmap, 0, tables - (uintptr_t)heap->sl_bitmap);
+
+#if defined(MULTI_HEAP_DEFAULT_INT_LOCK)
+  heap->lock = (void *)(&heap->int_lock);
+#else
+  heap->lock = NULL;
+#endif
+
+  /* The first block has no previous block, so its prev_phys may overlap
+     the end of the tables. */
+  first = tables - offsetof(heap_block_t, header);
+  heap->first_block = (heap_block_t *)first;
+  heap->first_block->header = end - tables - 2 * BLOCK_OVERHEAD;
+
+  /* last block is used and of size 0, so nothing merges past it */
+  last = link_next(heap->first_block);
+  last->header = 0;
+  mark_free(heap->first_block);
+  insert_free_block(heap, heap->first_block);
+
+  heap->free_bytes = block_size(heap->first_block);
+  heap->minimum_free_bytes = heap->free_bytes;
+  heap->total_bytes = end - (uintptr_t)heap;
+  return heap;
+}
+
+void multi_heap_set_lock(multi_heap_handle_t heap, void *lock) {
+  heap->lock = lock;
+}
+
+void multi_heap_internal_lock(multi_heap_handle_t heap) {
+  MULTI_HEAP_LOCK(heap->lock);
+}
+
+void multi_heap_internal_unlock(multi_heap_handle_t heap) {
+  MULTI_HEAP_UNLOCK(heap->lock);
+}
+
+multi_heap_block_handle_t multi_heap_get_first_block(multi_heap_handle_t heap) {
+  return heap->first_block;
+}
+
+multi_heap_block_handle_t
+multi_heap_get_next_block(multi_heap_handle_t heap,
+                          multi_heap_block_handle_t block) {
+  heap_block_t *next = get_next_block(block);
+
+  (void)heap;
+  if (is_last_block(next)) {
+    return NULL;
+  }
+  return next;
+}
+
+bool multi_heap_is_free(multi_heap_block_handle_t block) {
+  return is_free(block);
+}
+
+static void *heap_malloc_locked(heap_t *heap, size_t size) {
+  heap_block_t *block = locate_free_block(heap, size);
+
+  if (block == NULL) {
+    return NULL; /* No room in heap */
+  }
+
+  remove_free_block(heap, block);
+  mark_used(block);
+  heap->free_bytes -= block_size(block);
+  trim_used(heap, block, size);
+
+  if (heap->free_bytes < heap->minimum_free_bytes) {
+    heap->minimum_free_bytes = heap->free_bytes;
+  }
+  return block->data;
+}
+
+static void heap_free_locked(heap_t *heap, heap_block_t *block) {
+  heap_block_t *next;
+
+  mark_free(block);
+  heap->free_bytes += block_size(block);
+
+  if (is_prev_free(block)) {
+    heap_block_t *prev = block->prev_phys;
+
+    remove_free_block(heap, prev);
+    absorb_next(prev, block);
+    heap->free_bytes += BLOCK_OVERHEAD;
+    block = prev;
+  }
+
+  next = get_next_block(block);
+  if (is_free(next)) {
+    remove_free_block(heap, next);
+    absorb_next(block, next);
+    heap->free_bytes += BLOCK_OVERHEAD;
+  }
+
+  insert_free_block(heap, block);
+}
+
+void *multi_heap_malloc_impl(multi_heap_handle_t heap, size_t size) {
+  void *result;
+
+  size = HEAP_ALIGN_UP(size);
+  if (size == 0 || heap == NULL) {
+    return NULL;
+  }
+  if (size < BLOCK_SIZE_MIN) {
+    size = BLOCK_SIZE_MIN;
+  }
+
+  multi_heap_internal_lock(heap);
+
+  if (heap->free_bytes < size) {
+    MULTI_HEAP_UNLOCK(heap->lock);
+    ASSERT(0, "[%s] need size = %d, heap->free_bytes = %d", __func__,
+           (int)size, (int)heap->free_bytes);
+    return NULL;
+  }
+
+  result = heap_malloc_locked(heap, size);
+
+  multi_heap_internal_unlock(heap);
+
+  return result;
+}
+
+void multi_heap_free_impl(multi_heap_handle_t heap, void *p) {
+  if (heap == NULL || p == NULL) {
+    return;
+  }
+
+  multi_heap_internal_lock(heap);
+
+  assert_valid_used_block(heap, get_block(p));
+  heap_free_locked(heap, get_block(p));
+
+  multi_heap_internal_unlock(heap);
+}
+
+void *multi_heap_realloc_impl(multi_heap_handle_t heap, void *p, size_t size) {
+  heap_block_t *pb, *next;
+  void *result;
+  size_t orig_size;
+
+  size = HEAP_ALIGN_UP(size);
+
+  assert(heap != NULL);
+
+  if (p == NULL) {
+    return multi_heap_malloc_impl(heap, size);
+  }
+
+  pb = get_block(p);
+  assert_valid_used_block(heap, pb);
+
+  if (size == 0) {
+    multi_heap_free_impl(heap, p);
+    return NULL;
+  }
+  if (size < BLOCK_SIZE_MIN) {
+    size = BLOCK_SIZE_MIN;
+  }
+
+  multi_heap_internal_lock(heap);
+  orig_size = block_size(pb);
+
+  if (size <= orig_size) {
+    // Shrinking....
+    trim_used(heap, pb, size);
+    multi_heap_internal_unlock(heap);
+    return p;
+  }
+  if (heap->free_bytes < size - orig_size) {
+    // Growing, but there's not enough total free space in the heap
+    multi_heap_internal_unlock(heap);
+    return NULL;
+  }
+
+  // Grow in place into the next block if it is free and big enough
+  next = get_next_block(pb);
+  if (is_free(next) &&
+      orig_size + BLOCK_OVERHEAD + block_size(next) >= size) {
+    remove_free_block(heap, next);
+    heap->free_bytes -= block_size(next);
+    absorb_next(pb, next);
+    mark_used(pb);
+    trim_used(heap, pb, size);
+    result = p;
+  } else {
+    result = heap_malloc_locked(heap, size);
+    if (result != NULL) {
+      memcpy(result, p, orig_size);
+      heap_free_locked(heap, pb);
+    }
+  }
+
+  if (heap->free_bytes < heap->minimum_free_bytes) {
+    heap->minimum_free_bytes = heap->free_bytes;
+  }
+
+  multi_heap_internal_unlock(heap);
+  return result;
+}
+
+#define FAIL_PRINT(num, MSG, ...)                                              \
+  do {                                                                         \
+    if (print_errors) {                                                        \
+      MULTI_HEAP_STDERR_PRINTF(num, MSG, __VA_ARGS__);                         \
+    }                                                                          \
+    valid = false;                                                             \
+  } while (0)
+
+bool multi_heap_check(multi_heap_handle_t heap, bool print_errors) {
+  bool valid = true;
+  size_t total_free_bytes = 0;
+  size_t free_blocks = 0, listed_blocks = 0;
+  const char *end;
+  assert(heap != NULL);
+
+  multi_heap_internal_lock(heap);
+
+  end = (const char *)heap + heap->total_bytes;
+  heap_block_t *prev = NULL;
+
+  /* Physical order: sizes stay in the heap, boundary tags agree */
+  for (heap_block_t *b = heap->first_block;; b = get_next_block(b)) {
+    if ((const char *)b < (const char *)heap->first_block ||
+        (const char *)b->data > end) {
+      FAIL_PRINT(2, "CORRUPT HEAP: Block %p is outside heap (prev block %p)\n",
+                 b, prev);
+      goto done;
+    }
+    if (prev != NULL && is_free(prev) != is_prev_free(b)) {
+      FAIL_PRINT(2, "CORRUPT HEAP: Block %p prev free flag wrong for %p\n", b,
+                 prev);
+    }
+    if (prev != NULL && is_free(prev) && b->prev_phys != prev) {
+      FAIL_PRINT(2, "CORRUPT HEAP: Block %p points back to %p\n", b,
+                 b->prev_phys);
+    }
+    if (is_last_block(b)) {
+      if (is_free(b)) {
+        FAIL_PRINT(1, "CORRUPT HEAP: Last block %p is free\n", b);
+      }
+      break;
+    }
+    if (is_free(b)) {
+      if (prev != NULL && is_free(prev)) {
+        FAIL_PRINT(2,
+                   "CORRUPT HEAP: Two adjacent free blocks found, %p and %p\n",
+                   prev, b);
+      }
+      total_free_bytes += block_size(b);
+      free_blocks++;
+    }
+    prev = b;
+  }
+
+  /* Free lists: every entry is free, in its own class, and flagged */
+  for (int fl = 0; fl < (int)heap->fl_count; fl++) {
+    for (int sl = 0; sl < TLSF_SL_COUNT; sl++) {
+      heap_block_t *head = *free_list(heap, fl, sl);
+      bool bit = heap->sl_bitmap[fl] & (1U << sl);
+
+      if ((head != NULL) != bit) {
+        FAIL_PRINT(2, "CORRUPT HEAP: List %d/%d bitmap wrong, head %p\n", fl,
+                   sl, head);
+      }
+      for (heap_block_t *b = head; b != NULL; b = b->next_free) {
+        int bfl, bsl;
+
+        if (!is_free(b)) {
+          FAIL_PRINT(1, "CORRUPT HEAP: Used block %p on a free list\n", b);
+          goto done;
+        }
+        mapping_insert(block_size(b), &bfl, &bsl);
+        if (bfl != fl || bsl != sl) {
+          FAIL_PRINT(3, "CORRUPT HEAP: Block %p on list %d/%d\n", b, fl, sl);
+        }
+        if (b->next_free != NULL && b->next_free->prev_free != b) {
+          FAIL_PRINT(2, "CORRUPT HEAP: Block %p next free %p links back "
+                        "wrong\n", b, b->next_free);
+        }
+        if (++listed_blocks > free_blocks) {
+          FAIL_PRINT(1, "CORRUPT HEAP: More listed than free blocks at %p\n",
+                     b);
+          goto done;
+        }
+      }
+    }
+    if (((heap->fl_bitmap >> fl) & 1) != (heap->sl_bitmap[fl] != 0)) {
+      FAIL_PRINT(1, "CORRUPT HEAP: First level %d bitmap wrong\n", fl);
+    }
+  }
+  if (listed_blocks != free_blocks) {
+    FAIL_PRINT(2, "CORRUPT HEAP: %u free blocks but %u listed\n",
+               (unsigned)free_blocks, (unsigned)listed_blocks);
+  }
+
+  if (heap->free_bytes != total_free_bytes) {
+    FAIL_PRINT(2, "CORRUPT HEAP: Expected %u free bytes counted %u\n",
+               (unsigned)heap->free_bytes, (unsigned)total_free_bytes);
+  }
+
+done:
+  multi_heap_internal_unlock(heap);
+
+  return valid;
+}
+
+void multi_heap_dump(multi_heap_handle_t heap) {
+  assert(heap != NULL);
+
+  multi_heap_internal_lock(heap);
+  MULTI_HEAP_STDERR_PRINTF(3, "Heap start %p first block %p levels %u\n", heap,
+                           heap->first_block, (unsigned)heap->fl_count);
+  for (heap_block_t *b = heap->first_block; !is_last_block(b);
+       b = get_next_block(b)) {
+    MULTI_HEAP_STDERR_PRINTF(3, "Block %p data size 0x%08x bytes next block %p",
+                             b, (unsigned)block_size(b), get_next_block(b));
+    if (is_free(b)) {
+      MULTI_HEAP_STDERR_PRINTF(1, " FREE. Next free %p\n", b->next_free);
+    } else {
+      MULTI_HEAP_STDERR_PRINTF(1, "%s",
+                               "\n"); /* C macros & optional __VA_ARGS__ */
+    }
+  }
+  multi_heap_internal_unlock(heap);
+}
+
+size_t multi_heap_free_size_impl(multi_heap_handle_t heap) {
+  if (heap == NULL) {
+    return 0;
+  }
+  return heap->free_bytes;
+}
+
+size_t multi_heap_minimum_free_size_impl(multi_heap_handle_t heap) {
+  if (heap == NULL) {
+    return 0;
+  }
+  return heap->minimum_free_bytes;
+}
+
+void multi_heap_get_info_impl(multi_heap_handle_t heap,
+                              multi_heap_info_t *info) {
+  memset(info, 0, sizeof(multi_heap_info_t));
+
+  if (heap == NULL) {
+    return;
+  }
+
+  multi_heap_internal_lock(heap);
+  for (heap_block_t *b = heap->first_block; !is_last_block(b);
+       b = get_next_block(b)) {
+    info->total_blocks++;
+    if (is_free(b)) {
+      size_t s = block_size(b);
+      info->total_free_bytes += s;
+      if (s > info->largest_free_block) {
+        info->largest_free_block = s;
+      }
+      info->free_blocks++;
+    } else {
+      info->total_allocated_bytes += block_size(b);
+      info->allocated_blocks++;
+    }
+  }
+
+  info->minimum_free_bytes = heap->minimum_free_bytes;
+  info->total_bytes = heap->total_bytes;
+  // heap has wrong total size (address printed here is not indicative of the
+  // real error)
+  MULTI_HEAP_ASSERT(info->total_free_bytes == heap->free_bytes, heap);
+
+  multi_heap_internal_unlock(heap);
+}
@@ -8,6 +8,36 @@ uint8_t *syspool_addr = NULL;
 uint32_t syspool_size = 0;
 
 static uint32_t syspoll_used = 0;
+static bool syspool_clear = true;
+
+// Open scopes, outermost first. |id| tells a scope from a later one at the
+// same depth, so a stale handle cannot end it.
+typedef struct {
+  uint32_t mark;
+  uint32_t peak;
+  uint32_t allocs;
+  int stat;
+  int id;
+} syspool_scope_t;
+
+typedef struct {
+  void *caller;
+  const char *scope;
+  uint32_t offset;
+  uint32_t size;
+} syspool_alloc_log_t;
+
+static syspool_scope_t syspool_scopes[SYSPOOL_SCOPE_DEPTH];
+static int syspool_depth = 0;
+static int syspool_scope_seq = 0;
+static syspool_scope_stat_t syspool_stats[SYSPOOL_SCOPE_STAT_NUM];
+static int syspool_stat_num = 0;
+static syspool_alloc_log_t syspool_log[SYSPOOL_ALLOC_LOG_NUM];
+static uint32_t syspool_log_cnt = 0;
+
+// A scope handle is its depth in the low bits and a sequence number above.
+#define SYSPOOL_SCOPE_ID(depth, seq) (((seq) << 3) | (depth))
+#define SYSPOOL_SCOPE_DEPTH_OF(id) ((id) & 7)
 
 static void syspool_init_addr(void) {
   syspool_addr = __HeapLimit;
@@ -18,21 +48,62 @@ uint32_t syspool_original_size(void) {
   return __StackLimit - __HeapLimit - 512;
 }
 
+static int syspool_find_stat(const char *name) {
+  int i;
+
+  for (i = 0; i < syspool_stat_num; i++) {
+    if (strcmp(syspool_stats[i].name, name) == 0)
+      return i;
+  }
+  if (syspool_stat_num == SYSPOOL_SCOPE_STAT_NUM)
+    return -1;
+  syspool_stats[syspool_stat_num].name = name;
+  return syspool_stat_num++;
+}
+
+// Ends the open scopes from |depth| inwards, innermost first.
+static void syspool_close_scopes(int depth) {
+  while (syspool_depth > depth) {
+    syspool_scope_t *scope = &syspool_scopes[--syspool_depth];
+    syspool_scope_stat_t *stat;
+
+    if (scope->stat < 0)
+      continue;
+    stat = &syspool_stats[scope->stat];
+    stat->runs++;
+    stat->last_peak = scope->peak;
+    stat->allocs = scope->allocs;
+    if (scope->peak > stat->peak)
+      stat->peak = scope->peak;
+    TRACE(4, "syspool: %s peak %d (max %d), %d buffers", stat->name,
+          scope->peak, stat->peak, scope->allocs);
+  }
+}
+
+static void syspool_reset(void) {
+  syspool_close_scopes(0);
+  syspoll_used = 0;
+  syspool_clear = true;
+}
+
 void syspool_init() {
   syspool_init_addr();
-  syspoll_used = 0;
-  memset(syspool_addr, 0, syspool_size);
+  syspool_reset();
   TRACE(2, "syspool_init: %p,0x%x", syspool_addr, syspool_size);
 }
 
+void syspool_init_noclr(void) {
+  syspool_init();
+  syspool_clear = false;
+}
+
 void syspool_init_specific_size(uint32_t size) {
   syspool_init_addr();
-  syspoll_used = 0;
+  syspool_reset();
   TRACE(2, "syspool_init_specific_size: %d/%d", size, syspool_size);
   if (size < syspool_size) {
     syspool_size = size;
   }
-  memset(syspool_addr, 0, syspool_size);
   TRACE(2, "syspool_init_specific_size: %p,0x%x", syspool_addr, size);
 }
 
@@ -42,6 +113,38 @@ uint32_t syspool_total_size(void) { return syspool_size; }
 
 int syspool_free_size() { return syspool_size - syspoll_used; }
 
+// Hands out |size| bytes at the top of the pool to |caller|.
+static uint8_t *syspool_take(uint32_t size, void *caller) {
+  uint8_t *buff = syspool_addr + syspoll_used;
+  syspool_alloc_log_t *log;
+  int i;
+
+  if (syspool_clear)
+    memset(buff, 0, size);
+
+  log = &syspool_log[syspool_log_cnt++ % SYSPOOL_ALLOC_LOG_NUM];
+  log->caller = caller;
+  log->scope = NULL;
+  log->offset = syspoll_used;
+  log->size = size;
+
+  syspoll_used += size;
+  for (i = 0; i < syspool_depth; i++) {
+    syspool_scope_t *scope = &syspool_scopes[i];
+
+    if (syspoll_used - scope->mark > scope->peak)
+      scope->peak = syspoll_used - scope->mark;
+  }
+  if (syspool_depth) {
+    syspool_scope_t *scope = &syspool_scopes[syspool_depth - 1];
+
+    scope->allocs++;
+    if (scope->stat >= 0)
+      log->scope = syspool_stats[scope->stat].name;
+  }
+  return buff;
+}
+
 int syspool_get_buff(uint8_t **buff, uint32_t size) {
   uint32_t buff_size_free;
 
@@ -54,8 +157,7 @@ int syspool_get_buff(uint8_t **buff, uint32_t size) {
   ASSERT(size <= buff_size_free,
          "System pool in shortage! To allocate size %d but free size %d.", size,
          buff_size_free);
-  *buff = syspool_addr + syspoll_used;
-  syspoll_used += size;
+  *buff = syspool_take(size, __builtin_return_address(0));
   return buff_size_free;
 }
 
@@ -67,8 +169,7 @@ int syspool_get_available(uint8_t **buff) {
   if (buff_size_free < 8)
     return -1;
   if (buff != NULL) {
-    *buff = syspool_addr + syspoll_used;
-    syspoll_used += buff_size_free;
+    *buff = syspool_take(buff_size_free, __builtin_return_address(0));
   }
   return buff_size_free;
 }
@@ -76,3 +177,72 @@ int syspool_get_available(uint8_t **buff) {
 #if defined(A2DP_LDAC_ON)
 int syspool_force_used_size(uint32_t size) { return syspoll_used = size; }
 #endif
+
+int syspool_scope_begin(const char *name) {
+  syspool_scope_t *scope;
+
+  if (syspool_depth == SYSPOOL_SCOPE_DEPTH) {
+    TRACE(1, "syspool: no room for scope %s", name);
+    return -1;
+  }
+  scope = &syspool_scopes[syspool_depth];
+  scope->mark = syspoll_used;
+  scope->peak = 0;
+  scope->allocs = 0;
+  scope->stat = syspool_find_stat(name);
+  scope->id = SYSPOOL_SCOPE_ID(syspool_depth, ++syspool_scope_seq & 0xFFFF);
+  syspool_depth++;
+  return scope->id;
+}
+
+void syspool_scope_end(int scope) {
+  int depth = SYSPOOL_SCOPE_DEPTH_OF(scope);
+
+  if (scope < 0 || depth >= syspool_depth ||
+      syspool_scopes[depth].id != scope)
+    return;
+  syspoll_used = syspool_scopes[depth].mark;
+  syspool_close_scopes(depth);
+}
+
+uint32_t syspool_mark(void) { return syspoll_used; }
+
+void syspool_rollback(uint32_t mark) {
+  int depth = syspool_depth;
+
+  if (mark > syspoll_used)
+    return;
+  // Scopes that began above the mark have nothing left to give back.
+  while (depth > 0 && syspool_scopes[depth - 1].mark > mark)
+    depth--;
+  syspool_close_scopes(depth);
+  syspoll_used = mark;
+}
+
+int syspool_get_scope_stats(syspool_scope_stat_t *stats, int num) {
+  if (num > syspool_stat_num)
+    num = syspool_stat_num;
+  memcpy(stats, syspool_stats, num * sizeof(*stats));
+  return num;
+}
+
+void syspool_dump(void) {
+  uint32_t i, n;
+
+  TRACE(3, "syspool: %p used %d/%d", syspool_addr, syspoll_used,
+        syspool_size);
+  for (i = 0; i < (uint32_t)syspool_stat_num; i++) {
+    syspool_scope_stat_t *stat = &syspool_stats[i];
+
+    TRACE(5, "syspool: scope %s runs %d peak %d last %d buffers %d",
+          stat->name, stat->runs, stat->peak, stat->last_peak, stat->allocs);
+  }
+  n = syspool_log_cnt < SYSPOOL_ALLOC_LOG_NUM ? syspool_log_cnt
+                                              : SYSPOOL_ALLOC_LOG_NUM;
+  for (i = syspool_log_cnt - n; i < syspool_log_cnt; i++) {
+    syspool_alloc_log_t *log = &syspool_log[i % SYSPOOL_ALLOC_LOG_NUM];
+
+    TRACE(4, "syspool: +0x%x %d by %p in %s", log->offset, log->size,
+          log->caller, log->scope ? log->scope : "-");
+  }
+}
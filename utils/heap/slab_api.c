@@ -0,0 +1,89 @@
+#include "cmsis.h"
+#include "hal_trace.h"
+#include "slab_api.h"
+#include <string.h>
+
+#define SLAB_ALIGN_UP(x) (((x) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+
+uint32_t slab_buffer_size(uint32_t obj_size, uint32_t count) {
+  if (obj_size < sizeof(void *))
+    obj_size = sizeof(void *);
+  return SLAB_ALIGN_UP(obj_size) * count + SLAB_ALIGN - 1;
+}
+
+uint32_t slab_init(slab_t *slab, void *buf, uint32_t size, uint32_t obj_size) {
+  uintptr_t start = SLAB_ALIGN_UP((uintptr_t)buf);
+  uint32_t pad = start - (uintptr_t)buf;
+  uint32_t total = 0;
+
+  if (obj_size < sizeof(void *))
+    obj_size = sizeof(void *);
+  obj_size = SLAB_ALIGN_UP(obj_size);
+  if (buf && size > pad)
+    total = (size - pad) / obj_size;
+
+  memset(slab, 0, sizeof(*slab));
+  slab->buf = buf;
+  slab->start = (uint8_t *)start;
+  slab->end = slab->start + total * obj_size;
+  slab->uncarved = slab->start;
+  slab->info.obj_size = obj_size;
+  slab->info.total = total;
+  return total;
+}
+
+void slab_reset(slab_t *slab) {
+  uint32_t lock = int_lock();
+  slab->uncarved = slab->start;
+  slab->free_list = NULL;
+  slab->info.used = 0;
+  int_unlock(lock);
+}
+
+void *slab_alloc(slab_t *slab) {
+  void *obj;
+  uint32_t lock = int_lock();
+
+  obj = slab->free_list;
+  if (obj) {
+    slab->free_list = *(void **)obj;
+  } else if (slab->uncarved < slab->end) {
+    obj = slab->uncarved;
+    slab->uncarved += slab->info.obj_size;
+  } else {
+    slab->info.fail_cnt++;
+    int_unlock(lock);
+    return NULL;
+  }
+  slab->info.alloc_cnt++;
+  if (++slab->info.used > slab->info.peak)
+    slab->info.peak = slab->info.used;
+  int_unlock(lock);
+  return obj;
+}
+
+void slab_free(slab_t *slab, void *obj) {
+  uint32_t lock;
+
+  ASSERT(slab_owns(slab, obj) &&
+             ((uint8_t *)obj - slab->start) % slab->info.obj_size == 0,
+         "%s: %p is not a slot of slab %p", __func__, obj, slab);
+  lock = int_lock();
+  ASSERT(slab->info.used, "%s: slab %p has no slot in use", __func__, slab);
+  *(void **)obj = slab->free_list;
+  slab->free_list = obj;
+  slab->info.used--;
+  slab->info.free_cnt++;
+  int_unlock(lock);
+}
+
+bool slab_owns(const slab_t *slab, const void *obj) {
+  return (const uint8_t *)obj >= slab->start &&
+         (const uint8_t *)obj < slab->end;
+}
+
+void slab_get_info(const slab_t *slab, slab_info_t *info) {
+  uint32_t lock = int_lock();
+  *info = slab->info;
+  int_unlock(lock);
+}
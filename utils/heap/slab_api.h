@@ -0,0 +1,53 @@
+#ifndef __SLAB_API__
+#define __SLAB_API__
+#include "stdint.h"
+#include "stdbool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fixed-size object allocator. A slab carves a caller-provided buffer into
+// equally sized slots and hands them out from an intrusive free list, so
+// slab_alloc() and slab_free() are O(1) and never fragment. Slots are carved
+// lazily on first use, so slab_init() is O(1) as well and does not touch the
+// buffer. Alloc and free may be called from different threads or from IRQ
+// context; each takes the interrupt lock for a handful of instructions.
+
+#define SLAB_ALIGN sizeof(void *)
+
+typedef struct slab_info {
+  uint32_t obj_size;  // slot size after alignment
+  uint32_t total;     // number of slots
+  uint32_t used;      // slots currently handed out
+  uint32_t peak;      // high-water mark of `used`
+  uint32_t alloc_cnt; // successful slab_alloc() calls
+  uint32_t free_cnt;  // slab_free() calls
+  uint32_t fail_cnt;  // slab_alloc() calls that found the slab empty
+} slab_info_t;
+
+typedef struct slab {
+  void *buf;         // backing buffer as passed to slab_init()
+  uint8_t *start;
+  uint8_t *end;
+  uint8_t *uncarved; // first slot never handed out yet
+  void *free_list;   // slots returned by slab_free()
+  slab_info_t info;
+} slab_t;
+
+// Bytes of backing buffer needed for `count` objects of `obj_size` bytes,
+// including worst-case alignment padding.
+uint32_t slab_buffer_size(uint32_t obj_size, uint32_t count);
+// Returns the number of slots carved from `buf`, 0 if none fit.
+uint32_t slab_init(slab_t *slab, void *buf, uint32_t size, uint32_t obj_size);
+// Return every slot to the slab. Statistics other than `used` are kept.
+void slab_reset(slab_t *slab);
+void *slab_alloc(slab_t *slab);
+void slab_free(slab_t *slab, void *obj);
+bool slab_owns(const slab_t *slab, const void *obj);
+void slab_get_info(const slab_t *slab, slab_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,259 @@
+#include "heap_api.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Replays the allocation pattern of a long media session on one med heap
+// and reports how long heap_malloc/heap_free took and how often a request
+// failed although the heap had the bytes free.
+//
+// Each tick carries A2DP packet buffers with short lifetimes and the odd
+// long-lived control object; every so often the A2DP codec switches, which
+// frees one decoder's buffers and allocates the next one's, or a SCO call
+// starts or stops, which allocates or frees the speech buffers. The
+// long-lived objects land between the big buffers and pin the free space
+// apart, which is what fragments the heap over hours of use.
+
+#define HEAP_SIZE (96 * 1024)
+#define MAX_LIVE 512
+#define TICKS_PER_SESSION 50
+
+enum { GROUP_PACKET, GROUP_OBJECT, GROUP_CODEC, GROUP_SCO };
+
+typedef struct {
+  void *ptr;
+  uint32_t size;
+  uint32_t expires; // tick it is freed at, 0 while its group holds it
+  int group;
+} bench_obj_t;
+
+typedef struct {
+  const char *name;
+  uint32_t sizes[8];
+} bench_set_t;
+
+// Decoder context, PCM buffer and frame buffers of each codec.
+static const bench_set_t codecs[] = {
+    {"sbc", {1400, 4096, 700, 700, 700, 700, 700, 700}},
+    {"aac", {14000, 4096, 1500, 1500, 1500, 1500, 0}},
+    {"ldac", {22000, 8192, 1100, 1100, 1100, 1100, 0}},
+    {"lhdc", {17000, 8192, 2048, 2048, 0}},
+};
+
+// Speech algorithm state, PCM and queues of a SCO call.
+static const bench_set_t sco = {"sco", {7200, 960, 960, 2048, 2048, 512, 0}};
+
+// Host timings catch the odd preemption, so the tail is read at the 99.9th
+// percentile as well as the maximum.
+typedef struct {
+  uint32_t *ns;
+  uint32_t calls;
+  uint32_t cap;
+  uint64_t sum_ns;
+} bench_lat_t;
+
+typedef struct {
+  bench_lat_t alloc, free;
+  uint32_t fragmented; // NULL with enough bytes free
+  uint32_t full;       // fewer bytes free than asked for
+  uint32_t first_fail; // session of the first failure of either kind
+  uint32_t max_free_blocks;
+} bench_result_t;
+
+static uint8_t heap_buf[HEAP_SIZE] __attribute__((aligned(8)));
+static bench_obj_t live[MAX_LIVE];
+static int live_cnt;
+static heap_handle_t heap;
+static bench_result_t res;
+static uint32_t lcg = 1;
+static uint32_t session;
+
+static uint32_t lcg_next(void) {
+  lcg = lcg * 1103515245u + 12345u;
+  return lcg >> 8;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void lat_add(bench_lat_t *lat, uint64_t ns) {
+  if (lat->calls == lat->cap) {
+    lat->cap = lat->cap ? 2 * lat->cap : 4096;
+    lat->ns = realloc(lat->ns, lat->cap * sizeof(*lat->ns));
+    if (!lat->ns) {
+      printf("out of memory\n");
+      exit(1);
+    }
+  }
+  lat->ns[lat->calls++] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+  lat->sum_ns += ns;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static void lat_print(const char *op, bench_lat_t *lat) {
+  qsort(lat->ns, lat->calls, sizeof(*lat->ns), cmp_u32);
+  printf("%-6s %9u %8.1f %8u %8u %8u\n", op, lat->calls,
+         lat->calls ? (double)lat->sum_ns / lat->calls : 0.0,
+         lat->calls ? lat->ns[lat->calls * 99 / 100] : 0,
+         lat->calls ? lat->ns[lat->calls * 999 / 1000] : 0,
+         lat->calls ? lat->ns[lat->calls - 1] : 0);
+}
+
+static void bench_fail(uint32_t *counter) {
+  (*counter)++;
+  if (!res.first_fail)
+    res.first_fail = session + 1;
+}
+
+static void bench_alloc(uint32_t size, int group, uint32_t expires) {
+  uint64_t t;
+  void *p;
+
+  if (live_cnt == MAX_LIVE)
+    return;
+  // The heap asserts rather than fail a request it cannot cover at all.
+  if (heap_free_size(heap) < size + sizeof(void *)) {
+    bench_fail(&res.full);
+    return;
+  }
+  t = now_ns();
+  p = heap_malloc(heap, size);
+  lat_add(&res.alloc, now_ns() - t);
+  if (!p) {
+    bench_fail(&res.fragmented);
+    return;
+  }
+  memset(p, group, size < 64 ? size : 64);
+  live[live_cnt].ptr = p;
+  live[live_cnt].size = size;
+  live[live_cnt].expires = expires;
+  live[live_cnt].group = group;
+  live_cnt++;
+}
+
+static void bench_free(int i) {
+  uint64_t t = now_ns();
+
+  heap_free(heap, live[i].ptr);
+  lat_add(&res.free, now_ns() - t);
+  live[i] = live[--live_cnt];
+}
+
+static void free_group(int group) {
+  int i = 0;
+
+  while (i < live_cnt) {
+    if (live[i].group == group && live[i].expires == 0)
+      bench_free(i);
+    else
+      i++;
+  }
+}
+
+static void alloc_set(const bench_set_t *set, int group) {
+  int i;
+
+  for (i = 0; i < 8 && set->sizes[i]; i++)
+    bench_alloc(set->sizes[i], group, 0);
+}
+
+static void bench_tick(uint32_t tick) {
+  int i = 0, n;
+
+  while (i < live_cnt) {
+    if (live[i].expires && live[i].expires <= tick)
+      bench_free(i);
+    else
+      i++;
+  }
+
+  // A2DP packets: a few per tick, held until decoded.
+  n = 1 + lcg_next() % 3;
+  while (n--)
+    bench_alloc(60 + lcg_next() % 840, GROUP_PACKET,
+                tick + 1 + lcg_next() % 8);
+
+  // Control objects: connection and profile state, timers, messages.
+  if (lcg_next() % 4 == 0)
+    bench_alloc(16 + lcg_next() % 300, GROUP_OBJECT,
+                tick + 50 + lcg_next() % 600);
+}
+
+static void usage(const char *prog) {
+  printf("usage: %s [-s sessions] [-r seed]\n", prog);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t sessions = 2000, tick = 0, codec = 0;
+  int sco_on = 0, opt;
+  multi_heap_info_t info;
+
+  while ((opt = getopt(argc, argv, "s:r:h")) != -1) {
+    switch (opt) {
+    case 's':
+      sessions = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      lcg = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  heap = heap_register(heap_buf, sizeof(heap_buf));
+  alloc_set(&codecs[codec], GROUP_CODEC);
+  for (session = 0; session < sessions; session++) {
+    int t;
+
+    for (t = 0; t < TICKS_PER_SESSION; t++)
+      bench_tick(++tick);
+
+    if (lcg_next() % 2 == 0) {
+      free_group(GROUP_CODEC);
+      codec = lcg_next() % (sizeof(codecs) / sizeof(codecs[0]));
+      alloc_set(&codecs[codec], GROUP_CODEC);
+    }
+    if (lcg_next() % 3 == 0) {
+      if (sco_on)
+        free_group(GROUP_SCO);
+      else
+        alloc_set(&sco, GROUP_SCO);
+      sco_on = !sco_on;
+    }
+
+    heap_get_info(heap, &info);
+    if (info.free_blocks > res.max_free_blocks)
+      res.max_free_blocks = info.free_blocks;
+  }
+  if (!heap_check(heap, true)) {
+    printf("heap corrupt\n");
+    return 1;
+  }
+
+  heap_get_info(heap, &info);
+  printf("%s: %u sessions, %d KB heap\n", argv[0], sessions, HEAP_SIZE / 1024);
+  printf("%-6s %9s %8s %8s %8s %8s\n", "op", "calls", "mean ns", "p99",
+         "p99.9", "max");
+  lat_print("malloc", &res.alloc);
+  lat_print("free", &res.free);
+  printf("failed: %u fragmented, %u full, first in session %u\n",
+         res.fragmented, res.full, res.first_fail);
+  printf("free blocks: %u now, %u peak; largest %u of %u free bytes\n",
+         (unsigned)info.free_blocks, res.max_free_blocks,
+         (unsigned)info.largest_free_block, (unsigned)info.total_free_bytes);
+  return 0;
+}
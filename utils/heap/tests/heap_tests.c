@@ -0,0 +1,208 @@
+#include "heap_api.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Behaviour of the heap_* API that callers rely on, whichever multi_heap
+// backend is linked in.
+
+#define HEAP_SIZE (64 * 1024)
+#define MAX_LIVE 256
+
+static uint8_t heap_buf[HEAP_SIZE] __attribute__((aligned(8)));
+
+static uint32_t lcg_next(uint32_t *lcg) {
+  *lcg = *lcg * 1103515245u + 12345u;
+  return *lcg >> 8;
+}
+
+static size_t free_after_register(void) {
+  heap_handle_t heap = heap_register(heap_buf, sizeof(heap_buf));
+
+  return heap_free_size(heap);
+}
+
+static void test_register(void) {
+  static uint8_t tiny[16];
+  heap_handle_t heap;
+  multi_heap_info_t info;
+
+  assert(heap_register(tiny, sizeof(tiny)) == NULL);
+
+  // The handle sits at the start of the region, which callers use to find
+  // the heap a pointer came from.
+  heap = heap_register(heap_buf, sizeof(heap_buf));
+  assert((uint8_t *)heap == heap_buf);
+  heap_get_info(heap, &info);
+  assert(info.total_bytes == sizeof(heap_buf));
+  assert(info.free_blocks == 1 && info.allocated_blocks == 0);
+  assert(info.largest_free_block == info.total_free_bytes);
+  assert(info.minimum_free_bytes == info.total_free_bytes);
+  assert(heap_check(heap, true));
+}
+
+static void test_malloc_free(void) {
+  heap_handle_t heap = heap_register(heap_buf, sizeof(heap_buf));
+  size_t initial = heap_free_size(heap);
+  multi_heap_info_t info;
+  uint8_t *p[64];
+  int i;
+
+  assert(heap_malloc(heap, 0) == NULL);
+  for (i = 0; i < 64; i++) {
+    size_t size = 1 + i * 23;
+
+    p[i] = heap_malloc(heap, size);
+    assert(p[i] && (uintptr_t)p[i] % sizeof(void *) == 0);
+    assert(heap_get_allocated_size(heap, p[i]) >= size);
+    memset(p[i], i, size);
+  }
+  assert(heap_check(heap, true));
+  heap_get_info(heap, &info);
+  assert(info.allocated_blocks == 64);
+  assert(info.total_free_bytes == heap_free_size(heap));
+  assert(heap_minimum_free_size(heap) == heap_free_size(heap));
+
+  // Every other block, then the rest: the holes merge back into one block.
+  for (i = 0; i < 64; i += 2)
+    heap_free(heap, p[i]);
+  assert(heap_check(heap, true));
+  for (i = 1; i < 64; i += 2) {
+    size_t j, size = 1 + i * 23;
+
+    for (j = 0; j < size; j++)
+      assert(p[i][j] == i);
+    heap_free(heap, p[i]);
+  }
+  heap_free(heap, NULL);
+  assert(heap_check(heap, true));
+  assert(heap_free_size(heap) == initial);
+  heap_get_info(heap, &info);
+  assert(info.free_blocks == 1 && info.largest_free_block == initial);
+  assert(heap_minimum_free_size(heap) < initial);
+}
+
+// The largest single block a fresh heap hands out is its whole free space.
+static void test_exhaust(void) {
+  heap_handle_t heap = heap_register(heap_buf, sizeof(heap_buf));
+  size_t initial = heap_free_size(heap);
+  void *p = heap_malloc(heap, initial);
+
+  assert(p && heap_free_size(heap) == 0);
+  heap_free(heap, p);
+  assert(heap_free_size(heap) == initial);
+
+  // Two halves that together use everything.
+  p = heap_malloc(heap, initial / 2);
+  assert(p);
+  assert(heap_malloc(heap, heap_free_size(heap)) != NULL);
+  assert(heap_check(heap, true));
+}
+
+static void test_realloc(void) {
+  heap_handle_t heap = heap_register(heap_buf, sizeof(heap_buf));
+  size_t initial = heap_free_size(heap);
+  uint8_t *a, *b, *c;
+  int i;
+
+  a = heap_realloc(heap, NULL, 100);
+  assert(a);
+  for (i = 0; i < 100; i++)
+    a[i] = (uint8_t)i;
+
+  // Nothing follows: grows in place.
+  b = heap_realloc(heap, a, 1000);
+  assert(b == a);
+  for (i = 0; i < 100; i++)
+    assert(b[i] == (uint8_t)i);
+
+  // Shrinks in place and gives the tail back.
+  a = heap_realloc(heap, b, 200);
+  assert(a == b && heap_get_allocated_size(heap, a) < 1000);
+
+  // Blocked by a neighbour: moves, keeping the contents.
+  c = heap_malloc(heap, 64);
+  b = heap_realloc(heap, a, 4000);
+  assert(b && b != a);
+  for (i = 0; i < 100; i++)
+    assert(b[i] == (uint8_t)i);
+  assert(heap_check(heap, true));
+
+  assert(heap_realloc(heap, b, sizeof(heap_buf)) == NULL);
+  assert(heap_realloc(heap, b, 0) == NULL);
+  heap_free(heap, c);
+  assert(heap_check(heap, true));
+  assert(heap_free_size(heap) == initial);
+}
+
+// Random malloc/free/realloc: contents survive, the heap stays consistent
+// and nothing leaks.
+static void test_random_churn(void) {
+  heap_handle_t heap = heap_register(heap_buf, sizeof(heap_buf));
+  size_t initial = heap_free_size(heap);
+  uint8_t *live[MAX_LIVE];
+  size_t size[MAX_LIVE];
+  uint32_t lcg = 4321;
+  int n = 0, iter, i;
+
+  for (iter = 0; iter < 100000; iter++) {
+    uint32_t r = lcg_next(&lcg);
+
+    if (n < MAX_LIVE && (n == 0 || r % 8 < 4)) {
+      size_t s = 1 + lcg_next(&lcg) % (r % 16 == 0 ? 4096 : 256);
+
+      if (heap_free_size(heap) < s + 64)
+        continue;
+      live[n] = heap_malloc(heap, s);
+      if (!live[n])
+        continue;
+      memset(live[n], n, s);
+      size[n++] = s;
+    } else {
+      int victim = lcg_next(&lcg) % n;
+      size_t j;
+
+      for (j = 0; j < size[victim]; j++)
+        assert(live[victim][j] == (uint8_t)victim);
+      if (r % 8 == 7) {
+        size_t s = 1 + lcg_next(&lcg) % 1024;
+        uint8_t *p;
+
+        if (heap_free_size(heap) < s + 64)
+          continue;
+        p = heap_realloc(heap, live[victim], s);
+        if (p) {
+          memset(p, victim, s);
+          live[victim] = p;
+          size[victim] = s;
+        }
+        continue;
+      }
+      heap_free(heap, live[victim]);
+      n--;
+      if (victim != n) {
+        live[victim] = live[n];
+        size[victim] = size[n];
+        memset(live[victim], victim, size[victim]);
+      }
+    }
+    if (iter % 1000 == 0)
+      assert(heap_check(heap, true));
+  }
+  for (i = 0; i < n; i++)
+    heap_free(heap, live[i]);
+  assert(heap_check(heap, true));
+  assert(heap_free_size(heap) == initial);
+}
+
+int main(void) {
+  assert(free_after_register() > sizeof(heap_buf) - 4096);
+  test_register();
+  test_malloc_free();
+  test_exhaust();
+  test_realloc();
+  test_random_churn();
+  printf("All heap tests passed.\n");
+  return 0;
+}
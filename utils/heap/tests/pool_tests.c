@@ -0,0 +1,218 @@
+#include "heap_api.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// The syspool bump allocator with its scopes. The pool is this array: the
+// Makefile points __StackLimit at its end, as the linker script does on
+// the target, and syspool keeps the last 512 bytes for the stack.
+
+#define POOL_SIZE (16 * 1024)
+
+uint8_t __HeapLimit[POOL_SIZE + 512] __attribute__((aligned(8)));
+
+static const syspool_scope_stat_t *find_stat(const char *name) {
+  static syspool_scope_stat_t stats[SYSPOOL_SCOPE_STAT_NUM];
+  int i, n = syspool_get_scope_stats(stats, SYSPOOL_SCOPE_STAT_NUM);
+
+  for (i = 0; i < n; i++) {
+    if (strcmp(stats[i].name, name) == 0)
+      return &stats[i];
+  }
+  return NULL;
+}
+
+static int all_bytes(const uint8_t *p, uint8_t val, uint32_t len) {
+  while (len--) {
+    if (*p++ != val)
+      return 0;
+  }
+  return 1;
+}
+
+static void test_get_buff(void) {
+  uint8_t *a, *b;
+
+  syspool_init();
+  assert(syspool_start_addr() == __HeapLimit);
+  assert(syspool_total_size() == POOL_SIZE);
+  assert(syspool_free_size() == POOL_SIZE);
+
+  // Sizes round up to words and buffers follow each other.
+  syspool_get_buff(&a, 5);
+  syspool_get_buff(&b, 100);
+  assert(a == __HeapLimit && b == a + 8);
+  assert(syspool_free_size() == POOL_SIZE - 108);
+  assert(syspool_mark() == 108);
+
+  assert(syspool_get_available(NULL) == POOL_SIZE - 108);
+  assert(syspool_get_available(&a) == POOL_SIZE - 108);
+  assert(a == b + 100 && syspool_free_size() == 0);
+  assert(syspool_get_available(NULL) == -1);
+
+  syspool_init_specific_size(1024);
+  assert(syspool_total_size() == 1024 && syspool_free_size() == 1024);
+  syspool_init_specific_size(POOL_SIZE * 2);
+  assert(syspool_total_size() == POOL_SIZE);
+}
+
+// Buffers come out zeroed, but only the bytes handed out are written.
+static void test_zero_on_hand_out(void) {
+  uint8_t *a, *b;
+
+  memset(__HeapLimit, 0xa5, sizeof(__HeapLimit));
+  syspool_init();
+  assert(all_bytes(__HeapLimit, 0xa5, POOL_SIZE));
+  syspool_get_buff(&a, 256);
+  assert(all_bytes(a, 0, 256));
+  assert(all_bytes(a + 256, 0xa5, POOL_SIZE - 256));
+
+  // A buffer taken again after a rollback is zeroed again.
+  memset(a, 0x5a, 256);
+  syspool_rollback(0);
+  syspool_get_buff(&b, 128);
+  assert(b == a && all_bytes(b, 0, 128));
+  assert(all_bytes(a + 128, 0x5a, 128));
+
+  memset(__HeapLimit, 0xa5, sizeof(__HeapLimit));
+  syspool_init_noclr();
+  syspool_get_buff(&a, 256);
+  assert(all_bytes(a, 0xa5, 256));
+
+  // The next plain init zeroes again.
+  syspool_init();
+  syspool_get_buff(&a, 256);
+  assert(all_bytes(a, 0, 256));
+}
+
+static void test_scopes(void) {
+  const syspool_scope_stat_t *stat;
+  int outer, inner;
+  uint8_t *p;
+
+  syspool_init();
+  syspool_get_buff(&p, 64);
+  outer = syspool_scope_begin("test.outer");
+  assert(outer >= 0);
+  syspool_get_buff(&p, 1000);
+  inner = syspool_scope_begin("test.inner");
+  assert(inner >= 0 && inner != outer);
+  syspool_get_buff(&p, 400);
+  syspool_get_buff(&p, 100);
+
+  // Ending the inner scope gives its buffers back.
+  syspool_scope_end(inner);
+  assert(syspool_mark() == 64 + 1000);
+  stat = find_stat("test.inner");
+  assert(stat && stat->runs == 1 && stat->peak == 500);
+  assert(stat->last_peak == 500 && stat->allocs == 2);
+  assert(find_stat("test.outer")->runs == 0);
+
+  // A smaller second run keeps the peak and updates the last run.
+  inner = syspool_scope_begin("test.inner");
+  syspool_get_buff(&p, 200);
+  syspool_scope_end(inner);
+  stat = find_stat("test.inner");
+  assert(stat->runs == 2 && stat->peak == 500 && stat->last_peak == 200);
+
+  // The stale handle names an ended scope; it must not end the outer one.
+  syspool_scope_end(inner);
+  assert(syspool_mark() == 64 + 1000);
+  assert(find_stat("test.outer")->runs == 0);
+
+  // The outer peak counts what its nested scopes held.
+  syspool_scope_end(outer);
+  assert(syspool_mark() == 64);
+  stat = find_stat("test.outer");
+  assert(stat && stat->runs == 1 && stat->peak == 1500);
+  assert(stat->allocs == 1);
+  syspool_scope_end(outer);
+  assert(syspool_mark() == 64);
+}
+
+// Ending an outer scope, rolling back below a scope or re-initialising the
+// pool ends the scopes still open inside.
+static void test_scope_unwind(void) {
+  const syspool_scope_stat_t *stat;
+  int outer, inner, i, s[SYSPOOL_SCOPE_DEPTH];
+  uint32_t mark;
+  uint8_t *p;
+
+  syspool_init();
+  outer = syspool_scope_begin("unwind.outer");
+  syspool_get_buff(&p, 100);
+  inner = syspool_scope_begin("unwind.inner");
+  syspool_get_buff(&p, 300);
+  syspool_scope_end(outer);
+  assert(syspool_mark() == 0);
+  assert(find_stat("unwind.inner")->runs == 1);
+  assert(find_stat("unwind.outer")->peak == 400);
+  syspool_scope_end(inner);
+  assert(find_stat("unwind.inner")->runs == 1);
+
+  // A rollback to the start of a scope keeps it open.
+  outer = syspool_scope_begin("unwind.outer");
+  mark = syspool_mark();
+  syspool_get_buff(&p, 100);
+  inner = syspool_scope_begin("unwind.inner");
+  syspool_get_buff(&p, 300);
+  syspool_rollback(mark);
+  assert(syspool_mark() == mark);
+  assert(find_stat("unwind.inner")->runs == 2);
+  assert(find_stat("unwind.outer")->runs == 1);
+  syspool_get_buff(&p, 50);
+  syspool_rollback(mark + 1000);
+  assert(syspool_mark() == mark + 52);
+
+  syspool_init();
+  assert(syspool_mark() == 0);
+  stat = find_stat("unwind.outer");
+  assert(stat->runs == 2 && stat->last_peak == 400 && stat->allocs == 2);
+  syspool_scope_end(outer);
+  assert(find_stat("unwind.outer")->runs == 2);
+
+  for (i = 0; i < SYSPOOL_SCOPE_DEPTH; i++) {
+    s[i] = syspool_scope_begin("unwind.deep");
+    assert(s[i] >= 0);
+  }
+  assert(syspool_scope_begin("unwind.deep") == -1);
+  syspool_scope_end(-1);
+  syspool_scope_end(s[0]);
+  assert(find_stat("unwind.deep")->runs == SYSPOOL_SCOPE_DEPTH);
+}
+
+// Scopes still work once every name slot is taken; they just go unrecorded.
+static void test_stat_table_full(void) {
+  static char names[SYSPOOL_SCOPE_STAT_NUM][16];
+  syspool_scope_stat_t stats[SYSPOOL_SCOPE_STAT_NUM];
+  int i, n, scope;
+  uint8_t *p;
+
+  syspool_init();
+  for (i = 0; i < SYSPOOL_SCOPE_STAT_NUM; i++) {
+    snprintf(names[i], sizeof(names[i]), "full.%d", i);
+    syspool_scope_end(syspool_scope_begin(names[i]));
+  }
+  n = syspool_get_scope_stats(stats, SYSPOOL_SCOPE_STAT_NUM);
+  assert(n == SYSPOOL_SCOPE_STAT_NUM);
+
+  scope = syspool_scope_begin("full.extra");
+  assert(scope >= 0);
+  syspool_get_buff(&p, 64);
+  syspool_scope_end(scope);
+  assert(syspool_mark() == 0);
+  assert(find_stat("full.extra") == NULL);
+  assert(syspool_get_scope_stats(stats, 2) == 2);
+  syspool_dump();
+}
+
+int main(void) {
+  test_get_buff();
+  test_zero_on_hand_out();
+  test_scopes();
+  test_scope_unwind();
+  test_stat_table_full();
+  printf("All syspool tests passed.\n");
+  return 0;
+}
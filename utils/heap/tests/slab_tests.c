@@ -0,0 +1,107 @@
+#include "slab_api.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define OBJ_SIZE 37
+#define OBJ_COUNT 50
+
+static void test_init_sizes_and_aligns_slots(void) {
+  static uint8_t buf[4096];
+  slab_t slab;
+  slab_info_t info;
+  uint32_t size = slab_buffer_size(OBJ_SIZE, OBJ_COUNT);
+
+  assert(size <= sizeof(buf));
+  // An odd start address must still yield `count` aligned slots.
+  assert(slab_init(&slab, buf + 1, size, OBJ_SIZE) == OBJ_COUNT);
+  slab_get_info(&slab, &info);
+  assert(info.obj_size % SLAB_ALIGN == 0 && info.obj_size >= OBJ_SIZE);
+  assert(info.total == OBJ_COUNT && info.used == 0);
+
+  for (int i = 0; i < OBJ_COUNT; ++i) {
+    uint8_t *p = slab_alloc(&slab);
+    assert(p && (uintptr_t)p % SLAB_ALIGN == 0);
+    assert(p >= buf + 1 && p + OBJ_SIZE <= buf + 1 + size);
+    memset(p, 0xa5, OBJ_SIZE);
+  }
+  assert(slab_alloc(&slab) == NULL);
+  slab_get_info(&slab, &info);
+  assert(info.used == OBJ_COUNT && info.peak == OBJ_COUNT);
+  assert(info.alloc_cnt == OBJ_COUNT && info.fail_cnt == 1);
+
+  assert(slab_init(&slab, buf, sizeof(void *) - 1, 1) == 0);
+  assert(slab_alloc(&slab) == NULL);
+  assert(slab_init(&slab, NULL, 0, OBJ_SIZE) == 0);
+}
+
+static void test_free_reuses_slots_and_tracks_stats(void) {
+  static uint8_t buf[1024];
+  void *objs[OBJ_COUNT];
+  slab_t slab;
+  slab_info_t info;
+
+  slab_init(&slab, buf, sizeof(buf), OBJ_SIZE);
+  for (int i = 0; i < 10; ++i)
+    objs[i] = slab_alloc(&slab);
+  assert(!slab_owns(&slab, buf + sizeof(buf)));
+  assert(slab_owns(&slab, objs[3]));
+
+  slab_free(&slab, objs[3]);
+  slab_free(&slab, objs[7]);
+  assert(slab_alloc(&slab) == objs[7]);
+  assert(slab_alloc(&slab) == objs[3]);
+  slab_free(&slab, objs[0]);
+  slab_get_info(&slab, &info);
+  assert(info.used == 9 && info.peak == 10);
+  assert(info.alloc_cnt == 12 && info.free_cnt == 3);
+
+  slab_reset(&slab);
+  slab_get_info(&slab, &info);
+  assert(info.used == 0 && info.peak == 10);
+  assert(slab_alloc(&slab) == objs[0]);
+}
+
+// Random alloc/free churn: every live object keeps its contents, no slot is
+// handed out twice, and the slab never runs dry while a slot is free.
+static void test_random_churn(void) {
+  static uint8_t buf[OBJ_COUNT * 48 + SLAB_ALIGN];
+  uint8_t *live[OBJ_COUNT];
+  uint32_t n = 0, lcg = 12345;
+  slab_t slab;
+  slab_info_t info;
+
+  assert(slab_init(&slab, buf, sizeof(buf), 48) == OBJ_COUNT);
+  for (int iter = 0; iter < 200000; ++iter) {
+    lcg = lcg * 1103515245u + 12345u;
+    if (n < OBJ_COUNT && (n == 0 || (lcg >> 16) % 3 != 0)) {
+      uint8_t *p = slab_alloc(&slab);
+      assert(p);
+      for (uint32_t i = 0; i < n; ++i)
+        assert(live[i] != p);
+      memset(p, (uint8_t)iter, 48);
+      p[0] = (uint8_t)n;
+      live[n++] = p;
+    } else {
+      uint32_t victim = (lcg >> 8) % n;
+      uint8_t *p = live[victim];
+      for (int b = 1; b < 48; ++b)
+        assert(p[b] == p[1]);
+      slab_free(&slab, p);
+      live[victim] = live[--n];
+    }
+  }
+  slab_get_info(&slab, &info);
+  assert(info.used == n);
+  assert(info.alloc_cnt - info.free_cnt == n);
+  assert(info.peak == OBJ_COUNT && info.fail_cnt == 0);
+}
+
+int main(void) {
+  test_init_sizes_and_aligns_slots();
+  test_free_reuses_slots_and_tracks_stats();
+  test_random_churn();
+  printf("All slab tests passed.\n");
+  return 0;
+}
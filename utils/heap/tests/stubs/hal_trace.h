@@ -0,0 +1,36 @@
+#ifndef __HAL_TRACE_H__
+#define __HAL_TRACE_H__
+
+// Host stand-in for platform/hal/hal_trace.h: TRACE compiles to nothing,
+// hal_trace_printf goes to stderr and ASSERT prints and aborts.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static inline void hal_trace_dummy(const char *fmt, ...) { (void)fmt; }
+
+static inline int hal_trace_printf(uint32_t attr, const char *fmt, ...) {
+  va_list ap;
+  int ret;
+
+  (void)attr;
+  va_start(ap, fmt);
+  ret = vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  return ret;
+}
+
+#define TRACE(attr, str, ...) hal_trace_dummy(str, ##__VA_ARGS__)
+
+#define ASSERT(cond, str, ...)                                                 \
+  {                                                                            \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "ASSERT %s:%d: " str "\n", __FILE__, __LINE__,          \
+              ##__VA_ARGS__);                                                  \
+      abort();                                                                 \
+    }                                                                          \
+  }
+
+#endif // __HAL_TRACE_H__
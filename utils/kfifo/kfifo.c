@@ -17,6 +17,25 @@ void kfifo_init(struct kfifo *fifo, unsigned char *buffer, unsigned int len) {
   fifo->size = len;
   fifo->buffer = buffer;
   fifo->in = fifo->out = 0;
+  fifo->mirror = 0;
+}
+
+void kfifo_init_mirrored(struct kfifo *fifo, unsigned char *buffer,
+                         unsigned int len, unsigned int mirror) {
+  ASSERT(mirror <= len, "kfifo_init_mirrored : mirror %d > len %d", mirror,
+         len);
+  kfifo_init(fifo, buffer, len);
+  fifo->mirror = mirror;
+}
+
+/* Copy the part of [off, off + len) that lies in the head region to the
+ * shadow after the buffer. */
+static void kfifo_mirror_head(struct kfifo *fifo, unsigned int off,
+                              unsigned int len) {
+  if (off < fifo->mirror) {
+    memcpy(fifo->buffer + fifo->size + off, fifo->buffer + off,
+           MIN(len, fifo->mirror - off));
+  }
 }
 unsigned int kfifo_put(struct kfifo *fifo, unsigned char *buffer,
                        unsigned int len) {
@@ -27,6 +46,10 @@ unsigned int kfifo_put(struct kfifo *fifo, unsigned char *buffer,
   l = MIN(len, fifo->size - (fifo->in & (fifo->size - 1)));
   memcpy(fifo->buffer + (fifo->in & (fifo->size - 1)), buffer, l);
   memcpy(fifo->buffer, buffer + l, len - l);
+  if (fifo->mirror) {
+    kfifo_mirror_head(fifo, fifo->in & (fifo->size - 1), l);
+    kfifo_mirror_head(fifo, 0, len - l);
+  }
 
   __sync_synchronize();
   fifo->in += len;
@@ -61,8 +84,12 @@ unsigned int kfifo_peek(struct kfifo *fifo, unsigned int len_want,
   }
 
   __sync_synchronize();
-  l = MIN(len, fifo->size - (fifo->out & (fifo->size - 1)));
   *buff1 = fifo->buffer + (fifo->out & (fifo->size - 1));
+  if (len <= fifo->mirror) {
+    *len1 = len;
+    return len_want;
+  }
+  l = MIN(len, fifo->size - (fifo->out & (fifo->size - 1)));
   *len1 = l;
   if (l < len) {
     *buff2 = fifo->buffer;
@@ -91,6 +118,29 @@ unsigned int kfifo_peek_to_buf(struct kfifo *fifo, unsigned char *buff,
 
 unsigned int kfifo_len(struct kfifo *fifo) { return (fifo->in - fifo->out); }
 
+unsigned char *kfifo_peek_contig(struct kfifo *fifo, unsigned int len) {
+  unsigned int off = fifo->out & (fifo->size - 1);
+
+  if (fifo->in - fifo->out < len) {
+    return NULL;
+  }
+  if (len > fifo->mirror && len > fifo->size - off) {
+    return NULL;
+  }
+
+  __sync_synchronize();
+  return fifo->buffer + off;
+}
+
+unsigned int kfifo_skip(struct kfifo *fifo, unsigned int len) {
+  len = MIN(len, fifo->in - fifo->out);
+
+  __sync_synchronize();
+  fifo->out += len;
+
+  return len;
+}
+
 #if 0
 struct kfifo test_kfifo;
 unsigned char kfifo_buffer[32];
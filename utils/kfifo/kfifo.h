@@ -12,6 +12,7 @@ struct kfifo {
     unsigned int size;         /* the size of the allocated buffer */
     unsigned int in;           /* data is added at offset (in % size) */
     unsigned int out;          /* data is extracted from off. (out % size) */
+    unsigned int mirror;       /* bytes of shadow copy after the buffer */
 };
 
 void kfifo_init(struct kfifo *k, unsigned char *buff, unsigned int len);
@@ -21,6 +22,17 @@ unsigned int kfifo_peek(struct kfifo *k, unsigned int len_want, unsigned char **
 unsigned int kfifo_peek_to_buf(struct kfifo *fifo, unsigned char *buff, unsigned int len);
 unsigned int kfifo_len(struct kfifo *fifo);
 
+/*
+ * Mirrored mode: buff holds len + mirror bytes and the last mirror bytes
+ * shadow the first mirror bytes of the ring, so any peek of up to mirror
+ * bytes is one contiguous span (kfifo_peek() then never returns buff2).
+ */
+void kfifo_init_mirrored(struct kfifo *k, unsigned char *buff, unsigned int len, unsigned int mirror);
+/* Contiguous view of len queued bytes, or NULL if fewer are queued or the span wraps past the mirror */
+unsigned char *kfifo_peek_contig(struct kfifo *k, unsigned int len);
+/* Drop len bytes after consuming them in place */
+unsigned int kfifo_skip(struct kfifo *k, unsigned int len);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -0,0 +1,18 @@
+#ifndef __HAL_TRACE_H__
+#define __HAL_TRACE_H__
+
+// Host stand-in for platform/hal/hal_trace.h: ASSERT prints and aborts.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ASSERT(cond, str, ...)                                                 \
+  {                                                                            \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "ASSERT %s:%d: " str "\n", __FILE__, __LINE__,          \
+              ##__VA_ARGS__);                                                  \
+      abort();                                                                 \
+    }                                                                          \
+  }
+
+#endif // __HAL_TRACE_H__
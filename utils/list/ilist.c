@@ -0,0 +1,148 @@
+#include "ilist.h"
+#include "hal_trace.h"
+
+// Returns |list| to the empty state. Nodes still linked to it are forgotten,
+// not touched.
+void ilist_init(ilist_t *list) {
+  ASSERT(list != NULL, "%s", __func__);
+  list->head = NULL;
+  list->tail = NULL;
+  list->length = 0;
+}
+
+bool ilist_is_empty(const ilist_t *list) {
+  ASSERT(list != NULL, "%s", __func__);
+  return list->length == 0;
+}
+
+size_t ilist_length(const ilist_t *list) {
+  ASSERT(list != NULL, "%s", __func__);
+  return list->length;
+}
+
+// Links |node| after |prev_node|, or at the front when |prev_node| is NULL.
+// |node| must not be on any list.
+void ilist_insert_after(ilist_t *list, ilist_node_t *prev_node,
+                        ilist_node_t *node) {
+  ilist_node_t *next;
+  ASSERT(list != NULL, "%s", __func__);
+  ASSERT(node != NULL, "%s", __func__);
+
+  next = prev_node ? prev_node->next : list->head;
+  node->prev = prev_node;
+  node->next = next;
+  if (prev_node)
+    prev_node->next = node;
+  else
+    list->head = node;
+  if (next)
+    next->prev = node;
+  else
+    list->tail = node;
+  ++list->length;
+}
+
+void ilist_prepend(ilist_t *list, ilist_node_t *node) {
+  ilist_insert_after(list, NULL, node);
+}
+
+void ilist_append(ilist_t *list, ilist_node_t *node) {
+  ASSERT(list != NULL, "%s", __func__);
+  ilist_insert_after(list, list->tail, node);
+}
+
+// Unlinks |node|, which must be on |list|. The node itself is not freed.
+void ilist_remove(ilist_t *list, ilist_node_t *node) {
+  ASSERT(list != NULL, "%s", __func__);
+  ASSERT(node != NULL, "%s", __func__);
+  ASSERT(list->length, "%s: empty list", __func__);
+
+  if (node->prev)
+    node->prev->next = node->next;
+  else
+    list->head = node->next;
+  if (node->next)
+    node->next->prev = node->prev;
+  else
+    list->tail = node->prev;
+  node->next = NULL;
+  node->prev = NULL;
+  --list->length;
+}
+
+// Unlinks and returns the first node, or NULL if |list| is empty.
+ilist_node_t *ilist_pop_front(ilist_t *list) {
+  ilist_node_t *node;
+  ASSERT(list != NULL, "%s", __func__);
+
+  node = list->head;
+  if (node)
+    ilist_remove(list, node);
+  return node;
+}
+
+// Moves every node of |src| to the back of |dst|, leaving |src| empty.
+void ilist_splice(ilist_t *dst, ilist_t *src) {
+  ASSERT(dst != NULL, "%s", __func__);
+  ASSERT(src != NULL, "%s", __func__);
+
+  if (src->head == NULL)
+    return;
+  if (dst->tail) {
+    dst->tail->next = src->head;
+    src->head->prev = dst->tail;
+  } else {
+    dst->head = src->head;
+  }
+  dst->tail = src->tail;
+  dst->length += src->length;
+  ilist_init(src);
+}
+
+// Moves the first |count| nodes of |src| (all of them if it is shorter) to
+// the back of |dst| and returns how many were moved. O(count).
+size_t ilist_cut_front(ilist_t *dst, ilist_t *src, size_t count) {
+  ilist_t cut;
+  ilist_node_t *last;
+  size_t n;
+  ASSERT(dst != NULL, "%s", __func__);
+  ASSERT(src != NULL, "%s", __func__);
+
+  if (count >= src->length) {
+    n = src->length;
+    ilist_splice(dst, src);
+    return n;
+  }
+  if (count == 0)
+    return 0;
+
+  last = src->head;
+  for (n = 1; n < count; ++n)
+    last = last->next;
+
+  cut.head = src->head;
+  cut.tail = last;
+  cut.length = count;
+  src->head = last->next;
+  src->head->prev = NULL;
+  src->length -= count;
+  last->next = NULL;
+  ilist_splice(dst, &cut);
+  return count;
+}
+
+ilist_node_t *ilist_begin(const ilist_t *list) {
+  ASSERT(list != NULL, "%s", __func__);
+  return list->head;
+}
+
+// The iterator one past the last node, for use with |ilist_next|.
+ilist_node_t *ilist_end(const ilist_t *list) {
+  ASSERT(list != NULL, "%s", __func__);
+  return NULL;
+}
+
+ilist_node_t *ilist_next(const ilist_node_t *node) {
+  ASSERT(node != NULL, "%s", __func__);
+  return node->next;
+}
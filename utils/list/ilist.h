@@ -0,0 +1,55 @@
+#ifndef __ILIST_H__
+#define __ILIST_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Intrusive doubly-linked list. The caller embeds an ilist_node_t in each
+// element, so linking never allocates, and removing any element or splicing
+// two lists is O(1). An element may be on at most one list per embedded node.
+
+typedef struct ilist_node_t {
+  struct ilist_node_t *next;
+  struct ilist_node_t *prev;
+} ilist_node_t;
+
+typedef struct ilist_t {
+  ilist_node_t *head;
+  ilist_node_t *tail;
+  size_t length;
+} ilist_t;
+
+// The element containing |node|, embedded as |member| of |type|.
+#define ilist_entry(node, type, member)                                        \
+  ((type *)((char *)(node)-offsetof(type, member)))
+
+void ilist_init(ilist_t *list);
+
+// Accessors.
+bool ilist_is_empty(const ilist_t *list);
+size_t ilist_length(const ilist_t *list);
+
+// Mutators.
+void ilist_insert_after(ilist_t *list, ilist_node_t *prev_node,
+                        ilist_node_t *node);
+void ilist_prepend(ilist_t *list, ilist_node_t *node);
+void ilist_append(ilist_t *list, ilist_node_t *node);
+void ilist_remove(ilist_t *list, ilist_node_t *node);
+ilist_node_t *ilist_pop_front(ilist_t *list);
+void ilist_splice(ilist_t *dst, ilist_t *src);
+size_t ilist_cut_front(ilist_t *dst, ilist_t *src, size_t count);
+
+// Iteration.
+ilist_node_t *ilist_begin(const ilist_t *list);
+ilist_node_t *ilist_end(const ilist_t *list);
+ilist_node_t *ilist_next(const ilist_node_t *node);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __ILIST_H__
@@ -0,0 +1,134 @@
+#include "ilist.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ITEM_NUM 64
+
+typedef struct {
+  uint32_t seq;
+  ilist_node_t node;
+} item_t;
+
+static item_t items[ITEM_NUM];
+
+static item_t *item_of(ilist_node_t *node) {
+  return node ? ilist_entry(node, item_t, node) : NULL;
+}
+
+// Walks |list| both ways and checks it holds exactly |seqs|.
+static void check_list(const ilist_t *list, const uint32_t *seqs, size_t n) {
+  ilist_node_t *node = ilist_begin(list);
+  size_t i = 0;
+
+  assert(ilist_length(list) == n);
+  assert(ilist_is_empty(list) == (n == 0));
+  for (; node != ilist_end(list); node = ilist_next(node), ++i) {
+    assert(i < n && item_of(node)->seq == seqs[i]);
+    assert(node->prev == (i ? &items[seqs[i - 1]].node : NULL));
+  }
+  assert(i == n);
+  assert(list->tail == (n ? &items[seqs[n - 1]].node : NULL));
+}
+
+static void test_link_and_remove(void) {
+  ilist_t list;
+
+  ilist_init(&list);
+  check_list(&list, NULL, 0);
+  ilist_append(&list, &items[1].node);
+  ilist_append(&list, &items[2].node);
+  ilist_prepend(&list, &items[0].node);
+  ilist_insert_after(&list, &items[2].node, &items[4].node);
+  ilist_insert_after(&list, &items[2].node, &items[3].node);
+  check_list(&list, (const uint32_t[]){0, 1, 2, 3, 4}, 5);
+
+  ilist_remove(&list, &items[2].node);
+  check_list(&list, (const uint32_t[]){0, 1, 3, 4}, 4);
+  ilist_remove(&list, &items[4].node);
+  check_list(&list, (const uint32_t[]){0, 1, 3}, 3);
+  assert(ilist_pop_front(&list) == &items[0].node);
+  check_list(&list, (const uint32_t[]){1, 3}, 2);
+  ilist_remove(&list, &items[1].node);
+  ilist_remove(&list, &items[3].node);
+  check_list(&list, NULL, 0);
+  assert(ilist_pop_front(&list) == NULL);
+}
+
+static void test_splice_and_cut(void) {
+  ilist_t a, b;
+
+  ilist_init(&a);
+  ilist_init(&b);
+  for (uint32_t i = 0; i < 6; ++i)
+    ilist_append(i < 3 ? &a : &b, &items[i].node);
+  ilist_splice(&a, &b);
+  check_list(&a, (const uint32_t[]){0, 1, 2, 3, 4, 5}, 6);
+  check_list(&b, NULL, 0);
+  ilist_splice(&a, &b);
+  check_list(&a, (const uint32_t[]){0, 1, 2, 3, 4, 5}, 6);
+  ilist_splice(&b, &a);
+  check_list(&b, (const uint32_t[]){0, 1, 2, 3, 4, 5}, 6);
+
+  assert(ilist_cut_front(&a, &b, 0) == 0);
+  assert(ilist_cut_front(&a, &b, 2) == 2);
+  check_list(&a, (const uint32_t[]){0, 1}, 2);
+  check_list(&b, (const uint32_t[]){2, 3, 4, 5}, 4);
+  assert(ilist_cut_front(&a, &b, 1) == 1);
+  check_list(&a, (const uint32_t[]){0, 1, 2}, 3);
+  assert(ilist_cut_front(&a, &b, 10) == 3);
+  check_list(&a, (const uint32_t[]){0, 1, 2, 3, 4, 5}, 6);
+  check_list(&b, NULL, 0);
+}
+
+// Random operations against an array model of the list.
+static void test_random_against_model(void) {
+  uint32_t model[ITEM_NUM], spare[ITEM_NUM];
+  size_t n = 0, spare_n = 0;
+  uint32_t lcg = 7;
+  ilist_t list, cut;
+
+  ilist_init(&list);
+  for (uint32_t i = 0; i < ITEM_NUM; ++i)
+    spare[spare_n++] = i;
+  for (int iter = 0; iter < 50000; ++iter) {
+    lcg = lcg * 1103515245u + 12345u;
+    uint32_t op = (lcg >> 16) % 4, r = lcg >> 8;
+    if (op <= 1 && spare_n) {
+      uint32_t id = spare[--spare_n];
+      size_t pos = n ? r % (n + 1) : 0;
+      ilist_insert_after(&list, pos ? &items[model[pos - 1]].node : NULL,
+                         &items[id].node);
+      memmove(&model[pos + 1], &model[pos], (n - pos) * sizeof(model[0]));
+      model[pos] = id;
+      ++n;
+    } else if (op == 2 && n) {
+      size_t pos = r % n;
+      ilist_remove(&list, &items[model[pos]].node);
+      spare[spare_n++] = model[pos];
+      memmove(&model[pos], &model[pos + 1], (n - pos - 1) * sizeof(model[0]));
+      --n;
+    } else if (op == 3 && n) {
+      size_t k = r % (n + 1);
+      ilist_init(&cut);
+      assert(ilist_cut_front(&cut, &list, k) == k);
+      check_list(&cut, model, k);
+      for (size_t i = 0; i < k; ++i)
+        spare[spare_n++] = model[i];
+      memmove(&model[0], &model[k], (n - k) * sizeof(model[0]));
+      n -= k;
+    }
+    check_list(&list, model, n);
+  }
+}
+
+int main(void) {
+  for (uint32_t i = 0; i < ITEM_NUM; ++i)
+    items[i].seq = i;
+  test_link_and_remove();
+  test_splice_and_cut();
+  test_random_against_model();
+  printf("All ilist tests passed.\n");
+  return 0;
+}